@@ -3,6 +3,18 @@
  */
 
 #include "main.h"
+#include "chunk_pool.h"
+#include "audio_spill.h"
+#include "dictation.h"
+#include "frame_adapt.h"
+#include "noise_suppress.h"
+#include "runtime_config.h"
+#include "session_profile.h"
+#include "tts_cache.h"
+#include "udp_audio.h"
+#include "wake_word.h"
+#include "ws_mux.h"
+#include "memory_plan.h"
 
 // Global handles for tasks
 TaskHandle_t audio_capture_task_handle = NULL;
@@ -11,6 +23,317 @@ TaskHandle_t audio_playback_task_handle = NULL;
 
 // audio_i2s_initialized and i2s_mutex are defined in globals.c
 
+// Nominal time between two capture reads of a frame
+#define FRAME_PERIOD_US(bytes) ((int64_t)(bytes) / (int64_t)sizeof(int16_t) * 1000000 / SAMPLE_RATE)
+
+// Capture jitter / playback underrun counters, read by the telemetry task
+static audio_timing_stats_t timing_stats;
+static portMUX_TYPE timing_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Set by tts_done; the playback task returns to IDLE once q_playback drains
+static volatile bool playback_end_of_stream = false;
+
+// Bumped by audio_playback_flush(); TTS chunks stamped with an older epoch
+// are stale and dropped, and a write in progress stops at the next block
+static volatile uint32_t playback_epoch = 0;
+
+// Button press that interrupted playback, until the microphone is live
+static int64_t barge_in_press_us = 0;
+
+// Spill to flash when fewer outbound message slots than this are free
+// (one chunk needs two: metadata and binary frame)
+#define SEND_WINDOW_MIN_FREE    4
+// Spilled chunks replayed per pass of the send loop
+#define SPILL_REPLAY_BURST      4
+
+// Internal DMA-capable bounce buffers between the I2S driver and the pool
+// chunks (which live in PSRAM); only these blocks touch the driver
+DMA_ATTR static uint8_t capture_bounce[I2S_BOUNCE_BYTES];
+DMA_ATTR static uint8_t playback_bounce[I2S_BOUNCE_BYTES];
+
+// Adaptive live frame size. Send times come from websocket_message_task and
+// round trips from the server's chunk acks, matched to the time each chunk
+// was queued in a small ring.
+#define UPLINK_ACK_SLOTS 16
+static frame_adapt_t uplink_frames;
+static size_t uplink_min_bytes, uplink_max_bytes;  // Limits uplink_frames was set up for
+static struct {
+    uint32_t seq;
+    int64_t queued_us;
+} uplink_sent[UPLINK_ACK_SLOTS];
+static portMUX_TYPE uplink_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// recording_stopped from the effect task, held by the send task until every
+// chunk captured before it has gone out (live or replayed from the spill)
+static cJSON *deferred_stop = NULL;
+static portMUX_TYPE stop_lock = portMUX_INITIALIZER_UNLOCKED;
+// The server holds a recording open from recording_started until the
+// recording_stopped that ends it has been sent; a reconnect in between
+// keeps SESSION_ID so the rest of the recording reaches it
+static bool recording_open = false;
+
+// Set by the capture task before it reads a frame of a recording, cleared
+// once it has queued the recording's last frame (or read nothing more).
+// The stop effect runs while a frame may still be filling, so the held
+// recording_stopped waits for this as well as for the queues.
+static bool capture_recording = false;
+
+#if CONFIG_HOTPIN_NOISE_SUPPRESS
+// ~12.5 KB, mostly noise statistics read once per 8 ms hop; PSRAM when the
+// build allows it, like the chunk pool (see memory_plan.h)
+EXT_RAM_BSS_ATTR static ns_state_t noise_suppressor;
+#endif
+
+static void record_capture_read(uint32_t state_generation, size_t frame_bytes) {
+    static int64_t last_read_us = 0;
+    static uint32_t last_generation = UINT32_MAX;
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&timing_lock);
+    timing_stats.capture_chunks++;
+    // Only reads within the same recording form an interval
+    if (state_generation == last_generation) {
+        int64_t jitter_us = (now_us - last_read_us) - FRAME_PERIOD_US(frame_bytes);
+        uint32_t abs_jitter_us = (uint32_t)(jitter_us < 0 ? -jitter_us : jitter_us);
+        timing_stats.capture_intervals++;
+        timing_stats.capture_jitter_total_us += abs_jitter_us;
+        if (abs_jitter_us > timing_stats.capture_jitter_max_us) {
+            timing_stats.capture_jitter_max_us = abs_jitter_us;
+        }
+    }
+    portEXIT_CRITICAL(&timing_lock);
+
+    last_read_us = now_us;
+    last_generation = state_generation;
+}
+
+#if CONFIG_HOTPIN_NOISE_SUPPRESS
+// Runs on the bounce buffer before the copy to PSRAM. Blocks are not whole
+// hops, so they are fed a hop at a time: each call then runs at most one
+// frame, and only calls that ran one are counted.
+static void HOT_PATH_ATTR suppress_noise(int16_t *samples, size_t count) {
+    for (size_t i = 0; i < count; i += NS_HOP_LEN) {
+        size_t n = count - i < NS_HOP_LEN ? count - i : NS_HOP_LEN;
+        uint32_t start = perf_begin();
+        if (ns_process(&noise_suppressor, samples + i, n) > 0) {
+            perf_end(PERF_NOISE_SUPPRESS, start);
+        }
+    }
+}
+#endif
+
+// Size of the next live frame: one packet over UDP, the server's chunk_ms if
+// it set one, else adaptive within the session's limits, which restart the
+// controller when a new session_config changes them
+static size_t uplink_frame_bytes(void) {
+    if (udp_audio_active()) {
+        return UDP_AUDIO_FRAME_BYTES;
+    }
+    size_t max_bytes = session_uplink_frame_bytes();
+    size_t min_bytes = session_uplink_min_frame_bytes();
+    runtime_config_t config;
+    runtime_config_get(&config);
+    if (config.chunk_ms > 0) {
+        size_t bytes = (size_t)config.chunk_ms * (SAMPLE_RATE * sizeof(int16_t) / 1000);
+        bytes = bytes < min_bytes ? min_bytes : bytes > max_bytes ? max_bytes : bytes;
+        return bytes & ~(size_t)1;
+    }
+#if CONFIG_HOTPIN_ADAPTIVE_FRAMES
+    portENTER_CRITICAL(&uplink_lock);
+    if (min_bytes != uplink_min_bytes || max_bytes != uplink_max_bytes) {
+        frame_adapt_init(&uplink_frames, SAMPLE_RATE * sizeof(int16_t) / 1000, min_bytes, max_bytes);
+        uplink_min_bytes = min_bytes;
+        uplink_max_bytes = max_bytes;
+    }
+    size_t bytes = frame_adapt_bytes(&uplink_frames);
+    portEXIT_CRITICAL(&uplink_lock);
+    return bytes;
+#else
+    return max_bytes;
+#endif
+}
+
+void audio_uplink_note_sent(size_t len, uint32_t send_us) {
+    // Frames waiting for the send task, plus those already queued for the
+    // WebSocket (one message per frame)
+    UBaseType_t queued = q_capture_to_send ? uxQueueMessagesWaiting(q_capture_to_send) : 0;
+    queued += ws_outbound_backlog();
+    portENTER_CRITICAL(&uplink_lock);
+    if (uplink_max_bytes > 0) {
+        frame_adapt_note_sent(&uplink_frames, (uint32_t)len, send_us, (uint32_t)queued);
+    }
+    portEXIT_CRITICAL(&uplink_lock);
+}
+
+void audio_uplink_note_ack(uint32_t seq) {
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&uplink_lock);
+    uint32_t slot = seq % UPLINK_ACK_SLOTS;
+    if (uplink_sent[slot].seq == seq && uplink_sent[slot].queued_us > 0 && uplink_max_bytes > 0) {
+        frame_adapt_note_rtt(&uplink_frames, (uint32_t)(now_us - uplink_sent[slot].queued_us));
+        uplink_sent[slot].queued_us = 0;
+    }
+    portEXIT_CRITICAL(&uplink_lock);
+}
+
+typedef enum {
+    CAPTURE_FULL,       // The whole frame was read
+    CAPTURE_ENDED,      // The recording ended; bytes_read holds its tail
+    CAPTURE_BUSY,       // I2S mutex not available, nothing read
+    CAPTURE_FAILED,     // i2s_read error or short read while recording
+} capture_result_t;
+
+// Fill one frame of frame_bytes (at most CHUNK_BYTES) from I2S block by
+// block. The I2S mutex is held per block, so a mode switch waits at most one
+// block instead of a whole frame. Once the recording (state generation)
+// has ended, no further block is read and the frame ends with its tail.
+static capture_result_t capture_read_chunk(uint8_t *chunk, size_t frame_bytes, uint32_t generation,
+                                           size_t *bytes_read) {
+    *bytes_read = 0;
+    while (*bytes_read < frame_bytes) {
+        size_t want = frame_bytes - *bytes_read;
+        if (want > I2S_BOUNCE_BYTES) {
+            want = I2S_BOUNCE_BYTES;
+        }
+
+        size_t got = 0;
+        esp_err_t err = ESP_OK;
+        if (!i2s_mutex || xSemaphoreTake(i2s_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+            return *bytes_read > 0 ? CAPTURE_FAILED : CAPTURE_BUSY;
+        }
+        // The state effect task withdraws RECORDING before it touches I2S
+        state_snapshot_t snapshot = get_state_snapshot();
+        bool ended = snapshot.state != CLIENT_STATE_RECORDING || snapshot.generation != generation ||
+                     !audio_i2s_initialized;
+        if (!ended) {
+            err = i2s_read(I2S_PORT, capture_bounce, want, &got, pdMS_TO_TICKS(200));
+        }
+        xSemaphoreGive(i2s_mutex);
+        if (ended) {
+            return CAPTURE_ENDED;
+        }
+        if (err != ESP_OK || got != want) {
+            ESP_LOGE("AUDIO", "I2S read failed: %s, %u of %u bytes", esp_err_to_name(err),
+                     (unsigned)got, (unsigned)want);
+            *bytes_read += got;
+            return CAPTURE_FAILED;
+        }
+
+#if CONFIG_HOTPIN_NOISE_SUPPRESS
+        if (session_feature_enabled(SESSION_FEATURE_NOISE_SUPPRESS)) {
+            suppress_noise((int16_t*)capture_bounce, got / sizeof(int16_t));
+        }
+#endif
+
+        uint32_t copy_start = perf_begin();
+        memcpy(chunk + *bytes_read, capture_bounce, got);
+        perf_end(PERF_CAPTURE_COPY, copy_start);
+        *bytes_read += got;
+    }
+    return CAPTURE_FULL;
+}
+
+// Play one chunk block by block through the bounce buffer. Returns the
+// cycles spent blocked in i2s_write so callers can exclude DMA waits.
+// Like capture, the I2S mutex is held per block, and a flush stops the
+// chunk at the next block boundary.
+static esp_err_t playback_write_chunk(const uint8_t *chunk, size_t len,
+                                      size_t *bytes_written, uint32_t *write_cycles) {
+    uint32_t epoch = playback_epoch;
+    *bytes_written = 0;
+    *write_cycles = 0;
+    while (*bytes_written < len) {
+        size_t block = len - *bytes_written;
+        if (block > I2S_BOUNCE_BYTES) {
+            block = I2S_BOUNCE_BYTES;
+        }
+
+        uint32_t copy_start = perf_begin();
+        memcpy(playback_bounce, chunk + *bytes_written, block);
+        perf_end(PERF_PLAYBACK_COPY, copy_start);
+
+        size_t written = 0;
+        esp_err_t err = ESP_ERR_INVALID_STATE;
+        if (!i2s_mutex || xSemaphoreTake(i2s_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        uint32_t write_start = perf_begin();
+        if (audio_i2s_initialized && epoch == playback_epoch) {
+            err = i2s_write(I2S_PORT, playback_bounce, block, &written, portMAX_DELAY);
+        }
+        *write_cycles += perf_begin() - write_start;
+        xSemaphoreGive(i2s_mutex);
+        *bytes_written += written;
+        if (err != ESP_OK || written != block) {
+            return err != ESP_OK ? err : ESP_FAIL;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t audio_write_clip(const uint8_t *pcm, size_t len) {
+    size_t written = 0;
+    uint32_t write_cycles = 0;
+    return playback_write_chunk(pcm, len, &written, &write_cycles);
+}
+
+void get_audio_timing_stats(audio_timing_stats_t *stats) {
+    portENTER_CRITICAL(&timing_lock);
+    *stats = timing_stats;
+    portEXIT_CRITICAL(&timing_lock);
+
+    portENTER_CRITICAL(&uplink_lock);
+    stats->uplink_frame_ms = uplink_max_bytes > 0 ? frame_adapt_ms(&uplink_frames)
+                                                  : (uint32_t)(session_uplink_frame_bytes() / (SAMPLE_RATE * sizeof(int16_t) / 1000));
+    stats->uplink_frame_grows = uplink_frames.grows;
+    stats->uplink_frame_shrinks = uplink_frames.shrinks;
+    stats->uplink_rtt_us = uplink_frames.rtt_us;
+    portEXIT_CRITICAL(&uplink_lock);
+}
+
+void audio_playback_end_of_stream(void) {
+    playback_end_of_stream = true;
+}
+
+uint32_t audio_playback_epoch(void) {
+    return playback_epoch;
+}
+
+void audio_playback_flush(void) {
+    playback_epoch++;
+    playback_end_of_stream = false;
+
+    audio_chunk_t chunk;
+    int dropped = 0;
+    while (q_playback && xQueueReceive(q_playback, &chunk, 0) == pdTRUE) {
+        free_chunk(chunk.data);
+        dropped++;
+    }
+    ESP_LOGI("AUDIO", "Playback flushed, %d queued chunks dropped", dropped);
+}
+
+void audio_note_barge_in(int64_t press_us) {
+    portENTER_CRITICAL(&timing_lock);
+    barge_in_press_us = press_us;
+    portEXIT_CRITICAL(&timing_lock);
+}
+
+// First read of a recording: close out a pending barge-in measurement
+static void record_capture_start(void) {
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&timing_lock);
+    if (barge_in_press_us > 0) {
+        uint32_t latency_us = (uint32_t)(now_us - barge_in_press_us);
+        timing_stats.barge_ins++;
+        timing_stats.barge_in_total_us += latency_us;
+        if (latency_us > timing_stats.barge_in_max_us) {
+            timing_stats.barge_in_max_us = latency_us;
+        }
+        barge_in_press_us = 0;
+    }
+    portEXIT_CRITICAL(&timing_lock);
+}
+
 bool init_i2s() {
     // Create I2S mutex if not exists
     if (!i2s_mutex) {
@@ -39,8 +362,8 @@ bool init_i2s() {
         .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,  // Mono
         .communication_format = I2S_COMM_FORMAT_STAND_I2S,
         .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
-        .dma_buf_count = 4,
-        .dma_buf_len = 1024,
+        .dma_buf_count = I2S_DMA_BUF_COUNT,
+        .dma_buf_len = I2S_DMA_BUF_LEN,
         .use_apll = false,
         .tx_desc_auto_clear = true,
         .fixed_mclk = 0,
@@ -104,113 +427,406 @@ bool uninstall_i2s() {
     return true;
 }
 
+// Dictation mode: read one chunk straight into the banked store
+static void capture_dictation_chunk(uint32_t generation) {
+    uint8_t *slot = dictation_write_slot();
+    if (!slot) {
+        // Store full: end the recording rather than overwrite unsent audio
+        ESP_LOGW("AUDIO", "Dictation store full, ending recording");
+        dictation_note_full_stop();
+        set_state(CLIENT_STATE_PROCESSING);
+        return;
+    }
+
+    size_t bytes_read = 0;
+    capture_result_t result = capture_read_chunk(slot, CHUNK_BYTES, generation, &bytes_read);
+    if (result == CAPTURE_BUSY) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+        return;
+    }
+    if (result == CAPTURE_ENDED) {
+        // Keep the tail read before the stop
+        if (bytes_read > 0) {
+            dictation_commit_write(next_seq++, bytes_read);
+        }
+        return;
+    }
+    if (result == CAPTURE_FAILED) {
+        set_state(CLIENT_STATE_PROCESSING);
+        return;
+    }
+
+    record_capture_read(generation, CHUNK_BYTES);
+    dictation_commit_write(next_seq++, bytes_read);
+}
+
+// Recording started by the wake word: queue the audio leading up to the
+// detection ahead of the first live chunk. Runs once per recording; any
+// pre-roll left over when the pool runs dry is dropped. The pre-roll goes
+// through the suppressor first, so it and the live audio are one stream
+// with the same gain and delay.
+static void queue_wake_preroll(void) {
+    while (1) {
+        uint8_t *buf = alloc_chunk();
+        if (!buf) {
+            return;
+        }
+        size_t len = wake_word_take_preroll(buf, CHUNK_BYTES);
+        if (len == 0) {
+            free_chunk(buf);
+            return;
+        }
+
+#if CONFIG_HOTPIN_NOISE_SUPPRESS
+        if (session_feature_enabled(SESSION_FEATURE_NOISE_SUPPRESS)) {
+            suppress_noise((int16_t*)buf, len / sizeof(int16_t));
+        }
+#endif
+
+        audio_chunk_t chunk = {
+            .data = buf,
+            .len = len,
+            .seq = next_seq++,
+            .timestamp = xTaskGetTickCount(),
+        };
+        if (xQueueSend(q_capture_to_send, &chunk, portMAX_DELAY) != pdTRUE) {
+            free_chunk(buf);
+            return;
+        }
+    }
+}
+
 void audio_capture_task(void *pvParameters) {
     audio_capture_task_handle = xTaskGetCurrentTaskHandle();
+    uint32_t recording_generation = UINT32_MAX;
+
+#if CONFIG_HOTPIN_NOISE_SUPPRESS
+    runtime_config_t config;
+    runtime_config_get(&config);
+    uint8_t ns_max_db = config.ns_max_db;
+    ns_init();
+    ns_reset(&noise_suppressor, ns_max_db);
+#endif
     
-    while (current_state != CLIENT_STATE_SHUTDOWN) {
-        if (current_state == CLIENT_STATE_RECORDING) {
-            // Check if I2S is initialized before attempting to read
-            if (!audio_i2s_initialized) {
-                ESP_LOGW("AUDIO", "I2S not initialized, waiting...");
-                vTaskDelay(pdMS_TO_TICKS(100));
-                continue;
-            }
-            
-            // Allocate a chunk for audio data
-            uint8_t *buf = alloc_chunk();
-            if (!buf) {
-                // Chunk pool exhausted
-                ESP_LOGE("AUDIO", "Buffer pool exhausted during recording");
-                
-                // Send error to server
-                cJSON *json = cJSON_CreateObject();
-                cJSON_AddStringToObject(json, "type", "error");
-                cJSON_AddStringToObject(json, "session", SESSION_ID);
-                cJSON_AddStringToObject(json, "state", "RECORDING");
-                cJSON_AddStringToObject(json, "error", "buffer_overflow");
-                cJSON_AddStringToObject(json, "detail", "Free chunk pool exhausted");
-                
-                // ws_send_json takes ownership of the JSON object
-                // It will delete the object whether it succeeds or fails
-                ws_send_json(json);
-                // NOTE: json object is already deleted by ws_send_json
-                // Do not call cJSON_Delete(json) here to avoid double-free
-                
-                // Transition to processing state
-                set_state(CLIENT_STATE_PROCESSING);
-                continue;
+    while (1) {
+        if (get_state() != CLIENT_STATE_RECORDING) {
+            // Let the shared chunk go back to the pool while not recording
+            chunk_pool_close_frames();
+            // Every frame of the recording is queued (or stored) by now
+            __atomic_store_n(&capture_recording, false, __ATOMIC_SEQ_CST);
+        }
+
+        // Sleep until RECORDING (I2S already in RX mode) or SHUTDOWN
+        EventBits_t bits = wait_for_state(STATE_BIT(CLIENT_STATE_RECORDING) | STATE_BIT(CLIENT_STATE_SHUTDOWN),
+                                          portMAX_DELAY);
+        record_task_wakeup(WAKEUP_AUDIO_CAPTURE);
+        if (bits & STATE_BIT(CLIENT_STATE_SHUTDOWN)) {
+            break;
+        }
+
+        // Check if I2S is initialized before attempting to read
+        if (!audio_i2s_initialized) {
+            ESP_LOGW("AUDIO", "I2S not initialized, waiting...");
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+
+        // Before capture_read_chunk() checks the state: either the stop sees
+        // this flag, or this task sees the stop and reads nothing more
+        __atomic_store_n(&capture_recording, true, __ATOMIC_SEQ_CST);
+
+        uint32_t generation = get_state_snapshot().generation;
+        bool new_recording = generation != recording_generation;
+        recording_generation = generation;
+#if CONFIG_HOTPIN_NOISE_SUPPRESS
+        if (new_recording) {
+            // The previous recording's tail must not bleed into this one;
+            // a new attenuation limit from the server starts here too
+            runtime_config_get(&config);
+            if (config.ns_max_db != ns_max_db) {
+                ns_max_db = config.ns_max_db;
+                ns_reset(&noise_suppressor, ns_max_db);
+            } else {
+                ns_restart(&noise_suppressor);
             }
+        }
+#endif
 
-            // Read audio data from I2S with mutex protection
-            size_t bytes_read = 0;
-            esp_err_t err = ESP_FAIL;
-            
-            if (i2s_mutex && xSemaphoreTake(i2s_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-                if (audio_i2s_initialized) {
-                    err = i2s_read(I2S_PORT, buf, CHUNK_BYTES, &bytes_read, pdMS_TO_TICKS(1000));
+        if (dictation_active()) {
+            capture_dictation_chunk(generation);
+            continue;
+        }
+
+        if (new_recording) {
+            queue_wake_preroll();
+        }
+        
+        // Allocate a buffer for the next frame, sized for the current link
+        size_t frame_bytes = uplink_frame_bytes();
+        uint8_t *buf = alloc_frame(frame_bytes);
+        if (!buf) {
+            // Pool exhausted even after growing: keep recording by recycling the
+            // oldest chunk that has not been sent yet (the server sees a seq gap)
+            audio_chunk_t oldest;
+            if (xQueueReceive(q_capture_to_send, &oldest, 0) == pdTRUE) {
+                chunk_pool_note_eviction();
+                ESP_LOGW("AUDIO", "Buffer pool exhausted, dropping unsent chunk %"PRIu32, oldest.seq);
+                if (oldest.len < frame_bytes) {
+                    // A shorter frame, maybe cut from a shared chunk
+                    free_chunk(oldest.data);
+                    continue;
                 }
-                xSemaphoreGive(i2s_mutex);
+                buf = oldest.data;
             } else {
-                ESP_LOGW("AUDIO", "Could not take I2S mutex, skipping read");
-                free_chunk(buf);
-                vTaskDelay(pdMS_TO_TICKS(10));
-                continue;
-            }
-            
-            if (err != ESP_OK || bytes_read != CHUNK_BYTES) {
-                ESP_LOGE("AUDIO", "I2S read failed: %s, bytes read: %d", 
-                         esp_err_to_name(err), bytes_read);
-                
-                // Return buffer to pool
-                free_chunk(buf);
-                
-                // Send error to server
-                cJSON *json = cJSON_CreateObject();
-                cJSON_AddStringToObject(json, "type", "error");
-                cJSON_AddStringToObject(json, "session", SESSION_ID);
-                cJSON_AddStringToObject(json, "state", "RECORDING");
-                cJSON_AddStringToObject(json, "error", "i2s_read_timeout");
-                cJSON_AddStringToObject(json, "detail", "Failed to read expected bytes from I2S");
-                
-                ws_send_json(json);
-                // NOTE: json object is already deleted by ws_send_json
-                // Do not call cJSON_Delete(json) here to avoid double-free
-                
-                // Transition to processing state
-                set_state(CLIENT_STATE_PROCESSING);
+                // Every chunk is in flight on the uplink; wait for one to return
+                ESP_LOGD("AUDIO", "Buffer pool exhausted, waiting for the uplink");
+                vTaskDelay(pdMS_TO_TICKS(20));
                 continue;
             }
+        }
 
-            // Create audio chunk structure
-            audio_chunk_t chunk;
-            chunk.data = buf;
-            chunk.len = bytes_read;
-            chunk.seq = next_seq++;
-            chunk.timestamp = xTaskGetTickCount();
-
-            // Send to send queue
-            if (xQueueSend(q_capture_to_send, &chunk, portMAX_DELAY) != pdTRUE) {
-                ESP_LOGE("AUDIO", "Failed to send chunk to capture queue");
-                free_chunk(buf);
-            }
-        } else {
-            // Not recording, wait a bit before checking again
+        // Read audio data from I2S through the internal bounce buffer
+        record_capture_start();
+        size_t bytes_read = 0;
+        capture_result_t result = capture_read_chunk(buf, frame_bytes, generation, &bytes_read);
+        if (result == CAPTURE_BUSY) {
+            ESP_LOGW("AUDIO", "Could not take I2S mutex, skipping read");
+            free_chunk(buf);
             vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
+
+        if (result == CAPTURE_ENDED && bytes_read == 0) {
+            free_chunk(buf);
+            continue;
+        }
+
+        if (result == CAPTURE_FAILED) {
+            // Return buffer to pool
+            free_chunk(buf);
+            
+            // Send error to server
+            cJSON *json = cJSON_CreateObject();
+            cJSON_AddStringToObject(json, "type", "error");
+            cJSON_AddStringToObject(json, "session", SESSION_ID);
+            cJSON_AddStringToObject(json, "state", "RECORDING");
+            cJSON_AddStringToObject(json, "error", "i2s_read_timeout");
+            cJSON_AddStringToObject(json, "detail", "Failed to read expected bytes from I2S");
+            
+            ws_send_json(json);
+            // NOTE: json object is already deleted by ws_send_json
+            // Do not call cJSON_Delete(json) here to avoid double-free
+            
+            // Transition to processing state
+            set_state(CLIENT_STATE_PROCESSING);
+            continue;
+        }
+
+        uint32_t loop_start = perf_begin();
+        // A tail cut short by the stop is not a capture interval
+        if (result == CAPTURE_FULL) {
+            record_capture_read(generation, frame_bytes);
+        }
+
+        // Create audio chunk structure
+        audio_chunk_t chunk;
+        chunk.data = buf;
+        chunk.len = bytes_read;
+        chunk.seq = next_seq++;
+        chunk.timestamp = xTaskGetTickCount();
+
+        // Send to send queue
+        if (xQueueSend(q_capture_to_send, &chunk, portMAX_DELAY) != pdTRUE) {
+            ESP_LOGE("AUDIO", "Failed to send chunk to capture queue");
+            free_chunk(buf);
         }
+        perf_end(PERF_CAPTURE_LOOP, loop_start);
     }
 
     vTaskDelete(NULL);
 }
 
+// Send one chunk. Takes ownership of data. The WebSocket task frames it:
+// audio_chunk_meta and a binary frame, or one multiplexed message carrying
+// its own seq. Only live frames feed the frame size controller and its
+// round trip times.
+static bool send_audio_chunk(uint32_t seq, uint8_t *data, size_t len, bool replay, bool live) {
+    uint32_t loop_start = perf_begin();
+
+    if (live) {
+        portENTER_CRITICAL(&uplink_lock);
+        uplink_sent[seq % UPLINK_ACK_SLOTS].seq = seq;
+        uplink_sent[seq % UPLINK_ACK_SLOTS].queued_us = esp_timer_get_time();
+        portEXIT_CRITICAL(&uplink_lock);
+    }
+
+    // ws_send_audio owns the chunk from here and returns it to the pool
+    // once it is on the wire (or on failure)
+    uint8_t flags = (live ? WS_AUDIO_LIVE : 0) | (replay ? WS_AUDIO_REPLAY : 0);
+    bool sent = ws_send_audio(seq, data, len, flags);
+    perf_end(PERF_SEND_LOOP, loop_start);
+    if (!sent) {
+        ESP_LOGE("AUDIO", "Failed to send audio chunk %"PRIu32, seq);
+        return false;
+    }
+    return true;
+}
+
+// Outbound queue close to full: the uplink is not keeping up. Messages the
+// multiplexer holds count as well, or it would hide a backlog.
+static bool uplink_backed_up(void) {
+    return uxQueueSpacesAvailable(q_ws_messages) < SEND_WINDOW_MIN_FREE ||
+           ws_outbound_backlog() + SEND_WINDOW_MIN_FREE > QUEUE_LEN_WS_MESSAGES;
+}
+
+// Dictation mode: hand stored chunks to the WebSocket while the uplink has room
+static void drain_dictation_store(void) {
+    while (dictation_pending() > 0) {
+        if (!esp_websocket_client_is_connected(get_ws_client()) || uplink_backed_up()) {
+            return;
+        }
+
+        uint8_t *buf = alloc_chunk();
+        if (!buf) {
+            return;
+        }
+
+        uint32_t seq = 0;
+        size_t len = 0;
+        if (!dictation_peek(buf, &seq, &len)) {
+            free_chunk(buf);
+            return;
+        }
+        if (!send_audio_chunk(seq, buf, len, false, false)) {
+            return;  // Stays in the store, retried on the next pass
+        }
+        dictation_consume();
+    }
+}
+
+void audio_begin_recording(void) {
+    portENTER_CRITICAL(&stop_lock);
+    recording_open = true;
+    portEXIT_CRITICAL(&stop_lock);
+}
+
+bool audio_recording_open(void) {
+    portENTER_CRITICAL(&stop_lock);
+    bool open = recording_open;
+    portEXIT_CRITICAL(&stop_lock);
+    return open;
+}
+
+void audio_end_recording(cJSON *stop) {
+    portENTER_CRITICAL(&stop_lock);
+    cJSON *previous = deferred_stop;
+    deferred_stop = stop;
+    portEXIT_CRITICAL(&stop_lock);
+
+    if (previous) {
+        // New recordings are refused while a stop is held, so this only
+        // happens if one slipped through; its audio joins this recording
+        ESP_LOGW("AUDIO", "Previous recording_stopped still held, replacing it");
+        cJSON_Delete(previous);
+    }
+}
+
+bool audio_recording_ending(void) {
+    portENTER_CRITICAL(&stop_lock);
+    bool ending = deferred_stop != NULL;
+    portEXIT_CRITICAL(&stop_lock);
+    return ending;
+}
+
+// Send the held recording_stopped once the capture task has left the
+// recording and the capture queue, the spill and the dictation store are
+// empty. The capture task queues its last frame before it clears
+// capture_recording, and a chunk leaves a store only after it has been
+// handed to the WebSocket, so nothing of the recording can follow it.
+static void send_deferred_stop(void) {
+    if (__atomic_load_n(&capture_recording, __ATOMIC_SEQ_CST)) {
+        return;
+    }
+    if (uxQueueMessagesWaiting(q_capture_to_send) > 0 || audio_spill_pending() > 0 ||
+        dictation_pending() > 0 || !esp_websocket_client_is_connected(get_ws_client())) {
+        return;
+    }
+
+    portENTER_CRITICAL(&stop_lock);
+    cJSON *json = deferred_stop;
+    deferred_stop = NULL;
+    if (json) {
+        recording_open = false;
+    }
+    portEXIT_CRITICAL(&stop_lock);
+
+    if (!json) {
+        return;
+    }
+    // Every live frame has gone out over UDP by now: close the last parity
+    // group and name the last packet
+    udp_audio_end_recording(json);
+    // ws_send_json_after takes ownership of the JSON object
+    if (!ws_send_json_after(json, WS_MUX_AUDIO)) {
+        ESP_LOGE("AUDIO", "Failed to send recording_stopped");
+    }
+}
+
+// Replay spilled chunks oldest-first while the uplink has room
+static void replay_spilled_chunks(void) {
+    for (int i = 0; i < SPILL_REPLAY_BURST && audio_spill_pending() > 0; i++) {
+        if (!esp_websocket_client_is_connected(get_ws_client()) || uplink_backed_up()) {
+            return;
+        }
+
+        uint8_t *buf = alloc_chunk();
+        if (!buf) {
+            return;
+        }
+
+        uint32_t seq = 0;
+        size_t len = 0;
+        if (!audio_spill_peek(&seq, buf, &len)) {
+            free_chunk(buf);
+            return;
+        }
+        if (!send_audio_chunk(seq, buf, len, true, false)) {
+            return;  // Stays pending, retried on the next pass
+        }
+        audio_spill_consume();
+    }
+}
+
 void audio_send_task(void *pvParameters) {
     audio_send_task_handle = xTaskGetCurrentTaskHandle();
     
-    while (current_state != CLIENT_STATE_SHUTDOWN) {
+    while (get_state() != CLIENT_STATE_SHUTDOWN) {
+        send_deferred_stop();
+
         audio_chunk_t chunk;
         if (xQueueReceive(q_capture_to_send, &chunk, pdMS_TO_TICKS(100)) == pdTRUE) {
+            esp_websocket_client_handle_t ws = get_ws_client();
+
+            // Store-and-forward: while the uplink is down or backed up, and until
+            // the spilled backlog has drained, chunks go to flash in order
+            bool spill = session_feature_enabled(SESSION_FEATURE_STORE_FORWARD) &&
+                         (!esp_websocket_client_is_connected(ws) || uplink_backed_up());
+            if (spill || audio_spill_pending() > 0) {
+                if (audio_spill_store(chunk.seq, chunk.data, chunk.len)) {
+                    free_chunk(chunk.data);
+                    replay_spilled_chunks();
+                    continue;
+                }
+                if (audio_spill_pending() > 0) {
+                    // Sent live it would overtake the backlog
+                    ESP_LOGW("AUDIO", "Spill failed behind a backlog, dropping audio chunk %"PRIu32, chunk.seq);
+                    free_chunk(chunk.data);
+                    continue;
+                }
+            }
+
             // Wait for WebSocket to be ready before sending
             int retry_count = 0;
-            esp_websocket_client_handle_t ws = get_ws_client();
             while (!esp_websocket_client_is_connected(ws) && retry_count < 50) {
                 vTaskDelay(pdMS_TO_TICKS(10));
                 retry_count++;
@@ -222,42 +838,22 @@ void audio_send_task(void *pvParameters) {
                 continue;
             }
             
-            // Send chunk metadata
-            cJSON *meta_json = cJSON_CreateObject();
-            cJSON_AddStringToObject(meta_json, "type", "audio_chunk_meta");
-            cJSON_AddStringToObject(meta_json, "session", SESSION_ID);
-            cJSON_AddNumberToObject(meta_json, "seq", chunk.seq);
-            cJSON_AddNumberToObject(meta_json, "len", chunk.len);
-
-            // ws_send_json takes ownership of the JSON object
-            // It will delete the object whether it succeeds or fails
-            if (!ws_send_json(meta_json)) {
-                ESP_LOGE("AUDIO", "Failed to send audio chunk metadata for seq %"PRIu32, chunk.seq);
-                // NOTE: meta_json object is already deleted by ws_send_json on failure
-                // Do not call cJSON_Delete(meta_json) here to avoid double-free
-                free_chunk(chunk.data);
-                continue;
-            }
-            // NOTE: meta_json object is now owned by the WebSocket system on success
-            // Do not call cJSON_Delete(meta_json) here to avoid premature deletion
-
-            // Small delay to let metadata be processed
-            vTaskDelay(pdMS_TO_TICKS(20));
-
-            // Send binary chunk data
-            if (!ws_send_binary(chunk.data, chunk.len)) {
-                ESP_LOGE("AUDIO", "Failed to send audio chunk binary data for seq %"PRIu32, chunk.seq);
+            // Over UDP a late or lost packet holds back nothing behind it
+            if (udp_audio_send(chunk.data, chunk.len)) {
                 free_chunk(chunk.data);
                 continue;
             }
 
-            // Return buffer to pool after successful send
-            free_chunk(chunk.data);
-            
-            // Delay before next chunk to prevent overwhelming the WebSocket
-            // At 16kHz mono PCM16, 16KB = 0.5s of audio
-            // So this adds ~25ms overhead per 500ms chunk = 5% overhead
-            vTaskDelay(pdMS_TO_TICKS(25));
+            // No pacing delay: a fixed sleep per chunk would cap short
+            // frames below real time, and the frame size already backs off
+            // when the uplink queue grows
+            send_audio_chunk(chunk.seq, chunk.data, chunk.len, false, true);
+        } else if (dictation_pending() > 0) {
+            // Also after the session turned dictation off: a held stop waits on it
+            drain_dictation_store();
+        } else {
+            // Nothing captured: drain the backlog left by a disconnect
+            replay_spilled_chunks();
         }
     }
 
@@ -270,14 +866,54 @@ void audio_playback_task(void *pvParameters) {
     // I2S configuration is now handled by set_state() function
     // when transitioning to/from PLAYING state
 
-    while (current_state != CLIENT_STATE_SHUTDOWN) {
+    bool stream_active = false;  // At least one chunk played since the queue last ran dry
+
+    while (1) {
+        // Sleep until PLAYING (I2S already in TX mode) or SHUTDOWN
+        EventBits_t bits = wait_for_state(STATE_BIT(CLIENT_STATE_PLAYING) | STATE_BIT(CLIENT_STATE_SHUTDOWN),
+                                          portMAX_DELAY);
+        record_task_wakeup(WAKEUP_AUDIO_PLAYBACK);
+        if (bits & STATE_BIT(CLIENT_STATE_SHUTDOWN)) {
+            break;
+        }
+
+        // A local replay is served straight from the PSRAM cache
         audio_chunk_t chunk;
-        if (xQueueReceive(q_playback, &chunk, pdMS_TO_TICKS(100)) == pdTRUE) {
-            // Write audio data to I2S
+        const uint8_t *cached = NULL;
+        size_t cached_len = 0;
+        bool replayed = tts_cache_replay_next(&cached, &cached_len);
+        if (replayed) {
+            chunk.data = (uint8_t *)cached;
+            chunk.len = cached_len;
+        }
+
+        if (replayed || xQueueReceive(q_playback, &chunk, pdMS_TO_TICKS(100)) == pdTRUE) {
+            // Flushed by a barge-in, or queued for a stream that was cut short
+            if (get_state() != CLIENT_STATE_PLAYING || (!replayed && chunk.seq != playback_epoch)) {
+                if (!replayed) {
+                    free_chunk(chunk.data);
+                }
+                stream_active = false;
+                continue;
+            }
+
+            // Write audio data to I2S; the time blocked on DMA space is not loop work
+            uint32_t loop_start = perf_begin();
             size_t bytes_written = 0;
-            esp_err_t err = i2s_write(I2S_PORT, chunk.data, chunk.len, &bytes_written, portMAX_DELAY);
+            uint32_t write_cycles = 0;
+            esp_err_t err = playback_write_chunk(chunk.data, chunk.len, &bytes_written, &write_cycles);
+            if (!stream_active) {
+                tts_cache_note_first_audio();
+            }
             
             if (err != ESP_OK || bytes_written != chunk.len) {
+                if (get_state() != CLIENT_STATE_PLAYING) {
+                    // Cut short by a barge-in; not an error
+                    if (!replayed) {
+                        free_chunk(chunk.data);
+                    }
+                    continue;
+                }
                 ESP_LOGE("AUDIO", "I2S write failed: %s, bytes written: %d", 
                          esp_err_to_name(err), bytes_written);
                 
@@ -294,17 +930,41 @@ void audio_playback_task(void *pvParameters) {
                 // Do not call cJSON_Delete(json) here to avoid double-free
                 
                 // Free the chunk data
-                free_chunk(chunk.data);
+                if (!replayed) {
+                    free_chunk(chunk.data);
+                }
                 continue;
             }
 
-            // Free the chunk data after playback
-            free_chunk(chunk.data);
-        } else {
-            // No data to play, check if state has changed
-            if (current_state != CLIENT_STATE_PLAYING) {
-                break; // Exit if not in playing state
+            // Keep a copy for local replay, then free the chunk data
+            if (!replayed) {
+                tts_cache_append(chunk.data, chunk.len);
+                free_chunk(chunk.data);
+            }
+            perf_end(PERF_PLAYBACK_LOOP, loop_start + write_cycles);
+            stream_active = true;
+            portENTER_CRITICAL(&timing_lock);
+            timing_stats.playback_chunks++;
+            portEXIT_CRITICAL(&timing_lock);
+        } else if (get_state() != CLIENT_STATE_PLAYING) {
+            // Playback aborted; drop leftovers so they don't play next turn
+            while (xQueueReceive(q_playback, &chunk, 0) == pdTRUE) {
+                free_chunk(chunk.data);
             }
+            stream_active = false;
+            playback_end_of_stream = false;
+        } else if (playback_end_of_stream) {
+            // Server finished streaming and everything queued has been played
+            stream_active = false;
+            playback_end_of_stream = false;
+            tts_cache_commit();
+            set_state(CLIENT_STATE_IDLE);
+        } else if (stream_active) {
+            // Queue ran dry mid-stream
+            stream_active = false;
+            portENTER_CRITICAL(&timing_lock);
+            timing_stats.playback_underruns++;
+            portEXIT_CRITICAL(&timing_lock);
         }
     }
 
@@ -0,0 +1,147 @@
+/*
+ * HotPin Firmware - Audio Store-and-Forward
+ *
+ * Binds the spill log to the `storage` partition. Only audio_send_task
+ * appends and replays; the mutex keeps telemetry reads consistent with
+ * in-progress flash operations.
+ */
+
+#include "main.h"
+#include "audio_spill.h"
+#include "esp_partition.h"
+
+static spill_log_t spill_log;
+static bool spill_available = false;
+static audio_spill_stats_t spill_stats;
+static SemaphoreHandle_t spill_mutex = NULL;
+static StaticSemaphore_t spill_mutex_buf;
+
+static bool partition_read(void *ctx, uint32_t offset, void *dst, size_t len) {
+    return esp_partition_read((const esp_partition_t*)ctx, offset, dst, len) == ESP_OK;
+}
+
+static bool partition_write(void *ctx, uint32_t offset, const void *src, size_t len) {
+    return esp_partition_write((const esp_partition_t*)ctx, offset, src, len) == ESP_OK;
+}
+
+static bool partition_erase(void *ctx, uint32_t offset, size_t len) {
+    return esp_partition_erase_range((const esp_partition_t*)ctx, offset, len) == ESP_OK;
+}
+
+bool init_audio_spill(void) {
+#if CONFIG_HOTPIN_AUDIO_SPILL
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                           ESP_PARTITION_SUBTYPE_ANY, "storage");
+    if (!part) {
+        ESP_LOGW("SPILL", "No 'storage' partition, audio spill disabled");
+        return false;
+    }
+
+    spill_mutex = xSemaphoreCreateMutexStatic(&spill_mutex_buf);
+
+    spill_flash_t flash = {
+        .read = partition_read,
+        .write = partition_write,
+        .erase = partition_erase,
+        .ctx = (void*)part,
+        .size = part->size,
+    };
+    int64_t start_us = esp_timer_get_time();
+    if (!spill_log_open(&spill_log, &flash, CONFIG_HOTPIN_SPILL_MAX_SLOTS)) {
+        ESP_LOGE("SPILL", "Failed to open spill log on 'storage' (%"PRIu32" bytes)", part->size);
+        return false;
+    }
+
+    // Chunks left by the previous boot belong to a recording that boot
+    // never closed; replayed now they would land in this session's next one
+    uint32_t stale = spill_log_discard(&spill_log);
+    if (stale > 0) {
+        ESP_LOGW("SPILL", "Discarded %"PRIu32" chunks spilled before the reboot", stale);
+    }
+
+    spill_available = true;
+    ESP_LOGI("SPILL", "Spill log: %"PRIu32" slots of %d bytes, %"PRIu32" chunks pending, "
+             "erase count %"PRIu32"-%"PRIu32", mounted in %lld ms",
+             spill_log.slot_count, SPILL_SLOT_BYTES, spill_log.pending,
+             spill_log.stats.erase_min, spill_log.stats.erase_max,
+             (esp_timer_get_time() - start_us) / 1000);
+    return true;
+#else
+    return false;
+#endif
+}
+
+uint32_t audio_spill_pending(void) {
+    return spill_available ? spill_log.pending : 0;
+}
+
+bool audio_spill_store(uint32_t seq, const uint8_t *data, size_t len) {
+    if (!spill_available) {
+        return false;
+    }
+
+    xSemaphoreTake(spill_mutex, portMAX_DELAY);
+    uint32_t evicted_before = spill_log.stats.evicted;
+    int64_t start_us = esp_timer_get_time();
+    bool ok = spill_log_append(&spill_log, seq, data, len);
+    if (ok) {
+        spill_stats.write_bytes += len;
+        spill_stats.write_us += esp_timer_get_time() - start_us;
+    }
+    bool evicted = spill_log.stats.evicted != evicted_before;
+    xSemaphoreGive(spill_mutex);
+
+    if (!ok) {
+        ESP_LOGE("SPILL", "Failed to spill chunk %"PRIu32, seq);
+    } else if (evicted) {
+        ESP_LOGW("SPILL", "Spill log full, evicted oldest chunk");
+    }
+    return ok;
+}
+
+bool audio_spill_peek(uint32_t *seq, uint8_t *dst, size_t *len) {
+    if (!spill_available) {
+        return false;
+    }
+
+    xSemaphoreTake(spill_mutex, portMAX_DELAY);
+    int64_t start_us = esp_timer_get_time();
+    bool ok = spill_log_peek(&spill_log, seq, dst, CHUNK_BYTES, len);
+    if (ok) {
+        spill_stats.replay_bytes += *len;
+        spill_stats.replay_us += esp_timer_get_time() - start_us;
+    }
+    xSemaphoreGive(spill_mutex);
+    return ok;
+}
+
+void audio_spill_consume(void) {
+    if (!spill_available) {
+        return;
+    }
+
+    xSemaphoreTake(spill_mutex, portMAX_DELAY);
+    spill_log_consume(&spill_log);
+    bool drained = spill_log.pending == 0;
+    uint32_t replayed = spill_log.stats.replayed;
+    xSemaphoreGive(spill_mutex);
+
+    if (drained) {
+        ESP_LOGI("SPILL", "Spill log drained (%"PRIu32" chunks replayed since boot)", replayed);
+    }
+}
+
+void get_audio_spill_stats(audio_spill_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (!spill_available) {
+        return;
+    }
+
+    xSemaphoreTake(spill_mutex, portMAX_DELAY);
+    *stats = spill_stats;
+    stats->available = true;
+    stats->pending = spill_log.pending;
+    stats->capacity = spill_log.slot_count;
+    stats->log = spill_log.stats;
+    xSemaphoreGive(spill_mutex);
+}
@@ -0,0 +1,77 @@
+/*
+ * HotPin Firmware - Audio Store-and-Forward
+ *
+ * Captured chunks that cannot go out on the WebSocket (disconnected, or the
+ * outbound queue is backed up) are spilled to the `storage` flash partition
+ * and replayed in order once the uplink recovers. recording_stopped is held
+ * until the backlog has drained, so replayed chunks stay inside their
+ * recording; a backlog left by a previous boot is dropped at mount. See
+ * spill_log.h for the on-flash format.
+ */
+
+#ifndef AUDIO_SPILL_H
+#define AUDIO_SPILL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "spill_log.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Spill counters since boot, reported in telemetry
+typedef struct {
+    bool available;
+    uint32_t pending;
+    uint32_t capacity;              // Slots in the log
+    spill_log_stats_t log;
+    uint64_t write_bytes;
+    uint64_t write_us;              // Time spent in append (erase + program)
+    uint64_t replay_bytes;
+    uint64_t replay_us;             // Time spent reading records back
+} audio_spill_stats_t;
+
+/**
+ * @brief Mount the spill log on the `storage` partition
+ *
+ * @return true if spilling is available
+ */
+bool init_audio_spill(void);
+
+/**
+ * @brief Number of spilled chunks waiting to be replayed
+ */
+uint32_t audio_spill_pending(void);
+
+/**
+ * @brief Spill one captured chunk (the caller keeps ownership of data)
+ */
+bool audio_spill_store(uint32_t seq, const uint8_t *data, size_t len);
+
+/**
+ * @brief Read the oldest spilled chunk without consuming it
+ *
+ * @param seq Output: audio sequence number
+ * @param dst Output buffer of CHUNK_BYTES
+ * @param len Output: payload length
+ */
+bool audio_spill_peek(uint32_t *seq, uint8_t *dst, size_t *len);
+
+/**
+ * @brief Mark the oldest spilled chunk as sent
+ */
+void audio_spill_consume(void);
+
+/**
+ * @brief Copy the spill counters
+ */
+void get_audio_spill_stats(audio_spill_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AUDIO_SPILL_H */
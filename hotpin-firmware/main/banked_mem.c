@@ -0,0 +1,147 @@
+/*
+ * HotPin Firmware - Banked PSRAM Allocator
+ */
+
+#include "main.h"
+#include "banked_mem.h"
+#include "esp_himem.h"
+
+// PSRAM left to the heap when blocks come from the mapped region
+#define BANKED_HEAP_RESERVE_BYTES   (1024 * 1024)
+
+static bool use_himem = false;
+static uint32_t block_count = 0;
+
+// himem backend
+static esp_himem_handle_t himem_handle = NULL;
+static esp_himem_rangehandle_t himem_range = NULL;
+
+// Heap backend
+static uint8_t **heap_blocks = NULL;
+
+static bool init_himem(size_t max_bytes) {
+#if CONFIG_SPIRAM_BANKSWITCH_ENABLE
+    size_t free_bytes = esp_himem_get_free_size();
+    size_t bytes = max_bytes < free_bytes ? max_bytes : free_bytes;
+    bytes -= bytes % BANKED_BLOCK_BYTES;
+    if (bytes < 2 * BANKED_BLOCK_BYTES) {
+        return false;
+    }
+
+    if (esp_himem_alloc(bytes, &himem_handle) != ESP_OK) {
+        ESP_LOGW("BANKED", "himem alloc of %zu bytes failed", bytes);
+        return false;
+    }
+    if (esp_himem_alloc_map_range(BANKED_WINDOW_COUNT * BANKED_BLOCK_BYTES, &himem_range) != ESP_OK) {
+        ESP_LOGW("BANKED", "No himem map range (CONFIG_SPIRAM_BANKSWITCH_RESERVE too small?)");
+        esp_himem_free(himem_handle);
+        himem_handle = NULL;
+        return false;
+    }
+
+    block_count = bytes / BANKED_BLOCK_BYTES;
+    use_himem = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+static bool init_heap(size_t max_bytes) {
+    size_t free_bytes = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    size_t usable = free_bytes > BANKED_HEAP_RESERVE_BYTES ? free_bytes - BANKED_HEAP_RESERVE_BYTES : 0;
+    uint32_t wanted = (max_bytes < usable ? max_bytes : usable) / BANKED_BLOCK_BYTES;
+    if (wanted < 2) {
+        return false;
+    }
+
+    heap_blocks = heap_caps_calloc(wanted, sizeof(uint8_t*), MALLOC_CAP_SPIRAM);
+    if (!heap_blocks) {
+        return false;
+    }
+    while (block_count < wanted) {
+        heap_blocks[block_count] = heap_caps_malloc(BANKED_BLOCK_BYTES, MALLOC_CAP_SPIRAM);
+        if (!heap_blocks[block_count]) {
+            break;
+        }
+        block_count++;
+    }
+    if (block_count >= 2) {
+        return true;
+    }
+
+    // One block cannot give the writer and reader a window each
+    while (block_count > 0) {
+        heap_caps_free(heap_blocks[--block_count]);
+    }
+    heap_caps_free(heap_blocks);
+    heap_blocks = NULL;
+    return false;
+}
+
+bool banked_mem_init(size_t max_bytes) {
+    if (block_count > 0) {
+        return true;
+    }
+
+    if (init_himem(max_bytes) || init_heap(max_bytes)) {
+        ESP_LOGI("BANKED", "Reserved %"PRIu32" x %d KB blocks in %s", block_count,
+                 BANKED_BLOCK_BYTES / 1024, use_himem ? "himem (bank-switched)" : "mapped PSRAM");
+        return true;
+    }
+
+    ESP_LOGW("BANKED", "No banked memory available");
+    return false;
+}
+
+uint32_t banked_mem_block_count(void) {
+    return block_count;
+}
+
+bool banked_mem_is_himem(void) {
+    return use_himem;
+}
+
+void banked_window_init(banked_window_t *window, int index) {
+    window->index = index;
+    window->block = -1;
+    window->ptr = NULL;
+    window->switches = 0;
+}
+
+uint8_t* banked_window_map(banked_window_t *window, uint32_t block) {
+    if (block >= block_count) {
+        return NULL;
+    }
+    if (window->block == (int32_t)block) {
+        return window->ptr;
+    }
+
+    if (!use_himem) {
+        window->block = block;
+        window->ptr = heap_blocks[block];
+        return window->ptr;
+    }
+
+#if CONFIG_SPIRAM_BANKSWITCH_ENABLE
+    uint32_t start = perf_begin();
+    if (window->ptr) {
+        esp_himem_unmap(himem_range, window->ptr, BANKED_BLOCK_BYTES);
+        window->ptr = NULL;
+        window->block = -1;
+    }
+    void *ptr = NULL;
+    if (esp_himem_map(himem_handle, himem_range, (size_t)block * BANKED_BLOCK_BYTES,
+                      (size_t)window->index * BANKED_BLOCK_BYTES, BANKED_BLOCK_BYTES, 0, &ptr) != ESP_OK) {
+        ESP_LOGE("BANKED", "Failed to map block %"PRIu32, block);
+        return NULL;
+    }
+    perf_end(PERF_BANK_SWITCH, start);
+    window->block = block;
+    window->ptr = ptr;
+    window->switches++;
+    return window->ptr;
+#else
+    return NULL;
+#endif
+}
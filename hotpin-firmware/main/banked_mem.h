@@ -0,0 +1,67 @@
+/*
+ * HotPin Firmware - Banked PSRAM Allocator
+ *
+ * Fixed-size blocks of PSRAM that are only reachable through a window.
+ * With himem (CONFIG_SPIRAM_BANKSWITCH_ENABLE, 8 MB modules) the blocks sit
+ * above the 4 MB mapped region and a window is a 32 KB bank that is
+ * remapped on demand. Without himem, blocks are allocated from the mapped
+ * PSRAM heap and "mapping" a block is free.
+ */
+
+#ifndef BANKED_MEM_H
+#define BANKED_MEM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BANKED_BLOCK_BYTES      (32 * 1024)  // ESP_HIMEM_BLKSZ
+#define BANKED_WINDOW_COUNT     2            // Banks reserved from the map range
+
+// One mapping window; each concurrent user owns one
+typedef struct {
+    int index;              // Bank within the map range (0..BANKED_WINDOW_COUNT-1)
+    int32_t block;          // Block currently mapped, -1 if none
+    uint8_t *ptr;
+    uint32_t switches;      // Remaps performed through this window
+} banked_window_t;
+
+/**
+ * @brief Reserve up to max_bytes of banked memory
+ *
+ * @return true if at least two blocks were reserved
+ */
+bool banked_mem_init(size_t max_bytes);
+
+/**
+ * @brief Number of blocks reserved by banked_mem_init()
+ */
+uint32_t banked_mem_block_count(void);
+
+/**
+ * @brief true if blocks live in himem, false if in the mapped PSRAM heap
+ */
+bool banked_mem_is_himem(void);
+
+/**
+ * @brief Prepare a window for use (no mapping yet)
+ */
+void banked_window_init(banked_window_t *window, int index);
+
+/**
+ * @brief Address of a block through a window, remapping if needed
+ *
+ * The pointer stays valid until the next call on the same window.
+ * Remap time is recorded in the PERF_BANK_SWITCH cycle counter.
+ */
+uint8_t* banked_window_map(banked_window_t *window, uint32_t block);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BANKED_MEM_H */
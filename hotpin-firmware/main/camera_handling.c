@@ -8,6 +8,8 @@
 // Include camera header if available
 #include "camera.h"
 #include "esp_camera.h"
+#include "runtime_config.h"
+#include "ws_mux.h"
 #endif
 
 extern TaskHandle_t camera_task_handle;
@@ -17,18 +19,18 @@ extern TaskHandle_t camera_task_handle;
 void camera_task(void *pvParameters) {
     camera_task_handle = xTaskGetCurrentTaskHandle();
     
-    while (current_state != CLIENT_STATE_SHUTDOWN) {
+    while (get_state() != CLIENT_STATE_SHUTDOWN) {
         // Wait for notification to capture image
         ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
         
-        if (current_state != CLIENT_STATE_CAMERA_CAPTURE) {
+        if (get_state() != CLIENT_STATE_CAMERA_CAPTURE) {
             continue; // Don't capture if not in camera capture state
         }
 
         ESP_LOGI("CAMERA", "Starting camera capture sequence");
 
         // If currently recording, stop and clean up I2S
-        if (current_state == CLIENT_STATE_RECORDING) {
+        if (get_state() == CLIENT_STATE_RECORDING) {
             set_state(CLIENT_STATE_PROCESSING);
             
             // Small delay to allow audio tasks to clean up
@@ -44,6 +46,11 @@ void camera_task(void *pvParameters) {
         vTaskDelay(pdMS_TO_TICKS(50));
 
 #ifdef CONFIG_CAMERA_MODEL_AI_THINKER
+        // The camera is set up for every photo, so a new quality from the server
+        // applies to the next one
+        runtime_config_t settings;
+        runtime_config_get(&settings);
+
         // Camera configuration
         camera_config_t config = {
             .pin_pwdn = PWDN_GPIO_NUM,
@@ -70,7 +77,7 @@ void camera_task(void *pvParameters) {
 
             .pixel_format = PIXFORMAT_JPEG, // JPEG for smaller size
             .frame_size = FRAMESIZE_VGA,    // 640x480, adjust as needed
-            .jpeg_quality = 12,             // 0-63, smaller number = higher quality
+            .jpeg_quality = settings.jpeg_quality, // 0-63, smaller number = higher quality
             .fb_count = 1                   // Use PSRAM if available
         };
 
@@ -204,7 +211,27 @@ void camera_task(void *pvParameters) {
     vTaskDelete(NULL);
 }
 
+// Mux sessions: the image goes in slices on its own channel, behind any
+// control message, instead of over a second connection
+static bool send_image_on_channel(const uint8_t *image_data, size_t image_len) {
+    // The frame buffer goes back to the driver before the upload finishes
+    uint8_t *copy = heap_caps_malloc(image_len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!copy) {
+        copy = malloc(image_len);
+    }
+    if (!copy) {
+        ESP_LOGE("CAMERA", "No memory to queue a %zu byte image", image_len);
+        return false;
+    }
+    memcpy(copy, image_data, image_len);
+    return ws_send_bulk(WS_MUX_IMAGE, copy, image_len);
+}
+
 bool upload_image_to_server(uint8_t *image_data, size_t image_len) {
+    if (ws_mux_enabled()) {
+        return send_image_on_channel(image_data, image_len);
+    }
+
     char task_url[256];
     snprintf(task_url, sizeof(task_url), "%s/image?session=%s", 
              HOTPIN_WS_URL, SESSION_ID);
@@ -250,10 +277,10 @@ void camera_task(void *pvParameters) {
     ESP_LOGW("CAMERA", "Camera task started but camera is disabled");
     
     // Send error to server when camera capture is requested but not available
-    while (current_state != CLIENT_STATE_SHUTDOWN) {
+    while (get_state() != CLIENT_STATE_SHUTDOWN) {
         ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
         
-        if (current_state == CLIENT_STATE_CAMERA_CAPTURE) {
+        if (get_state() == CLIENT_STATE_CAMERA_CAPTURE) {
             // Send error to server
             cJSON *json = cJSON_CreateObject();
             cJSON_AddStringToObject(json, "type", "error");
@@ -0,0 +1,331 @@
+/*
+ * HotPin Firmware - Elastic Audio Chunk Pool
+ *
+ * All chunks, static or slab, circulate through q_free_chunks. Growth runs
+ * in the allocating task (a PSRAM allocation of one slab, no zeroing);
+ * shrinking runs from a periodic esp_timer and only reclaims a slab once
+ * every one of its chunks is back in the free queue.
+ *
+ * Live capture frames shorter than half a chunk are carved one after another
+ * from a shared chunk, so a 20 ms frame does not hold 16 KB. A shared chunk
+ * goes back to the free queue once every frame cut from it has been freed
+ * and the capture task has moved on to the next one.
+ */
+
+#include "main.h"
+#include "memory_plan.h"
+#include "chunk_pool.h"
+#include "esp_timer.h"
+
+#define POOL_SLAB_BYTES             (POOL_SLAB_CHUNKS * CHUNK_BYTES)
+#define POOL_MAINTENANCE_PERIOD_MS  1000
+#define SHARED_CHUNK_SLOTS          16      // Chunks with frames in flight at once
+
+typedef struct {
+    uint8_t *base;          // NULL if the slot is unused
+    uint32_t refs;          // Frames not yet freed, plus one while being carved
+} shared_chunk_t;
+
+static uint8_t *slabs[POOL_MAX_SLABS];
+static chunk_pool_stats_t pool_stats;
+static bool pool_growing = false;
+static bool pool_reclaiming = false;
+static uint32_t pool_idle_ms = 0;
+static portMUX_TYPE pool_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t pool_maintenance_timer = NULL;
+
+// Scratch for draining q_free_chunks during reclaim (timer task only)
+static uint8_t *reclaim_scratch[CHUNK_POOL_CAPACITY];
+
+static shared_chunk_t shared_chunks[SHARED_CHUNK_SLOTS];
+static uint32_t shared_in_use = 0;
+static shared_chunk_t *carving = NULL;     // Capture task only
+static size_t carve_offset = 0;
+
+static void chunk_pool_grow(void) {
+    if (!psram_available) {
+        return;
+    }
+
+    portENTER_CRITICAL(&pool_lock);
+    if (pool_growing || pool_reclaiming || pool_stats.slab_count >= POOL_MAX_SLABS) {
+        if (pool_stats.slab_count >= POOL_MAX_SLABS) {
+            pool_stats.grow_failures++;
+        }
+        portEXIT_CRITICAL(&pool_lock);
+        return;
+    }
+    pool_growing = true;
+    portEXIT_CRITICAL(&pool_lock);
+
+    uint8_t *slab = (uint8_t*)heap_caps_malloc(POOL_SLAB_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+
+    portENTER_CRITICAL(&pool_lock);
+    if (slab) {
+        slabs[pool_stats.slab_count++] = slab;
+        pool_stats.total_chunks += POOL_SLAB_CHUNKS;
+        pool_stats.grow_events++;
+        if (pool_stats.slab_count > pool_stats.peak_slabs) {
+            pool_stats.peak_slabs = pool_stats.slab_count;
+        }
+    } else {
+        pool_stats.grow_failures++;
+    }
+    uint32_t slab_count = pool_stats.slab_count;
+    uint32_t total = pool_stats.total_chunks;
+    portEXIT_CRITICAL(&pool_lock);
+
+    if (!slab) {
+        ESP_LOGW("POOL", "Slab allocation failed (%d bytes PSRAM)", POOL_SLAB_BYTES);
+    } else {
+        for (int i = 0; i < POOL_SLAB_CHUNKS; i++) {
+            uint8_t *chunk_ptr = slab + (i * CHUNK_BYTES);
+            xQueueSend(q_free_chunks, &chunk_ptr, 0);
+        }
+        ESP_LOGI("POOL", "Grew pool: slab %"PRIu32"/%d, %"PRIu32" chunks total",
+                 slab_count, POOL_MAX_SLABS, total);
+    }
+
+    portENTER_CRITICAL(&pool_lock);
+    pool_growing = false;
+    portEXIT_CRITICAL(&pool_lock);
+}
+
+// Return the newest slab to the heap if all of its chunks are free
+static void chunk_pool_reclaim_slab(void) {
+    portENTER_CRITICAL(&pool_lock);
+    if (pool_growing || pool_stats.slab_count == 0) {
+        portEXIT_CRITICAL(&pool_lock);
+        return;
+    }
+    pool_reclaiming = true;
+    uint8_t *slab = slabs[pool_stats.slab_count - 1];
+    portEXIT_CRITICAL(&pool_lock);
+
+    // Pull every free chunk, then put back all but the ones in this slab
+    int drained = 0;
+    while (drained < CHUNK_POOL_CAPACITY &&
+           xQueueReceive(q_free_chunks, &reclaim_scratch[drained], 0) == pdTRUE) {
+        drained++;
+    }
+
+    int in_slab = 0;
+    for (int i = 0; i < drained; i++) {
+        if (reclaim_scratch[i] >= slab && reclaim_scratch[i] < slab + POOL_SLAB_BYTES) {
+            in_slab++;
+        }
+    }
+
+    bool release = (in_slab == POOL_SLAB_CHUNKS);
+    for (int i = 0; i < drained; i++) {
+        bool ours = reclaim_scratch[i] >= slab && reclaim_scratch[i] < slab + POOL_SLAB_BYTES;
+        if (!release || !ours) {
+            xQueueSend(q_free_chunks, &reclaim_scratch[i], 0);
+        }
+    }
+
+    portENTER_CRITICAL(&pool_lock);
+    if (release) {
+        slabs[--pool_stats.slab_count] = NULL;
+        pool_stats.total_chunks -= POOL_SLAB_CHUNKS;
+        pool_stats.shrink_events++;
+    }
+    uint32_t slab_count = pool_stats.slab_count;
+    uint32_t total = pool_stats.total_chunks;
+    pool_reclaiming = false;
+    portEXIT_CRITICAL(&pool_lock);
+
+    if (release) {
+        heap_caps_free(slab);
+        ESP_LOGI("POOL", "Shrank pool: %"PRIu32" slabs, %"PRIu32" chunks total", slab_count, total);
+    }
+}
+
+static void pool_maintenance_cb(void *arg) {
+    UBaseType_t free_now = uxQueueMessagesWaiting(q_free_chunks);
+
+    portENTER_CRITICAL(&pool_lock);
+    bool idle = (free_now == pool_stats.total_chunks);
+    pool_idle_ms = idle ? pool_idle_ms + POOL_MAINTENANCE_PERIOD_MS : 0;
+    bool shrink = pool_stats.slab_count > 0 && pool_idle_ms >= CONFIG_HOTPIN_POOL_SHRINK_IDLE_MS;
+    portEXIT_CRITICAL(&pool_lock);
+
+    // Audio is streaming in these states even when the pool is momentarily full
+    client_state_t state = get_state();
+    if (shrink && state != CLIENT_STATE_RECORDING && state != CLIENT_STATE_PLAYING) {
+        chunk_pool_reclaim_slab();  // One slab per period while idle
+    }
+}
+
+bool init_chunk_pool() {
+    // The base pool is statically placed by memory_plan.c (PSRAM or internal DMA RAM)
+    chunk_pool = memory_plan_chunk_pool(&pool_size);
+    ESP_LOGI("POOL", "Chunk pool: %d x %d bytes (%s), up to %d PSRAM slabs of %d chunks",
+             pool_size, CHUNK_BYTES, CHUNK_POOL_IN_PSRAM ? "PSRAM" : "internal RAM",
+             POOL_MAX_SLABS, POOL_SLAB_CHUNKS);
+
+    // Initialize the free chunks queue with pointers to each chunk
+    for (int i = 0; i < pool_size; i++) {
+        uint8_t *chunk_ptr = chunk_pool + (i * CHUNK_BYTES);
+        if (xQueueSend(q_free_chunks, &chunk_ptr, 0) != pdTRUE) {
+            ESP_LOGE("POOL", "Failed to add chunk %d to free queue", i);
+            return false;
+        }
+    }
+
+    portENTER_CRITICAL(&pool_lock);
+    pool_stats.base_chunks = pool_size;
+    pool_stats.total_chunks = pool_size;
+    pool_stats.min_free = pool_size;
+    portEXIT_CRITICAL(&pool_lock);
+
+    if (!pool_maintenance_timer) {
+        const esp_timer_create_args_t args = {
+            .callback = pool_maintenance_cb,
+            .name = "pool_maint",
+        };
+        if (esp_timer_create(&args, &pool_maintenance_timer) != ESP_OK) {
+            ESP_LOGW("POOL", "Failed to create pool maintenance timer, slabs will not shrink");
+            return true;
+        }
+        esp_timer_start_periodic(pool_maintenance_timer, (uint64_t)POOL_MAINTENANCE_PERIOD_MS * 1000);
+    }
+
+    return true;
+}
+
+uint8_t* HOT_PATH_ATTR alloc_chunk() {
+    uint32_t start = perf_begin();
+    uint8_t *buf = NULL;
+    if (xQueueReceive(q_free_chunks, &buf, 0) != pdTRUE) {
+        // Pool empty: grow now, or wait out a reclaim that holds the free chunks
+        chunk_pool_grow();
+        if (xQueueReceive(q_free_chunks, &buf, pdMS_TO_TICKS(10)) != pdTRUE) {
+            portENTER_CRITICAL(&pool_lock);
+            pool_stats.exhausted++;
+            pool_stats.min_free = 0;
+            portEXIT_CRITICAL(&pool_lock);
+            ESP_LOGW("ALLOC", "No free chunks available in pool");
+            return NULL;
+        }
+    }
+
+    UBaseType_t free_now = uxQueueMessagesWaiting(q_free_chunks);
+    portENTER_CRITICAL(&pool_lock);
+    if (free_now < pool_stats.min_free) {
+        pool_stats.min_free = free_now;
+    }
+    portEXIT_CRITICAL(&pool_lock);
+
+    // Grow ahead of exhaustion so the capture path never sees an empty pool
+    if (free_now < POOL_LOW_WATERMARK) {
+        chunk_pool_grow();
+    }
+
+    perf_end(PERF_CHUNK_ALLOC, start);
+    return buf;
+}
+
+// A frame of a shared chunk drops one reference and yields the chunk once
+// the last one goes; anything else is a whole chunk
+static uint8_t* HOT_PATH_ATTR unshare(uint8_t *buf) {
+    portENTER_CRITICAL(&pool_lock);
+    for (int i = 0; shared_in_use > 0 && i < SHARED_CHUNK_SLOTS; i++) {
+        shared_chunk_t *shared = &shared_chunks[i];
+        if (shared->base && buf >= shared->base && buf < shared->base + CHUNK_BYTES) {
+            buf = NULL;
+            if (--shared->refs == 0) {
+                buf = shared->base;
+                shared->base = NULL;
+                shared_in_use--;
+            }
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&pool_lock);
+    return buf;
+}
+
+uint8_t* alloc_frame(size_t len) {
+    len = (len + 3) & ~(size_t)3;
+    if (len * 2 > CHUNK_BYTES) {
+        return alloc_chunk();   // Fewer than two per chunk: nothing to share
+    }
+    if (carving && carve_offset + len > CHUNK_BYTES) {
+        chunk_pool_close_frames();
+    }
+
+    if (!carving) {
+        uint8_t *base = alloc_chunk();
+        if (!base) {
+            return NULL;
+        }
+        portENTER_CRITICAL(&pool_lock);
+        for (int i = 0; i < SHARED_CHUNK_SLOTS; i++) {
+            if (!shared_chunks[i].base) {
+                shared_chunks[i] = (shared_chunk_t){ .base = base, .refs = 1 };
+                shared_in_use++;
+                carving = &shared_chunks[i];
+                break;
+            }
+        }
+        portEXIT_CRITICAL(&pool_lock);
+        if (!carving) {
+            return base;        // Every slot has frames in flight: a whole chunk
+        }
+        carve_offset = 0;
+    }
+
+    portENTER_CRITICAL(&pool_lock);
+    carving->refs++;
+    pool_stats.carved_frames++;
+    portEXIT_CRITICAL(&pool_lock);
+    uint8_t *frame = carving->base + carve_offset;
+    carve_offset += len;
+    return frame;
+}
+
+void chunk_pool_close_frames(void) {
+    if (carving) {
+        uint8_t *base = carving->base;
+        carving = NULL;
+        free_chunk(base);       // Drops the carving reference
+    }
+}
+
+void HOT_PATH_ATTR free_chunk(uint8_t *buf) {
+    if (buf) {
+        buf = unshare(buf);
+    }
+    if (buf) {
+        if (xQueueSend(q_free_chunks, &buf, 0) != pdTRUE) {
+            // Queue full, should not happen if pool is properly managed
+            ESP_LOGE("FREE", "Failed to return chunk to pool");
+        }
+    }
+}
+
+void chunk_pool_note_eviction(void) {
+    portENTER_CRITICAL(&pool_lock);
+    pool_stats.capture_evictions++;
+    portEXIT_CRITICAL(&pool_lock);
+}
+
+void get_chunk_pool_stats(chunk_pool_stats_t *stats) {
+    UBaseType_t free_now = q_free_chunks ? uxQueueMessagesWaiting(q_free_chunks) : 0;
+    portENTER_CRITICAL(&pool_lock);
+    *stats = pool_stats;
+    stats->free_chunks = free_now;
+    portEXIT_CRITICAL(&pool_lock);
+}
+
+void log_chunk_pool_stats(void) {
+    chunk_pool_stats_t stats;
+    get_chunk_pool_stats(&stats);
+    ESP_LOGI("POOL", "Pool: %"PRIu32" chunks (%"PRIu32" slabs, peak %"PRIu32"), min free %"PRIu32,
+             stats.total_chunks, stats.slab_count, stats.peak_slabs, stats.min_free);
+    ESP_LOGI("POOL", "  grow %"PRIu32"  shrink %"PRIu32"  grow failures %"PRIu32"  exhausted %"PRIu32"  capture evictions %"PRIu32,
+             stats.grow_events, stats.shrink_events, stats.grow_failures, stats.exhausted,
+             stats.capture_evictions);
+    ESP_LOGI("POOL", "  frames carved from shared chunks %"PRIu32, stats.carved_frames);
+}
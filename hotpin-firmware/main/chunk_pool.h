@@ -0,0 +1,80 @@
+/*
+ * HotPin Firmware - Elastic Audio Chunk Pool
+ *
+ * The static base pool (memory_plan.c) is extended with PSRAM slabs of
+ * CONFIG_HOTPIN_POOL_SLAB_CHUNKS chunks when the free count drops below the
+ * low watermark, and slabs are returned to the heap after the pool has been
+ * fully idle for CONFIG_HOTPIN_POOL_SHRINK_IDLE_MS. Short capture frames
+ * share chunks (alloc_frame()).
+ */
+
+#ifndef CHUNK_POOL_H
+#define CHUNK_POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define POOL_SLAB_CHUNKS        CONFIG_HOTPIN_POOL_SLAB_CHUNKS
+#define POOL_MAX_SLABS          CONFIG_HOTPIN_POOL_MAX_SLABS
+#define POOL_LOW_WATERMARK      CONFIG_HOTPIN_POOL_LOW_WATERMARK
+
+// Largest number of chunks the pool can hold (sizes q_free_chunks)
+#define CHUNK_POOL_CAPACITY     (CHUNK_POOL_COUNT + POOL_MAX_SLABS * POOL_SLAB_CHUNKS)
+
+// Pool counters since boot, reported in telemetry
+typedef struct {
+    uint32_t base_chunks;       // Static chunks
+    uint32_t slab_count;        // PSRAM slabs currently allocated
+    uint32_t total_chunks;      // base_chunks + slab_count * POOL_SLAB_CHUNKS
+    uint32_t free_chunks;
+    uint32_t min_free;          // Lowest free count seen
+    uint32_t peak_slabs;
+    uint32_t grow_events;
+    uint32_t shrink_events;
+    uint32_t grow_failures;     // PSRAM allocation failed or POOL_MAX_SLABS reached
+    uint32_t exhausted;         // alloc_chunk() returned NULL
+    uint32_t capture_evictions; // Oldest unsent capture chunk recycled on exhaustion
+    uint32_t carved_frames;     // Frames cut from shared chunks by alloc_frame()
+} chunk_pool_stats_t;
+
+/**
+ * @brief Buffer for one capture frame of len bytes, freed with free_chunk()
+ *
+ * Frames shorter than half a chunk are cut one after another from a shared
+ * chunk; longer ones get a chunk of their own. Capture task only.
+ *
+ * @return NULL if the pool is exhausted
+ */
+uint8_t* alloc_frame(size_t len);
+
+/**
+ * @brief Stop carving the current shared chunk, so it returns to the pool
+ *        once its frames have been freed. Capture task only.
+ */
+void chunk_pool_close_frames(void);
+
+/**
+ * @brief Copy the pool counters
+ */
+void get_chunk_pool_stats(chunk_pool_stats_t *stats);
+
+/**
+ * @brief Count one capture chunk recycled to keep recording on exhaustion
+ */
+void chunk_pool_note_eviction(void);
+
+/**
+ * @brief Log the pool counters
+ */
+void log_chunk_pool_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CHUNK_POOL_H */
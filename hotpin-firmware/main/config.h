@@ -14,6 +14,7 @@
 // WebSocket Configuration
 #define WEBSOCKET_URL "ws://10.89.246.235:8000/ws"
 #define WEBSOCKET_TOKEN "mysecrettoken123"
+#define WEBSOCKET_FALLBACK_URLS ""
 
 // Audio Configuration
 #define CHUNK_SIZE_BYTES 16000
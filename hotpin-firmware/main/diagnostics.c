@@ -0,0 +1,313 @@
+/*
+ * HotPin Firmware - On-Device Diagnostics
+ *
+ * Binds the self-test run loop to the device. I2S is installed here rather
+ * than through the state effect task: loopback needs RX and TX at once,
+ * which no other state uses, and the driver's event queue is the only
+ * place DMA overruns and underruns are reported. The IDLE -> SELF_TEST
+ * transition releases I2S first, and the driver is uninstalled again
+ * before going back to IDLE, where the state effect task parks it as usual.
+ */
+
+#include "main.h"
+#include "diagnostics.h"
+#include "session_profile.h"
+#include "esp_timer.h"
+
+#define SELFTEST_QUEUE_LEN      (SELFTEST_QUEUE_TARGET + 2)
+#define SELFTEST_EVENT_QUEUE_LEN 8
+#define SELFTEST_PING_BLOCKS    4   // One WebSocket ping every ~256 ms
+#define SELFTEST_JSON_BYTES     1024
+
+typedef struct {
+    QueueHandle_t blocks;
+    QueueHandle_t i2s_events;
+    uint32_t pings;
+} selftest_device_t;
+
+static portMUX_TYPE selftest_lock = portMUX_INITIALIZER_UNLOCKED;
+static selftest_mode_t requested_mode = SELFTEST_LOOPBACK;
+static uint32_t requested_duration_ms = SELFTEST_DEFAULT_DURATION_MS;
+static bool running = false;
+static selftest_stage_stats_t ws_rtt;    // Pongs arrive on the dispatcher task
+
+static DMA_ATTR int16_t read_scratch[SELFTEST_BLOCK_SAMPLES];
+static selftest_report_t report;
+static char report_json[SELFTEST_JSON_BYTES];
+
+static StaticQueue_t block_queue_storage;
+static uint8_t block_queue_buffer[SELFTEST_QUEUE_LEN * sizeof(selftest_block_t)];
+
+bool selftest_request(selftest_mode_t mode, uint32_t duration_ms) {
+    if (get_state() != CLIENT_STATE_IDLE || (unsigned)mode >= SELFTEST_MODE_COUNT) {
+        return false;
+    }
+    if (!session_feature_enabled(SESSION_FEATURE_SELFTEST)) {
+        ESP_LOGW("SELFTEST", "Self-test is disabled for this session");
+        return false;
+    }
+    portENTER_CRITICAL(&selftest_lock);
+    requested_mode = mode;
+    requested_duration_ms = duration_ms ? duration_ms : SELFTEST_DEFAULT_DURATION_MS;
+    portEXIT_CRITICAL(&selftest_lock);
+
+    set_state(CLIENT_STATE_SELF_TEST);
+    return get_state() == CLIENT_STATE_SELF_TEST;
+}
+
+void selftest_note_pong(int64_t sent_us) {
+    int64_t rtt_us = esp_timer_get_time() - sent_us;
+    if (sent_us <= 0 || rtt_us < 0) {
+        return;
+    }
+    portENTER_CRITICAL(&selftest_lock);
+    if (running) {
+        ws_rtt.count++;
+        ws_rtt.total_us += (uint64_t)rtt_us;
+        if ((uint32_t)rtt_us > ws_rtt.max_us) {
+            ws_rtt.max_us = (uint32_t)rtt_us;
+        }
+    }
+    portEXIT_CRITICAL(&selftest_lock);
+}
+
+static int64_t device_now_us(void *ctx) {
+    return esp_timer_get_time();
+}
+
+static bool device_i2s_read(void *ctx, int16_t *pcm, size_t samples) {
+    size_t want = samples * sizeof(int16_t);
+    size_t got = 0;
+    esp_err_t err = ESP_ERR_INVALID_STATE;
+    if (xSemaphoreTake(i2s_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+        return false;
+    }
+    if (audio_i2s_initialized) {
+        err = i2s_read(I2S_PORT, pcm, want, &got, pdMS_TO_TICKS(200));
+    }
+    xSemaphoreGive(i2s_mutex);
+    return err == ESP_OK && got == want;
+}
+
+static bool device_i2s_write(void *ctx, const int16_t *pcm, size_t samples) {
+    size_t want = samples * sizeof(int16_t);
+    size_t written = 0;
+    esp_err_t err = ESP_ERR_INVALID_STATE;
+    if (xSemaphoreTake(i2s_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+        return false;
+    }
+    if (audio_i2s_initialized) {
+        err = i2s_write(I2S_PORT, pcm, want, &written, pdMS_TO_TICKS(200));
+    }
+    xSemaphoreGive(i2s_mutex);
+    return err == ESP_OK && written == want;
+}
+
+static uint8_t* device_alloc(void *ctx) {
+    return alloc_chunk();
+}
+
+static void device_release(void *ctx, uint8_t *chunk) {
+    free_chunk(chunk);
+}
+
+static bool device_enqueue(void *ctx, const selftest_block_t *block) {
+    selftest_device_t *dev = ctx;
+    return xQueueSend(dev->blocks, block, 0) == pdTRUE;
+}
+
+static bool device_dequeue(void *ctx, selftest_block_t *block) {
+    selftest_device_t *dev = ctx;
+    return xQueueReceive(dev->blocks, block, 0) == pdTRUE;
+}
+
+static void send_ping(void) {
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddStringToObject(json, "type", "ping");
+    cJSON_AddNumberToObject(json, "t", (double)esp_timer_get_time());
+    ws_send_json(json);
+}
+
+static void device_on_block(void *ctx, selftest_report_t *r) {
+    selftest_device_t *dev = ctx;
+    i2s_event_t event;
+    while (xQueueReceive(dev->i2s_events, &event, 0) == pdTRUE) {
+        if (event.type == I2S_EVENT_RX_Q_OVF) {
+            r->rx_overruns++;
+        } else if (event.type == I2S_EVENT_TX_Q_OVF && r->tx_samples > 0) {
+            // The TX ring runs dry before the first write by design
+            r->tx_underruns++;
+        }
+    }
+    if (++dev->pings % SELFTEST_PING_BLOCKS == 0) {
+        send_ping();
+    }
+}
+
+static bool device_should_stop(void *ctx) {
+    return get_state() != CLIENT_STATE_SELF_TEST;
+}
+
+static bool install_selftest_i2s(selftest_mode_t mode, QueueHandle_t *events) {
+    const bool rx = mode != SELFTEST_PLAYBACK;
+    const bool tx = mode != SELFTEST_CAPTURE;
+    i2s_config_t i2s_config = {
+        .mode = I2S_MODE_MASTER | (rx ? I2S_MODE_RX : 0) | (tx ? I2S_MODE_TX : 0),
+        .sample_rate = SAMPLE_RATE,
+        .bits_per_sample = BITS_PER_SAMPLE,
+        .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
+        .communication_format = I2S_COMM_FORMAT_STAND_I2S,
+        .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
+        .dma_buf_count = I2S_DMA_BUF_COUNT,
+        .dma_buf_len = I2S_DMA_BUF_LEN,
+        .use_apll = false,
+        .tx_desc_auto_clear = true,
+        .fixed_mclk = 0,
+        .mclk_multiple = I2S_MCLK_MULTIPLE_128,
+        .bits_per_chan = I2S_BITS_PER_CHAN_DEFAULT
+    };
+    i2s_pin_config_t pin_config = {
+        .bck_io_num = GPIO_BCLK,
+        .ws_io_num = GPIO_LRCLK,
+        .data_out_num = tx ? GPIO_DAC_SD : -1,
+        .data_in_num = rx ? GPIO_MIC_SD : -1
+    };
+
+    // Normally a no-op: the transition into SELF_TEST released I2S
+    uninstall_i2s();
+
+    bool ok = false;
+    if (xSemaphoreTake(i2s_mutex, pdMS_TO_TICKS(5000)) != pdTRUE) {
+        return false;
+    }
+    esp_err_t err = i2s_driver_install(I2S_PORT, &i2s_config, SELFTEST_EVENT_QUEUE_LEN, events);
+    if (err == ESP_OK) {
+        err = i2s_set_pin(I2S_PORT, &pin_config);
+        if (err == ESP_OK) {
+            audio_i2s_initialized = true;
+            ok = true;
+        } else {
+            i2s_driver_uninstall(I2S_PORT);
+        }
+    }
+    xSemaphoreGive(i2s_mutex);
+    if (!ok) {
+        ESP_LOGE("SELFTEST", "Failed to configure I2S: %s", esp_err_to_name(err));
+    }
+    return ok;
+}
+
+// Idle-task run time per core; the run-time counter is esp_timer based
+static void idle_run_time(configRUN_TIME_COUNTER_TYPE idle[2]) {
+    for (int core = 0; core < 2; core++) {
+        idle[core] = ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(core));
+    }
+}
+
+static void send_report(void) {
+    size_t len = selftest_report_json(&report, report_json, sizeof(report_json));
+    cJSON *json = len ? cJSON_Parse(report_json) : NULL;
+    if (!json) {
+        ESP_LOGE("SELFTEST", "Failed to build the report");
+        return;
+    }
+    cJSON_AddStringToObject(json, "session", SESSION_ID);
+    if (!ws_send_json(json)) {
+        ESP_LOGW("SELFTEST", "Report not sent, server unreachable");
+    }
+}
+
+static void run_selftest(selftest_device_t *dev) {
+    portENTER_CRITICAL(&selftest_lock);
+    selftest_mode_t mode = requested_mode;
+    uint32_t duration_ms = requested_duration_ms;
+    memset(&ws_rtt, 0, sizeof(ws_rtt));
+    running = true;
+    portEXIT_CRITICAL(&selftest_lock);
+
+    ESP_LOGI("SELFTEST", "Starting %s self-test for %"PRIu32" ms", selftest_mode_name(mode), duration_ms);
+    xQueueReset(dev->blocks);
+    dev->pings = 0;
+
+    if (!install_selftest_i2s(mode, &dev->i2s_events)) {
+        memset(&report, 0, sizeof(report));
+        report.mode = mode;
+        report.sample_rate = SAMPLE_RATE;
+        report.duration_ms = duration_ms;
+        report.io_errors = 1;
+        report.aborted = true;
+        report.cpu_permille[0] = report.cpu_permille[1] = -1;
+    } else {
+        const selftest_platform_t platform = {
+            .now_us = device_now_us,
+            .i2s_read = device_i2s_read,
+            .i2s_write = device_i2s_write,
+            .alloc = device_alloc,
+            .release = device_release,
+            .enqueue = device_enqueue,
+            .dequeue = device_dequeue,
+            .on_block = device_on_block,
+            .should_stop = device_should_stop,
+            .ctx = dev,
+            .scratch = read_scratch,
+            .sample_rate = SAMPLE_RATE,
+        };
+
+        configRUN_TIME_COUNTER_TYPE idle_before[2];
+        configRUN_TIME_COUNTER_TYPE idle_after[2];
+        idle_run_time(idle_before);
+        int64_t start_us = esp_timer_get_time();
+        selftest_run(&platform, mode, duration_ms, &report);
+        int64_t window_us = esp_timer_get_time() - start_us;
+        idle_run_time(idle_after);
+
+        // Let the last pong come back before the totals are taken
+        vTaskDelay(pdMS_TO_TICKS(200));
+        uninstall_i2s();
+
+        for (int core = 0; core < 2 && window_us > 0; core++) {
+            uint64_t idle_permille = (uint64_t)(idle_after[core] - idle_before[core]) * 1000 / (uint64_t)window_us;
+            report.cpu_permille[core] = idle_permille > 1000 ? 0 : (int32_t)(1000 - idle_permille);
+        }
+    }
+
+    portENTER_CRITICAL(&selftest_lock);
+    running = false;
+    report.stages[SELFTEST_STAGE_WS_RTT] = ws_rtt;
+    portEXIT_CRITICAL(&selftest_lock);
+
+    ESP_LOGI("SELFTEST", "%s: %"PRIu32" blocks, rx %"PRIu32" Hz, tx %"PRIu32" Hz, "
+             "overruns %"PRIu32", underruns %"PRIu32", data errors %"PRIu32,
+             selftest_passed(&report) ? "PASSED" : "FAILED", report.blocks,
+             report.rx_rate_hz, report.tx_rate_hz, report.rx_overruns,
+             report.tx_underruns, report.data_errors);
+    send_report();
+}
+
+void selftest_task(void *pvParameters) {
+    selftest_device_t dev = {
+        .blocks = xQueueCreateStatic(SELFTEST_QUEUE_LEN, sizeof(selftest_block_t),
+                                     block_queue_buffer, &block_queue_storage),
+    };
+
+    while (1) {
+        EventBits_t bits = wait_for_state(STATE_BIT(CLIENT_STATE_SELF_TEST) | STATE_BIT(CLIENT_STATE_SHUTDOWN),
+                                          portMAX_DELAY);
+        if (bits & STATE_BIT(CLIENT_STATE_SHUTDOWN)) {
+            break;
+        }
+
+        run_selftest(&dev);
+
+        // A disconnect or shutdown may already have moved us on
+        if (get_state() == CLIENT_STATE_SELF_TEST) {
+            set_state(CLIENT_STATE_IDLE);
+        }
+        // Wait for the SELF_TEST bit to clear so the next wait blocks
+        while (wait_for_state(STATE_BIT(CLIENT_STATE_SELF_TEST), 0)) {
+            vTaskDelay(pdMS_TO_TICKS(20));
+        }
+    }
+
+    vTaskDelete(NULL);
+}
@@ -0,0 +1,50 @@
+/*
+ * HotPin Firmware - On-Device Diagnostics
+ *
+ * Runs the audio pipeline self-test (selftest.h) against the real I2S
+ * driver, chunk pool and a FreeRTOS queue while the device sits in
+ * CLIENT_STATE_SELF_TEST, then sends the report to the server as a
+ * "selftest_report" message. Started by a "selftest" message from the
+ * server or by holding the button through boot.
+ */
+
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "selftest.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SELFTEST_DEFAULT_DURATION_MS    5000
+
+/**
+ * @brief Start a self-test (only from IDLE)
+ *
+ * @param mode Which half of the pipeline to exercise
+ * @param duration_ms Run time, capped at SELFTEST_MAX_DURATION_MS
+ * @return false if the device is busy
+ */
+bool selftest_request(selftest_mode_t mode, uint32_t duration_ms);
+
+/**
+ * @brief Record the round trip of a self-test ping
+ *
+ * @param sent_us esp_timer_get_time() echoed back in the pong ("t")
+ */
+void selftest_note_pong(int64_t sent_us);
+
+/**
+ * @brief Runs a self-test each time CLIENT_STATE_SELF_TEST is entered
+ */
+void selftest_task(void *pvParameters);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DIAGNOSTICS_H */
@@ -0,0 +1,153 @@
+/*
+ * HotPin Firmware - Long-Form Dictation Store
+ *
+ * Each banked block holds DICTATION_SLOTS_PER_BLOCK chunk slots. The writer
+ * and the reader each own a mapping window, so capture and send never
+ * remap each other's bank; a window only switches when its side crosses
+ * into the next block.
+ */
+
+#include "main.h"
+#include "banked_mem.h"
+#include "dictation.h"
+#include "session_profile.h"
+
+#define DICTATION_SLOT_BYTES        (16 * 1024)
+#define DICTATION_SLOTS_PER_BLOCK   (BANKED_BLOCK_BYTES / DICTATION_SLOT_BYTES)
+
+_Static_assert(CHUNK_BYTES <= DICTATION_SLOT_BYTES, "a chunk must fit in one dictation slot");
+
+typedef struct {
+    uint32_t seq;
+    uint32_t len;
+} dictation_slot_meta_t;
+
+static bool store_ready = false;
+static uint32_t slot_count = 0;
+static dictation_slot_meta_t *slot_meta = NULL;   // In PSRAM, one per slot
+static uint32_t head = 0;   // Next slot to write
+static uint32_t tail = 0;   // Oldest unsent slot
+static uint32_t pending = 0;
+static dictation_stats_t stats;
+static portMUX_TYPE dictation_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static banked_window_t writer_window;
+static banked_window_t reader_window;
+
+static uint8_t* map_slot(banked_window_t *window, uint32_t slot) {
+    uint8_t *block = banked_window_map(window, slot / DICTATION_SLOTS_PER_BLOCK);
+    return block ? block + (slot % DICTATION_SLOTS_PER_BLOCK) * DICTATION_SLOT_BYTES : NULL;
+}
+
+bool init_dictation_store(void) {
+#if CONFIG_HOTPIN_DICTATION_MODE
+    if (store_ready) {
+        return true;
+    }
+    if (!banked_mem_init((size_t)CONFIG_HOTPIN_DICTATION_STORE_KB * 1024)) {
+        ESP_LOGW("DICTATE", "No banked memory, dictation mode disabled");
+        return false;
+    }
+
+    slot_count = banked_mem_block_count() * DICTATION_SLOTS_PER_BLOCK;
+    slot_meta = heap_caps_calloc(slot_count, sizeof(dictation_slot_meta_t), MALLOC_CAP_SPIRAM);
+    if (!slot_meta) {
+        ESP_LOGE("DICTATE", "Failed to allocate slot table");
+        return false;
+    }
+
+    banked_window_init(&writer_window, 0);
+    banked_window_init(&reader_window, 1);
+    stats.available = true;
+    stats.himem = banked_mem_is_himem();
+    stats.capacity_chunks = slot_count;
+    store_ready = true;
+
+    ESP_LOGI("DICTATE", "Dictation store: %"PRIu32" chunks (%"PRIu32" s of audio) in %s",
+             slot_count, slot_count * CHUNK_SAMPLES / SAMPLE_RATE, stats.himem ? "himem" : "PSRAM");
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool dictation_active(void) {
+    return store_ready && session_feature_enabled(SESSION_FEATURE_DICTATION);
+}
+
+uint8_t* dictation_write_slot(void) {
+    portENTER_CRITICAL(&dictation_lock);
+    bool full = pending == slot_count;
+    uint32_t slot = head;
+    portEXIT_CRITICAL(&dictation_lock);
+
+    return full ? NULL : map_slot(&writer_window, slot);
+}
+
+void dictation_commit_write(uint32_t seq, size_t len) {
+    portENTER_CRITICAL(&dictation_lock);
+    slot_meta[head].seq = seq;
+    slot_meta[head].len = len;
+    head = (head + 1) % slot_count;
+    pending++;
+    stats.stored++;
+    if (pending > stats.peak_pending) {
+        stats.peak_pending = pending;
+    }
+    portEXIT_CRITICAL(&dictation_lock);
+}
+
+void dictation_note_full_stop(void) {
+    portENTER_CRITICAL(&dictation_lock);
+    stats.full_stops++;
+    portEXIT_CRITICAL(&dictation_lock);
+}
+
+uint32_t dictation_pending(void) {
+    if (!store_ready) {
+        return 0;
+    }
+    portENTER_CRITICAL(&dictation_lock);
+    uint32_t count = pending;
+    portEXIT_CRITICAL(&dictation_lock);
+    return count;
+}
+
+bool dictation_peek(uint8_t *dst, uint32_t *seq, size_t *len) {
+    portENTER_CRITICAL(&dictation_lock);
+    bool empty = pending == 0;
+    uint32_t slot = tail;
+    dictation_slot_meta_t meta = empty ? (dictation_slot_meta_t){0} : slot_meta[slot];
+    portEXIT_CRITICAL(&dictation_lock);
+
+    if (empty) {
+        return false;
+    }
+    // The writer never touches a pending slot, so copy outside the lock
+    const uint8_t *src = map_slot(&reader_window, slot);
+    if (!src) {
+        return false;
+    }
+    memcpy(dst, src, meta.len);
+    *seq = meta.seq;
+    *len = meta.len;
+    return true;
+}
+
+void dictation_consume(void) {
+    portENTER_CRITICAL(&dictation_lock);
+    if (pending > 0) {
+        tail = (tail + 1) % slot_count;
+        pending--;
+        stats.sent++;
+    }
+    portEXIT_CRITICAL(&dictation_lock);
+}
+
+void get_dictation_stats(dictation_stats_t *out) {
+    portENTER_CRITICAL(&dictation_lock);
+    *out = stats;
+    out->pending_chunks = pending;
+    out->window_switches = writer_window.switches + reader_window.switches;
+    portEXIT_CRITICAL(&dictation_lock);
+}
@@ -0,0 +1,90 @@
+/*
+ * HotPin Firmware - Long-Form Dictation Store
+ *
+ * In dictation mode (CONFIG_HOTPIN_DICTATION_MODE) the capture task writes
+ * chunks straight into a circular store in banked PSRAM instead of the
+ * chunk pool, and the send task drains it as fast as the uplink allows.
+ * Audio is only lost if the store fills, in which case the recording ends.
+ */
+
+#ifndef DICTATION_H
+#define DICTATION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    bool available;
+    bool himem;
+    uint32_t capacity_chunks;
+    uint32_t pending_chunks;
+    uint32_t peak_pending;
+    uint32_t stored;
+    uint32_t sent;
+    uint32_t full_stops;            // Recordings ended because the store filled
+    uint32_t window_switches;       // Bank remaps (writer + reader)
+} dictation_stats_t;
+
+/**
+ * @brief Reserve the banked store (no-op unless CONFIG_HOTPIN_DICTATION_MODE)
+ *
+ * @return true if dictation mode is active
+ */
+bool init_dictation_store(void);
+
+/**
+ * @brief true if recordings are captured into the dictation store
+ */
+bool dictation_active(void);
+
+/**
+ * @brief Slot for the next chunk, mapped for writing (capture task only)
+ *
+ * @return CHUNK_BYTES of writable memory, or NULL if the store is full
+ */
+uint8_t* dictation_write_slot(void);
+
+/**
+ * @brief Publish the slot returned by dictation_write_slot()
+ */
+void dictation_commit_write(uint32_t seq, size_t len);
+
+/**
+ * @brief Note that a recording ended because the store was full
+ */
+void dictation_note_full_stop(void);
+
+/**
+ * @brief Chunks captured but not yet handed to the WebSocket
+ */
+uint32_t dictation_pending(void);
+
+/**
+ * @brief Copy the oldest chunk out of the store without consuming it
+ *        (send task only)
+ *
+ * @param dst Buffer of CHUNK_BYTES
+ * @return true if a chunk was copied
+ */
+bool dictation_peek(uint8_t *dst, uint32_t *seq, size_t *len);
+
+/**
+ * @brief Release the oldest chunk once it has been handed to the WebSocket
+ */
+void dictation_consume(void);
+
+/**
+ * @brief Copy the dictation counters
+ */
+void get_dictation_stats(dictation_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DICTATION_H */
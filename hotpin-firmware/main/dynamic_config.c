@@ -9,11 +9,123 @@
 #include "esp_http_client.h"
 #include "cJSON.h"
 #include "network_discovery.h"
+#include "dynamic_config.h"
+#include "nvs.h"
 #include <string.h>
 
-// Global configuration variables
-static char dynamic_ws_url[256] = {0};
-static bool dynamic_config_available = false;
+#define ENDPOINTS_NVS_NAMESPACE     "hotpin"
+#define ENDPOINTS_NVS_KEY           "endpoints"
+
+// Server endpoints in preference order with their health (endpoint_list.h)
+static endpoint_list_t endpoints;
+static portMUX_TYPE endpoints_lock = portMUX_INITIALIZER_UNLOCKED;
+static endpoint_list_t saved_endpoints;  // NVS staging; too large for the boot task's stack
+
+static uint32_t now_ms(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+// Append the session ID and token the server expects to a listed URL
+static bool format_ws_url(char *out, size_t size, const char *base) {
+    const char *sep = strchr(base, '?') ? "&" : "?";
+    int len = snprintf(out, size, "%s%ssession=%s&token=%s", base, sep, SESSION_ID, HOTPIN_WS_TOKEN);
+    return len > 0 && (size_t)len < size;
+}
+
+static void save_endpoints(void) {
+    portENTER_CRITICAL(&endpoints_lock);
+    saved_endpoints = endpoints;
+    portEXIT_CRITICAL(&endpoints_lock);
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(ENDPOINTS_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(nvs, ENDPOINTS_NVS_KEY, &saved_endpoints, sizeof(saved_endpoints));
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW("CONFIG", "Failed to save server endpoints: %s", esp_err_to_name(err));
+    }
+}
+
+// Bring back the learned endpoints and the health of the configured ones.
+// A configured endpoint that is no longer in config.h is dropped.
+static void restore_endpoints(void) {
+    nvs_handle_t nvs;
+    if (nvs_open(ENDPOINTS_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return;
+    }
+    size_t len = sizeof(saved_endpoints);
+    esp_err_t err = nvs_get_blob(nvs, ENDPOINTS_NVS_KEY, &saved_endpoints, &len);
+    nvs_close(nvs);
+    if (err != ESP_OK || len != sizeof(saved_endpoints) || saved_endpoints.count > ENDPOINT_MAX) {
+        return;
+    }
+
+    int restored = 0;
+    for (int i = 0; i < saved_endpoints.count; i++) {
+        endpoint_t *saved = &saved_endpoints.entries[i];
+        saved->url[ENDPOINT_URL_LEN - 1] = '\0';
+        int index = -1;
+        for (int j = 0; j < endpoints.count; j++) {
+            if (strcmp(endpoints.entries[j].url, saved->url) == 0) {
+                index = j;
+            }
+        }
+        if (index < 0 && saved->source == ENDPOINT_LEARNED) {
+            index = endpoint_list_add(&endpoints, saved->url, ENDPOINT_LEARNED);
+        }
+        if (index < 0) {
+            continue;
+        }
+        endpoint_t *ep = &endpoints.entries[index];
+        ep->score = saved->score;
+        ep->connect_ms = saved->connect_ms;
+        ep->connects = saved->connects;
+        ep->drops = saved->drops;
+        restored++;  // Backoff is not kept: the clock restarted
+    }
+    ESP_LOGI("CONFIG", "Restored %d server endpoint(s) from NVS", restored);
+}
+
+// Add a server found by discovery or named by a /config response
+static void learn_endpoint(const char *url) {
+    portENTER_CRITICAL(&endpoints_lock);
+    bool known = false;
+    for (int i = 0; i < endpoints.count; i++) {
+        known |= strcmp(endpoints.entries[i].url, url) == 0;
+    }
+    int index = endpoint_list_add(&endpoints, url, ENDPOINT_LEARNED);
+    portEXIT_CRITICAL(&endpoints_lock);
+
+    if (index < 0) {
+        ESP_LOGW("CONFIG", "Could not add server endpoint %s", url);
+    } else if (!known) {
+        ESP_LOGI("CONFIG", "Learned server endpoint %s", url);
+        save_endpoints();
+    }
+}
+
+// WEBSOCKET_URL, then each of the comma-separated WEBSOCKET_FALLBACK_URLS
+static void add_configured_endpoints(void) {
+    char urls[sizeof(HOTPIN_WS_URL) + sizeof(HOTPIN_WS_FALLBACK_URLS) + 1];
+    snprintf(urls, sizeof(urls), "%s,%s", HOTPIN_WS_URL, HOTPIN_WS_FALLBACK_URLS);
+
+    char *save = NULL;
+    for (char *url = strtok_r(urls, ", ", &save); url; url = strtok_r(NULL, ", ", &save)) {
+        // A device cannot reach a server on its own loopback
+        if (strlen(url) <= 10 || strstr(url, "localhost") || strstr(url, "127.0.0.1")) {
+            ESP_LOGW("CONFIG", "Skipping unusable configured URL: %s", url);
+            continue;
+        }
+        if (endpoint_list_add(&endpoints, url, ENDPOINT_CONFIGURED) < 0) {
+            ESP_LOGW("CONFIG", "Could not add configured URL: %s", url);
+        }
+    }
+}
 
 /**
  * @brief HTTP event handler for configuration requests
@@ -68,7 +180,7 @@ static bool fetch_dynamic_config_from_ip(const char *server_ip) {
     ESP_LOGI("CONFIG", "Fetching dynamic configuration from server IP: %s", server_ip);
     
     // Early exit if we're in a critical state where stack overflow is likely
-    if (current_state == CLIENT_STATE_BOOTING) {
+    if (get_state() == CLIENT_STATE_BOOTING) {
         ESP_LOGW("CONFIG", "Skipping HTTP fetch during critical boot phase to prevent stack overflow");
         return false;
     }
@@ -154,32 +266,8 @@ static bool fetch_dynamic_config_from_ip(const char *server_ip) {
         return false;
     }
     
-    // Check if the URL already contains query parameters - use smaller buffer
-    char full_ws_url[256];  // Reasonable size for URL with params
-    if (strchr(ws_url, '?')) {
-        // URL already has query params, append with &
-        if (snprintf(full_ws_url, sizeof(full_ws_url), "%s&session=%s&token=%s", ws_url, SESSION_ID, HOTPIN_WS_TOKEN) >= sizeof(full_ws_url)) {
-            ESP_LOGE("CONFIG", "Full WebSocket URL would be too long");
-            cJSON_Delete(json);
-            esp_http_client_cleanup(client);
-            return false;
-        }
-    } else {
-        // URL has no query params, append with ?
-        if (snprintf(full_ws_url, sizeof(full_ws_url), "%s?session=%s&token=%s", ws_url, SESSION_ID, HOTPIN_WS_TOKEN) >= sizeof(full_ws_url)) {
-            ESP_LOGE("CONFIG", "Full WebSocket URL would be too long");
-            cJSON_Delete(json);
-            esp_http_client_cleanup(client);
-            return false;
-        }
-    }
-    
-    // Update dynamic configuration
-    strncpy(dynamic_ws_url, full_ws_url, sizeof(dynamic_ws_url) - 1);
-    dynamic_ws_url[sizeof(dynamic_ws_url) - 1] = '\0';  // Ensure null termination
-    dynamic_config_available = true;
-    
-    ESP_LOGI("CONFIG", "Dynamic WebSocket URL updated: %s", dynamic_ws_url);
+    // The session ID and token are added per connection (format_ws_url)
+    learn_endpoint(ws_url);
     
     // Clean up
     cJSON_Delete(json);
@@ -205,6 +293,8 @@ bool fetch_dynamic_config() {
     
     // Try network discovery
     if (discover_server(discovered_server_ip, sizeof(discovered_server_ip))) {
+        learn_endpoint(discovered_server_ip);
+        
         // Extract just the IP part from the returned WebSocket URL
         // Format is ws://IP:port/path
         char *start = strstr(discovered_server_ip, "ws://");
@@ -247,28 +337,118 @@ bool fetch_dynamic_config() {
 /**
  * @brief Get the current WebSocket URL
  * 
- * Returns the WebSocket URL to use, preferring dynamic configuration
- * when available, falling back to compiled configuration.
+ * Returns the best endpoint's URL, falling back to compiled configuration
+ * when no endpoint is listed.
  * 
  * @return Pointer to the WebSocket URL string
  */
 const char* get_current_ws_url() {
-    static char fallback_ws_url[256];
+    static ws_candidate_t best;
     
-    if (dynamic_config_available && strlen(dynamic_ws_url) > 0) {
-        return dynamic_ws_url;
+    if (get_ws_candidates(&best, 1) == 1) {
+        return best.url;
     }
     
-    // Format the fallback URL with session and token parameters
-    if (strchr(HOTPIN_WS_URL, '?')) {
-        // URL already has query params, append with &
-        snprintf(fallback_ws_url, sizeof(fallback_ws_url), "%s&session=%s&token=%s", HOTPIN_WS_URL, SESSION_ID, HOTPIN_WS_TOKEN);
+    format_ws_url(best.url, sizeof(best.url), HOTPIN_WS_URL);
+    return best.url;
+}
+
+int get_ws_candidates(ws_candidate_t *out, int max) {
+    int picked[ENDPOINT_MAX];
+    if (max > ENDPOINT_MAX) {
+        max = ENDPOINT_MAX;
+    }
+
+    int count = 0;
+    portENTER_CRITICAL(&endpoints_lock);
+    int n = endpoint_list_pick(&endpoints, now_ms(), picked, max);
+    for (int i = 0; i < n; i++) {
+        out[count].endpoint = picked[i];
+        strcpy(out[count].endpoint_url, endpoints.entries[picked[i]].url);
+        count++;
+    }
+    portEXIT_CRITICAL(&endpoints_lock);
+
+    // Formatted outside the critical section (snprintf)
+    for (int i = 0; i < count; i++) {
+        if (!format_ws_url(out[i].url, sizeof(out[i].url), out[i].endpoint_url)) {
+            ESP_LOGE("CONFIG", "WebSocket URL too long for %s", out[i].endpoint_url);
+            out[i] = out[--count];
+            i--;
+        }
+    }
+    return count;
+}
+
+uint32_t get_ws_retry_wait_ms(void) {
+    portENTER_CRITICAL(&endpoints_lock);
+    uint32_t wait_ms = endpoint_list_wait_ms(&endpoints, now_ms());
+    portEXIT_CRITICAL(&endpoints_lock);
+    return wait_ms;
+}
+
+void note_ws_connect_result(int endpoint, bool connected, uint32_t connect_ms) {
+    portENTER_CRITICAL(&endpoints_lock);
+    if (connected) {
+        endpoint_list_note_success(&endpoints, endpoint, connect_ms);
     } else {
-        // URL has no query params, append with ?
-        snprintf(fallback_ws_url, sizeof(fallback_ws_url), "%s?session=%s&token=%s", HOTPIN_WS_URL, SESSION_ID, HOTPIN_WS_TOKEN);
+        endpoint_list_note_failure(&endpoints, endpoint, now_ms());
     }
-    
-    return fallback_ws_url;
+    portEXIT_CRITICAL(&endpoints_lock);
+
+    // Failures are frequent while a server is down; only keep what a
+    // restart should remember
+    if (connected) {
+        save_endpoints();
+    }
+}
+
+void note_ws_connect_slow(int endpoint) {
+    portENTER_CRITICAL(&endpoints_lock);
+    endpoint_list_note_slow(&endpoints, endpoint);
+    portEXIT_CRITICAL(&endpoints_lock);
+}
+
+void note_ws_endpoint_announced(const char *url) {
+    learn_endpoint(url);
+
+    portENTER_CRITICAL(&endpoints_lock);
+    for (int i = 0; i < endpoints.count; i++) {
+        if (strcmp(endpoints.entries[i].url, url) == 0) {
+            endpoint_list_note_announced(&endpoints, i);
+        }
+    }
+    portEXIT_CRITICAL(&endpoints_lock);
+}
+
+void note_ws_endpoint_moved(const char *old_url, const char *new_url) {
+    portENTER_CRITICAL(&endpoints_lock);
+    int old_index = -1;
+    bool new_known = false;
+    for (int i = 0; i < endpoints.count; i++) {
+        if (strcmp(endpoints.entries[i].url, old_url) == 0) {
+            old_index = i;
+        }
+        new_known |= strcmp(endpoints.entries[i].url, new_url) == 0;
+    }
+    bool replace = old_index >= 0 && !new_known && endpoints.entries[old_index].source == ENDPOINT_LEARNED;
+    if (replace) {
+        endpoint_list_replace(&endpoints, old_index, new_url);
+    }
+    portEXIT_CRITICAL(&endpoints_lock);
+
+    if (replace) {
+        ESP_LOGI("CONFIG", "Server endpoint moved: %s -> %s", old_url, new_url);
+        save_endpoints();
+    } else {
+        note_ws_endpoint_announced(new_url);
+    }
+}
+
+void note_ws_connection_lost(int endpoint) {
+    portENTER_CRITICAL(&endpoints_lock);
+    endpoint_list_note_drop(&endpoints, endpoint);
+    portEXIT_CRITICAL(&endpoints_lock);
 }
 
 /**
@@ -293,98 +473,72 @@ void update_dynamic_config() {
 /**
  * @brief Initialize dynamic configuration management
  * 
- * Sets up the dynamic configuration system and fetches initial configuration.
- * Prioritizes using the pre-configured URL from .env file with authentication.
- * Only attempts to fetch configuration from server if URL seems incomplete.
- * If that fails, attempts network discovery as fallback.
+ * Builds the endpoint list from the configured URLs and the endpoints saved
+ * in NVS. Only when no usable URL is configured, or the configured one seems
+ * incomplete, does it fetch configuration from the server or run network
+ * discovery, since HTTP requests during initialization can overflow the
+ * boot task's stack.
  * 
  * @return true if initialization was successful, false otherwise
  */
 bool init_dynamic_config() {
     ESP_LOGI("CONFIG", "Initializing dynamic configuration management");
     
-    // If the pre-configured URL is valid, use it directly with authentication parameters
-    // This avoids HTTP requests during initialization which can cause stack overflow
-    if (strlen(HOTPIN_WS_URL) > 10 && strstr(HOTPIN_WS_URL, "localhost") == NULL && 
-        strstr(HOTPIN_WS_URL, "127.0.0.1") == NULL) {
-        
-        ESP_LOGI("CONFIG", "Found pre-configured URL, applying authentication parameters without server fetch");
-        
-        // Format the pre-configured URL with authentication parameters directly
-        // This avoids HTTP requests during initialization which can cause stack overflow
-        if (strchr(HOTPIN_WS_URL, '?')) {
-            // URL already has query params, append with &
-            if (snprintf(dynamic_ws_url, sizeof(dynamic_ws_url), "%s&session=%s&token=%s", 
-                         HOTPIN_WS_URL, SESSION_ID, HOTPIN_WS_TOKEN) < sizeof(dynamic_ws_url)) {
-                dynamic_config_available = true;
-                ESP_LOGI("CONFIG", "Dynamic configuration initialized with pre-configured URL: %s", dynamic_ws_url);
-                return true;
-            }
-        } else {
-            // URL has no query params, append with ?
-            if (snprintf(dynamic_ws_url, sizeof(dynamic_ws_url), "%s?session=%s&token=%s", 
-                         HOTPIN_WS_URL, SESSION_ID, HOTPIN_WS_TOKEN) < sizeof(dynamic_ws_url)) {
-                dynamic_config_available = true;
-                ESP_LOGI("CONFIG", "Dynamic configuration initialized with pre-configured URL: %s", dynamic_ws_url);
-                return true;
-            }
-        }
-        
-        ESP_LOGW("CONFIG", "Failed to format pre-configured URL with auth parameters");
+    portENTER_CRITICAL(&endpoints_lock);
+    endpoint_list_init(&endpoints);
+    portEXIT_CRITICAL(&endpoints_lock);
+    // Nothing else uses the list until this returns
+    add_configured_endpoints();
+    int configured = endpoints.count;
+    restore_endpoints();
+    
+    for (int i = 0; i < endpoints.count; i++) {
+        const endpoint_t *ep = &endpoints.entries[i];
+        ESP_LOGI("CONFIG", "Endpoint %d: %s (%s, score %u, %"PRIu32" connects)", i, ep->url,
+                 ep->source == ENDPOINT_CONFIGURED ? "configured" : "learned", ep->score, ep->connects);
     }
     
-    // Only try to fetch configuration from server if we have a valid URL but it seems incomplete
-    // This avoids unnecessary HTTP requests during initialization
-    if (strlen(HOTPIN_WS_URL) > 10) {
+    if (configured > 0) {
         // Check if the URL appears to be incomplete (missing port, path, etc.)
         bool url_seems_complete = (strstr(HOTPIN_WS_URL, ":8000/") != NULL) || 
                                   (strstr(HOTPIN_WS_URL, ":8000") != NULL);
+        if (url_seems_complete) {
+            ESP_LOGI("CONFIG", "Pre-configured URL appears complete, skipping server fetch to avoid stack overflow");
+            return true;
+        }
         
-        if (!url_seems_complete) {
-            ESP_LOGI("CONFIG", "Pre-configured URL seems incomplete, attempting to fetch config from server");
-            
-            // Extract the server IP from the configured URL to try fetching config from it
-            char server_ip[64] = {0};
-            
-            // Parse the IP from the WebSocket URL: ws://IP:port/path -> extract IP
-            char *start = strstr(HOTPIN_WS_URL, "ws://");
-            if (start) {
-                start += 5; // Skip "ws://"
-                char *end = strchr(start, ':'); // Find the port separator
-                if (end) {
-                    size_t ip_len = end - start;
-                    strncpy(server_ip, start, ip_len);
-                    server_ip[ip_len] = '\0';
-                    
-                    ESP_LOGI("CONFIG", "Attempting to fetch config from server IP: %s", server_ip);
-                    
-                    // Try to fetch config from the pre-configured server IP
-                    if (fetch_dynamic_config_from_ip(server_ip)) {
-                        ESP_LOGI("CONFIG", "Dynamic configuration initialized successfully by fetching from server: %s", server_ip);
-                        return true;
-                    } else {
-                        ESP_LOGW("CONFIG", "Failed to fetch config from server, will try network discovery");
-                    }
+        ESP_LOGI("CONFIG", "Pre-configured URL seems incomplete, attempting to fetch config from server");
+        
+        // Parse the IP from the WebSocket URL: ws://IP:port/path -> extract IP
+        char server_ip[64] = {0};
+        char *start = strstr(HOTPIN_WS_URL, "ws://");
+        if (start) {
+            start += 5; // Skip "ws://"
+            char *end = strchr(start, ':'); // Find the port separator
+            if (end && (size_t)(end - start) < sizeof(server_ip)) {
+                strncpy(server_ip, start, end - start);
+                
+                ESP_LOGI("CONFIG", "Attempting to fetch config from server IP: %s", server_ip);
+                if (fetch_dynamic_config_from_ip(server_ip)) {
+                    ESP_LOGI("CONFIG", "Dynamic configuration initialized successfully by fetching from server: %s", server_ip);
+                    return true;
                 }
+                ESP_LOGW("CONFIG", "Failed to fetch config from server, will try network discovery");
             }
-        } else {
-            ESP_LOGI("CONFIG", "Pre-configured URL appears complete, skipping server fetch to avoid stack overflow");
         }
     }
     
-    // If we can't use the pre-configured URL directly and it's not incomplete, 
-    // try network discovery as fallback but only if we really need to
+    // Without a usable configured URL, look for a server on the network
+    // (a learned endpoint from an earlier boot may also still be listed)
     char discovered_ws_url[256];
     if (discover_server(discovered_ws_url, sizeof(discovered_ws_url))) {
-        // Use the discovered URL as the dynamic WebSocket URL
-        strncpy(dynamic_ws_url, discovered_ws_url, sizeof(dynamic_ws_url) - 1);
-        dynamic_ws_url[sizeof(dynamic_ws_url) - 1] = '\0';  // Ensure null termination
-        dynamic_config_available = true;
-        
-        ESP_LOGI("CONFIG", "Dynamic configuration initialized via network discovery: %s", dynamic_ws_url);
+        learn_endpoint(discovered_ws_url);
+        ESP_LOGI("CONFIG", "Dynamic configuration initialized via network discovery: %s", discovered_ws_url);
         return true;
     }
     
-    ESP_LOGW("CONFIG", "Failed to initialize configuration from pre-configured URL, fetch, or discovery. Using defaults.");
+    if (endpoints.count == 0) {
+        ESP_LOGW("CONFIG", "No server endpoint from configuration, NVS or discovery. Using defaults.");
+    }
     return true; // Continue with defaults
-}
\ No newline at end of file
+}
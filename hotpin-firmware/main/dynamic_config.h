@@ -6,6 +6,9 @@
 #define DYNAMIC_CONFIG_H
 
 #include <stdbool.h>
+#include <stdint.h>
+
+#include "endpoint_list.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -37,6 +40,61 @@ void update_dynamic_config();
  */
 bool init_dynamic_config();
 
+/*
+ * Server endpoints (endpoint_list.h): the configured WEBSOCKET_URL and
+ * WEBSOCKET_FALLBACK_URLS, plus servers learned from discovery, with their
+ * health scores kept in NVS across restarts.
+ */
+
+typedef struct {
+    int endpoint;                   // For note_ws_connect_result()/note_ws_connection_lost()
+    char endpoint_url[ENDPOINT_URL_LEN]; // As listed, for logging
+    char url[256];                  // With the current session ID and token
+} ws_candidate_t;
+
+/**
+ * @brief Best endpoints to connect to now, best first (none in backoff)
+ *
+ * @return Number of candidates written to out
+ */
+int get_ws_candidates(ws_candidate_t *out, int max);
+
+/**
+ * @brief Time until an endpoint leaves backoff (0 if one is ready now)
+ */
+uint32_t get_ws_retry_wait_ms(void);
+
+/**
+ * @brief Record the outcome of a connect attempt to a candidate
+ *
+ * @param connected  true if the WebSocket upgrade completed
+ * @param connect_ms Time from starting the attempt to the upgrade
+ */
+void note_ws_connect_result(int endpoint, bool connected, uint32_t connect_ms);
+
+/**
+ * @brief Record an attempt that was still connecting when another won
+ */
+void note_ws_connect_slow(int endpoint);
+
+/**
+ * @brief Add a server found by its discovery beacon and end its backoff
+ */
+void note_ws_endpoint_announced(const char *url);
+
+/**
+ * @brief A server seen by mDNS has moved from old_url to new_url
+ *
+ * A learned endpoint at old_url is pointed at new_url; a configured one is
+ * kept and new_url is added as a learned endpoint.
+ */
+void note_ws_endpoint_moved(const char *old_url, const char *new_url);
+
+/**
+ * @brief Record that an established connection to an endpoint was lost
+ */
+void note_ws_connection_lost(int endpoint);
+
 #ifdef __cplusplus
 }
 #endif
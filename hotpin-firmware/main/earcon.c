@@ -0,0 +1,119 @@
+/*
+ * HotPin Firmware - Flash-Resident Earcons
+ */
+
+#include "main.h"
+#include "earcon.h"
+#include "esp_partition.h"
+
+#define EARCON_MAX_ENTRIES  16
+
+static const char *earcon_names[EARCON_COUNT] = {
+    [EARCON_THINKING]    = "thinking",
+    [EARCON_UNREACHABLE] = "unreachable",
+    [EARCON_REPEAT]      = "repeat",
+};
+
+typedef struct {
+    const uint8_t *pcm;
+    size_t len;
+} earcon_clip_t;
+
+static earcon_clip_t clips[EARCON_COUNT];
+static const uint8_t *bundle = NULL;
+static esp_partition_mmap_handle_t bundle_handle;
+
+bool init_earcons(void) {
+#if CONFIG_HOTPIN_EARCONS
+    if (bundle) {
+        return true;
+    }
+
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                           ESP_PARTITION_SUBTYPE_ANY, "earcons");
+    if (!part) {
+        ESP_LOGW("EARCON", "No 'earcons' partition");
+        return false;
+    }
+
+    const void *ptr = NULL;
+    esp_err_t err = esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &ptr, &bundle_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE("EARCON", "Failed to map earcon partition: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    const earcon_bundle_header_t *header = ptr;
+    if (header->magic != EARCON_BUNDLE_MAGIC || header->version != EARCON_BUNDLE_VERSION ||
+        header->count > EARCON_MAX_ENTRIES) {
+        ESP_LOGW("EARCON", "Earcon partition holds no valid bundle (flash build/earcons.bin)");
+        esp_partition_munmap(bundle_handle);
+        return false;
+    }
+
+    const earcon_entry_t *entries = (const earcon_entry_t*)(header + 1);
+    int found = 0;
+    for (int i = 0; i < header->count; i++) {
+        const earcon_entry_t *entry = &entries[i];
+        if (entry->format != EARCON_FORMAT_PCM16 || entry->sample_rate != SAMPLE_RATE ||
+            entry->offset > part->size || entry->length > part->size - entry->offset) {
+            ESP_LOGW("EARCON", "Skipping unusable clip '%.*s'", EARCON_NAME_LEN, entry->name);
+            continue;
+        }
+        for (int id = 0; id < EARCON_COUNT; id++) {
+            if (strncmp(entry->name, earcon_names[id], EARCON_NAME_LEN) == 0) {
+                clips[id].pcm = (const uint8_t*)ptr + entry->offset;
+                clips[id].len = entry->length & ~1u;  // Whole samples only
+                found++;
+                break;
+            }
+        }
+    }
+
+    if (found == 0) {
+        esp_partition_munmap(bundle_handle);
+        return false;
+    }
+    bundle = ptr;
+    ESP_LOGI("EARCON", "Mapped %d earcon(s) from flash", found);
+    return true;
+#else
+    return false;
+#endif
+}
+
+earcon_id_t earcon_for_state(client_state_t state) {
+    switch (state) {
+        case CLIENT_STATE_PROCESSING:
+            return EARCON_THINKING;
+        case CLIENT_STATE_STALLED:
+            return EARCON_UNREACHABLE;
+        default:
+            return EARCON_NONE;
+    }
+}
+
+bool earcon_get(earcon_id_t id, const uint8_t **pcm, size_t *len) {
+    if (!bundle || id <= EARCON_NONE || id >= EARCON_COUNT || !clips[id].pcm) {
+        return false;
+    }
+    *pcm = clips[id].pcm;
+    *len = clips[id].len;
+    return true;
+}
+
+bool earcon_request(earcon_id_t id) {
+    if (!bundle || !q_earcons) {
+        return false;
+    }
+    int request = id;
+    if (xQueueSend(q_earcons, &request, 0) != pdTRUE) {
+        return false;
+    }
+    state_effect_wake();
+    return true;
+}
+
+const char* earcon_name(earcon_id_t id) {
+    return (id > EARCON_NONE && id < EARCON_COUNT) ? earcon_names[id] : "none";
+}
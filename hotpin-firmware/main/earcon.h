@@ -0,0 +1,95 @@
+/*
+ * HotPin Firmware - Flash-Resident Earcons
+ *
+ * Short feedback clips ("thinking" chime, "can't reach server", "please
+ * repeat") live in the 'earcons' partition as a bundle built by
+ * tools/build_earcons.py. The partition is memory-mapped once at boot and
+ * clips are written to I2S straight from the mapping, so playing one costs
+ * no heap and no chunk-pool slots.
+ *
+ * Bundle layout (little-endian):
+ *     earcon_bundle_header_t
+ *     earcon_entry_t[count]
+ *     clip data, each entry's offset is from the start of the partition
+ */
+
+#ifndef EARCON_H
+#define EARCON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "state_machine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EARCON_BUNDLE_MAGIC     0x43455048u  // "HPEC"
+#define EARCON_BUNDLE_VERSION   1
+#define EARCON_NAME_LEN         16
+#define EARCON_FORMAT_PCM16     0            // Signed 16-bit mono, little-endian
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+} earcon_bundle_header_t;
+
+typedef struct {
+    char name[EARCON_NAME_LEN];     // NUL-padded
+    uint32_t offset;
+    uint32_t length;                // Bytes
+    uint32_t sample_rate;
+    uint32_t format;                // EARCON_FORMAT_*
+} earcon_entry_t;
+
+typedef enum {
+    EARCON_NONE = -1,
+    EARCON_THINKING = 0,    // Recording handed to the server
+    EARCON_UNREACHABLE,     // Server connection lost
+    EARCON_REPEAT,          // Server asked for a re-record
+    EARCON_COUNT
+} earcon_id_t;
+
+/**
+ * @brief Map the earcon partition and index its clips
+ *
+ * @return true if at least one clip is playable
+ */
+bool init_earcons(void);
+
+/**
+ * @brief Clip played when a transition into a state carries SM_EFFECT_EARCON
+ */
+earcon_id_t earcon_for_state(client_state_t state);
+
+/**
+ * @brief Look up a clip in the mapped partition
+ *
+ * @param pcm Set to the clip samples (flash mapping, read-only)
+ * @param len Set to the clip length in bytes
+ * @return false if the clip is missing or earcons are unavailable
+ */
+bool earcon_get(earcon_id_t id, const uint8_t **pcm, size_t *len);
+
+/**
+ * @brief Queue a clip on the state effect task outside of a transition
+ *
+ * Played once no transition is waiting; transitions have their own queue.
+ *
+ * @return false if the earcon queue is full
+ */
+bool earcon_request(earcon_id_t id);
+
+/**
+ * @brief Name of a clip as stored in the bundle
+ */
+const char* earcon_name(earcon_id_t id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EARCON_H */
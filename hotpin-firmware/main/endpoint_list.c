@@ -0,0 +1,171 @@
+/*
+ * HotPin Firmware - Server Endpoint List
+ *
+ * No ESP-IDF dependencies: see endpoint_list.h.
+ */
+
+#include <string.h>
+
+#include "endpoint_list.h"
+
+static bool in_backoff(const endpoint_t *ep, uint32_t now_ms) {
+    return ep->failures > 0 && (int32_t)(ep->retry_at_ms - now_ms) > 0;
+}
+
+void endpoint_list_init(endpoint_list_t *list) {
+    memset(list, 0, sizeof(*list));
+}
+
+int endpoint_list_add(endpoint_list_t *list, const char *url, endpoint_source_t source) {
+    if (!url || url[0] == '\0' || strlen(url) >= ENDPOINT_URL_LEN) {
+        return -1;
+    }
+    for (int i = 0; i < list->count; i++) {
+        if (strcmp(list->entries[i].url, url) == 0) {
+            // Configuring a learned endpoint promotes it
+            if (source == ENDPOINT_CONFIGURED) {
+                list->entries[i].source = ENDPOINT_CONFIGURED;
+            }
+            return i;
+        }
+    }
+
+    int index = list->count;
+    if (index == ENDPOINT_MAX) {
+        if (source != ENDPOINT_LEARNED) {
+            return -1;
+        }
+        index = -1;
+        for (int i = 0; i < list->count; i++) {
+            if (list->entries[i].source == ENDPOINT_LEARNED &&
+                (index < 0 || list->entries[i].score < list->entries[index].score)) {
+                index = i;
+            }
+        }
+        if (index < 0) {
+            return -1;
+        }
+    } else {
+        list->count++;
+    }
+
+    int configured = 0;
+    for (int i = 0; i < list->count; i++) {
+        configured += (i != index && list->entries[i].source == ENDPOINT_CONFIGURED);
+    }
+    endpoint_t *ep = &list->entries[index];
+    memset(ep, 0, sizeof(*ep));
+    strcpy(ep->url, url);
+    ep->source = (uint8_t)source;
+    if (source == ENDPOINT_CONFIGURED) {
+        int score = ENDPOINT_SCORE_CONFIGURED - 50 * configured;
+        ep->score = (uint16_t)(score > ENDPOINT_SCORE_LEARNED ? score : ENDPOINT_SCORE_LEARNED + 1);
+    } else {
+        ep->score = ENDPOINT_SCORE_LEARNED;
+    }
+    return index;
+}
+
+int endpoint_list_pick(const endpoint_list_t *list, uint32_t now_ms, int *out, int max) {
+    int picked = 0;
+    // Selection by score; ties go to the earlier entry (configured order)
+    while (picked < max) {
+        int best = -1;
+        for (int i = 0; i < list->count; i++) {
+            bool taken = false;
+            for (int j = 0; j < picked; j++) {
+                taken |= (out[j] == i);
+            }
+            if (taken || in_backoff(&list->entries[i], now_ms)) {
+                continue;
+            }
+            if (best < 0 || list->entries[i].score > list->entries[best].score) {
+                best = i;
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+        out[picked++] = best;
+    }
+    return picked;
+}
+
+uint32_t endpoint_list_wait_ms(const endpoint_list_t *list, uint32_t now_ms) {
+    uint32_t wait_ms = UINT32_MAX;
+    for (int i = 0; i < list->count; i++) {
+        const endpoint_t *ep = &list->entries[i];
+        uint32_t ep_wait = in_backoff(ep, now_ms) ? ep->retry_at_ms - now_ms : 0;
+        if (ep_wait < wait_ms) {
+            wait_ms = ep_wait;
+        }
+    }
+    return list->count ? wait_ms : ENDPOINT_BACKOFF_MIN_MS;
+}
+
+void endpoint_list_note_success(endpoint_list_t *list, int index, uint32_t connect_ms) {
+    if (index < 0 || index >= list->count) {
+        return;
+    }
+    endpoint_t *ep = &list->entries[index];
+    ep->score += (ENDPOINT_SCORE_MAX - ep->score + 3) / 4;
+    ep->failures = 0;
+    ep->retry_at_ms = 0;
+    ep->connect_ms = ep->connect_ms ? (ep->connect_ms * 3 + connect_ms) / 4 : connect_ms;
+    ep->connects++;
+}
+
+void endpoint_list_note_failure(endpoint_list_t *list, int index, uint32_t now_ms) {
+    if (index < 0 || index >= list->count) {
+        return;
+    }
+    endpoint_t *ep = &list->entries[index];
+    ep->score /= 2;
+    if (ep->failures < UINT8_MAX) {
+        ep->failures++;
+    }
+    uint32_t backoff_ms = ENDPOINT_BACKOFF_MAX_MS;
+    if (ep->failures <= 6) {
+        backoff_ms = ENDPOINT_BACKOFF_MIN_MS << (ep->failures - 1);
+    }
+    if (backoff_ms > ENDPOINT_BACKOFF_MAX_MS) {
+        backoff_ms = ENDPOINT_BACKOFF_MAX_MS;
+    }
+    ep->retry_at_ms = now_ms + backoff_ms;
+}
+
+void endpoint_list_note_slow(endpoint_list_t *list, int index) {
+    if (index < 0 || index >= list->count) {
+        return;
+    }
+    endpoint_t *ep = &list->entries[index];
+    ep->score -= ep->score / 8;
+}
+
+void endpoint_list_note_announced(endpoint_list_t *list, int index) {
+    if (index < 0 || index >= list->count) {
+        return;
+    }
+    endpoint_t *ep = &list->entries[index];
+    ep->failures = 0;
+    ep->retry_at_ms = 0;
+}
+
+void endpoint_list_replace(endpoint_list_t *list, int index, const char *url) {
+    if (index < 0 || index >= list->count || !url || strlen(url) >= ENDPOINT_URL_LEN) {
+        return;
+    }
+    endpoint_t *ep = &list->entries[index];
+    strcpy(ep->url, url);
+    ep->failures = 0;
+    ep->retry_at_ms = 0;
+}
+
+void endpoint_list_note_drop(endpoint_list_t *list, int index) {
+    if (index < 0 || index >= list->count) {
+        return;
+    }
+    endpoint_t *ep = &list->entries[index];
+    ep->score -= ep->score / 4;
+    ep->drops++;
+}
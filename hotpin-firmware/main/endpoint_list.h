@@ -0,0 +1,133 @@
+/*
+ * HotPin Firmware - Server Endpoint List
+ *
+ * The WebSocket servers the device can use, in preference order, each with
+ * a health score. Configured endpoints (config.h) come first in the order
+ * they are listed; learned endpoints (found by discovery or the /config
+ * fetch) follow and replace each other when the list is full.
+ *
+ * The score starts from the endpoint's place in the list and then tracks
+ * outcomes: a completed WebSocket upgrade moves it a quarter of the way to
+ * ENDPOINT_SCORE_MAX, a failed connect halves it, a dropped connection takes
+ * a quarter off and losing a hedged race to a faster endpoint an eighth. A
+ * failed endpoint is also held back for a backoff (1 s doubling to 60 s) so
+ * a dead server is not retried on every round while another one works.
+ *
+ * Times are milliseconds on any clock that wraps at 2^32. No ESP-IDF
+ * dependencies: the same code runs in the firmware (dynamic_config.c) and in
+ * the host simulation (tools/failover_sim.c).
+ */
+
+#ifndef ENDPOINT_LIST_H
+#define ENDPOINT_LIST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ENDPOINT_MAX                6
+#define ENDPOINT_URL_LEN            128
+#define ENDPOINT_SCORE_MAX          1000
+#define ENDPOINT_SCORE_CONFIGURED   600     // First configured endpoint; 50 less for each after it
+#define ENDPOINT_SCORE_LEARNED      400
+#define ENDPOINT_BACKOFF_MIN_MS     1000
+#define ENDPOINT_BACKOFF_MAX_MS     60000
+
+typedef enum {
+    ENDPOINT_CONFIGURED = 0,
+    ENDPOINT_LEARNED,
+} endpoint_source_t;
+
+typedef struct {
+    char url[ENDPOINT_URL_LEN];     // ws://host:port/path, without session or token
+    uint8_t source;                 // endpoint_source_t
+    uint8_t failures;               // Consecutive failed connects
+    uint16_t score;                 // 0..ENDPOINT_SCORE_MAX
+    uint32_t connect_ms;            // Averaged time to a completed upgrade, 0 if never
+    uint32_t retry_at_ms;           // Held back until then after a failure
+    uint32_t connects;
+    uint32_t drops;
+} endpoint_t;
+
+typedef struct {
+    endpoint_t entries[ENDPOINT_MAX];
+    uint8_t count;
+} endpoint_list_t;
+
+/**
+ * @brief Start with an empty list
+ */
+void endpoint_list_init(endpoint_list_t *list);
+
+/**
+ * @brief Add an endpoint, or find it if the URL is already listed
+ *
+ * A learned endpoint replaces the lowest scored learned one when the list is
+ * full; configured endpoints are never replaced.
+ *
+ * @return Index of the endpoint, or -1 if it could not be added
+ */
+int endpoint_list_add(endpoint_list_t *list, const char *url, endpoint_source_t source);
+
+/**
+ * @brief Candidates for the next connect, best first
+ *
+ * Endpoints in backoff are left out.
+ *
+ * @param out Indexes of up to max endpoints
+ * @return Number of candidates (0 when every endpoint is in backoff)
+ */
+int endpoint_list_pick(const endpoint_list_t *list, uint32_t now_ms, int *out, int max);
+
+/**
+ * @brief Time until the first endpoint leaves backoff (0 if one is ready)
+ */
+uint32_t endpoint_list_wait_ms(const endpoint_list_t *list, uint32_t now_ms);
+
+/**
+ * @brief Record a completed WebSocket upgrade
+ */
+void endpoint_list_note_success(endpoint_list_t *list, int index, uint32_t connect_ms);
+
+/**
+ * @brief Record a failed or abandoned connect and start the backoff
+ */
+void endpoint_list_note_failure(endpoint_list_t *list, int index, uint32_t now_ms);
+
+/**
+ * @brief Record an attempt still connecting when another one won the race
+ *
+ * Takes an eighth off the score without a backoff, so a slow endpoint drops
+ * below a faster one over a few connects.
+ */
+void endpoint_list_note_slow(endpoint_list_t *list, int index);
+
+/**
+ * @brief Record that the server announced itself (discovery beacon)
+ *
+ * Ends any backoff, so the endpoint is tried in the next round; the score
+ * is left alone until a connect shows how it does.
+ */
+void endpoint_list_note_announced(endpoint_list_t *list, int index);
+
+/**
+ * @brief Point an endpoint at the address its server has moved to
+ *
+ * Keeps the index (attempts in flight refer to it) and the score; the
+ * backoff is cleared, since it was earned at the old address.
+ */
+void endpoint_list_replace(endpoint_list_t *list, int index, const char *url);
+
+/**
+ * @brief Record an established connection that was lost
+ */
+void endpoint_list_note_drop(endpoint_list_t *list, int index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ENDPOINT_LIST_H */
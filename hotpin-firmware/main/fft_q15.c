@@ -0,0 +1,121 @@
+/*
+ * HotPin Firmware - Fixed-Point FFT
+ *
+ * Device: esp-dsp's radix-2 FFT. dsps_fft2r_sc16 leaves its output in
+ * bit-reversed order and halves every stage, so all log2n stages are
+ * reported as scaled.
+ *
+ * Host: decimation in time. Before each stage the block is checked against
+ * half of full scale; a butterfly output is at most |a| + |b|·sqrt(2) in
+ * each component, so anything above 2^14 / (1 + sqrt(2)) gets the stage
+ * scaled.
+ */
+
+#include <stdbool.h>
+
+#include "fft_q15.h"
+
+#ifdef ESP_PLATFORM
+
+#include "esp_log.h"
+#include "dsps_fft2r.h"
+
+static bool table_ready = false;
+
+void fft_q15_init(void) {
+    if (table_ready) {
+        return;
+    }
+    // NULL: esp-dsp allocates the twiddle table itself
+    esp_err_t err = dsps_fft2r_init_sc16(NULL, FFT_Q15_MAX_LEN);
+    if (err != ESP_OK) {
+        ESP_LOGE("FFT", "esp-dsp FFT init failed: %s", esp_err_to_name(err));
+        return;
+    }
+    table_ready = true;
+}
+
+int fft_q15(int16_t *data, int log2n) {
+    int n = 1 << log2n;
+    dsps_fft2r_sc16(data, n);
+    dsps_bit_rev_sc16_ansi(data, n);
+    return log2n;
+}
+
+#else
+
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Largest magnitude an unscaled stage accepts without overflowing int16
+#define FFT_STAGE_SAFE_MAX  13573   // 32767 / (1 + sqrt(2))
+
+static int16_t twiddle_cos[FFT_Q15_MAX_LEN / 2];
+static int16_t twiddle_sin[FFT_Q15_MAX_LEN / 2];
+static bool twiddles_ready = false;
+
+void fft_q15_init(void) {
+    if (twiddles_ready) {
+        return;
+    }
+    for (int k = 0; k < FFT_Q15_MAX_LEN / 2; k++) {
+        twiddle_cos[k] = (int16_t)lround(32767.0 * cos(2.0 * M_PI * k / FFT_Q15_MAX_LEN));
+        twiddle_sin[k] = (int16_t)lround(32767.0 * sin(2.0 * M_PI * k / FFT_Q15_MAX_LEN));
+    }
+    twiddles_ready = true;
+}
+
+static int32_t block_peak(const int16_t *data, int n) {
+    int32_t peak = 0;
+    for (int i = 0; i < 2 * n; i++) {
+        int32_t mag = data[i] < 0 ? -data[i] : data[i];
+        if (mag > peak) {
+            peak = mag;
+        }
+    }
+    return peak;
+}
+
+int fft_q15(int16_t *data, int log2n) {
+    int n = 1 << log2n;
+    for (int i = 1, j = 0; i < n; i++) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j |= bit;
+        if (i < j) {
+            int16_t t = data[2 * i]; data[2 * i] = data[2 * j]; data[2 * j] = t;
+            t = data[2 * i + 1]; data[2 * i + 1] = data[2 * j + 1]; data[2 * j + 1] = t;
+        }
+    }
+
+    int scaled = 0;
+    for (int half = 1; half < n; half <<= 1) {
+        int shift = block_peak(data, n) > FFT_STAGE_SAFE_MAX ? 1 : 0;
+        int step = FFT_Q15_MAX_LEN / (2 * half);
+        scaled += shift;
+        for (int start = 0; start < n; start += half << 1) {
+            for (int k = 0; k < half; k++) {
+                int16_t *a = &data[2 * (start + k)];
+                int16_t *b = &data[2 * (start + k + half)];
+                int32_t wr = twiddle_cos[k * step];
+                int32_t wi = -twiddle_sin[k * step];
+                int32_t tr = (b[0] * wr - b[1] * wi) >> 15;
+                int32_t ti = (b[0] * wi + b[1] * wr) >> 15;
+                int32_t ar = a[0];
+                int32_t ai = a[1];
+                a[0] = (int16_t)((ar + tr) >> shift);
+                a[1] = (int16_t)((ai + ti) >> shift);
+                b[0] = (int16_t)((ar - tr) >> shift);
+                b[1] = (int16_t)((ai - ti) >> shift);
+            }
+        }
+    }
+    return scaled;
+}
+
+#endif
@@ -0,0 +1,47 @@
+/*
+ * HotPin Firmware - Fixed-Point FFT
+ *
+ * In-place radix-2 complex FFT on interleaved Q15 data (re, im pairs), up
+ * to FFT_Q15_MAX_LEN points. Used by the keyword spotter and the noise
+ * suppressor. On the device it is esp-dsp's dsps_fft2r_sc16, which uses
+ * the ESP32's multiply-accumulate instructions and halves every stage. The
+ * host build (tools/ harnesses) uses a portable version that halves a
+ * stage only when a butterfly could overflow (block floating point).
+ * Either way the number of halved stages is returned, so callers fold it
+ * back into their own scale.
+ *
+ * An inverse transform is the forward transform of the conjugate: negate
+ * the imaginary part before and after, and divide by the length.
+ */
+
+#ifndef FFT_Q15_H
+#define FFT_Q15_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FFT_Q15_MAX_LOG2    9
+#define FFT_Q15_MAX_LEN     (1 << FFT_Q15_MAX_LOG2)
+
+/**
+ * @brief Build the twiddle table (call once; later calls are no-ops)
+ */
+void fft_q15_init(void);
+
+/**
+ * @brief Forward FFT of 2^log2n points, in place
+ *
+ * @param data 2 * 2^log2n values: re[0], im[0], re[1], im[1], ...
+ * @return Stages scaled by 1/2: the true transform is the result times
+ *         2^return
+ */
+int fft_q15(int16_t *data, int log2n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FFT_Q15_H */
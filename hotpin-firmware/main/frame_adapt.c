@@ -0,0 +1,97 @@
+/*
+ * HotPin Firmware - Adaptive Uplink Frame Size
+ *
+ * No ESP-IDF dependencies: see frame_adapt.h.
+ */
+
+#include "frame_adapt.h"
+
+static uint32_t clamp_frame(const frame_adapt_t *fa, uint32_t bytes) {
+    if (bytes < fa->min_bytes) {
+        bytes = fa->min_bytes;
+    }
+    if (bytes > fa->max_bytes) {
+        bytes = fa->max_bytes;
+    }
+    return bytes & ~1u;  // Whole PCM16 samples
+}
+
+// Smallest frame that keeps FRAME_ADAPT_MAX_IN_FLIGHT frames per round trip
+static uint32_t rtt_floor_bytes(const frame_adapt_t *fa) {
+    uint64_t bytes = (uint64_t)fa->rtt_us * fa->bytes_per_ms / 1000 / FRAME_ADAPT_MAX_IN_FLIGHT;
+    return bytes > UINT32_MAX ? UINT32_MAX : (uint32_t)bytes;
+}
+
+static void set_frame(frame_adapt_t *fa, uint32_t bytes) {
+    bytes = clamp_frame(fa, bytes);
+    if (bytes == fa->frame_bytes) {
+        return;
+    }
+    if (bytes > fa->frame_bytes) {
+        fa->grows++;
+    } else {
+        fa->shrinks++;
+    }
+    fa->frame_bytes = bytes;
+    fa->good_ms = 0;
+    fa->settle = FRAME_ADAPT_SETTLE_FRAMES;
+}
+
+void frame_adapt_init(frame_adapt_t *fa, uint32_t bytes_per_ms, uint32_t min_bytes, uint32_t max_bytes) {
+    *fa = (frame_adapt_t){ .bytes_per_ms = bytes_per_ms ? bytes_per_ms : 1 };
+
+    uint32_t floor_bytes = FRAME_ADAPT_MIN_MS * fa->bytes_per_ms;
+    uint32_t ceiling_bytes = FRAME_ADAPT_MAX_MS * fa->bytes_per_ms;
+    fa->min_bytes = min_bytes > floor_bytes ? min_bytes : floor_bytes;
+    fa->max_bytes = max_bytes < ceiling_bytes ? max_bytes : ceiling_bytes;
+    if (fa->max_bytes < fa->min_bytes) {
+        fa->max_bytes = fa->min_bytes;
+    }
+    fa->frame_bytes = clamp_frame(fa, FRAME_ADAPT_START_MS * fa->bytes_per_ms);
+}
+
+void frame_adapt_note_sent(frame_adapt_t *fa, uint32_t bytes, uint32_t send_us, uint32_t queued_frames) {
+    if (bytes == 0) {
+        return;
+    }
+    uint64_t frame_us = (uint64_t)bytes * 1000 / fa->bytes_per_ms;
+    uint64_t util = frame_us ? (uint64_t)send_us * 1000 / frame_us : 0;
+    if (util > 10000) {
+        util = 10000;  // A single stall must not dominate the average
+    }
+    fa->util_permille = (fa->util_permille * 3 + (uint32_t)util) / 4;
+
+    if (fa->settle > 0) {
+        fa->settle--;
+        return;
+    }
+
+    bool backlog = queued_frames >= FRAME_ADAPT_QUEUE_HIGH;
+    if (backlog || fa->util_permille > FRAME_ADAPT_HIGH_PERMILLE || fa->frame_bytes < rtt_floor_bytes(fa)) {
+        set_frame(fa, fa->frame_bytes * 2);
+        return;
+    }
+
+    uint32_t smaller = clamp_frame(fa, fa->frame_bytes / 2);
+    if (queued_frames > 0 || fa->util_permille >= FRAME_ADAPT_LOW_PERMILLE ||
+        smaller == fa->frame_bytes || smaller < rtt_floor_bytes(fa)) {
+        fa->good_ms = 0;
+        return;
+    }
+    fa->good_ms += (uint32_t)(frame_us / 1000);
+    if (fa->good_ms >= FRAME_ADAPT_HOLD_MS) {
+        set_frame(fa, smaller);
+    }
+}
+
+void frame_adapt_note_rtt(frame_adapt_t *fa, uint32_t rtt_us) {
+    fa->rtt_us = fa->rtt_us ? (fa->rtt_us * 7 + rtt_us) / 8 : rtt_us;
+}
+
+uint32_t frame_adapt_bytes(const frame_adapt_t *fa) {
+    return fa->frame_bytes;
+}
+
+uint32_t frame_adapt_ms(const frame_adapt_t *fa) {
+    return fa->frame_bytes / fa->bytes_per_ms;
+}
@@ -0,0 +1,95 @@
+/*
+ * HotPin Firmware - Adaptive Uplink Frame Size
+ *
+ * Picks how much audio goes into each uplink frame, between 20 ms and the
+ * session's maximum (500 ms). Short frames cut the delay between the end of
+ * speech and the last byte at the server; long frames spread the per-frame
+ * cost (metadata message, WebSocket header, TCP segment, send task wakeup)
+ * over more audio. The controller uses three signals:
+ *
+ *   - send time: how long the WebSocket took to put each frame on the wire,
+ *     as a fraction of the audio it holds (utilization, averaged)
+ *   - queue depth: frames captured but not yet sent
+ *   - round trip: from the server's chunk acks; frames are kept long enough
+ *     that no more than FRAME_ADAPT_MAX_IN_FLIGHT are unacknowledged
+ *
+ * A backlog, high utilization or a round-trip floor above the current size
+ * doubles the frame at once. The frame is halved only after FRAME_ADAPT_HOLD_MS
+ * of audio has been sent with an empty queue and utilization under the low
+ * mark, so a marginal link does not flap between two sizes.
+ *
+ * No ESP-IDF dependencies: the same code runs in the capture path
+ * (audio_handling.c) and in the host simulation (tools/frame_adapt_sim.c).
+ */
+
+#ifndef FRAME_ADAPT_H
+#define FRAME_ADAPT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FRAME_ADAPT_MIN_MS          20
+#define FRAME_ADAPT_MAX_MS          500
+#define FRAME_ADAPT_START_MS        160     // Until the link has been measured
+#define FRAME_ADAPT_HIGH_PERMILLE   800     // Grow above this utilization
+#define FRAME_ADAPT_LOW_PERMILLE    350     // Shrink only below this
+#define FRAME_ADAPT_QUEUE_HIGH      2       // Frames waiting that count as a backlog
+#define FRAME_ADAPT_HOLD_MS         1000    // Good audio needed before shrinking
+#define FRAME_ADAPT_SETTLE_FRAMES   2       // Frames ignored after a change
+#define FRAME_ADAPT_MAX_IN_FLIGHT   8       // Unacknowledged frames per round trip
+
+typedef struct {
+    uint32_t bytes_per_ms;          // 32 for 16 kHz PCM16
+    uint32_t min_bytes;
+    uint32_t max_bytes;
+    uint32_t frame_bytes;           // Current choice
+    uint32_t util_permille;         // Averaged send time / frame duration
+    uint32_t rtt_us;                // Averaged, 0 until the first ack
+    uint32_t good_ms;               // Audio sent since the link last looked busy
+    uint32_t settle;                // Frames left before the next decision
+    uint32_t grows;
+    uint32_t shrinks;
+} frame_adapt_t;
+
+/**
+ * @brief Start over with new limits (on a new session profile)
+ *
+ * @param bytes_per_ms Audio bytes per millisecond
+ * @param min_bytes    Smallest frame the server accepts, raised to 20 ms
+ * @param max_bytes    Largest frame, at most 500 ms
+ */
+void frame_adapt_init(frame_adapt_t *fa, uint32_t bytes_per_ms, uint32_t min_bytes, uint32_t max_bytes);
+
+/**
+ * @brief Record a frame handed to the network
+ *
+ * @param bytes         Frame size
+ * @param send_us       Time the send call took
+ * @param queued_frames Frames still waiting to be sent behind it
+ */
+void frame_adapt_note_sent(frame_adapt_t *fa, uint32_t bytes, uint32_t send_us, uint32_t queued_frames);
+
+/**
+ * @brief Record a round trip (frame queued -> server ack)
+ */
+void frame_adapt_note_rtt(frame_adapt_t *fa, uint32_t rtt_us);
+
+/**
+ * @brief Bytes for the next frame (even, within the limits)
+ */
+uint32_t frame_adapt_bytes(const frame_adapt_t *fa);
+
+/**
+ * @brief Duration of the current frame size in milliseconds
+ */
+uint32_t frame_adapt_ms(const frame_adapt_t *fa);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FRAME_ADAPT_H */
@@ -13,7 +13,10 @@ QueueHandle_t q_free_chunks = NULL;
 QueueHandle_t q_capture_to_send = NULL;
 QueueHandle_t q_playback = NULL;
 QueueHandle_t q_ws_messages = NULL;  // WebSocket message queue
-SemaphoreHandle_t state_mutex = NULL;
+QueueHandle_t q_ws_inbound = NULL;
+QueueHandle_t q_state_effects = NULL;
+QueueHandle_t q_earcons = NULL;
+EventGroupHandle_t state_events = NULL;
 SemaphoreHandle_t i2s_mutex = NULL;
 uint32_t next_seq = 0;
 bool psram_available = false;
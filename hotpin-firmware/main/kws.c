@@ -0,0 +1,518 @@
+/*
+ * HotPin Firmware - Keyword Spotter
+ *
+ * Front end per frame: block-normalize the samples, Hamming window, 512
+ * point radix-2 FFT in Q15 (fft_q15.c), power spectrum,
+ * 40 triangular mel bands (20 Hz - 4 kHz), log2 in Q8 and a DCT-II down to
+ * KWS_MFCC_COEFFS. The block normalization shift and the FFT scaling are
+ * folded back in the log domain, so quiet and loud input land on the same
+ * scale without losing bits in the FFT.
+ *
+ * Floating point is only used to build the tables and for the final
+ * softmax. No ESP-IDF dependencies: see kws.h.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "fft_q15.h"
+#include "kws.h"
+
+#define FFT_STAGES          9       // log2(KWS_FFT_LEN)
+#define SPECTRUM_BINS       (KWS_FFT_LEN / 2 + 1)
+#define MEL_LOW_HZ          20.0f
+#define MEL_HIGH_HZ         4000.0f
+#define MEL_WEIGHTS_MAX     (2 * SPECTRUM_BINS)
+#define MFCC_OUT_SHIFT      (15 + 4)  // Q15 DCT * Q8 log2 -> Q4
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static int16_t window_q15[KWS_FRAME_LEN];
+static int16_t dct_q15[KWS_MFCC_COEFFS][KWS_MEL_BANDS];
+
+// Sparse triangular filters: band b covers mel_first[b] .. + mel_len[b]
+static uint16_t mel_first[KWS_MEL_BANDS];
+static uint16_t mel_len[KWS_MEL_BANDS];
+static uint16_t mel_weight_start[KWS_MEL_BANDS];
+static int16_t mel_weights[MEL_WEIGHTS_MAX];
+
+static bool tables_ready = false;
+
+static float hz_to_mel(float hz) {
+    return 1127.0f * logf(1.0f + hz / 700.0f);
+}
+
+static float mel_to_hz(float mel) {
+    return 700.0f * (expf(mel / 1127.0f) - 1.0f);
+}
+
+static int16_t to_q15(double value) {
+    long q = lround(value * 32767.0);
+    return (int16_t)(q > 32767 ? 32767 : (q < -32768 ? -32768 : q));
+}
+
+void kws_init(void) {
+    if (tables_ready) {
+        return;
+    }
+
+    for (int n = 0; n < KWS_FRAME_LEN; n++) {
+        window_q15[n] = to_q15(0.54 - 0.46 * cos(2.0 * M_PI * n / (KWS_FRAME_LEN - 1)));
+    }
+    fft_q15_init();
+
+    // Band edges equally spaced on the mel scale
+    float mel_low = hz_to_mel(MEL_LOW_HZ);
+    float mel_step = (hz_to_mel(MEL_HIGH_HZ) - mel_low) / (KWS_MEL_BANDS + 1);
+    float bin_hz = (float)KWS_SAMPLE_RATE / KWS_FFT_LEN;
+    int used = 0;
+    for (int b = 0; b < KWS_MEL_BANDS; b++) {
+        float left = mel_low + b * mel_step;
+        float center = left + mel_step;
+        float right = center + mel_step;
+
+        mel_weight_start[b] = (uint16_t)used;
+        mel_first[b] = 0;
+        mel_len[b] = 0;
+        for (int k = 1; k < SPECTRUM_BINS && used < MEL_WEIGHTS_MAX; k++) {
+            float mel = hz_to_mel(k * bin_hz);
+            float weight = 0.0f;
+            if (mel > left && mel < right) {
+                weight = mel <= center ? (mel - left) / mel_step : (right - mel) / mel_step;
+            }
+            if (weight <= 0.0f) {
+                if (mel_len[b] > 0) {
+                    break;
+                }
+                continue;
+            }
+            if (mel_len[b] == 0) {
+                mel_first[b] = (uint16_t)k;
+            }
+            mel_weights[used++] = to_q15(weight);
+            mel_len[b]++;
+        }
+        // Narrow low bands can fall between bins; take the nearest one
+        if (mel_len[b] == 0 && used < MEL_WEIGHTS_MAX) {
+            mel_first[b] = (uint16_t)lroundf(mel_to_hz(center) / bin_hz);
+            mel_weights[used++] = 32767;
+            mel_len[b] = 1;
+        }
+    }
+
+    // Orthonormal DCT-II
+    for (int k = 0; k < KWS_MFCC_COEFFS; k++) {
+        double scale = sqrt((k == 0 ? 1.0 : 2.0) / KWS_MEL_BANDS);
+        for (int m = 0; m < KWS_MEL_BANDS; m++) {
+            dct_q15[k][m] = to_q15(scale * cos(M_PI * k * (m + 0.5) / KWS_MEL_BANDS));
+        }
+    }
+
+    tables_ready = true;
+}
+
+// log2(x) in Q8, with a quadratic correction on the mantissa (error < 0.01)
+static int32_t log2_q8(uint64_t x) {
+    if (x == 0) {
+        return 0;
+    }
+    int n = 63 - __builtin_clzll(x);
+    uint32_t frac = (uint32_t)(n >= 8 ? (x >> (n - 8)) : (x << (8 - n))) & 0xFF;
+    return n * 256 + (int32_t)frac + (int32_t)((frac * (256 - frac) * 89) >> 16);
+}
+
+void kws_mfcc(const int16_t *frame, int16_t *mfcc) {
+    int16_t x[2 * KWS_FFT_LEN];     // Interleaved re, im
+
+    // Block normalization: use the full range, leaving one bit of headroom
+    // for the complex butterflies
+    int32_t peak = 0;
+    for (int n = 0; n < KWS_FRAME_LEN; n++) {
+        int32_t mag = frame[n] < 0 ? -frame[n] : frame[n];
+        if (mag > peak) {
+            peak = mag;
+        }
+    }
+    int norm = 0;
+    while (peak > 0 && norm < 15 && (peak << (norm + 1)) <= 16383) {
+        norm++;
+    }
+
+    for (int n = 0; n < KWS_FRAME_LEN; n++) {
+        x[2 * n] = (int16_t)(((int32_t)frame[n] * (1 << norm) * window_q15[n]) >> 15);
+        x[2 * n + 1] = 0;
+    }
+    memset(&x[2 * KWS_FRAME_LEN], 0, 2 * (KWS_FFT_LEN - KWS_FRAME_LEN) * sizeof(int16_t));
+
+    int fft_scale = fft_q15(x, FFT_STAGES);
+
+    uint32_t power[SPECTRUM_BINS];
+    for (int k = 0; k < SPECTRUM_BINS; k++) {
+        power[k] = (uint32_t)(x[2 * k] * x[2 * k]) + (uint32_t)(x[2 * k + 1] * x[2 * k + 1]);
+    }
+
+    // Undo the FFT scaling, the Q15 mel weights and the normalization shift
+    const int32_t log_offset = (2 * fft_scale - 15 - 2 * norm) * 256;
+    int32_t log_mel[KWS_MEL_BANDS];
+    for (int b = 0; b < KWS_MEL_BANDS; b++) {
+        uint64_t energy = 0;
+        const int16_t *weights = &mel_weights[mel_weight_start[b]];
+        for (int i = 0; i < mel_len[b]; i++) {
+            energy += (uint64_t)power[mel_first[b] + i] * (uint32_t)weights[i];
+        }
+        log_mel[b] = log2_q8(energy) + log_offset;
+    }
+
+    for (int k = 0; k < KWS_MFCC_COEFFS; k++) {
+        int64_t acc = 0;
+        for (int m = 0; m < KWS_MEL_BANDS; m++) {
+            acc += (int64_t)log_mel[m] * dct_q15[k][m];
+        }
+        int64_t value = acc >> MFCC_OUT_SHIFT;
+        mfcc[k] = (int16_t)(value > 32767 ? 32767 : (value < -32768 ? -32768 : value));
+    }
+}
+
+void kws_frontend_reset(kws_frontend_t *fe) {
+    memset(fe, 0, sizeof(*fe));
+}
+
+int kws_frontend_push(kws_frontend_t *fe, const int16_t *samples, size_t count) {
+    int frames = 0;
+    while (count > 0) {
+        size_t take = KWS_FRAME_LEN - fe->fill;
+        if (take > count) {
+            take = count;
+        }
+        memcpy(&fe->samples[fe->fill], samples, take * sizeof(int16_t));
+        fe->fill += (int)take;
+        samples += take;
+        count -= take;
+
+        if (fe->fill == KWS_FRAME_LEN) {
+            kws_mfcc(fe->samples, fe->features[fe->head]);
+            fe->head = (fe->head + 1) % KWS_MAX_FRAMES;
+            if (fe->count < KWS_MAX_FRAMES) {
+                fe->count++;
+            }
+            memmove(fe->samples, &fe->samples[KWS_HOP_LEN], (KWS_FRAME_LEN - KWS_HOP_LEN) * sizeof(int16_t));
+            fe->fill = KWS_FRAME_LEN - KWS_HOP_LEN;
+            frames++;
+        }
+    }
+    return frames;
+}
+
+bool kws_frontend_ready(const kws_frontend_t *fe, const kws_model_t *model) {
+    return model->header && fe->count >= model->header->n_frames;
+}
+
+// Output shape and parameter counts of one layer
+typedef struct {
+    int h, w, c;
+    size_t weights;
+    int channels;       // Entries in the bias/multiplier/shift arrays
+    uint32_t macs;
+} layer_shape_t;
+
+static int ceil_div(int a, int b) {
+    return (a + b - 1) / b;
+}
+
+static bool layer_output_shape(const kws_layer_t *layer, int h, int w, int c, layer_shape_t *out) {
+    bool spatial = layer->type == KWS_LAYER_CONV2D || layer->type == KWS_LAYER_DWCONV2D;
+    if (spatial && (!layer->kernel_h || !layer->kernel_w || !layer->stride_h || !layer->stride_w)) {
+        return false;
+    }
+
+    switch (layer->type) {
+        case KWS_LAYER_CONV2D:
+            *out = (layer_shape_t){ ceil_div(h, layer->stride_h), ceil_div(w, layer->stride_w), layer->out_channels,
+                                    (size_t)layer->out_channels * layer->kernel_h * layer->kernel_w * c,
+                                    layer->out_channels, 0 };
+            break;
+        case KWS_LAYER_DWCONV2D:
+            *out = (layer_shape_t){ ceil_div(h, layer->stride_h), ceil_div(w, layer->stride_w), c,
+                                    (size_t)layer->kernel_h * layer->kernel_w * c, c, 0 };
+            break;
+        case KWS_LAYER_POINTWISE:
+            *out = (layer_shape_t){ h, w, layer->out_channels, (size_t)layer->out_channels * c, layer->out_channels, 0 };
+            break;
+        case KWS_LAYER_AVGPOOL:
+            *out = (layer_shape_t){ 1, 1, c, 0, 0, 0 };
+            break;
+        case KWS_LAYER_FC:
+            *out = (layer_shape_t){ 1, 1, layer->out_channels, (size_t)layer->out_channels * h * w * c,
+                                    layer->out_channels, 0 };
+            break;
+        default:
+            return false;
+    }
+    // Every weight is used once per output position; pooling adds each input once
+    out->macs = layer->type == KWS_LAYER_AVGPOOL ? (uint32_t)(h * w * c) :
+                layer->type == KWS_LAYER_FC ? (uint32_t)out->weights :
+                (uint32_t)(out->weights * out->h * out->w);
+    return out->c > 0;
+}
+
+static bool blob_range_ok(const kws_model_t *model, uint32_t offset, size_t bytes, size_t align) {
+    return offset % align == 0 && offset <= model->size && bytes <= model->size - offset;
+}
+
+bool kws_model_load(kws_model_t *model, const void *blob, size_t size) {
+    memset(model, 0, sizeof(*model));
+    if (!blob || size < sizeof(kws_model_header_t)) {
+        return false;
+    }
+
+    const kws_model_header_t *header = blob;
+    if (header->magic != KWS_MODEL_MAGIC || header->version != KWS_MODEL_VERSION ||
+        header->layer_count == 0 || header->n_frames == 0 || header->n_frames > KWS_MAX_FRAMES ||
+        header->n_mfcc == 0 || header->n_mfcc > KWS_MFCC_COEFFS ||
+        header->n_classes < 2 || header->n_classes > KWS_MAX_CLASSES ||
+        header->wake_class >= header->n_classes ||
+        header->input_shift < -31 || header->input_shift > 30) {
+        return false;
+    }
+    if (size - sizeof(kws_model_header_t) < (size_t)header->layer_count * sizeof(kws_layer_t)) {
+        return false;
+    }
+
+    model->blob = blob;
+    model->size = size;
+    model->header = header;
+    model->layers = (const kws_layer_t*)(header + 1);
+
+    int h = header->n_frames, w = header->n_mfcc, c = 1;
+    size_t max_activation = (size_t)h * w * c;
+    for (int i = 0; i < header->layer_count; i++) {
+        const kws_layer_t *layer = &model->layers[i];
+        layer_shape_t shape;
+        if (!layer_output_shape(layer, h, w, c, &shape) ||
+            !blob_range_ok(model, layer->weights_offset, shape.weights, 1) ||
+            !blob_range_ok(model, layer->bias_offset, shape.channels * sizeof(int32_t), 4) ||
+            !blob_range_ok(model, layer->multiplier_offset, shape.channels * sizeof(int32_t), 4) ||
+            !blob_range_ok(model, layer->shift_offset, shape.channels * sizeof(int32_t), 4)) {
+            memset(model, 0, sizeof(*model));
+            return false;
+        }
+        const int32_t *shifts = (const int32_t*)(model->blob + layer->shift_offset);
+        for (int ch = 0; ch < shape.channels; ch++) {
+            if (shifts[ch] < -31 || shifts[ch] > 30) {
+                memset(model, 0, sizeof(*model));
+                return false;
+            }
+        }
+
+        model->macs += shape.macs;
+        h = shape.h;
+        w = shape.w;
+        c = shape.c;
+        size_t activation = (size_t)h * w * c;
+        if (activation > max_activation) {
+            max_activation = activation;
+        }
+    }
+
+    if (h * w * c != header->n_classes) {
+        memset(model, 0, sizeof(*model));
+        return false;
+    }
+    model->arena_bytes = 2 * ((max_activation + 3) & ~(size_t)3);
+    return true;
+}
+
+// out = (acc * mult) >> (31 - shift), rounded
+static inline int32_t requantize(int32_t acc, int32_t mult, int32_t shift) {
+    int total = 31 - shift;
+    int64_t product = (int64_t)acc * mult;
+    return (int32_t)((product + ((int64_t)1 << (total - 1))) >> total);
+}
+
+static inline int8_t saturate(int32_t value, int32_t low) {
+    return (int8_t)(value > 127 ? 127 : (value < low ? low : value));
+}
+
+// Spatial convolution (full or depthwise) with 'same' padding
+static void run_conv(const kws_model_t *model, const kws_layer_t *layer, bool depthwise,
+                     const int8_t *in, int h, int w, int c, int32_t in_zp,
+                     int8_t *out, const layer_shape_t *shape) {
+    const int8_t *weights = (const int8_t*)(model->blob + layer->weights_offset);
+    const int32_t *bias = (const int32_t*)(model->blob + layer->bias_offset);
+    const int32_t *mult = (const int32_t*)(model->blob + layer->multiplier_offset);
+    const int32_t *shift = (const int32_t*)(model->blob + layer->shift_offset);
+    int kh = layer->kernel_h, kw = layer->kernel_w;
+    int pad_top = ((shape->h - 1) * layer->stride_h + kh - h) / 2;
+    int pad_left = ((shape->w - 1) * layer->stride_w + kw - w) / 2;
+    int32_t low = layer->relu ? layer->output_zero_point : -128;
+    if (pad_top < 0) {
+        pad_top = 0;
+    }
+    if (pad_left < 0) {
+        pad_left = 0;
+    }
+
+    for (int oy = 0; oy < shape->h; oy++) {
+        for (int ox = 0; ox < shape->w; ox++) {
+            int8_t *dst = &out[(oy * shape->w + ox) * shape->c];
+            for (int oc = 0; oc < shape->c; oc++) {
+                int32_t acc = bias[oc];
+                for (int ky = 0; ky < kh; ky++) {
+                    int iy = oy * layer->stride_h - pad_top + ky;
+                    if (iy < 0 || iy >= h) {
+                        continue;   // Padding holds the zero point: contributes nothing
+                    }
+                    for (int kx = 0; kx < kw; kx++) {
+                        int ix = ox * layer->stride_w - pad_left + kx;
+                        if (ix < 0 || ix >= w) {
+                            continue;
+                        }
+                        const int8_t *src = &in[(iy * w + ix) * c];
+                        if (depthwise) {
+                            acc += (src[oc] - in_zp) * weights[(ky * kw + kx) * c + oc];
+                        } else {
+                            const int8_t *wt = &weights[((oc * kh + ky) * kw + kx) * c];
+                            for (int ic = 0; ic < c; ic++) {
+                                acc += (src[ic] - in_zp) * wt[ic];
+                            }
+                        }
+                    }
+                }
+                dst[oc] = saturate(requantize(acc, mult[oc], shift[oc]) + layer->output_zero_point, low);
+            }
+        }
+    }
+}
+
+// Pointwise convolution; FC is the same over a single flattened pixel
+static void run_dense(const kws_model_t *model, const kws_layer_t *layer,
+                      const int8_t *in, int pixels, int c, int32_t in_zp, int8_t *out, int out_c) {
+    const int8_t *weights = (const int8_t*)(model->blob + layer->weights_offset);
+    const int32_t *bias = (const int32_t*)(model->blob + layer->bias_offset);
+    const int32_t *mult = (const int32_t*)(model->blob + layer->multiplier_offset);
+    const int32_t *shift = (const int32_t*)(model->blob + layer->shift_offset);
+    int32_t low = layer->relu ? layer->output_zero_point : -128;
+
+    for (int p = 0; p < pixels; p++) {
+        const int8_t *src = &in[p * c];
+        for (int oc = 0; oc < out_c; oc++) {
+            const int8_t *wt = &weights[oc * c];
+            int32_t acc = bias[oc];
+            for (int ic = 0; ic < c; ic++) {
+                acc += (src[ic] - in_zp) * wt[ic];
+            }
+            out[p * out_c + oc] = saturate(requantize(acc, mult[oc], shift[oc]) + layer->output_zero_point, low);
+        }
+    }
+}
+
+bool kws_infer(const kws_model_t *model, const kws_frontend_t *fe, int8_t *arena, float *probs) {
+    if (!kws_frontend_ready(fe, model)) {
+        return false;
+    }
+    const kws_model_header_t *header = model->header;
+    int8_t *in = arena;
+    int8_t *out = arena + model->arena_bytes / 2;
+
+    // Oldest frame first, each frame's first n_mfcc coefficients
+    for (int f = 0; f < header->n_frames; f++) {
+        int slot = (fe->head - header->n_frames + f + KWS_MAX_FRAMES) % KWS_MAX_FRAMES;
+        for (int k = 0; k < header->n_mfcc; k++) {
+            int32_t q = requantize(fe->features[slot][k], header->input_multiplier, header->input_shift);
+            in[f * header->n_mfcc + k] = saturate(q + header->input_zero_point, -128);
+        }
+    }
+
+    int h = header->n_frames, w = header->n_mfcc, c = 1;
+    int32_t zp = header->input_zero_point;
+    for (int i = 0; i < header->layer_count; i++) {
+        const kws_layer_t *layer = &model->layers[i];
+        layer_shape_t shape;
+        layer_output_shape(layer, h, w, c, &shape);
+
+        switch (layer->type) {
+            case KWS_LAYER_CONV2D:
+            case KWS_LAYER_DWCONV2D:
+                run_conv(model, layer, layer->type == KWS_LAYER_DWCONV2D, in, h, w, c, zp, out, &shape);
+                zp = layer->output_zero_point;
+                break;
+            case KWS_LAYER_POINTWISE:
+                run_dense(model, layer, in, h * w, c, zp, out, shape.c);
+                zp = layer->output_zero_point;
+                break;
+            case KWS_LAYER_FC:
+                run_dense(model, layer, in, 1, h * w * c, zp, out, shape.c);
+                zp = layer->output_zero_point;
+                break;
+            case KWS_LAYER_AVGPOOL: {
+                // Keeps the input scale and zero point
+                int count = h * w;
+                for (int ch = 0; ch < c; ch++) {
+                    int32_t sum = 0;
+                    for (int p = 0; p < count; p++) {
+                        sum += in[p * c + ch] - zp;
+                    }
+                    int32_t avg = (sum >= 0 ? sum + count / 2 : sum - count / 2) / count;
+                    out[ch] = saturate(avg + zp, -128);
+                }
+                break;
+            }
+        }
+
+        int8_t *t = in;
+        in = out;
+        out = t;
+        h = shape.h;
+        w = shape.w;
+        c = shape.c;
+    }
+
+    // Softmax over the dequantized logits
+    float max_logit = -1e30f;
+    float logits[KWS_MAX_CLASSES];
+    for (int k = 0; k < header->n_classes; k++) {
+        logits[k] = (in[k] - header->output_zero_point) * header->output_scale;
+        if (logits[k] > max_logit) {
+            max_logit = logits[k];
+        }
+    }
+    float total = 0.0f;
+    for (int k = 0; k < header->n_classes; k++) {
+        probs[k] = expf(logits[k] - max_logit);
+        total += probs[k];
+    }
+    for (int k = 0; k < header->n_classes; k++) {
+        probs[k] /= total;
+    }
+    return true;
+}
+
+void kws_detector_reset(kws_detector_t *det) {
+    memset(det, 0, sizeof(*det));
+}
+
+bool kws_detector_update(kws_detector_t *det, float prob, float threshold, int refractory) {
+    det->history[det->pos] = prob;
+    det->pos = (det->pos + 1) % KWS_SMOOTH_WINDOW;
+    if (det->filled < KWS_SMOOTH_WINDOW) {
+        det->filled++;
+    }
+
+    float sum = 0.0f;
+    for (int i = 0; i < det->filled; i++) {
+        sum += det->history[i];
+    }
+    det->last_score = sum / det->filled;
+
+    if (det->refractory > 0) {
+        det->refractory--;
+        return false;
+    }
+    if (det->filled == KWS_SMOOTH_WINDOW && det->last_score >= threshold) {
+        det->refractory = refractory;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,177 @@
+/*
+ * HotPin Firmware - Keyword Spotter
+ *
+ * Fixed-point MFCC front end and an int8 interpreter for small DS-CNN
+ * style classifiers. Audio is framed at 30 ms with a 20 ms hop; each frame
+ * becomes KWS_MFCC_COEFFS cepstral coefficients, and the classifier sees
+ * the last second (KWS_MAX_FRAMES frames) of them.
+ *
+ * The model is a flat blob (kws_model_header_t, a layer table, then int8
+ * weights, int32 biases and per-channel requantization parameters) that is
+ * used in place, so it can be executed straight from memory-mapped flash.
+ * tools/pack_kws_model.py writes it.
+ *
+ * No ESP-IDF dependencies: the same code runs on the device (wake_word.c)
+ * and in the host evaluation harness (tools/kws_eval.c).
+ */
+
+#ifndef KWS_H
+#define KWS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define KWS_SAMPLE_RATE         16000
+#define KWS_FRAME_LEN           480     // 30 ms
+#define KWS_HOP_LEN             320     // 20 ms
+#define KWS_FFT_LEN             512
+#define KWS_MEL_BANDS           40
+#define KWS_MFCC_COEFFS         10
+#define KWS_MAX_FRAMES          49      // 1 s of hops
+#define KWS_MAX_CLASSES         16
+#define KWS_SMOOTH_WINDOW       3       // Posteriors averaged by the detector
+
+#define KWS_MODEL_MAGIC         0x574B5048u  // "HPKW"
+#define KWS_MODEL_VERSION       1
+
+typedef enum {
+    KWS_LAYER_CONV2D = 0,       // Full convolution, weights [out][kh][kw][in]
+    KWS_LAYER_DWCONV2D,         // Depthwise, weights [kh][kw][channels]
+    KWS_LAYER_POINTWISE,        // 1x1 convolution, weights [out][in]
+    KWS_LAYER_AVGPOOL,          // Global average pool, no parameters
+    KWS_LAYER_FC,               // Fully connected over the flattened input, weights [out][in]
+} kws_layer_type_t;
+
+// Activations are int8 HWC (frames x coefficients x channels). Weights are
+// symmetric (zero point 0); each output channel has its own Q31 multiplier
+// and shift, applied as in TFLite: out = zp + (acc * mult) >> (31 - shift).
+typedef struct {
+    uint8_t type;               // kws_layer_type_t
+    uint8_t relu;               // Clamp at the output zero point
+    uint8_t kernel_h;
+    uint8_t kernel_w;
+    uint8_t stride_h;
+    uint8_t stride_w;
+    uint16_t out_channels;      // Output features for FC; ignored by DWCONV2D and AVGPOOL
+    int32_t output_zero_point;
+    uint32_t weights_offset;    // Offsets from the start of the blob
+    uint32_t bias_offset;
+    uint32_t multiplier_offset;
+    uint32_t shift_offset;
+} kws_layer_t;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t layer_count;
+    uint16_t n_frames;          // Input height, at most KWS_MAX_FRAMES
+    uint16_t n_mfcc;            // Input width, at most KWS_MFCC_COEFFS
+    uint16_t n_classes;
+    uint16_t wake_class;        // Index of the wake word in the output
+    int32_t input_multiplier;   // MFCC (Q4 log2 units) -> int8 input
+    int32_t input_shift;
+    int32_t input_zero_point;
+    float output_scale;         // int8 logits -> float
+    int32_t output_zero_point;
+    uint32_t arena_bytes;       // Two activation buffers, from the packer
+    uint32_t reserved[2];
+    // kws_layer_t[layer_count] follows
+} kws_model_header_t;
+
+typedef struct {
+    const uint8_t *blob;
+    size_t size;
+    const kws_model_header_t *header;
+    const kws_layer_t *layers;
+    size_t arena_bytes;         // Recomputed from the layer shapes on load
+    uint32_t macs;              // Multiply-accumulates per inference
+} kws_model_t;
+
+// Streaming MFCC state: sample history for the current frame and a ring of
+// the most recent feature frames
+typedef struct {
+    int16_t samples[KWS_FRAME_LEN];
+    int fill;
+    int16_t features[KWS_MAX_FRAMES][KWS_MFCC_COEFFS];
+    int head;                   // Next feature frame to write
+    int count;                  // Valid frames, up to KWS_MAX_FRAMES
+} kws_frontend_t;
+
+typedef struct {
+    float history[KWS_SMOOTH_WINDOW];
+    int filled;
+    int pos;
+    int refractory;             // Inferences left before another detection
+    float last_score;           // Smoothed posterior of the last update
+} kws_detector_t;
+
+/**
+ * @brief Build the window, mel filterbank and DCT tables (call once)
+ */
+void kws_init(void);
+
+/**
+ * @brief Compute the MFCCs of one KWS_FRAME_LEN frame
+ *
+ * @param frame PCM16 samples
+ * @param mfcc Output: KWS_MFCC_COEFFS coefficients in Q4 log2 units
+ */
+void kws_mfcc(const int16_t *frame, int16_t *mfcc);
+
+/**
+ * @brief Clear the sample history and feature ring
+ */
+void kws_frontend_reset(kws_frontend_t *fe);
+
+/**
+ * @brief Feed PCM16 samples
+ *
+ * @return Number of new feature frames (one per KWS_HOP_LEN samples)
+ */
+int kws_frontend_push(kws_frontend_t *fe, const int16_t *samples, size_t count);
+
+/**
+ * @brief true once a full model window of feature frames is available
+ */
+bool kws_frontend_ready(const kws_frontend_t *fe, const kws_model_t *model);
+
+/**
+ * @brief Validate a model blob and bind it (the blob must stay mapped)
+ *
+ * @return false if the blob is malformed or the model does not fit the
+ *         front end (frames, coefficients, classes)
+ */
+bool kws_model_load(kws_model_t *model, const void *blob, size_t size);
+
+/**
+ * @brief Classify the most recent model window
+ *
+ * @param arena Scratch of at least model->arena_bytes
+ * @param probs Output: softmax over the model classes
+ * @return false if too few frames are buffered
+ */
+bool kws_infer(const kws_model_t *model, const kws_frontend_t *fe, int8_t *arena, float *probs);
+
+/**
+ * @brief Reset the posterior smoothing and refractory period
+ */
+void kws_detector_reset(kws_detector_t *det);
+
+/**
+ * @brief Smooth one wake-word posterior and decide whether it fires
+ *
+ * @param refractory Inferences to ignore after a detection
+ * @return true on a detection
+ */
+bool kws_detector_update(kws_detector_t *det, float prob, float threshold, int refractory);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KWS_H */
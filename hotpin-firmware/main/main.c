@@ -44,6 +44,14 @@
 #include "esp_http_client.h"
 #include "mbedtls/base64.h"
 #include "main.h"
+#include "task_profile.h"
+#include "memory_plan.h"
+#include "audio_spill.h"
+#include "dictation.h"
+#include "earcon.h"
+#include "tts_cache.h"
+#include "wake_word.h"
+#include "runtime_config.h"
 
 // Global state variables are defined in globals.c
 
@@ -65,15 +73,19 @@ void app_main()
     }
     ESP_ERROR_CHECK(ret);
 
+    // Settings pushed by the server on an earlier connection
+    init_runtime_config();
+
     // Generate unique session ID based on device MAC address and timestamp
     init_session_id();
 
-    // Initialize state mutex
-    state_mutex = xSemaphoreCreateMutex();
-    if (!state_mutex) {
-        ESP_LOGE("HOTPIN", "Failed to create state mutex");
+    // Create queues, the state event group and the I2S mutex from static storage
+    if (!init_static_objects()) {
+        ESP_LOGE("HOTPIN", "Failed to create static queues/sync objects");
         return;
     }
+    // State-change broadcast; tasks block on it instead of polling current_state
+    xEventGroupSetBits(state_events, STATE_BIT(CLIENT_STATE_BOOTING) | WS_DISCONNECTED_BIT);
 
     // Initialize PSRAM detection
     if (!init_psram_detection()) {
@@ -90,18 +102,32 @@ void app_main()
     // Small delay to let power stabilize after GPIO initialization
     vTaskDelay(pdMS_TO_TICKS(100));
 
-    // Create queues (must be created before init_chunk_pool)
-    q_free_chunks = xQueueCreate(psram_available ? POOL_COUNT_WITH_PSRAM : POOL_COUNT_NO_PSRAM, sizeof(uint8_t*));
-    q_capture_to_send = xQueueCreate(32, sizeof(audio_chunk_t));  // Buffer for captured chunks
-    q_playback = xQueueCreate(16, sizeof(audio_chunk_t));  // Buffer for playback chunks
-    q_ws_messages = xQueueCreate(16, sizeof(ws_message_t));  // Buffer for WebSocket messages
-
-    if (!q_free_chunks || !q_capture_to_send || !q_playback || !q_ws_messages) {
-        ESP_LOGE("HOTPIN", "Failed to create queues");
-        cleanup_resources();
+    // Fill the free-chunk queue from the static pool (no allocation involved)
+    if (!init_chunk_pool()) {
+        ESP_LOGE("HOTPIN", "Failed to initialize chunk pool");
         return;
     }
 
+    // Mount the flash spill log; chunks left by a previous run are replayed
+    // once the WebSocket connects
+    if (!init_audio_spill()) {
+        ESP_LOGW("HOTPIN", "Audio spill unavailable, chunks are dropped while disconnected");
+    }
+
+    // Long-form dictation store in banked PSRAM (CONFIG_HOTPIN_DICTATION_MODE)
+    init_dictation_store();
+
+    // Replay cache of recent TTS responses (entries live in PSRAM)
+    init_tts_cache();
+
+    // Map the feedback clips in the 'earcons' partition (played from flash)
+    if (!init_earcons()) {
+        ESP_LOGW("HOTPIN", "Earcons unavailable, state feedback is LED only");
+    }
+
+    // Keyword spotter model from the 'kws' partition (CONFIG_HOTPIN_WAKE_WORD)
+    init_wake_word();
+
     // Initialize WiFi (most power intensive operation) first to avoid PSRAM conflicts
     // Use error checking to catch initialization failures
     vTaskDelay(pdMS_TO_TICKS(100)); // Small delay before WiFi init
@@ -128,15 +154,6 @@ void app_main()
     // Small delay to let memory allocation settle after WiFi
     vTaskDelay(pdMS_TO_TICKS(100));
 
-    // Initialize chunk pool (depends on q_free_chunks being created) - after WiFi to reduce memory pressure
-    if (!init_chunk_pool()) {
-        ESP_LOGE("HOTPIN", "Failed to initialize chunk pool");
-        return;
-    }
-
-    // Small delay to let memory pool initialization settle
-    vTaskDelay(pdMS_TO_TICKS(50));
-
     // Small delay after WiFi initialization to let power stabilize
     vTaskDelay(pdMS_TO_TICKS(200));
 
@@ -172,17 +189,12 @@ void app_main()
     // Small delay before creating tasks
     vTaskDelay(pdMS_TO_TICKS(100));
 
-    // Create tasks
-    xTaskCreate(&state_manager_task, "state_manager", TASK_STACK_SIZE_BUTTON, NULL, 5, NULL);
-    xTaskCreate(&button_task, "button", TASK_STACK_SIZE_BUTTON, NULL, 5, NULL);
-    xTaskCreate(&websocket_task, "websocket", TASK_STACK_SIZE_WS, NULL, 5, NULL);  // WebSocket connection and handshake task
-    xTaskCreate(&websocket_message_task, "websocket_message", 8192, NULL, 5, NULL);  // WebSocket message processing task
-    
-    // Only create audio and camera tasks after system is stable
-    xTaskCreate(&audio_capture_task, "audio_capture", TASK_STACK_SIZE_AUDIO_CAPTURE, NULL, 5, NULL);
-    xTaskCreate(&audio_send_task, "audio_send", TASK_STACK_SIZE_AUDIO_SEND, NULL, 5, NULL);
-    xTaskCreate(&audio_playback_task, "audio_playback", TASK_STACK_SIZE_AUDIO_PLAYBACK, NULL, 5, NULL);
-    xTaskCreate(&camera_task, "camera", TASK_STACK_SIZE_CAMERA, NULL, 4, NULL);
+    // Create tasks (core affinity and priorities come from the scheduling profile)
+    if (!start_profile_tasks()) {
+        ESP_LOGE("HOTPIN", "Failed to create all tasks");
+    }
+
+    log_memory_map();
 
     ESP_LOGI("HOTPIN", "All tasks created, system ready");
     // Don't call set_state(CLIENT_STATE_IDLE) here - websocket_task will do it after handshake
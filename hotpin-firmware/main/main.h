@@ -16,6 +16,7 @@
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "freertos/semphr.h"
+#include "freertos/event_groups.h"
 
 #include "esp_system.h"
 #include "esp_mac.h"  // Required for MAC address functions in ESP-IDF v5.4+
@@ -36,6 +37,8 @@
 #include "cJSON.h"
 
 #include "dynamic_config.h"
+#include "state_machine.h"
+#include "perf_stats.h"
 
 #include "sdkconfig.h"
 #include "config.h"  // Generated configuration from .env file
@@ -54,9 +57,14 @@
 // Use values from generated config.h
 #define HOTPIN_WS_URL WEBSOCKET_URL
 #define HOTPIN_WS_TOKEN WEBSOCKET_TOKEN
+#ifndef WEBSOCKET_FALLBACK_URLS
+#define WEBSOCKET_FALLBACK_URLS ""  // config.h from before failover support
+#endif
+#define HOTPIN_WS_FALLBACK_URLS WEBSOCKET_FALLBACK_URLS
 // SESSION_ID will be dynamically generated to be unique per device
 extern char SESSION_ID[32];  // Dynamically generated unique session ID
 void init_session_id(void);  // Function to initialize unique session ID
+#define HOTPIN_FIRMWARE_VERSION "1.0"  // Reported in client_on and hello
 
 // GPIO mapping
 #define GPIO_MIC_SD     2   // I2S data in from INMP441
@@ -79,8 +87,15 @@ void init_session_id(void);  // Function to initialize unique session ID
 #define CHUNK_BYTES         16000 // 8000 samples * 2 bytes per sample
 #define I2S_PORT            I2S_NUM_1  // Prefer I2S1 to avoid camera conflicts
 
+// I2S buffering: the driver's DMA ring and the per-direction bounce buffer
+// live in internal RAM; audio is staged block by block into pool chunks
+#define I2S_DMA_BUF_COUNT   4
+#define I2S_DMA_BUF_LEN     1024  // Frames per DMA buffer (64 ms)
+#define I2S_DMA_RING_BYTES  (I2S_DMA_BUF_COUNT * I2S_DMA_BUF_LEN * 2)
+#define I2S_BOUNCE_BYTES    2048  // 1024 samples, one DMA buffer
+
 // Memory pool configuration
-#define POOL_COUNT_NO_PSRAM     4   // ~64KB pool
+#define POOL_COUNT_NO_PSRAM     2   // ~32KB pool, out of the internal budget
 #define POOL_COUNT_WITH_PSRAM   16  // ~256KB pool
 
 // Task stack sizes
@@ -89,7 +104,17 @@ void init_session_id(void);  // Function to initialize unique session ID
 #define TASK_STACK_SIZE_AUDIO_PLAYBACK  8192
 #define TASK_STACK_SIZE_WS              6144
 #define TASK_STACK_SIZE_BUTTON          3072
+#define TASK_STACK_SIZE_STATE_EFFECT    4096
 #define TASK_STACK_SIZE_CAMERA          12288
+#define TASK_STACK_SIZE_WS_MESSAGE      8192
+#define TASK_STACK_SIZE_TELEMETRY       4096
+#define TASK_STACK_SIZE_WS_DISPATCH     6144
+#define TASK_STACK_SIZE_SELFTEST        4096
+#if CONFIG_HOTPIN_WAKE_WORD
+#define TASK_STACK_SIZE_WAKE_WORD       6144  // MFCC FFT buffers live on the stack
+#else
+#define TASK_STACK_SIZE_WAKE_WORD       2048  // Exits at once
+#endif
 
 // Camera GPIO definitions (AI-Thinker specific)
 #ifdef CONFIG_CAMERA_MODEL_AI_THINKER
@@ -112,17 +137,6 @@ void init_session_id(void);  // Function to initialize unique session ID
 #endif
 
 // Global variables and structs
-typedef enum {
-    CLIENT_STATE_BOOTING = 0,
-    CLIENT_STATE_CONNECTED,
-    CLIENT_STATE_IDLE,
-    CLIENT_STATE_RECORDING,
-    CLIENT_STATE_PROCESSING,
-    CLIENT_STATE_PLAYING,
-    CLIENT_STATE_CAMERA_CAPTURE,
-    CLIENT_STATE_STALLED,
-    CLIENT_STATE_SHUTDOWN
-} client_state_t;
 
 typedef struct {
     uint8_t *data;
@@ -131,6 +145,57 @@ typedef struct {
     TickType_t timestamp;
 } audio_chunk_t;
 
+// Side effects of one accepted transition, consumed by state_effect_task
+typedef struct {
+    client_state_t old_state;
+    client_state_t new_state;
+    uint32_t effects;       // SM_EFFECT_* flags from the transition table
+    int earcon;             // earcon_id_t to play for SM_EFFECT_EARCON
+    int64_t requested_us;   // esp_timer_get_time() when set_state() was called
+} state_effect_t;
+
+// Consistent view of the state machine for readers outside set_state()
+typedef struct {
+    client_state_t state;
+    uint32_t generation;    // Number of accepted transitions so far
+    int64_t entered_us;     // esp_timer_get_time() when the state was entered
+} state_snapshot_t;
+
+// state_events bits: one per client state (set while that state is current
+// and its side effects are applied), plus WebSocket connection bits
+#define STATE_BIT(state)        ((EventBits_t)1 << (state))
+#define STATE_BITS_ALL          (STATE_BIT(CLIENT_STATE_COUNT) - 1)
+#define WS_CONNECTED_BIT        ((EventBits_t)1 << 16)
+#define WS_DISCONNECTED_BIT     ((EventBits_t)1 << 17)
+#define WS_CANCEL_BIT           ((EventBits_t)1 << 18)  // A losing hedged connect is waiting to be stopped
+#define MDNS_CHANGED_BIT        ((EventBits_t)1 << 19)  // Browse results wait for mdns_discovery_apply()
+
+// Task loops that block on state_events, for idle wakeup accounting
+typedef enum {
+    WAKEUP_AUDIO_CAPTURE = 0,
+    WAKEUP_AUDIO_PLAYBACK,
+    WAKEUP_STATE_MANAGER,
+    WAKEUP_WEBSOCKET,
+    WAKEUP_SOURCE_COUNT
+} wakeup_source_t;
+
+// Audio timing counters since boot, reported in telemetry
+typedef struct {
+    uint32_t capture_chunks;
+    uint32_t capture_intervals;         // Consecutive reads within one recording
+    uint64_t capture_jitter_total_us;   // Sum of |interval - chunk period|
+    uint32_t capture_jitter_max_us;
+    uint32_t playback_chunks;
+    uint32_t playback_underruns;        // q_playback ran dry before tts_done
+    uint32_t barge_ins;                 // Playback interrupted by a press
+    uint64_t barge_in_total_us;         // Press -> microphone live
+    uint32_t barge_in_max_us;
+    uint32_t uplink_frame_ms;           // Current live frame length
+    uint32_t uplink_frame_grows;        // Adaptive frame size changes
+    uint32_t uplink_frame_shrinks;
+    uint32_t uplink_rtt_us;             // Averaged chunk queued -> server ack
+} audio_timing_stats_t;
+
 typedef enum {
     BUTTON_STATE_IDLE = 0,
     BUTTON_STATE_PRESSED,
@@ -144,7 +209,9 @@ extern QueueHandle_t q_free_chunks;
 extern QueueHandle_t q_capture_to_send;
 extern QueueHandle_t q_playback;
 extern QueueHandle_t q_ws_messages;  // WebSocket message queue
-extern SemaphoreHandle_t state_mutex;
+extern QueueHandle_t q_state_effects;  // Transition side effects for state_effect_task
+extern QueueHandle_t q_earcons;  // earcon_id_t requests outside a transition, played by state_effect_task
+extern EventGroupHandle_t state_events;  // State-change broadcast, see STATE_BIT()
 extern SemaphoreHandle_t i2s_mutex;
 extern uint32_t next_seq;
 extern bool psram_available;
@@ -152,16 +219,53 @@ extern bool audio_i2s_initialized;
 extern uint8_t *chunk_pool;
 extern int pool_size;
 
+// ws_message_t audio_flags
+#define WS_AUDIO_LIVE       0x01    // A live capture frame, timed for the frame size controller
+#define WS_AUDIO_REPLAY     0x02    // Spilled to flash while the uplink was down
+
 // WebSocket message queue structure
 typedef struct {
     cJSON *json;        // JSON message to send (NULL if binary)
     bool is_binary;     // Flag indicating if this is a binary message
     uint8_t *data;      // Binary data (if is_binary is true)
     size_t len;         // Length of binary data
+    uint8_t channel;    // ws_mux_channel_t of binary data: audio is a pool chunk, the rest malloc'd
+    uint8_t after;      // For JSON, the channel whose queued messages go first (ws_mux.h)
+    uint8_t audio_flags;    // Binary audio: WS_AUDIO_*
+    bool mux_ready;     // JSON "mux_ready": binary messages after it go in slices
+    uint32_t seq;       // Binary audio: its seq; mux_ready: the configure_ws_mux() call it answers
 } ws_message_t;
 
+// Inbound WebSocket message, copied out of the client task for ws_dispatch_task
+typedef enum {
+    WS_INBOUND_TEXT = 0,    // data: malloc'd NUL-terminated JSON
+    WS_INBOUND_BINARY,      // data: chunk from the pool (TTS audio)
+    WS_INBOUND_RECONNECT,   // First connect or connection lost, run reconnect_websocket()
+    WS_INBOUND_SHUTDOWN     // Stop the dispatcher
+} ws_inbound_type_t;
+
+typedef struct {
+    ws_inbound_type_t type;
+    uint8_t *data;
+    size_t len;
+    int64_t received_us;    // esp_timer_get_time() in the client task
+} ws_inbound_t;
+
+// Receive path counters, reported in telemetry
+typedef struct {
+    uint32_t events;            // Client task events handled
+    uint64_t stall_total_us;    // Time the client task spent in websocket_event_handler
+    uint32_t stall_max_us;
+    uint32_t inbound_drops;     // q_ws_inbound full
+    uint32_t dispatched;
+    uint32_t dispatch_max_us;
+    uint32_t budget_overruns;   // Text messages over their handling budget
+    uint32_t playback_drops;    // TTS frames dropped, q_playback full
+} ws_rx_stats_t;
+
 // External reference to WebSocket message queue
 extern QueueHandle_t q_ws_messages;
+extern QueueHandle_t q_ws_inbound;  // Inbound messages for ws_dispatch_task
 extern TaskHandle_t audio_capture_task_handle;
 extern TaskHandle_t audio_send_task_handle;
 extern TaskHandle_t audio_playback_task_handle;
@@ -169,8 +273,13 @@ extern TaskHandle_t audio_playback_task_handle;
 // Function declarations
 void app_main(void);
 void set_state(client_state_t new_state);
-const char* state_to_string(client_state_t state);
+client_state_t get_state(void);  // Atomic read of current_state
+state_snapshot_t get_state_snapshot(void);
+EventBits_t wait_for_state(EventBits_t state_bits, TickType_t timeout);  // Block until one of the states is current
+void record_task_wakeup(wakeup_source_t source);
+void log_task_wakeup_stats(void);
 void update_led_pattern();
+void led_flash_async(int count, uint32_t period_ms);  // Blink without blocking the caller
 bool init_psram_detection();
 bool init_chunk_pool();
 bool init_gpio();
@@ -182,16 +291,38 @@ void button_task(void *pvParameters);
 void audio_capture_task(void *pvParameters);
 void audio_send_task(void *pvParameters);
 void audio_playback_task(void *pvParameters);
+void get_audio_timing_stats(audio_timing_stats_t *stats);
+esp_err_t audio_write_clip(const uint8_t *pcm, size_t len);  // Blocking I2S write, TX mode required
+void audio_playback_end_of_stream(void);  // Go IDLE once queued TTS audio has played
+uint32_t audio_playback_epoch(void);  // Stamp for TTS chunks (audio_chunk_t.seq) entering q_playback
+void audio_playback_flush(void);  // Drop queued TTS audio and cut the chunk being played
+void audio_note_barge_in(int64_t press_us);  // Time press -> microphone live
+void audio_uplink_note_sent(size_t len, uint32_t send_us);  // Audio frame on the wire
+void audio_uplink_note_ack(uint32_t seq);  // Server acked a chunk
+void audio_begin_recording(void);  // recording_started is going out
+void audio_end_recording(cJSON *stop);  // Send recording_stopped after the recording's audio
+bool audio_recording_open(void);  // recording_started sent, its recording_stopped not yet
+bool audio_recording_ending(void);  // recording_stopped still held behind queued or spilled audio
 void websocket_task(void *pvParameters);
 void camera_task(void *pvParameters);
 void state_manager_task(void *pvParameters);
+void state_effect_task(void *pvParameters);  // Executes transition side effects
+void state_effect_wake(void);  // Wake state_effect_task after queueing an earcon
+void log_state_transition_stats(void);
 void config_update_task(void *pvParameters);
 void websocket_message_task(void *pvParameters);  // WebSocket message processing task
 void handle_text_message(char *message, size_t len);
-void handle_binary_message(const uint8_t *data, size_t data_len);
+void handle_binary_message(uint8_t *buf, size_t data_len);  // Takes ownership of a pool chunk
+void ws_dispatch_task(void *pvParameters);  // Handles messages from q_ws_inbound
+void get_ws_rx_stats(ws_rx_stats_t *stats);
 void websocket_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data);
 bool ws_send_json(cJSON *json);
-bool ws_send_binary(uint8_t *data, size_t len);
+bool ws_send_audio(uint32_t seq, uint8_t *data, size_t len, uint8_t flags);  // Takes ownership of a pool chunk
+bool ws_send_json_after(cJSON *json, uint8_t channel);  // Sent once the channel's queued messages have gone
+bool ws_send_bulk(uint8_t channel, uint8_t *data, size_t len);  // Takes ownership of a malloc'd buffer
+void configure_ws_mux(bool enabled);  // Slice binary messages onto channels (session feature "mux")
+bool ws_mux_enabled(void);  // mux_ready sent: binary messages go in slices
+uint32_t ws_outbound_backlog(void);  // Messages queued or held for the WebSocket
 esp_websocket_client_handle_t get_ws_client();
 void cleanup_websocket(void);  // Add WebSocket cleanup function
 void reconnect_websocket(void);  // Add WebSocket reconnection function
@@ -0,0 +1,115 @@
+/*
+ * HotPin Firmware - DNS-SD Result Cache
+ *
+ * No ESP-IDF dependencies: see mdns_cache.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "mdns_cache.h"
+
+void mdns_cache_init(mdns_cache_t *cache) {
+    memset(cache, 0, sizeof(*cache));
+}
+
+bool mdns_cache_build_url(char *out, size_t size, const char *ip, uint16_t port, const char *path, bool tls) {
+    if (!path || path[0] == '\0') {
+        path = "/ws";
+    }
+    int len = snprintf(out, size, "%s://%s:%u%s%s", tls ? "wss" : "ws", ip, port, path[0] == '/' ? "" : "/", path);
+    return len > 0 && (size_t)len < size;
+}
+
+static uint32_t expiry(uint32_t ttl_s, uint32_t now_ms) {
+    if (ttl_s < MDNS_CACHE_MIN_TTL_S) {
+        ttl_s = MDNS_CACHE_MIN_TTL_S;
+    }
+    // Keep the expiry within half the clock's range so the wrap compare works
+    if (ttl_s > 0x7fffffffU / 2000) {
+        ttl_s = 0x7fffffffU / 2000;
+    }
+    return now_ms + ttl_s * 1000;
+}
+
+mdns_cache_change_t mdns_cache_update(mdns_cache_t *cache, const char *instance, const char *url, uint32_t ttl_s,
+                                      uint32_t now_ms, char *old_url) {
+    mdns_cache_entry_t *entry = NULL;
+    for (int i = 0; i < MDNS_CACHE_MAX; i++) {
+        if (cache->entries[i].used && strcmp(cache->entries[i].instance, instance) == 0) {
+            entry = &cache->entries[i];
+            break;
+        }
+    }
+
+    if (ttl_s == 0) {
+        if (!entry) {
+            return MDNS_CACHE_UNCHANGED;
+        }
+        if (old_url) {
+            strcpy(old_url, entry->url);
+        }
+        memset(entry, 0, sizeof(*entry));
+        return MDNS_CACHE_REMOVED;
+    }
+    if (strlen(instance) >= MDNS_CACHE_NAME_LEN || strlen(url) >= ENDPOINT_URL_LEN) {
+        return MDNS_CACHE_UNCHANGED;
+    }
+
+    mdns_cache_change_t change = MDNS_CACHE_UNCHANGED;
+    if (entry) {
+        if (strcmp(entry->url, url) != 0) {
+            if (old_url) {
+                strcpy(old_url, entry->url);
+            }
+            strcpy(entry->url, url);
+            change = MDNS_CACHE_MOVED;
+        }
+    } else {
+        // A free entry, else a stale one, else the one expiring first
+        for (int i = 0; i < MDNS_CACHE_MAX; i++) {
+            mdns_cache_entry_t *e = &cache->entries[i];
+            if (!e->used) {
+                entry = e;
+                break;
+            }
+            if (!entry || (e->stale && !entry->stale) ||
+                (e->stale == entry->stale && (int32_t)(e->expires_ms - entry->expires_ms) < 0)) {
+                entry = e;
+            }
+        }
+        memset(entry, 0, sizeof(*entry));
+        strcpy(entry->instance, instance);
+        strcpy(entry->url, url);
+        entry->used = 1;
+        change = MDNS_CACHE_ADDED;
+    }
+    entry->ttl_s = ttl_s;
+    entry->expires_ms = expiry(ttl_s, now_ms);
+    entry->stale = 0;
+    return change;
+}
+
+int mdns_cache_expire(mdns_cache_t *cache, uint32_t now_ms) {
+    int expired = 0;
+    for (int i = 0; i < MDNS_CACHE_MAX; i++) {
+        mdns_cache_entry_t *e = &cache->entries[i];
+        if (e->used && !e->stale && (int32_t)(now_ms - e->expires_ms) >= 0) {
+            e->stale = 1;
+            expired++;
+        }
+    }
+    return expired;
+}
+
+void mdns_cache_restored(mdns_cache_t *cache, uint32_t now_ms) {
+    for (int i = 0; i < MDNS_CACHE_MAX; i++) {
+        mdns_cache_entry_t *e = &cache->entries[i];
+        if (e->used) {
+            e->instance[MDNS_CACHE_NAME_LEN - 1] = '\0';
+            e->url[ENDPOINT_URL_LEN - 1] = '\0';
+            e->expires_ms = expiry(e->ttl_s, now_ms);
+            e->stale = 1;
+        }
+    }
+}
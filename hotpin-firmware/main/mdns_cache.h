@@ -0,0 +1,99 @@
+/*
+ * HotPin Firmware - DNS-SD Result Cache
+ *
+ * The HotPin servers seen on the network as _hotpin._tcp services, by
+ * instance name, each with the WebSocket URL built from its address, SRV
+ * port and TXT record (path, tls) and the record's TTL. The instance name
+ * is what stays the same when a server moves to another address, so an
+ * update for a known instance with a new URL is reported as a move and
+ * the old URL can be dropped from the endpoint list.
+ *
+ * Times are milliseconds on any clock that wraps at 2^32. No ESP-IDF
+ * dependencies; the mDNS side is in mdns_discovery.c.
+ */
+
+#ifndef MDNS_CACHE_H
+#define MDNS_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "endpoint_list.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MDNS_CACHE_MAX          4
+#define MDNS_CACHE_NAME_LEN     64
+#define MDNS_CACHE_MIN_TTL_S    30      // Shorter TTLs are held this long
+
+typedef enum {
+    MDNS_CACHE_UNCHANGED = 0,   // Known and the same URL; the TTL is refreshed
+    MDNS_CACHE_ADDED,
+    MDNS_CACHE_MOVED,           // Known instance, new URL
+    MDNS_CACHE_REMOVED,         // Goodbye (TTL 0)
+} mdns_cache_change_t;
+
+typedef struct {
+    char instance[MDNS_CACHE_NAME_LEN];
+    char url[ENDPOINT_URL_LEN];     // ws[s]://ip:port/path
+    uint32_t ttl_s;
+    uint32_t expires_ms;            // Stale after this until seen again
+    uint8_t used;
+    uint8_t stale;
+} mdns_cache_entry_t;
+
+typedef struct {
+    mdns_cache_entry_t entries[MDNS_CACHE_MAX];
+} mdns_cache_t;
+
+/**
+ * @brief Start with an empty cache
+ */
+void mdns_cache_init(mdns_cache_t *cache);
+
+/**
+ * @brief Build a WebSocket URL from a DNS-SD result
+ *
+ * @param path TXT "path", NULL or empty for "/ws"
+ * @return false if it does not fit
+ */
+bool mdns_cache_build_url(char *out, size_t size, const char *ip, uint16_t port, const char *path, bool tls);
+
+/**
+ * @brief Record a result for an instance
+ *
+ * A TTL of 0 removes it. When the cache is full a new instance replaces a
+ * stale entry, or else the one closest to expiring.
+ *
+ * @param old_url Set to the previous URL on MDNS_CACHE_MOVED and
+ *                MDNS_CACHE_REMOVED (ENDPOINT_URL_LEN bytes), may be NULL
+ */
+mdns_cache_change_t mdns_cache_update(mdns_cache_t *cache, const char *instance, const char *url, uint32_t ttl_s,
+                                      uint32_t now_ms, char *old_url);
+
+/**
+ * @brief Mark entries whose TTL has run out as stale
+ *
+ * Stale entries are kept, so a server that comes back at a new address is
+ * still recognised as a move.
+ *
+ * @return Number of entries that became stale
+ */
+int mdns_cache_expire(mdns_cache_t *cache, uint32_t now_ms);
+
+/**
+ * @brief Restart the TTLs of entries loaded from NVS
+ *
+ * The device has no clock across a restart, so saved entries are treated
+ * as just seen, and as stale until the network confirms them.
+ */
+void mdns_cache_restored(mdns_cache_t *cache, uint32_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MDNS_CACHE_H */
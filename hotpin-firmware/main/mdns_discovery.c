@@ -0,0 +1,316 @@
+/*
+ * HotPin Firmware - mDNS / DNS-SD Server Discovery
+ */
+
+#include "main.h"
+#include "mdns_discovery.h"
+#include "mdns_cache.h"
+#include "nvs.h"
+
+#ifdef CONFIG_HOTPIN_DISCOVERY_MDNS
+#include "mdns.h"
+
+#define MDNS_SERVICE            "_hotpin"
+#define MDNS_PROTO              "_tcp"
+#define MDNS_NVS_NAMESPACE      "hotpin"
+#define MDNS_NVS_KEY            "mdns_cache"
+#define MDNS_RESOLVE_TIMEOUT_MS 1000
+
+// An announcement from the browse, held for mdns_discovery_apply()
+typedef struct {
+    char instance[MDNS_CACHE_NAME_LEN];
+    char url[ENDPOINT_URL_LEN];     // Empty for a goodbye
+    uint32_t ttl_s;
+} mdns_announcement_t;
+
+static mdns_cache_t cache;
+static mdns_cache_t saved_cache;    // Staging for NVS, outside the lock
+static portMUX_TYPE cache_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool mdns_started = false;
+static bool cache_restored = false;
+static mdns_announcement_t announced[MDNS_CACHE_MAX];
+static int announced_count = 0;
+static mdns_announcement_t applying[MDNS_CACHE_MAX];    // Taken by the app side
+
+static uint32_t now_ms(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static bool start_mdns(void) {
+    if (mdns_started) {
+        return true;
+    }
+    esp_err_t err = mdns_init();
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE("MDNS", "Failed to start mDNS: %s", esp_err_to_name(err));
+        return false;
+    }
+    mdns_started = true;
+    return true;
+}
+
+static void save_cache(void) {
+    portENTER_CRITICAL(&cache_lock);
+    saved_cache = cache;
+    portEXIT_CRITICAL(&cache_lock);
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(MDNS_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(nvs, MDNS_NVS_KEY, &saved_cache, sizeof(saved_cache));
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW("MDNS", "Failed to save the mDNS cache: %s", esp_err_to_name(err));
+    }
+}
+
+// Once, before anything is recorded: the first query runs before the browse
+// starts, and its fresh answer must not be overwritten with NVS contents
+static void restore_cache(void) {
+    if (cache_restored) {
+        return;
+    }
+    cache_restored = true;
+
+    nvs_handle_t nvs;
+    if (nvs_open(MDNS_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return;
+    }
+    size_t len = sizeof(saved_cache);
+    esp_err_t err = nvs_get_blob(nvs, MDNS_NVS_KEY, &saved_cache, &len);
+    nvs_close(nvs);
+    // A different size is a layout from another firmware version
+    if (err != ESP_OK || len != sizeof(saved_cache)) {
+        return;
+    }
+
+    mdns_cache_restored(&saved_cache, now_ms());
+    portENTER_CRITICAL(&cache_lock);
+    cache = saved_cache;
+    portEXIT_CRITICAL(&cache_lock);
+    for (int i = 0; i < MDNS_CACHE_MAX; i++) {
+        if (saved_cache.entries[i].used) {
+            ESP_LOGI("MDNS", "Cached server %s at %s", saved_cache.entries[i].instance, saved_cache.entries[i].url);
+        }
+    }
+}
+
+// TXT value for key, or NULL; values need not be NUL-terminated
+static const char *txt_value(const mdns_result_t *r, const char *key, char *buf, size_t size) {
+    for (size_t i = 0; i < r->txt_count; i++) {
+        if (r->txt[i].key && strcasecmp(r->txt[i].key, key) == 0 && r->txt[i].value) {
+            size_t len = r->txt_value_len ? r->txt_value_len[i] : strlen(r->txt[i].value);
+            if (len >= size) {
+                return NULL;
+            }
+            memcpy(buf, r->txt[i].value, len);
+            buf[len] = '\0';
+            return buf;
+        }
+    }
+    return NULL;
+}
+
+// WebSocket URL for a result, at ip or else its first IPv4 address
+static bool result_url(const mdns_result_t *r, const esp_ip4_addr_t *ip, char *url, size_t size) {
+    for (const mdns_ip_addr_t *a = r->addr; a && !ip; a = a->next) {
+        if (a->addr.type == ESP_IPADDR_TYPE_V4) {
+            ip = &a->addr.u_addr.ip4;
+        }
+    }
+    if (!ip) {
+        return false;
+    }
+
+    char ip_str[16];
+    char port_str[8];
+    char path[64];
+    char tls[8];
+    uint16_t port = r->port;
+    if (txt_value(r, "port", port_str, sizeof(port_str))) {
+        int txt_port = atoi(port_str);
+        if (txt_port > 0 && txt_port <= 65535) {
+            port = (uint16_t)txt_port;
+        }
+    }
+    const char *tls_value = txt_value(r, "tls", tls, sizeof(tls));
+    esp_ip4addr_ntoa(ip, ip_str, sizeof(ip_str));
+    return port != 0 && mdns_cache_build_url(url, size, ip_str, port, txt_value(r, "path", path, sizeof(path)),
+                                             tls_value && strcasecmp(tls_value, "true") == 0);
+}
+
+// Update the cache with one server and pass changes to the endpoint list
+static void record_result(const char *instance, const char *url, uint32_t ttl_s) {
+    char old_url[ENDPOINT_URL_LEN];
+    portENTER_CRITICAL(&cache_lock);
+    mdns_cache_change_t change = mdns_cache_update(&cache, instance, url, ttl_s, now_ms(), old_url);
+    portEXIT_CRITICAL(&cache_lock);
+
+    switch (change) {
+    case MDNS_CACHE_ADDED:
+        ESP_LOGI("MDNS", "Server %s at %s (TTL %"PRIu32" s)", instance, url, ttl_s);
+        note_ws_endpoint_announced(url);
+        break;
+    case MDNS_CACHE_MOVED:
+        ESP_LOGI("MDNS", "Server %s moved from %s to %s", instance, old_url, url);
+        note_ws_endpoint_moved(old_url, url);
+        break;
+    case MDNS_CACHE_REMOVED:
+        // The endpoint stays listed; its connects decide what it is worth
+        ESP_LOGI("MDNS", "Server %s at %s went away", instance, old_url);
+        break;
+    case MDNS_CACHE_UNCHANGED:
+        return;
+    }
+    save_cache();
+}
+
+// Hold an announcement for the app side; a later one for the same instance
+// replaces it
+static bool hold_announcement(const char *instance, const char *url, uint32_t ttl_s) {
+    portENTER_CRITICAL(&cache_lock);
+    int slot = 0;
+    while (slot < announced_count && strcmp(announced[slot].instance, instance) != 0) {
+        slot++;
+    }
+    bool held = slot < MDNS_CACHE_MAX;
+    if (held) {
+        strlcpy(announced[slot].instance, instance, sizeof(announced[slot].instance));
+        strlcpy(announced[slot].url, url, sizeof(announced[slot].url));
+        announced[slot].ttl_s = ttl_s;
+        if (slot == announced_count) {
+            announced_count++;
+        }
+    }
+    portEXIT_CRITICAL(&cache_lock);
+    return held;
+}
+
+// Runs in the mDNS task: no blocking queries or flash writes here. Results
+// are handed to mdns_discovery_apply() in websocket_task.
+static void browse_notify(mdns_result_t *results) {
+    bool held = false;
+    for (const mdns_result_t *r = results; r; r = r->next) {
+        const char *instance = r->instance_name ? r->instance_name : r->hostname;
+        char url[ENDPOINT_URL_LEN];
+        if (!instance) {
+            continue;
+        }
+        if (r->ttl == 0) {
+            url[0] = '\0';
+        } else if (!result_url(r, NULL, url, sizeof(url))) {
+            continue;   // Without an address record yet, wait for the next notification
+        }
+        if (hold_announcement(instance, url, r->ttl)) {
+            held = true;
+        } else {
+            ESP_LOGW("MDNS", "Too many announcements pending, dropping %s", instance);
+        }
+    }
+    if (held) {
+        xEventGroupSetBits(state_events, MDNS_CHANGED_BIT);
+    }
+}
+#endif
+
+void mdns_discovery_apply(void) {
+#ifdef CONFIG_HOTPIN_DISCOVERY_MDNS
+    portENTER_CRITICAL(&cache_lock);
+    int count = announced_count;
+    memcpy(applying, announced, count * sizeof(applying[0]));
+    announced_count = 0;
+    portEXIT_CRITICAL(&cache_lock);
+
+    for (int i = 0; i < count; i++) {
+        record_result(applying[i].instance, applying[i].url, applying[i].ttl_s);
+    }
+
+    portENTER_CRITICAL(&cache_lock);
+    int expired = mdns_cache_expire(&cache, now_ms());
+    portEXIT_CRITICAL(&cache_lock);
+    if (expired > 0) {
+        ESP_LOGD("MDNS", "%d cached server(s) not re-announced within their TTL", expired);
+    }
+#endif
+}
+
+bool init_mdns_discovery(void) {
+#ifdef CONFIG_HOTPIN_DISCOVERY_MDNS
+    restore_cache();
+    if (!start_mdns()) {
+        return false;
+    }
+    if (!mdns_browse_new(MDNS_SERVICE, MDNS_PROTO, browse_notify)) {
+        ESP_LOGE("MDNS", "Failed to start browsing for %s.%s", MDNS_SERVICE, MDNS_PROTO);
+        return false;
+    }
+    ESP_LOGI("MDNS", "Browsing for %s.%s.local", MDNS_SERVICE, MDNS_PROTO);
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool mdns_query_server(char *ws_url, size_t buffer_size, uint32_t timeout_ms) {
+#ifdef CONFIG_HOTPIN_DISCOVERY_MDNS
+    restore_cache();
+
+    // A cached answer still within its TTL needs no query
+    bool cached = false;
+    portENTER_CRITICAL(&cache_lock);
+    mdns_cache_expire(&cache, now_ms());
+    for (int i = 0; i < MDNS_CACHE_MAX && !cached; i++) {
+        const mdns_cache_entry_t *e = &cache.entries[i];
+        if (e->used && !e->stale && strlen(e->url) < buffer_size) {
+            strcpy(ws_url, e->url);
+            cached = true;
+        }
+    }
+    portEXIT_CRITICAL(&cache_lock);
+    if (cached) {
+        ESP_LOGI("MDNS", "HotPin server from the mDNS cache: %s", ws_url);
+        return true;
+    }
+
+    if (!start_mdns()) {
+        return false;
+    }
+    ESP_LOGI("MDNS", "Querying %s.%s.local for %"PRIu32" ms", MDNS_SERVICE, MDNS_PROTO, timeout_ms);
+    mdns_result_t *results = NULL;
+    esp_err_t err = mdns_query_ptr(MDNS_SERVICE, MDNS_PROTO, timeout_ms, 1, &results);
+    if (err != ESP_OK) {
+        ESP_LOGW("MDNS", "Query failed: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    bool found = false;
+    for (const mdns_result_t *r = results; r && !found; r = r->next) {
+        char url[ENDPOINT_URL_LEN];
+        const char *instance = r->instance_name ? r->instance_name : r->hostname;
+        bool have_url = result_url(r, NULL, url, sizeof(url));
+        if (!have_url && r->hostname) {
+            // The answer had no address record: resolve the host
+            esp_ip4_addr_t ip;
+            have_url = mdns_query_a(r->hostname, MDNS_RESOLVE_TIMEOUT_MS, &ip) == ESP_OK &&
+                       result_url(r, &ip, url, sizeof(url));
+        }
+        if (have_url && instance && strlen(url) < buffer_size) {
+            record_result(instance, url, r->ttl);
+            strcpy(ws_url, url);
+            found = true;
+            ESP_LOGI("MDNS", "HotPin server found: %s", ws_url);
+        }
+    }
+    mdns_query_results_free(results);
+    return found;
+#else
+    (void)ws_url;
+    (void)buffer_size;
+    (void)timeout_ms;
+    return false;
+#endif
+}
@@ -0,0 +1,56 @@
+/*
+ * HotPin Firmware - mDNS / DNS-SD Server Discovery
+ *
+ * Finds HotPin servers advertised as _hotpin._tcp (MDNS_ADVERTISE on the
+ * webserver). The TXT record gives the path and the TLS flag, and may
+ * override the SRV port. A one-shot query is part of discover_server();
+ * after start-up a continuous browse follows the announcements, so a server
+ * that moves to another address is picked up without a restart or a
+ * rescan. Results are cached by instance name with their TTL
+ * (mdns_cache.h), in RAM and in NVS, and fed to the endpoint list
+ * (dynamic_config.h).
+ */
+
+#ifndef MDNS_DISCOVERY_H
+#define MDNS_DISCOVERY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Restore the cache from NVS (unless a query already did) and start
+ *        the continuous browse
+ *
+ * Call after init_dynamic_config(), which the results are fed to.
+ *
+ * @return true if the browse is running, false on failure or when
+ *         CONFIG_HOTPIN_DISCOVERY_MDNS is off
+ */
+bool init_mdns_discovery(void);
+
+/**
+ * @brief Apply the announcements the browse has collected
+ *
+ * Updates the cache and the endpoint list and saves both to NVS. The browse
+ * callback runs in the mDNS task, which must not wait on flash, so it only
+ * holds each announcement and sets MDNS_CHANGED_BIT; websocket_task then
+ * calls this.
+ */
+void mdns_discovery_apply(void);
+
+/**
+ * @brief Find a HotPin server with one DNS-SD query
+ *
+ * Answers from the cache when it holds an entry whose TTL has not run out.
+ * The first call restores the cache from NVS before looking.
+ * Returns as soon as the first server answers.
+ *
+ * @param[out] ws_url Output buffer for the server's WebSocket URL
+ * @param[in] buffer_size Size of the output buffer
+ * @param[in] timeout_ms Longest to wait for an answer
+ * @return true if a server was found
+ */
+bool mdns_query_server(char *ws_url, size_t buffer_size, uint32_t timeout_ms);
+
+#endif /* MDNS_DISCOVERY_H */
@@ -0,0 +1,131 @@
+/*
+ * HotPin Firmware - Static Memory Plan
+ *
+ * Storage for the queues, the state event group, the I2S mutex and the
+ * audio chunk pool. Task stacks live in task_profile.c; their size is part
+ * of the internal budget checked below.
+ */
+
+#include "main.h"
+#include "memory_plan.h"
+#include "chunk_pool.h"
+#include "task_profile.h"
+
+#include "esp_attr.h"
+
+// Queue storage stays in internal DRAM: FreeRTOS objects must remain
+// accessible while the flash/PSRAM cache is disabled
+static uint8_t q_state_effects_storage[QUEUE_LEN_STATE_EFFECTS * sizeof(state_effect_t)];
+static uint8_t q_earcons_storage[QUEUE_LEN_EARCONS * sizeof(int)];
+static uint8_t q_free_chunks_storage[CHUNK_POOL_CAPACITY * sizeof(uint8_t*)];
+static uint8_t q_capture_to_send_storage[QUEUE_LEN_CAPTURE_TO_SEND * sizeof(audio_chunk_t)];
+static uint8_t q_playback_storage[QUEUE_LEN_PLAYBACK * sizeof(audio_chunk_t)];
+static uint8_t q_ws_messages_storage[QUEUE_LEN_WS_MESSAGES * sizeof(ws_message_t)];
+static uint8_t q_ws_inbound_storage[QUEUE_LEN_WS_INBOUND * sizeof(ws_inbound_t)];
+
+static StaticQueue_t q_state_effects_buf;
+static StaticQueue_t q_earcons_buf;
+static StaticQueue_t q_free_chunks_buf;
+static StaticQueue_t q_capture_to_send_buf;
+static StaticQueue_t q_playback_buf;
+static StaticQueue_t q_ws_messages_buf;
+static StaticQueue_t q_ws_inbound_buf;
+
+static StaticEventGroup_t state_events_buf;
+static StaticSemaphore_t i2s_mutex_buf;
+
+// Audio chunk pool
+#if CHUNK_POOL_IN_PSRAM
+EXT_RAM_BSS_ATTR static uint8_t chunk_pool_storage[CHUNK_POOL_COUNT * CHUNK_BYTES] __attribute__((aligned(4)));
+#else
+DMA_ATTR static uint8_t chunk_pool_storage[CHUNK_POOL_COUNT * CHUNK_BYTES];
+#endif
+
+#define MEM_PLAN_QUEUE_BYTES (sizeof(q_state_effects_storage) + sizeof(q_earcons_storage) +            \
+                              sizeof(q_free_chunks_storage) +                                          \
+                              sizeof(q_capture_to_send_storage) + sizeof(q_playback_storage) +         \
+                              sizeof(q_ws_messages_storage) + sizeof(q_ws_inbound_storage) +           \
+                              7 * sizeof(StaticQueue_t) + sizeof(StaticEventGroup_t) +                 \
+                              sizeof(StaticSemaphore_t))
+
+#define MEM_PLAN_TASK_BYTES  (MEM_PLAN_TASK_STACK_BYTES + MEM_PLAN_TASK_COUNT * sizeof(StaticTask_t))
+
+// Capture and playback bounce buffers (audio_handling.c)
+#define MEM_PLAN_BOUNCE_BYTES (2 * I2S_BOUNCE_BYTES)
+
+#define MEM_PLAN_INTERNAL_BYTES (MEM_PLAN_TASK_BYTES + MEM_PLAN_QUEUE_BYTES + MEM_PLAN_BOUNCE_BYTES + \
+                                 (CHUNK_POOL_IN_PSRAM ? 0 : sizeof(chunk_pool_storage)))
+
+_Static_assert(MEM_PLAN_INTERNAL_BYTES <= MEM_PLAN_INTERNAL_BUDGET_BYTES,
+               "Static internal RAM plan exceeds MEM_PLAN_INTERNAL_BUDGET_BYTES; "
+               "enable CONFIG_SPIRAM_ALLOW_BSS_SEG_EXTERNAL_MEMORY or shrink task stacks/queues");
+
+// Linker-provided region boundaries
+extern int _data_start, _data_end, _bss_start, _bss_end;
+#if CHUNK_POOL_IN_PSRAM
+extern int _ext_ram_bss_start, _ext_ram_bss_end;
+#endif
+
+bool init_static_objects(void) {
+    q_state_effects = xQueueCreateStatic(QUEUE_LEN_STATE_EFFECTS, sizeof(state_effect_t),
+                                         q_state_effects_storage, &q_state_effects_buf);
+    q_earcons = xQueueCreateStatic(QUEUE_LEN_EARCONS, sizeof(int), q_earcons_storage, &q_earcons_buf);
+    q_free_chunks = xQueueCreateStatic(CHUNK_POOL_CAPACITY, sizeof(uint8_t*),
+                                       q_free_chunks_storage, &q_free_chunks_buf);
+    q_capture_to_send = xQueueCreateStatic(QUEUE_LEN_CAPTURE_TO_SEND, sizeof(audio_chunk_t),
+                                           q_capture_to_send_storage, &q_capture_to_send_buf);
+    q_playback = xQueueCreateStatic(QUEUE_LEN_PLAYBACK, sizeof(audio_chunk_t),
+                                    q_playback_storage, &q_playback_buf);
+    q_ws_messages = xQueueCreateStatic(QUEUE_LEN_WS_MESSAGES, sizeof(ws_message_t),
+                                       q_ws_messages_storage, &q_ws_messages_buf);
+    q_ws_inbound = xQueueCreateStatic(QUEUE_LEN_WS_INBOUND, sizeof(ws_inbound_t),
+                                      q_ws_inbound_storage, &q_ws_inbound_buf);
+    state_events = xEventGroupCreateStatic(&state_events_buf);
+    i2s_mutex = xSemaphoreCreateMutexStatic(&i2s_mutex_buf);
+
+    if (!q_state_effects || !q_earcons || !q_free_chunks || !q_capture_to_send || !q_playback ||
+        !q_ws_messages || !q_ws_inbound || !state_events || !i2s_mutex) {
+        ESP_LOGE("MEMPLAN", "Failed to create static queues/sync objects");
+        return false;
+    }
+    return true;
+}
+
+uint8_t* memory_plan_chunk_pool(int *count) {
+    if (count) {
+        *count = CHUNK_POOL_COUNT;
+    }
+    return chunk_pool_storage;
+}
+
+static void log_heap_region(const char *name, uint32_t caps) {
+    ESP_LOGI("MEMPLAN", "  heap %-8s free %7u  largest %7u  min-ever %7u", name,
+             (unsigned)heap_caps_get_free_size(caps),
+             (unsigned)heap_caps_get_largest_free_block(caps),
+             (unsigned)heap_caps_get_minimum_free_size(caps));
+}
+
+void log_memory_map(void) {
+    ESP_LOGI("MEMPLAN", "Static memory map:");
+    ESP_LOGI("MEMPLAN", "  .data     %p-%p %7u bytes", &_data_start, &_data_end,
+             (unsigned)((uint8_t*)&_data_end - (uint8_t*)&_data_start));
+    ESP_LOGI("MEMPLAN", "  .bss      %p-%p %7u bytes", &_bss_start, &_bss_end,
+             (unsigned)((uint8_t*)&_bss_end - (uint8_t*)&_bss_start));
+#if CHUNK_POOL_IN_PSRAM
+    ESP_LOGI("MEMPLAN", "  .ext_bss  %p-%p %7u bytes", &_ext_ram_bss_start, &_ext_ram_bss_end,
+             (unsigned)((uint8_t*)&_ext_ram_bss_end - (uint8_t*)&_ext_ram_bss_start));
+#endif
+    ESP_LOGI("MEMPLAN", "  task stacks+TCBs %7u bytes (internal)", (unsigned)MEM_PLAN_TASK_BYTES);
+    ESP_LOGI("MEMPLAN", "  queues+sync      %7u bytes (internal)", (unsigned)MEM_PLAN_QUEUE_BYTES);
+    ESP_LOGI("MEMPLAN", "  I2S bounce       %7u bytes (internal DMA), driver DMA ring %u bytes (heap)",
+             (unsigned)MEM_PLAN_BOUNCE_BYTES, (unsigned)I2S_DMA_RING_BYTES);
+    ESP_LOGI("MEMPLAN", "  chunk pool       %7u bytes (%s, %d x %d) at %p",
+             (unsigned)sizeof(chunk_pool_storage), CHUNK_POOL_IN_PSRAM ? "PSRAM" : "internal DMA",
+             CHUNK_POOL_COUNT, CHUNK_BYTES, chunk_pool_storage);
+    ESP_LOGI("MEMPLAN", "  internal plan    %7u / %u bytes budget",
+             (unsigned)MEM_PLAN_INTERNAL_BYTES, (unsigned)MEM_PLAN_INTERNAL_BUDGET_BYTES);
+
+    log_heap_region("internal", MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    log_heap_region("dma", MALLOC_CAP_DMA);
+    log_heap_region("psram", MALLOC_CAP_SPIRAM);
+}
@@ -0,0 +1,90 @@
+/*
+ * HotPin Firmware - Static Memory Plan
+ *
+ * Every task stack, queue, sync object and the audio chunk pool is
+ * statically allocated, so its region (internal DRAM, DMA-capable DRAM or
+ * PSRAM) is fixed at link time. Overrunning a region is a link error and
+ * overrunning the internal budget below is a compile error, instead of a
+ * failed allocation in the field.
+ */
+
+#ifndef MEMORY_PLAN_H
+#define MEMORY_PLAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Internal DRAM the plan may reserve statically; the rest stays heap for
+// Wi-Fi, lwIP, mbedTLS and cJSON. Without PSRAM the chunk pool comes out of
+// internal RAM too, so that build gets a larger share and a smaller pool.
+#if CONFIG_SPIRAM_ALLOW_BSS_SEG_EXTERNAL_MEMORY
+#define MEM_PLAN_INTERNAL_BUDGET_BYTES  (96 * 1024)
+#else
+#define MEM_PLAN_INTERNAL_BUDGET_BYTES  (128 * 1024)
+#endif
+
+// Stack arena for the tasks in the scheduling profile tables (both
+// profiles create the same tasks with the same stack sizes)
+#define MEM_PLAN_TASK_COUNT         13
+#define MEM_PLAN_TASK_STACK_BYTES   (TASK_STACK_SIZE_BUTTON * 2 +          \
+                                     TASK_STACK_SIZE_STATE_EFFECT +        \
+                                     TASK_STACK_SIZE_WS +                  \
+                                     TASK_STACK_SIZE_WS_MESSAGE +          \
+                                     TASK_STACK_SIZE_WS_DISPATCH +         \
+                                     TASK_STACK_SIZE_AUDIO_CAPTURE +       \
+                                     TASK_STACK_SIZE_AUDIO_SEND +          \
+                                     TASK_STACK_SIZE_AUDIO_PLAYBACK +      \
+                                     TASK_STACK_SIZE_CAMERA +              \
+                                     TASK_STACK_SIZE_TELEMETRY +           \
+                                     TASK_STACK_SIZE_WAKE_WORD +           \
+                                     TASK_STACK_SIZE_SELFTEST)
+
+// Queue depths
+#define QUEUE_LEN_STATE_EFFECTS     16
+#define QUEUE_LEN_EARCONS           4
+#define QUEUE_LEN_CAPTURE_TO_SEND   32
+#define QUEUE_LEN_PLAYBACK          16
+#define QUEUE_LEN_WS_MESSAGES       16
+#define QUEUE_LEN_WS_INBOUND        16
+
+// Chunk pool placement: PSRAM via .ext_ram.bss when the build allows it,
+// otherwise DMA-capable internal RAM
+#if CONFIG_SPIRAM_ALLOW_BSS_SEG_EXTERNAL_MEMORY
+#define CHUNK_POOL_COUNT            POOL_COUNT_WITH_PSRAM
+#define CHUNK_POOL_IN_PSRAM         1
+#else
+#define CHUNK_POOL_COUNT            POOL_COUNT_NO_PSRAM
+#define CHUNK_POOL_IN_PSRAM         0
+#endif
+
+/**
+ * @brief Create all queues, the state event group and the I2S mutex from
+ *        static storage
+ *
+ * @return true on success (static creation only fails on bad arguments)
+ */
+bool init_static_objects(void);
+
+/**
+ * @brief Static chunk pool storage
+ *
+ * @param count Output: number of CHUNK_BYTES chunks in the pool
+ * @return Start of the pool
+ */
+uint8_t* memory_plan_chunk_pool(int *count);
+
+/**
+ * @brief Log the static memory map and the heap budgets per capability
+ */
+void log_memory_map(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MEMORY_PLAN_H */
@@ -7,9 +7,27 @@
 #include "network_discovery.h"
 #include "esp_http_client.h"
 #include "esp_netif.h"
+#include "lwip/sockets.h"
+#include "mbedtls/md.h"
+#include "subnet_probe.h"
+#include "mdns_discovery.h"
+#include "endpoint_list.h"
+#include "nvs.h"
+#include <errno.h>
 #include <string.h>
 #include <stdio.h>
 
+#define BEACON_MAX_LEN      512
+#define BEACON_VERSION      1
+#define BEACON_SIG_LEN      32      // HMAC-SHA256
+#define BEACON_SEEN_MAX     4       // Servers whose newest beacon is remembered
+#define BEACON_NVS_NAMESPACE "hotpin"
+#define BEACON_NVS_KEY      "beacon_seen"
+
+#define DISCOVERY_HTTP_PORT             8000
+#define DISCOVERY_RESPONSE_TIMEOUT_MS   1500
+#define DISCOVERY_MAX_CANDIDATES        (254 + 8)   // A /24, the gateway and common_local_ips
+
 // Common local network IP ranges to scan
 static const char* common_local_ips[] = {
     "192.168.0.100",    // Common router range
@@ -18,7 +36,7 @@ static const char* common_local_ips[] = {
     "10.0.0.100",       // Alternative range
     "10.143.111.100",   // Close to the original hardcoded IP
     "10.143.111.1",     // Gateway IP
-    "127.0.0.1",        // Localhost (for testing)
+    "127.0.0.1",        // Localhost (for testing; not probed from the device)
     NULL
 };
 
@@ -68,77 +86,283 @@ bool ping_server_at_ip(const char *ip)
     return (status_code == 200 || status_code == 401 || status_code == 403);
 }
 
-/**
- * @brief Check if the server at given IP is specifically a HotPin server
- * 
- * @param ip The IP address to check
- * @return true if it's a HotPin server, false otherwise
- */
-bool is_hotpin_server_at_ip(const char *ip)
+// Check a beacon's signature: HMAC-SHA256 keyed with the WebSocket token
+// over "hotpin<v>|<url>|<seq>|<ts>", as hex. Without a token there is
+// nothing to check against and any well-formed beacon is accepted.
+static bool beacon_signature_valid(int version, const char *url, double seq, double ts, const char *sig_hex)
 {
-    char health_url[256];
-    snprintf(health_url, sizeof(health_url), "http://%s:8000/health", ip);
-
-    // Set up short timeout to avoid blocking for too long on unreachable IPs
-    esp_http_client_config_t config = {
-        .url = health_url,
-        .event_handler = discovery_http_event_handler,
-        .timeout_ms = 2000,  // Shorter timeout to prevent blocking
-    };
+    const char *key = HOTPIN_WS_TOKEN;
+    if (key[0] == '\0') {
+        return true;
+    }
+    if (!sig_hex || strlen(sig_hex) != BEACON_SIG_LEN * 2) {
+        return false;
+    }
 
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (!client) {
+    char message[BEACON_MAX_LEN];
+    int len = snprintf(message, sizeof(message), "hotpin%d|%s|%.0f|%.0f", version, url, seq, ts);
+    if (len < 0 || len >= (int)sizeof(message)) {
+        return false;
+    }
+    unsigned char mac[BEACON_SIG_LEN];
+    if (mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), (const unsigned char*)key, strlen(key),
+                        (const unsigned char*)message, len, mac) != 0) {
         return false;
     }
 
-    // Perform the request with shorter timeout
-    esp_err_t err = esp_http_client_perform(client);
+    // Compare every byte, so the time taken does not tell how much matched
+    unsigned char diff = 0;
+    for (int i = 0; i < BEACON_SIG_LEN; i++) {
+        unsigned int byte;
+        if (sscanf(&sig_hex[i * 2], "%2x", &byte) != 1) {
+            return false;
+        }
+        diff |= mac[i] ^ (unsigned char)byte;
+    }
+    return diff == 0;
+}
+
+// The newest signed beacon accepted from each URL. A beacon is ordered by
+// its ts, then its seq: seq restarts with the server, ts carries on. Kept in
+// NVS so a captured beacon cannot be replayed after a restart either. Only
+// touched from listen_for_beacon(), which is not reentrant
+typedef struct {
+    char url[ENDPOINT_URL_LEN];
+    double ts;
+    double seq;
+} beacon_seen_t;
+
+static beacon_seen_t beacon_seen[BEACON_SEEN_MAX];
+static bool beacon_seen_restored = false;
+
+static void restore_beacon_seen(void)
+{
+    if (beacon_seen_restored) {
+        return;
+    }
+    beacon_seen_restored = true;
+
+    nvs_handle_t nvs;
+    if (nvs_open(BEACON_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return;
+    }
+    size_t len = sizeof(beacon_seen);
+    esp_err_t err = nvs_get_blob(nvs, BEACON_NVS_KEY, beacon_seen, &len);
+    nvs_close(nvs);
+    // A different size is a layout from another firmware version
+    if (err != ESP_OK || len != sizeof(beacon_seen)) {
+        memset(beacon_seen, 0, sizeof(beacon_seen));
+    }
+}
+
+static void save_beacon_seen(void)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(BEACON_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(nvs, BEACON_NVS_KEY, beacon_seen, sizeof(beacon_seen));
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
     if (err != ESP_OK) {
-        esp_http_client_cleanup(client);
+        ESP_LOGW("DISCOVERY", "Failed to save beacon sequence numbers: %s", esp_err_to_name(err));
+    }
+}
+
+// Record a signed beacon, or return false if it is not newer than the last
+// one accepted from its URL (a replay)
+static bool beacon_is_new(const char *url, double seq, double ts)
+{
+    restore_beacon_seen();
+
+    beacon_seen_t *slot = NULL;
+    for (int i = 0; i < BEACON_SEEN_MAX; i++) {
+        if (beacon_seen[i].url[0] != '\0' && strcmp(beacon_seen[i].url, url) == 0) {
+            slot = &beacon_seen[i];
+            break;
+        }
+    }
+    if (slot) {
+        if (ts < slot->ts || (ts == slot->ts && seq <= slot->seq)) {
+            return false;
+        }
+    } else {
+        // A free slot, else the server heard from longest ago
+        slot = &beacon_seen[0];
+        for (int i = 0; i < BEACON_SEEN_MAX && slot->url[0] != '\0'; i++) {
+            if (beacon_seen[i].url[0] == '\0' || beacon_seen[i].ts < slot->ts) {
+                slot = &beacon_seen[i];
+            }
+        }
+        strlcpy(slot->url, url, sizeof(slot->url));
+    }
+    slot->ts = ts;
+    slot->seq = seq;
+    save_beacon_seen();
+    return true;
+}
+
+// Parse and authenticate one beacon; the URL is copied without any query
+static bool parse_beacon(const char *payload, char *ws_url, size_t buffer_size)
+{
+    cJSON *beacon = cJSON_Parse(payload);
+    if (!beacon) {
         return false;
     }
 
-    int status_code = esp_http_client_get_status_code(client);
-    
-    // For stack efficiency, only check status codes first, and only read response body if needed
-    if (status_code == 200) {
-        // Try to read a small portion to check for HotPin-specific response
-        // Use a smaller buffer to reduce stack usage
-        char response_buffer[128];  // Reduced size to save stack space
-        int content_length = esp_http_client_get_content_length(client);
-        
-        if (content_length > 0 && content_length < sizeof(response_buffer) - 1) {
-            int read_len = esp_http_client_read(client, response_buffer, sizeof(response_buffer) - 1);
-            if (read_len > 0) {
-                response_buffer[read_len] = '\0';
-                
-                // Check if response contains HotPin-specific identifiers
-                if (strstr(response_buffer, "HotPin") || 
-                    strstr(response_buffer, "hotpin") || 
-                    strstr(response_buffer, "models") || 
-                    strstr(response_buffer, "groq")) {
-                    esp_http_client_cleanup(client);
-                    return true;
-                }
+    bool valid = false;
+    cJSON *type = cJSON_GetObjectItem(beacon, "type");
+    cJSON *version = cJSON_GetObjectItem(beacon, "v");
+    cJSON *url = cJSON_GetObjectItem(beacon, "url");
+    cJSON *seq = cJSON_GetObjectItem(beacon, "seq");
+    cJSON *ts = cJSON_GetObjectItem(beacon, "ts");
+    if (cJSON_IsString(type) && strcmp(type->valuestring, "hotpin_beacon") == 0 &&
+        cJSON_IsNumber(version) && version->valueint == BEACON_VERSION &&
+        cJSON_IsString(url) && cJSON_IsNumber(seq) && cJSON_IsNumber(ts) &&
+        (strncmp(url->valuestring, "ws://", 5) == 0 || strncmp(url->valuestring, "wss://", 6) == 0)) {
+        if (!beacon_signature_valid(version->valueint, url->valuestring, seq->valuedouble, ts->valuedouble,
+                                    cJSON_GetStringValue(cJSON_GetObjectItem(beacon, "sig")))) {
+            ESP_LOGW("DISCOVERY", "Ignoring beacon for %s: bad signature", url->valuestring);
+        } else {
+            size_t len = strcspn(url->valuestring, "?");
+            if (len < buffer_size) {
+                memcpy(ws_url, url->valuestring, len);
+                ws_url[len] = '\0';
+                valid = true;
+            }
+            // Unsigned beacons prove nothing, so only signed ones are tracked
+            if (valid && HOTPIN_WS_TOKEN[0] != '\0' && !beacon_is_new(ws_url, seq->valuedouble, ts->valuedouble)) {
+                ESP_LOGW("DISCOVERY", "Ignoring beacon for %s: seq %.0f at %.0f is not newer than the last one",
+                         ws_url, seq->valuedouble, ts->valuedouble);
+                valid = false;
             }
         }
-    } else if (status_code == 401 || status_code == 403) {
-        // Even if unauthorized, it's likely a HotPin server (correct status code)
-        esp_http_client_cleanup(client);
-        return true;
     }
+    cJSON_Delete(beacon);
+    return valid;
+}
 
-    esp_http_client_cleanup(client);
-    return false;  // Only return true for verified HotPin servers
+bool listen_for_beacon(char *ws_url, size_t buffer_size, uint32_t wait_ms)
+{
+#ifdef CONFIG_HOTPIN_DISCOVERY_BEACON
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        ESP_LOGE("DISCOVERY", "Failed to create beacon socket: errno %d", errno);
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CONFIG_HOTPIN_DISCOVERY_BEACON_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        ESP_LOGE("DISCOVERY", "Failed to bind beacon port %d: errno %d", CONFIG_HOTPIN_DISCOVERY_BEACON_PORT, errno);
+        close(sock);
+        return false;
+    }
+
+    ESP_LOGI("DISCOVERY", "Listening for server beacons on UDP %d for %"PRIu32" ms",
+             CONFIG_HOTPIN_DISCOVERY_BEACON_PORT, wait_ms);
+    // Static: callers are the boot path and the dispatcher, never both at once
+    static char payload[BEACON_MAX_LEN + 1];
+    int64_t deadline_us = esp_timer_get_time() + (int64_t)wait_ms * 1000;
+    bool found = false;
+    while (!found) {
+        int64_t left_us = deadline_us - esp_timer_get_time();
+        if (left_us <= 0) {
+            break;
+        }
+        struct timeval timeout = { .tv_sec = left_us / 1000000, .tv_usec = left_us % 1000000 };
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        int len = recvfrom(sock, payload, BEACON_MAX_LEN, 0, (struct sockaddr*)&from, &from_len);
+        if (len < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                ESP_LOGW("DISCOVERY", "Beacon receive failed: errno %d", errno);
+            }
+            break;
+        }
+        payload[len] = '\0';
+        found = parse_beacon(payload, ws_url, buffer_size);
+        if (found) {
+            char from_ip[16];
+            inet_ntoa_r(from.sin_addr, from_ip, sizeof(from_ip));
+            ESP_LOGI("DISCOVERY", "HotPin server beacon from %s: %s", from_ip, ws_url);
+        }
+    }
+    close(sock);
+    return found;
+#else
+    (void)ws_url;
+    (void)buffer_size;
+    (void)wait_ms;
+    return false;
+#endif
+}
+
+static bool add_candidate(uint32_t *out, int *count, int max, uint32_t addr)
+{
+    for (int i = 0; i < *count; i++) {
+        if (out[i] == addr) {
+            return false;
+        }
+    }
+    if (*count == max) {
+        return false;
+    }
+    out[(*count)++] = addr;
+    return true;
+}
+
+// Addresses to probe, likeliest first: outward from our own address across
+// our /24 (or our subnet, if smaller), the gateway after the nearest ten,
+// then the common local IPs. Network byte order.
+static int build_probe_candidates(uint32_t *out, int max)
+{
+    int count = 0;
+    esp_netif_ip_info_t ip_info;
+    esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    if (netif && esp_netif_get_ip_info(netif, &ip_info) == ESP_OK && ip_info.ip.addr != 0) {
+        uint32_t ip = ntohl(ip_info.ip.addr);
+        uint32_t mask = ntohl(ip_info.netmask.addr) | 0xFFFFFF00;
+        uint32_t first = (ip & mask) + 1;
+        uint32_t last = (ip | ~mask) - 1;
+        for (uint32_t step = 1; step < 256; step++) {
+            if (ip >= first + step) {
+                add_candidate(out, &count, max, htonl(ip - step));
+            }
+            if (ip + step <= last) {
+                add_candidate(out, &count, max, htonl(ip + step));
+            }
+            if (step == 5 && ip_info.gw.addr != 0 && ip_info.gw.addr != ip_info.ip.addr) {
+                add_candidate(out, &count, max, ip_info.gw.addr);
+            }
+        }
+    }
+    for (int i = 0; common_local_ips[i] != NULL; i++) {
+        uint32_t addr = inet_addr(common_local_ips[i]);
+        if (addr != htonl(INADDR_LOOPBACK)) {
+            add_candidate(out, &count, max, addr);
+        }
+    }
+    return count;
 }
 
 /**
  * @brief Discover the HotPin WebServer on the local network
  * 
  * This function attempts to locate the HotPin WebServer using multiple methods:
- * 1. Targeted scanning around common server IP ranges
- * 2. Using the local network gateway
- * 3. Trying common local IPs
+ * 1. A DNS-SD query for _hotpin._tcp (mdns_discovery.h)
+ * 2. A signed UDP beacon from the server
+ * 3. A concurrent HTTP probe of our /24, nearest addresses first, the
+ *    gateway and common local IPs (subnet_probe.h)
  * 
  * @param[out] ws_url Output buffer to store the WebSocket URL (should be at least 256 chars)
  * @param[in] buffer_size Size of the output buffer
@@ -148,63 +372,39 @@ bool discover_server(char *ws_url, size_t buffer_size)
 {
     ESP_LOGI("DISCOVERY", "Starting server discovery...");
     
-    // Check if we can get our own IP and use the gateway as a hint
-    esp_netif_ip_info_t ip_info;
-    esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+#ifdef CONFIG_HOTPIN_DISCOVERY_MDNS
+    if (mdns_query_server(ws_url, buffer_size, CONFIG_HOTPIN_DISCOVERY_MDNS_QUERY_MS)) {
+        return true;
+    }
+#endif
     
-    if (esp_netif_get_ip_info(netif, &ip_info) == ESP_OK) {
-        // Get our own IP parts
-        uint8_t *my_ip = (uint8_t*)&ip_info.ip.addr;
-        
-        // Try targeted IP ranges that are more likely to have servers
-        // Check near our own IP (e.g. if we're 10.143.111.105, check .100-.110)
-        int start_range = (my_ip[3] > 10) ? (my_ip[3] - 5) : 1;  // Reduced range from 10 to 5
-        int end_range = (my_ip[3] < 249) ? (my_ip[3] + 5) : 254;  // Reduced range from 10 to 5
-        
-        int attempts = 0;
-        const int max_attempts = 20;  // Limit total attempts to prevent long blocking
-        
-        for (int i = start_range; i <= end_range && attempts < max_attempts; i++, attempts++) {
-            if (i == my_ip[3]) continue;  // Skip our own IP
-            
-            char server_ip[24];  // Increased size to safely accommodate "255.255.255.255" + null terminator with extra safety margin
-            snprintf(server_ip, sizeof(server_ip), "%d.%d.%d.%d", my_ip[0], my_ip[1], my_ip[2], i);
-            
-            ESP_LOGD("DISCOVERY", "Scanning IP: %s", server_ip);
-            if (is_hotpin_server_at_ip(server_ip)) {
-                snprintf(ws_url, buffer_size, "ws://%s:8000/ws", server_ip);
-                ESP_LOGI("DISCOVERY", "HotPin server found: %s", ws_url);
-                return true;
-            }
-            
-            // Add small delay between requests to prevent overwhelming network
-            vTaskDelay(pdMS_TO_TICKS(50));
-        }
-        
-        // If targeted scan didn't work, try the gateway
-        char gateway_ip[24];  // Increased size to safely accommodate "255.255.255.255" + null terminator with extra safety margin
-        uint8_t *gw = (uint8_t*)&ip_info.gw.addr;
-        snprintf(gateway_ip, sizeof(gateway_ip), "%d.%d.%d.%d", gw[0], gw[1], gw[2], gw[3]);
-        
-        ESP_LOGD("DISCOVERY", "Trying gateway IP: %s", gateway_ip);
-        if (is_hotpin_server_at_ip(gateway_ip)) {
-            snprintf(ws_url, buffer_size, "ws://%s:8000/ws", gateway_ip);
-            ESP_LOGI("DISCOVERY", "HotPin server found at gateway: %s", ws_url);
-            return true;
-        }
+#ifdef CONFIG_HOTPIN_DISCOVERY_BEACON
+    if (listen_for_beacon(ws_url, buffer_size, CONFIG_HOTPIN_DISCOVERY_BEACON_WAIT_MS)) {
+        return true;
     }
+#endif
     
-    // Try common local IPs if the above didn't work, with a limit on attempts
-    for (int i = 0; common_local_ips[i] != NULL && i < 3; i++) {  // Limit to first 3 common IPs
-        ESP_LOGD("DISCOVERY", "Trying common IP: %s", common_local_ips[i]);
-        if (is_hotpin_server_at_ip(common_local_ips[i])) {
-            snprintf(ws_url, buffer_size, "ws://%s:8000/ws", common_local_ips[i]);
-            ESP_LOGI("DISCOVERY", "HotPin server found: %s", ws_url);
-            return true;
-        }
-        
-        // Add delay between requests
-        vTaskDelay(pdMS_TO_TICKS(100));
+    // No beacon: probe likely addresses over HTTP, many at once
+    static uint32_t candidates[DISCOVERY_MAX_CANDIDATES];  // Too large for the caller's stack
+    int count = build_probe_candidates(candidates, DISCOVERY_MAX_CANDIDATES);
+    probe_config_t config = {
+        .port = DISCOVERY_HTTP_PORT,
+        .parallel = CONFIG_HOTPIN_DISCOVERY_PROBE_PARALLEL,
+        .connect_timeout_ms = CONFIG_HOTPIN_DISCOVERY_PROBE_TIMEOUT_MS,
+        .response_timeout_ms = DISCOVERY_RESPONSE_TIMEOUT_MS,
+    };
+    probe_stats_t stats;
+    int found = probe_hotpin_servers(candidates, count, &config, &stats);
+    ESP_LOGI("DISCOVERY", "Probed %"PRIu32" of %d addresses in %"PRIu32" ms: %"PRIu32" refused, "
+             "%"PRIu32" unreachable, %"PRIu32" not HotPin", stats.probed, count, stats.elapsed_ms,
+             stats.refused, stats.unreachable, stats.not_hotpin);
+    if (found >= 0) {
+        char server_ip[16];
+        struct in_addr addr = { .s_addr = candidates[found] };
+        inet_ntoa_r(addr, server_ip, sizeof(server_ip));
+        snprintf(ws_url, buffer_size, "ws://%s:%d/ws", server_ip, DISCOVERY_HTTP_PORT);
+        ESP_LOGI("DISCOVERY", "HotPin server found: %s", ws_url);
+        return true;
     }
     
     ESP_LOGW("DISCOVERY", "Server discovery failed - no HotPin server detected");
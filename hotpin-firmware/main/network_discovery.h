@@ -7,14 +7,16 @@
 #define NETWORK_DISCOVERY_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 /**
  * @brief Discover the HotPin WebServer on the local network
  * 
  * This function attempts to locate the HotPin WebServer using multiple methods:
- * 1. mDNS discovery (if available)
- * 2. Simple HTTP requests to common local IPs
- * 3. Using dynamic configuration endpoint
+ * 1. A DNS-SD query for _hotpin._tcp (mdns_query_server)
+ * 2. The server's UDP beacon (listen_for_beacon)
+ * 3. A concurrent HTTP probe of the local /24 and common IPs, as a last resort
  * 
  * @param[out] ws_url Output buffer to store the WebSocket URL (should be at least 256 chars)
  * @param[in] buffer_size Size of the output buffer
@@ -22,6 +24,23 @@
  */
 bool discover_server(char *ws_url, size_t buffer_size);
 
+/**
+ * @brief Wait for a server discovery beacon
+ *
+ * Listens on CONFIG_HOTPIN_DISCOVERY_BEACON_PORT for the UDP beacon the
+ * webserver broadcasts and returns on the first one signed with the
+ * WebSocket token (HMAC-SHA256). Beacons with a bad signature, or not
+ * newer (ts, then seq) than the last one accepted from the same URL, are
+ * logged and skipped. Not reentrant.
+ *
+ * @param[out] ws_url Output buffer for the server's WebSocket URL, without token
+ * @param[in] buffer_size Size of the output buffer
+ * @param[in] wait_ms How long to listen
+ * @return true if a valid beacon arrived in time, false otherwise (or when
+ *         CONFIG_HOTPIN_DISCOVERY_BEACON is off)
+ */
+bool listen_for_beacon(char *ws_url, size_t buffer_size, uint32_t wait_ms);
+
 /**
  * @brief Check if a server is responding at a given IP address
  * 
@@ -3,16 +3,53 @@
  */
 
 #include "main.h"
+#include "task_profile.h"
+#include "earcon.h"
+#include "tts_cache.h"
+#include "diagnostics.h"
+#include "session_profile.h"
+#include "runtime_config.h"
+#include "mdns_discovery.h"
+#include "udp_audio.h"
+#include "ws_mux.h"
+#include "audio_spill.h"
 
 // Forward declaration for message processing task
 void websocket_message_task(void *pvParameters);
 void reconnect_websocket(void);  // Forward declaration for reconnect function
 
-static esp_websocket_client_handle_t ws_client = NULL;
+static esp_websocket_client_handle_t ws_client = NULL;  // Connection in use, one of hedge_clients
 static bool ws_connected = false;
 static bool ws_handshake_complete = false;  // Track if initial handshake is done
 // static char effective_ws_url[256] = {0};  // No longer used, commented out to avoid warning
 
+/*
+ * Hedged connects: each connect races the two best endpoints (dynamic_config.h)
+ * on two long-lived clients. The first to complete the WebSocket upgrade
+ * becomes ws_client. The clients are reused rather than destroyed, so a task
+ * holding the old ws_client never sees freed memory.
+ */
+#define WS_HEDGE_COUNT  2
+
+typedef struct {
+    esp_websocket_client_handle_t client;
+    int endpoint;
+    int64_t started_us;
+    int64_t connected_us;
+    bool failed;
+} ws_attempt_t;
+
+static esp_websocket_client_handle_t hedge_clients[WS_HEDGE_COUNT];
+static ws_attempt_t attempts[WS_HEDGE_COUNT];
+static int ws_endpoint = -1;                // Endpoint of ws_client
+static bool race_open = false;
+static TaskHandle_t race_waiter = NULL;     // Task in connect_hedged(), notified on each outcome
+// A losing attempt still connecting; websocket_task stops it, since stopping
+// waits for the connect to time out
+static esp_websocket_client_handle_t cancel_pending = NULL;
+static esp_websocket_client_handle_t cancel_running = NULL;
+static portMUX_TYPE ws_client_lock = portMUX_INITIALIZER_UNLOCKED;
+
 bool init_wifi() {
     ESP_LOGI("WIFI", "Initializing WiFi");
     
@@ -116,6 +153,43 @@ bool init_wifi() {
     return true;
 }
 
+static esp_websocket_client_handle_t create_ws_client(const char *ws_url) {
+    runtime_config_t settings;
+    runtime_config_get(&settings);
+
+    // Set up WebSocket headers with authorization
+    char auth_header[256];
+    snprintf(auth_header, sizeof(auth_header), "Authorization: Bearer %s\r\n", HOTPIN_WS_TOKEN);
+    
+    // Initialize WebSocket client with authentication headers
+    esp_websocket_client_config_t websocket_cfg = {
+        .uri = ws_url,
+        .user_agent = "HotPin-Firmware-Client/1.0",
+        .headers = auth_header,
+        .task_stack = 8192,  // Increase WebSocket task stack to prevent stack overflow
+        .task_prio = task_profile_ws_client_priority(),  // See task_profile.c
+        .reconnect_timeout_ms = 10000,  // 10 second reconnect timeout
+        .network_timeout_ms = 10000,    // 10 second network timeout
+        .pingpong_timeout_sec = 15,     // 15 second ping/pong timeout
+        .keep_alive_idle = 60,          // 60 second keep-alive idle
+        .keep_alive_interval = 10,       // 10 second keep-alive interval
+        .keep_alive_count = 3,          // 3 keep-alive probes
+        .disable_auto_reconnect = true, // reconnect_websocket() picks the endpoint
+        .buffer_size = 2048,            // Increase buffer size for better performance
+        .cert_pem = NULL,               // No certificate validation for now
+        .transport = WEBSOCKET_TRANSPORT_OVER_TCP, // Use TCP transport
+        .subprotocol = NULL,            // No subprotocol
+        .user_context = NULL,           // No user context
+        .ping_interval_sec = settings.ping_interval_sec, // Server-set, 30 s by default
+    };
+    
+    esp_websocket_client_handle_t client = esp_websocket_client_init(&websocket_cfg);
+    if (client) {
+        esp_websocket_register_events(client, WEBSOCKET_EVENT_ANY, websocket_event_handler, NULL);
+    }
+    return client;
+}
+
 bool init_websocket() {
     ESP_LOGI("WS", "Initializing WebSocket client");
     
@@ -128,6 +202,9 @@ bool init_websocket() {
         ESP_LOGW("WS", "Failed to initialize dynamic configuration, continuing with defaults");
     }
     
+    // Follow _hotpin._tcp announcements, so a server that moves is picked up
+    init_mdns_discovery();
+    
     // Get the local IP address to create a WebSocket URL for local connections
     esp_netif_ip_info_t ip_info;
     esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
@@ -143,63 +220,21 @@ bool init_websocket() {
         ESP_LOGI("WS", "Connect other devices to this URL to interact with this HotPin device on the local network");
     }
     
-    // WebSocket configuration
-    // Use the dynamic WebSocket URL if available, otherwise fall back to local or configured URL
-    const char* ws_url = get_current_ws_url();
-    ESP_LOGI("WS", "Using WebSocket URL: %s", ws_url);
-    
-    // Set up WebSocket headers with authorization
-    char auth_header[256];
-    snprintf(auth_header, sizeof(auth_header), "Authorization: Bearer %s\r\n", HOTPIN_WS_TOKEN);
-    
-    // Initialize WebSocket client with authentication headers
-    esp_websocket_client_config_t websocket_cfg = {
-        .uri = ws_url,
-        .user_agent = "HotPin-Firmware-Client/1.0",
-        .headers = auth_header,
-        .task_stack = 8192,  // Increase WebSocket task stack to prevent stack overflow
-        .task_prio = 5,      // Standard priority
-        .reconnect_timeout_ms = 10000,  // 10 second reconnect timeout
-        .network_timeout_ms = 10000,    // 10 second network timeout
-        .pingpong_timeout_sec = 15,     // 15 second ping/pong timeout
-        .keep_alive_idle = 60,          // 60 second keep-alive idle
-        .keep_alive_interval = 10,       // 10 second keep-alive interval
-        .keep_alive_count = 3,          // 3 keep-alive probes
-        .disable_auto_reconnect = false, // Allow auto-reconnect
-        .buffer_size = 2048,            // Increase buffer size for better performance
-        .cert_pem = NULL,               // No certificate validation for now
-        .transport = WEBSOCKET_TRANSPORT_OVER_TCP, // Use TCP transport
-        .subprotocol = NULL,            // No subprotocol
-        .user_context = NULL,           // No user context
-        .ping_interval_sec = 30,        // Ping every 30 seconds
-    };
-    
-    // Clean up any existing WebSocket client before creating a new one
-    if (ws_client) {
-        ESP_LOGI("WS", "Cleaning up existing WebSocket client");
-        // Properly stop and destroy the WebSocket client
-        esp_websocket_client_stop(ws_client);
-        vTaskDelay(pdMS_TO_TICKS(500)); // Give time for cleanup
-        esp_websocket_client_destroy(ws_client);
-        ws_client = NULL;
-    }
-    
-    // Initialize WebSocket client
-    ws_client = esp_websocket_client_init(&websocket_cfg);
-    if (!ws_client) {
-        ESP_LOGE("WS", "Failed to initialize WebSocket client");
-        return false;
+    // The clients are created once; each connect points them at an endpoint
+    if (!hedge_clients[0]) {
+        for (int i = 0; i < WS_HEDGE_COUNT; i++) {
+            hedge_clients[i] = create_ws_client(get_current_ws_url());
+            if (!hedge_clients[i]) {
+                ESP_LOGE("WS", "Failed to initialize WebSocket client");
+                return false;
+            }
+        }
     }
     
-    // Set event handler
-    esp_websocket_register_events(ws_client, WEBSOCKET_EVENT_ANY, websocket_event_handler, (void*)ws_client);
-    
-    // Start WebSocket client
-    esp_err_t err = esp_websocket_client_start(ws_client);
-    if (err != ESP_OK) {
-        ESP_LOGE("WS", "Failed to start WebSocket client: %s", esp_err_to_name(err));
-        esp_websocket_client_destroy(ws_client);
-        ws_client = NULL;
+    // The dispatcher runs the first connect as it runs every reconnect
+    ws_inbound_t connect = { .type = WS_INBOUND_RECONNECT, .received_us = esp_timer_get_time() };
+    if (!q_ws_inbound || xQueueSend(q_ws_inbound, &connect, 0) != pdTRUE) {
+        ESP_LOGE("WS", "Failed to queue the first connect");
         return false;
     }
     
@@ -207,13 +242,244 @@ bool init_websocket() {
     return true;
 }
 
+/*
+ * Inbound path: websocket_event_handler runs in the esp_websocket_client
+ * task, so it only copies payloads into q_ws_inbound. ws_dispatch_task
+ * parses and acts on them, keeping the client task free to read the
+ * socket and answer PINGs.
+ */
+
+// Longest the client task waits on a full q_ws_inbound before dropping
+#define WS_INBOUND_ENQUEUE_TIMEOUT_MS   50
+// Target handling time for a text message. A metric only: handlers run to
+// completion, and an overrun is counted (budget_overruns) and logged so the
+// handler that blocks can be found
+#define WS_TEXT_BUDGET_US               20000
+// Longest a TTS frame waits for room in q_playback (flow control)
+#define WS_BINARY_BUDGET_MS             2000
+
+static ws_rx_stats_t rx_stats;
+static portMUX_TYPE rx_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Reassembly buffer for text frames split across client reads
+static char *text_assembly = NULL;
+
+// Set per session by the dispatcher (configure_ws_mux())
+static volatile bool mux_wanted = false;
+// Bumped by each configure_ws_mux(); a mux_ready from an older one is stale
+static volatile uint32_t mux_generation = 0;
+// mux_ready has gone out: binary frames carry a ws_mux.h header both ways
+static volatile bool mux_active = false;
+static portMUX_TYPE mux_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// TTS frame being joined from its slices (mux sessions)
+static uint8_t *mux_rx_chunk = NULL;
+static size_t mux_rx_len = 0;
+static uint8_t mux_rx_id = 0;
+static uint8_t mux_rx_flags = 0;        // Of the WebSocket frame being read
+static bool mux_rx_frame_ok = false;    // Later fragments of this WebSocket frame belong to mux_rx_chunk
+
+static void enqueue_inbound(ws_inbound_t *msg) {
+    if (q_ws_inbound && xQueueSend(q_ws_inbound, msg, pdMS_TO_TICKS(WS_INBOUND_ENQUEUE_TIMEOUT_MS)) == pdTRUE) {
+        return;
+    }
+
+    ESP_LOGW("WS", "Inbound queue full, dropping message type %d", msg->type);
+    if (msg->type == WS_INBOUND_TEXT) {
+        free(msg->data);
+    } else if (msg->type == WS_INBOUND_BINARY) {
+        free_chunk(msg->data);
+    }
+    portENTER_CRITICAL(&rx_stats_lock);
+    rx_stats.inbound_drops++;
+    portEXIT_CRITICAL(&rx_stats_lock);
+}
+
+static void enqueue_text_fragment(const esp_websocket_event_data_t *data) {
+    if (data->payload_offset == 0) {
+        free(text_assembly);
+        text_assembly = malloc(data->payload_len + 1);
+        if (!text_assembly) {
+            ESP_LOGE("WS", "Failed to allocate %d bytes for text message", data->payload_len);
+        }
+    }
+    if (!text_assembly || data->payload_offset + data->data_len > data->payload_len) {
+        return;
+    }
+
+    memcpy(text_assembly + data->payload_offset, data->data_ptr, data->data_len);
+    if (data->payload_offset + data->data_len < data->payload_len) {
+        return;  // More fragments follow
+    }
+    text_assembly[data->payload_len] = '\0';
+
+    ws_inbound_t msg = {
+        .type = WS_INBOUND_TEXT,
+        .data = (uint8_t *)text_assembly,
+        .len = data->payload_len,
+        .received_us = esp_timer_get_time(),
+    };
+    text_assembly = NULL;  // Ownership passes to the dispatcher
+    enqueue_inbound(&msg);
+}
+
+static void mux_rx_drop(void) {
+    if (mux_rx_chunk) {
+        free_chunk(mux_rx_chunk);
+        mux_rx_chunk = NULL;
+    }
+}
+
+// Mux sessions: each frame is a slice (ws_mux.h), possibly split across
+// client reads. Slices of a TTS frame are joined in a pool chunk.
+static void enqueue_mux_slice(const esp_websocket_event_data_t *data) {
+    const uint8_t *body = (const uint8_t *)data->data_ptr;
+    size_t len = data->data_len;
+
+    if (data->payload_offset == 0) {
+        ws_mux_channel_t channel;
+        uint8_t flags, msg_id;
+        mux_rx_frame_ok = false;
+        if (!ws_mux_parse(body, len, &channel, &flags, &msg_id) || channel != WS_MUX_TTS) {
+            ESP_LOGW("WS", "Dropping binary frame for no channel this device receives");
+            return;
+        }
+        body += WS_MUX_HEADER_BYTES;
+        len -= WS_MUX_HEADER_BYTES;
+        mux_rx_flags = flags;
+        if (flags & WS_MUX_FLAG_START) {
+            mux_rx_drop();  // Its FINAL slice never came
+            if (get_state() != CLIENT_STATE_PLAYING) {
+                ESP_LOGW("WS", "Received binary data while not in playing state, ignoring");
+                return;
+            }
+            mux_rx_chunk = alloc_chunk();
+            if (!mux_rx_chunk) {
+                ESP_LOGE("WS", "Failed to allocate buffer for TTS data");
+                return;
+            }
+            mux_rx_len = 0;
+            mux_rx_id = msg_id;
+        }
+        if (!mux_rx_chunk || msg_id != mux_rx_id) {
+            return;  // Rest of a message whose start was dropped
+        }
+        mux_rx_frame_ok = true;
+    }
+    if (!mux_rx_frame_ok) {
+        return;
+    }
+    if (mux_rx_len + len > CHUNK_BYTES) {
+        ESP_LOGE("WS", "TTS frame does not fit a chunk");
+        mux_rx_drop();
+        mux_rx_frame_ok = false;
+        return;
+    }
+    memcpy(mux_rx_chunk + mux_rx_len, body, len);
+    mux_rx_len += len;
+
+    if (data->payload_offset + data->data_len < data->payload_len || !(mux_rx_flags & WS_MUX_FLAG_FINAL)) {
+        return;  // More of this frame, or more slices, to come
+    }
+
+    ws_inbound_t msg = {
+        .type = WS_INBOUND_BINARY,
+        .data = mux_rx_chunk,
+        .len = mux_rx_len,
+        .received_us = esp_timer_get_time(),
+    };
+    mux_rx_chunk = NULL;  // Ownership passes to the dispatcher
+    mux_rx_frame_ok = false;
+    enqueue_inbound(&msg);
+}
+
+static void enqueue_binary_frame(const esp_websocket_event_data_t *data) {
+    if (mux_active) {
+        enqueue_mux_slice(data);
+        return;
+    }
+    mux_rx_drop();  // Left over from a session that used the multiplexer
+    if (get_state() != CLIENT_STATE_PLAYING) {
+        ESP_LOGW("WS", "Received binary data while not in playing state, ignoring");
+        return;
+    }
+    if (data->data_len <= 0 || data->data_len > CHUNK_BYTES) {
+        ESP_LOGE("WS", "TTS frame of %d bytes does not fit a chunk", data->data_len);
+        return;
+    }
+
+    uint32_t start = perf_begin();
+    uint8_t *buf = alloc_chunk();
+    if (!buf) {
+        ESP_LOGE("WS", "Failed to allocate buffer for TTS data");
+        return;
+    }
+    memcpy(buf, data->data_ptr, data->data_len);
+
+    ws_inbound_t msg = {
+        .type = WS_INBOUND_BINARY,
+        .data = buf,
+        .len = data->data_len,
+        .received_us = esp_timer_get_time(),
+    };
+    enqueue_inbound(&msg);
+    perf_end(PERF_FRAME_PATH, start);
+}
+
+void get_ws_rx_stats(ws_rx_stats_t *stats) {
+    portENTER_CRITICAL(&rx_stats_lock);
+    *stats = rx_stats;
+    portEXIT_CRITICAL(&rx_stats_lock);
+}
+
+// Sort out events from hedged connect attempts. The first attempt to
+// complete its upgrade becomes ws_client; the others' events only tell
+// connect_hedged() how they went. Returns true for events of ws_client.
+static bool claim_event(esp_websocket_client_handle_t client, int32_t event_id) {
+    bool active = false;
+    TaskHandle_t waiter = NULL;
+
+    portENTER_CRITICAL(&ws_client_lock);
+    if (client && client == ws_client) {
+        active = true;
+    } else if (race_open) {
+        for (int i = 0; i < WS_HEDGE_COUNT; i++) {
+            if (!client || attempts[i].client != client) {
+                continue;
+            }
+            if (event_id == WEBSOCKET_EVENT_CONNECTED && !ws_client) {
+                ws_client = client;
+                ws_endpoint = attempts[i].endpoint;
+                attempts[i].connected_us = esp_timer_get_time();
+                active = true;
+            } else if (event_id == WEBSOCKET_EVENT_ERROR || event_id == WEBSOCKET_EVENT_DISCONNECTED) {
+                attempts[i].failed = true;
+            }
+            waiter = race_waiter;
+        }
+    }
+    portEXIT_CRITICAL(&ws_client_lock);
+
+    if (waiter) {
+        xTaskNotifyGive(waiter);
+    }
+    return active;
+}
+
 void websocket_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data) {
     esp_websocket_event_data_t *data = (esp_websocket_event_data_t *)event_data;
+    int64_t start_us = esp_timer_get_time();
+    
+    if (!claim_event(data ? data->client : NULL, event_id)) {
+        event_id = WEBSOCKET_EVENT_ANY;  // Counted below, not handled
+    }
     
     switch (event_id) {
         case WEBSOCKET_EVENT_CONNECTED:
             ESP_LOGI("WS", "WebSocket connected");
             ws_connected = true;
+            xEventGroupClearBits(state_events, WS_DISCONNECTED_BIT);
+            xEventGroupSetBits(state_events, WS_CONNECTED_BIT);
             
             // DO NOT send messages from event handler - they will fail!
             // The WebSocket internal buffers are not fully ready yet.
@@ -224,31 +490,37 @@ void websocket_event_handler(void *handler_args, esp_event_base_t base, int32_t
             ESP_LOGW("WS", "WebSocket disconnected");
             ws_connected = false;
             ws_handshake_complete = false;  // Reset handshake flag on disconnect
+            xEventGroupClearBits(state_events, WS_CONNECTED_BIT);
+            xEventGroupSetBits(state_events, WS_DISCONNECTED_BIT);
             
-            if (current_state != CLIENT_STATE_SHUTDOWN) {
+            if (get_state() != CLIENT_STATE_SHUTDOWN) {
                 set_state(CLIENT_STATE_STALLED);
                 
-                // Attempt to reconnect with exponential backoff
-                reconnect_websocket();
+                // Reconnect with exponential backoff from the dispatcher,
+                // not from the WebSocket client task
+                ws_inbound_t reconnect = { .type = WS_INBOUND_RECONNECT, .received_us = esp_timer_get_time() };
+                enqueue_inbound(&reconnect);
             }
             break;
             
         case WEBSOCKET_EVENT_DATA:
+            // Only copy the payload here; ws_dispatch_task handles it
             if (data->op_code == WS_TRANSPORT_OPCODES_TEXT) {
-                // Handle text message
-                handle_text_message((char*)data->data_ptr, data->data_len);
+                enqueue_text_fragment(data);
             } else if (data->op_code == WS_TRANSPORT_OPCODES_BINARY) {
-                // Handle binary message (TTS audio from server)
-                handle_binary_message((uint8_t*)data->data_ptr, data->data_len);
+                // TTS audio from server
+                enqueue_binary_frame(data);
             }
             break;
             
         case WEBSOCKET_EVENT_ERROR:
             ESP_LOGE("WS", "WebSocket error");
             ws_connected = false;
+            xEventGroupClearBits(state_events, WS_CONNECTED_BIT);
+            xEventGroupSetBits(state_events, WS_DISCONNECTED_BIT);
             
             // Handle error gracefully by signaling for reconnection
-            if (current_state != CLIENT_STATE_SHUTDOWN) {
+            if (get_state() != CLIENT_STATE_SHUTDOWN) {
                 set_state(CLIENT_STATE_STALLED);
                 
                 // Schedule reconnection from a separate task to avoid WebSocket task deadlock
@@ -258,6 +530,74 @@ void websocket_event_handler(void *handler_args, esp_event_base_t base, int32_t
             }
             break;
     }
+
+    // Time the client task spent away from the socket for this event
+    uint32_t stall_us = (uint32_t)(esp_timer_get_time() - start_us);
+    portENTER_CRITICAL(&rx_stats_lock);
+    rx_stats.events++;
+    rx_stats.stall_total_us += stall_us;
+    if (stall_us > rx_stats.stall_max_us) {
+        rx_stats.stall_max_us = stall_us;
+    }
+    portEXIT_CRITICAL(&rx_stats_lock);
+}
+
+void ws_dispatch_task(void *pvParameters) {
+    ws_inbound_t msg;
+
+    ESP_LOGI("WS", "Starting inbound message dispatcher");
+
+    while (1) {
+        if (xQueueReceive(q_ws_inbound, &msg, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        if (msg.type == WS_INBOUND_SHUTDOWN) {
+            break;
+        }
+
+        int64_t start_us = esp_timer_get_time();
+
+        switch (msg.type) {
+            case WS_INBOUND_TEXT:
+                handle_text_message((char *)msg.data, msg.len);
+                free(msg.data);
+                break;
+
+            case WS_INBOUND_BINARY:
+                handle_binary_message(msg.data, msg.len);
+                break;
+
+            case WS_INBOUND_RECONNECT:
+                reconnect_websocket();
+                break;
+
+            default:
+                break;
+        }
+
+        int64_t done_us = esp_timer_get_time();
+        uint32_t handle_us = (uint32_t)(done_us - start_us);
+        bool overrun = (msg.type == WS_INBOUND_TEXT && handle_us > WS_TEXT_BUDGET_US);
+
+        portENTER_CRITICAL(&rx_stats_lock);
+        rx_stats.dispatched++;
+        if (handle_us > rx_stats.dispatch_max_us && msg.type != WS_INBOUND_RECONNECT) {
+            rx_stats.dispatch_max_us = handle_us;
+        }
+        if (overrun) {
+            rx_stats.budget_overruns++;
+        }
+        portEXIT_CRITICAL(&rx_stats_lock);
+
+        if (overrun) {
+            ESP_LOGW("WS", "Text message took %lu us (budget %d us, queued %lu us)",
+                     (unsigned long)handle_us, WS_TEXT_BUDGET_US,
+                     (unsigned long)(start_us - msg.received_us));
+        }
+    }
+
+    ESP_LOGI("WS", "Inbound message dispatcher stopping");
+    vTaskDelete(NULL);
 }
 
 void handle_text_message(char *message, size_t len) {
@@ -276,6 +616,24 @@ void handle_text_message(char *message, size_t len) {
     if (strcmp(type, "ready") == 0) {
         ESP_LOGI("WS", "Server ready message received");
         set_state(CLIENT_STATE_IDLE);
+
+        // Sent on every connection, so renegotiate from the legacy profile
+        session_profile_reset();
+        udp_audio_reset();
+        configure_ws_mux(false);
+        cJSON *hello = session_profile_hello();
+        if (hello && !ws_send_json(hello)) {
+            ESP_LOGW("WS", "Failed to send hello; keeping the legacy session profile");
+        }
+    }
+    else if (strcmp(type, "session_config") == 0) {
+        if (session_profile_apply(json)) {
+            udp_audio_configure(cJSON_GetObjectItem(json, "udp_audio"));
+            configure_ws_mux(session_feature_enabled(SESSION_FEATURE_MUX));
+        }
+    }
+    else if (strcmp(type, "config_update") == 0) {
+        runtime_config_handle_update(json);
     }
     else if (strcmp(type, "partial") == 0) {
         const char *text = cJSON_GetStringValue(cJSON_GetObjectItem(json, "text"));
@@ -290,7 +648,18 @@ void handle_text_message(char *message, size_t len) {
         ESP_LOGI("WS", "TTS ready received");
         
         // Check if we can play back audio
-        if (current_state == CLIENT_STATE_IDLE || current_state == CLIENT_STATE_PROCESSING) {
+        if (get_state() == CLIENT_STATE_IDLE || get_state() == CLIENT_STATE_PROCESSING) {
+            // Keep this response for local replay unless the session turned
+            // the cache off (a zero size only times the round trip, which
+            // runs from when the recording was handed over)
+            cJSON *turn = cJSON_GetObjectItem(json, "turn");
+            cJSON *file_size = cJSON_GetObjectItem(json, "fileSize");
+            bool cache = session_feature_enabled(SESSION_FEATURE_TTS_CACHE) && cJSON_IsNumber(file_size);
+            state_snapshot_t snap = get_state_snapshot();
+            tts_cache_begin(cJSON_IsNumber(turn) ? (int32_t)turn->valuedouble : TTS_CACHE_LATEST,
+                            cache ? (size_t)file_size->valuedouble : 0,
+                            snap.state == CLIENT_STATE_PROCESSING ? snap.entered_us : esp_timer_get_time());
+
             // Send ready_for_playback to server
             cJSON *ready_json = cJSON_CreateObject();
             cJSON_AddStringToObject(ready_json, "type", "ready_for_playback");
@@ -302,7 +671,7 @@ void handle_text_message(char *message, size_t len) {
             set_state(CLIENT_STATE_PLAYING);
         } else {
             // Busy - send reject
-            send_reject_message("busy", state_to_string(current_state));
+            send_reject_message("busy", state_to_string(get_state()));
         }
     }
     else if (strcmp(type, "tts_chunk_meta") == 0) {
@@ -314,15 +683,15 @@ void handle_text_message(char *message, size_t len) {
         // Server indicates TTS streaming is complete
         ESP_LOGI("WS", "TTS streaming complete");
         
-        // Send playback complete message
-        cJSON *complete_json = cJSON_CreateObject();
-        cJSON_AddStringToObject(complete_json, "type", "playback_complete");
-        cJSON_AddStringToObject(complete_json, "session", SESSION_ID);
-        
-        ws_send_json(complete_json);
-        // Note: ws_send_json takes ownership of complete_json, so we don't delete it here
-        
-        set_state(CLIENT_STATE_IDLE);
+        if (get_state() == CLIENT_STATE_PLAYING) {
+            // Let the playback task drain q_playback first; its PLAYING -> IDLE
+            // transition sends playback_complete
+            audio_playback_end_of_stream();
+        } else if (get_state() != CLIENT_STATE_RECORDING) {
+            // In RECORDING this is the tail of a stream cut short by a
+            // barge-in, and must not end the new recording
+            set_state(CLIENT_STATE_IDLE);
+        }
     }
     else if (strcmp(type, "image_received") == 0) {
         ESP_LOGI("WS", "Image received by server");
@@ -333,29 +702,35 @@ void handle_text_message(char *message, size_t len) {
         const char *reason = cJSON_GetStringValue(cJSON_GetObjectItem(json, "reason"));
         ESP_LOGW("WS", "Server requested re-record: %s", reason ? reason : "unknown");
         
-        if (current_state == CLIENT_STATE_IDLE) {
+        if (get_state() == CLIENT_STATE_IDLE) {
             // Indicate need for user to re-record
-            // Could flash LED or play sound
-            for (int i = 0; i < 5; i++) {
-                gpio_set_level(GPIO_LED, 1);
-                vTaskDelay(pdMS_TO_TICKS(200));
-                gpio_set_level(GPIO_LED, 0);
-                vTaskDelay(pdMS_TO_TICKS(200));
-            }
-        } else if (current_state == CLIENT_STATE_PROCESSING) {
+            led_flash_async(5, 200);
+            earcon_request(EARCON_REPEAT);
+        } else if (get_state() == CLIENT_STATE_PROCESSING) {
             // Still in processing state, just note the request
             set_state(CLIENT_STATE_IDLE); // Clear processing state
             
-            // Flash LED to indicate re-recording needed
-            for (int i = 0; i < 5; i++) {
-                gpio_set_level(GPIO_LED, 1);
-                vTaskDelay(pdMS_TO_TICKS(200));
-                gpio_set_level(GPIO_LED, 0);
-                vTaskDelay(pdMS_TO_TICKS(200));
-            }
+            // Flash LED and prompt to indicate re-recording needed
+            led_flash_async(5, 200);
+            earcon_request(EARCON_REPEAT);
         } else {
             // Can't re-record now, server will request again
-            send_reject_message("busy", state_to_string(current_state));
+            send_reject_message("busy", state_to_string(get_state()));
+        }
+    }
+    else if (strcmp(type, "replay") == 0) {
+        // Server asks for a cached response to be played again locally
+        cJSON *turn = cJSON_GetObjectItem(json, "turn");
+        int32_t turn_id = cJSON_IsNumber(turn) ? (int32_t)turn->valuedouble : TTS_CACHE_LATEST;
+
+        if (get_state() != CLIENT_STATE_IDLE) {
+            send_reject_message("busy", state_to_string(get_state()));
+        } else if (!tts_cache_play(turn_id)) {
+            cJSON *miss = cJSON_CreateObject();
+            cJSON_AddStringToObject(miss, "type", "replay_miss");
+            cJSON_AddStringToObject(miss, "session", SESSION_ID);
+            cJSON_AddNumberToObject(miss, "turn", turn_id);
+            ws_send_json(miss);
         }
     }
     else if (strcmp(type, "offer_download") == 0) {
@@ -377,11 +752,35 @@ void handle_text_message(char *message, size_t len) {
         ESP_LOGW("WS", "Server requires user intervention: %s", message ? message : "unknown");
         
         // Rapid flash LED to indicate issue
-        for (int i = 0; i < 10; i++) {
-            gpio_set_level(GPIO_LED, 1);
-            vTaskDelay(pdMS_TO_TICKS(100));
-            gpio_set_level(GPIO_LED, 0);
-            vTaskDelay(pdMS_TO_TICKS(100));
+        led_flash_async(10, 100);
+    }
+    else if (strcmp(type, "selftest") == 0) {
+        // Server asks for an audio pipeline self-test; the report follows
+        // as "selftest_report" once it has run
+        const char *mode_name = cJSON_GetStringValue(cJSON_GetObjectItem(json, "mode"));
+        cJSON *duration = cJSON_GetObjectItem(json, "duration_ms");
+        uint32_t duration_ms = 0;  // Default
+        selftest_mode_t mode = SELFTEST_LOOPBACK;
+
+        if (cJSON_IsNumber(duration) && duration->valuedouble > 0) {
+            duration_ms = duration->valuedouble < SELFTEST_MAX_DURATION_MS ?
+                          (uint32_t)duration->valuedouble : SELFTEST_MAX_DURATION_MS;
+        }
+
+        if (mode_name && !selftest_mode_from_string(mode_name, &mode)) {
+            ESP_LOGW("WS", "Unknown self-test mode '%s'", mode_name);
+            send_reject_message("bad_mode", state_to_string(get_state()));
+        } else if (!session_feature_enabled(SESSION_FEATURE_SELFTEST)) {
+            send_reject_message("disabled", state_to_string(get_state()));
+        } else if (!selftest_request(mode, duration_ms)) {
+            send_reject_message("busy", state_to_string(get_state()));
+        }
+    }
+    else if (strcmp(type, "pong") == 0) {
+        // Only self-test pings carry a timestamp
+        cJSON *sent = cJSON_GetObjectItem(json, "t");
+        if (cJSON_IsNumber(sent)) {
+            selftest_note_pong((int64_t)sent->valuedouble);
         }
     }
     else if (strcmp(type, "ack") == 0) {
@@ -389,40 +788,43 @@ void handle_text_message(char *message, size_t len) {
         int seq = cJSON_GetNumberValue(cJSON_GetObjectItem(json, "seq"));
         const char *ref = cJSON_GetStringValue(cJSON_GetObjectItem(json, "ref"));
         ESP_LOGD("WS", "Ack received for %s seq %d", ref ? ref : "unknown", seq);
+        if (ref && strcmp(ref, "chunk") == 0 && seq >= 0) {
+            audio_uplink_note_ack((uint32_t)seq);
+        }
     }
     
     cJSON_Delete(json);
 }
 
-void handle_binary_message(const uint8_t *data, size_t data_len) {
-    if (current_state == CLIENT_STATE_PLAYING) {
-        // Allocate a chunk for the binary data
-        uint8_t *buf = alloc_chunk();
-        if (buf && data_len <= CHUNK_BYTES) {
-            // Copy data to our buffer
-            memcpy(buf, data, data_len);
-            
-            // Create audio chunk for playback queue
-            audio_chunk_t chunk;
-            chunk.data = buf;
-            chunk.len = data_len;
-            chunk.seq = 0;  // Not used for playback
-            chunk.timestamp = xTaskGetTickCount();
-            
-            // Send to playback queue
-            if (xQueueSend(q_playback, &chunk, portMAX_DELAY) != pdTRUE) {
-                ESP_LOGE("WS", "Failed to send TTS chunk to playback queue");
-                free_chunk(buf);
-            }
-        } else {
-            ESP_LOGE("WS", "Failed to allocate buffer for TTS data or data too large");
-        }
-    } else {
-        ESP_LOGW("WS", "Received binary data while not in playing state, ignoring");
+void handle_binary_message(uint8_t *buf, size_t data_len) {
+    if (get_state() != CLIENT_STATE_PLAYING) {
+        // Playback ended while the frame was queued
+        free_chunk(buf);
+        return;
+    }
+
+    // Create audio chunk for playback queue
+    audio_chunk_t chunk;
+    chunk.data = buf;
+    chunk.len = data_len;
+    chunk.seq = audio_playback_epoch();  // Stale if a flush happens while queued
+    chunk.timestamp = xTaskGetTickCount();
+
+    // Bounded wait: backpressure on the server without stalling the dispatcher forever
+    if (xQueueSend(q_playback, &chunk, pdMS_TO_TICKS(WS_BINARY_BUDGET_MS)) != pdTRUE) {
+        ESP_LOGE("WS", "Playback queue full for %d ms, dropping TTS chunk", WS_BINARY_BUDGET_MS);
+        free_chunk(buf);
+        portENTER_CRITICAL(&rx_stats_lock);
+        rx_stats.playback_drops++;
+        portEXIT_CRITICAL(&rx_stats_lock);
     }
 }
 
 bool ws_send_json(cJSON *json) {
+    return ws_send_json_after(json, WS_MUX_CONTROL);
+}
+
+bool ws_send_json_after(cJSON *json, uint8_t channel) {
     if (!ws_client) {
         ESP_LOGW("WS", "WebSocket client not initialized");
         // Clean up the JSON object since we're not sending it
@@ -449,16 +851,12 @@ bool ws_send_json(cJSON *json) {
     }
     
     // Create message structure for queue
-    struct {
-        cJSON *json;
-        bool is_binary;
-        uint8_t *data;
-        size_t len;
-    } message = {
+    ws_message_t message = {
         .json = json,
         .is_binary = false,
         .data = NULL,
-        .len = 0
+        .len = 0,
+        .after = channel,
     };
     
     // Add message to queue with timeout
@@ -474,105 +872,287 @@ bool ws_send_json(cJSON *json) {
     return true;
 }
 
-bool ws_send_binary(uint8_t *data, size_t len) {
+bool ws_send_audio(uint32_t seq, uint8_t *data, size_t len, uint8_t flags) {
     if (!ws_client) {
         ESP_LOGW("WS", "WebSocket client not initialized");
-        // Clean up the data since we're not sending it
-        if (data) {
-            free(data);
-        }
+        // Return the chunk since we're not sending it
+        free_chunk(data);
         return false;
     }
     
     // Use the official is_connected check
     if (!esp_websocket_client_is_connected(ws_client)) {
         ESP_LOGW("WS", "WebSocket not connected, cannot send binary");
-        // Clean up the data since we're not sending it
-        if (data) {
-            free(data);
-        }
+        // Return the chunk since we're not sending it
+        free_chunk(data);
         return false;
     }
     
     // Validate binary data before queuing
     if (!data || len == 0) {
         ESP_LOGW("WS", "Invalid binary data provided for sending");
-        // Clean up the data since it's invalid
-        if (data) {
-            free(data);
-        }
+        // Return the chunk since it's invalid
+        free_chunk(data);
         return false;
     }
     
     // Create message structure for queue
-    struct {
-        cJSON *json;
-        bool is_binary;
-        uint8_t *data;
-        size_t len;
-    } message = {
+    ws_message_t message = {
         .json = NULL,
         .is_binary = true,
         .data = data,
-        .len = len
+        .len = len,
+        .channel = WS_MUX_AUDIO,
+        .audio_flags = flags,
+        .seq = seq,
     };
     
     // Add message to queue with timeout
     if (q_ws_messages && xQueueSend(q_ws_messages, &message, pdMS_TO_TICKS(100)) != pdTRUE) {
         ESP_LOGE("WS", "Failed to queue WebSocket binary message");
-        // Clean up the data since we couldn't queue it
-        if (data) {
-            free(data);
-        }
+        // Return the chunk since we couldn't queue it
+        free_chunk(data);
         return false;
     }
     
     return true;
 }
 
+bool ws_send_bulk(uint8_t channel, uint8_t *data, size_t len) {
+    // Only the multiplexer can tell a server what else a binary frame holds
+    if (!ws_mux_enabled() || channel == WS_MUX_CONTROL || channel == WS_MUX_AUDIO || channel >= WS_MUX_CHANNELS ||
+        !data || len == 0) {
+        free(data);
+        return false;
+    }
+
+    ws_message_t message = {
+        .is_binary = true,
+        .data = data,
+        .len = len,
+        .channel = channel,
+    };
+    if (!q_ws_messages || xQueueSend(q_ws_messages, &message, pdMS_TO_TICKS(100)) != pdTRUE) {
+        ESP_LOGE("WS", "Failed to queue %u bytes for channel %u", (unsigned)len, channel);
+        free(data);
+        return false;
+    }
+    return true;
+}
+
 esp_websocket_client_handle_t get_ws_client() {
     return ws_client;
 }
 
+// Make a client ready for a new connect. A stop queued for websocket_task is
+// done here instead; one already running there is waited for.
+static void reclaim_client(esp_websocket_client_handle_t client) {
+    portENTER_CRITICAL(&ws_client_lock);
+    if (cancel_pending == client) {
+        cancel_pending = NULL;
+    }
+    portEXIT_CRITICAL(&ws_client_lock);
+    while (cancel_running == client) {
+        vTaskDelay(pdMS_TO_TICKS(20));
+    }
+    esp_websocket_client_stop(client);  // Fails harmlessly if it is not running
+}
+
+static void start_attempt(int slot, const ws_candidate_t *candidate) {
+    esp_websocket_client_handle_t client = hedge_clients[slot];
+    reclaim_client(client);
+
+    portENTER_CRITICAL(&ws_client_lock);
+    attempts[slot] = (ws_attempt_t){
+        .client = client,
+        .endpoint = candidate->endpoint,
+        .started_us = esp_timer_get_time(),
+    };
+    portEXIT_CRITICAL(&ws_client_lock);
+
+    runtime_config_t settings;
+    runtime_config_get(&settings);
+    esp_websocket_client_set_ping_interval_sec(client, settings.ping_interval_sec);
+
+    ESP_LOGI("WS", "Connecting to %s", candidate->endpoint_url);
+    if (esp_websocket_client_set_uri(client, candidate->url) != ESP_OK ||
+        esp_websocket_client_start(client) != ESP_OK) {
+        ESP_LOGE("WS", "Failed to start connect to %s", candidate->endpoint_url);
+        portENTER_CRITICAL(&ws_client_lock);
+        attempts[slot].failed = true;
+        portEXIT_CRITICAL(&ws_client_lock);
+    }
+}
+
+/**
+ * @brief Connect to the best two endpoints, keeping the first to upgrade
+ *
+ * The best endpoint is tried at once and the second after
+ * CONFIG_HOTPIN_WS_HEDGE_DELAY_MS, or as soon as the first fails. The first
+ * to complete the WebSocket upgrade becomes ws_client and the other attempt
+ * is cancelled. Runs in the dispatcher.
+ *
+ * @return true if an endpoint connected within CONFIG_HOTPIN_WS_CONNECT_TIMEOUT_MS
+ */
+static bool connect_hedged(void) {
+    static ws_candidate_t candidates[WS_HEDGE_COUNT];  // Too large for the dispatcher's stack
+    int count = get_ws_candidates(candidates, WS_HEDGE_COUNT);
+    if (count == 0) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&ws_client_lock);
+    memset(attempts, 0, sizeof(attempts));
+    race_waiter = xTaskGetCurrentTaskHandle();
+    race_open = true;
+    portEXIT_CRITICAL(&ws_client_lock);
+    ulTaskNotifyTake(pdTRUE, 0);  // Drop notifications from an earlier race
+
+    int64_t start_us = esp_timer_get_time();
+    int64_t hedge_us = start_us + (int64_t)CONFIG_HOTPIN_WS_HEDGE_DELAY_MS * 1000;
+    int64_t deadline_us = start_us + (int64_t)CONFIG_HOTPIN_WS_CONNECT_TIMEOUT_MS * 1000;
+    int started;
+    start_attempt(0, &candidates[0]);
+    started = 1;
+
+    while (1) {
+        portENTER_CRITICAL(&ws_client_lock);
+        bool won = ws_client != NULL;
+        bool all_failed = true;
+        for (int i = 0; i < started; i++) {
+            all_failed &= attempts[i].failed;
+        }
+        portEXIT_CRITICAL(&ws_client_lock);
+
+        int64_t now_us = esp_timer_get_time();
+        if (won || now_us >= deadline_us) {
+            break;
+        }
+        if (started < count && (all_failed || now_us >= hedge_us)) {
+            start_attempt(started, &candidates[started]);
+            started++;
+            continue;
+        }
+        if (all_failed) {
+            break;
+        }
+        int64_t wake_us = (started < count && hedge_us < deadline_us) ? hedge_us : deadline_us;
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS((wake_us - now_us) / 1000) + 1);
+    }
+
+    portENTER_CRITICAL(&ws_client_lock);
+    race_open = false;
+    race_waiter = NULL;
+    esp_websocket_client_handle_t winner = ws_client;
+    portEXIT_CRITICAL(&ws_client_lock);
+
+    for (int i = 0; i < started; i++) {
+        ws_attempt_t *attempt = &attempts[i];
+        if (attempt->client == winner) {
+            uint32_t connect_ms = (uint32_t)((attempt->connected_us - attempt->started_us) / 1000);
+            ESP_LOGI("WS", "Connected to %s in %"PRIu32" ms", candidates[i].endpoint_url, connect_ms);
+            note_ws_connect_result(attempt->endpoint, true, connect_ms);
+            continue;
+        }
+
+        // One that failed, or did not connect in time, is marked down; a
+        // slower one that lost the race only loses a little score
+        if (attempt->failed || !winner) {
+            ESP_LOGW("WS", "Connect to %s %s", candidates[i].endpoint_url, attempt->failed ? "failed" : "timed out");
+            note_ws_connect_result(attempt->endpoint, false, 0);
+        } else {
+            ESP_LOGI("WS", "Cancelling slower connect to %s", candidates[i].endpoint_url);
+            note_ws_connect_slow(attempt->endpoint);
+        }
+        if (attempt->failed) {
+            esp_websocket_client_stop(attempt->client);
+            continue;
+        }
+        portENTER_CRITICAL(&ws_client_lock);
+        bool queued = cancel_pending == NULL;
+        if (queued) {
+            cancel_pending = attempt->client;
+        }
+        portEXIT_CRITICAL(&ws_client_lock);
+        if (queued) {
+            xEventGroupSetBits(state_events, WS_CANCEL_BIT);
+        } else {
+            esp_websocket_client_stop(attempt->client);
+        }
+    }
+    return winner != NULL;
+}
+
+// Stop the losing attempt connect_hedged() left behind (websocket_task)
+static void stop_cancelled_attempt(void) {
+    portENTER_CRITICAL(&ws_client_lock);
+    esp_websocket_client_handle_t client = cancel_pending;
+    cancel_pending = NULL;
+    cancel_running = client;
+    portEXIT_CRITICAL(&ws_client_lock);
+
+    if (client) {
+        esp_websocket_client_stop(client);
+    }
+
+    portENTER_CRITICAL(&ws_client_lock);
+    cancel_running = NULL;
+    portEXIT_CRITICAL(&ws_client_lock);
+}
+
 void reconnect_websocket() {
-    // Regenerate session ID to ensure uniqueness for each connection attempt
-    // This prevents session conflicts when server still has previous session active
-    ESP_LOGI("WS", "Regenerating session ID for new connection attempt");
-    init_session_id();
-    
-    // Add a delay to allow the server to clean up the previous session
-    ESP_LOGI("WS", "Waiting for server session cleanup...");
-    vTaskDelay(pdMS_TO_TICKS(5000)); // 5 second delay to allow server cleanup (increased from 3s)
+    if (esp_websocket_client_is_connected(ws_client)) {
+        return;  // Already connected (a stale request)
+    }
     
-    // Exponential backoff: 1s, 2s, 4s, 8s, 16s, 32s, 60s cap
-    int delay_seconds = 1;
-    const int max_delay = 60; // 60 seconds max
+    // Forget the lost connection; its client is reused by the next attempt
+    portENTER_CRITICAL(&ws_client_lock);
+    int lost_endpoint = ws_client ? ws_endpoint : -1;
+    ws_client = NULL;
+    ws_endpoint = -1;
+    portEXIT_CRITICAL(&ws_client_lock);
+    if (lost_endpoint >= 0) {
+        note_ws_connection_lost(lost_endpoint);
+    }
     
-    while (current_state != CLIENT_STATE_SHUTDOWN && !ws_connected) {
-        ESP_LOGI("WS", "Attempting WebSocket reconnection in %d seconds...", delay_seconds);
-        
-        vTaskDelay(pdMS_TO_TICKS(delay_seconds * 1000));
+    while (get_state() != CLIENT_STATE_SHUTDOWN) {
+        // Regenerate session ID to ensure uniqueness for each connection attempt
+        // This prevents session conflicts when server still has previous session active.
+        // A recording cut off by the outage keeps its ID: the server holds it
+        // open for the spilled chunks and the held recording_stopped, and
+        // replaces its stale connection for this session
+        if (!audio_recording_open()) {
+            init_session_id();
+        }
         
-        if (esp_websocket_client_is_connected(ws_client)) {
-            // Already connected somehow
+        if (connect_hedged()) {
+            ESP_LOGI("WS", "WebSocket connected with session ID: %s", SESSION_ID);
             break;
         }
         
-        // Use proper API to restart the WebSocket client
-        // Don't call stop from within WebSocket task to avoid deadlock
-        esp_err_t err = esp_websocket_client_start(ws_client);
-        if (err == ESP_OK) {
-            ESP_LOGI("WS", "WebSocket reconnected successfully with new session ID: %s", SESSION_ID);
-            break;
-        } else {
-            ESP_LOGE("WS", "WebSocket reconnection failed: %s", esp_err_to_name(err));
-            
-            // Exponential backoff
-            delay_seconds *= 2;
-            if (delay_seconds > max_delay) {
-                delay_seconds = max_delay;
-            }
+        // Every endpoint failed or is in backoff: wait for the first to come out
+        uint32_t wait_ms = get_ws_retry_wait_ms();
+        if (wait_ms < 250) {
+            wait_ms = 250;
+        } else if (wait_ms > ENDPOINT_BACKOFF_MAX_MS) {
+            wait_ms = ENDPOINT_BACKOFF_MAX_MS;
+        }
+        ESP_LOGW("WS", "No server reachable, retrying in %"PRIu32" ms", wait_ms);
+#ifdef CONFIG_HOTPIN_DISCOVERY_BEACON
+        // A beacon from a server that is back, or has moved, ends the wait
+        char beacon_url[ENDPOINT_URL_LEN];
+        int64_t wait_until_us = esp_timer_get_time() + (int64_t)wait_ms * 1000;
+        if (listen_for_beacon(beacon_url, sizeof(beacon_url), wait_ms)) {
+            note_ws_endpoint_announced(beacon_url);
+            continue;
         }
+        int64_t left_us = wait_until_us - esp_timer_get_time();
+        if (left_us > 0) {
+            vTaskDelay(pdMS_TO_TICKS(left_us / 1000));  // Could not listen
+        }
+#else
+        vTaskDelay(pdMS_TO_TICKS(wait_ms));
+#endif
     }
 }
 
@@ -589,85 +1169,101 @@ void websocket_task(void *pvParameters)
     ESP_LOGI("WS", "Starting WebSocket task - handling handshake and connection management");
     
     // Connection monitoring variables
+    // Failed reconnects are retried on the endpoint list's backoff (capped at
+    // ENDPOINT_BACKOFF_MAX_MS), so only a long outage restarts the device
     int connection_failures = 0;
-    const int max_connection_failures = 10; // Maximum consecutive connection failures before system restart
     TickType_t last_successful_connection = xTaskGetTickCount();
     const TickType_t connection_timeout_ticks = pdMS_TO_TICKS(300000); // 5 minutes timeout
     
-    // Wait for WebSocket to be connected
-    int wait_count = 0;
-    const int max_wait = 50; // 5 seconds at 100ms intervals
-    
-    while (current_state != CLIENT_STATE_SHUTDOWN && wait_count < max_wait) {
-        if (ws_connected && ws_handshake_complete) {
-            ESP_LOGI("WS", "WebSocket already connected and handshake complete");
-            break;
-        } else if (ws_connected && !ws_handshake_complete) {
-            ESP_LOGI("WS", "WebSocket connected, performing handshake...");
-            
-            // Send client_on message to complete handshake
-            cJSON *hello_json = cJSON_CreateObject();
-            cJSON_AddStringToObject(hello_json, "type", "client_on");
-            cJSON_AddStringToObject(hello_json, "session", SESSION_ID);
-            cJSON_AddStringToObject(hello_json, "version", "1.0"); // Add version info
-            
-            if (ws_send_json(hello_json)) {
-                ESP_LOGI("WS", "Handshake message sent successfully");
-                ws_handshake_complete = true;
-                
-                // Set state to IDLE after successful handshake
-                set_state(CLIENT_STATE_IDLE);
-            } else {
-                ESP_LOGE("WS", "Failed to send handshake message");
-            }
-            break;
-        } else {
-            ESP_LOGD("WS", "Waiting for WebSocket connection... (%d/%d)", wait_count, max_wait);
-            vTaskDelay(pdMS_TO_TICKS(100));
-            wait_count++;
-        }
-    }
-    
-    if (current_state == CLIENT_STATE_SHUTDOWN) {
+    const EventBits_t shutdown_bit = STATE_BIT(CLIENT_STATE_SHUTDOWN);
+
+    // Wait (up to 5 seconds) for the event handler to report the connection
+    EventBits_t bits = xEventGroupWaitBits(state_events, WS_CONNECTED_BIT | shutdown_bit,
+                                           pdFALSE, pdFALSE, pdMS_TO_TICKS(5000));
+    record_task_wakeup(WAKEUP_WEBSOCKET);
+
+    if (bits & shutdown_bit) {
         ESP_LOGI("WS", "WebSocket task shutting down due to client shutdown");
         vTaskDelete(NULL);
     }
-    
-    if (!ws_connected) {
+
+    if (ws_connected && ws_handshake_complete) {
+        ESP_LOGI("WS", "WebSocket already connected and handshake complete");
+    } else if (ws_connected) {
+        ESP_LOGI("WS", "WebSocket connected, performing handshake...");
+
+        // Send client_on message to complete handshake
+        cJSON *hello_json = cJSON_CreateObject();
+        cJSON_AddStringToObject(hello_json, "type", "client_on");
+        cJSON_AddStringToObject(hello_json, "session", SESSION_ID);
+        cJSON_AddStringToObject(hello_json, "version", HOTPIN_FIRMWARE_VERSION);
+
+        if (ws_send_json(hello_json)) {
+            ESP_LOGI("WS", "Handshake message sent successfully");
+            ws_handshake_complete = true;
+
+            // Set state to IDLE after successful handshake
+            set_state(CLIENT_STATE_IDLE);
+        } else {
+            ESP_LOGE("WS", "Failed to send handshake message");
+        }
+    } else {
         ESP_LOGW("WS", "WebSocket connection not established after timeout, will continue to monitor");
     }
-    
-    // Continue monitoring connection status and handle reconnection if needed
-    while (current_state != CLIENT_STATE_SHUTDOWN) {
-        if (!ws_connected) {
+
+    // Continue monitoring connection status and handle reconnection if needed.
+    // While connected the task sleeps until the event handler reports a
+    // disconnect; while disconnected it wakes every 5 seconds to count failures.
+    const EventBits_t cancel_bit = WS_CANCEL_BIT;
+    const EventBits_t mdns_bit = MDNS_CHANGED_BIT;
+    bool woken_for_work = false;
+    while (1) {
+        if (!ws_connected && !woken_for_work) {
             // Update connection failure counter
             connection_failures++;
             
-            // Check if we've exceeded maximum consecutive failures
-            if (connection_failures >= max_connection_failures) {
-                ESP_LOGE("WS", "Maximum consecutive connection failures (%d) exceeded - restarting system", max_connection_failures);
-                esp_restart(); // Restart the entire system to recover
-            }
-            
-            // Check if we've been disconnected for too long
+            // Check if we've been disconnected for too long. A restart would
+            // discard the spilled backlog and the open recording, so it waits
+            // while either is still to be delivered
             TickType_t time_since_last_connection = xTaskGetTickCount() - last_successful_connection;
-            if (time_since_last_connection > connection_timeout_ticks) {
+            if (time_since_last_connection > connection_timeout_ticks &&
+                audio_spill_pending() == 0 && !audio_recording_open()) {
                 ESP_LOGE("WS", "Connection timeout exceeded (%lu ms) - restarting system", time_since_last_connection * portTICK_PERIOD_MS);
                 esp_restart(); // Restart the entire system to recover
             }
             
             // Log connection failure but continue monitoring
-            ESP_LOGW("WS", "WebSocket disconnected (failure %d/%d), will continue to monitor", connection_failures, max_connection_failures);
+            ESP_LOGW("WS", "WebSocket disconnected (check %d), will continue to monitor", connection_failures);
             
-            // Small delay before checking again
-            vTaskDelay(pdMS_TO_TICKS(5000)); // Check every 5 seconds
+            bits = xEventGroupWaitBits(state_events, WS_CONNECTED_BIT | shutdown_bit | cancel_bit | mdns_bit,
+                                       pdFALSE, pdFALSE, pdMS_TO_TICKS(5000));
+        } else if (!ws_connected) {
+            bits = xEventGroupWaitBits(state_events, WS_CONNECTED_BIT | shutdown_bit | cancel_bit | mdns_bit,
+                                       pdFALSE, pdFALSE, pdMS_TO_TICKS(5000));
         } else {
             // WebSocket is connected, reset failure counter
             connection_failures = 0;
             last_successful_connection = xTaskGetTickCount();
             
-            // Small delay to prevent busy looping
-            vTaskDelay(pdMS_TO_TICKS(1000)); // Check every second when connected
+            bits = xEventGroupWaitBits(state_events, WS_DISCONNECTED_BIT | shutdown_bit | cancel_bit | mdns_bit,
+                                       pdFALSE, pdFALSE, portMAX_DELAY);
+        }
+        record_task_wakeup(WAKEUP_WEBSOCKET);
+
+        if (bits & shutdown_bit) {
+            break;
+        }
+        // Woken for work, not by a connection change: no failure to count
+        woken_for_work = (bits & (cancel_bit | mdns_bit)) != 0;
+        // A hedged connect left a losing attempt to stop (connect_hedged())
+        if (bits & cancel_bit) {
+            xEventGroupClearBits(state_events, cancel_bit);
+            stop_cancelled_attempt();
+        }
+        // Server announcements, held by the mDNS task (NVS writes happen here)
+        if (bits & mdns_bit) {
+            xEventGroupClearBits(state_events, mdns_bit);
+            mdns_discovery_apply();
         }
     }
     
@@ -675,70 +1271,344 @@ void websocket_task(void *pvParameters)
     vTaskDelete(NULL);
 }
 
+// Without mux an audio frame goes as audio_chunk_meta, then the bare frame
+static void send_audio_in_order(esp_websocket_client_handle_t client, const ws_message_t *message) {
+    cJSON *meta_json = cJSON_CreateObject();
+    cJSON_AddStringToObject(meta_json, "type", "audio_chunk_meta");
+    cJSON_AddStringToObject(meta_json, "session", SESSION_ID);
+    cJSON_AddNumberToObject(meta_json, "seq", message->seq);
+    cJSON_AddNumberToObject(meta_json, "len_bytes", message->len);
+    if (message->audio_flags & WS_AUDIO_REPLAY) {
+        cJSON_AddBoolToObject(meta_json, "replay", true);
+    }
+    char *meta_str = cJSON_PrintUnformatted(meta_json);
+    cJSON_Delete(meta_json);
+    if (!meta_str) {
+        ESP_LOGE("WS", "Failed to serialize audio chunk metadata for seq %"PRIu32, message->seq);
+        return;
+    }
+
+    esp_err_t err = esp_websocket_client_send_text(client, meta_str, strlen(meta_str), pdMS_TO_TICKS(5000));
+    free(meta_str);
+    int64_t send_start_us = esp_timer_get_time();
+    if (err == ESP_OK) {
+        err = esp_websocket_client_send_bin(client, (char*)message->data, message->len, pdMS_TO_TICKS(5000));
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE("WS", "Failed to send audio chunk %"PRIu32": %s (0x%x)", message->seq, esp_err_to_name(err), err);
+    } else if (message->audio_flags & WS_AUDIO_LIVE) {
+        // Replayed and dictated audio would skew the live pacing
+        audio_uplink_note_sent(message->len, (uint32_t)(esp_timer_get_time() - send_start_us));
+    }
+}
+
+// Sessions without mux: each message whole, in the order queued
+static void send_in_order(ws_message_t *message) {
+    // Validate message data before processing to prevent corruption
+    if (message->is_binary && message->channel != WS_MUX_AUDIO) {
+        // Queued for a multiplexed session that has since ended
+        free(message->data);
+    } else if (message->is_binary) {
+        // Validate binary message data
+        if (message->data && message->len > 0) {
+            // Send binary message directly using ESP-IDF API
+            esp_websocket_client_handle_t client = ws_client;  // Changes on failover
+            if (client && esp_websocket_client_is_connected(client)) {
+                send_audio_in_order(client, message);
+            } else {
+                ESP_LOGW("WS", "WebSocket not connected, cannot send binary message");
+            }
+        } else {
+            ESP_LOGW("WS", "Invalid binary message data - ignoring");
+        }
+        // Binary payloads are pool chunks (see ws_send_audio); return the
+        // chunk even if invalid to prevent pool leaks
+        free_chunk(message->data);
+    } else {
+        // Validate JSON message data
+        if (message->json) {
+            // Send JSON message directly using ESP-IDF API
+            esp_websocket_client_handle_t client = ws_client;  // Changes on failover
+            if (client && esp_websocket_client_is_connected(client)) {
+                char *json_str = cJSON_PrintUnformatted(message->json);
+                if (json_str) {
+                    size_t json_len = strlen(json_str);
+                    esp_err_t err = esp_websocket_client_send_text(client, json_str, json_len, pdMS_TO_TICKS(5000));
+                    if (err != ESP_OK) {
+                        ESP_LOGE("WS", "Failed to send WebSocket text: %s (0x%x)", esp_err_to_name(err), err);
+                    }
+                    free(json_str);
+                } else {
+                    ESP_LOGE("WS", "Failed to serialize JSON for sending");
+                }
+            } else {
+                ESP_LOGW("WS", "WebSocket not connected, cannot send JSON message");
+            }
+            cJSON_Delete(message->json);
+        } else {
+            ESP_LOGW("WS", "Invalid JSON message data - ignoring");
+        }
+    }
+}
+
+/*
+ * Multiplexed sending (ws_mux.h), once a session agrees to "mux". Only
+ * websocket_message_task touches the scheduler; other tasks read mux_held
+ * for the uplink's flow control.
+ */
+#define WS_MUX_WEIGHT_AUDIO     4       // Live audio must keep up with real time
+#define WS_MUX_WEIGHT_IMAGE     1
+#define WS_MUX_WEIGHT_TELEMETRY 1
+
+#ifdef CONFIG_HOTPIN_WS_MUX
+#define WS_MUX_SLICE_BYTES  CONFIG_HOTPIN_WS_MUX_SLICE_BYTES
+#else
+#define WS_MUX_SLICE_BYTES  WS_MUX_MIN_SLICE
+#endif
+
+static volatile uint32_t mux_held = 0;
+static ws_mux_t mux;
+static uint8_t mux_frame[WS_MUX_HEADER_BYTES + WS_MUX_AUDIO_HEADER_BYTES + WS_MUX_SLICE_BYTES];
+
+// A bulk message whose channel is full waits here, so the control messages
+// queued behind it can still go ahead of the bulk channels
+static ws_message_t mux_parked;
+static bool mux_have_parked = false;
+
+void configure_ws_mux(bool enabled) {
+#ifdef CONFIG_HOTPIN_WS_MUX
+    if (enabled != mux_wanted) {
+        ESP_LOGI("WS", "Channel multiplexing %s", enabled ? "agreed, switching after mux_ready" : "off");
+    }
+    // Framing stops at once: a new connection or session has not agreed to
+    // it yet, and whatever the old one held is not sliced for this one
+    portENTER_CRITICAL(&mux_lock);
+    mux_active = false;
+    mux_wanted = enabled;
+    uint32_t generation = ++mux_generation;
+    portEXIT_CRITICAL(&mux_lock);
+
+    if (enabled) {
+        // The last message sent whole; the server switches when it reads it
+        cJSON *json = cJSON_CreateObject();
+        cJSON_AddStringToObject(json, "type", "mux_ready");
+        ws_message_t message = {
+            .json = json,
+            .mux_ready = true,
+            .seq = generation,
+        };
+        if (!q_ws_messages || xQueueSend(q_ws_messages, &message, pdMS_TO_TICKS(100)) != pdTRUE) {
+            ESP_LOGE("WS", "Failed to queue mux_ready, binary messages stay whole");
+            cJSON_Delete(json);
+        }
+    }
+#else
+    (void)enabled;
+#endif
+}
+
+bool ws_mux_enabled(void) {
+    return mux_active;
+}
+
+uint32_t ws_outbound_backlog(void) {
+    return (q_ws_messages ? uxQueueMessagesWaiting(q_ws_messages) : 0) + mux_held;
+}
+
+static void release_payload(ws_mux_channel_t channel, void *payload) {
+    if (channel == WS_MUX_AUDIO) {
+        free_chunk(payload);
+    } else {
+        free(payload);  // Serialized JSON, images
+    }
+}
+
+// Move a queued message into its channel. false if the channel is full.
+static bool mux_take(const ws_message_t *message) {
+    ws_mux_channel_t channel = message->is_binary ? (ws_mux_channel_t)message->channel : WS_MUX_CONTROL;
+    if (!ws_mux_has_room(&mux, channel)) {
+        return false;
+    }
+    if (!message->is_binary) {
+        char *json_str = message->json ? cJSON_PrintUnformatted(message->json) : NULL;
+        cJSON_Delete(message->json);
+        if (!json_str || !ws_mux_push(&mux, WS_MUX_CONTROL, json_str, (uint8_t *)json_str, strlen(json_str),
+                                      (ws_mux_channel_t)message->after, 0, 0)) {
+            ESP_LOGE("WS", "Failed to serialize JSON for sending");
+            free(json_str);
+        }
+    } else if (!ws_mux_push(&mux, channel, message->data, message->data, message->len, WS_MUX_CONTROL,
+                            message->seq, message->audio_flags)) {
+        ESP_LOGW("WS", "Invalid binary message for channel %d - ignoring", channel);
+        release_payload(channel, message->data);
+    }
+    return true;
+}
+
+// Take in what is queued so control can jump the bulk channels. A bulk
+// message for a full channel is parked; behind it only control that is not
+// fenced after that channel may pass.
+static void mux_fill(TickType_t wait) {
+    if (mux_have_parked && mux_take(&mux_parked)) {
+        mux_have_parked = false;
+    }
+
+    ws_message_t message;
+    while (xQueuePeek(q_ws_messages, &message, wait) == pdTRUE) {
+        wait = 0;
+        if (message.mux_ready) {
+            break;      // Another negotiation: handled once this one is left
+        }
+        bool control = !message.is_binary;
+        if (mux_have_parked && (!control || message.after == mux_parked.channel)) {
+            break;
+        }
+        if (!mux_take(&message)) {
+            if (control || mux_have_parked) {
+                break;
+            }
+            xQueueReceive(q_ws_messages, &mux_parked, 0);
+            mux_have_parked = true;
+            continue;
+        }
+        xQueueReceive(q_ws_messages, &message, 0);
+    }
+}
+
+// Leave the multiplexer: held control still goes out as text, bulk messages
+// sliced for the old session are dropped
+static void mux_stop(bool send_control) {
+    ws_mux_channel_t channel;
+    void *payload;
+    int dropped = 0;
+    while (ws_mux_discard(&mux, &channel, &payload)) {
+        esp_websocket_client_handle_t client = ws_client;  // Changes on failover
+        if (channel == WS_MUX_CONTROL && send_control && client && esp_websocket_client_is_connected(client)) {
+            esp_websocket_client_send_text(client, (const char *)payload, strlen((const char *)payload),
+                                           pdMS_TO_TICKS(5000));
+        } else if (channel != WS_MUX_CONTROL) {
+            dropped++;
+        }
+        release_payload(channel, payload);
+    }
+    if (mux_have_parked) {
+        release_payload((ws_mux_channel_t)mux_parked.channel, mux_parked.data);
+        mux_have_parked = false;
+        dropped++;
+    }
+    mux_held = 0;
+    if (dropped > 0) {
+        ESP_LOGW("WS", "Multiplexing ended, %d binary message(s) dropped", dropped);
+    }
+}
+
+static void mux_send(const ws_mux_slice_t *slice) {
+    static uint32_t audio_send_us = 0;      // Slices of the audio frame going out
+    static size_t audio_bytes = 0;
+    esp_websocket_client_handle_t client = ws_client;  // Changes on failover
+    esp_err_t err = ESP_FAIL;
+
+    int64_t send_start_us = esp_timer_get_time();
+    if (client && esp_websocket_client_is_connected(client)) {
+        if (slice->channel == WS_MUX_CONTROL) {
+            err = esp_websocket_client_send_text(client, (const char *)slice->data, slice->len, pdMS_TO_TICKS(5000));
+        } else {
+            // Header and slice in one frame; an audio message starts with its seq
+            size_t frame_len = WS_MUX_HEADER_BYTES;
+            memcpy(mux_frame, slice->header, WS_MUX_HEADER_BYTES);
+            if (slice->channel == WS_MUX_AUDIO && (slice->header[0] & WS_MUX_FLAG_START)) {
+                uint8_t flags = (slice->tag_flags & WS_AUDIO_REPLAY) ? WS_MUX_AUDIO_REPLAY : 0;
+                frame_len += ws_mux_audio_header(mux_frame + frame_len, slice->tag, flags);
+            }
+            memcpy(mux_frame + frame_len, slice->data, slice->len);
+            err = esp_websocket_client_send_bin(client, (const char *)mux_frame, frame_len + slice->len,
+                                                pdMS_TO_TICKS(5000));
+        }
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE("WS", "Failed to send on channel %d: %s", slice->channel, esp_err_to_name(err));
+        // The receiver drops the partial message when the channel's next one starts
+        void *payload = slice->payload ? slice->payload : ws_mux_abort(&mux, slice->channel);
+        if (payload) {
+            release_payload(slice->channel, payload);
+        }
+        if (slice->channel == WS_MUX_AUDIO) {
+            audio_send_us = 0;
+            audio_bytes = 0;
+        }
+        return;
+    }
+
+    if (slice->channel == WS_MUX_AUDIO) {
+        audio_send_us += (uint32_t)(esp_timer_get_time() - send_start_us);
+        audio_bytes += slice->len;
+        if (slice->payload && (slice->tag_flags & WS_AUDIO_LIVE)) {
+            // Replayed and dictated audio would skew the live pacing
+            audio_uplink_note_sent(audio_bytes, audio_send_us);
+        }
+        if (slice->payload) {
+            audio_send_us = 0;
+            audio_bytes = 0;
+        }
+    }
+    if (slice->payload) {
+        release_payload(slice->channel, slice->payload);
+    }
+}
+
 void websocket_message_task(void *pvParameters)
 {
     ESP_LOGI("WS", "Starting WebSocket message processing task");
     
-    // Message structure for queue
-    struct {
-        cJSON *json;        // JSON message to send (NULL if binary)
-        bool is_binary;     // Flag indicating if this is a binary message
-        uint8_t *data;      // Binary data (if is_binary is true)
-        size_t len;         // Length of binary data
-    } message;
+    ws_message_t message;
+    bool muxing = false;
+    uint32_t muxing_generation = 0;
     
-    while (current_state != CLIENT_STATE_SHUTDOWN) {
+    while (get_state() != CLIENT_STATE_SHUTDOWN) {
+        if (muxing && muxing_generation != mux_generation) {
+            // Reconnected or renegotiated: send whole from the next message
+            mux_stop(true);
+            muxing = false;
+        }
+
+        if (muxing) {
+            // Take in everything queued, then send one frame; wait only when idle
+            mux_fill(mux.held > 0 || mux_have_parked ? 0 : pdMS_TO_TICKS(1000));
+            ws_mux_slice_t slice;
+            if (ws_mux_next(&mux, &slice)) {
+                mux_send(&slice);
+            }
+            mux_held = mux.held + (mux_have_parked ? 1 : 0);
+            continue;
+        }
+
         // Wait for messages in the queue with a timeout
         if (xQueueReceive(q_ws_messages, &message, pdMS_TO_TICKS(1000)) == pdTRUE) {
-            // Validate message data before processing to prevent corruption
-            if (message.is_binary) {
-                // Validate binary message data
-                if (message.data && message.len > 0) {
-                    // Send binary message directly using ESP-IDF API
-                    if (ws_client && esp_websocket_client_is_connected(ws_client)) {
-                        esp_err_t err = esp_websocket_client_send_bin(ws_client, (char*)message.data, message.len, pdMS_TO_TICKS(5000));
-                        if (err != ESP_OK) {
-                            ESP_LOGE("WS", "Failed to send WebSocket binary: %s (0x%x)", esp_err_to_name(err), err);
-                        }
-                    } else {
-                        ESP_LOGW("WS", "WebSocket not connected, cannot send binary message");
-                    }
-                    free(message.data);
-                } else {
-                    ESP_LOGW("WS", "Invalid binary message data - ignoring");
-                    // Still free the data pointer if it exists to prevent memory leaks
-                    if (message.data) {
-                        free(message.data);
-                    }
-                }
-            } else {
-                // Validate JSON message data
-                if (message.json) {
-                    // Send JSON message directly using ESP-IDF API
-                    if (ws_client && esp_websocket_client_is_connected(ws_client)) {
-                        char *json_str = cJSON_PrintUnformatted(message.json);
-                        if (json_str) {
-                            size_t json_len = strlen(json_str);
-                            esp_err_t err = esp_websocket_client_send_text(ws_client, json_str, json_len, pdMS_TO_TICKS(5000));
-                            if (err != ESP_OK) {
-                                ESP_LOGE("WS", "Failed to send WebSocket text: %s (0x%x)", esp_err_to_name(err), err);
-                            }
-                            free(json_str);
-                        } else {
-                            ESP_LOGE("WS", "Failed to serialize JSON for sending");
-                        }
-                    } else {
-                        ESP_LOGW("WS", "WebSocket not connected, cannot send JSON message");
-                    }
-                    cJSON_Delete(message.json);
-                } else {
-                    ESP_LOGW("WS", "Invalid JSON message data - ignoring");
-                }
+            if (message.mux_ready && message.seq != mux_generation) {
+                cJSON_Delete(message.json);     // For a connection or session since replaced
+                continue;
+            }
+            send_in_order(&message);
+            if (message.mux_ready) {
+                ws_mux_init(&mux, WS_MUX_SLICE_BYTES);
+                ws_mux_set_weight(&mux, WS_MUX_AUDIO, WS_MUX_WEIGHT_AUDIO);
+                ws_mux_set_weight(&mux, WS_MUX_IMAGE, WS_MUX_WEIGHT_IMAGE);
+                ws_mux_set_weight(&mux, WS_MUX_TELEMETRY, WS_MUX_WEIGHT_TELEMETRY);
+                muxing = true;
+                muxing_generation = message.seq;
+                portENTER_CRITICAL(&mux_lock);
+                mux_active = mux_generation == muxing_generation;
+                portEXIT_CRITICAL(&mux_lock);
             }
         }
-        
-        // Small delay to prevent busy looping
-        vTaskDelay(pdMS_TO_TICKS(10));
+        // No delay here: xQueueReceive already blocks, and a sleep per
+        // message would cap 20 ms audio frames below real time
+    }
+
+    // Release what the multiplexer still holds
+    if (muxing) {
+        mux_stop(false);
     }
     
     ESP_LOGI("WS", "WebSocket message processing task stopping");
@@ -748,21 +1618,32 @@ void websocket_message_task(void *pvParameters)
 void cleanup_websocket(void) {
     ESP_LOGI("WS", "Cleaning up WebSocket client");
     
-    // Stop WebSocket client if it's running
+    // Stop the connection in use first so it closes gracefully
     if (ws_client) {
         ESP_LOGI("WS", "Stopping WebSocket client");
         esp_websocket_client_stop(ws_client);
         vTaskDelay(pdMS_TO_TICKS(500)); // Give time for graceful shutdown
-        
-        // Destroy WebSocket client
-        ESP_LOGI("WS", "Destroying WebSocket client");
-        esp_websocket_client_destroy(ws_client);
         ws_client = NULL;
     }
     
+    // Destroy both hedged connect clients (destroy stops a running one)
+    ESP_LOGI("WS", "Destroying WebSocket clients");
+    for (int i = 0; i < WS_HEDGE_COUNT; i++) {
+        if (hedge_clients[i]) {
+            esp_websocket_client_destroy(hedge_clients[i]);
+            hedge_clients[i] = NULL;
+        }
+    }
+    
     // Reset connection state
     ws_connected = false;
     ws_handshake_complete = false;
     
+    // Client task is gone, so nothing else feeds the dispatcher
+    if (q_ws_inbound) {
+        ws_inbound_t stop = { .type = WS_INBOUND_SHUTDOWN };
+        xQueueSend(q_ws_inbound, &stop, 0);
+    }
+    
     ESP_LOGI("WS", "WebSocket client cleanup complete");
 }
\ No newline at end of file
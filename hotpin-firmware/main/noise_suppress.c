@@ -0,0 +1,211 @@
+/*
+ * HotPin Firmware - Noise Suppressor
+ *
+ * Per frame: block-normalize, window, FFT, then per bin (k = 0..N/2)
+ *
+ *   P      = |X|^2 rescaled to the input's scale
+ *   S      = S + (P - S) / 8                      smoothed power
+ *   noise  = 1.5 * min(S over the last 1.5 s)     minimum statistics
+ *   post   = P / noise                            a posteriori SNR
+ *   prio   = 0.98 * clean_prev + 0.02 * max(post - 1, 0)
+ *   G      = max(prio / (1 + prio), floor)        Wiener gain
+ *   clean  = G^2 * post
+ *
+ * The gain is applied to bins k and N - k, the inverse FFT is the forward
+ * FFT of the conjugate, and the result is windowed again and overlap-added.
+ * Both transforms use block floating point, and their scale factors and
+ * the normalization shift are undone in one shift at the end. SNRs are Q8,
+ * gains Q15; floating point is only used to build tables.
+ *
+ * No ESP-IDF dependencies: see noise_suppress.h.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "fft_q15.h"
+#include "noise_suppress.h"
+
+#define SMOOTH_SHIFT        3           // S += (P - S) / 8
+#define NOISE_BIAS_Q4       24          // Minimum-to-mean correction, 1.5
+#define SNR_ONE_Q8          256
+#define SNR_MAX_Q8          (1u << 24)  // 48 dB
+#define PRIO_WEIGHT_Q15     32113       // 0.98
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// sqrt(periodic Hann): analysis times synthesis window overlap-adds to 1
+// at a 50% hop
+static int16_t window_q15[NS_FRAME_LEN];
+
+void ns_init(void) {
+    fft_q15_init();
+    for (int n = 0; n < NS_FRAME_LEN; n++) {
+        window_q15[n] = (int16_t)lround(32767.0 * sin(M_PI * n / NS_FRAME_LEN));
+    }
+}
+
+void ns_reset(ns_state_t *ns, int max_attenuation_db) {
+    memset(ns, 0, sizeof(*ns));
+    ns->gain_floor_q15 = (uint16_t)lround(32767.0 * pow(10.0, -max_attenuation_db / 20.0));
+    for (int i = 0; i < NS_SUBWINDOWS; i++) {
+        for (int k = 0; k < NS_BINS; k++) {
+            ns->subwindow_min[i][k] = UINT64_MAX;
+        }
+    }
+    for (int k = 0; k < NS_BINS; k++) {
+        ns->stored_min[k] = UINT64_MAX;
+    }
+}
+
+void ns_restart(ns_state_t *ns) {
+    memset(ns->input, 0, sizeof(ns->input));
+    memset(ns->output, 0, sizeof(ns->output));
+    memset(ns->overlap, 0, sizeof(ns->overlap));
+    memset(ns->clean_snr_q8, 0, sizeof(ns->clean_snr_q8));
+    ns->pos = 0;
+}
+
+static void update_noise(ns_state_t *ns, const uint64_t *power) {
+    bool open_subwindow = ns->subwindow_frames == 0;
+    for (int k = 0; k < NS_BINS; k++) {
+        uint64_t s = ns->frames == 0 ? power[k]
+                   : ns->smoothed[k] - (ns->smoothed[k] >> SMOOTH_SHIFT) + (power[k] >> SMOOTH_SHIFT);
+        ns->smoothed[k] = s;
+        if (open_subwindow || s < ns->current_min[k]) {
+            ns->current_min[k] = s;
+        }
+        uint64_t m = ns->current_min[k] < ns->stored_min[k] ? ns->current_min[k] : ns->stored_min[k];
+        ns->noise[k] = (m >> 4) * NOISE_BIAS_Q4 + (((m & 15) * NOISE_BIAS_Q4) >> 4);
+    }
+    ns->frames++;
+
+    if (++ns->subwindow_frames < NS_SUBWINDOW_FRAMES) {
+        return;
+    }
+    // Close the subwindow: it replaces the oldest, and the stored minimum
+    // is recomputed over the ring
+    ns->subwindow_frames = 0;
+    memcpy(ns->subwindow_min[ns->subwindow], ns->current_min, sizeof(ns->current_min));
+    ns->subwindow = (ns->subwindow + 1) % NS_SUBWINDOWS;
+    for (int k = 0; k < NS_BINS; k++) {
+        uint64_t m = UINT64_MAX;
+        for (int i = 0; i < NS_SUBWINDOWS; i++) {
+            if (ns->subwindow_min[i][k] < m) {
+                m = ns->subwindow_min[i][k];
+            }
+        }
+        ns->stored_min[k] = m;
+    }
+}
+
+static uint16_t wiener_gain(ns_state_t *ns, int k, uint64_t power) {
+    uint64_t noise = ns->noise[k];
+    uint32_t post = SNR_MAX_Q8;
+    if (noise > 0 && (power << 8) / noise < SNR_MAX_Q8) {
+        post = (uint32_t)((power << 8) / noise);
+    }
+
+    uint32_t excess = post > SNR_ONE_Q8 ? post - SNR_ONE_Q8 : 0;
+    uint32_t prio = (uint32_t)(((uint64_t)PRIO_WEIGHT_Q15 * ns->clean_snr_q8[k] +
+                                (uint64_t)(32768 - PRIO_WEIGHT_Q15) * excess) >> 15);
+
+    // prio / (1 + prio) = 1 - 1 / (1 + prio), which stays in 32 bits
+    int32_t gain = 32768 - (int32_t)((1u << 23) / (prio + SNR_ONE_Q8));
+    if (gain > 32767) {
+        gain = 32767;
+    }
+    if (gain < ns->gain_floor_q15) {
+        gain = ns->gain_floor_q15;
+    }
+
+    uint32_t gain_sq = (uint32_t)(gain * gain) >> 15;
+    ns->clean_snr_q8[k] = (uint32_t)(((uint64_t)gain_sq * post) >> 15);
+    return (uint16_t)gain;
+}
+
+static void process_frame(ns_state_t *ns) {
+    int16_t x[2 * NS_FRAME_LEN];    // Interleaved re, im
+
+    // Block normalization as in kws.c: full range with one bit of headroom
+    int32_t peak = 0;
+    for (int n = 0; n < NS_FRAME_LEN; n++) {
+        int32_t mag = ns->input[n] < 0 ? -ns->input[n] : ns->input[n];
+        if (mag > peak) {
+            peak = mag;
+        }
+    }
+    int norm = 0;
+    while (peak > 0 && norm < 15 && (peak << (norm + 1)) <= 16383) {
+        norm++;
+    }
+    for (int n = 0; n < NS_FRAME_LEN; n++) {
+        x[2 * n] = (int16_t)(((int32_t)ns->input[n] * (1 << norm) * window_q15[n]) >> 15);
+        x[2 * n + 1] = 0;
+    }
+
+    int forward_scale = fft_q15(x, NS_FFT_LOG2);
+
+    // |X|^2 on the input's scale: times 2^(2 * (scale - norm))
+    int power_shift = 2 * (forward_scale - norm);
+    uint64_t power[NS_BINS];
+    for (int k = 0; k < NS_BINS; k++) {
+        uint64_t p = (uint32_t)(x[2 * k] * x[2 * k]) + (uint32_t)(x[2 * k + 1] * x[2 * k + 1]);
+        power[k] = power_shift >= 0 ? p << power_shift : p >> -power_shift;
+    }
+    update_noise(ns, power);
+
+    for (int k = 0; k < NS_BINS; k++) {
+        int32_t gain = wiener_gain(ns, k, power[k]);
+        x[2 * k] = (int16_t)((x[2 * k] * gain) >> 15);
+        x[2 * k + 1] = (int16_t)((x[2 * k + 1] * gain) >> 15);
+        if (k > 0 && k < NS_FRAME_LEN / 2) {
+            int mirror = NS_FRAME_LEN - k;
+            x[2 * mirror] = (int16_t)((x[2 * mirror] * gain) >> 15);
+            x[2 * mirror + 1] = (int16_t)((x[2 * mirror + 1] * gain) >> 15);
+        }
+    }
+
+    // Inverse: conjugate, forward FFT; the output is real, so the second
+    // conjugation is not needed
+    for (int n = 0; n < NS_FRAME_LEN; n++) {
+        int16_t im = x[2 * n + 1];
+        x[2 * n + 1] = im == INT16_MIN ? INT16_MAX : (int16_t)-im;
+    }
+    int inverse_scale = fft_q15(x, NS_FFT_LOG2);
+
+    // Undo both FFT scales, the 1/N of the inverse, the normalization and
+    // the Q15 synthesis window in one rounding shift (always at least 7)
+    int shift = 15 + NS_FFT_LOG2 + norm - forward_scale - inverse_scale;
+    for (int n = 0; n < NS_FRAME_LEN; n++) {
+        int64_t y = (int64_t)(x[2 * n] * window_q15[n]);
+        y = shift > 47 ? 0 : (y + ((int64_t)1 << (shift - 1))) >> shift;
+        if (n < NS_HOP_LEN) {
+            int64_t out = ns->overlap[n] + y;
+            ns->output[n] = (int16_t)(out > 32767 ? 32767 : (out < -32768 ? -32768 : out));
+        } else {
+            ns->overlap[n - NS_HOP_LEN] = (int32_t)y;
+        }
+    }
+}
+
+int ns_process(ns_state_t *ns, int16_t *samples, size_t count) {
+    int frames = 0;
+    for (size_t i = 0; i < count; i++) {
+        int16_t in = samples[i];
+        samples[i] = ns->output[ns->pos];
+        ns->input[NS_HOP_LEN + ns->pos] = in;
+        if (++ns->pos < NS_HOP_LEN) {
+            continue;
+        }
+
+        process_frame(ns);
+        memmove(ns->input, &ns->input[NS_HOP_LEN], NS_HOP_LEN * sizeof(int16_t));
+        ns->pos = 0;
+        frames++;
+    }
+    return frames;
+}
@@ -0,0 +1,90 @@
+/*
+ * HotPin Firmware - Noise Suppressor
+ *
+ * Single-channel spectral noise suppression for the uplink. The signal is
+ * cut into 16 ms frames with an 8 ms hop, windowed with a square-root Hann
+ * window, and transformed with the fixed-point FFT (fft_q15.c). The noise
+ * power per bin is tracked by minimum statistics (the minimum of the
+ * smoothed power over about 1.5 s, so it follows the noise through speech
+ * without a voice activity detector). Each bin is scaled by a Wiener gain
+ * from a decision-directed a priori SNR, limited to a maximum attenuation,
+ * and the frames are overlap-added back together.
+ *
+ * Processing is streaming and in place, with a fixed delay of one frame
+ * (NS_DELAY, 16 ms). No ESP-IDF dependencies: the same code runs in the capture path
+ * (audio_handling.c) and in the host harness (tools/ns_eval.c).
+ */
+
+#ifndef NOISE_SUPPRESS_H
+#define NOISE_SUPPRESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NS_SAMPLE_RATE          16000
+#define NS_FFT_LOG2             8
+#define NS_FRAME_LEN            (1 << NS_FFT_LOG2)  // 16 ms
+#define NS_HOP_LEN              (NS_FRAME_LEN / 2)  // 8 ms
+#define NS_DELAY                NS_FRAME_LEN        // Samples from input to output
+#define NS_BINS                 (NS_FRAME_LEN / 2 + 1)
+#define NS_SUBWINDOWS           6                   // Minimum search: 6 x 32 hops = 1.5 s
+#define NS_SUBWINDOW_FRAMES     32
+
+// Bin powers are kept as 64-bit integers on the scale of the unnormalized
+// 16-bit input, so the statistics survive the per-frame block scaling
+typedef struct {
+    int16_t input[NS_FRAME_LEN];        // Analysis frame: previous hop, then the current one
+    int16_t output[NS_HOP_LEN];         // Finished samples handed out during the current hop
+    int32_t overlap[NS_HOP_LEN];        // Second half of the last synthesis frame
+    int pos;                            // Samples into the current hop
+    uint16_t gain_floor_q15;
+    uint32_t frames;                    // Since ns_reset()
+    int subwindow_frames;
+    int subwindow;
+    uint64_t smoothed[NS_BINS];         // Recursively smoothed power
+    uint64_t current_min[NS_BINS];      // Minimum in the open subwindow
+    uint64_t subwindow_min[NS_SUBWINDOWS][NS_BINS];
+    uint64_t stored_min[NS_BINS];       // Minimum over the closed subwindows
+    uint64_t noise[NS_BINS];            // Bias-compensated noise estimate
+    uint32_t clean_snr_q8[NS_BINS];     // Previous frame's |S|^2 / noise, for the a priori SNR
+} ns_state_t;
+
+/**
+ * @brief Build the window and FFT tables (call once)
+ */
+void ns_init(void);
+
+/**
+ * @brief Clear everything, including the noise estimate
+ *
+ * @param max_attenuation_db Gain floor; bins are never cut by more than this
+ */
+void ns_reset(ns_state_t *ns, int max_attenuation_db);
+
+/**
+ * @brief Start a new stream, keeping the noise estimate
+ *
+ * The minimum search needs about 1.5 s to settle, so the estimate is
+ * carried from one recording to the next instead of relearned each time.
+ */
+void ns_restart(ns_state_t *ns);
+
+/**
+ * @brief Suppress noise in place
+ *
+ * Output lags input by NS_DELAY samples; a new stream starts with that
+ * many samples of silence.
+ *
+ * @return Number of frames processed (one per NS_HOP_LEN samples)
+ */
+int ns_process(ns_state_t *ns, int16_t *samples, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NOISE_SUPPRESS_H */
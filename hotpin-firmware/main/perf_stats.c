@@ -0,0 +1,65 @@
+/*
+ * HotPin Firmware - Hot Path Cycle Counters
+ */
+
+#include "main.h"
+#include "perf_stats.h"
+
+// Anything longer is a cross-core sample, not a real measurement
+#define PERF_MAX_SAMPLE_CYCLES  (CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ * 100000u)
+
+static perf_counter_t counters[PERF_COUNTER_COUNT];
+static portMUX_TYPE perf_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *counter_names[PERF_COUNTER_COUNT] = {
+    "capture_loop", "send_loop", "playback_loop", "chunk_alloc", "frame_path",
+    "capture_copy", "playback_copy", "bank_switch", "noise_suppress"
+};
+
+void HOT_PATH_ATTR perf_end(perf_counter_id_t id, uint32_t start_cycles) {
+    uint32_t cycles = esp_cpu_get_cycle_count() - start_cycles;
+    if ((unsigned)id >= PERF_COUNTER_COUNT || cycles > PERF_MAX_SAMPLE_CYCLES) {
+        return;
+    }
+
+    portENTER_CRITICAL(&perf_lock);
+    perf_counter_t *counter = &counters[id];
+    counter->count++;
+    counter->total_cycles += cycles;
+    if (cycles > counter->max_cycles) {
+        counter->max_cycles = cycles;
+    }
+    portEXIT_CRITICAL(&perf_lock);
+}
+
+void perf_get(perf_counter_id_t id, perf_counter_t *counter) {
+    if ((unsigned)id >= PERF_COUNTER_COUNT) {
+        memset(counter, 0, sizeof(*counter));
+        return;
+    }
+    portENTER_CRITICAL(&perf_lock);
+    *counter = counters[id];
+    portEXIT_CRITICAL(&perf_lock);
+}
+
+const char* perf_counter_name(perf_counter_id_t id) {
+    return (unsigned)id < PERF_COUNTER_COUNT ? counter_names[id] : "unknown";
+}
+
+void log_perf_counters(void) {
+#if CONFIG_HOTPIN_PERF_PROFILE
+    ESP_LOGI("PERF", "Hot path cycle counts (performance build):");
+#else
+    ESP_LOGI("PERF", "Hot path cycle counts (default build):");
+#endif
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        perf_counter_t counter;
+        perf_get((perf_counter_id_t)i, &counter);
+        if (counter.count == 0) {
+            continue;
+        }
+        ESP_LOGI("PERF", "  %-14s n=%-6lu avg=%-8lu max=%lu cycles", counter_names[i],
+                 (unsigned long)counter.count, (unsigned long)(counter.total_cycles / counter.count),
+                 (unsigned long)counter.max_cycles);
+    }
+}
@@ -0,0 +1,81 @@
+/*
+ * HotPin Firmware - Hot Path Cycle Counters
+ *
+ * CPU cycle counts for the audio and transport hot paths, used to compare
+ * the default and performance build profiles (see README).
+ */
+
+#ifndef PERF_STATS_H
+#define PERF_STATS_H
+
+#include <stdint.h>
+
+#include "esp_attr.h"
+#include "esp_cpu.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Hot-path placement: in the performance profile these functions are kept
+// in IRAM so flash cache misses during Wi-Fi activity don't stall them.
+// Only for short leaf functions that call nothing in flash (no logging,
+// cJSON or WebSocket client on the fast path); a loop that calls out to
+// flash gains nothing from IRAM and costs the space.
+#if CONFIG_HOTPIN_PERF_PROFILE
+#define HOT_PATH_ATTR IRAM_ATTR
+#else
+#define HOT_PATH_ATTR
+#endif
+
+typedef enum {
+    PERF_CAPTURE_LOOP = 0,  // Capture: I2S read returned -> chunk queued for send
+    PERF_SEND_LOOP,         // Send: chunk dequeued -> metadata and frame queued
+    PERF_PLAYBACK_LOOP,     // Playback: chunk dequeued -> handed to I2S, excluding the DMA wait
+    PERF_CHUNK_ALLOC,       // alloc_chunk()
+    PERF_FRAME_PATH,        // Inbound TTS frame: copied into a chunk and queued
+    PERF_CAPTURE_COPY,      // One I2S block: internal bounce buffer -> PSRAM chunk
+    PERF_PLAYBACK_COPY,     // One I2S block: PSRAM chunk -> internal bounce buffer
+    PERF_BANK_SWITCH,       // himem window remap (dictation store)
+    PERF_NOISE_SUPPRESS,    // One 8 ms noise suppressor frame
+    PERF_COUNTER_COUNT
+} perf_counter_id_t;
+
+typedef struct {
+    uint32_t count;
+    uint64_t total_cycles;
+    uint32_t max_cycles;
+} perf_counter_t;
+
+static inline uint32_t perf_begin(void) {
+    return esp_cpu_get_cycle_count();
+}
+
+/**
+ * @brief Record the cycles elapsed since perf_begin()
+ *
+ * The cycle counter is per core. Samples longer than 100 ms are discarded,
+ * which covers unpinned tasks that migrated between cores mid-measurement.
+ */
+void perf_end(perf_counter_id_t id, uint32_t start_cycles);
+
+/**
+ * @brief Copy one counter
+ */
+void perf_get(perf_counter_id_t id, perf_counter_t *counter);
+
+/**
+ * @brief Name of a counter for logs and telemetry
+ */
+const char* perf_counter_name(perf_counter_id_t id);
+
+/**
+ * @brief Log all counters (average and maximum cycles)
+ */
+void log_perf_counters(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PERF_STATS_H */
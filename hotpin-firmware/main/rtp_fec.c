@@ -0,0 +1,90 @@
+/*
+ * HotPin Firmware - RTP Packets with XOR Parity
+ *
+ * No ESP-IDF dependencies: see rtp_fec.h.
+ */
+
+#include <string.h>
+
+#include "rtp_fec.h"
+
+static void write_header(uint8_t *out, uint8_t payload_type, bool marker, uint16_t seq, uint32_t timestamp,
+                         uint32_t ssrc) {
+    out[0] = 2 << 6;    // Version 2, no padding, extension or CSRCs
+    out[1] = (marker ? 0x80 : 0) | payload_type;
+    out[2] = seq >> 8;
+    out[3] = seq & 0xff;
+    out[4] = timestamp >> 24;
+    out[5] = (timestamp >> 16) & 0xff;
+    out[6] = (timestamp >> 8) & 0xff;
+    out[7] = timestamp & 0xff;
+    out[8] = ssrc >> 24;
+    out[9] = (ssrc >> 16) & 0xff;
+    out[10] = (ssrc >> 8) & 0xff;
+    out[11] = ssrc & 0xff;
+}
+
+void rtp_sender_init(rtp_sender_t *sender, uint32_t ssrc, uint8_t fec_group, uint16_t first_seq) {
+    memset(sender, 0, sizeof(*sender));
+    sender->ssrc = ssrc;
+    sender->seq = first_seq;
+    sender->fec_group = fec_group > RTP_FEC_MAX_GROUP ? RTP_FEC_MAX_GROUP : fec_group;
+    sender->marker = true;
+}
+
+void rtp_sender_mark(rtp_sender_t *sender) {
+    sender->marker = true;
+}
+
+size_t rtp_sender_audio(rtp_sender_t *sender, const uint8_t *pcm, size_t len, uint8_t *out, size_t out_size) {
+    if (len == 0 || len > RTP_MAX_PAYLOAD || len % 2 || out_size < RTP_HEADER_BYTES + len) {
+        return 0;
+    }
+    write_header(out, RTP_PT_AUDIO, sender->marker, sender->seq, sender->timestamp, sender->ssrc);
+    memcpy(out + RTP_HEADER_BYTES, pcm, len);
+
+    if (sender->fec_group > 0) {
+        if (sender->fec_count == 0) {
+            sender->fec_seq = sender->seq;
+            sender->fec_timestamp = sender->timestamp;
+            sender->fec_len_xor = 0;
+            sender->fec_max_len = 0;
+            memset(sender->fec_xor, 0, sizeof(sender->fec_xor));
+        }
+        for (size_t i = 0; i < len; i++) {
+            sender->fec_xor[i] ^= pcm[i];
+        }
+        sender->fec_len_xor ^= (uint16_t)len;
+        if (len > sender->fec_max_len) {
+            sender->fec_max_len = (uint16_t)len;
+        }
+        sender->fec_count++;
+    }
+
+    sender->marker = false;
+    sender->seq++;
+    sender->timestamp += (uint32_t)(len / 2);
+    return RTP_HEADER_BYTES + len;
+}
+
+size_t rtp_sender_fec(rtp_sender_t *sender, bool flush, uint8_t *out, size_t out_size) {
+    if (sender->fec_count == 0 || (!flush && sender->fec_count < sender->fec_group)) {
+        return 0;
+    }
+    size_t len = RTP_HEADER_BYTES + RTP_FEC_HEADER_BYTES + sender->fec_max_len;
+    if (out_size < len) {
+        return 0;
+    }
+    write_header(out, RTP_PT_FEC, false, sender->fec_seq, sender->fec_timestamp, sender->ssrc);
+    out[RTP_HEADER_BYTES] = sender->fec_count;
+    out[RTP_HEADER_BYTES + 1] = 0;
+    out[RTP_HEADER_BYTES + 2] = sender->fec_len_xor >> 8;
+    out[RTP_HEADER_BYTES + 3] = sender->fec_len_xor & 0xff;
+    memcpy(out + RTP_HEADER_BYTES + RTP_FEC_HEADER_BYTES, sender->fec_xor, sender->fec_max_len);
+    sender->fec_count = 0;
+    return len;
+}
+
+uint16_t rtp_sender_last_seq(const rtp_sender_t *sender) {
+    return (uint16_t)(sender->seq - 1);
+}
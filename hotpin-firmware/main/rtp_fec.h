@@ -0,0 +1,91 @@
+/*
+ * HotPin Firmware - RTP Packets with XOR Parity
+ *
+ * Builds the packets of the UDP audio path: an RTP header (RFC 3550, no
+ * CSRCs or extensions) and a PCM16 payload, normally 20 ms. After every
+ * fec_group audio packets comes a parity packet holding the XOR of their
+ * payloads, from which the server rebuilds any one of them that is lost.
+ * Its sequence number and timestamp are those of the first packet it
+ * protects, and its payload is:
+ *
+ *   count (1 byte), 0 (1 byte), XOR of the payload lengths (2 bytes),
+ *   XOR of the payloads, each zero-padded to the longest
+ *
+ * The receiver is JitterBuffer in the webserver's audio_ingestor.py.
+ *
+ * No ESP-IDF dependencies; the socket side is in udp_audio.c.
+ */
+
+#ifndef RTP_FEC_H
+#define RTP_FEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RTP_HEADER_BYTES        12
+#define RTP_FEC_HEADER_BYTES    4
+#define RTP_PT_AUDIO            96
+#define RTP_PT_FEC              97
+#define RTP_FEC_MAX_GROUP       16
+#define RTP_MAX_PAYLOAD         640     // 20 ms of 16 kHz PCM16
+#define RTP_MAX_PACKET          (RTP_HEADER_BYTES + RTP_FEC_HEADER_BYTES + RTP_MAX_PAYLOAD)
+
+typedef struct {
+    uint32_t ssrc;
+    uint16_t seq;                   // Of the next audio packet
+    uint32_t timestamp;             // Samples
+    bool marker;                    // Set on the next audio packet
+    uint8_t fec_group;              // Audio packets per parity packet, 0 for none
+    uint8_t fec_count;              // Audio packets in the group so far
+    uint16_t fec_seq;
+    uint32_t fec_timestamp;
+    uint16_t fec_len_xor;
+    uint16_t fec_max_len;
+    uint8_t fec_xor[RTP_MAX_PAYLOAD];
+} rtp_sender_t;
+
+/**
+ * @brief Start a stream
+ *
+ * @param fec_group Audio packets per parity packet (0 for none, at most
+ *                  RTP_FEC_MAX_GROUP)
+ * @param first_seq Sequence number of the first packet
+ */
+void rtp_sender_init(rtp_sender_t *sender, uint32_t ssrc, uint8_t fec_group, uint16_t first_seq);
+
+/**
+ * @brief Mark the next audio packet as the first of a recording
+ */
+void rtp_sender_mark(rtp_sender_t *sender);
+
+/**
+ * @brief Build the audio packet for one frame and add it to the parity
+ *
+ * @param len Payload bytes, even and at most RTP_MAX_PAYLOAD
+ * @return Packet length, 0 if the frame does not fit
+ */
+size_t rtp_sender_audio(rtp_sender_t *sender, const uint8_t *pcm, size_t len, uint8_t *out, size_t out_size);
+
+/**
+ * @brief Build the parity packet once its group is complete
+ *
+ * @param flush Also for a group that is not complete (end of a recording)
+ * @return Packet length, 0 if there is nothing to send yet
+ */
+size_t rtp_sender_fec(rtp_sender_t *sender, bool flush, uint8_t *out, size_t out_size);
+
+/**
+ * @brief Sequence number of the last audio packet built
+ */
+uint16_t rtp_sender_last_seq(const rtp_sender_t *sender);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTP_FEC_H */
@@ -0,0 +1,233 @@
+/*
+ * HotPin Firmware - Server-Pushed Runtime Configuration
+ */
+
+#include "main.h"
+#include "runtime_config.h"
+#include "frame_adapt.h"
+#include "nvs.h"
+
+#define RUNTIME_CONFIG_NAMESPACE    "hotpin"
+#define RUNTIME_CONFIG_KEY          "runtime_cfg"
+#define RUNTIME_CONFIG_DEFAULT_PING 30
+
+static const char *log_level_names[] = { "none", "error", "warn", "info", "debug", "verbose" };
+
+static portMUX_TYPE config_lock = portMUX_INITIALIZER_UNLOCKED;
+static runtime_config_t current = {
+    .version = 0,
+    .chunk_ms = 0,
+    .ping_interval_sec = RUNTIME_CONFIG_DEFAULT_PING,
+    .jpeg_quality = 12,
+#ifdef CONFIG_HOTPIN_WAKE_WORD_THRESHOLD
+    .wake_threshold = CONFIG_HOTPIN_WAKE_WORD_THRESHOLD,
+#else
+    .wake_threshold = 85,
+#endif
+#ifdef CONFIG_HOTPIN_NOISE_SUPPRESS_MAX_DB
+    .ns_max_db = CONFIG_HOTPIN_NOISE_SUPPRESS_MAX_DB,
+#else
+    .ns_max_db = 12,
+#endif
+    .log_level = ESP_LOG_INFO,
+};
+
+// Settings read by other tasks take effect at their next use (frame, photo,
+// recording, inference); the two below belong to no task and are pushed here
+static void apply_immediate(const runtime_config_t *config) {
+    esp_log_level_set("*", (esp_log_level_t)config->log_level);
+
+    esp_websocket_client_handle_t ws = get_ws_client();
+    if (ws) {
+        esp_websocket_client_set_ping_interval_sec(ws, config->ping_interval_sec);
+    }
+}
+
+bool init_runtime_config(void) {
+    nvs_handle_t nvs;
+    if (nvs_open(RUNTIME_CONFIG_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        ESP_LOGI("RTCONFIG", "No saved runtime configuration, using defaults");
+        apply_immediate(&current);
+        return false;
+    }
+
+    runtime_config_t saved;
+    size_t len = sizeof(saved);
+    esp_err_t err = nvs_get_blob(nvs, RUNTIME_CONFIG_KEY, &saved, &len);
+    nvs_close(nvs);
+    // A different size is a layout from another firmware version
+    if (err != ESP_OK || len != sizeof(saved)) {
+        ESP_LOGI("RTCONFIG", "No usable saved runtime configuration, using defaults");
+        apply_immediate(&current);
+        return false;
+    }
+
+    portENTER_CRITICAL(&config_lock);
+    current = saved;
+    portEXIT_CRITICAL(&config_lock);
+    apply_immediate(&saved);
+    ESP_LOGI("RTCONFIG", "Runtime configuration version %"PRIu32" loaded", saved.version);
+    return true;
+}
+
+void runtime_config_get(runtime_config_t *config) {
+    portENTER_CRITICAL(&config_lock);
+    *config = current;
+    portEXIT_CRITICAL(&config_lock);
+}
+
+uint32_t runtime_config_version(void) {
+    portENTER_CRITICAL(&config_lock);
+    uint32_t version = current.version;
+    portEXIT_CRITICAL(&config_lock);
+    return version;
+}
+
+static bool save_config(const runtime_config_t *config) {
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(RUNTIME_CONFIG_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(nvs, RUNTIME_CONFIG_KEY, config, sizeof(*config));
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW("RTCONFIG", "Failed to save runtime configuration: %s", esp_err_to_name(err));
+        return false;
+    }
+    return true;
+}
+
+static bool number_in_range(const cJSON *item, int min, int max, int *value) {
+    if (!cJSON_IsNumber(item) || item->valuedouble < min || item->valuedouble > max) {
+        return false;
+    }
+    *value = (int)item->valuedouble;
+    return true;
+}
+
+// Apply one key of the delta to next. Returns false if the value is invalid;
+// unknown keys are left to the caller.
+static bool apply_key(runtime_config_t *next, const cJSON *item, bool *known) {
+    const char *key = item->string;
+    int value = 0;
+    *known = true;
+
+    if (strcmp(key, "chunk_ms") == 0) {
+        if (!cJSON_IsNumber(item) || (item->valuedouble != 0 &&
+            !number_in_range(item, FRAME_ADAPT_MIN_MS, FRAME_ADAPT_MAX_MS, &value))) {
+            return false;
+        }
+        next->chunk_ms = (uint16_t)value;
+    } else if (strcmp(key, "codec") == 0) {
+        // PCM16 is the only codec in this firmware
+        const char *codec = cJSON_GetStringValue(item);
+        return codec && strcmp(codec, "pcm16") == 0;
+    } else if (strcmp(key, "jpeg_quality") == 0) {
+        if (!number_in_range(item, 4, 63, &value)) {
+            return false;
+        }
+        next->jpeg_quality = (uint8_t)value;
+    } else if (strcmp(key, "wake_threshold") == 0) {
+        if (!number_in_range(item, 50, 99, &value)) {
+            return false;
+        }
+        next->wake_threshold = (uint8_t)value;
+    } else if (strcmp(key, "ns_max_db") == 0) {
+        if (!number_in_range(item, 3, 30, &value)) {
+            return false;
+        }
+        next->ns_max_db = (uint8_t)value;
+    } else if (strcmp(key, "ping_interval_sec") == 0) {
+        if (!number_in_range(item, 5, 300, &value)) {
+            return false;
+        }
+        next->ping_interval_sec = (uint16_t)value;
+    } else if (strcmp(key, "log_level") == 0) {
+        const char *name = cJSON_GetStringValue(item);
+        size_t count = sizeof(log_level_names) / sizeof(log_level_names[0]);
+        size_t level = 0;
+        while (name && level < count && strcmp(name, log_level_names[level]) != 0) {
+            level++;
+        }
+        if (!name || level == count) {
+            return false;
+        }
+        next->log_level = (uint8_t)level;
+    } else {
+        *known = false;
+    }
+    return true;
+}
+
+static void send_ack(uint32_t version, const char *status, const char *error, cJSON *ignored) {
+    cJSON *ack = cJSON_CreateObject();
+    if (!ack) {
+        cJSON_Delete(ignored);
+        return;
+    }
+    cJSON_AddStringToObject(ack, "type", "config_ack");
+    cJSON_AddStringToObject(ack, "session", SESSION_ID);
+    cJSON_AddNumberToObject(ack, "version", version);
+    cJSON_AddStringToObject(ack, "status", status);
+    if (error) {
+        cJSON_AddStringToObject(ack, "error", error);
+    }
+    if (ignored) {
+        cJSON_AddItemToObject(ack, "ignored", ignored);
+    }
+    ws_send_json(ack);
+}
+
+void runtime_config_handle_update(const cJSON *message) {
+    cJSON *version_item = cJSON_GetObjectItem(message, "version");
+    cJSON *delta = cJSON_GetObjectItem(message, "set");
+    if (!cJSON_IsNumber(version_item) || version_item->valuedouble < 1 || !cJSON_IsObject(delta)) {
+        send_ack(runtime_config_version(), "rejected", "malformed", NULL);
+        return;
+    }
+
+    runtime_config_t next;
+    runtime_config_get(&next);
+    uint32_t version = (uint32_t)version_item->valuedouble;
+    if (version <= next.version) {
+        // Already applied (a resend, or an older server): nothing to do
+        send_ack(next.version, "stale", NULL, NULL);
+        return;
+    }
+
+    // All or nothing: one bad value rejects the whole update
+    cJSON *ignored = NULL;
+    const cJSON *item;
+    cJSON_ArrayForEach(item, delta) {
+        bool known;
+        if (!apply_key(&next, item, &known)) {
+            ESP_LOGW("RTCONFIG", "Rejecting config version %"PRIu32": bad value for %s", version, item->string);
+            cJSON_Delete(ignored);
+            send_ack(runtime_config_version(), "rejected", item->string, NULL);
+            return;
+        }
+        if (!known) {
+            // A setting for newer firmware; the rest still applies
+            if (!ignored) {
+                ignored = cJSON_CreateArray();
+            }
+            cJSON_AddItemToArray(ignored, cJSON_CreateString(item->string));
+        }
+    }
+    next.version = version;
+
+    portENTER_CRITICAL(&config_lock);
+    current = next;
+    portEXIT_CRITICAL(&config_lock);
+    apply_immediate(&next);
+    bool saved = save_config(&next);
+
+    ESP_LOGI("RTCONFIG", "Applied config version %"PRIu32": chunk %u ms, jpeg %u, wake %u%%, ns %u dB, "
+             "ping %u s, log %s%s", version, next.chunk_ms, next.jpeg_quality, next.wake_threshold,
+             next.ns_max_db, next.ping_interval_sec, log_level_names[next.log_level],
+             saved ? "" : " (not saved)");
+    send_ack(version, saved ? "applied" : "applied_unsaved", NULL, ignored);
+}
@@ -0,0 +1,67 @@
+/*
+ * HotPin Firmware - Server-Pushed Runtime Configuration
+ *
+ * Settings the server can change without a reflash or a reconnect. A
+ * "config_update" carries a version and a delta (only the keys that
+ * change). A newer version is validated as a whole, applied to the running
+ * pipelines, saved to NVS and acknowledged with "config_ack". An older or
+ * equal version is acknowledged as stale and changes nothing. The device
+ * reports its version in "hello", so a server can bring a device that was
+ * offline up to date when it reconnects.
+ *
+ * Until the first update, and when NVS holds nothing for this firmware's
+ * layout, every setting has its compiled-in default (version 0).
+ */
+
+#ifndef RUNTIME_CONFIG_H
+#define RUNTIME_CONFIG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cJSON.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t version;               // 0: compiled-in defaults
+    uint16_t chunk_ms;              // Live frame length, 0 to let it adapt (frame_adapt.h)
+    uint16_t ping_interval_sec;     // WebSocket ping
+    uint8_t jpeg_quality;           // 4-63, lower is better
+    uint8_t wake_threshold;         // Wake word detection threshold, percent
+    uint8_t ns_max_db;              // Noise suppressor maximum attenuation
+    uint8_t log_level;              // esp_log_level_t for every tag
+} runtime_config_t;
+
+/**
+ * @brief Load the saved configuration from NVS and apply the log level
+ *
+ * Needs nvs_flash_init(); call before init_websocket() so the ping interval
+ * is in place for the first connection.
+ *
+ * @return true if a saved configuration was loaded, false if the defaults apply
+ */
+bool init_runtime_config(void);
+
+/**
+ * @brief Copy the current configuration
+ */
+void runtime_config_get(runtime_config_t *config);
+
+/**
+ * @brief Version of the current configuration (0 for the defaults)
+ */
+uint32_t runtime_config_version(void);
+
+/**
+ * @brief Handle a "config_update" message and send the "config_ack"
+ */
+void runtime_config_handle_update(const cJSON *message);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RUNTIME_CONFIG_H */
@@ -0,0 +1,333 @@
+/*
+ * HotPin Firmware - Audio Pipeline Self-Test
+ *
+ * One loop iteration per block: read (or generate) it, allocate a chunk,
+ * encode into it, queue it, and consume whatever is above the queue target.
+ * Keeping SELFTEST_QUEUE_TARGET blocks queued in loopback gives the TX DMA
+ * the same slack the playback task has, so a healthy device plays without
+ * underruns. Achieved I2S rates come from the block completion times once
+ * RATE_WARMUP_BLOCKS have passed: until then the TX writes only fill the
+ * empty DMA ring and complete at once.
+ *
+ * The tone is a phase accumulator at SELFTEST_TONE_HZ, so every block
+ * differs and a reordered or repeated block is caught like a corrupted one.
+ * Microphone blocks are checked against an FNV-1a checksum seeded with the
+ * block number, and block numbers must rise, which catches the same faults.
+ *
+ * No ESP-IDF dependencies: see selftest.h.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "selftest.h"
+
+#define TONE_AMPLITUDE      8192    // -12 dBFS
+#define TONE_TABLE_BITS     8
+#define RATE_WARMUP_BLOCKS  8       // Twice the DMA ring
+#define LOOPBACK_ATTEN_SHIFT 2      // -12 dB on the way back to the speaker
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static const char *mode_names[SELFTEST_MODE_COUNT] = { "capture", "loopback", "playback" };
+
+static const char *stage_names[SELFTEST_STAGE_COUNT] = {
+    "i2s_read", "pool", "encode", "queue", "i2s_write", "end_to_end", "ws_rtt"
+};
+
+static int16_t tone_table[1 << TONE_TABLE_BITS];
+static uint32_t tone_step = 0;
+static uint32_t tone_rate = 0;
+
+typedef struct {
+    uint32_t blocks;
+    int64_t first_us;
+    int64_t last_us;
+    uint64_t samples_after_first;
+} rate_meter_t;
+
+static void tone_init(uint32_t sample_rate) {
+    if (tone_rate == sample_rate) {
+        return;
+    }
+    for (int i = 0; i < (1 << TONE_TABLE_BITS); i++) {
+        tone_table[i] = (int16_t)lround(TONE_AMPLITUDE * sin(2.0 * M_PI * i / (1 << TONE_TABLE_BITS)));
+    }
+    tone_step = (uint32_t)(((uint64_t)SELFTEST_TONE_HZ << 32) / sample_rate);
+    tone_rate = sample_rate;
+}
+
+static int16_t tone_sample(uint64_t n) {
+    return tone_table[(uint32_t)(n * tone_step) >> (32 - TONE_TABLE_BITS)];
+}
+
+static void tone_fill(int16_t *pcm, uint32_t index) {
+    uint64_t n = (uint64_t)index * SELFTEST_BLOCK_SAMPLES;
+    for (size_t i = 0; i < SELFTEST_BLOCK_SAMPLES; i++) {
+        pcm[i] = tone_sample(n + i);
+    }
+}
+
+static bool tone_check(const int16_t *pcm, uint32_t index) {
+    uint64_t n = (uint64_t)index * SELFTEST_BLOCK_SAMPLES;
+    for (size_t i = 0; i < SELFTEST_BLOCK_SAMPLES; i++) {
+        if (pcm[i] != tone_sample(n + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint32_t block_checksum(const int16_t *pcm, uint32_t index) {
+    uint32_t hash = 2166136261u ^ index;
+    for (size_t i = 0; i < SELFTEST_BLOCK_SAMPLES; i++) {
+        hash = (hash ^ (uint16_t)pcm[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static void rate_note(rate_meter_t *meter, int64_t now_us, size_t samples) {
+    if (++meter->blocks <= RATE_WARMUP_BLOCKS) {
+        meter->first_us = now_us;
+    } else {
+        meter->samples_after_first += samples;
+    }
+    meter->last_us = now_us;
+}
+
+static uint32_t rate_hz(const rate_meter_t *meter) {
+    int64_t span_us = meter->last_us - meter->first_us;
+    return span_us > 0 ? (uint32_t)(meter->samples_after_first * 1000000 / (uint64_t)span_us) : 0;
+}
+
+void selftest_record(selftest_report_t *report, selftest_stage_t stage, uint32_t us) {
+    if ((unsigned)stage >= SELFTEST_STAGE_COUNT) {
+        return;
+    }
+    selftest_stage_stats_t *s = &report->stages[stage];
+    s->count++;
+    s->total_us += us;
+    if (us > s->max_us) {
+        s->max_us = us;
+    }
+}
+
+// Take one block off the queue, check it, play it (except in capture
+// mode), and return its chunk. next_index is the lowest block number that
+// may arrive next; blocks dropped on the way in leave gaps.
+static bool consume_block(const selftest_platform_t *p, selftest_report_t *report, rate_meter_t *tx,
+                          uint32_t *next_index) {
+    selftest_block_t block;
+    if (!p->dequeue(p->ctx, &block)) {
+        return false;
+    }
+    int64_t now_us = p->now_us(p->ctx);
+    selftest_record(report, SELFTEST_STAGE_QUEUE, (uint32_t)(now_us - block.queued_us));
+
+    int16_t *pcm = (int16_t*)block.data;
+    bool intact = report->mode == SELFTEST_PLAYBACK
+                      ? tone_check(pcm, block.index)
+                      : block_checksum(pcm, block.index) == block.checksum && block.index >= *next_index;
+    if (!intact) {
+        report->data_errors++;
+    }
+    if (block.index >= *next_index) {
+        *next_index = block.index + 1;
+    }
+
+    if (report->mode != SELFTEST_CAPTURE) {
+        if (report->mode == SELFTEST_LOOPBACK) {
+            for (size_t i = 0; i < SELFTEST_BLOCK_SAMPLES; i++) {
+                pcm[i] = (int16_t)(pcm[i] >> LOOPBACK_ATTEN_SHIFT);
+            }
+        }
+        bool ok = p->i2s_write(p->ctx, (const int16_t*)block.data, SELFTEST_BLOCK_SAMPLES);
+        int64_t written_us = p->now_us(p->ctx);
+        selftest_record(report, SELFTEST_STAGE_I2S_WRITE, (uint32_t)(written_us - now_us));
+        if (ok) {
+            report->tx_samples += SELFTEST_BLOCK_SAMPLES;
+            rate_note(tx, written_us, SELFTEST_BLOCK_SAMPLES);
+            selftest_record(report, SELFTEST_STAGE_END_TO_END, (uint32_t)(written_us - block.captured_us));
+        } else {
+            report->io_errors++;
+        }
+    }
+
+    p->release(p->ctx, block.data);
+    report->blocks++;
+    return true;
+}
+
+void selftest_run(const selftest_platform_t *p, selftest_mode_t mode,
+                  uint32_t duration_ms, selftest_report_t *report) {
+    memset(report, 0, sizeof(*report));
+    report->mode = mode;
+    report->sample_rate = p->sample_rate;
+    report->duration_ms = duration_ms > SELFTEST_MAX_DURATION_MS ? SELFTEST_MAX_DURATION_MS : duration_ms;
+    report->cpu_permille[0] = -1;
+    report->cpu_permille[1] = -1;
+    tone_init(p->sample_rate);
+
+    const bool rx = mode != SELFTEST_PLAYBACK;
+    const int target = mode == SELFTEST_CAPTURE ? 0 : SELFTEST_QUEUE_TARGET;
+    rate_meter_t rx_meter = { 0 };
+    rate_meter_t tx_meter = { 0 };
+    uint32_t next_index = 0;
+    uint32_t consume_index = 0;
+    int queued = 0;
+
+    const int64_t start_us = p->now_us(p->ctx);
+    const int64_t end_us = start_us + (int64_t)report->duration_ms * 1000;
+    while (p->now_us(p->ctx) < end_us) {
+        if (p->should_stop && p->should_stop(p->ctx)) {
+            report->aborted = true;
+            break;
+        }
+
+        int64_t captured_us = p->now_us(p->ctx);
+        if (rx) {
+            bool ok = p->i2s_read(p->ctx, p->scratch, SELFTEST_BLOCK_SAMPLES);
+            int64_t read_us = p->now_us(p->ctx);
+            selftest_record(report, SELFTEST_STAGE_I2S_READ, (uint32_t)(read_us - captured_us));
+            if (!ok) {
+                // The driver is gone or wedged; nothing later would be meaningful
+                report->io_errors++;
+                report->aborted = true;
+                break;
+            }
+            captured_us = read_us;
+            report->rx_samples += SELFTEST_BLOCK_SAMPLES;
+            rate_note(&rx_meter, read_us, SELFTEST_BLOCK_SAMPLES);
+        }
+
+        int64_t t0 = p->now_us(p->ctx);
+        uint8_t *chunk = p->alloc(p->ctx);
+        int64_t t1 = p->now_us(p->ctx);
+        selftest_record(report, SELFTEST_STAGE_POOL, (uint32_t)(t1 - t0));
+
+        if (!chunk) {
+            report->pool_exhausted++;
+        } else {
+            uint32_t checksum = 0;
+            if (rx) {
+                memcpy(chunk, p->scratch, SELFTEST_BLOCK_SAMPLES * sizeof(int16_t));
+                checksum = block_checksum((const int16_t*)chunk, next_index);
+            } else {
+                tone_fill((int16_t*)chunk, next_index);
+            }
+            int64_t t2 = p->now_us(p->ctx);
+            selftest_record(report, SELFTEST_STAGE_ENCODE, (uint32_t)(t2 - t1));
+
+            selftest_block_t block = {
+                .data = chunk,
+                .index = next_index,
+                .checksum = checksum,
+                .captured_us = captured_us,
+                .queued_us = t2,
+            };
+            if (p->enqueue(p->ctx, &block)) {
+                queued++;
+            } else {
+                report->queue_full++;
+                p->release(p->ctx, chunk);
+            }
+        }
+        next_index++;
+
+        while (queued > target && consume_block(p, report, &tx_meter, &consume_index)) {
+            queued--;
+        }
+        if (p->on_block) {
+            p->on_block(p->ctx, report);
+        }
+    }
+
+    report->rx_rate_hz = rate_hz(&rx_meter);
+    report->tx_rate_hz = rate_hz(&tx_meter);
+
+    // Play out (or free) what is still queued. In loopback these writes
+    // only fill the TX ring, so they stay out of the rate.
+    rate_meter_t drain_meter = { 0 };
+    while (queued > 0 && consume_block(p, report, &drain_meter, &consume_index)) {
+        queued--;
+    }
+
+    report->elapsed_ms = (uint32_t)((p->now_us(p->ctx) - start_us) / 1000);
+}
+
+static bool rate_ok(uint32_t achieved, uint32_t nominal) {
+    uint32_t diff = achieved > nominal ? achieved - nominal : nominal - achieved;
+    return (uint64_t)diff * 1000000 <= (uint64_t)nominal * SELFTEST_RATE_TOLERANCE_PPM;
+}
+
+bool selftest_passed(const selftest_report_t *r) {
+    if (r->aborted || r->blocks == 0 || r->io_errors || r->rx_overruns || r->tx_underruns ||
+        r->pool_exhausted || r->queue_full || r->data_errors) {
+        return false;
+    }
+    if (r->mode != SELFTEST_PLAYBACK && !rate_ok(r->rx_rate_hz, r->sample_rate)) {
+        return false;
+    }
+    if (r->mode != SELFTEST_CAPTURE && !rate_ok(r->tx_rate_hz, r->sample_rate)) {
+        return false;
+    }
+    return true;
+}
+
+size_t selftest_report_json(const selftest_report_t *r, char *buf, size_t len) {
+    size_t pos = 0;
+#define APPEND(...)                                                         \
+    do {                                                                    \
+        int n = snprintf(buf + pos, pos < len ? len - pos : 0, __VA_ARGS__); \
+        if (n < 0 || pos + (size_t)n >= len) {                              \
+            return 0;                                                       \
+        }                                                                   \
+        pos += (size_t)n;                                                   \
+    } while (0)
+
+    APPEND("{\"type\":\"selftest_report\",\"mode\":\"%s\",\"passed\":%s,\"aborted\":%s,",
+           selftest_mode_name(r->mode), selftest_passed(r) ? "true" : "false", r->aborted ? "true" : "false");
+    APPEND("\"sample_rate\":%u,\"block_samples\":%u,\"duration_ms\":%u,\"elapsed_ms\":%u,\"blocks\":%u,",
+           (unsigned)r->sample_rate, (unsigned)SELFTEST_BLOCK_SAMPLES, (unsigned)r->duration_ms,
+           (unsigned)r->elapsed_ms, (unsigned)r->blocks);
+    APPEND("\"i2s\":{\"rx_rate_hz\":%u,\"tx_rate_hz\":%u,\"rx_overruns\":%u,\"tx_underruns\":%u,\"io_errors\":%u},",
+           (unsigned)r->rx_rate_hz, (unsigned)r->tx_rate_hz, (unsigned)r->rx_overruns,
+           (unsigned)r->tx_underruns, (unsigned)r->io_errors);
+    APPEND("\"pipeline\":{\"pool_exhausted\":%u,\"queue_full\":%u,\"data_errors\":%u},",
+           (unsigned)r->pool_exhausted, (unsigned)r->queue_full, (unsigned)r->data_errors);
+
+    APPEND("\"core_load_pct\":[");
+    for (int core = 0; core < 2; core++) {
+        if (r->cpu_permille[core] < 0) {
+            APPEND("%snull", core ? "," : "");
+        } else {
+            APPEND("%s%.1f", core ? "," : "", r->cpu_permille[core] / 10.0);
+        }
+    }
+    APPEND("],\"stages\":{");
+    for (int i = 0; i < SELFTEST_STAGE_COUNT; i++) {
+        const selftest_stage_stats_t *s = &r->stages[i];
+        APPEND("%s\"%s\":{\"n\":%u,\"avg_us\":%u,\"max_us\":%u}", i ? "," : "", stage_names[i],
+               (unsigned)s->count, (unsigned)(s->count ? s->total_us / s->count : 0), (unsigned)s->max_us);
+    }
+    APPEND("}}");
+#undef APPEND
+    return pos;
+}
+
+bool selftest_mode_from_string(const char *name, selftest_mode_t *mode) {
+    for (int i = 0; name && i < SELFTEST_MODE_COUNT; i++) {
+        if (strcmp(name, mode_names[i]) == 0) {
+            *mode = (selftest_mode_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* selftest_mode_name(selftest_mode_t mode) {
+    return (unsigned)mode < SELFTEST_MODE_COUNT ? mode_names[mode] : "unknown";
+}
@@ -0,0 +1,150 @@
+/*
+ * HotPin Firmware - Audio Pipeline Self-Test
+ *
+ * Drives blocks through the same stages as a recording or a response,
+ * capture -> chunk pool -> encode -> queue -> playback, and times each
+ * stage. Three modes:
+ *
+ *   capture   I2S RX only; the consumer frees chunks as the uplink would
+ *   loopback  I2S RX and TX at once; every captured block is queued and
+ *             played back, 12 dB down so the speaker cannot drive the
+ *             microphone into feedback
+ *   playback  I2S TX only, fed with a synthetic tone
+ *
+ * Microphone blocks carry a checksum taken when they are encoded; the tone
+ * depends only on the sample index. Either way the consumer can check
+ * every block that reaches it.
+ *
+ * The run loop only talks to the platform through selftest_platform_t, so
+ * it builds on the host against a timing model (tools/selftest_sim.c) as
+ * well as on the device (diagnostics.c), and both print the report with
+ * selftest_report_json().
+ */
+
+#ifndef SELFTEST_H
+#define SELFTEST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SELFTEST_BLOCK_SAMPLES      1024    // One I2S bounce block
+#define SELFTEST_TONE_HZ            997     // Not a divisor of the block, so no two blocks match
+#define SELFTEST_QUEUE_TARGET       2       // Blocks held in the queue in loopback and playback
+#define SELFTEST_MAX_DURATION_MS    30000
+#define SELFTEST_RATE_TOLERANCE_PPM 10000   // Achieved I2S rate must be within 1 %
+
+typedef enum {
+    SELFTEST_CAPTURE = 0,
+    SELFTEST_LOOPBACK,
+    SELFTEST_PLAYBACK,
+    SELFTEST_MODE_COUNT
+} selftest_mode_t;
+
+typedef enum {
+    SELFTEST_STAGE_I2S_READ = 0,    // One block, including the DMA wait
+    SELFTEST_STAGE_POOL,            // Chunk allocation
+    SELFTEST_STAGE_ENCODE,          // Block into the chunk
+    SELFTEST_STAGE_QUEUE,           // Enqueue -> dequeue
+    SELFTEST_STAGE_I2S_WRITE,       // One block, including waiting for DMA space
+    SELFTEST_STAGE_END_TO_END,      // Block read (or generated) -> written to I2S
+    SELFTEST_STAGE_WS_RTT,          // WebSocket ping -> pong, filled in by the platform
+    SELFTEST_STAGE_COUNT
+} selftest_stage_t;
+
+typedef struct {
+    uint32_t count;
+    uint64_t total_us;
+    uint32_t max_us;
+} selftest_stage_stats_t;
+
+typedef struct {
+    selftest_mode_t mode;
+    uint32_t sample_rate;
+    uint32_t duration_ms;           // Requested
+    uint32_t elapsed_ms;
+    uint32_t blocks;                // Blocks that completed the pipeline
+    uint64_t rx_samples;
+    uint64_t tx_samples;
+    uint32_t rx_rate_hz;            // Achieved, from the read completion times
+    uint32_t tx_rate_hz;
+    uint32_t rx_overruns;           // DMA events, filled in by the platform
+    uint32_t tx_underruns;
+    uint32_t io_errors;             // Failed or short I2S transfers
+    uint32_t pool_exhausted;
+    uint32_t queue_full;
+    uint32_t data_errors;           // Blocks that did not arrive intact
+    int32_t cpu_permille[2];        // Per core over the run, -1 if unknown
+    bool aborted;                   // Stopped early by the platform
+    selftest_stage_stats_t stages[SELFTEST_STAGE_COUNT];
+} selftest_report_t;
+
+typedef struct {
+    uint8_t *data;
+    uint32_t index;                 // Block number, for the integrity check
+    uint32_t checksum;              // Of the microphone samples (capture, loopback)
+    int64_t captured_us;
+    int64_t queued_us;
+} selftest_block_t;
+
+// Platform hooks. i2s_read is unused in playback mode and i2s_write in
+// capture mode; on_block and should_stop may be NULL.
+typedef struct {
+    int64_t (*now_us)(void *ctx);
+    bool (*i2s_read)(void *ctx, int16_t *pcm, size_t samples);
+    bool (*i2s_write)(void *ctx, const int16_t *pcm, size_t samples);
+    uint8_t* (*alloc)(void *ctx);               // SELFTEST_BLOCK_SAMPLES samples
+    void (*release)(void *ctx, uint8_t *chunk);
+    bool (*enqueue)(void *ctx, const selftest_block_t *block);
+    bool (*dequeue)(void *ctx, selftest_block_t *block);
+    void (*on_block)(void *ctx, selftest_report_t *report);
+    bool (*should_stop)(void *ctx);
+    void *ctx;
+    int16_t *scratch;               // SELFTEST_BLOCK_SAMPLES samples for I2S reads
+    uint32_t sample_rate;
+} selftest_platform_t;
+
+/**
+ * @brief Run one self-test
+ *
+ * The report's DMA counters, CPU use and WebSocket round trips are left
+ * for the platform to fill in afterwards.
+ */
+void selftest_run(const selftest_platform_t *platform, selftest_mode_t mode,
+                  uint32_t duration_ms, selftest_report_t *report);
+
+/**
+ * @brief Add one sample to a stage
+ */
+void selftest_record(selftest_report_t *report, selftest_stage_t stage, uint32_t us);
+
+/**
+ * @brief true if the run met its rates and lost or damaged nothing
+ */
+bool selftest_passed(const selftest_report_t *report);
+
+/**
+ * @brief Write the report as a "selftest_report" JSON message
+ *
+ * @return Length written, or 0 if the buffer is too small
+ */
+size_t selftest_report_json(const selftest_report_t *report, char *buf, size_t len);
+
+/**
+ * @brief Mode from its protocol name ("capture", "loopback", "playback")
+ *
+ * @return false for unknown names
+ */
+bool selftest_mode_from_string(const char *name, selftest_mode_t *mode);
+
+const char* selftest_mode_name(selftest_mode_t mode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SELFTEST_H */
@@ -0,0 +1,235 @@
+/*
+ * HotPin Firmware - Session Profile Negotiation
+ */
+
+#include "main.h"
+#include "session_profile.h"
+#include "runtime_config.h"
+#include "audio_spill.h"
+#include "dictation.h"
+#include "wake_word.h"
+
+static const char *feature_names[SESSION_FEATURE_COUNT] = {
+    [SESSION_FEATURE_BARGE_IN] = "barge_in",
+    [SESSION_FEATURE_TTS_CACHE] = "tts_cache",
+    [SESSION_FEATURE_DICTATION] = "dictation",
+    [SESSION_FEATURE_STORE_FORWARD] = "store_forward",
+    [SESSION_FEATURE_WAKE_WORD] = "wake_word",
+    [SESSION_FEATURE_NOISE_SUPPRESS] = "noise_suppress",
+    [SESSION_FEATURE_SELFTEST] = "selftest",
+    [SESSION_FEATURE_UDP_AUDIO] = "udp_audio",
+    [SESSION_FEATURE_MUX] = "mux",
+};
+
+static const char *codec_names[SESSION_CODEC_COUNT] = {
+    [SESSION_CODEC_PCM16] = "pcm16",
+};
+
+// The I2S clock, keyword spotter and noise suppressor all run at SAMPLE_RATE
+static const uint32_t supported_rates[] = { SAMPLE_RATE };
+
+static portMUX_TYPE profile_lock = portMUX_INITIALIZER_UNLOCKED;
+static session_profile_t profile = {
+    .protocol = 1,
+    .codec = SESSION_CODEC_PCM16,
+    .sample_rate = SAMPLE_RATE,
+    .uplink_frame_bytes = CHUNK_BYTES,
+    .uplink_min_frame_bytes = CHUNK_BYTES,
+    .downlink_frame_bytes = CHUNK_BYTES,
+    .features = UINT32_MAX,
+};
+
+// What this build and its hardware can offer, independent of the server
+static uint32_t available_features(void) {
+    uint32_t features = (1u << SESSION_FEATURE_BARGE_IN) | (1u << SESSION_FEATURE_SELFTEST);
+
+    if (psram_available) {
+        features |= 1u << SESSION_FEATURE_TTS_CACHE;
+    }
+    dictation_stats_t dictation;
+    get_dictation_stats(&dictation);
+    if (dictation.available) {
+        features |= 1u << SESSION_FEATURE_DICTATION;
+    }
+    audio_spill_stats_t spill;
+    get_audio_spill_stats(&spill);
+    if (spill.available) {
+        features |= 1u << SESSION_FEATURE_STORE_FORWARD;
+    }
+    if (wake_word_available()) {
+        features |= 1u << SESSION_FEATURE_WAKE_WORD;
+    }
+#if CONFIG_HOTPIN_NOISE_SUPPRESS
+    features |= 1u << SESSION_FEATURE_NOISE_SUPPRESS;
+#endif
+#ifdef CONFIG_HOTPIN_UDP_AUDIO
+    features |= 1u << SESSION_FEATURE_UDP_AUDIO;
+#endif
+#ifdef CONFIG_HOTPIN_WS_MUX
+    features |= 1u << SESSION_FEATURE_MUX;
+#endif
+    return features;
+}
+
+void session_profile_reset(void) {
+    portENTER_CRITICAL(&profile_lock);
+    profile.protocol = 1;
+    profile.codec = SESSION_CODEC_PCM16;
+    profile.sample_rate = SAMPLE_RATE;
+    profile.uplink_frame_bytes = CHUNK_BYTES;
+    profile.uplink_min_frame_bytes = CHUNK_BYTES;
+    profile.downlink_frame_bytes = CHUNK_BYTES;
+    profile.features = UINT32_MAX;
+    portEXIT_CRITICAL(&profile_lock);
+}
+
+cJSON* session_profile_hello(void) {
+    cJSON *json = cJSON_CreateObject();
+    if (!json) {
+        return NULL;
+    }
+    cJSON_AddStringToObject(json, "type", "hello");
+    cJSON_AddStringToObject(json, "session", SESSION_ID);
+    cJSON_AddNumberToObject(json, "protocol", SESSION_PROTOCOL_VERSION);
+    cJSON_AddStringToObject(json, "device", "hotpin-esp32");
+    cJSON_AddStringToObject(json, "firmware", HOTPIN_FIRMWARE_VERSION);
+    cJSON_AddNumberToObject(json, "config_version", runtime_config_version());
+
+    cJSON *caps = cJSON_AddObjectToObject(json, "capabilities");
+    cJSON_AddBoolToObject(caps, "psram", psram_available);
+    cJSON_AddNumberToObject(caps, "psram_bytes", psram_available ? (double)esp_psram_get_size() : 0);
+
+    cJSON *codecs = cJSON_AddArrayToObject(caps, "codecs");
+    for (int i = 0; i < SESSION_CODEC_COUNT; i++) {
+        cJSON_AddItemToArray(codecs, cJSON_CreateString(codec_names[i]));
+    }
+    cJSON *rates = cJSON_AddArrayToObject(caps, "sample_rates");
+    for (size_t i = 0; i < sizeof(supported_rates) / sizeof(supported_rates[0]); i++) {
+        cJSON_AddItemToArray(rates, cJSON_CreateNumber(supported_rates[i]));
+    }
+    // Kept for servers that only read the original two fields
+    cJSON_AddNumberToObject(caps, "max_chunk_bytes", CHUNK_BYTES);
+    cJSON_AddNumberToObject(caps, "min_frame_bytes", SESSION_MIN_FRAME_BYTES);
+    cJSON_AddNumberToObject(caps, "max_frame_bytes", CHUNK_BYTES);
+
+    uint32_t available = available_features();
+    cJSON *features = cJSON_AddArrayToObject(caps, "features");
+    for (int i = 0; i < SESSION_FEATURE_COUNT; i++) {
+        if (available & (1u << i)) {
+            cJSON_AddItemToArray(features, cJSON_CreateString(feature_names[i]));
+        }
+    }
+    return json;
+}
+
+static bool frame_bytes_ok(const cJSON *item, uint32_t *bytes) {
+    if (!cJSON_IsNumber(item)) {
+        return false;
+    }
+    double value = item->valuedouble;
+    if (value < SESSION_MIN_FRAME_BYTES || value > CHUNK_BYTES || (uint32_t)value % sizeof(int16_t)) {
+        return false;
+    }
+    *bytes = (uint32_t)value;
+    return true;
+}
+
+bool session_profile_apply(const cJSON *config) {
+    session_profile_t next = {
+        .protocol = SESSION_PROTOCOL_VERSION,
+        .codec = SESSION_CODEC_COUNT,
+    };
+
+    cJSON *protocol = cJSON_GetObjectItem(config, "protocol");
+    if (cJSON_IsNumber(protocol)) {
+        next.protocol = (uint32_t)protocol->valuedouble;
+    }
+    const char *codec = cJSON_GetStringValue(cJSON_GetObjectItem(config, "codec"));
+    for (int i = 0; codec && i < SESSION_CODEC_COUNT; i++) {
+        if (strcmp(codec, codec_names[i]) == 0) {
+            next.codec = (session_codec_t)i;
+        }
+    }
+    cJSON *rate = cJSON_GetObjectItem(config, "sample_rate");
+    for (size_t i = 0; cJSON_IsNumber(rate) && i < sizeof(supported_rates) / sizeof(supported_rates[0]); i++) {
+        if ((uint32_t)rate->valuedouble == supported_rates[i]) {
+            next.sample_rate = supported_rates[i];
+        }
+    }
+
+    if (next.protocol < 2 || next.codec == SESSION_CODEC_COUNT || next.sample_rate == 0 ||
+        !frame_bytes_ok(cJSON_GetObjectItem(config, "uplink_frame_bytes"), &next.uplink_frame_bytes) ||
+        !frame_bytes_ok(cJSON_GetObjectItem(config, "downlink_frame_bytes"), &next.downlink_frame_bytes)) {
+        ESP_LOGW("SESSION", "Refusing session_config outside the advertised capabilities");
+        return false;
+    }
+    // Optional: without it frames stay at uplink_frame_bytes
+    cJSON *min_frame = cJSON_GetObjectItem(config, "uplink_min_frame_bytes");
+    next.uplink_min_frame_bytes = next.uplink_frame_bytes;
+    if (min_frame && (!frame_bytes_ok(min_frame, &next.uplink_min_frame_bytes) ||
+                      next.uplink_min_frame_bytes > next.uplink_frame_bytes)) {
+        ESP_LOGW("SESSION", "Refusing session_config outside the advertised capabilities");
+        return false;
+    }
+
+    // Features the server leaves out are off for this session; it cannot
+    // turn on one the device does not have
+    cJSON *features = cJSON_GetObjectItem(config, "features");
+    if (cJSON_IsArray(features)) {
+        cJSON *item;
+        cJSON_ArrayForEach(item, features) {
+            const char *name = cJSON_GetStringValue(item);
+            for (int i = 0; name && i < SESSION_FEATURE_COUNT; i++) {
+                if (strcmp(name, feature_names[i]) == 0) {
+                    next.features |= 1u << i;
+                }
+            }
+        }
+    } else {
+        next.features = UINT32_MAX;
+    }
+
+    portENTER_CRITICAL(&profile_lock);
+    profile = next;
+    portEXIT_CRITICAL(&profile_lock);
+
+    ESP_LOGI("SESSION", "Negotiated protocol %"PRIu32": %s %"PRIu32" Hz, uplink %"PRIu32"-%"PRIu32" B, "
+             "downlink %"PRIu32" B, features 0x%02"PRIx32,
+             next.protocol, codec_names[next.codec], next.sample_rate, next.uplink_min_frame_bytes,
+             next.uplink_frame_bytes, next.downlink_frame_bytes, next.features & available_features());
+    return true;
+}
+
+void session_profile_get(session_profile_t *out) {
+    portENTER_CRITICAL(&profile_lock);
+    *out = profile;
+    portEXIT_CRITICAL(&profile_lock);
+}
+
+size_t session_uplink_frame_bytes(void) {
+    portENTER_CRITICAL(&profile_lock);
+    size_t bytes = profile.uplink_frame_bytes;
+    portEXIT_CRITICAL(&profile_lock);
+    return bytes;
+}
+
+size_t session_uplink_min_frame_bytes(void) {
+    portENTER_CRITICAL(&profile_lock);
+    size_t bytes = profile.uplink_min_frame_bytes;
+    portEXIT_CRITICAL(&profile_lock);
+    return bytes;
+}
+
+bool session_feature_enabled(session_feature_t feature) {
+    if ((unsigned)feature >= SESSION_FEATURE_COUNT) {
+        return false;
+    }
+    portENTER_CRITICAL(&profile_lock);
+    bool enabled = (profile.features & (1u << feature)) != 0;
+    portEXIT_CRITICAL(&profile_lock);
+    return enabled;
+}
+
+const char* session_feature_name(session_feature_t feature) {
+    return (unsigned)feature < SESSION_FEATURE_COUNT ? feature_names[feature] : "unknown";
+}
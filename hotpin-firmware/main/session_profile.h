@@ -0,0 +1,112 @@
+/*
+ * HotPin Firmware - Session Profile Negotiation
+ *
+ * On every connection the server's "ready" is answered with a "hello"
+ * listing what this build can do: PSRAM, codecs, sample rates, frame size
+ * limits and optional features. The server answers with "session_config",
+ * the parameters it picked, and the audio pipelines read them from here at
+ * the next frame boundary. Until then (and with servers that predate the
+ * handshake) the legacy profile applies: 16 kHz PCM in CHUNK_BYTES frames
+ * with every available feature on. A server that sends
+ * uplink_min_frame_bytes lets the capture path pick each frame's size in
+ * that range (frame_adapt.h).
+ */
+
+#ifndef SESSION_PROFILE_H
+#define SESSION_PROFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cJSON.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SESSION_PROTOCOL_VERSION    2       // 1: client_on only, fixed parameters
+#define SESSION_MIN_FRAME_BYTES     640     // 20 ms, the shortest adaptive frame
+
+typedef enum {
+    SESSION_FEATURE_BARGE_IN = 0,
+    SESSION_FEATURE_TTS_CACHE,
+    SESSION_FEATURE_DICTATION,
+    SESSION_FEATURE_STORE_FORWARD,
+    SESSION_FEATURE_WAKE_WORD,
+    SESSION_FEATURE_NOISE_SUPPRESS,
+    SESSION_FEATURE_SELFTEST,
+    SESSION_FEATURE_UDP_AUDIO,
+    SESSION_FEATURE_MUX,
+    SESSION_FEATURE_COUNT
+} session_feature_t;
+
+typedef enum {
+    SESSION_CODEC_PCM16 = 0,
+    SESSION_CODEC_COUNT
+} session_codec_t;
+
+typedef struct {
+    uint32_t protocol;              // Version the server answered with, 1 if it did not
+    session_codec_t codec;
+    uint32_t sample_rate;
+    uint32_t uplink_frame_bytes;    // Largest live capture frame
+    uint32_t uplink_min_frame_bytes;// Smallest, for the adaptive frame size
+    uint32_t downlink_frame_bytes;  // Largest TTS frame the server will send
+    uint32_t features;              // Bit per session_feature_t, enabled for this session
+} session_profile_t;
+
+/**
+ * @brief Go back to the legacy profile (on each new connection)
+ */
+void session_profile_reset(void);
+
+/**
+ * @brief Build the "hello" message advertising this device
+ *
+ * @return New JSON object for ws_send_json(), NULL if out of memory
+ */
+cJSON* session_profile_hello(void);
+
+/**
+ * @brief Apply a "session_config" message from the server
+ *
+ * Every parameter is checked against what this device advertised; if any
+ * is out of range the whole config is refused and the current profile kept.
+ *
+ * @return true if the config was applied
+ */
+bool session_profile_apply(const cJSON *config);
+
+/**
+ * @brief Copy the current profile
+ */
+void session_profile_get(session_profile_t *profile);
+
+/**
+ * @brief Largest live capture frame under the current profile
+ */
+size_t session_uplink_frame_bytes(void);
+
+/**
+ * @brief Smallest live capture frame under the current profile (equal to
+ *        the largest unless the server allows adaptive frames)
+ */
+size_t session_uplink_min_frame_bytes(void);
+
+/**
+ * @brief true if the feature is available on this device and the server
+ *        left it enabled
+ */
+bool session_feature_enabled(session_feature_t feature);
+
+/**
+ * @brief Protocol name of a feature ("tts_cache", ...)
+ */
+const char* session_feature_name(session_feature_t feature);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SESSION_PROFILE_H */
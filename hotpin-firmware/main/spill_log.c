@@ -0,0 +1,219 @@
+/*
+ * HotPin Firmware - Flash Spill Log
+ *
+ * Slot layout: [header (32 bytes)][payload]. A record is committed by
+ * writing the header after the payload, so a torn write leaves a slot whose
+ * header CRC does not match and is treated as free. Consuming a record
+ * programs its state word to zero, which needs no erase.
+ *
+ * No ESP-IDF dependencies: see spill_log.h.
+ */
+
+#include <string.h>
+
+#include "spill_log.h"
+
+#define SPILL_MAGIC             0x4C505348u  // "HSPL"
+#define SPILL_STATE_VALID       0x0000FFFFu
+#define SPILL_STATE_CONSUMED    0x00000000u
+
+typedef struct {
+    uint32_t magic;
+    uint32_t state;             // Not covered by header_crc (rewritten on consume)
+    uint32_t spill_seq;
+    uint32_t chunk_seq;
+    uint32_t len;
+    uint32_t erase_count;
+    uint32_t payload_crc;
+    uint32_t header_crc;        // Over magic, spill_seq .. payload_crc
+} spill_header_t;
+
+_Static_assert(sizeof(spill_header_t) == SPILL_HEADER_BYTES, "spill header must be SPILL_HEADER_BYTES");
+
+static uint32_t spill_crc32(uint32_t crc, const uint8_t *data, size_t len) {
+    // Nibble-table CRC-32 (IEEE), small enough to keep out of the hot path
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc = table[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+        crc = table[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+static uint32_t header_crc(const spill_header_t *hdr) {
+    uint32_t crc = spill_crc32(0, (const uint8_t*)&hdr->magic, sizeof(hdr->magic));
+    return spill_crc32(crc, (const uint8_t*)&hdr->spill_seq,
+                       offsetof(spill_header_t, header_crc) - offsetof(spill_header_t, spill_seq));
+}
+
+static uint32_t slot_offset(uint32_t slot) {
+    return slot * SPILL_SLOT_BYTES;
+}
+
+// Header of a slot if it holds a committed record (pending or consumed)
+static bool read_header(spill_log_t *log, uint32_t slot, spill_header_t *hdr) {
+    if (!log->flash.read(log->flash.ctx, slot_offset(slot), hdr, sizeof(*hdr))) {
+        return false;
+    }
+    return hdr->magic == SPILL_MAGIC && hdr->len <= SPILL_MAX_PAYLOAD && hdr->header_crc == header_crc(hdr);
+}
+
+static bool mark_consumed(spill_log_t *log, uint32_t slot) {
+    uint32_t state = SPILL_STATE_CONSUMED;
+    return log->flash.write(log->flash.ctx, slot_offset(slot) + offsetof(spill_header_t, state),
+                            &state, sizeof(state));
+}
+
+static void note_erase_count(spill_log_t *log, uint32_t erase_count, bool first) {
+    if (first || erase_count < log->stats.erase_min) {
+        log->stats.erase_min = erase_count;
+    }
+    if (first || erase_count > log->stats.erase_max) {
+        log->stats.erase_max = erase_count;
+    }
+}
+
+bool spill_log_open(spill_log_t *log, const spill_flash_t *flash, uint32_t max_slots) {
+    memset(log, 0, sizeof(*log));
+    log->flash = *flash;
+    log->slot_count = flash->size / SPILL_SLOT_BYTES;
+    if (max_slots && max_slots < log->slot_count) {
+        log->slot_count = max_slots;
+    }
+    if (log->slot_count < 2) {
+        return false;
+    }
+
+    // Newest record (any state) decides where writing resumes; the oldest
+    // pending record is where replay resumes
+    bool have_newest = false, have_oldest = false;
+    uint32_t newest_seq = 0, newest_slot = 0, oldest_seq = 0, oldest_slot = 0;
+
+    for (uint32_t slot = 0; slot < log->slot_count; slot++) {
+        spill_header_t hdr;
+        if (!read_header(log, slot, &hdr)) {
+            note_erase_count(log, 0, slot == 0);
+            continue;
+        }
+        note_erase_count(log, hdr.erase_count, slot == 0);
+
+        if (!have_newest || (int32_t)(hdr.spill_seq - newest_seq) > 0) {
+            have_newest = true;
+            newest_seq = hdr.spill_seq;
+            newest_slot = slot;
+        }
+        if (hdr.state == SPILL_STATE_VALID) {
+            log->pending++;
+            if (!have_oldest || (int32_t)(hdr.spill_seq - oldest_seq) < 0) {
+                have_oldest = true;
+                oldest_seq = hdr.spill_seq;
+                oldest_slot = slot;
+            }
+        }
+    }
+
+    if (have_newest) {
+        log->head = (newest_slot + 1) % log->slot_count;
+        log->next_spill_seq = newest_seq + 1;
+    }
+    log->tail = have_oldest ? oldest_slot : log->head;
+    log->stats.recovered = log->pending;
+    return true;
+}
+
+bool spill_log_append(spill_log_t *log, uint32_t chunk_seq, const uint8_t *data, size_t len) {
+    if (len > SPILL_MAX_PAYLOAD) {
+        return false;
+    }
+
+    if (log->pending == log->slot_count) {
+        // Full: the oldest unsent record makes room
+        mark_consumed(log, log->tail);
+        log->tail = (log->tail + 1) % log->slot_count;
+        log->pending--;
+        log->stats.evicted++;
+    }
+
+    uint32_t slot = log->head;
+    spill_header_t old;
+    uint32_t erase_count = read_header(log, slot, &old) ? old.erase_count + 1 : 1;
+
+    if (!log->flash.erase(log->flash.ctx, slot_offset(slot), SPILL_SLOT_BYTES) ||
+        !log->flash.write(log->flash.ctx, slot_offset(slot) + SPILL_HEADER_BYTES, data, len)) {
+        return false;
+    }
+
+    spill_header_t hdr = {
+        .magic = SPILL_MAGIC,
+        .state = SPILL_STATE_VALID,
+        .spill_seq = log->next_spill_seq,
+        .chunk_seq = chunk_seq,
+        .len = (uint32_t)len,
+        .erase_count = erase_count,
+        .payload_crc = spill_crc32(0, data, len),
+    };
+    hdr.header_crc = header_crc(&hdr);
+    if (!log->flash.write(log->flash.ctx, slot_offset(slot), &hdr, sizeof(hdr))) {
+        return false;
+    }
+
+    if (log->pending == 0) {
+        log->tail = slot;
+    }
+    log->head = (slot + 1) % log->slot_count;
+    log->next_spill_seq++;
+    log->pending++;
+    log->stats.appended++;
+    if (erase_count > log->stats.erase_max) {
+        log->stats.erase_max = erase_count;
+    }
+    return true;
+}
+
+bool spill_log_peek(spill_log_t *log, uint32_t *chunk_seq, uint8_t *dst, size_t cap, size_t *len) {
+    while (log->pending > 0) {
+        spill_header_t hdr;
+        bool ok = read_header(log, log->tail, &hdr) && hdr.state == SPILL_STATE_VALID && hdr.len <= cap &&
+                  log->flash.read(log->flash.ctx, slot_offset(log->tail) + SPILL_HEADER_BYTES, dst, hdr.len) &&
+                  spill_crc32(0, dst, hdr.len) == hdr.payload_crc;
+        if (ok) {
+            *chunk_seq = hdr.chunk_seq;
+            *len = hdr.len;
+            return true;
+        }
+
+        // Corrupt record: drop it and try the next one
+        log->stats.crc_errors++;
+        mark_consumed(log, log->tail);
+        log->tail = (log->tail + 1) % log->slot_count;
+        log->pending--;
+    }
+    return false;
+}
+
+bool spill_log_consume(spill_log_t *log) {
+    if (log->pending == 0) {
+        return false;
+    }
+    bool ok = mark_consumed(log, log->tail);
+    log->tail = (log->tail + 1) % log->slot_count;
+    log->pending--;
+    log->stats.replayed++;
+    return ok;
+}
+
+uint32_t spill_log_discard(spill_log_t *log) {
+    uint32_t dropped = 0;
+    while (log->pending > 0) {
+        mark_consumed(log, log->tail);
+        log->tail = (log->tail + 1) % log->slot_count;
+        log->pending--;
+        dropped++;
+    }
+    log->stats.discarded += dropped;
+    return dropped;
+}
@@ -0,0 +1,108 @@
+/*
+ * HotPin Firmware - Flash Spill Log
+ *
+ * Log-structured ring of fixed-size slots on a raw flash region. Each slot
+ * holds one audio chunk behind a header with a spill sequence number, the
+ * chunk's audio sequence number, CRCs and the slot's erase count. Slots are
+ * written round-robin, so erases spread evenly over the region; when every
+ * slot holds unsent data the oldest record is evicted.
+ *
+ * The log only talks to flash through spill_flash_t, so it builds on the
+ * host against a file (tools/spill_bench.c) as well as on the device
+ * against the `storage` partition (audio_spill.c).
+ */
+
+#ifndef SPILL_LOG_H
+#define SPILL_LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SPILL_SECTOR_BYTES      4096
+#define SPILL_SLOT_BYTES        (4 * SPILL_SECTOR_BYTES)
+#define SPILL_HEADER_BYTES      32
+#define SPILL_MAX_PAYLOAD       (SPILL_SLOT_BYTES - SPILL_HEADER_BYTES)
+
+// Flash access; offsets are relative to the start of the region. Writes
+// follow NOR semantics (bits only go 1 -> 0), erase sets bytes to 0xFF.
+typedef struct {
+    bool (*read)(void *ctx, uint32_t offset, void *dst, size_t len);
+    bool (*write)(void *ctx, uint32_t offset, const void *src, size_t len);
+    bool (*erase)(void *ctx, uint32_t offset, size_t len);
+    void *ctx;
+    uint32_t size;
+} spill_flash_t;
+
+typedef struct {
+    uint32_t appended;
+    uint32_t replayed;
+    uint32_t evicted;           // Oldest unsent records overwritten
+    uint32_t crc_errors;        // Records skipped on replay
+    uint32_t recovered;         // Pending records found by spill_log_open()
+    uint32_t discarded;         // Pending records dropped unsent by spill_log_discard()
+    uint32_t erase_min;         // Lowest / highest slot erase count
+    uint32_t erase_max;
+} spill_log_stats_t;
+
+typedef struct {
+    spill_flash_t flash;
+    uint32_t slot_count;
+    uint32_t head;              // Next slot to write
+    uint32_t tail;              // Oldest pending slot
+    uint32_t pending;
+    uint32_t next_spill_seq;
+    spill_log_stats_t stats;
+} spill_log_t;
+
+/**
+ * @brief Mount the log and recover pending records left by a previous run
+ *
+ * @param log Log state to initialize
+ * @param flash Flash access for the region
+ * @param max_slots Upper bound on slots used (0 = as many as fit)
+ * @return true on success, false if the region is too small or unreadable
+ */
+bool spill_log_open(spill_log_t *log, const spill_flash_t *flash, uint32_t max_slots);
+
+/**
+ * @brief Append one chunk, evicting the oldest pending record if full
+ *
+ * @return true if the record was committed
+ */
+bool spill_log_append(spill_log_t *log, uint32_t chunk_seq, const uint8_t *data, size_t len);
+
+/**
+ * @brief Read the oldest pending record without consuming it
+ *
+ * Records that fail their CRC are consumed and skipped.
+ *
+ * @param chunk_seq Output: audio sequence number of the record
+ * @param dst Output buffer
+ * @param cap Size of dst; larger records are treated as corrupt
+ * @param len Output: payload length
+ * @return true if a record was read, false if the log is empty
+ */
+bool spill_log_peek(spill_log_t *log, uint32_t *chunk_seq, uint8_t *dst, size_t cap, size_t *len);
+
+/**
+ * @brief Mark the oldest pending record as sent
+ */
+bool spill_log_consume(spill_log_t *log);
+
+/**
+ * @brief Drop every pending record without sending it
+ *
+ * @return Number of records dropped
+ */
+uint32_t spill_log_discard(spill_log_t *log);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPILL_LOG_H */
@@ -0,0 +1,159 @@
+/*
+ * HotPin Firmware - Client State Machine Transition Table
+ *
+ * Every legal transition is declared once in transition_table, indexed by
+ * [from][to], together with the side effects it triggers. Lookups are a
+ * single array index, so set_state() can decide a transition inside a
+ * critical section and hand the effects to the executor task.
+ */
+
+#include "state_machine.h"
+
+#include <stddef.h>
+#include <string.h>
+
+// Marks a declared edge, independent of the side effects it carries
+#define SM_EDGE  (1u << 31)
+
+#define LEAVE_RECORDING  (SM_EFFECT_I2S_RELEASE | SM_EFFECT_MSG_RECORDING_STOPPED)
+#define ENTER_RECORDING  (SM_EFFECT_I2S_RX | SM_EFFECT_MSG_RECORDING_STARTED)
+#define ENTER_PLAYING    (SM_EFFECT_I2S_TX | SM_EFFECT_MSG_READY_PLAYBACK)
+
+static const uint32_t transition_table[CLIENT_STATE_COUNT][CLIENT_STATE_COUNT] = {
+    [CLIENT_STATE_BOOTING] = {
+        [CLIENT_STATE_CONNECTED]      = SM_EDGE | SM_EFFECT_LED,
+        // websocket_task sends client_on itself after the handshake
+        [CLIENT_STATE_IDLE]           = SM_EDGE | SM_EFFECT_LED,
+        [CLIENT_STATE_STALLED]        = SM_EDGE | SM_EFFECT_EARCON | SM_EFFECT_LED,
+        [CLIENT_STATE_SHUTDOWN]       = SM_EDGE | SM_EFFECT_LED,
+    },
+    [CLIENT_STATE_CONNECTED] = {
+        [CLIENT_STATE_IDLE]           = SM_EDGE | SM_EFFECT_MSG_CLIENT_ON | SM_EFFECT_LED,
+        [CLIENT_STATE_STALLED]        = SM_EDGE | SM_EFFECT_EARCON | SM_EFFECT_LED,
+        [CLIENT_STATE_SHUTDOWN]       = SM_EDGE | SM_EFFECT_LED,
+    },
+    [CLIENT_STATE_IDLE] = {
+        [CLIENT_STATE_RECORDING]      = SM_EDGE | ENTER_RECORDING | SM_EFFECT_LED,
+        [CLIENT_STATE_PLAYING]        = SM_EDGE | ENTER_PLAYING | SM_EFFECT_LED,
+        [CLIENT_STATE_CAMERA_CAPTURE] = SM_EDGE | SM_EFFECT_LED,
+        // The self-test installs its own I2S configuration
+        [CLIENT_STATE_SELF_TEST]      = SM_EDGE | SM_EFFECT_I2S_RELEASE | SM_EFFECT_LED,
+        [CLIENT_STATE_STALLED]        = SM_EDGE | SM_EFFECT_EARCON | SM_EFFECT_LED,
+        [CLIENT_STATE_SHUTDOWN]       = SM_EDGE | SM_EFFECT_LED,
+    },
+    [CLIENT_STATE_RECORDING] = {
+        [CLIENT_STATE_IDLE]           = SM_EDGE | LEAVE_RECORDING | SM_EFFECT_LED,
+        [CLIENT_STATE_PROCESSING]     = SM_EDGE | LEAVE_RECORDING | SM_EFFECT_EARCON | SM_EFFECT_LED,
+        [CLIENT_STATE_STALLED]        = SM_EDGE | LEAVE_RECORDING | SM_EFFECT_EARCON | SM_EFFECT_LED,
+        [CLIENT_STATE_SHUTDOWN]       = SM_EDGE | LEAVE_RECORDING | SM_EFFECT_LED,
+    },
+    [CLIENT_STATE_PROCESSING] = {
+        [CLIENT_STATE_IDLE]           = SM_EDGE | SM_EFFECT_LED,
+        [CLIENT_STATE_PLAYING]        = SM_EDGE | ENTER_PLAYING | SM_EFFECT_LED,
+        [CLIENT_STATE_STALLED]        = SM_EDGE | SM_EFFECT_EARCON | SM_EFFECT_LED,
+        [CLIENT_STATE_SHUTDOWN]       = SM_EDGE | SM_EFFECT_LED,
+    },
+    [CLIENT_STATE_PLAYING] = {
+        // Barge-in: reinstalling I2S in RX mode also releases TX
+        [CLIENT_STATE_RECORDING]      = SM_EDGE | ENTER_RECORDING | SM_EFFECT_LED,
+        [CLIENT_STATE_IDLE]           = SM_EDGE | SM_EFFECT_I2S_RELEASE | SM_EFFECT_MSG_PLAYBACK_COMPLETE | SM_EFFECT_LED,
+        [CLIENT_STATE_STALLED]        = SM_EDGE | SM_EFFECT_I2S_RELEASE | SM_EFFECT_EARCON | SM_EFFECT_LED,
+        [CLIENT_STATE_SHUTDOWN]       = SM_EDGE | SM_EFFECT_I2S_RELEASE | SM_EFFECT_LED,
+    },
+    [CLIENT_STATE_CAMERA_CAPTURE] = {
+        [CLIENT_STATE_IDLE]           = SM_EDGE | SM_EFFECT_LED,
+        [CLIENT_STATE_STALLED]        = SM_EDGE | SM_EFFECT_EARCON | SM_EFFECT_LED,
+        [CLIENT_STATE_SHUTDOWN]       = SM_EDGE | SM_EFFECT_LED,
+    },
+    [CLIENT_STATE_STALLED] = {
+        [CLIENT_STATE_CONNECTED]      = SM_EDGE | SM_EFFECT_LED,
+        [CLIENT_STATE_IDLE]           = SM_EDGE | SM_EFFECT_LED,
+        [CLIENT_STATE_SHUTDOWN]       = SM_EDGE | SM_EFFECT_LED,
+    },
+    [CLIENT_STATE_SELF_TEST] = {
+        [CLIENT_STATE_IDLE]           = SM_EDGE | SM_EFFECT_I2S_RELEASE | SM_EFFECT_LED,
+        [CLIENT_STATE_STALLED]        = SM_EDGE | SM_EFFECT_I2S_RELEASE | SM_EFFECT_EARCON | SM_EFFECT_LED,
+        [CLIENT_STATE_SHUTDOWN]       = SM_EDGE | SM_EFFECT_I2S_RELEASE | SM_EFFECT_LED,
+    },
+    // SHUTDOWN is terminal
+};
+
+static sm_edge_stats_t edge_stats[CLIENT_STATE_COUNT][CLIENT_STATE_COUNT];
+
+static inline bool state_in_range(client_state_t state) {
+    return (unsigned)state < CLIENT_STATE_COUNT;
+}
+
+bool sm_is_valid_transition(client_state_t from, client_state_t to) {
+    if (!state_in_range(from) || !state_in_range(to)) {
+        return false;
+    }
+    return (transition_table[from][to] & SM_EDGE) != 0;
+}
+
+uint32_t sm_transition_effects(client_state_t from, client_state_t to) {
+    if (!state_in_range(from) || !state_in_range(to)) {
+        return SM_EFFECT_NONE;
+    }
+    return transition_table[from][to] & ~SM_EDGE;
+}
+
+bool sm_request_transition(client_state_t from, client_state_t to, uint32_t *effects) {
+    if (from == to) {
+        return false;
+    }
+    if (!sm_is_valid_transition(from, to)) {
+        sm_record_rejected(from, to);
+        return false;
+    }
+    if (effects) {
+        *effects = sm_transition_effects(from, to);
+    }
+    return true;
+}
+
+void sm_record_latency(client_state_t from, client_state_t to, uint32_t latency_us) {
+    if (!state_in_range(from) || !state_in_range(to)) {
+        return;
+    }
+    sm_edge_stats_t *stats = &edge_stats[from][to];
+    stats->count++;
+    stats->total_us += latency_us;
+    if (latency_us > stats->max_us) {
+        stats->max_us = latency_us;
+    }
+}
+
+void sm_record_rejected(client_state_t from, client_state_t to) {
+    if (!state_in_range(from) || !state_in_range(to)) {
+        return;
+    }
+    edge_stats[from][to].rejected++;
+}
+
+const sm_edge_stats_t* sm_get_edge_stats(client_state_t from, client_state_t to) {
+    if (!state_in_range(from) || !state_in_range(to)) {
+        return NULL;
+    }
+    return &edge_stats[from][to];
+}
+
+void sm_reset_stats(void) {
+    memset(edge_stats, 0, sizeof(edge_stats));
+}
+
+const char* state_to_string(client_state_t state) {
+    switch (state) {
+        case CLIENT_STATE_BOOTING: return "BOOTING";
+        case CLIENT_STATE_CONNECTED: return "CONNECTED";
+        case CLIENT_STATE_IDLE: return "IDLE";
+        case CLIENT_STATE_RECORDING: return "RECORDING";
+        case CLIENT_STATE_PROCESSING: return "PROCESSING";
+        case CLIENT_STATE_PLAYING: return "PLAYING";
+        case CLIENT_STATE_CAMERA_CAPTURE: return "CAMERA_CAPTURE";
+        case CLIENT_STATE_STALLED: return "STALLED";
+        case CLIENT_STATE_SELF_TEST: return "SELF_TEST";
+        case CLIENT_STATE_SHUTDOWN: return "SHUTDOWN";
+        default: return "UNKNOWN";
+    }
+}
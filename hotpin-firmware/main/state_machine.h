@@ -0,0 +1,126 @@
+/*
+ * HotPin Firmware - Client State Machine Transition Table
+ *
+ * Pure C (no FreeRTOS / ESP-IDF dependencies) so the table can be
+ * compiled and unit-tested on the host.
+ */
+
+#ifndef STATE_MACHINE_H
+#define STATE_MACHINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    CLIENT_STATE_BOOTING = 0,
+    CLIENT_STATE_CONNECTED,
+    CLIENT_STATE_IDLE,
+    CLIENT_STATE_RECORDING,
+    CLIENT_STATE_PROCESSING,
+    CLIENT_STATE_PLAYING,
+    CLIENT_STATE_CAMERA_CAPTURE,
+    CLIENT_STATE_STALLED,
+    CLIENT_STATE_SELF_TEST,         // Audio pipeline self-test, see diagnostics.h
+    CLIENT_STATE_SHUTDOWN,
+    CLIENT_STATE_COUNT
+} client_state_t;
+
+// Side effects attached to a transition, executed asynchronously by the
+// state effect task in the order they are listed here
+#define SM_EFFECT_NONE                  0u
+#define SM_EFFECT_I2S_RX                (1u << 0)  // Reinstall I2S in RX mode (recording)
+#define SM_EFFECT_I2S_TX                (1u << 1)  // Reinstall I2S in TX mode (playback)
+#define SM_EFFECT_I2S_RELEASE           (1u << 2)  // Uninstall I2S when leaving an audio state
+#define SM_EFFECT_MSG_CLIENT_ON         (1u << 3)
+#define SM_EFFECT_MSG_RECORDING_STARTED (1u << 4)
+#define SM_EFFECT_MSG_RECORDING_STOPPED (1u << 5)
+#define SM_EFFECT_MSG_READY_PLAYBACK    (1u << 6)
+#define SM_EFFECT_MSG_PLAYBACK_COMPLETE (1u << 7)
+#define SM_EFFECT_LED                   (1u << 8)
+#define SM_EFFECT_EARCON                (1u << 9)  // Play the flash earcon for the new state
+
+#define SM_EFFECT_I2S_MASK  (SM_EFFECT_I2S_RX | SM_EFFECT_I2S_TX | SM_EFFECT_I2S_RELEASE)
+#define SM_EFFECT_MSG_MASK  (SM_EFFECT_MSG_CLIENT_ON | SM_EFFECT_MSG_RECORDING_STARTED | \
+                             SM_EFFECT_MSG_RECORDING_STOPPED | SM_EFFECT_MSG_READY_PLAYBACK | \
+                             SM_EFFECT_MSG_PLAYBACK_COMPLETE)
+
+// Per-edge transition latency (request -> side effects completed)
+typedef struct {
+    uint32_t count;
+    uint32_t rejected;
+    uint64_t total_us;
+    uint32_t max_us;
+} sm_edge_stats_t;
+
+/**
+ * @brief Check whether a transition is declared in the table
+ *
+ * @param from Current state
+ * @param to Requested state
+ * @return true if the edge exists, false otherwise
+ */
+bool sm_is_valid_transition(client_state_t from, client_state_t to);
+
+/**
+ * @brief Look up the side effects of a transition (O(1) table index)
+ *
+ * @param from Current state
+ * @param to Requested state
+ * @return Bitmask of SM_EFFECT_* flags, SM_EFFECT_NONE for undeclared edges
+ */
+uint32_t sm_transition_effects(client_state_t from, client_state_t to);
+
+/**
+ * @brief Decide a transition request: look up its effects, or count it as
+ *        rejected if the edge is undeclared
+ *
+ * Requesting the current state is a no-op: it returns false and is not
+ * counted.
+ *
+ * @param from Current state
+ * @param to Requested state
+ * @param effects Set to the edge's SM_EFFECT_* flags if accepted, may be NULL
+ * @return true if the transition may be applied
+ */
+bool sm_request_transition(client_state_t from, client_state_t to, uint32_t *effects);
+
+/**
+ * @brief Record the latency of a completed transition
+ *
+ * @param from Previous state
+ * @param to New state
+ * @param latency_us Time from the set_state() request to completion of its side effects
+ */
+void sm_record_latency(client_state_t from, client_state_t to, uint32_t latency_us);
+
+/**
+ * @brief Record a transition request that was rejected by the table
+ */
+void sm_record_rejected(client_state_t from, client_state_t to);
+
+/**
+ * @brief Get the latency statistics for one edge
+ *
+ * @return Pointer to the statistics, or NULL for out-of-range states
+ */
+const sm_edge_stats_t* sm_get_edge_stats(client_state_t from, client_state_t to);
+
+/**
+ * @brief Reset all per-edge statistics
+ */
+void sm_reset_stats(void);
+
+/**
+ * @brief Convert a state to its protocol/log name
+ */
+const char* state_to_string(client_state_t state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STATE_MACHINE_H */
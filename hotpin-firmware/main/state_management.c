@@ -3,260 +3,469 @@
  */
 
 #include "main.h"
+#include "chunk_pool.h"
+#include "diagnostics.h"
+#include "dictation.h"
+#include "earcon.h"
+#include "session_profile.h"
+#include "tts_cache.h"
+#include "wake_word.h"
+#include "ws_mux.h"
 #include "esp_timer.h"  // For esp_timer_get_time()
 
 // These are defined as global variables in main.c
 extern TaskHandle_t camera_task_handle;
-extern TaskHandle_t audio_capture_task_handle;  // Add audio capture task handle for suspend/resume control
+
+// Serialises the current_state read-modify-write in set_state()
+static portMUX_TYPE state_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t state_generation = 0;   // Incremented on every accepted transition
+static int64_t state_entered_us = 0;    // esp_timer_get_time() of the last transition
+static TaskHandle_t state_effect_task_handle = NULL;  // Woken for each queued transition or earcon
+
+// Wakeup counters for the state-driven task loops, see log_task_wakeup_stats()
+static uint32_t task_wakeups[WAKEUP_SOURCE_COUNT];
+static const char *wakeup_source_names[WAKEUP_SOURCE_COUNT] = {
+    [WAKEUP_AUDIO_CAPTURE] = "audio_capture",
+    [WAKEUP_AUDIO_PLAYBACK] = "audio_playback",
+    [WAKEUP_STATE_MANAGER] = "state_manager",
+    [WAKEUP_WEBSOCKET] = "websocket",
+};
+
+client_state_t get_state(void) {
+    return __atomic_load_n(&current_state, __ATOMIC_ACQUIRE);
+}
+
+state_snapshot_t get_state_snapshot(void) {
+    state_snapshot_t snapshot;
+    portENTER_CRITICAL(&state_lock);
+    snapshot.state = current_state;
+    snapshot.generation = state_generation;
+    snapshot.entered_us = state_entered_us;
+    portEXIT_CRITICAL(&state_lock);
+    return snapshot;
+}
+
+// Make exactly one state bit visible to tasks blocked in wait_for_state()
+static void publish_state_bits(client_state_t state) {
+    if (!state_events) {
+        return;
+    }
+    xEventGroupClearBits(state_events, STATE_BITS_ALL & ~STATE_BIT(state));
+    xEventGroupSetBits(state_events, STATE_BIT(state));
+}
+
+EventBits_t wait_for_state(EventBits_t state_bits, TickType_t timeout) {
+    if (!state_events) {
+        vTaskDelay(timeout == portMAX_DELAY ? pdMS_TO_TICKS(100) : timeout);
+        return STATE_BIT(get_state()) & state_bits;
+    }
+    return xEventGroupWaitBits(state_events, state_bits, pdFALSE, pdFALSE, timeout) & state_bits;
+}
+
+void record_task_wakeup(wakeup_source_t source) {
+    if (source < WAKEUP_SOURCE_COUNT) {
+        task_wakeups[source]++;
+    }
+}
+
+void log_task_wakeup_stats(void) {
+    int64_t uptime_s = esp_timer_get_time() / 1000000;
+    if (uptime_s <= 0) {
+        uptime_s = 1;
+    }
+    for (int i = 0; i < WAKEUP_SOURCE_COUNT; i++) {
+        ESP_LOGI("STATE", "Wakeups %s: %"PRIu32" total, %.2f/s",
+                 wakeup_source_names[i], task_wakeups[i], (double)task_wakeups[i] / (double)uptime_s);
+    }
+}
 
 void set_state(client_state_t new_state) {
-    if (xSemaphoreTake(state_mutex, portMAX_DELAY) == pdTRUE) {
-        client_state_t old_state = current_state;
-        current_state = new_state;
-        
-        // Handle I2S mode switching when entering/leaving RECORDING state
-        if (new_state == CLIENT_STATE_RECORDING && old_state != CLIENT_STATE_RECORDING) {
-            // Entering RECORDING state - ensure I2S is in RX mode
-            ESP_LOGI("STATE", "Switching I2S to RX mode for recording");
-            
-            // Pause audio capture task during I2S reconfiguration to prevent race conditions
-            if (audio_capture_task_handle) {
-                ESP_LOGI("STATE", "Pausing audio capture task during I2S reconfiguration");
-                vTaskSuspend(audio_capture_task_handle);
-            }
-            
-            uninstall_i2s();  // Use the safe mutex-protected uninstall function
-            
-            // Wait a bit for uninstall to complete
-            vTaskDelay(pdMS_TO_TICKS(100));
-            
-            i2s_config_t i2s_config_rx = {
-                .mode = I2S_MODE_MASTER | I2S_MODE_RX,
-                .sample_rate = SAMPLE_RATE,
-                .bits_per_sample = BITS_PER_SAMPLE,
-                .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
-                .communication_format = I2S_COMM_FORMAT_STAND_I2S,
-                .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
-                .dma_buf_count = 4,
-                .dma_buf_len = 1024,
-                .use_apll = false,
-                .tx_desc_auto_clear = true,
-                .fixed_mclk = 0,
-                .mclk_multiple = I2S_MCLK_MULTIPLE_128,
-                .bits_per_chan = I2S_BITS_PER_CHAN_DEFAULT
-            };
-            
-            // Take I2S mutex to safely reinstall
-            if (i2s_mutex && xSemaphoreTake(i2s_mutex, pdMS_TO_TICKS(5000)) == pdTRUE) {
-                if (i2s_driver_install(I2S_PORT, &i2s_config_rx, 0, NULL) == ESP_OK) {
-                    i2s_pin_config_t pin_config = {
-                        .bck_io_num = GPIO_BCLK,
-                        .ws_io_num = GPIO_LRCLK,
-                        .data_out_num = -1,
-                        .data_in_num = GPIO_MIC_SD
-                    };
-                    i2s_set_pin(I2S_PORT, &pin_config);
-                    audio_i2s_initialized = true;  // Update the flag
-                    ESP_LOGI("STATE", "I2S configured for RX mode (recording)");
-                } else {
-                    ESP_LOGE("STATE", "Failed to configure I2S for RX mode");
-                }
-                xSemaphoreGive(i2s_mutex);
-            }
-            
-            // Resume audio capture task after I2S reconfiguration
-            if (audio_capture_task_handle) {
-                ESP_LOGI("STATE", "Resuming audio capture task after I2S reconfiguration");
-                vTaskResume(audio_capture_task_handle);
-            }
-        } else if (new_state == CLIENT_STATE_PLAYING && old_state != CLIENT_STATE_PLAYING) {
-            // Entering PLAYING state - ensure I2S is in TX mode
-            ESP_LOGI("STATE", "Switching I2S to TX mode for playback");
-            
-            // Pause audio capture task during I2S reconfiguration to prevent race conditions
-            if (audio_capture_task_handle) {
-                ESP_LOGI("STATE", "Pausing audio capture task during I2S reconfiguration");
-                vTaskSuspend(audio_capture_task_handle);
-            }
-            
-            uninstall_i2s();  // Use the safe mutex-protected uninstall function
-            
-            // Wait a bit for uninstall to complete
-            vTaskDelay(pdMS_TO_TICKS(100));
-            
-            i2s_config_t i2s_config_tx = {
-                .mode = I2S_MODE_MASTER | I2S_MODE_TX,
-                .sample_rate = SAMPLE_RATE,
-                .bits_per_sample = BITS_PER_SAMPLE,
-                .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
-                .communication_format = I2S_COMM_FORMAT_STAND_I2S,
-                .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
-                .dma_buf_count = 4,
-                .dma_buf_len = 1024,
-                .use_apll = false,
-                .tx_desc_auto_clear = true,
-                .fixed_mclk = 0,
-                .mclk_multiple = I2S_MCLK_MULTIPLE_128,
-                .bits_per_chan = I2S_BITS_PER_CHAN_DEFAULT
+    client_state_t old_state;
+    uint32_t effects = SM_EFFECT_NONE;
+    bool accepted;
+
+    // Decide and apply the transition atomically; the table lookup is O(1)
+    portENTER_CRITICAL(&state_lock);
+    old_state = current_state;
+    accepted = sm_request_transition(old_state, new_state, &effects);
+    if (accepted) {
+        __atomic_store_n(&current_state, new_state, __ATOMIC_RELEASE);
+        state_generation++;
+        state_entered_us = esp_timer_get_time();
+    }
+    portEXIT_CRITICAL(&state_lock);
+
+    if (old_state == new_state) {
+        return;  // Nothing to do
+    }
+
+    if (!accepted) {
+        ESP_LOGW("STATE", "Rejected undeclared transition: %s -> %s",
+                 state_to_string(old_state), state_to_string(new_state));
+        return;
+    }
+
+    ESP_LOGI("STATE", "State changed: %s -> %s",
+             state_to_string(old_state), state_to_string(new_state));
+
+    // Hand the side effects to the executor; callers never block here
+    state_effect_t effect = {
+        .old_state = old_state,
+        .new_state = new_state,
+        .effects = effects,
+        .earcon = (effects & SM_EFFECT_EARCON) ? earcon_for_state(new_state) : EARCON_NONE,
+        .requested_us = esp_timer_get_time()
+    };
+
+    // A transition that switches I2S or sends a protocol message must not
+    // be lost (the server would never see recording_stopped), so wait for
+    // room. Only LED/earcon-only transitions may be dropped. The executor
+    // never waits on its own queue.
+    TickType_t wait = 0;
+    if ((effects & (SM_EFFECT_I2S_MASK | SM_EFFECT_MSG_MASK)) &&
+        xTaskGetCurrentTaskHandle() != state_effect_task_handle) {
+        wait = portMAX_DELAY;
+    }
+    if (!q_state_effects || xQueueSend(q_state_effects, &effect, wait) != pdTRUE) {
+        ESP_LOGE("STATE", "State effect queue full, dropping effects for %s -> %s",
+                 state_to_string(old_state), state_to_string(new_state));
+        // Still wake the tasks waiting for this state
+        publish_state_bits(new_state);
+        return;
+    }
+    state_effect_wake();
+}
+
+void state_effect_wake(void) {
+    TaskHandle_t handle = state_effect_task_handle;
+    if (handle) {
+        xTaskNotifyGive(handle);
+    }
+}
+
+// Mode of the installed driver while audio_i2s_initialized (init_i2s() installs RX)
+static bool i2s_tx_mode = false;
+
+// Reinstall the I2S driver in RX (microphone) or TX (speaker) mode
+static void reconfigure_i2s(bool tx) {
+    // Already in this mode (RX kept for the wake-word listener): leave the
+    // stream running so a recording continues straight from the pre-roll
+    if (audio_i2s_initialized && i2s_tx_mode == tx) {
+        return;
+    }
+    ESP_LOGI("STATE", "Switching I2S to %s mode", tx ? "TX" : "RX");
+
+    // Capture and playback hold i2s_mutex for one block at a time, so this
+    // waits at most one block for them
+    uninstall_i2s();  // Use the safe mutex-protected uninstall function
+
+    // Wait a bit for uninstall to complete
+    vTaskDelay(pdMS_TO_TICKS(100));
+
+    i2s_config_t i2s_config = {
+        .mode = I2S_MODE_MASTER | (tx ? I2S_MODE_TX : I2S_MODE_RX),
+        .sample_rate = SAMPLE_RATE,
+        .bits_per_sample = BITS_PER_SAMPLE,
+        .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
+        .communication_format = I2S_COMM_FORMAT_STAND_I2S,
+        .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
+        .dma_buf_count = I2S_DMA_BUF_COUNT,
+        .dma_buf_len = I2S_DMA_BUF_LEN,
+        .use_apll = false,
+        .tx_desc_auto_clear = true,
+        .fixed_mclk = 0,
+        .mclk_multiple = I2S_MCLK_MULTIPLE_128,
+        .bits_per_chan = I2S_BITS_PER_CHAN_DEFAULT
+    };
+
+    // Take I2S mutex to safely reinstall
+    if (i2s_mutex && xSemaphoreTake(i2s_mutex, pdMS_TO_TICKS(5000)) == pdTRUE) {
+        if (i2s_driver_install(I2S_PORT, &i2s_config, 0, NULL) == ESP_OK) {
+            i2s_pin_config_t pin_config = {
+                .bck_io_num = GPIO_BCLK,
+                .ws_io_num = GPIO_LRCLK,
+                .data_out_num = tx ? GPIO_DAC_SD : -1,
+                .data_in_num = tx ? -1 : GPIO_MIC_SD
             };
-            
-            // Take I2S mutex to safely reinstall
-            if (i2s_mutex && xSemaphoreTake(i2s_mutex, pdMS_TO_TICKS(5000)) == pdTRUE) {
-                if (i2s_driver_install(I2S_PORT, &i2s_config_tx, 0, NULL) == ESP_OK) {
-                    i2s_pin_config_t pin_config = {
-                        .bck_io_num = GPIO_BCLK,
-                        .ws_io_num = GPIO_LRCLK,
-                        .data_out_num = GPIO_DAC_SD,
-                        .data_in_num = -1
-                    };
-                    i2s_set_pin(I2S_PORT, &pin_config);
-                    audio_i2s_initialized = true;  // Update the flag
-                    ESP_LOGI("STATE", "I2S configured for TX mode (playback)");
-                } else {
-                    ESP_LOGE("STATE", "Failed to configure I2S for TX mode");
-                }
-                xSemaphoreGive(i2s_mutex);
-            }
-            
-            // Resume audio capture task after I2S reconfiguration
-            if (audio_capture_task_handle) {
-                ESP_LOGI("STATE", "Resuming audio capture task after I2S reconfiguration");
-                vTaskResume(audio_capture_task_handle);
-            }
-        } else if ((new_state != CLIENT_STATE_RECORDING && old_state == CLIENT_STATE_RECORDING) ||
-                   (new_state != CLIENT_STATE_PLAYING && old_state == CLIENT_STATE_PLAYING)) {
-            // Leaving RECORDING or PLAYING state - clean up I2S
-            ESP_LOGI("STATE", "Leaving audio state, cleaning up I2S");
-            
-            // Pause audio capture task during I2S cleanup to prevent race conditions
-            if (audio_capture_task_handle) {
-                ESP_LOGI("STATE", "Pausing audio capture task during I2S cleanup");
-                vTaskSuspend(audio_capture_task_handle);
-            }
-            
-            uninstall_i2s();  // Use the safe mutex-protected uninstall function
-            
-            // Resume audio capture task after I2S cleanup
-            if (audio_capture_task_handle) {
-                ESP_LOGI("STATE", "Resuming audio capture task after I2S cleanup");
-                vTaskResume(audio_capture_task_handle);
+            i2s_set_pin(I2S_PORT, &pin_config);
+            audio_i2s_initialized = true;  // Update the flag
+            i2s_tx_mode = tx;
+            ESP_LOGI("STATE", "I2S configured for %s mode", tx ? "TX" : "RX");
+        } else {
+            ESP_LOGE("STATE", "Failed to configure I2S for %s mode", tx ? "TX" : "RX");
+        }
+        xSemaphoreGive(i2s_mutex);
+    }
+}
+
+static void release_i2s(void) {
+    ESP_LOGI("STATE", "Leaving audio state, cleaning up I2S");
+    uninstall_i2s();  // Waits at most one capture/playback block for i2s_mutex
+}
+
+// Leave I2S the way a state without its own audio use needs it: in RX for
+// the wake-word listener while IDLE, otherwise uninstalled
+static void park_i2s(client_state_t state) {
+    if (state == CLIENT_STATE_IDLE && wake_word_enabled()) {
+        reconfigure_i2s(false);
+    } else {
+        release_i2s();
+    }
+}
+
+// Play a flash earcon, borrowing I2S in TX mode for its duration. Only
+// runs while no audio state owns I2S, and stops at the next block boundary
+// if another transition is queued so its effects are not held up.
+static void play_earcon(earcon_id_t id) {
+    const uint8_t *pcm = NULL;
+    size_t len = 0;
+    if (!earcon_get(id, &pcm, &len)) {
+        return;
+    }
+    client_state_t state = get_state();
+    if (state == CLIENT_STATE_RECORDING || state == CLIENT_STATE_PLAYING ||
+        state == CLIENT_STATE_SELF_TEST || state == CLIENT_STATE_SHUTDOWN || uxQueueMessagesWaiting(q_state_effects) > 0) {
+        return;
+    }
+
+    ESP_LOGI("STATE", "Playing earcon '%s' (%zu bytes)", earcon_name(id), len);
+    reconfigure_i2s(true);
+
+    size_t offset = 0;
+    while (offset < len && uxQueueMessagesWaiting(q_state_effects) == 0) {
+        size_t block = len - offset;
+        if (block > I2S_BOUNCE_BYTES) {
+            block = I2S_BOUNCE_BYTES;
+        }
+        if (audio_write_clip(pcm + offset, block) != ESP_OK) {
+            ESP_LOGW("STATE", "Earcon write failed");
+            break;
+        }
+        offset += block;
+    }
+
+    // Let the DMA ring drain before the driver goes away
+    if (offset == len) {
+        vTaskDelay(pdMS_TO_TICKS(I2S_DMA_RING_BYTES * 1000 / (SAMPLE_RATE * sizeof(int16_t))));
+    }
+    park_i2s(get_state());
+}
+
+// Send the protocol message attached to a transition. The server expects:
+// client_on, recording_started, recording_stopped, ready_for_playback,
+// playback_complete. CONNECTED, STALLED and SHUTDOWN have no message; the
+// WebSocket connection/disconnection events cover those.
+static void send_state_message(uint32_t effects) {
+    cJSON *json = NULL;
+
+    // A local replay plays without the server knowing
+    if ((effects & (SM_EFFECT_MSG_READY_PLAYBACK | SM_EFFECT_MSG_PLAYBACK_COMPLETE)) && tts_cache_replaying()) {
+        return;
+    }
+
+    if (effects & SM_EFFECT_MSG_CLIENT_ON) {
+        json = cJSON_CreateObject();
+        cJSON_AddStringToObject(json, "type", "client_on");
+    } else if (effects & SM_EFFECT_MSG_RECORDING_STARTED) {
+        json = cJSON_CreateObject();
+        cJSON_AddStringToObject(json, "type", "recording_started");
+        audio_begin_recording();
+        cJSON_AddNumberToObject(json, "ts", (double)(esp_timer_get_time() / 1000));
+        if (dictation_active()) {
+            cJSON_AddStringToObject(json, "mode", "dictation");
+        }
+    } else if (effects & SM_EFFECT_MSG_RECORDING_STOPPED) {
+        json = cJSON_CreateObject();
+        cJSON_AddStringToObject(json, "type", "recording_stopped");
+        // Must not overtake the audio it ends, including chunks still in
+        // the capture queue, the spill log or the dictation store
+        audio_end_recording(json);
+        return;
+    } else if (effects & SM_EFFECT_MSG_READY_PLAYBACK) {
+        json = cJSON_CreateObject();
+        cJSON_AddStringToObject(json, "type", "ready_for_playback");
+    } else if (effects & SM_EFFECT_MSG_PLAYBACK_COMPLETE) {
+        json = cJSON_CreateObject();
+        cJSON_AddStringToObject(json, "type", "playback_complete");
+    }
+
+    if (json) {
+        // ws_send_json takes ownership of the JSON object
+        // It will delete the object whether it succeeds or fails
+        if (!ws_send_json(json)) {
+            ESP_LOGE("STATE", "Failed to send state change to server");
+        }
+    }
+}
+
+/**
+ * @brief Executor for transition side effects
+ *
+ * Applies I2S reconfiguration, protocol messages, earcons and LED updates
+ * in the order transitions were accepted, and records the per-edge latency from
+ * the set_state() request until the effects have completed. Earcons from
+ * earcon_request() play only while no transition is queued.
+ *
+ * @param pvParameters Task parameters (unused)
+ */
+void state_effect_task(void *pvParameters) {
+    state_effect_t effect;
+    int earcon;
+
+    // Set before the first queue check, so a wake-up cannot be missed
+    state_effect_task_handle = xTaskGetCurrentTaskHandle();
+
+    while (1) {
+        if (xQueueReceive(q_state_effects, &effect, 0) != pdTRUE) {
+            if (xQueueReceive(q_earcons, &earcon, 0) == pdTRUE) {
+                play_earcon(earcon);
+            } else {
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
             }
+            continue;
         }
-        
-        // Send appropriate protocol message to server based on state transition
-        cJSON *json = NULL;
-        
-        // Only send specific protocol messages, not generic "state" updates
-        // The server expects: client_on, recording_started, recording_stopped,
-        // ready_for_playback, playback_complete, image_captured, ping
-        
-        if (new_state == CLIENT_STATE_IDLE && old_state == CLIENT_STATE_CONNECTED) {
-            // Initial transition to idle after connection
-            json = cJSON_CreateObject();
-            cJSON_AddStringToObject(json, "type", "client_on");
-        } else if (new_state == CLIENT_STATE_RECORDING && old_state != CLIENT_STATE_RECORDING) {
-            // Starting recording
-            json = cJSON_CreateObject();
-            cJSON_AddStringToObject(json, "type", "recording_started");
-            cJSON_AddNumberToObject(json, "ts", (double)(esp_timer_get_time() / 1000));
-        } else if (old_state == CLIENT_STATE_RECORDING && new_state != CLIENT_STATE_RECORDING) {
-            // Stopped recording
-            json = cJSON_CreateObject();
-            cJSON_AddStringToObject(json, "type", "recording_stopped");
-        } else if (new_state == CLIENT_STATE_PROCESSING && old_state == CLIENT_STATE_RECORDING) {
-            // Already sent recording_stopped above
-        } else if (new_state == CLIENT_STATE_PLAYING) {
-            // Ready to receive playback audio
-            json = cJSON_CreateObject();
-            cJSON_AddStringToObject(json, "type", "ready_for_playback");
-        } else if (old_state == CLIENT_STATE_PLAYING && new_state == CLIENT_STATE_IDLE) {
-            // Playback completed
-            json = cJSON_CreateObject();
-            cJSON_AddStringToObject(json, "type", "playback_complete");
+
+        // Withdraw the old state first so its waiters park before I2S is torn down
+        if (state_events) {
+            xEventGroupClearBits(state_events, STATE_BIT(effect.old_state));
         }
-        // Note: Other state changes like CONNECTED, STALLED, SHUTDOWN don't need explicit messages
-        // The WebSocket connection/disconnection events handle those
-        
-        if (json) {
-            // ws_send_json takes ownership of the JSON object
-            // It will delete the object whether it succeeds or fails
-            if (!ws_send_json(json)) {
-                ESP_LOGE("STATE", "Failed to send state change to server");
+
+        if (effect.effects & SM_EFFECT_I2S_RX) {
+            reconfigure_i2s(false);
+        } else if (effect.effects & SM_EFFECT_I2S_TX) {
+            reconfigure_i2s(true);
+        } else if ((effect.effects & SM_EFFECT_I2S_RELEASE) ||
+                   (effect.new_state == CLIENT_STATE_IDLE && wake_word_enabled())) {
+            park_i2s(effect.new_state);
+        }
+
+        if (effect.effects & SM_EFFECT_MSG_MASK) {
+            send_state_message(effect.effects);
+        }
+
+        if (effect.old_state == CLIENT_STATE_PLAYING) {
+            tts_cache_playback_ended();
+        }
+
+        // Waiting tasks see the new state only once its effects (e.g. I2S
+        // mode) are in place. Earcons and the LED do not gate them.
+        publish_state_bits(effect.new_state);
+
+        // Starts the pattern on the esp_timer and returns
+        if (effect.effects & SM_EFFECT_LED) {
+            update_led_pattern();
+        }
+
+        if (effect.effects & SM_EFFECT_EARCON) {
+            play_earcon(effect.earcon);
+        }
+
+        sm_record_latency(effect.old_state, effect.new_state,
+                          (uint32_t)(esp_timer_get_time() - effect.requested_us));
+
+        if (effect.new_state == CLIENT_STATE_SHUTDOWN) {
+            break;
+        }
+    }
+
+    vTaskDelete(NULL);
+}
+
+void log_state_transition_stats(void) {
+    for (int from = 0; from < CLIENT_STATE_COUNT; from++) {
+        for (int to = 0; to < CLIENT_STATE_COUNT; to++) {
+            const sm_edge_stats_t *stats = sm_get_edge_stats(from, to);
+            if (!stats || (stats->count == 0 && stats->rejected == 0)) {
+                continue;
             }
-            // NOTE: json object is already deleted by ws_send_json on failure
-            // Do not call cJSON_Delete(json) here to avoid double-free
+            ESP_LOGI("STATE", "Edge %s -> %s: count=%"PRIu32" avg=%"PRIu32"us max=%"PRIu32"us rejected=%"PRIu32,
+                     state_to_string(from), state_to_string(to), stats->count,
+                     stats->count ? (uint32_t)(stats->total_us / stats->count) : 0,
+                     stats->max_us, stats->rejected);
         }
-        
-        // Update LED pattern
-        update_led_pattern();
-        
-        ESP_LOGI("STATE", "State changed: %s -> %s", 
-                 state_to_string(old_state), state_to_string(new_state));
-        
-        xSemaphoreGive(state_mutex);
     }
 }
 
-const char* state_to_string(client_state_t state) {
-    switch (state) {
-        case CLIENT_STATE_BOOTING: return "BOOTING";
-        case CLIENT_STATE_CONNECTED: return "CONNECTED";
-        case CLIENT_STATE_IDLE: return "IDLE";
-        case CLIENT_STATE_RECORDING: return "RECORDING";
-        case CLIENT_STATE_PROCESSING: return "PROCESSING";
-        case CLIENT_STATE_PLAYING: return "PLAYING";
-        case CLIENT_STATE_CAMERA_CAPTURE: return "CAMERA_CAPTURE";
-        case CLIENT_STATE_STALLED: return "STALLED";
-        case CLIENT_STATE_SHUTDOWN: return "SHUTDOWN";
-        default: return "UNKNOWN";
+// esp_timer driven blink so message handlers don't sleep through the pattern
+static esp_timer_handle_t led_flash_timer = NULL;
+static volatile int led_flash_toggles_left = 0;
+
+static void led_flash_callback(void *arg) {
+    int left = led_flash_toggles_left;
+    if (left <= 0) {
+        esp_timer_stop(led_flash_timer);
+        gpio_set_level(GPIO_LED, 0);
+        return;
+    }
+    // Started on with an odd toggle count, so odd counts turn it off
+    gpio_set_level(GPIO_LED, (left % 2) ? 0 : 1);
+    led_flash_toggles_left = left - 1;
+}
+
+void led_flash_async(int count, uint32_t period_ms) {
+    if (!led_flash_timer) {
+        const esp_timer_create_args_t args = {
+            .callback = led_flash_callback,
+            .name = "led_flash",
+        };
+        if (esp_timer_create(&args, &led_flash_timer) != ESP_OK) {
+            ESP_LOGE("LED", "Failed to create LED flash timer");
+            return;
+        }
     }
+
+    esp_timer_stop(led_flash_timer);  // Restart if a pattern is already running
+    led_flash_toggles_left = count * 2 - 1;
+    gpio_set_level(GPIO_LED, 1);
+    esp_timer_start_periodic(led_flash_timer, (uint64_t)period_ms * 1000);
 }
 
+// Steady level, ending any blink pattern still running
+static void led_steady(int level) {
+    if (led_flash_timer) {
+        esp_timer_stop(led_flash_timer);
+        led_flash_toggles_left = 0;
+    }
+    gpio_set_level(GPIO_LED, level);
+}
+
+// Show the current state on the LED. Blinks run on the esp_timer, so the
+// state effect task is not held up by the pattern.
 void update_led_pattern() {
-    // Update LED based on current state
-    switch (current_state) {
+    switch (get_state()) {
         case CLIENT_STATE_IDLE:
             // Slow blink
-            gpio_set_level(GPIO_LED, 1);
-            vTaskDelay(pdMS_TO_TICKS(100));
-            gpio_set_level(GPIO_LED, 0);
-            vTaskDelay(pdMS_TO_TICKS(900));
+            led_flash_async(1, 100);
             break;
-            
+
         case CLIENT_STATE_RECORDING:
             // Fast blink
-            gpio_set_level(GPIO_LED, 1);
-            vTaskDelay(pdMS_TO_TICKS(100));
-            gpio_set_level(GPIO_LED, 0);
-            vTaskDelay(pdMS_TO_TICKS(100));
+            led_flash_async(2, 100);
             break;
-            
+
         case CLIENT_STATE_PROCESSING:
             // Medium blink
-            gpio_set_level(GPIO_LED, 1);
-            vTaskDelay(pdMS_TO_TICKS(300));
-            gpio_set_level(GPIO_LED, 0);
-            vTaskDelay(pdMS_TO_TICKS(300));
+            led_flash_async(1, 300);
             break;
-            
+
         case CLIENT_STATE_PLAYING:
             // Continuous on
-            gpio_set_level(GPIO_LED, 1);
+            led_steady(1);
             break;
-            
+
+        case CLIENT_STATE_SELF_TEST:
+            // Steady until the report is sent
+            led_steady(1);
+            break;
+
         case CLIENT_STATE_CAMERA_CAPTURE:
             // Triple quick blink
-            for (int i = 0; i < 3; i++) {
-                gpio_set_level(GPIO_LED, 1);
-                vTaskDelay(pdMS_TO_TICKS(50));
-                gpio_set_level(GPIO_LED, 0);
-                vTaskDelay(pdMS_TO_TICKS(50));
-            }
+            led_flash_async(3, 50);
             break;
-            
+
         default:
             // Turn off LED for other states
-            gpio_set_level(GPIO_LED, 0);
+            led_steady(0);
             break;
     }
 }
@@ -266,61 +475,28 @@ bool init_psram_detection() {
     if (psram_available) {
         size_t psram_size = esp_psram_get_size();
         ESP_LOGI("PSRAM", "PSRAM available: %zu bytes", psram_size);
-        pool_size = POOL_COUNT_WITH_PSRAM;
     } else {
         ESP_LOGI("PSRAM", "No PSRAM available, using internal RAM");
-        pool_size = POOL_COUNT_NO_PSRAM;
     }
     return true;
 }
 
-bool init_chunk_pool() {
-    int total_size = pool_size * CHUNK_BYTES;
-    
-    if (psram_available) {
-        // Allocate from PSRAM if available
-        chunk_pool = (uint8_t*)heap_caps_malloc(total_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_DMA);
-        ESP_LOGI("POOL", "Allocated %d bytes chunk pool from PSRAM", total_size);
-    } else {
-        // Allocate from internal RAM with DMA capability
-        chunk_pool = (uint8_t*)heap_caps_malloc(total_size, MALLOC_CAP_DMA);
-        ESP_LOGI("POOL", "Allocated %d bytes chunk pool from internal RAM", total_size);
-    }
-    
-    if (!chunk_pool) {
-        ESP_LOGE("POOL", "Failed to allocate chunk pool");
-        return false;
-    }
-    
-    // Initialize the free chunks queue with pointers to each chunk
-    for (int i = 0; i < pool_size; i++) {
-        uint8_t *chunk_ptr = chunk_pool + (i * CHUNK_BYTES);
-        if (xQueueSend(q_free_chunks, &chunk_ptr, 0) != pdTRUE) {
-            ESP_LOGE("POOL", "Failed to add chunk %d to free queue", i);
-            return false;
-        }
-    }
-    
-    return true;
-}
+// Cut TTS playback short and start recording right away. The server is
+// told first so it stops streaming; recording_started follows from the
+// PLAYING -> RECORDING transition.
+static void barge_in(void) {
+    ESP_LOGI("BUTTON", "Barge-in - interrupting playback");
+    audio_note_barge_in(esp_timer_get_time());
 
-uint8_t* alloc_chunk() {
-    uint8_t *buf = NULL;
-    if (xQueueReceive(q_free_chunks, &buf, 0) != pdTRUE) {
-        // No free chunks available
-        ESP_LOGW("ALLOC", "No free chunks available in pool");
-        return NULL;
-    }
-    return buf;
-}
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddStringToObject(json, "type", "tts_cancel");
+    cJSON_AddStringToObject(json, "session", SESSION_ID);
+    ws_send_json(json);
 
-void free_chunk(uint8_t *buf) {
-    if (buf) {
-        if (xQueueSend(q_free_chunks, &buf, 0) != pdTRUE) {
-            // Queue full, should not happen if pool is properly managed
-            ESP_LOGE("FREE", "Failed to return chunk to pool");
-        }
-    }
+    // Leave PLAYING before flushing so the playback task drops, rather
+    // than plays, anything it dequeues in between
+    set_state(CLIENT_STATE_RECORDING);
+    audio_playback_flush();
 }
 
 void button_task(void *pvParameters) {
@@ -328,10 +504,27 @@ void button_task(void *pvParameters) {
     int press_count = 0;
     TickType_t long_press_start = 0;
     bool long_press_detected = false;
+    bool barged_in = false;  // This press interrupted playback; not counted on release
     
     TickType_t last_debounce_time = xTaskGetTickCount();
+
+    // Held through boot: run the loopback self-test once the device is
+    // IDLE. Wait for the release so the hold is not taken as a long press.
+    bool boot_selftest = gpio_get_level(GPIO_BUTTON) == 0;
+    if (boot_selftest) {
+        ESP_LOGI("BUTTON", "Button held at boot - self-test armed");
+        while (gpio_get_level(GPIO_BUTTON) == 0) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+        last_debounce_time = xTaskGetTickCount();
+    }
     
-    while (current_state != CLIENT_STATE_SHUTDOWN) {
+    while (get_state() != CLIENT_STATE_SHUTDOWN) {
+        if (boot_selftest && get_state() == CLIENT_STATE_IDLE) {
+            boot_selftest = false;
+            selftest_request(SELFTEST_LOOPBACK, SELFTEST_DEFAULT_DURATION_MS);
+        }
+
         TickType_t current_time = xTaskGetTickCount();
         
         // Read button state (active LOW - button press pulls to GND)
@@ -346,6 +539,13 @@ void button_task(void *pvParameters) {
                 
                 if (long_press_start == 0) {
                     long_press_start = current_time;
+
+                    // Act on the press itself rather than the release
+                    if (get_state() == CLIENT_STATE_PLAYING &&
+                        session_feature_enabled(SESSION_FEATURE_BARGE_IN)) {
+                        barge_in();
+                        barged_in = true;
+                    }
                 }
                 
                 // Check for long press
@@ -353,46 +553,35 @@ void button_task(void *pvParameters) {
                     long_press_detected = true;
                     ESP_LOGI("BUTTON", "Long press detected - initiating shutdown");
                     
-                    if (xSemaphoreTake(state_mutex, portMAX_DELAY) == pdTRUE) {
-                        if (current_state == CLIENT_STATE_RECORDING) {
-                            // Stop recording before shutdown
-                            set_state(CLIENT_STATE_PROCESSING);
-                        }
-                        set_state(CLIENT_STATE_SHUTDOWN);
-                        xSemaphoreGive(state_mutex);
-                    }
+                    // RECORDING -> SHUTDOWN stops the recording via the transition table
+                    set_state(CLIENT_STATE_SHUTDOWN);
                 }
             }
         } else {
             // Button released
-            if (long_press_start > 0 && !long_press_detected) {
+            if (long_press_start > 0 && !long_press_detected && !barged_in) {
                 // Valid short press
                 if ((current_time - last_debounce_time) > pdMS_TO_TICKS(DEBOUNCE_MS)) {
                     last_debounce_time = current_time;
                     
-                    // Check for double press
-                    if (press_count == 0) {
+                    // Count presses that follow each other within the window
+                    if (press_count > 0 &&
+                        (current_time - last_press_time) < pdMS_TO_TICKS(DOUBLE_PRESS_WINDOW_MS)) {
+                        press_count++;
+                    } else {
                         press_count = 1;
-                        last_press_time = current_time;
-                    } else if (press_count == 1) {
-                        if ((current_time - last_press_time) < pdMS_TO_TICKS(DOUBLE_PRESS_WINDOW_MS)) {
-                            // Double press detected - camera capture
-                            press_count = 0;
-                            last_press_time = 0;
-                            
-                            if (current_state == CLIENT_STATE_IDLE) {
-                                set_state(CLIENT_STATE_CAMERA_CAPTURE);
-                                if (camera_task_handle) {
-                                    xTaskNotifyGive(camera_task_handle);  // Wake up camera task
-                                }
-                            } else {
-                                // Send reject if busy
-                                send_reject_message("busy", state_to_string(current_state));
-                            }
-                        } else {
-                            // Single press (not double)
-                            press_count = 1;
-                            last_press_time = current_time;
+                    }
+                    last_press_time = current_time;
+
+                    if (press_count == 3) {
+                        // Triple press - replay the last response from the cache
+                        press_count = 0;
+                        last_press_time = 0;
+
+                        if (get_state() != CLIENT_STATE_IDLE) {
+                            send_reject_message("busy", state_to_string(get_state()));
+                        } else if (!tts_cache_play(TTS_CACHE_LATEST)) {
+                            led_flash_async(2, 100);  // Nothing cached
                         }
                     }
                 }
@@ -400,20 +589,41 @@ void button_task(void *pvParameters) {
             
             long_press_start = 0;
             long_press_detected = false;
+            barged_in = false;
         }
         
+        // Double press once no third press followed - camera capture
+        if (press_count == 2 &&
+            (current_time - last_press_time) >= pdMS_TO_TICKS(DOUBLE_PRESS_WINDOW_MS)) {
+            press_count = 0;
+            last_press_time = 0;
+
+            if (get_state() == CLIENT_STATE_IDLE) {
+                set_state(CLIENT_STATE_CAMERA_CAPTURE);
+                if (camera_task_handle) {
+                    xTaskNotifyGive(camera_task_handle);  // Wake up camera task
+                }
+            } else {
+                // Send reject if busy
+                send_reject_message("busy", state_to_string(get_state()));
+            }
+        }
+
         // Handle single press after timeout window
         if (press_count == 1 && 
             (current_time - last_press_time) >= pdMS_TO_TICKS(DOUBLE_PRESS_WINDOW_MS)) {
             
             // Execute single press action
-            if (current_state == CLIENT_STATE_IDLE) {
+            if (get_state() == CLIENT_STATE_IDLE && audio_recording_ending()) {
+                // The last recording's audio is still going out
+                send_reject_message("uploading", state_to_string(get_state()));
+            } else if (get_state() == CLIENT_STATE_IDLE) {
                 set_state(CLIENT_STATE_RECORDING);
-            } else if (current_state == CLIENT_STATE_RECORDING) {
+            } else if (get_state() == CLIENT_STATE_RECORDING) {
                 set_state(CLIENT_STATE_PROCESSING);
             } else {
                 // Send reject if busy
-                send_reject_message("busy", state_to_string(current_state));
+                send_reject_message("busy", state_to_string(get_state()));
             }
             
             press_count = 0;
@@ -443,52 +653,33 @@ void send_reject_message(const char* reason, const char* current_state_str) {
     // NOTE: json object is now owned by the WebSocket system on success
     // Do not call cJSON_Delete(json) here to avoid premature deletion
     
-    // Visual/audible feedback for reject
-    for (int i = 0; i < 3; i++) {
-        gpio_set_level(GPIO_LED, 1);
-        vTaskDelay(pdMS_TO_TICKS(100));
-        gpio_set_level(GPIO_LED, 0);
-        vTaskDelay(pdMS_TO_TICKS(100));
-    }
+    // Visual feedback for reject, without holding up the caller (the
+    // button task or the WebSocket dispatcher)
+    led_flash_async(3, 100);
 }
 
 void state_manager_task(void *pvParameters) {
-    while (current_state != CLIENT_STATE_SHUTDOWN) {
-        // Monitor state changes and handle any special management tasks
-        switch (current_state) {
-            case CLIENT_STATE_SHUTDOWN:
-                // Handle shutdown sequence
-                ESP_LOGI("STATE", "Shutdown sequence initiated");
-                // Additional shutdown steps can be added here
-                break;
-                
-            case CLIENT_STATE_RECORDING:
-                // Ensure audio capture is active
-                break;
-                
-            case CLIENT_STATE_PLAYING:
-                // Ensure audio playback is active
-                break;
-                
-            default:
-                break;
-        }
-        
-        vTaskDelay(pdMS_TO_TICKS(100));
+    // Block until shutdown instead of polling the state
+    while (!(wait_for_state(STATE_BIT(CLIENT_STATE_SHUTDOWN), portMAX_DELAY) & STATE_BIT(CLIENT_STATE_SHUTDOWN))) {
+        record_task_wakeup(WAKEUP_STATE_MANAGER);
     }
-    
+    record_task_wakeup(WAKEUP_STATE_MANAGER);
+
+    ESP_LOGI("STATE", "Shutdown sequence initiated");
+
     // Clean up and shutdown
+    log_state_transition_stats();
+    log_task_wakeup_stats();
+    log_perf_counters();
+    log_chunk_pool_stats();
     cleanup_resources();
     ESP_LOGI("STATE", "Firmware shutdown complete");
     vTaskDelete(NULL);
 }
 
 void cleanup_resources() {
-    // Free chunk pool
-    if (chunk_pool) {
-        heap_caps_free(chunk_pool);
-        chunk_pool = NULL;
-    }
+    // The chunk pool is static storage, only drop the reference
+    chunk_pool = NULL;
     
     // Clean up queues
     if (q_free_chunks) {
@@ -515,12 +706,6 @@ void cleanup_resources() {
     // Clean up WebSocket client
     cleanup_websocket();
     
-    // Delete mutex
-    if (state_mutex) {
-        vSemaphoreDelete(state_mutex);
-        state_mutex = NULL;
-    }
-    
     // Uninstall I2S driver only if it was initialized
     if (audio_i2s_initialized) {
         i2s_driver_uninstall(I2S_PORT);
@@ -0,0 +1,229 @@
+/*
+ * HotPin Firmware - Concurrent Server Probe
+ *
+ * BSD sockets only: see subnet_probe.h.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "subnet_probe.h"
+
+typedef enum {
+    SLOT_FREE = 0,
+    SLOT_CONNECTING,
+    SLOT_READING,
+} slot_state_t;
+
+typedef struct {
+    int fd;
+    int index;                      // Into addrs
+    uint8_t state;                  // slot_state_t
+    uint32_t deadline_ms;
+    uint16_t len;
+    char response[PROBE_RESPONSE_MAX + 1];
+} probe_slot_t;
+
+static uint32_t probe_now_ms(void) {
+#ifdef ESP_PLATFORM
+    return (uint32_t)(esp_timer_get_time() / 1000);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+#endif
+}
+
+bool probe_response_is_hotpin(const char *response) {
+    if (strncmp(response, "HTTP/1.", 7) != 0 || strncmp(response + 8, " 200", 4) != 0) {
+        return false;
+    }
+    const char *body = strstr(response, "\r\n\r\n");
+    return body && (strstr(body, "\"service\":\"hotpin\"") || strstr(body, "groq-whisper"));
+}
+
+static void close_slot(probe_slot_t *slot) {
+    if (slot->state != SLOT_FREE) {
+        close(slot->fd);
+        slot->state = SLOT_FREE;
+    }
+}
+
+static bool send_request(probe_slot_t *slot, uint32_t addr, const probe_config_t *config) {
+    char host[16];
+    char request[96];
+    struct in_addr in = { .s_addr = addr };
+    inet_ntop(AF_INET, &in, host, sizeof(host));
+    int len = snprintf(request, sizeof(request),
+                       "GET /health HTTP/1.0\r\nHost: %s:%u\r\nConnection: close\r\n\r\n", host, config->port);
+    if (send(slot->fd, request, len, 0) != len) {
+        return false;
+    }
+    slot->state = SLOT_READING;
+    slot->len = 0;
+    slot->deadline_ms = probe_now_ms() + config->response_timeout_ms;
+    return true;
+}
+
+// Start a connect in a free slot. Returns 1 if started, 0 if it failed at
+// once (refused), -1 if no socket was available
+static int start_slot(probe_slot_t *slot, int index, uint32_t addr, const probe_config_t *config) {
+    slot->fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (slot->fd < 0) {
+        return -1;
+    }
+    fcntl(slot->fd, F_SETFL, fcntl(slot->fd, F_GETFL, 0) | O_NONBLOCK);
+
+    struct sockaddr_in sa = {
+        .sin_family = AF_INET,
+        .sin_port = htons(config->port),
+        .sin_addr.s_addr = addr,
+    };
+    slot->index = index;
+    slot->state = SLOT_CONNECTING;
+    slot->deadline_ms = probe_now_ms() + config->connect_timeout_ms;
+    if (connect(slot->fd, (struct sockaddr*)&sa, sizeof(sa)) == 0) {
+        if (send_request(slot, addr, config)) {
+            return 1;
+        }
+    } else if (errno == EINPROGRESS) {
+        return 1;
+    }
+    close_slot(slot);
+    return 0;
+}
+
+// Read what has arrived. Returns 1 for a HotPin server, -1 when the answer
+// is complete and is not one, 0 to keep reading
+static int read_slot(probe_slot_t *slot) {
+    int n = recv(slot->fd, slot->response + slot->len, PROBE_RESPONSE_MAX - slot->len, 0);
+    if (n < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    }
+    slot->len += n;
+    slot->response[slot->len] = '\0';
+    if (probe_response_is_hotpin(slot->response)) {
+        return 1;
+    }
+    // Closed, or the signature would have been in what we have by now
+    return (n == 0 || slot->len == PROBE_RESPONSE_MAX) ? -1 : 0;
+}
+
+int probe_hotpin_servers(const uint32_t *addrs, int count, const probe_config_t *config, probe_stats_t *stats) {
+    probe_stats_t local;
+    if (!stats) {
+        stats = &local;
+    }
+    memset(stats, 0, sizeof(*stats));
+    int parallel = config->parallel;
+    if (parallel < 1) {
+        parallel = 1;
+    } else if (parallel > PROBE_MAX_PARALLEL) {
+        parallel = PROBE_MAX_PARALLEL;
+    }
+
+    probe_slot_t *slots = calloc(parallel, sizeof(probe_slot_t));
+    if (!slots) {
+        return -1;
+    }
+
+    uint32_t start_ms = probe_now_ms();
+    int next = 0;
+    int found = -1;
+    while (found < 0) {
+        // Keep every slot busy while there are addresses left; when the
+        // stack is out of sockets, carry on with the ones open
+        int open = 0;
+        bool sockets_left = true;
+        for (int i = 0; i < parallel; i++) {
+            while (slots[i].state == SLOT_FREE && next < count && sockets_left) {
+                int started = start_slot(&slots[i], next, addrs[next], config);
+                if (started < 0) {
+                    sockets_left = false;
+                    break;
+                }
+                stats->probed++;
+                stats->refused += (started == 0);
+                next++;
+            }
+            open += slots[i].state != SLOT_FREE;
+        }
+        if (open == 0) {
+            break;  // Nothing left to wait for
+        }
+        if ((uint32_t)open > stats->max_open) {
+            stats->max_open = open;
+        }
+
+        fd_set readable, writable;
+        FD_ZERO(&readable);
+        FD_ZERO(&writable);
+        int max_fd = -1;
+        uint32_t now = probe_now_ms();
+        uint32_t wait_ms = UINT32_MAX;
+        for (int i = 0; i < parallel; i++) {
+            probe_slot_t *slot = &slots[i];
+            if (slot->state == SLOT_FREE) {
+                continue;
+            }
+            FD_SET(slot->fd, slot->state == SLOT_CONNECTING ? &writable : &readable);
+            max_fd = slot->fd > max_fd ? slot->fd : max_fd;
+            int32_t left = (int32_t)(slot->deadline_ms - now);
+            uint32_t slot_wait = left > 0 ? (uint32_t)left : 0;
+            wait_ms = slot_wait < wait_ms ? slot_wait : wait_ms;
+        }
+        struct timeval timeout = { .tv_sec = wait_ms / 1000, .tv_usec = (wait_ms % 1000) * 1000 };
+        if (select(max_fd + 1, &readable, &writable, NULL, &timeout) < 0 && errno != EINTR) {
+            break;
+        }
+
+        now = probe_now_ms();
+        for (int i = 0; i < parallel && found < 0; i++) {
+            probe_slot_t *slot = &slots[i];
+            if (slot->state == SLOT_CONNECTING && FD_ISSET(slot->fd, &writable)) {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(slot->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                if (err != 0 || !send_request(slot, addrs[slot->index], config)) {
+                    // Refused, or the host is unreachable
+                    stats->refused += (err == ECONNREFUSED);
+                    stats->unreachable += (err != ECONNREFUSED);
+                    close_slot(slot);
+                }
+            } else if (slot->state == SLOT_READING && FD_ISSET(slot->fd, &readable)) {
+                int result = read_slot(slot);
+                if (result > 0) {
+                    found = slot->index;
+                } else if (result < 0) {
+                    stats->not_hotpin++;
+                    close_slot(slot);
+                }
+            } else if (slot->state != SLOT_FREE && (int32_t)(slot->deadline_ms - now) <= 0) {
+                stats->unreachable++;
+                close_slot(slot);
+            }
+        }
+    }
+
+    for (int i = 0; i < parallel; i++) {
+        close_slot(&slots[i]);
+    }
+    free(slots);
+    stats->elapsed_ms = probe_now_ms() - start_ms;
+    return found;
+}
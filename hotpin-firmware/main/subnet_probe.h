@@ -0,0 +1,70 @@
+/*
+ * HotPin Firmware - Concurrent Server Probe
+ *
+ * Looks for a HotPin server among a list of addresses by sending
+ * "GET /health" to many of them at once. Up to `parallel` non-blocking
+ * sockets are open at a time and multiplexed with select(); as soon as one
+ * finishes, the next address takes its place. An address that neither
+ * connects within connect_timeout_ms nor is refused (no host there) costs
+ * one slot for that long, so a /24 takes about
+ * 254 / parallel * connect_timeout_ms.
+ *
+ * A server counts as HotPin if /health answers 200 with "service":"hotpin"
+ * in the body (or "groq-whisper", from servers that predate the field).
+ *
+ * Only BSD socket calls are used: the same code runs on lwIP in the
+ * firmware (network_discovery.c) and on the host (tools/probe_sim.c).
+ * Memory is one slot per parallel socket, allocated for the scan. Not
+ * reentrant.
+ */
+
+#ifndef SUBNET_PROBE_H
+#define SUBNET_PROBE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PROBE_MAX_PARALLEL      16
+#define PROBE_RESPONSE_MAX      384     // Status line, headers and the start of the body
+
+typedef struct {
+    uint16_t port;
+    uint8_t parallel;                   // Sockets open at once, 1..PROBE_MAX_PARALLEL
+    uint32_t connect_timeout_ms;
+    uint32_t response_timeout_ms;       // From connected to a complete answer
+} probe_config_t;
+
+typedef struct {
+    uint32_t probed;                    // Addresses a connect was started for
+    uint32_t refused;                   // Host up, nothing on the port
+    uint32_t unreachable;               // No answer in time, or no route to the host
+    uint32_t not_hotpin;                // Answered, but not a HotPin server
+    uint32_t max_open;                  // Most sockets open at once
+    uint32_t elapsed_ms;
+} probe_stats_t;
+
+/**
+ * @brief Probe addresses in order until one is a HotPin server
+ *
+ * Earlier addresses are started first, so the likeliest go at the front.
+ *
+ * @param addrs IPv4 addresses in network byte order (in_addr.s_addr)
+ * @param stats Filled in if not NULL
+ * @return Index of the first HotPin server found, or -1
+ */
+int probe_hotpin_servers(const uint32_t *addrs, int count, const probe_config_t *config, probe_stats_t *stats);
+
+/**
+ * @brief Check an HTTP response from /health for the HotPin signature
+ */
+bool probe_response_is_hotpin(const char *response);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SUBNET_PROBE_H */
@@ -0,0 +1,114 @@
+/*
+ * HotPin Firmware - Task Scheduling Profile
+ *
+ * "default" keeps the original layout: every task unpinned at priority 5
+ * (camera at 4), sharing both cores with the Wi-Fi stack.
+ *
+ * "tuned" keeps the I2S tasks away from networking: capture, playback and
+ * the state effect executor (which reconfigures I2S) run on the APP CPU at
+ * elevated priority, while everything that talks to lwIP runs on the PRO
+ * CPU next to the Wi-Fi task (pinned to core 0 by CONFIG_ESP_WIFI_TASK_PINNED_TO_CORE_0).
+ */
+
+#include "main.h"
+#include "task_profile.h"
+#include "telemetry.h"
+#include "memory_plan.h"
+#include "wake_word.h"
+#include "diagnostics.h"
+
+#if CONFIG_HOTPIN_SCHED_PROFILE_TUNED
+
+#define WS_CLIENT_TASK_PRIORITY 6
+
+static const task_spec_t profile_tasks[] = {
+    { state_manager_task,     "state_manager",     TASK_STACK_SIZE_BUTTON,         3,  APP_CPU_NUM },
+    { state_effect_task,      "state_effect",      TASK_STACK_SIZE_STATE_EFFECT,   8,  APP_CPU_NUM },
+    { button_task,            "button",            TASK_STACK_SIZE_BUTTON,         6,  APP_CPU_NUM },
+    { websocket_task,         "websocket",         TASK_STACK_SIZE_WS,             5,  PRO_CPU_NUM },
+    { websocket_message_task, "websocket_message", TASK_STACK_SIZE_WS_MESSAGE,     6,  PRO_CPU_NUM },
+    { ws_dispatch_task,       "ws_dispatch",       TASK_STACK_SIZE_WS_DISPATCH,    6,  PRO_CPU_NUM },
+    { audio_capture_task,     "audio_capture",     TASK_STACK_SIZE_AUDIO_CAPTURE,  12, APP_CPU_NUM },
+    { audio_send_task,        "audio_send",        TASK_STACK_SIZE_AUDIO_SEND,     7,  PRO_CPU_NUM },
+    { audio_playback_task,    "audio_playback",    TASK_STACK_SIZE_AUDIO_PLAYBACK, 12, APP_CPU_NUM },
+    { camera_task,            "camera",            TASK_STACK_SIZE_CAMERA,         4,  PRO_CPU_NUM },
+    { telemetry_task,         "telemetry",         TASK_STACK_SIZE_TELEMETRY,      2,  PRO_CPU_NUM },
+    { wake_word_task,         "wake_word",         TASK_STACK_SIZE_WAKE_WORD,      4,  APP_CPU_NUM },
+    { selftest_task,          "selftest",          TASK_STACK_SIZE_SELFTEST,       11, APP_CPU_NUM },
+};
+
+#else  // CONFIG_HOTPIN_SCHED_PROFILE_DEFAULT
+
+#define WS_CLIENT_TASK_PRIORITY 5
+
+static const task_spec_t profile_tasks[] = {
+    { state_manager_task,     "state_manager",     TASK_STACK_SIZE_BUTTON,         5, tskNO_AFFINITY },
+    { state_effect_task,      "state_effect",      TASK_STACK_SIZE_STATE_EFFECT,   5, tskNO_AFFINITY },
+    { button_task,            "button",            TASK_STACK_SIZE_BUTTON,         5, tskNO_AFFINITY },
+    { websocket_task,         "websocket",         TASK_STACK_SIZE_WS,             5, tskNO_AFFINITY },
+    { websocket_message_task, "websocket_message", TASK_STACK_SIZE_WS_MESSAGE,     5, tskNO_AFFINITY },
+    { ws_dispatch_task,       "ws_dispatch",       TASK_STACK_SIZE_WS_DISPATCH,    5, tskNO_AFFINITY },
+    { audio_capture_task,     "audio_capture",     TASK_STACK_SIZE_AUDIO_CAPTURE,  5, tskNO_AFFINITY },
+    { audio_send_task,        "audio_send",        TASK_STACK_SIZE_AUDIO_SEND,     5, tskNO_AFFINITY },
+    { audio_playback_task,    "audio_playback",    TASK_STACK_SIZE_AUDIO_PLAYBACK, 5, tskNO_AFFINITY },
+    { camera_task,            "camera",            TASK_STACK_SIZE_CAMERA,         4, tskNO_AFFINITY },
+    { telemetry_task,         "telemetry",         TASK_STACK_SIZE_TELEMETRY,      2, tskNO_AFFINITY },
+    // Not part of the original layout; kept off the Wi-Fi core in both profiles
+    { wake_word_task,         "wake_word",         TASK_STACK_SIZE_WAKE_WORD,      4, APP_CPU_NUM },
+    { selftest_task,          "selftest",          TASK_STACK_SIZE_SELFTEST,       5, tskNO_AFFINITY },
+};
+
+#endif
+
+_Static_assert(sizeof(profile_tasks) / sizeof(profile_tasks[0]) == MEM_PLAN_TASK_COUNT,
+               "MEM_PLAN_TASK_COUNT must match the scheduling profile tables");
+
+// Task stacks and TCBs are carved from one static arena in table order
+static StackType_t task_stack_arena[MEM_PLAN_TASK_STACK_BYTES] __attribute__((aligned(16)));
+static StaticTask_t task_tcbs[MEM_PLAN_TASK_COUNT];
+
+const char* task_profile_name(void) {
+#if CONFIG_HOTPIN_SCHED_PROFILE_TUNED
+    return "tuned";
+#else
+    return "default";
+#endif
+}
+
+int task_profile_ws_client_priority(void) {
+    return WS_CLIENT_TASK_PRIORITY;
+}
+
+bool start_profile_tasks(void) {
+    bool all_created = true;
+    size_t stack_offset = 0;
+
+    ESP_LOGI("SCHED", "Creating tasks with '%s' scheduling profile", task_profile_name());
+
+    for (size_t i = 0; i < sizeof(profile_tasks) / sizeof(profile_tasks[0]); i++) {
+        const task_spec_t *spec = &profile_tasks[i];
+        if (stack_offset + spec->stack_size > sizeof(task_stack_arena)) {
+            ESP_LOGE("SCHED", "Stack arena exhausted at task %s, update MEM_PLAN_TASK_STACK_BYTES", spec->name);
+            all_created = false;
+            break;
+        }
+
+        TaskHandle_t handle = xTaskCreateStaticPinnedToCore(spec->fn, spec->name, spec->stack_size, NULL,
+                                                            spec->priority, &task_stack_arena[stack_offset],
+                                                            &task_tcbs[i], spec->core);
+        stack_offset += spec->stack_size;
+        if (!handle) {
+            ESP_LOGE("SCHED", "Failed to create task %s", spec->name);
+            all_created = false;
+            continue;
+        }
+
+        if (spec->core == tskNO_AFFINITY) {
+            ESP_LOGI("SCHED", "  %-18s prio %2u  core any", spec->name, (unsigned)spec->priority);
+        } else {
+            ESP_LOGI("SCHED", "  %-18s prio %2u  core %d", spec->name, (unsigned)spec->priority, (int)spec->core);
+        }
+    }
+
+    return all_created;
+}
@@ -0,0 +1,51 @@
+/*
+ * HotPin Firmware - Task Scheduling Profile
+ *
+ * Core affinity, priority and stack size of every firmware task, declared
+ * in one table per profile. The profile is chosen with
+ * CONFIG_HOTPIN_SCHED_PROFILE_* in menuconfig.
+ */
+
+#ifndef TASK_PROFILE_H
+#define TASK_PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    TaskFunction_t fn;
+    const char *name;
+    uint32_t stack_size;
+    UBaseType_t priority;
+    BaseType_t core;        // PRO_CPU_NUM, APP_CPU_NUM or tskNO_AFFINITY
+} task_spec_t;
+
+/**
+ * @brief Create all firmware tasks as declared by the active profile
+ *
+ * @return true if every task was created, false otherwise
+ */
+bool start_profile_tasks(void);
+
+/**
+ * @brief Name of the active scheduling profile ("default" or "tuned")
+ */
+const char* task_profile_name(void);
+
+/**
+ * @brief Priority the profile assigns to the esp_websocket_client task
+ */
+int task_profile_ws_client_priority(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TASK_PROFILE_H */
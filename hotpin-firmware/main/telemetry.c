@@ -0,0 +1,292 @@
+/*
+ * HotPin Firmware - Runtime Telemetry
+ */
+
+#include "main.h"
+#include "task_profile.h"
+#include "telemetry.h"
+#include "chunk_pool.h"
+#include "audio_spill.h"
+#include "dictation.h"
+#include "tts_cache.h"
+#include "wake_word.h"
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+
+typedef struct {
+    TaskHandle_t handle;
+    configRUN_TIME_COUNTER_TYPE run_time;
+} task_run_time_t;
+
+static TaskStatus_t status_buf[TELEMETRY_MAX_TASKS];
+static task_run_time_t prev_run_time[TELEMETRY_MAX_TASKS];
+static int prev_count = 0;
+static configRUN_TIME_COUNTER_TYPE prev_total = 0;
+
+static configRUN_TIME_COUNTER_TYPE previous_run_time(TaskHandle_t handle, bool *found) {
+    for (int i = 0; i < prev_count; i++) {
+        if (prev_run_time[i].handle == handle) {
+            *found = true;
+            return prev_run_time[i].run_time;
+        }
+    }
+    *found = false;
+    return 0;
+}
+
+bool telemetry_sample_cpu(telemetry_cpu_sample_t *sample) {
+    configRUN_TIME_COUNTER_TYPE total = 0;
+    UBaseType_t count = uxTaskGetSystemState(status_buf, TELEMETRY_MAX_TASKS, &total);
+    if (count == 0) {
+        ESP_LOGW("TELEMETRY", "More than %d tasks, CPU sample skipped", TELEMETRY_MAX_TASKS);
+        return false;
+    }
+
+    // The run-time counter is esp_timer based, so the window is the same
+    // on both cores and each task's delta is its share of one core
+    configRUN_TIME_COUNTER_TYPE window = total - prev_total;
+    bool have_baseline = prev_count > 0 && window > 0;
+
+    if (have_baseline && sample) {
+        memset(sample, 0, sizeof(*sample));
+        sample->window_ms = (uint32_t)(window / 1000);
+
+        for (UBaseType_t i = 0; i < count; i++) {
+            bool found = false;
+            configRUN_TIME_COUNTER_TYPE before = previous_run_time(status_buf[i].xHandle, &found);
+            if (!found) {
+                continue;  // Task created during this window
+            }
+
+            uint32_t permille = (uint32_t)(((uint64_t)(status_buf[i].ulRunTimeCounter - before) * 1000) / window);
+            BaseType_t core = xTaskGetCoreID(status_buf[i].xHandle);
+
+            // Idle task time is the inverse of the core's load
+            if (strncmp(status_buf[i].pcTaskName, "IDLE", 4) == 0 && core >= 0 && core < 2) {
+                sample->core_load_permille[core] = permille > 1000 ? 0 : 1000 - permille;
+                continue;
+            }
+
+            telemetry_task_load_t *load = &sample->tasks[sample->task_count++];
+            strlcpy(load->name, status_buf[i].pcTaskName, sizeof(load->name));
+            load->core = (core == tskNO_AFFINITY) ? -1 : (int)core;
+            load->priority = (unsigned)status_buf[i].uxCurrentPriority;
+            load->cpu_permille = permille;
+        }
+    }
+
+    for (UBaseType_t i = 0; i < count; i++) {
+        prev_run_time[i].handle = status_buf[i].xHandle;
+        prev_run_time[i].run_time = status_buf[i].ulRunTimeCounter;
+    }
+    prev_count = (int)count;
+    prev_total = total;
+
+    return have_baseline;
+}
+
+#else
+
+bool telemetry_sample_cpu(telemetry_cpu_sample_t *sample) {
+    (void)sample;
+    return false;
+}
+
+#endif
+
+static cJSON* build_telemetry_message(void) {
+    cJSON *json = cJSON_CreateObject();
+    if (!json) {
+        return NULL;
+    }
+
+    cJSON_AddStringToObject(json, "type", "telemetry");
+    cJSON_AddStringToObject(json, "session", SESSION_ID);
+    cJSON_AddStringToObject(json, "profile", task_profile_name());
+#if CONFIG_HOTPIN_PERF_PROFILE
+    cJSON_AddStringToObject(json, "build", "performance");
+#else
+    cJSON_AddStringToObject(json, "build", "default");
+#endif
+    cJSON_AddStringToObject(json, "state", state_to_string(get_state()));
+    cJSON_AddNumberToObject(json, "uptime_ms", (double)(esp_timer_get_time() / 1000));
+    cJSON_AddNumberToObject(json, "free_heap", esp_get_free_heap_size());
+
+    static telemetry_cpu_sample_t cpu;
+    if (telemetry_sample_cpu(&cpu)) {
+        cJSON *cpu_json = cJSON_AddObjectToObject(json, "cpu");
+        cJSON_AddNumberToObject(cpu_json, "window_ms", cpu.window_ms);
+        cJSON *cores = cJSON_AddArrayToObject(cpu_json, "core_load_pct");
+        for (int core = 0; core < 2; core++) {
+            cJSON_AddItemToArray(cores, cJSON_CreateNumber(cpu.core_load_permille[core] / 10.0));
+        }
+        cJSON *tasks = cJSON_AddArrayToObject(cpu_json, "tasks");
+        for (int i = 0; i < cpu.task_count; i++) {
+            cJSON *task = cJSON_CreateObject();
+            cJSON_AddStringToObject(task, "name", cpu.tasks[i].name);
+            cJSON_AddNumberToObject(task, "core", cpu.tasks[i].core);
+            cJSON_AddNumberToObject(task, "prio", cpu.tasks[i].priority);
+            cJSON_AddNumberToObject(task, "cpu_pct", cpu.tasks[i].cpu_permille / 10.0);
+            cJSON_AddItemToArray(tasks, task);
+        }
+    }
+
+    audio_timing_stats_t audio;
+    get_audio_timing_stats(&audio);
+    cJSON *audio_json = cJSON_AddObjectToObject(json, "audio");
+    cJSON_AddNumberToObject(audio_json, "capture_chunks", audio.capture_chunks);
+    cJSON_AddNumberToObject(audio_json, "capture_jitter_avg_us",
+                            audio.capture_intervals ? (double)(audio.capture_jitter_total_us / audio.capture_intervals) : 0);
+    cJSON_AddNumberToObject(audio_json, "capture_jitter_max_us", audio.capture_jitter_max_us);
+    cJSON_AddNumberToObject(audio_json, "playback_chunks", audio.playback_chunks);
+    cJSON_AddNumberToObject(audio_json, "playback_underruns", audio.playback_underruns);
+    cJSON_AddNumberToObject(audio_json, "barge_ins", audio.barge_ins);
+    cJSON_AddNumberToObject(audio_json, "barge_in_latency_avg_us",
+                            audio.barge_ins ? (double)(audio.barge_in_total_us / audio.barge_ins) : 0);
+    cJSON_AddNumberToObject(audio_json, "barge_in_latency_max_us", audio.barge_in_max_us);
+    cJSON_AddNumberToObject(audio_json, "uplink_frame_ms", audio.uplink_frame_ms);
+    cJSON_AddNumberToObject(audio_json, "uplink_frame_grows", audio.uplink_frame_grows);
+    cJSON_AddNumberToObject(audio_json, "uplink_frame_shrinks", audio.uplink_frame_shrinks);
+    cJSON_AddNumberToObject(audio_json, "uplink_rtt_us", audio.uplink_rtt_us);
+
+    cJSON *perf_json = cJSON_AddObjectToObject(json, "perf_cycles");
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        perf_counter_t counter;
+        perf_get((perf_counter_id_t)i, &counter);
+        cJSON *entry = cJSON_AddObjectToObject(perf_json, perf_counter_name((perf_counter_id_t)i));
+        cJSON_AddNumberToObject(entry, "n", counter.count);
+        cJSON_AddNumberToObject(entry, "avg", counter.count ? (double)(counter.total_cycles / counter.count) : 0);
+        cJSON_AddNumberToObject(entry, "max", counter.max_cycles);
+    }
+
+    ws_rx_stats_t rx;
+    get_ws_rx_stats(&rx);
+    cJSON *rx_json = cJSON_AddObjectToObject(json, "ws_rx");
+    cJSON_AddNumberToObject(rx_json, "events", rx.events);
+    cJSON_AddNumberToObject(rx_json, "stall_avg_us", rx.events ? (double)(rx.stall_total_us / rx.events) : 0);
+    cJSON_AddNumberToObject(rx_json, "stall_max_us", rx.stall_max_us);
+    cJSON_AddNumberToObject(rx_json, "inbound_drops", rx.inbound_drops);
+    cJSON_AddNumberToObject(rx_json, "dispatch_max_us", rx.dispatch_max_us);
+    cJSON_AddNumberToObject(rx_json, "budget_overruns", rx.budget_overruns);
+    cJSON_AddNumberToObject(rx_json, "playback_drops", rx.playback_drops);
+
+    chunk_pool_stats_t pool;
+    get_chunk_pool_stats(&pool);
+    cJSON *pool_json = cJSON_AddObjectToObject(json, "pool");
+    cJSON_AddNumberToObject(pool_json, "total_chunks", pool.total_chunks);
+    cJSON_AddNumberToObject(pool_json, "free_chunks", pool.free_chunks);
+    cJSON_AddNumberToObject(pool_json, "min_free", pool.min_free);
+    cJSON_AddNumberToObject(pool_json, "slabs", pool.slab_count);
+    cJSON_AddNumberToObject(pool_json, "peak_slabs", pool.peak_slabs);
+    cJSON_AddNumberToObject(pool_json, "grow_events", pool.grow_events);
+    cJSON_AddNumberToObject(pool_json, "shrink_events", pool.shrink_events);
+    cJSON_AddNumberToObject(pool_json, "grow_failures", pool.grow_failures);
+    cJSON_AddNumberToObject(pool_json, "exhausted", pool.exhausted);
+    cJSON_AddNumberToObject(pool_json, "capture_evictions", pool.capture_evictions);
+    cJSON_AddNumberToObject(pool_json, "carved_frames", pool.carved_frames);
+
+    audio_spill_stats_t spill;
+    get_audio_spill_stats(&spill);
+    if (spill.available) {
+        cJSON *spill_json = cJSON_AddObjectToObject(json, "spill");
+        cJSON_AddNumberToObject(spill_json, "pending", spill.pending);
+        cJSON_AddNumberToObject(spill_json, "capacity", spill.capacity);
+        cJSON_AddNumberToObject(spill_json, "appended", spill.log.appended);
+        cJSON_AddNumberToObject(spill_json, "replayed", spill.log.replayed);
+        cJSON_AddNumberToObject(spill_json, "evicted", spill.log.evicted);
+        cJSON_AddNumberToObject(spill_json, "crc_errors", spill.log.crc_errors);
+        cJSON_AddNumberToObject(spill_json, "recovered", spill.log.recovered);
+        cJSON_AddNumberToObject(spill_json, "discarded", spill.log.discarded);
+        cJSON_AddNumberToObject(spill_json, "erase_max", spill.log.erase_max);
+        cJSON_AddNumberToObject(spill_json, "write_kbps",
+                                spill.write_us ? (double)(spill.write_bytes * 1000 / spill.write_us) : 0);
+        cJSON_AddNumberToObject(spill_json, "replay_kbps",
+                                spill.replay_us ? (double)(spill.replay_bytes * 1000 / spill.replay_us) : 0);
+    }
+
+    dictation_stats_t dictation;
+    get_dictation_stats(&dictation);
+    if (dictation.available) {
+        cJSON *dict_json = cJSON_AddObjectToObject(json, "dictation");
+        cJSON_AddStringToObject(dict_json, "backend", dictation.himem ? "himem" : "psram");
+        cJSON_AddNumberToObject(dict_json, "capacity_chunks", dictation.capacity_chunks);
+        cJSON_AddNumberToObject(dict_json, "pending", dictation.pending_chunks);
+        cJSON_AddNumberToObject(dict_json, "peak_pending", dictation.peak_pending);
+        cJSON_AddNumberToObject(dict_json, "stored", dictation.stored);
+        cJSON_AddNumberToObject(dict_json, "sent", dictation.sent);
+        cJSON_AddNumberToObject(dict_json, "full_stops", dictation.full_stops);
+        cJSON_AddNumberToObject(dict_json, "window_switches", dictation.window_switches);
+    }
+
+    tts_cache_stats_t cache;
+    get_tts_cache_stats(&cache);
+    cJSON *cache_json = cJSON_AddObjectToObject(json, "tts_cache");
+    cJSON_AddNumberToObject(cache_json, "entries", cache.entries);
+    cJSON_AddNumberToObject(cache_json, "bytes", cache.bytes);
+    cJSON_AddNumberToObject(cache_json, "hits", cache.hits);
+    cJSON_AddNumberToObject(cache_json, "misses", cache.misses);
+    cJSON_AddNumberToObject(cache_json, "evicted", cache.evicted);
+    cJSON_AddNumberToObject(cache_json, "skipped", cache.skipped);
+    cJSON_AddNumberToObject(cache_json, "hit_latency_avg_us",
+                            cache.hit_count ? (double)(cache.hit_total_us / cache.hit_count) : 0);
+    cJSON_AddNumberToObject(cache_json, "hit_latency_max_us", cache.hit_max_us);
+    cJSON_AddNumberToObject(cache_json, "server_latency_avg_us",
+                            cache.server_count ? (double)(cache.server_total_us / cache.server_count) : 0);
+    cJSON_AddNumberToObject(cache_json, "server_latency_max_us", cache.server_max_us);
+
+    wake_word_stats_t wake;
+    get_wake_word_stats(&wake);
+    if (wake.enabled) {
+        cJSON *wake_json = cJSON_AddObjectToObject(json, "wake_word");
+        cJSON_AddNumberToObject(wake_json, "detections", wake.detections);
+        cJSON_AddNumberToObject(wake_json, "listen_s", (double)(wake.listen_us / 1000000));
+        cJSON_AddNumberToObject(wake_json, "inferences", wake.inferences);
+        cJSON_AddNumberToObject(wake_json, "feature_us_avg", wake.hops ? (double)(wake.feature_us / wake.hops) : 0);
+        cJSON_AddNumberToObject(wake_json, "infer_us_avg",
+                                wake.inferences ? (double)(wake.infer_us / wake.inferences) : 0);
+        cJSON_AddNumberToObject(wake_json, "infer_us_max", wake.infer_max_us);
+        cJSON_AddNumberToObject(wake_json, "cpu_pct", wake.cpu_permille / 10.0);
+        cJSON_AddNumberToObject(wake_json, "power_est_mw", wake.power_est_mw);
+        cJSON_AddNumberToObject(wake_json, "preroll_chunks", wake.preroll_chunks);
+    }
+
+    return json;
+}
+
+void telemetry_task(void *pvParameters) {
+    const TickType_t interval = pdMS_TO_TICKS(CONFIG_HOTPIN_TELEMETRY_INTERVAL_MS);
+    const EventBits_t shutdown_bit = STATE_BIT(CLIENT_STATE_SHUTDOWN);
+
+    if (CONFIG_HOTPIN_TELEMETRY_INTERVAL_MS == 0) {
+        ESP_LOGI("TELEMETRY", "Telemetry disabled");
+        vTaskDelete(NULL);
+    }
+
+#if !(CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS)
+    ESP_LOGW("TELEMETRY", "FreeRTOS run-time stats disabled, CPU usage will not be reported");
+#endif
+
+    // Baseline so the first report covers a full interval
+    telemetry_sample_cpu(NULL);
+
+    while (1) {
+        // Doubles as the report timer; returns early on shutdown
+        EventBits_t bits = xEventGroupWaitBits(state_events, shutdown_bit, pdFALSE, pdFALSE, interval);
+        if (bits & shutdown_bit) {
+            break;
+        }
+
+        cJSON *json = build_telemetry_message();
+        if (!json) {
+            continue;
+        }
+
+        if (xEventGroupGetBits(state_events) & WS_CONNECTED_BIT) {
+            ws_send_json(json);
+        } else {
+            cJSON_Delete(json);
+        }
+    }
+
+    vTaskDelete(NULL);
+}
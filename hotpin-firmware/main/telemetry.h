@@ -0,0 +1,56 @@
+/*
+ * HotPin Firmware - Runtime Telemetry
+ *
+ * Periodically samples per-task CPU usage and audio timing counters and
+ * reports them to the server as a "telemetry" WebSocket message.
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TELEMETRY_MAX_TASKS 32
+
+// CPU usage of one task over the last sampling window
+typedef struct {
+    char name[16];
+    int core;               // Core the task is pinned to, -1 if unpinned
+    unsigned priority;
+    uint32_t cpu_permille;  // Share of one core, in 1/1000
+} telemetry_task_load_t;
+
+typedef struct {
+    uint32_t window_ms;
+    uint32_t core_load_permille[2];  // 1000 - idle task share, per core
+    int task_count;
+    telemetry_task_load_t tasks[TELEMETRY_MAX_TASKS];
+} telemetry_cpu_sample_t;
+
+/**
+ * @brief Sample per-task CPU usage since the previous call
+ *
+ * Requires CONFIG_FREERTOS_USE_TRACE_FACILITY and
+ * CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS.
+ *
+ * @param sample Output sample
+ * @return true if a sample was produced, false if run-time stats are
+ *         unavailable or this was the first (baseline) call
+ */
+bool telemetry_sample_cpu(telemetry_cpu_sample_t *sample);
+
+/**
+ * @brief Telemetry task: sends a report every CONFIG_HOTPIN_TELEMETRY_INTERVAL_MS
+ */
+void telemetry_task(void *pvParameters);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TELEMETRY_H */
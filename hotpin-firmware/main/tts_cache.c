@@ -0,0 +1,292 @@
+/*
+ * HotPin Firmware - TTS Replay Cache
+ *
+ * One entry is filled at a time, sized from the fileSize in tts_ready so
+ * the PSRAM allocation happens once per response. Entries being filled or
+ * replayed are never evicted, so the playback task can read replay slices
+ * without holding the lock.
+ */
+
+#include "main.h"
+#include "tts_cache.h"
+
+// PSRAM left for the chunk pool slabs and the rest of the heap
+#define TTS_CACHE_PSRAM_RESERVE     (512 * 1024)
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t size;
+    int32_t turn;
+    uint32_t last_used;     // LRU clock
+    uint32_t stored_seq;    // Order of commit, for TTS_CACHE_LATEST
+    bool valid;
+} tts_cache_entry_t;
+
+static tts_cache_entry_t entries[CONFIG_HOTPIN_TTS_CACHE_ENTRIES];
+static int filling = -1;        // Entry receiving the current stream
+static int replaying = -1;      // Entry being replayed
+static size_t replay_cursor = 0;
+static uint32_t lru_clock = 0;
+static uint32_t store_seq = 0;
+static int64_t first_audio_due_us = 0;  // Request time awaiting first audio, 0 if none
+static bool first_audio_is_replay = false;
+static tts_cache_stats_t stats;
+
+static SemaphoreHandle_t cache_mutex = NULL;
+static StaticSemaphore_t cache_mutex_buf;
+
+static void free_entry(int index) {
+    heap_caps_free(entries[index].data);
+    memset(&entries[index], 0, sizeof(entries[index]));
+}
+
+// Least-recently-used entry that may be evicted, -1 if none
+static int lru_victim(void) {
+    int victim = -1;
+    for (int i = 0; i < CONFIG_HOTPIN_TTS_CACHE_ENTRIES; i++) {
+        if (!entries[i].valid || i == replaying) {
+            continue;
+        }
+        if (victim < 0 || entries[i].last_used < entries[victim].last_used) {
+            victim = i;
+        }
+    }
+    return victim;
+}
+
+static void evict(int index) {
+    ESP_LOGI("TTSCACHE", "Evicting turn %"PRId32" (%zu bytes)", entries[index].turn, entries[index].len);
+    free_entry(index);
+    stats.evicted++;
+}
+
+bool init_tts_cache(void) {
+    if (!cache_mutex) {
+        cache_mutex = xSemaphoreCreateMutexStatic(&cache_mutex_buf);
+    }
+    return cache_mutex != NULL;
+}
+
+void tts_cache_begin(int32_t turn, size_t size, int64_t requested_us) {
+    if (!cache_mutex) {
+        return;
+    }
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+
+    first_audio_due_us = requested_us;
+    first_audio_is_replay = false;
+
+    // An earlier stream that never finished is not worth keeping
+    if (filling >= 0) {
+        free_entry(filling);
+        filling = -1;
+    }
+    if (!psram_available || size == 0) {
+        stats.skipped++;
+        xSemaphoreGive(cache_mutex);
+        return;
+    }
+
+    int slot = -1;
+    for (int i = 0; i < CONFIG_HOTPIN_TTS_CACHE_ENTRIES; i++) {
+        if (entries[i].valid && entries[i].turn == turn && i != replaying) {
+            free_entry(i);  // Re-streamed turn replaces its old copy
+        }
+        if (slot < 0 && !entries[i].valid) {
+            slot = i;
+        }
+    }
+    if (slot < 0 && (slot = lru_victim()) >= 0) {
+        evict(slot);
+    }
+
+    // Make room in PSRAM, oldest first
+    int victim;
+    while (heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM) < size + TTS_CACHE_PSRAM_RESERVE &&
+           (victim = lru_victim()) >= 0) {
+        evict(victim);
+        if (slot < 0) {
+            slot = victim;
+        }
+    }
+
+    uint8_t *data = NULL;
+    if (slot >= 0 && heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM) >= size + TTS_CACHE_PSRAM_RESERVE) {
+        data = heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    }
+    if (!data) {
+        ESP_LOGW("TTSCACHE", "No PSRAM to cache turn %"PRId32" (%zu bytes)", turn, size);
+        stats.skipped++;
+        xSemaphoreGive(cache_mutex);
+        return;
+    }
+
+    entries[slot] = (tts_cache_entry_t){ .data = data, .size = size, .turn = turn };
+    filling = slot;
+    xSemaphoreGive(cache_mutex);
+}
+
+void tts_cache_append(const uint8_t *data, size_t len) {
+    if (!cache_mutex) {
+        return;
+    }
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+    if (filling >= 0) {
+        tts_cache_entry_t *entry = &entries[filling];
+        size_t room = entry->size - entry->len;
+        size_t copy = len < room ? len : room;
+        memcpy(entry->data + entry->len, data, copy);
+        entry->len += copy;
+    }
+    xSemaphoreGive(cache_mutex);
+}
+
+void tts_cache_commit(void) {
+    if (!cache_mutex) {
+        return;
+    }
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+    if (filling >= 0) {
+        tts_cache_entry_t *entry = &entries[filling];
+        if (entry->len > 0) {
+            entry->valid = true;
+            entry->last_used = ++lru_clock;
+            entry->stored_seq = ++store_seq;
+            stats.stored++;
+            ESP_LOGI("TTSCACHE", "Cached turn %"PRId32" (%zu bytes)", entry->turn, entry->len);
+        } else {
+            free_entry(filling);
+        }
+        filling = -1;
+    }
+    xSemaphoreGive(cache_mutex);
+}
+
+bool tts_cache_play(int32_t turn) {
+    if (!cache_mutex || get_state() != CLIENT_STATE_IDLE) {
+        return false;
+    }
+    int64_t requested_us = esp_timer_get_time();
+
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+    int found = -1;
+    for (int i = 0; i < CONFIG_HOTPIN_TTS_CACHE_ENTRIES; i++) {
+        if (!entries[i].valid) {
+            continue;
+        }
+        if (turn == TTS_CACHE_LATEST ? (found < 0 || entries[i].stored_seq > entries[found].stored_seq)
+                                     : entries[i].turn == turn) {
+            found = i;
+        }
+    }
+    if (found < 0) {
+        stats.misses++;
+        xSemaphoreGive(cache_mutex);
+        ESP_LOGI("TTSCACHE", "Replay miss for turn %"PRId32, turn);
+        return false;
+    }
+    entries[found].last_used = ++lru_clock;
+    replaying = found;
+    replay_cursor = 0;
+    first_audio_due_us = requested_us;
+    first_audio_is_replay = true;
+    stats.hits++;
+    xSemaphoreGive(cache_mutex);
+
+    ESP_LOGI("TTSCACHE", "Replaying turn %"PRId32" from PSRAM", entries[found].turn);
+    set_state(CLIENT_STATE_PLAYING);
+    if (get_state() != CLIENT_STATE_PLAYING) {
+        tts_cache_playback_ended();  // Lost a race with another transition
+        return false;
+    }
+    // Nothing else is coming: go IDLE once the replayed audio has drained
+    audio_playback_end_of_stream();
+    return true;
+}
+
+bool tts_cache_replaying(void) {
+    if (!cache_mutex) {
+        return false;
+    }
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+    bool active = replaying >= 0;
+    xSemaphoreGive(cache_mutex);
+    return active;
+}
+
+bool tts_cache_replay_next(const uint8_t **data, size_t *len) {
+    if (!cache_mutex) {
+        return false;
+    }
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+    bool more = false;
+    if (replaying >= 0 && replay_cursor < entries[replaying].len) {
+        size_t slice = entries[replaying].len - replay_cursor;
+        *len = slice < CHUNK_BYTES ? slice : CHUNK_BYTES;
+        *data = entries[replaying].data + replay_cursor;
+        replay_cursor += *len;
+        more = true;
+    }
+    xSemaphoreGive(cache_mutex);
+    return more;
+}
+
+void tts_cache_note_first_audio(void) {
+    if (!cache_mutex) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+    if (first_audio_due_us > 0) {
+        uint32_t latency_us = (uint32_t)(now - first_audio_due_us);
+        if (first_audio_is_replay) {
+            stats.hit_count++;
+            stats.hit_total_us += latency_us;
+            if (latency_us > stats.hit_max_us) {
+                stats.hit_max_us = latency_us;
+            }
+        } else {
+            stats.server_count++;
+            stats.server_total_us += latency_us;
+            if (latency_us > stats.server_max_us) {
+                stats.server_max_us = latency_us;
+            }
+        }
+        first_audio_due_us = 0;
+    }
+    xSemaphoreGive(cache_mutex);
+}
+
+void tts_cache_playback_ended(void) {
+    if (!cache_mutex) {
+        return;
+    }
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+    replaying = -1;
+    replay_cursor = 0;
+    if (filling >= 0) {
+        free_entry(filling);  // Stream cut short
+        filling = -1;
+    }
+    first_audio_due_us = 0;
+    xSemaphoreGive(cache_mutex);
+}
+
+void get_tts_cache_stats(tts_cache_stats_t *out) {
+    if (!cache_mutex) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+    *out = stats;
+    out->entries = 0;
+    out->bytes = 0;
+    for (int i = 0; i < CONFIG_HOTPIN_TTS_CACHE_ENTRIES; i++) {
+        if (entries[i].valid) {
+            out->entries++;
+            out->bytes += entries[i].len;
+        }
+    }
+    xSemaphoreGive(cache_mutex);
+}
@@ -0,0 +1,105 @@
+/*
+ * HotPin Firmware - TTS Replay Cache
+ *
+ * The last few TTS responses are kept in PSRAM as they play, keyed by the
+ * server's turn ID. A triple press or a server "replay" command plays one
+ * again through the playback task without any network traffic. Entries are
+ * evicted least-recently-used, and also whenever free PSRAM runs short.
+ */
+
+#ifndef TTS_CACHE_H
+#define TTS_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TTS_CACHE_LATEST    (-1)    // Turn ID meaning "most recent response"
+
+typedef struct {
+    uint32_t entries;
+    uint32_t bytes;
+    uint32_t stored;
+    uint32_t evicted;
+    uint32_t skipped;               // Responses not cached (no PSRAM)
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t hit_count;             // Replays whose first audio was timed
+    uint64_t hit_total_us;
+    uint32_t hit_max_us;
+    uint32_t server_count;          // Server turns whose first audio was timed
+    uint64_t server_total_us;
+    uint32_t server_max_us;
+} tts_cache_stats_t;
+
+/**
+ * @brief Create the cache lock (entries are allocated on demand)
+ */
+bool init_tts_cache(void);
+
+/**
+ * @brief Start caching a streamed response (on tts_ready)
+ *
+ * @param turn Server turn ID
+ * @param size Expected response size in bytes (the cache entry is sized once)
+ * @param requested_us When the user's request left the device, for the
+ *                     server round-trip latency
+ */
+void tts_cache_begin(int32_t turn, size_t size, int64_t requested_us);
+
+/**
+ * @brief Copy a played chunk into the entry being cached (playback task)
+ */
+void tts_cache_append(const uint8_t *data, size_t len);
+
+/**
+ * @brief Keep the entry being cached; called once the stream has fully played
+ */
+void tts_cache_commit(void);
+
+/**
+ * @brief Replay a cached response from IDLE
+ *
+ * @param turn Turn ID, or TTS_CACHE_LATEST
+ * @return false on a cache miss or if playback could not start
+ */
+bool tts_cache_play(int32_t turn);
+
+/**
+ * @brief true while a local replay owns PLAYING (no server messages)
+ */
+bool tts_cache_replaying(void);
+
+/**
+ * @brief Next slice of the response being replayed (playback task)
+ *
+ * @param data Set to the slice, which stays valid until playback ends
+ * @param len Set to the slice length (at most CHUNK_BYTES)
+ * @return false once the response has been handed out
+ */
+bool tts_cache_replay_next(const uint8_t **data, size_t *len);
+
+/**
+ * @brief Record time to first audio for the stream or replay just started
+ */
+void tts_cache_note_first_audio(void);
+
+/**
+ * @brief Leaving PLAYING: end any replay and drop an unfinished entry
+ */
+void tts_cache_playback_ended(void);
+
+/**
+ * @brief Copy the cache counters
+ */
+void get_tts_cache_stats(tts_cache_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TTS_CACHE_H */
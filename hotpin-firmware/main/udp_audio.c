@@ -0,0 +1,162 @@
+/*
+ * HotPin Firmware - Live Audio over UDP
+ */
+
+#include "main.h"
+#include "udp_audio.h"
+#include "rtp_fec.h"
+#include "session_profile.h"
+#include <errno.h>
+
+#ifdef CONFIG_HOTPIN_UDP_AUDIO
+static SemaphoreHandle_t udp_mutex = NULL;
+static StaticSemaphore_t udp_mutex_buf;
+static volatile bool active = false;
+static int sock = -1;
+static rtp_sender_t sender;
+static uint8_t packet[RTP_MAX_PACKET];
+
+// Per recording, logged when it ends
+static uint32_t packets_sent = 0;
+static uint32_t parity_sent = 0;
+static uint32_t send_drops = 0;
+
+// Caller holds udp_mutex
+static void send_packet(size_t len) {
+    if (len == 0) {
+        return;
+    }
+    if (send(sock, packet, len, MSG_DONTWAIT) < 0) {
+        send_drops++;
+    } else if ((packet[1] & 0x7f) == RTP_PT_FEC) {
+        parity_sent++;
+    } else {
+        packets_sent++;
+    }
+}
+
+static void close_socket(void) {
+    if (sock >= 0) {
+        close(sock);
+        sock = -1;
+    }
+}
+#endif
+
+void udp_audio_reset(void) {
+#ifdef CONFIG_HOTPIN_UDP_AUDIO
+    if (!udp_mutex) {
+        udp_mutex = xSemaphoreCreateMutexStatic(&udp_mutex_buf);
+    }
+    xSemaphoreTake(udp_mutex, portMAX_DELAY);
+    active = false;
+    close_socket();
+    xSemaphoreGive(udp_mutex);
+#endif
+}
+
+bool udp_audio_configure(const cJSON *config) {
+#ifdef CONFIG_HOTPIN_UDP_AUDIO
+    udp_audio_reset();
+    if (!session_feature_enabled(SESSION_FEATURE_UDP_AUDIO) || !cJSON_IsObject(config)) {
+        return false;
+    }
+
+    const char *host = cJSON_GetStringValue(cJSON_GetObjectItem(config, "host"));
+    cJSON *port = cJSON_GetObjectItem(config, "port");
+    cJSON *ssrc = cJSON_GetObjectItem(config, "ssrc");
+    cJSON *fec_group = cJSON_GetObjectItem(config, "fec_group");
+    cJSON *frame_ms = cJSON_GetObjectItem(config, "frame_ms");
+    struct sockaddr_in server = {
+        .sin_family = AF_INET,
+    };
+    if (!host || inet_pton(AF_INET, host, &server.sin_addr) != 1 || !cJSON_IsNumber(port) ||
+        port->valuedouble < 1 || port->valuedouble > 65535 || !cJSON_IsNumber(ssrc) ||
+        (cJSON_IsNumber(frame_ms) && frame_ms->valuedouble != UDP_AUDIO_FRAME_BYTES / (SAMPLE_RATE * 2 / 1000))) {
+        ESP_LOGW("UDP_AUDIO", "Ignoring udp_audio outside what this device supports; audio stays on the WebSocket");
+        return false;
+    }
+    server.sin_port = htons((uint16_t)port->valuedouble);
+    uint8_t group = 0;
+    if (cJSON_IsNumber(fec_group) && fec_group->valuedouble > 0) {
+        group = fec_group->valuedouble > RTP_FEC_MAX_GROUP ? RTP_FEC_MAX_GROUP : (uint8_t)fec_group->valuedouble;
+    }
+
+    // A connected socket: send() needs no address and ICMP errors are reported
+    int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (fd < 0) {
+        ESP_LOGE("UDP_AUDIO", "Failed to create socket: errno %d", errno);
+        return false;
+    }
+    if (connect(fd, (struct sockaddr *)&server, sizeof(server)) != 0) {
+        ESP_LOGE("UDP_AUDIO", "Failed to connect to %s:%d: errno %d", host, ntohs(server.sin_port), errno);
+        close(fd);
+        return false;
+    }
+
+    xSemaphoreTake(udp_mutex, portMAX_DELAY);
+    sock = fd;
+    rtp_sender_init(&sender, (uint32_t)ssrc->valuedouble, group, (uint16_t)esp_random());
+    packets_sent = parity_sent = send_drops = 0;
+    active = true;
+    xSemaphoreGive(udp_mutex);
+
+    ESP_LOGI("UDP_AUDIO", "Live audio over UDP to %s:%d, parity every %u packets", host, ntohs(server.sin_port),
+             group);
+    return true;
+#else
+    (void)config;
+    return false;
+#endif
+}
+
+bool udp_audio_active(void) {
+#ifdef CONFIG_HOTPIN_UDP_AUDIO
+    return active;
+#else
+    return false;
+#endif
+}
+
+bool udp_audio_send(const uint8_t *data, size_t len) {
+#ifdef CONFIG_HOTPIN_UDP_AUDIO
+    if (!active) {
+        return false;
+    }
+    xSemaphoreTake(udp_mutex, portMAX_DELAY);
+    bool sent = active;
+    for (size_t offset = 0; sent && offset < len; offset += UDP_AUDIO_FRAME_BYTES) {
+        size_t n = len - offset < UDP_AUDIO_FRAME_BYTES ? len - offset : UDP_AUDIO_FRAME_BYTES;
+        send_packet(rtp_sender_audio(&sender, data + offset, n, packet, sizeof(packet)));
+        send_packet(rtp_sender_fec(&sender, false, packet, sizeof(packet)));
+    }
+    xSemaphoreGive(udp_mutex);
+    return sent;
+#else
+    (void)data;
+    (void)len;
+    return false;
+#endif
+}
+
+void udp_audio_end_recording(cJSON *stop_message) {
+#ifdef CONFIG_HOTPIN_UDP_AUDIO
+    if (!active) {
+        return;
+    }
+    xSemaphoreTake(udp_mutex, portMAX_DELAY);
+    if (active) {
+        send_packet(rtp_sender_fec(&sender, true, packet, sizeof(packet)));
+        if (packets_sent > 0) {
+            cJSON_AddNumberToObject(stop_message, "udp_last_seq", rtp_sender_last_seq(&sender));
+        }
+        rtp_sender_mark(&sender);
+        ESP_LOGI("UDP_AUDIO", "Recording sent as %"PRIu32" packets and %"PRIu32" parity, %"PRIu32" dropped locally",
+                 packets_sent, parity_sent, send_drops);
+        packets_sent = parity_sent = send_drops = 0;
+    }
+    xSemaphoreGive(udp_mutex);
+#else
+    (void)stop_message;
+#endif
+}
@@ -0,0 +1,64 @@
+/*
+ * HotPin Firmware - Live Audio over UDP
+ *
+ * On TCP one lost segment holds back every frame behind it until it is
+ * retransmitted, which on a busy Wi-Fi channel stalls the live uplink for
+ * hundreds of milliseconds. When the server agrees to the udp_audio
+ * feature, live frames go instead as 20 ms RTP packets with XOR parity
+ * (rtp_fec.h) to the address and SSRC given in session_config. The session,
+ * its authentication and every control message stay on the WebSocket;
+ * spilled and dictation audio is still sent over it too.
+ */
+
+#ifndef UDP_AUDIO_H
+#define UDP_AUDIO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cJSON.h"
+
+#define UDP_AUDIO_FRAME_BYTES   640     // 20 ms of 16 kHz PCM16 per packet
+
+/**
+ * @brief Go back to sending audio over the WebSocket (on each new connection)
+ */
+void udp_audio_reset(void);
+
+/**
+ * @brief Apply the "udp_audio" object of a session_config
+ *
+ * @return true if live audio now goes over UDP, false if it stays on the
+ *         WebSocket (feature off, no object, or no socket)
+ */
+bool udp_audio_configure(const cJSON *config);
+
+/**
+ * @brief true while live audio goes over UDP
+ */
+bool udp_audio_active(void);
+
+/**
+ * @brief Send one captured frame as 20 ms packets, with parity as each
+ *        group fills
+ *
+ * Never blocks: a packet the stack has no room for is counted and dropped,
+ * and left to the parity and the server's jitter buffer.
+ *
+ * @return false if UDP audio is not active
+ */
+bool udp_audio_send(const uint8_t *data, size_t len);
+
+/**
+ * @brief End a recording: send the parity of the last, partial group and
+ *        tell the server which packet was the last
+ *
+ * Call once the recording's last frame has been through udp_audio_send(),
+ * i.e. from the send task after the capture queue has drained.
+ *
+ * @param stop_message The recording_stopped message; gets "udp_last_seq"
+ */
+void udp_audio_end_recording(cJSON *stop_message);
+
+#endif /* UDP_AUDIO_H */
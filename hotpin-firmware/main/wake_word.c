@@ -0,0 +1,303 @@
+/*
+ * HotPin Firmware - Wake-Word Listener
+ *
+ * The listener reads one hop at a time under the I2S mutex, like the
+ * capture task, so a state change waits at most 20 ms for it. The MFCC
+ * front end runs on every hop; the classifier every
+ * CONFIG_HOTPIN_WAKE_WORD_INFER_HOPS hops over the last second of frames.
+ */
+
+#include "main.h"
+#include "kws.h"
+#include "wake_word.h"
+#include "runtime_config.h"
+#include "session_profile.h"
+#include "esp_partition.h"
+
+#define WAKE_HOP_BYTES          (KWS_HOP_LEN * sizeof(int16_t))
+#define WAKE_PREROLL_SAMPLES    ((size_t)CONFIG_HOTPIN_WAKE_WORD_PREROLL_MS * KWS_SAMPLE_RATE / 1000)
+#define WAKE_REFRACTORY_MS      1500
+
+// Idle-listening power model on top of the radio and the idle SoC, from
+// typical datasheet figures at 3.3 V: INMP441 microphone 1.4 mA, I2S with
+// DMA and the APB clock it keeps up about 1.5 mA, and one core busy at
+// 240 MHz rather than waiting for an interrupt about 20 mA
+#define WAKE_POWER_MIC_MW       5
+#define WAKE_POWER_I2S_MW       5
+#define WAKE_POWER_CORE_MW      66
+
+static bool ready = false;
+static kws_model_t model;
+static esp_partition_mmap_handle_t model_handle;
+static int8_t *arena = NULL;
+static kws_frontend_t frontend;
+static kws_detector_t detector;
+static int16_t hop_buffer[KWS_HOP_LEN];
+
+// Pre-roll ring in PSRAM: written by the listener while IDLE, drained by
+// the capture task after a detection. The two never run at the same time.
+static int16_t *preroll = NULL;
+static size_t preroll_head = 0;     // Next sample to write
+static size_t preroll_count = 0;    // Valid samples
+static bool preroll_armed = false;
+
+static wake_word_stats_t stats;
+static portMUX_TYPE wake_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool load_model(void) {
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                           ESP_PARTITION_SUBTYPE_ANY, "kws");
+    if (!part) {
+        ESP_LOGW("WAKE", "No 'kws' partition");
+        return false;
+    }
+
+    const void *ptr = NULL;
+    esp_err_t err = esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &ptr, &model_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE("WAKE", "Failed to map model partition: %s", esp_err_to_name(err));
+        return false;
+    }
+    if (!kws_model_load(&model, ptr, part->size)) {
+        ESP_LOGW("WAKE", "'kws' partition holds no valid model (see tools/pack_kws_model.py)");
+        esp_partition_munmap(model_handle);
+        return false;
+    }
+    return true;
+}
+
+bool init_wake_word(void) {
+#if CONFIG_HOTPIN_WAKE_WORD
+    if (ready) {
+        return true;
+    }
+
+    kws_init();
+    if (!load_model()) {
+        return false;
+    }
+
+    // Activations are hit on every MAC, so prefer internal RAM
+    arena = heap_caps_malloc(model.arena_bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!arena) {
+        arena = heap_caps_malloc(model.arena_bytes, MALLOC_CAP_SPIRAM);
+    }
+    if (WAKE_PREROLL_SAMPLES > 0) {
+        preroll = heap_caps_malloc(WAKE_PREROLL_SAMPLES * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+    }
+    if (!arena || (WAKE_PREROLL_SAMPLES > 0 && !preroll)) {
+        ESP_LOGE("WAKE", "Failed to allocate inference arena or pre-roll ring");
+        free(arena);
+        free(preroll);
+        arena = NULL;
+        preroll = NULL;
+        esp_partition_munmap(model_handle);
+        return false;
+    }
+
+    stats.enabled = true;
+    ready = true;
+    ESP_LOGI("WAKE", "Wake word: %u layers, %u classes, %zu byte arena, %d ms pre-roll, threshold %d%%",
+             model.header->layer_count, model.header->n_classes, model.arena_bytes,
+             CONFIG_HOTPIN_WAKE_WORD_PREROLL_MS, CONFIG_HOTPIN_WAKE_WORD_THRESHOLD);
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool wake_word_available(void) {
+    return ready;
+}
+
+bool wake_word_enabled(void) {
+    return ready && session_feature_enabled(SESSION_FEATURE_WAKE_WORD);
+}
+
+static void preroll_reset(void) {
+    portENTER_CRITICAL(&wake_lock);
+    preroll_head = 0;
+    preroll_count = 0;
+    preroll_armed = false;
+    portEXIT_CRITICAL(&wake_lock);
+}
+
+static void preroll_write(const int16_t *samples, size_t count) {
+    if (!preroll) {
+        return;
+    }
+    size_t head = preroll_head;
+    for (size_t i = 0; i < count; i++) {
+        preroll[head] = samples[i];
+        head = head + 1 == WAKE_PREROLL_SAMPLES ? 0 : head + 1;
+    }
+
+    portENTER_CRITICAL(&wake_lock);
+    preroll_head = head;
+    preroll_count = preroll_count + count > WAKE_PREROLL_SAMPLES ? WAKE_PREROLL_SAMPLES : preroll_count + count;
+    portEXIT_CRITICAL(&wake_lock);
+}
+
+size_t wake_word_take_preroll(uint8_t *dst, size_t max_bytes) {
+    portENTER_CRITICAL(&wake_lock);
+    size_t count = preroll_armed ? preroll_count : 0;
+    size_t start = (preroll_head + WAKE_PREROLL_SAMPLES - preroll_count) % (WAKE_PREROLL_SAMPLES ? WAKE_PREROLL_SAMPLES : 1);
+    portEXIT_CRITICAL(&wake_lock);
+
+    size_t take = max_bytes / sizeof(int16_t);
+    if (take > count) {
+        take = count;
+    }
+    if (take == 0) {
+        return 0;
+    }
+
+    // The listener is parked outside IDLE, so copy outside the lock
+    size_t first = WAKE_PREROLL_SAMPLES - start;
+    if (first > take) {
+        first = take;
+    }
+    memcpy(dst, &preroll[start], first * sizeof(int16_t));
+    memcpy(dst + first * sizeof(int16_t), preroll, (take - first) * sizeof(int16_t));
+
+    portENTER_CRITICAL(&wake_lock);
+    preroll_count -= take;
+    preroll_armed = preroll_count > 0;
+    stats.preroll_chunks++;
+    portEXIT_CRITICAL(&wake_lock);
+    return take * sizeof(int16_t);
+}
+
+void get_wake_word_stats(wake_word_stats_t *out) {
+    portENTER_CRITICAL(&wake_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&wake_lock);
+
+    if (out->listen_us > 0) {
+        uint64_t busy_us = out->feature_us + out->infer_us;
+        out->cpu_permille = (uint32_t)(busy_us * 1000 / out->listen_us);
+    }
+    if (out->enabled) {
+        out->power_est_mw = WAKE_POWER_MIC_MW + WAKE_POWER_I2S_MW +
+                            WAKE_POWER_CORE_MW * out->cpu_permille / 1000;
+    }
+}
+
+// One hop: pre-roll, features, and a classification every few hops
+static bool process_hop(int *hops_since_infer) {
+    preroll_write(hop_buffer, KWS_HOP_LEN);
+
+    int64_t start_us = esp_timer_get_time();
+    kws_frontend_push(&frontend, hop_buffer, KWS_HOP_LEN);
+    int64_t features_us = esp_timer_get_time() - start_us;
+
+    portENTER_CRITICAL(&wake_lock);
+    stats.hops++;
+    stats.feature_us += features_us;
+    portEXIT_CRITICAL(&wake_lock);
+
+    if (++*hops_since_infer < CONFIG_HOTPIN_WAKE_WORD_INFER_HOPS || !kws_frontend_ready(&frontend, &model)) {
+        return false;
+    }
+    *hops_since_infer = 0;
+
+    float probs[KWS_MAX_CLASSES];
+    start_us = esp_timer_get_time();
+    kws_infer(&model, &frontend, arena, probs);
+    uint32_t infer_us = (uint32_t)(esp_timer_get_time() - start_us);
+
+    portENTER_CRITICAL(&wake_lock);
+    stats.inferences++;
+    stats.infer_us += infer_us;
+    if (infer_us > stats.infer_max_us) {
+        stats.infer_max_us = infer_us;
+    }
+    portEXIT_CRITICAL(&wake_lock);
+
+    runtime_config_t config;
+    runtime_config_get(&config);
+    int refractory = WAKE_REFRACTORY_MS / 20 / CONFIG_HOTPIN_WAKE_WORD_INFER_HOPS;
+    return kws_detector_update(&detector, probs[model.header->wake_class],
+                               config.wake_threshold / 100.0f, refractory);
+}
+
+void wake_word_task(void *pvParameters) {
+    if (!ready) {
+        ESP_LOGI("WAKE", "Wake word disabled");
+        vTaskDelete(NULL);
+    }
+
+    bool listening = false;
+    int64_t listen_start_us = 0;
+    int hops_since_infer = 0;
+
+    while (1) {
+        EventBits_t bits = wait_for_state(STATE_BIT(CLIENT_STATE_IDLE) | STATE_BIT(CLIENT_STATE_SHUTDOWN),
+                                          portMAX_DELAY);
+        if (bits & STATE_BIT(CLIENT_STATE_SHUTDOWN)) {
+            break;
+        }
+        if (get_state() != CLIENT_STATE_IDLE) {
+            // Left IDLE (e.g. our own detection); the bit clears once the effects run
+            vTaskDelay(pdMS_TO_TICKS(20));
+            continue;
+        }
+        if (!wake_word_enabled()) {
+            // Left out of this session; IDLE parks the microphone from its next entry
+            if (listening) {
+                portENTER_CRITICAL(&wake_lock);
+                stats.listen_us += esp_timer_get_time() - listen_start_us;
+                portEXIT_CRITICAL(&wake_lock);
+                listening = false;
+            }
+            vTaskDelay(pdMS_TO_TICKS(200));
+            continue;
+        }
+
+        if (!listening) {
+            // Fresh start: stale frames and an unused pre-roll are dropped
+            kws_frontend_reset(&frontend);
+            kws_detector_reset(&detector);
+            preroll_reset();
+            hops_since_infer = 0;
+            listen_start_us = esp_timer_get_time();
+            listening = true;
+        }
+
+        size_t got = 0;
+        esp_err_t err = ESP_ERR_INVALID_STATE;
+        if (i2s_mutex && xSemaphoreTake(i2s_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+            if (audio_i2s_initialized && get_state() == CLIENT_STATE_IDLE) {
+                err = i2s_read(I2S_PORT, hop_buffer, WAKE_HOP_BYTES, &got, pdMS_TO_TICKS(100));
+            }
+            xSemaphoreGive(i2s_mutex);
+        }
+
+        bool detected = err == ESP_OK && got == WAKE_HOP_BYTES && process_hop(&hops_since_infer);
+        if (detected) {
+            ESP_LOGI("WAKE", "Wake word detected (score %.2f)", detector.last_score);
+            portENTER_CRITICAL(&wake_lock);
+            preroll_armed = preroll_count > 0;
+            stats.detections++;
+            portEXIT_CRITICAL(&wake_lock);
+        }
+
+        if (detected || err != ESP_OK || got != WAKE_HOP_BYTES) {
+            // Leaving IDLE, or I2S is briefly in TX mode for an earcon
+            portENTER_CRITICAL(&wake_lock);
+            stats.listen_us += esp_timer_get_time() - listen_start_us;
+            portEXIT_CRITICAL(&wake_lock);
+            listening = false;
+        }
+
+        if (detected && audio_recording_ending()) {
+            ESP_LOGW("WAKE", "Previous recording still uploading, ignoring wake word");
+        } else if (detected) {
+            set_state(CLIENT_STATE_RECORDING);
+        } else if (!listening) {
+            vTaskDelay(pdMS_TO_TICKS(20));
+        }
+    }
+
+    vTaskDelete(NULL);
+}
@@ -0,0 +1,83 @@
+/*
+ * HotPin Firmware - Wake-Word Listener
+ *
+ * With CONFIG_HOTPIN_WAKE_WORD, the microphone stays on while IDLE and
+ * wake_word_task runs the keyword spotter (kws.h) on every 20 ms hop. A
+ * detection starts a recording exactly like a button press; the audio
+ * leading up to it is kept in a PSRAM pre-roll ring and sent ahead of the
+ * live stream, so the server hears the whole utterance.
+ *
+ * The model is memory-mapped from the 'kws' partition. Without a valid
+ * model there the listener stays off and I2S is released in IDLE as usual.
+ */
+
+#ifndef WAKE_WORD_H
+#define WAKE_WORD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    bool enabled;
+    uint32_t detections;
+    uint32_t hops;                  // 20 ms hops processed
+    uint32_t inferences;
+    uint64_t listen_us;             // Wall time spent listening in IDLE
+    uint64_t feature_us;            // MFCC time, all hops
+    uint64_t infer_us;              // Classifier time, all inferences
+    uint32_t infer_max_us;
+    uint32_t preroll_chunks;        // Chunks sent ahead of a wake-word recording
+    uint32_t cpu_permille;          // (feature_us + infer_us) / listen_us, of one core
+    uint32_t power_est_mw;          // Idle-listening estimate, see wake_word.c
+} wake_word_stats_t;
+
+/**
+ * @brief Map the model partition and allocate the pre-roll ring and
+ *        inference arena (no-op unless CONFIG_HOTPIN_WAKE_WORD)
+ *
+ * @return true if the listener will run
+ */
+bool init_wake_word(void);
+
+/**
+ * @brief true if the model loaded and the listener can run on this device
+ */
+bool wake_word_available(void);
+
+/**
+ * @brief true if the microphone should stay on in IDLE for the listener:
+ *        available and enabled for this session
+ */
+bool wake_word_enabled(void);
+
+/**
+ * @brief Copy the next part of the pre-roll armed by the last detection
+ *
+ * Oldest audio first. Only the capture task calls this, at the start of a
+ * recording.
+ *
+ * @param dst Buffer of max_bytes
+ * @return Bytes copied, 0 once the pre-roll is exhausted or none is armed
+ */
+size_t wake_word_take_preroll(uint8_t *dst, size_t max_bytes);
+
+/**
+ * @brief Copy the listener counters, with CPU load and power derived
+ */
+void get_wake_word_stats(wake_word_stats_t *stats);
+
+/**
+ * @brief Listener task: reads I2S hop by hop while IDLE
+ */
+void wake_word_task(void *pvParameters);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WAKE_WORD_H */
@@ -0,0 +1,178 @@
+/*
+ * HotPin Firmware - WebSocket Channel Multiplexer
+ *
+ * No ESP-IDF dependencies: see ws_mux.h.
+ */
+
+#include <string.h>
+
+#include "ws_mux.h"
+
+static ws_mux_item_t *head_item(ws_mux_queue_t *queue) {
+    return &queue->items[queue->head];
+}
+
+static void *pop(ws_mux_t *mux, ws_mux_queue_t *queue) {
+    void *payload = head_item(queue)->payload;
+    queue->head = (queue->head + 1) % WS_MUX_QUEUE_LEN;
+    queue->count--;
+    queue->msg_id++;
+    queue->done++;
+    mux->held--;
+    return payload;
+}
+
+// Fenced control waits for the channel it follows
+static bool fence_open(const ws_mux_t *mux, const ws_mux_item_t *item) {
+    if (item->after == WS_MUX_CONTROL) {
+        return true;
+    }
+    return (int32_t)(mux->queues[item->after].done - item->fence) >= 0;
+}
+
+void ws_mux_init(ws_mux_t *mux, size_t slice_bytes) {
+    memset(mux, 0, sizeof(*mux));
+    if (slice_bytes < WS_MUX_MIN_SLICE) {
+        slice_bytes = WS_MUX_MIN_SLICE;
+    } else if (slice_bytes > WS_MUX_MAX_SLICE) {
+        slice_bytes = WS_MUX_MAX_SLICE;
+    }
+    mux->slice_bytes = slice_bytes;
+    mux->turn = WS_MUX_AUDIO;
+    for (int i = WS_MUX_AUDIO; i < WS_MUX_CHANNELS; i++) {
+        mux->queues[i].weight = 1;
+    }
+}
+
+void ws_mux_set_weight(ws_mux_t *mux, ws_mux_channel_t channel, uint16_t weight) {
+    if (channel > WS_MUX_CONTROL && channel < WS_MUX_CHANNELS) {
+        mux->queues[channel].weight = weight > 0 ? weight : 1;
+    }
+}
+
+bool ws_mux_has_room(const ws_mux_t *mux, ws_mux_channel_t channel) {
+    return channel < WS_MUX_CHANNELS && mux->queues[channel].count < WS_MUX_QUEUE_LEN;
+}
+
+bool ws_mux_push(ws_mux_t *mux, ws_mux_channel_t channel, void *payload, const uint8_t *data, size_t len,
+                 ws_mux_channel_t after, uint32_t tag, uint8_t tag_flags) {
+    if (!ws_mux_has_room(mux, channel) || !data || len == 0 || after >= WS_MUX_CHANNELS) {
+        return false;
+    }
+    ws_mux_queue_t *queue = &mux->queues[channel];
+    ws_mux_item_t *item = &queue->items[(queue->head + queue->count) % WS_MUX_QUEUE_LEN];
+    *item = (ws_mux_item_t){
+        .payload = payload,
+        .data = data,
+        .len = len,
+        .after = channel == WS_MUX_CONTROL ? (uint8_t)after : WS_MUX_CONTROL,
+        .fence = mux->queues[after].pushed,
+        .tag = tag,
+        .tag_flags = tag_flags,
+    };
+    queue->count++;
+    queue->pushed++;
+    mux->held++;
+    return true;
+}
+
+static void take_slice(ws_mux_t *mux, ws_mux_channel_t channel, ws_mux_slice_t *slice) {
+    ws_mux_queue_t *queue = &mux->queues[channel];
+    ws_mux_item_t *item = head_item(queue);
+    size_t left = item->len - item->offset;
+    size_t n = left < mux->slice_bytes ? left : mux->slice_bytes;
+
+    *slice = (ws_mux_slice_t){
+        .channel = channel,
+        .data = item->data + item->offset,
+        .len = n,
+        .tag = item->tag,
+        .tag_flags = item->tag_flags,
+    };
+    slice->header[0] = (uint8_t)channel | (item->offset == 0 ? WS_MUX_FLAG_START : 0) |
+                       (n == left ? WS_MUX_FLAG_FINAL : 0);
+    slice->header[1] = queue->msg_id;
+
+    item->offset += n;
+    queue->deficit -= (int32_t)n;
+    if (n == left) {
+        slice->payload = pop(mux, queue);
+    }
+}
+
+bool ws_mux_next(ws_mux_t *mux, ws_mux_slice_t *slice) {
+    ws_mux_queue_t *control = &mux->queues[WS_MUX_CONTROL];
+    if (control->count > 0 && fence_open(mux, head_item(control))) {
+        ws_mux_item_t *item = head_item(control);
+        *slice = (ws_mux_slice_t){
+            .channel = WS_MUX_CONTROL,
+            .data = item->data,
+            .len = item->len,
+            .tag = item->tag,
+            .tag_flags = item->tag_flags,
+        };
+        slice->payload = pop(mux, control);
+        return true;
+    }
+
+    // Deficit round robin: a channel keeps the turn while it has deficit
+    // left, and gets weight slices' worth once per turn
+    for (int i = 0; i < WS_MUX_CHANNELS; i++) {
+        ws_mux_queue_t *queue = &mux->queues[mux->turn];
+        if (queue->count > 0 && !mux->granted) {
+            queue->deficit += (int32_t)(queue->weight * mux->slice_bytes);
+            mux->granted = true;
+        }
+        if (queue->count > 0 && queue->deficit > 0) {
+            take_slice(mux, (ws_mux_channel_t)mux->turn, slice);
+            return true;
+        }
+        if (queue->count == 0) {
+            queue->deficit = 0;     // No credit saved up while idle
+        }
+        mux->turn = mux->turn + 1 < WS_MUX_CHANNELS ? mux->turn + 1 : WS_MUX_AUDIO;
+        mux->granted = false;
+    }
+    return false;
+}
+
+void *ws_mux_abort(ws_mux_t *mux, ws_mux_channel_t channel) {
+    if (channel >= WS_MUX_CHANNELS || mux->queues[channel].count == 0) {
+        return NULL;
+    }
+    return pop(mux, &mux->queues[channel]);
+}
+
+bool ws_mux_discard(ws_mux_t *mux, ws_mux_channel_t *channel, void **payload) {
+    for (int i = 0; i < WS_MUX_CHANNELS; i++) {
+        if (mux->queues[i].count > 0) {
+            *channel = (ws_mux_channel_t)i;
+            *payload = pop(mux, &mux->queues[i]);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ws_mux_parse(const uint8_t *frame, size_t len, ws_mux_channel_t *channel, uint8_t *flags, uint8_t *msg_id) {
+    if (len < WS_MUX_HEADER_BYTES) {
+        return false;
+    }
+    uint8_t id = frame[0] & WS_MUX_CHANNEL_MASK;
+    if (id == WS_MUX_CONTROL || id >= WS_MUX_CHANNELS) {
+        return false;
+    }
+    *channel = (ws_mux_channel_t)id;
+    *flags = frame[0] & (WS_MUX_FLAG_START | WS_MUX_FLAG_FINAL);
+    *msg_id = frame[1];
+    return true;
+}
+
+size_t ws_mux_audio_header(uint8_t *out, uint32_t seq, uint8_t flags) {
+    out[0] = (uint8_t)seq;
+    out[1] = (uint8_t)(seq >> 8);
+    out[2] = (uint8_t)(seq >> 16);
+    out[3] = (uint8_t)(seq >> 24);
+    out[4] = flags;
+    return WS_MUX_AUDIO_HEADER_BYTES;
+}
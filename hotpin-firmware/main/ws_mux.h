@@ -0,0 +1,186 @@
+/*
+ * HotPin Firmware - WebSocket Channel Multiplexer
+ *
+ * Control JSON, live audio, images and (later) telemetry share one
+ * WebSocket. Sent whole and in order, a 16 KB audio frame or a 60 KB JPEG
+ * holds a recording_stopped or an ack behind it for as long as it takes to
+ * go out. When both sides agree to the "mux" feature, each binary message
+ * goes instead on a logical channel, in slices of at most slice_bytes, and
+ * this scheduler picks what goes next:
+ *
+ *   - control (text frames, never sliced) goes first, ahead of any slice;
+ *   - the bulk channels share the rest by deficit round robin, each getting
+ *     about weight slices per round.
+ *
+ * So a control message waits for one slice at most. A control message
+ * pushed with an "after" channel (a fence) waits until everything queued on
+ * that channel before it has gone, so recording_stopped never overtakes the
+ * audio it ends; the control messages behind it wait too, keeping control
+ * in order.
+ *
+ * Each slice is one binary WebSocket frame with a 2-byte header:
+ *
+ *   flags (high 2 bits: START, FINAL) | channel (low 4 bits),
+ *   message id (1 byte, per channel, wrapping)
+ *
+ * The receiver joins a channel's slices from START to FINAL. An audio
+ * message carries its own metadata ahead of the PCM, so it pairs with no
+ * control message:
+ *
+ *   seq (4 bytes, little-endian), flags (1 byte: WS_MUX_AUDIO_REPLAY)
+ *
+ * A client switches to slices right after sending "mux_ready", and the
+ * server when it reads it; until then both sides send binary messages
+ * whole. The server's side is ws_mux.py in the webserver.
+ *
+ * No ESP-IDF dependencies; the task side is websocket_message_task in
+ * network_handling.c.
+ */
+
+#ifndef WS_MUX_H
+#define WS_MUX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WS_MUX_HEADER_BYTES     2
+#define WS_MUX_FLAG_START       0x40
+#define WS_MUX_FLAG_FINAL       0x80
+#define WS_MUX_CHANNEL_MASK     0x0f
+#define WS_MUX_QUEUE_LEN        32      // Messages held per channel
+#define WS_MUX_MIN_SLICE        256
+#define WS_MUX_MAX_SLICE        16384
+#define WS_MUX_AUDIO_HEADER_BYTES   5
+#define WS_MUX_AUDIO_REPLAY     0x01    // Spilled to flash while the uplink was down
+
+typedef enum {
+    WS_MUX_CONTROL = 0,     // JSON text frames
+    WS_MUX_AUDIO,           // Uplink audio frames
+    WS_MUX_TTS,             // Downlink TTS frames (server to device)
+    WS_MUX_IMAGE,           // Camera JPEGs
+    WS_MUX_TELEMETRY,       // Reserved for bulk telemetry
+    WS_MUX_CHANNELS
+} ws_mux_channel_t;
+
+typedef struct {
+    void *payload;          // Caller's handle, returned when the message is done
+    const uint8_t *data;
+    size_t len;
+    size_t offset;          // Bytes already sliced
+    uint8_t after;          // Fence channel, WS_MUX_CONTROL for none
+    uint32_t fence;         // Messages of that channel to finish first
+    uint32_t tag;           // Caller's, handed back with each slice
+    uint8_t tag_flags;
+} ws_mux_item_t;
+
+typedef struct {
+    ws_mux_item_t items[WS_MUX_QUEUE_LEN];
+    uint8_t head;
+    uint8_t count;
+    uint8_t msg_id;         // Of the message at the head
+    uint16_t weight;        // Slices per round
+    int32_t deficit;        // Bytes this channel may still send this round
+    uint32_t pushed;        // Messages queued since init
+    uint32_t done;          // Messages fully sliced since init
+} ws_mux_queue_t;
+
+typedef struct {
+    ws_mux_queue_t queues[WS_MUX_CHANNELS];
+    size_t slice_bytes;
+    uint8_t turn;           // Bulk channel whose turn it is
+    bool granted;           // It got its quantum this turn
+    uint32_t held;          // Messages queued on all channels
+} ws_mux_t;
+
+typedef struct {
+    ws_mux_channel_t channel;
+    uint8_t header[WS_MUX_HEADER_BYTES];    // For bulk channels
+    const uint8_t *data;
+    size_t len;
+    void *payload;          // Set on the last slice: the message is done
+    uint32_t tag;           // The message's, as pushed
+    uint8_t tag_flags;
+} ws_mux_slice_t;
+
+/**
+ * @brief Start empty
+ *
+ * @param slice_bytes Largest bulk slice, clamped to WS_MUX_MIN_SLICE ..
+ *                    WS_MUX_MAX_SLICE
+ */
+void ws_mux_init(ws_mux_t *mux, size_t slice_bytes);
+
+/**
+ * @brief Set a bulk channel's share: weight slices per round (at least 1)
+ */
+void ws_mux_set_weight(ws_mux_t *mux, ws_mux_channel_t channel, uint16_t weight);
+
+/**
+ * @brief true if a message for the channel fits
+ */
+bool ws_mux_has_room(const ws_mux_t *mux, ws_mux_channel_t channel);
+
+/**
+ * @brief Queue a message
+ *
+ * @param payload Handed back in the message's last slice (or by
+ *                ws_mux_discard) for the caller to release
+ * @param after   For control messages, a bulk channel whose queued
+ *                messages go first; WS_MUX_CONTROL for none
+ * @param tag, tag_flags Caller's own, copied into each of the message's
+ *                slices
+ * @return false if the channel is full or the message is empty
+ */
+bool ws_mux_push(ws_mux_t *mux, ws_mux_channel_t channel, void *payload, const uint8_t *data, size_t len,
+                 ws_mux_channel_t after, uint32_t tag, uint8_t tag_flags);
+
+/**
+ * @brief Pick the next frame to send
+ *
+ * Control messages come whole and without a header; bulk slices come with
+ * the header to send ahead of data in the same frame.
+ *
+ * @return false if nothing is queued
+ */
+bool ws_mux_next(ws_mux_t *mux, ws_mux_slice_t *slice);
+
+/**
+ * @brief Drop the rest of a channel's message after a failed send
+ *
+ * @return The message's payload, NULL if the channel is empty
+ */
+void *ws_mux_abort(ws_mux_t *mux, ws_mux_channel_t channel);
+
+/**
+ * @brief Take any queued message out, for releasing at shutdown
+ *
+ * @return false once the multiplexer is empty
+ */
+bool ws_mux_discard(ws_mux_t *mux, ws_mux_channel_t *channel, void **payload);
+
+/**
+ * @brief Split a received bulk frame
+ *
+ * @return false if the frame is too short or names no bulk channel
+ */
+bool ws_mux_parse(const uint8_t *frame, size_t len, ws_mux_channel_t *channel, uint8_t *flags, uint8_t *msg_id);
+
+/**
+ * @brief Write the header an audio message starts with
+ *
+ * @param out   WS_MUX_AUDIO_HEADER_BYTES bytes
+ * @param flags WS_MUX_AUDIO_REPLAY or 0
+ * @return WS_MUX_AUDIO_HEADER_BYTES
+ */
+size_t ws_mux_audio_header(uint8_t *out, uint32_t seq, uint8_t flags);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WS_MUX_H */
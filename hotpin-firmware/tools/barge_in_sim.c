@@ -0,0 +1,145 @@
+/*
+ * HotPin Firmware Barge-In Latency Simulation (host)
+ *
+ * Replays button presses during TTS playback against main/state_machine.c
+ * and a timing model of the firmware path from press to microphone live:
+ *
+ *   button poll -> tts_cancel + set_state(RECORDING) + playback flush
+ *   -> state effect task: wait for the I2S mutex (one playback block),
+ *      reinstall I2S in RX mode, send recording_started, publish RECORDING
+ *   -> capture task wakes and starts reading
+ *
+ * Each press lands at a random phase of the 10 ms button poll and of the
+ * 64 ms playback block. Driver costs are typical ESP32 figures; the fixed
+ * 100 ms settle delay in reconfigure_i2s() dominates.
+ *
+ * Usage:
+ *     gcc -O2 -Imain -o barge_in_sim tools/barge_in_sim.c main/state_machine.c
+ *     ./barge_in_sim [presses]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "state_machine.h"
+
+// Firmware constants (main.h, state_management.c)
+#define BUTTON_POLL_US          10000   // button_task loop period
+#define PLAYBACK_BLOCK_US       64000   // I2S_BOUNCE_BYTES at 16 kHz mono 16-bit
+#define I2S_SETTLE_US           100000  // vTaskDelay in reconfigure_i2s()
+#define LED_RECORDING_US        200000  // update_led_pattern() fast blink
+
+// Typical costs on the ESP32 at 240 MHz
+#define WS_ENQUEUE_US           300     // cJSON build + q_ws_messages send
+#define FLUSH_PER_CHUNK_US      20      // free_chunk() per queued TTS chunk
+#define I2S_UNINSTALL_US        600
+#define I2S_INSTALL_US          2000
+#define TASK_SWITCH_US          50
+
+static uint32_t rng_state = 0x12345678u;
+
+static uint32_t next_rand(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint32_t uniform_us(uint32_t max_us) {
+    return next_rand() % max_us;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Press -> microphone live for one press. led_gates_publish models the
+// effect order before barge-in, where RECORDING was published after the
+// LED blink.
+static uint32_t simulate_press(uint32_t effects, int queued_chunks, int led_gates_publish) {
+    uint32_t t = uniform_us(BUTTON_POLL_US);            // Until the next poll sees the press
+
+    // button_task: tts_cancel, set_state(), audio_playback_flush()
+    t += WS_ENQUEUE_US + TASK_SWITCH_US;
+    t += queued_chunks * FLUSH_PER_CHUNK_US;
+
+    // state_effect_task
+    t += TASK_SWITCH_US;
+    if (effects & SM_EFFECT_I2S_RX) {
+        t += uniform_us(PLAYBACK_BLOCK_US);             // Block being written holds the I2S mutex
+        t += I2S_UNINSTALL_US + I2S_SETTLE_US + I2S_INSTALL_US;
+    }
+    if (effects & SM_EFFECT_MSG_RECORDING_STARTED) {
+        t += WS_ENQUEUE_US;
+    }
+    if (led_gates_publish && (effects & SM_EFFECT_LED)) {
+        t += LED_RECORDING_US;
+    }
+
+    // audio_capture_task wakes on the RECORDING bit
+    return t + TASK_SWITCH_US;
+}
+
+static void report(const char *label, uint32_t *samples, int count) {
+    qsort(samples, count, sizeof(uint32_t), compare_u32);
+    uint64_t total = 0;
+    for (int i = 0; i < count; i++) {
+        total += samples[i];
+    }
+    printf("%-22s avg %6.1f ms  p50 %6.1f ms  p95 %6.1f ms  max %6.1f ms\n", label,
+           total / 1000.0 / count, samples[count / 2] / 1000.0,
+           samples[count * 95 / 100] / 1000.0, samples[count - 1] / 1000.0);
+}
+
+int main(int argc, char **argv) {
+    int presses = argc > 1 ? atoi(argv[1]) : 10000;
+    if (presses <= 0) {
+        fprintf(stderr, "Error: presses must be positive\n");
+        return 2;
+    }
+
+    if (!sm_is_valid_transition(CLIENT_STATE_PLAYING, CLIENT_STATE_RECORDING)) {
+        printf("FAIL: PLAYING -> RECORDING is not a declared transition\n");
+        return 1;
+    }
+    uint32_t effects = sm_transition_effects(CLIENT_STATE_PLAYING, CLIENT_STATE_RECORDING);
+    int failures = 0;
+    if (!(effects & SM_EFFECT_I2S_RX) || !(effects & SM_EFFECT_MSG_RECORDING_STARTED)) {
+        printf("FAIL: PLAYING -> RECORDING must reinstall I2S in RX mode and send recording_started\n");
+        failures++;
+    }
+
+    uint32_t *current = malloc(presses * sizeof(uint32_t));
+    uint32_t *led_first = malloc(presses * sizeof(uint32_t));
+    if (!current || !led_first) {
+        return 2;
+    }
+
+    sm_reset_stats();
+    for (int i = 0; i < presses; i++) {
+        int queued = (int)uniform_us(17);   // 0..QUEUE_LEN_PLAYBACK chunks waiting
+        current[i] = simulate_press(effects, queued, 0);
+        led_first[i] = simulate_press(effects, queued, 1);
+        sm_record_latency(CLIENT_STATE_PLAYING, CLIENT_STATE_RECORDING, current[i]);
+    }
+
+    const sm_edge_stats_t *edge = sm_get_edge_stats(CLIENT_STATE_PLAYING, CLIENT_STATE_RECORDING);
+    printf("Edge %s -> %s: %u presses simulated\n", state_to_string(CLIENT_STATE_PLAYING),
+           state_to_string(CLIENT_STATE_RECORDING), edge->count);
+    report("Press -> mic live:", current, presses);
+    report("(LED before publish):", led_first, presses);
+
+    // The settle delay and one playback block bound the worst case
+    uint32_t bound = BUTTON_POLL_US + PLAYBACK_BLOCK_US + I2S_SETTLE_US + 20000;
+    if (edge->max_us > bound) {
+        printf("FAIL: worst case %.1f ms exceeds %.1f ms\n", edge->max_us / 1000.0, bound / 1000.0);
+        failures++;
+    }
+
+    free(current);
+    free(led_first);
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+"""
+HotPin Firmware Earcon Bundle Builder
+
+Packs the feedback clips played by main/earcon.c into a binary image for the
+'earcons' flash partition. For each clip, a WAV file named <clip>.wav in the
+assets directory is used if present (16-bit mono, 16 kHz); otherwise a short
+tone sequence is synthesized so the firmware always has something to play.
+
+Usage:
+    python tools/build_earcons.py --out build/earcons.bin [--assets assets/earcons]
+"""
+
+import argparse
+import math
+import struct
+import sys
+import wave
+from pathlib import Path
+
+# Must match main/earcon.h
+BUNDLE_MAGIC = 0x43455048  # "HPEC"
+BUNDLE_VERSION = 1
+NAME_LEN = 16
+FORMAT_PCM16 = 0
+HEADER_FMT = "<IHH"
+ENTRY_FMT = "<16sIIII"
+
+SAMPLE_RATE = 16000
+PARTITION_SIZE = 256 * 1024
+CLIP_ALIGN = 4
+
+# (frequency Hz, duration ms) per tone; 0 Hz is a gap
+SYNTH_CLIPS = {
+    "thinking":    [(660, 90), (0, 40), (880, 120)],
+    "unreachable": [(784, 150), (0, 40), (622, 150), (0, 40), (466, 260)],
+    "repeat":      [(880, 80), (0, 70), (880, 80)],
+}
+
+def synth_tones(tones, amplitude=0.35):
+    """Render a tone sequence as PCM16 with 5 ms fades to avoid clicks."""
+    samples = []
+    fade = int(SAMPLE_RATE * 0.005)
+    for freq, ms in tones:
+        count = SAMPLE_RATE * ms // 1000
+        for i in range(count):
+            if freq == 0:
+                samples.append(0)
+                continue
+            env = min(1.0, i / fade, (count - 1 - i) / fade) if fade else 1.0
+            value = amplitude * env * math.sin(2 * math.pi * freq * i / SAMPLE_RATE)
+            samples.append(int(value * 32767))
+    return struct.pack("<%dh" % len(samples), *samples)
+
+def load_wav(path):
+    """Return PCM16 bytes from a 16 kHz mono 16-bit WAV, or exit with an error."""
+    with wave.open(str(path), "rb") as wav:
+        if wav.getnchannels() != 1 or wav.getsampwidth() != 2 or wav.getframerate() != SAMPLE_RATE:
+            sys.exit(f"Error: {path} must be 16-bit mono {SAMPLE_RATE} Hz")
+        return wav.readframes(wav.getnframes())
+
+def build_bundle(clips):
+    """Lay out header, entry table and clip data; returns the image bytes."""
+    table_end = struct.calcsize(HEADER_FMT) + struct.calcsize(ENTRY_FMT) * len(clips)
+    offset = (table_end + CLIP_ALIGN - 1) // CLIP_ALIGN * CLIP_ALIGN
+
+    entries = []
+    data = bytearray()
+    for name, pcm in clips:
+        entries.append(struct.pack(ENTRY_FMT, name.encode(), offset + len(data), len(pcm),
+                                   SAMPLE_RATE, FORMAT_PCM16))
+        data += pcm
+        data += b"\0" * (-len(data) % CLIP_ALIGN)
+
+    image = struct.pack(HEADER_FMT, BUNDLE_MAGIC, BUNDLE_VERSION, len(clips)) + b"".join(entries)
+    image += b"\0" * (offset - len(image))
+    return image + bytes(data)
+
+def main():
+    parser = argparse.ArgumentParser(description="Build the HotPin earcon partition image")
+    parser.add_argument("--out", required=True, help="Output image path (e.g. build/earcons.bin)")
+    parser.add_argument("--assets", default=None, help="Directory with <clip>.wav overrides")
+    parser.add_argument("--size", type=int, default=PARTITION_SIZE,
+                        help="Partition size in bytes (default: %(default)s)")
+    args = parser.parse_args()
+
+    assets = Path(args.assets) if args.assets else None
+    clips = []
+    for name, tones in SYNTH_CLIPS.items():
+        if len(name) > NAME_LEN:
+            sys.exit(f"Error: clip name '{name}' longer than {NAME_LEN} bytes")
+        wav_path = assets / f"{name}.wav" if assets else None
+        if wav_path and wav_path.is_file():
+            pcm = load_wav(wav_path)
+            source = wav_path.name
+        else:
+            pcm = synth_tones(tones)
+            source = "synthesized"
+        clips.append((name, pcm))
+        print(f"  {name:<12} {len(pcm) / 2 / SAMPLE_RATE * 1000:6.0f} ms  ({source})")
+
+    image = build_bundle(clips)
+    if len(image) > args.size:
+        sys.exit(f"Error: bundle is {len(image)} bytes, partition holds {args.size}")
+
+    out = Path(args.out)
+    out.parent.mkdir(parents=True, exist_ok=True)
+    out.write_bytes(image)
+    print(f"Earcon bundle: {len(clips)} clips, {len(image)} of {args.size} bytes -> {out}")
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
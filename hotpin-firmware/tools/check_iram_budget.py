@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""
+HotPin Firmware IRAM Budget Check
+
+Reads the linker map produced by the ESP-IDF build and reports how much of
+the IRAM0 segment is used. Exits non-zero when less than --min-free bytes
+remain, so IRAM placement of hot paths (CONFIG_HOTPIN_PERF_PROFILE) fails
+the build instead of overflowing on the next change.
+
+Usage:
+    python tools/check_iram_budget.py build/hotpin-firmware.map --min-free 4096
+"""
+
+import argparse
+import re
+import sys
+from pathlib import Path
+
+SEGMENT_RE = re.compile(r"^(iram0_0_seg|dram0_0_seg)\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)")
+SYMBOL_RE = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+(_iram_start|_iram_end|_iram_text_end)\s+=")
+
+def parse_map(map_path):
+    """Return (segments, symbols) parsed from an ESP-IDF linker map file."""
+    segments = {}
+    symbols = {}
+    with open(map_path, "r", errors="replace") as f:
+        for line in f:
+            match = SEGMENT_RE.match(line)
+            if match and match.group(1) not in segments:
+                segments[match.group(1)] = (int(match.group(2), 16), int(match.group(3), 16))
+                continue
+            match = SYMBOL_RE.match(line)
+            if match and match.group(2) not in symbols:
+                symbols[match.group(2)] = int(match.group(1), 16)
+    return segments, symbols
+
+def main():
+    parser = argparse.ArgumentParser(description="Check IRAM headroom in an ESP-IDF linker map")
+    parser.add_argument("map_file", help="Path to the .map file (e.g. build/hotpin-firmware.map)")
+    parser.add_argument("--min-free", type=int, default=4096,
+                        help="Minimum free IRAM0 bytes required (default: 4096)")
+    args = parser.parse_args()
+
+    map_path = Path(args.map_file)
+    if not map_path.exists():
+        print(f"Error: map file {map_path} not found", file=sys.stderr)
+        return 2
+
+    segments, symbols = parse_map(map_path)
+    if "iram0_0_seg" not in segments or "_iram_start" not in symbols or "_iram_end" not in symbols:
+        print("Error: IRAM segment or symbols not found in map file", file=sys.stderr)
+        return 2
+
+    origin, length = segments["iram0_0_seg"]
+    used = symbols["_iram_end"] - symbols["_iram_start"]
+    free = length - used
+
+    print(f"IRAM0: {used} / {length} bytes used ({used * 100.0 / length:.1f}%), {free} bytes free")
+
+    if free < args.min_free:
+        print(f"Error: IRAM headroom {free} bytes is below the required {args.min_free} bytes. "
+              f"Move functions out of IRAM or lower CONFIG_HOTPIN_IRAM_MIN_FREE.", file=sys.stderr)
+        return 1
+
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
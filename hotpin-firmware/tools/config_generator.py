@@ -77,6 +77,7 @@ def generate_config_h(env_vars, output_path):
 // WebSocket Configuration
 #define WEBSOCKET_URL "{env_vars.get('WEBSOCKET_URL', 'ws://10.50.92.58:8000/ws')}"
 #define WEBSOCKET_TOKEN "{env_vars.get('WEBSOCKET_TOKEN', 'mysecrettoken123')}"
+#define WEBSOCKET_FALLBACK_URLS "{env_vars.get('WEBSOCKET_FALLBACK_URLS') or ''}"
 
 // Audio Configuration
 #define CHUNK_SIZE_BYTES {env_vars.get('CHUNK_SIZE_BYTES', '16000')}
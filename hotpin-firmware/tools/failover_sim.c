@@ -0,0 +1,363 @@
+/*
+ * HotPin Firmware Server Failover Simulation (host)
+ *
+ * Runs main/endpoint_list.c with the hedged connect of network_handling.c
+ * against two servers, kills the primary and measures the time from the
+ * device noticing the lost connection to a completed WebSocket upgrade.
+ *
+ * The model:
+ *
+ *   - a connect to a working server completes after two round trips (TCP
+ *     handshake, then the upgrade) plus --proc-ms and a random
+ *     0..--jitter-ms. A killed server refuses the connect after one round
+ *     trip; a server whose host is down never answers, so the attempt lasts
+ *     until the connect timeout; an overloaded one upgrades after 1-4 s.
+ *   - each round takes the two best endpoints, starts the first, and starts
+ *     the second after the hedge delay or as soon as the first has failed.
+ *     The first upgrade wins and ends the round; the loser is cancelled.
+ *     When no attempt connects within the connect timeout, the device waits
+ *     for the first endpoint to leave its backoff and starts another round.
+ *   - before the kill the device has connected to the primary 10 times, so
+ *     the primary has a high score and the secondary its configured one.
+ *     After the kill the connection is lost --reconnects times (a Wi-Fi drop
+ *     each time after the first), with --gap-ms connected in between. The
+ *     primary stays down for the whole run; the list carries its state
+ *     across reconnects, as it does on the device.
+ *
+ * Four policies are compared: the firmware before failover (one URL, a 5 s
+ * delay, then retries of the same server 1, 2, 4 ... s apart until the
+ * watchdog restarts the device at 50 s), sequential failover (the second
+ * endpoint only after the first has failed or timed out), hedged
+ * (--hedge-ms, CONFIG_HOTPIN_WS_HEDGE_DELAY_MS) and a race of both at once.
+ * Detection of the lost connection is left out: a killed server resets it
+ * at once, a dead host is found by the ping timeout, the same for every
+ * policy.
+ *
+ * Usage:
+ *     gcc -O2 -Imain -o failover_sim tools/failover_sim.c main/endpoint_list.c
+ *     ./failover_sim                                  # all scenarios and policies
+ *     ./failover_sim [--rtt-ms 10] [--proc-ms 15] [--jitter-ms 20] [--timeout-ms 5000]
+ *                    [--hedge-ms 200] [--reconnects 5] [--gap-ms 60000] [--trials 200] [--seed 1]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "endpoint_list.h"
+
+// Firmware constants (network_handling.c)
+#define HEDGE_COUNT         2
+#define RETRY_MIN_MS        250
+#define LEGACY_DELAY_MS     5000        // Old cleanup delay before reconnecting
+#define LEGACY_RESTART_MS   50000       // websocket_task watchdog: 10 failures 5 s apart
+#define WARMUP_CONNECTS     10
+#define MAX_TRIALS          2000
+#define NEVER               1e300
+
+typedef enum {
+    SERVER_UP = 0,
+    SERVER_REFUSED,     // Process killed, host up: connection refused
+    SERVER_SILENT,      // Host down: no answer until the timeout
+    SERVER_SLOW,        // Overloaded: upgrade after 1-4 s
+} server_state_t;
+
+typedef struct {
+    const char *name;
+    const char *label;
+    server_state_t primary;
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+    { "killed",    "primary killed (refused)",   SERVER_REFUSED },
+    { "host-down", "primary host down (silent)", SERVER_SILENT  },
+    { "slow",      "primary overloaded (1-4 s)", SERVER_SLOW    },
+    { "healthy",   "both up (Wi-Fi drop)",       SERVER_UP      },
+};
+
+typedef enum {
+    POLICY_LEGACY = 0,
+    POLICY_SEQUENTIAL,
+    POLICY_HEDGED,
+    POLICY_RACE,
+} policy_t;
+
+static const char *policy_names[] = { "legacy", "sequential", "hedged", "race" };
+
+typedef struct {
+    double rtt_ms;
+    double proc_ms;
+    double jitter_ms;
+    double timeout_ms;
+    double hedge_ms;
+    double gap_ms;
+    int reconnects;
+    int trials;
+} params_t;
+
+typedef struct {
+    double first_mean_ms;
+    double first_p95_ms;
+    double later_mean_ms;
+    double attempts;        // Connects started per reconnect
+    double on_secondary;    // Share of reconnects that ended on the secondary
+    int restarts;           // Trials where the device would have restarted
+} result_t;
+
+static unsigned long rng_state = 1;
+
+static double uniform(double max) {
+    rng_state = rng_state * 6364136223846793005UL + 1442695040888963407UL;
+    return max * (double)((rng_state >> 33) & 0x7fffffff) / 2147483648.0;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Outcome of a connect started at start_ms: *ok_ms for a completed upgrade,
+// *fail_ms for a refusal, NEVER for whichever does not happen
+static void connect_outcome(const params_t *p, server_state_t state, double start_ms, double *ok_ms, double *fail_ms) {
+    *ok_ms = NEVER;
+    *fail_ms = NEVER;
+    switch (state) {
+    case SERVER_UP:
+        *ok_ms = start_ms + 2 * p->rtt_ms + p->proc_ms + uniform(p->jitter_ms);
+        break;
+    case SERVER_REFUSED:
+        *fail_ms = start_ms + p->rtt_ms;
+        break;
+    case SERVER_SILENT:
+        break;
+    case SERVER_SLOW:
+        *ok_ms = start_ms + 2 * p->rtt_ms + 1000.0 + uniform(3000.0);
+        break;
+    }
+}
+
+// One round of connect_hedged(); returns the winning endpoint or -1, and
+// moves *now_ms to the end of the round
+static int connect_round(endpoint_list_t *list, const server_state_t *servers, const params_t *p, double hedge_ms,
+                         double *now_ms, int *attempts) {
+    int picked[HEDGE_COUNT];
+    int count = endpoint_list_pick(list, (uint32_t)*now_ms, picked, HEDGE_COUNT);
+    if (count == 0) {
+        return -1;
+    }
+
+    double start[HEDGE_COUNT], ok[HEDGE_COUNT], fail[HEDGE_COUNT];
+    double t0 = *now_ms;
+    double deadline = t0 + p->timeout_ms;
+    start[0] = t0;
+    connect_outcome(p, servers[picked[0]], t0, &ok[0], &fail[0]);
+    int started = 1;
+    if (count > 1) {
+        // Started at the hedge delay, or as soon as the first has failed,
+        // unless the first has connected by then
+        double at = t0 + hedge_ms;
+        if (fail[0] < at) {
+            at = fail[0];
+        }
+        if (ok[0] > at && at < deadline) {
+            start[1] = at;
+            connect_outcome(p, servers[picked[1]], at, &ok[1], &fail[1]);
+            started = 2;
+        }
+    }
+    *attempts += started;
+
+    int winner = -1;
+    double end = deadline;
+    for (int i = 0; i < started; i++) {
+        if (ok[i] < end) {
+            end = ok[i];
+            winner = i;
+        }
+    }
+    if (winner < 0) {
+        // All failed before the deadline: the round ends with the last failure
+        double last_fail = 0.0;
+        for (int i = 0; i < started; i++) {
+            last_fail = fail[i] > last_fail ? fail[i] : last_fail;
+        }
+        if (last_fail < end) {
+            end = last_fail;
+        }
+    }
+    *now_ms = end;
+
+    for (int i = 0; i < started; i++) {
+        if (i == winner) {
+            endpoint_list_note_success(list, picked[i], (uint32_t)(ok[i] - start[i]));
+        } else if (fail[i] <= end || winner < 0) {
+            endpoint_list_note_failure(list, picked[i], (uint32_t)end);
+        } else {
+            endpoint_list_note_slow(list, picked[i]);
+        }
+    }
+    return winner < 0 ? -1 : picked[winner];
+}
+
+// reconnect_websocket(): rounds until one connects. Returns the endpoint, or
+// -1 if it takes longer than the old watchdog would have allowed
+static int reconnect(endpoint_list_t *list, const server_state_t *servers, const params_t *p, double hedge_ms,
+                     double *now_ms, int *attempts) {
+    double lost_ms = *now_ms;
+    while (*now_ms - lost_ms < LEGACY_RESTART_MS) {
+        int endpoint = connect_round(list, servers, p, hedge_ms, now_ms, attempts);
+        if (endpoint >= 0) {
+            return endpoint;
+        }
+        double wait_ms = endpoint_list_wait_ms(list, (uint32_t)*now_ms);
+        if (wait_ms < RETRY_MIN_MS) {
+            wait_ms = RETRY_MIN_MS;
+        } else if (wait_ms > ENDPOINT_BACKOFF_MAX_MS) {
+            wait_ms = ENDPOINT_BACKOFF_MAX_MS;
+        }
+        *now_ms += wait_ms;
+    }
+    return -1;
+}
+
+// The firmware before failover: the configured URL only
+static int reconnect_legacy(const server_state_t *servers, const params_t *p, double *now_ms, int *attempts) {
+    double lost_ms = *now_ms;
+    double backoff_ms = 1000.0;
+    *now_ms += LEGACY_DELAY_MS;
+    while (*now_ms - lost_ms < LEGACY_RESTART_MS) {
+        double ok, fail;
+        connect_outcome(p, servers[0], *now_ms, &ok, &fail);
+        (*attempts)++;
+        if (ok < *now_ms + p->timeout_ms) {
+            *now_ms = ok;
+            return 0;
+        }
+        *now_ms = (fail < NEVER ? fail : *now_ms + p->timeout_ms) + backoff_ms;
+        backoff_ms = backoff_ms * 2 > 60000.0 ? 60000.0 : backoff_ms * 2;
+    }
+    *now_ms = lost_ms + LEGACY_RESTART_MS;
+    return -1;
+}
+
+static void run(const scenario_t *scenario, policy_t policy, const params_t *p, result_t *result) {
+    static double firsts[MAX_TRIALS];
+    double hedge_ms = policy == POLICY_SEQUENTIAL ? p->timeout_ms : policy == POLICY_RACE ? 0.0 : p->hedge_ms;
+    double later_total = 0.0;
+    int later_count = 0, attempts = 0, secondary = 0;
+    memset(result, 0, sizeof(*result));
+
+    for (int t = 0; t < p->trials; t++) {
+        server_state_t servers[2] = { SERVER_UP, SERVER_UP };
+        endpoint_list_t list;
+        endpoint_list_init(&list);
+        endpoint_list_add(&list, "ws://primary:8000/ws", ENDPOINT_CONFIGURED);
+        endpoint_list_add(&list, "ws://secondary:8000/ws", ENDPOINT_CONFIGURED);
+        for (int i = 0; i < WARMUP_CONNECTS; i++) {
+            endpoint_list_note_success(&list, 0, (uint32_t)(2 * p->rtt_ms + p->proc_ms));
+        }
+
+        double now_ms = 100000.0;
+        int current = 0;
+        servers[0] = scenario->primary;
+        for (int r = 0; r < p->reconnects; r++) {
+            endpoint_list_note_drop(&list, current);
+            double lost_ms = now_ms;
+            current = policy == POLICY_LEGACY ? reconnect_legacy(servers, p, &now_ms, &attempts)
+                                              : reconnect(&list, servers, p, hedge_ms, &now_ms, &attempts);
+            double took_ms = now_ms - lost_ms;
+            if (current < 0) {
+                // The device restarts and comes back to the same list state
+                result->restarts += (r == 0);
+                current = 0;
+            }
+            secondary += (current == 1);
+            if (r == 0) {
+                firsts[t] = took_ms;
+                result->first_mean_ms += took_ms / p->trials;
+            } else {
+                later_total += took_ms;
+                later_count++;
+            }
+            now_ms += p->gap_ms;
+        }
+    }
+
+    qsort(firsts, p->trials, sizeof(firsts[0]), cmp_double);
+    result->first_p95_ms = firsts[(int)(0.95 * (p->trials - 1))];
+    result->later_mean_ms = later_count ? later_total / later_count : 0.0;
+    result->attempts = (double)attempts / (p->trials * p->reconnects);
+    result->on_secondary = (double)secondary / (p->trials * p->reconnects);
+}
+
+static void print_row(const char *name, const char *policy, const result_t *r) {
+    if (r->restarts) {
+        printf("%-10s %-10s %10s %9s %10s %9.2f %9.0f%%  (restart in %d/%d)\n", name, policy, "never", "-", "never",
+               r->attempts, r->on_secondary * 100.0, r->restarts, r->restarts);
+        return;
+    }
+    printf("%-10s %-10s %10.0f %9.0f %10.0f %9.2f %9.0f%%\n", name, policy, r->first_mean_ms, r->first_p95_ms,
+           r->later_mean_ms, r->attempts, r->on_secondary * 100.0);
+}
+
+static int usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [--rtt-ms 10] [--proc-ms 15] [--jitter-ms 20] [--timeout-ms 5000]\n"
+            "          [--hedge-ms 200] [--reconnects 5] [--gap-ms 60000] [--trials 200] [--seed 1]\n", prog);
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    params_t p = { 10.0, 15.0, 20.0, 5000.0, 200.0, 60000.0, 5, 200 };
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            return usage(argv[0]);
+        }
+        const char *value = argv[++i];
+        if (strcmp(argv[i - 1], "--rtt-ms") == 0) {
+            p.rtt_ms = atof(value);
+        } else if (strcmp(argv[i - 1], "--proc-ms") == 0) {
+            p.proc_ms = atof(value);
+        } else if (strcmp(argv[i - 1], "--jitter-ms") == 0) {
+            p.jitter_ms = atof(value);
+        } else if (strcmp(argv[i - 1], "--timeout-ms") == 0) {
+            p.timeout_ms = atof(value);
+        } else if (strcmp(argv[i - 1], "--hedge-ms") == 0) {
+            p.hedge_ms = atof(value);
+        } else if (strcmp(argv[i - 1], "--reconnects") == 0) {
+            p.reconnects = atoi(value);
+        } else if (strcmp(argv[i - 1], "--gap-ms") == 0) {
+            p.gap_ms = atof(value);
+        } else if (strcmp(argv[i - 1], "--trials") == 0) {
+            p.trials = atoi(value);
+        } else if (strcmp(argv[i - 1], "--seed") == 0) {
+            rng_state = strtoul(value, NULL, 10);
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if (p.trials < 1 || p.trials > MAX_TRIALS) {
+        fprintf(stderr, "--trials must be 1..%d\n", MAX_TRIALS);
+        return 2;
+    }
+    if (p.reconnects < 1) {
+        fprintf(stderr, "--reconnects must be at least 1\n");
+        return 2;
+    }
+
+    printf("connection lost -> upgrade complete, rtt %.0f ms, timeout %.0f ms, hedge %.0f ms, %d trials\n\n",
+           p.rtt_ms, p.timeout_ms, p.hedge_ms, p.trials);
+    printf("%-10s %-10s %10s %9s %10s %9s %10s\n", "scenario", "policy", "first ms", "p95 ms", "later ms",
+           "attempts", "secondary");
+    for (size_t s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++) {
+        for (int policy = POLICY_LEGACY; policy <= POLICY_RACE; policy++) {
+            result_t result;
+            unsigned long seed = rng_state;
+            run(&scenarios[s], (policy_t)policy, &p, &result);
+            rng_state = seed;  // Same jitter for every policy
+            print_row(scenarios[s].name, policy_names[policy], &result);
+        }
+    }
+    return 0;
+}
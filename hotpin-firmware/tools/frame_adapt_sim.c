@@ -0,0 +1,245 @@
+/*
+ * HotPin Firmware Adaptive Frame Simulation (host)
+ *
+ * Runs main/frame_adapt.c against a model of the uplink and measures the
+ * time from the end of speech to the last byte of the recording arriving at
+ * the server, with adaptive frames and with fixed frames for comparison.
+ *
+ * The model:
+ *
+ *   - capture fills one frame at a time in real time, and the size of each
+ *     frame is picked when it starts, as the capture task does. Speech ends
+ *     part way through a frame, and its last samples leave the device only
+ *     once that frame has filled, so the tail includes the rest of it.
+ *   - one sender puts frames on the link in order. Each takes --overhead-ms
+ *     (metadata message, headers, task wakeups), plus the payload at
+ *     --bw-kbps, plus a random 0..--jitter-ms. Bytes arrive half a round trip
+ *     (--rtt-ms) after they are sent.
+ *   - the server acks every 4th frame, which gives the controller its round
+ *     trip, measured from when the frame was queued
+ *
+ * Each run records --recordings utterances of --speech-ms, with a random
+ * extra 0..500 ms so the end of speech falls anywhere in a frame. The
+ * controller carries its state from one recording to the next, as it does
+ * on the device. With no --bw-kbps the built-in link presets are run.
+ *
+ * Usage:
+ *     gcc -O2 -Imain -o frame_adapt_sim tools/frame_adapt_sim.c main/frame_adapt.c
+ *     ./frame_adapt_sim                               # all presets, adaptive vs 500 ms
+ *     ./frame_adapt_sim --bw-kbps 400 --rtt-ms 250 --overhead-ms 12 --jitter-ms 40
+ *                       [--speech-ms 3000] [--recordings 50] [--fixed-ms 500] [--seed 1]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "frame_adapt.h"
+
+// Firmware constants (main.h)
+#define SAMPLE_RATE         16000
+#define BYTES_PER_MS        (SAMPLE_RATE * 2 / 1000)
+#define CHUNK_BYTES         16000
+#define MIN_FRAME_BYTES     (FRAME_ADAPT_MIN_MS * BYTES_PER_MS)
+#define ACK_EVERY           4       // server.py acks every 4th chunk
+#define MAX_FRAMES          4096
+#define MAX_RECORDINGS      1000
+
+typedef struct {
+    const char *name;
+    double bw_kbps;
+    double rtt_ms;
+    double overhead_ms;
+    double jitter_ms;
+} link_t;
+
+static const link_t presets[] = {
+    { "lan",        8000.0,   8.0,  3.0,   2.0 },
+    { "wifi-busy",  1500.0,  60.0,  5.0,  15.0 },
+    { "weak",        400.0, 250.0, 12.0,  40.0 },
+    { "congested",   300.0, 400.0, 15.0,  60.0 },
+};
+
+typedef struct {
+    double ready_ms;    // Captured and queued
+    double sent_ms;     // Off the sender
+    double arrive_ms;   // Last byte at the server
+    uint32_t bytes;
+    double send_ms;
+} frame_t;
+
+typedef struct {
+    double tail_mean_ms;
+    double tail_p95_ms;
+    double frame_mean_ms;
+    double rtt_ms;
+    uint32_t grows;
+    uint32_t shrinks;
+} result_t;
+
+static unsigned long rng_state = 1;
+
+static double uniform(double max) {
+    rng_state = rng_state * 6364136223846793005UL + 1442695040888963407UL;
+    return max * (double)((rng_state >> 33) & 0x7fffffff) / 2147483648.0;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Apply sends and acks that happened up to now_ms, in time order
+static void deliver_events(frame_adapt_t *fa, frame_t *frames, int count, int *next_sent, int *next_ack,
+                           double rtt_ms, double now_ms) {
+    while (1) {
+        double sent_at = *next_sent < count ? frames[*next_sent].sent_ms : 1e300;
+        while (*next_ack < count && (*next_ack % ACK_EVERY) != ACK_EVERY - 1) {
+            (*next_ack)++;
+        }
+        double ack_at = *next_ack < count ? frames[*next_ack].arrive_ms + rtt_ms / 2 : 1e300;
+        if (sent_at > now_ms && ack_at > now_ms) {
+            return;
+        }
+
+        if (sent_at <= ack_at) {
+            frame_t *f = &frames[*next_sent];
+            uint32_t queued = 0;
+            for (int i = *next_sent + 1; i < count && frames[i].ready_ms <= f->sent_ms; i++) {
+                queued++;
+            }
+            frame_adapt_note_sent(fa, f->bytes, (uint32_t)(f->send_ms * 1000), queued);
+            (*next_sent)++;
+        } else {
+            frame_t *f = &frames[*next_ack];
+            frame_adapt_note_rtt(fa, (uint32_t)((ack_at - f->ready_ms) * 1000));
+            (*next_ack)++;
+        }
+    }
+}
+
+static void run(const link_t *link, uint32_t fixed_ms, uint32_t speech_ms, int recordings, result_t *result) {
+    static frame_t frames[MAX_FRAMES];
+    static double tails[MAX_RECORDINGS];
+    frame_adapt_t fa;
+    frame_adapt_init(&fa, BYTES_PER_MS, MIN_FRAME_BYTES, CHUNK_BYTES);
+
+    double now_ms = 0.0;
+    double link_free_ms = 0.0;
+    double frame_ms_total = 0.0;
+    int frame_total = 0;
+    memset(result, 0, sizeof(*result));
+
+    for (int r = 0; r < recordings; r++) {
+        double speech_end_ms = now_ms + speech_ms + uniform(500.0);
+        int count = 0, next_sent = 0, next_ack = 0;
+
+        while (now_ms < speech_end_ms && count < MAX_FRAMES) {
+            deliver_events(&fa, frames, count, &next_sent, &next_ack, link->rtt_ms, now_ms);
+            uint32_t bytes = fixed_ms ? fixed_ms * BYTES_PER_MS : frame_adapt_bytes(&fa);
+
+            frame_t *f = &frames[count++];
+            f->bytes = bytes;
+            f->ready_ms = now_ms + (double)bytes / BYTES_PER_MS;
+            f->send_ms = link->overhead_ms + bytes * 8.0 / link->bw_kbps + uniform(link->jitter_ms);
+            double start_ms = f->ready_ms > link_free_ms ? f->ready_ms : link_free_ms;
+            f->sent_ms = start_ms + f->send_ms;
+            f->arrive_ms = f->sent_ms + link->rtt_ms / 2;
+            link_free_ms = f->sent_ms;
+
+            now_ms = f->ready_ms;
+            frame_ms_total += (double)bytes / BYTES_PER_MS;
+            frame_total++;
+        }
+
+        tails[r] = frames[count - 1].arrive_ms - speech_end_ms;
+        result->tail_mean_ms += tails[r] / recordings;
+
+        // Idle until the next utterance; everything outstanding is delivered
+        now_ms = frames[count - 1].arrive_ms + link->rtt_ms + 2000.0;
+        deliver_events(&fa, frames, count, &next_sent, &next_ack, link->rtt_ms, now_ms);
+    }
+
+    qsort(tails, recordings, sizeof(tails[0]), cmp_double);
+    result->tail_p95_ms = tails[(int)(0.95 * (recordings - 1))];
+    result->frame_mean_ms = frame_ms_total / frame_total;
+    result->rtt_ms = fa.rtt_us / 1000.0;
+    result->grows = fa.grows;
+    result->shrinks = fa.shrinks;
+}
+
+static void print_row(const char *name, const char *mode, const result_t *r) {
+    printf("%-10s %-9s %10.0f %9.0f %10.0f %8.0f %5u/%-5u\n", name, mode, r->tail_mean_ms, r->tail_p95_ms,
+           r->frame_mean_ms, r->rtt_ms, r->grows, r->shrinks);
+}
+
+static int usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [--bw-kbps K --rtt-ms R --overhead-ms O --jitter-ms J]\n"
+            "          [--speech-ms 3000] [--recordings 50] [--fixed-ms 500] [--seed 1]\n", prog);
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    link_t custom = { "custom", 0.0, 50.0, 5.0, 10.0 };
+    uint32_t speech_ms = 3000;
+    uint32_t fixed_ms = 500;
+    int recordings = 50;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            return usage(argv[0]);
+        }
+        const char *value = argv[++i];
+        if (strcmp(argv[i - 1], "--bw-kbps") == 0) {
+            custom.bw_kbps = atof(value);
+        } else if (strcmp(argv[i - 1], "--rtt-ms") == 0) {
+            custom.rtt_ms = atof(value);
+        } else if (strcmp(argv[i - 1], "--overhead-ms") == 0) {
+            custom.overhead_ms = atof(value);
+        } else if (strcmp(argv[i - 1], "--jitter-ms") == 0) {
+            custom.jitter_ms = atof(value);
+        } else if (strcmp(argv[i - 1], "--speech-ms") == 0) {
+            speech_ms = (uint32_t)atoi(value);
+        } else if (strcmp(argv[i - 1], "--recordings") == 0) {
+            recordings = atoi(value);
+        } else if (strcmp(argv[i - 1], "--fixed-ms") == 0) {
+            fixed_ms = (uint32_t)atoi(value);
+        } else if (strcmp(argv[i - 1], "--seed") == 0) {
+            rng_state = strtoul(value, NULL, 10);
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if (recordings < 1 || recordings > MAX_RECORDINGS) {
+        fprintf(stderr, "--recordings must be 1..%d\n", MAX_RECORDINGS);
+        return 2;
+    }
+    if (fixed_ms < FRAME_ADAPT_MIN_MS || fixed_ms > FRAME_ADAPT_MAX_MS) {
+        fprintf(stderr, "--fixed-ms must be %d..%d\n", FRAME_ADAPT_MIN_MS, FRAME_ADAPT_MAX_MS);
+        return 2;
+    }
+
+    const link_t *links = presets;
+    int link_count = sizeof(presets) / sizeof(presets[0]);
+    if (custom.bw_kbps > 0.0) {
+        links = &custom;
+        link_count = 1;
+    }
+
+    char fixed_name[16];
+    snprintf(fixed_name, sizeof(fixed_name), "fixed%u", fixed_ms);
+    printf("end of speech -> last byte at the server, %d recordings of %u ms\n\n", recordings, speech_ms);
+    printf("%-10s %-9s %10s %9s %10s %8s %11s\n", "link", "frames", "mean ms", "p95 ms", "frame ms", "rtt ms",
+           "grow/shrink");
+    for (int i = 0; i < link_count; i++) {
+        result_t adaptive, fixed;
+        unsigned long seed = rng_state;
+        run(&links[i], 0, speech_ms, recordings, &adaptive);
+        rng_state = seed;  // Same utterances and jitter for both
+        run(&links[i], fixed_ms, speech_ms, recordings, &fixed);
+        print_row(links[i].name, "adaptive", &adaptive);
+        print_row(links[i].name, fixed_name, &fixed);
+    }
+    return 0;
+}
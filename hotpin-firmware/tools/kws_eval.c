@@ -0,0 +1,396 @@
+/*
+ * HotPin Firmware Keyword Spotter Evaluation (host)
+ *
+ * Runs main/kws.c over a WAV corpus exactly as wake_word.c does on the
+ * device: streaming MFCCs hop by hop, the classifier every --infer-hops
+ * hops, and the smoothed detector with its refractory period. The corpus
+ * is two directories of 16 kHz mono 16-bit WAV files:
+ *
+ *   <corpus>/positive/   one wake word per clip
+ *   <corpus>/negative/   speech, music, room noise; any length
+ *
+ * A positive clip is accepted if the detector fires anywhere in it (each
+ * clip is followed by 0.5 s of silence so a late wake word still gets a
+ * full window). Every detection in the negative set is a false accept.
+ * The report gives the false-reject rate, false accepts per hour, a sweep
+ * over thresholds for picking CONFIG_HOTPIN_WAKE_WORD_THRESHOLD, and the
+ * model's MACs per inference with a device CPU and power estimate.
+ *
+ * --dump-features writes one 1 s feature window per clip (the first
+ * second, zero-padded) for training, so the model sees the same fixed-point
+ * MFCCs the device computes:
+ *
+ *   "HPKF" u32, version u16 = 1, frames u16, coeffs u16, reserved u16,
+ *   count u32, then per clip: label u8 (1 = positive), reserved u8,
+ *   int16 features[frames][coeffs]
+ *
+ * Usage:
+ *     gcc -O2 -Imain -o kws_eval tools/kws_eval.c main/kws.c main/fft_q15.c -lm
+ *     ./kws_eval --model model.bin <corpus> [--threshold 0.85] [--infer-hops 8]
+ *     ./kws_eval --dump-features features.bin <corpus>
+ */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kws.h"
+
+#define TAIL_SILENCE_SAMPLES    (KWS_SAMPLE_RATE / 2)
+#define REFRACTORY_MS           1500    // WAKE_REFRACTORY_MS in wake_word.c
+#define HOP_MS                  (KWS_HOP_LEN * 1000 / KWS_SAMPLE_RATE)
+
+// Device estimate: ESP32 at 240 MHz without SIMD, about 4 cycles per int8
+// MAC in the interpreter loops; power figures as in wake_word.c
+#define DEVICE_CPU_HZ           240000000.0
+#define DEVICE_CYCLES_PER_MAC   4.0
+#define DEVICE_FEATURE_CYCLES   120000.0    // One hop of MFCCs
+#define POWER_FIXED_MW          10.0
+#define POWER_CORE_MW           66.0
+
+typedef struct {
+    float *probs;       // Wake-word posterior per inference
+    int count;
+    double seconds;
+    int positive;
+} clip_scores_t;
+
+typedef struct {
+    clip_scores_t *clips;
+    int count;
+    int capacity;
+} clip_set_t;
+
+static int16_t* load_wav(const char *path, size_t *samples) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+
+    uint8_t riff[12];
+    if (fread(riff, 1, 12, f) != 12 || memcmp(riff, "RIFF", 4) || memcmp(riff + 8, "WAVE", 4)) {
+        fclose(f);
+        return NULL;
+    }
+
+    int format_ok = 0;
+    uint8_t chunk[8];
+    while (fread(chunk, 1, 8, f) == 8) {
+        uint32_t len = chunk[4] | chunk[5] << 8 | chunk[6] << 16 | (uint32_t)chunk[7] << 24;
+        if (!memcmp(chunk, "fmt ", 4)) {
+            uint8_t fmt[16];
+            if (len < 16 || fread(fmt, 1, 16, f) != 16) {
+                break;
+            }
+            uint16_t format = fmt[0] | fmt[1] << 8;
+            uint16_t channels = fmt[2] | fmt[3] << 8;
+            uint32_t rate = fmt[4] | fmt[5] << 8 | fmt[6] << 16 | (uint32_t)fmt[7] << 24;
+            uint16_t bits = fmt[14] | fmt[15] << 8;
+            format_ok = format == 1 && channels == 1 && rate == KWS_SAMPLE_RATE && bits == 16;
+            fseek(f, len - 16 + (len & 1), SEEK_CUR);
+        } else if (!memcmp(chunk, "data", 4)) {
+            if (!format_ok) {
+                break;
+            }
+            int16_t *pcm = malloc(len + 2);
+            size_t got = pcm ? fread(pcm, 1, len, f) : 0;
+            fclose(f);
+            *samples = got / sizeof(int16_t);
+            return pcm;
+        } else {
+            fseek(f, len + (len & 1), SEEK_CUR);
+        }
+    }
+
+    fclose(f);
+    return NULL;
+}
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// Sorted *.wav paths in a directory
+static char** list_wavs(const char *dir, int *count) {
+    *count = 0;
+    DIR *d = opendir(dir);
+    if (!d) {
+        return NULL;
+    }
+    char **paths = NULL;
+    int capacity = 0;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        if (len < 5 || strcmp(entry->d_name + len - 4, ".wav")) {
+            continue;
+        }
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            paths = realloc(paths, capacity * sizeof(char*));
+        }
+        paths[*count] = malloc(strlen(dir) + len + 2);
+        sprintf(paths[*count], "%s/%s", dir, entry->d_name);
+        (*count)++;
+    }
+    closedir(d);
+    qsort(paths, *count, sizeof(char*), compare_names);
+    return paths;
+}
+
+// Stream one clip through the front end and classifier
+static void score_clip(const kws_model_t *model, int8_t *arena, int infer_hops,
+                       const int16_t *pcm, size_t samples, clip_scores_t *out) {
+    static kws_frontend_t fe;
+    kws_frontend_reset(&fe);
+
+    size_t total = samples + TAIL_SILENCE_SAMPLES;
+    out->probs = malloc((total / KWS_HOP_LEN + 1) * sizeof(float));
+    out->count = 0;
+    out->seconds = (double)samples / KWS_SAMPLE_RATE;
+
+    int16_t hop[KWS_HOP_LEN];
+    int hops_since_infer = 0;
+    for (size_t pos = 0; pos + KWS_HOP_LEN <= total; pos += KWS_HOP_LEN) {
+        for (int i = 0; i < KWS_HOP_LEN; i++) {
+            hop[i] = pos + i < samples ? pcm[pos + i] : 0;
+        }
+        kws_frontend_push(&fe, hop, KWS_HOP_LEN);
+        if (++hops_since_infer < infer_hops || !kws_frontend_ready(&fe, model)) {
+            continue;
+        }
+        hops_since_infer = 0;
+
+        float probs[KWS_MAX_CLASSES];
+        kws_infer(model, &fe, arena, probs);
+        out->probs[out->count++] = probs[model->header->wake_class];
+    }
+}
+
+static int count_detections(const clip_scores_t *clip, float threshold, int refractory) {
+    kws_detector_t det;
+    kws_detector_reset(&det);
+    int detections = 0;
+    for (int i = 0; i < clip->count; i++) {
+        detections += kws_detector_update(&det, clip->probs[i], threshold, refractory);
+    }
+    return detections;
+}
+
+static void add_clip(clip_set_t *set, clip_scores_t clip) {
+    if (set->count == set->capacity) {
+        set->capacity = set->capacity ? set->capacity * 2 : 64;
+        set->clips = realloc(set->clips, set->capacity * sizeof(clip_scores_t));
+    }
+    set->clips[set->count++] = clip;
+}
+
+// Feature window of the first second of a clip, zero-padded
+static void clip_features(const int16_t *pcm, size_t samples, int16_t *features) {
+    static kws_frontend_t fe;
+    kws_frontend_reset(&fe);
+    int16_t hop[KWS_HOP_LEN];
+    for (size_t pos = 0; fe.count < KWS_MAX_FRAMES; pos += KWS_HOP_LEN) {
+        for (int i = 0; i < KWS_HOP_LEN; i++) {
+            hop[i] = pos + i < samples ? pcm[pos + i] : 0;
+        }
+        kws_frontend_push(&fe, hop, KWS_HOP_LEN);
+    }
+    for (int f = 0; f < KWS_MAX_FRAMES; f++) {
+        memcpy(&features[f * KWS_MFCC_COEFFS], fe.features[(fe.head + f) % KWS_MAX_FRAMES],
+               KWS_MFCC_COEFFS * sizeof(int16_t));
+    }
+}
+
+static void write_u16(FILE *f, uint16_t v) {
+    fwrite(&v, sizeof(v), 1, f);
+}
+
+static void write_u32(FILE *f, uint32_t v) {
+    fwrite(&v, sizeof(v), 1, f);
+}
+
+static void usage(void) {
+    fprintf(stderr, "Usage: kws_eval --model model.bin <corpus> [--threshold 0.85] [--infer-hops 8]\n"
+                    "       kws_eval --dump-features features.bin <corpus>\n");
+}
+
+int main(int argc, char **argv) {
+    const char *model_path = NULL;
+    const char *dump_path = NULL;
+    const char *corpus = NULL;
+    float threshold = 0.85f;
+    int infer_hops = 8;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--model") && i + 1 < argc) {
+            model_path = argv[++i];
+        } else if (!strcmp(argv[i], "--dump-features") && i + 1 < argc) {
+            dump_path = argv[++i];
+        } else if (!strcmp(argv[i], "--threshold") && i + 1 < argc) {
+            threshold = (float)atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--infer-hops") && i + 1 < argc) {
+            infer_hops = atoi(argv[++i]);
+        } else if (argv[i][0] != '-' && !corpus) {
+            corpus = argv[i];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (!corpus || (!model_path && !dump_path) || infer_hops < 1) {
+        usage();
+        return 2;
+    }
+
+    kws_init();
+
+    kws_model_t model;
+    int8_t *arena = NULL;
+    uint8_t *blob = NULL;
+    if (model_path) {
+        FILE *f = fopen(model_path, "rb");
+        if (!f) {
+            fprintf(stderr, "Error: cannot open %s\n", model_path);
+            return 2;
+        }
+        fseek(f, 0, SEEK_END);
+        long size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        blob = malloc(size);
+        if (!blob || fread(blob, 1, size, f) != (size_t)size || !kws_model_load(&model, blob, size)) {
+            fprintf(stderr, "Error: %s is not a valid model\n", model_path);
+            return 2;
+        }
+        fclose(f);
+        arena = malloc(model.arena_bytes);
+    }
+
+    FILE *dump = NULL;
+    uint32_t dumped = 0;
+    if (dump_path) {
+        dump = fopen(dump_path, "wb");
+        if (!dump) {
+            fprintf(stderr, "Error: cannot create %s\n", dump_path);
+            return 2;
+        }
+        write_u32(dump, 0x464B5048u);  // "HPKF"
+        write_u16(dump, 1);
+        write_u16(dump, KWS_MAX_FRAMES);
+        write_u16(dump, KWS_MFCC_COEFFS);
+        write_u16(dump, 0);
+        write_u32(dump, 0);             // Count, patched at the end
+    }
+
+    clip_set_t sets[2] = {{0}};
+    const char *subdirs[2] = { "negative", "positive" };
+    for (int label = 0; label < 2; label++) {
+        char dir[4096];
+        snprintf(dir, sizeof(dir), "%s/%s", corpus, subdirs[label]);
+        int count = 0;
+        char **paths = list_wavs(dir, &count);
+        for (int i = 0; i < count; i++) {
+            size_t samples = 0;
+            int16_t *pcm = load_wav(paths[i], &samples);
+            if (!pcm) {
+                fprintf(stderr, "Skipping %s (not 16 kHz mono PCM16)\n", paths[i]);
+                free(paths[i]);
+                continue;
+            }
+            if (dump) {
+                int16_t features[KWS_MAX_FRAMES * KWS_MFCC_COEFFS];
+                clip_features(pcm, samples, features);
+                uint8_t tag[2] = { (uint8_t)label, 0 };
+                fwrite(tag, 1, 2, dump);
+                fwrite(features, sizeof(features), 1, dump);
+                dumped++;
+            }
+            if (model_path) {
+                clip_scores_t clip;
+                score_clip(&model, arena, infer_hops, pcm, samples, &clip);
+                clip.positive = label;
+                add_clip(&sets[label], clip);
+            }
+            free(pcm);
+            free(paths[i]);
+        }
+        free(paths);
+    }
+
+    if (dump) {
+        fseek(dump, 12, SEEK_SET);
+        write_u32(dump, dumped);
+        fclose(dump);
+        printf("Wrote %u feature windows (%d x %d) to %s\n", dumped, KWS_MAX_FRAMES, KWS_MFCC_COEFFS, dump_path);
+    }
+    if (!model_path) {
+        return 0;
+    }
+
+    const clip_set_t *neg = &sets[0];
+    const clip_set_t *pos = &sets[1];
+    if (pos->count == 0 || neg->count == 0) {
+        fprintf(stderr, "Error: need WAV files in both %s/positive and %s/negative\n", corpus, corpus);
+        return 2;
+    }
+    double neg_hours = 0;
+    for (int i = 0; i < neg->count; i++) {
+        neg_hours += neg->clips[i].seconds / 3600.0;
+    }
+
+    int refractory = REFRACTORY_MS / HOP_MS / infer_hops;
+    printf("Corpus: %d positive clips, %d negative clips (%.2f h)\n", pos->count, neg->count, neg_hours);
+    printf("Model: %u layers, %u MACs/inference, %zu byte arena; inference every %d hops\n\n",
+           model.header->layer_count, model.macs, model.arena_bytes, infer_hops);
+
+    printf("threshold   FR %%     FA/h    FA clips %%\n");
+    int failures = 0;
+    for (int step = 10; step <= 19; step++) {
+        float t = step * 0.05f;
+        int rejected = 0, false_accepts = 0, fa_clips = 0;
+        for (int i = 0; i < pos->count; i++) {
+            rejected += count_detections(&pos->clips[i], t, refractory) == 0;
+        }
+        for (int i = 0; i < neg->count; i++) {
+            int n = count_detections(&neg->clips[i], t, refractory);
+            false_accepts += n;
+            fa_clips += n > 0;
+        }
+        printf("  %.2f    %6.2f  %7.2f    %6.2f\n", t, 100.0 * rejected / pos->count,
+               neg_hours > 0 ? false_accepts / neg_hours : 0.0, 100.0 * fa_clips / neg->count);
+    }
+
+    int rejected = 0, false_accepts = 0;
+    for (int i = 0; i < pos->count; i++) {
+        rejected += count_detections(&pos->clips[i], threshold, refractory) == 0;
+    }
+    for (int i = 0; i < neg->count; i++) {
+        false_accepts += count_detections(&neg->clips[i], threshold, refractory);
+    }
+    double fr = 100.0 * rejected / pos->count;
+    double fa_per_hour = neg_hours > 0 ? false_accepts / neg_hours : 0.0;
+    printf("\nAt threshold %.2f: false reject %.2f %% (%d/%d), false accept %.2f/h (%d)\n",
+           threshold, fr, rejected, pos->count, fa_per_hour, false_accepts);
+
+    // Idle-listening budget on the device, before measuring it in telemetry
+    double hop_cycles = DEVICE_FEATURE_CYCLES + model.macs * DEVICE_CYCLES_PER_MAC / infer_hops;
+    double cpu = hop_cycles / (DEVICE_CPU_HZ * HOP_MS / 1000.0);
+    printf("Device estimate: %.1f ms/inference, %.1f %% of one core, ~%.0f mW idle listening\n",
+           model.macs * DEVICE_CYCLES_PER_MAC / DEVICE_CPU_HZ * 1000.0, cpu * 100.0,
+           POWER_FIXED_MW + POWER_CORE_MW * (cpu > 1.0 ? 1.0 : cpu));
+    if (cpu >= 1.0) {
+        printf("FAIL: the model cannot keep up at this inference interval\n");
+        failures++;
+    }
+
+    for (int s = 0; s < 2; s++) {
+        for (int i = 0; i < sets[s].count; i++) {
+            free(sets[s].clips[i].probs);
+        }
+        free(sets[s].clips);
+    }
+    free(arena);
+    free(blob);
+    return failures ? 1 : 0;
+}
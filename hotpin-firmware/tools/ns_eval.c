@@ -0,0 +1,547 @@
+/*
+ * HotPin Firmware Noise Suppressor Evaluation (host)
+ *
+ * Mixes clean speech with noise at several SNRs and runs
+ * main/noise_suppress.c over each mix the way the capture path does:
+ * streaming, in place, NS_DELAY samples behind. A floating-point reference
+ * of the same algorithm runs alongside to check the fixed-point arithmetic.
+ * Per SNR the report gives:
+ *
+ *   - segmental SNR against the clean signal, before and after (20 ms
+ *     segments with speech, each clamped to [-10, 35] dB)
+ *   - noise attenuation in speech pauses
+ *   - fixed-point vs reference agreement (SNR of the difference)
+ *
+ * followed by the host time per frame. On the device the same number is
+ * the noise_suppress cycle counter in the telemetry perf object.
+ *
+ * The corpus is two directories of 16 kHz mono 16-bit WAV files; noise
+ * files are looped and cycled over the clean files. Without directories a
+ * synthetic corpus is used: voiced harmonic syllables with pauses, in
+ * white, pink and mains-hum noise.
+ *
+ * Usage:
+ *     gcc -O2 -Imain -o ns_eval tools/ns_eval.c main/noise_suppress.c main/fft_q15.c -lm
+ *     ./ns_eval [--snr 0,5,10] [--max-db 12] [<clean_dir> <noise_dir>]
+ */
+
+#include <dirent.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "noise_suppress.h"
+
+#define SEGMENT_LEN         320     // 20 ms
+#define SEGSNR_MIN_DB       -10.0
+#define SEGSNR_MAX_DB       35.0
+#define PAUSE_LEVEL         1e-4    // Segment power below this fraction of the clean mean is a pause
+#define MAX_SNRS            8
+#define MIN_AGREEMENT_DB    25.0
+#define SYNTH_SECONDS       8
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+typedef struct {
+    int16_t *pcm;
+    size_t samples;
+} clip_t;
+
+typedef struct {
+    double seg_in_db;
+    double seg_out_db;
+    int segments;
+    double pause_in;        // Energy in pauses, noisy input and output
+    double pause_out;
+    double ref_signal;      // Reference output energy, and its difference from the fixed output
+    double ref_error;
+} snr_result_t;
+
+// Floating-point reference: the algorithm of noise_suppress.c without
+// quantization. Constants must match it.
+#define REF_SMOOTH          0.125
+#define REF_NOISE_BIAS      1.5
+#define REF_SNR_MAX         65536.0
+#define REF_PRIO_WEIGHT     0.98
+
+typedef struct {
+    double input[NS_FRAME_LEN];
+    double output[NS_HOP_LEN];
+    double overlap[NS_HOP_LEN];
+    int pos;
+    double gain_floor;
+    long frames;
+    int subwindow_frames;
+    int subwindow;
+    double smoothed[NS_BINS];
+    double current_min[NS_BINS];
+    double subwindow_min[NS_SUBWINDOWS][NS_BINS];
+    double stored_min[NS_BINS];
+    double clean_snr[NS_BINS];
+} ref_state_t;
+
+static double ref_window[NS_FRAME_LEN];
+
+static int16_t* load_wav(const char *path, size_t *samples) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+
+    uint8_t riff[12];
+    if (fread(riff, 1, 12, f) != 12 || memcmp(riff, "RIFF", 4) || memcmp(riff + 8, "WAVE", 4)) {
+        fclose(f);
+        return NULL;
+    }
+
+    int format_ok = 0;
+    uint8_t chunk[8];
+    while (fread(chunk, 1, 8, f) == 8) {
+        uint32_t len = chunk[4] | chunk[5] << 8 | chunk[6] << 16 | (uint32_t)chunk[7] << 24;
+        if (!memcmp(chunk, "fmt ", 4)) {
+            uint8_t fmt[16];
+            if (len < 16 || fread(fmt, 1, 16, f) != 16) {
+                break;
+            }
+            uint16_t format = fmt[0] | fmt[1] << 8;
+            uint16_t channels = fmt[2] | fmt[3] << 8;
+            uint32_t rate = fmt[4] | fmt[5] << 8 | fmt[6] << 16 | (uint32_t)fmt[7] << 24;
+            uint16_t bits = fmt[14] | fmt[15] << 8;
+            format_ok = format == 1 && channels == 1 && rate == NS_SAMPLE_RATE && bits == 16;
+            fseek(f, len - 16 + (len & 1), SEEK_CUR);
+        } else if (!memcmp(chunk, "data", 4)) {
+            if (!format_ok) {
+                break;
+            }
+            int16_t *pcm = malloc(len + 2);
+            size_t got = pcm ? fread(pcm, 1, len, f) : 0;
+            fclose(f);
+            *samples = got / sizeof(int16_t);
+            return pcm;
+        } else {
+            fseek(f, len + (len & 1), SEEK_CUR);
+        }
+    }
+
+    fclose(f);
+    return NULL;
+}
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// All readable WAV files in a directory, sorted by name
+static clip_t* load_dir(const char *dir, int *count) {
+    *count = 0;
+    DIR *d = opendir(dir);
+    if (!d) {
+        return NULL;
+    }
+    char **names = NULL;
+    int n = 0, capacity = 0;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        if (len < 5 || strcmp(entry->d_name + len - 4, ".wav")) {
+            continue;
+        }
+        if (n == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            names = realloc(names, capacity * sizeof(char*));
+        }
+        names[n] = malloc(strlen(dir) + len + 2);
+        sprintf(names[n], "%s/%s", dir, entry->d_name);
+        n++;
+    }
+    closedir(d);
+    qsort(names, n, sizeof(char*), compare_names);
+
+    clip_t *clips = calloc(n ? n : 1, sizeof(clip_t));
+    for (int i = 0; i < n; i++) {
+        clips[*count].pcm = load_wav(names[i], &clips[*count].samples);
+        if (clips[*count].pcm && clips[*count].samples > 0) {
+            (*count)++;
+        } else {
+            fprintf(stderr, "Skipping %s (not 16 kHz mono PCM16)\n", names[i]);
+        }
+        free(names[i]);
+    }
+    free(names);
+    return clips;
+}
+
+static uint32_t rng_state = 12345;
+
+static double uniform(void) {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return (rng_state >> 8) / 16777216.0;
+}
+
+static double gaussian(void) {
+    double sum = 0;
+    for (int i = 0; i < 12; i++) {
+        sum += uniform();
+    }
+    return sum - 6.0;
+}
+
+// Voiced syllables (harmonics of a gliding pitch under a falling spectral
+// envelope) separated by pauses
+static clip_t synth_speech(void) {
+    clip_t clip = { calloc(SYNTH_SECONDS * NS_SAMPLE_RATE, sizeof(int16_t)), SYNTH_SECONDS * NS_SAMPLE_RATE };
+    size_t t = NS_SAMPLE_RATE / 2;
+    while (t < clip.samples) {
+        size_t len = (size_t)((0.15 + 0.25 * uniform()) * NS_SAMPLE_RATE);
+        double f0 = 100.0 + 120.0 * uniform();
+        double glide = (uniform() - 0.5) * 60.0;
+        double formant = 500.0 + 1500.0 * uniform();
+        double phase = 0;
+        for (size_t i = 0; i < len && t + i < clip.samples; i++) {
+            double progress = (double)i / len;
+            double f = f0 + glide * progress;
+            phase += 2.0 * M_PI * f / NS_SAMPLE_RATE;
+            double v = 0;
+            for (int h = 1; h * f < 4000.0; h++) {
+                double distance = (h * f - formant) / 800.0;
+                v += sin(h * phase) * (1.0 / h + 0.6 * exp(-distance * distance));
+            }
+            clip.pcm[t + i] = (int16_t)(3000.0 * sin(M_PI * progress) * v);
+        }
+        t += len + (size_t)((0.1 + 0.5 * uniform()) * NS_SAMPLE_RATE);
+    }
+    return clip;
+}
+
+static clip_t synth_noise(int kind) {
+    clip_t clip = { calloc(SYNTH_SECONDS * NS_SAMPLE_RATE, sizeof(int16_t)), SYNTH_SECONDS * NS_SAMPLE_RATE };
+    double b[3] = { 0 };
+    for (size_t i = 0; i < clip.samples; i++) {
+        double w = gaussian();
+        double v;
+        if (kind == 0) {
+            v = w;
+        } else if (kind == 1) {
+            // Pink: three one-pole sections (Kellet's economy filter)
+            b[0] = 0.99765 * b[0] + w * 0.0990460;
+            b[1] = 0.96300 * b[1] + w * 0.2965164;
+            b[2] = 0.57000 * b[2] + w * 1.0526913;
+            v = (b[0] + b[1] + b[2] + w * 0.1848) * 0.3;
+        } else {
+            // Mains hum with harmonics over a little broadband noise
+            double t = (double)i / NS_SAMPLE_RATE;
+            v = 0.2 * w;
+            for (int h = 1; h <= 8; h++) {
+                v += sin(2.0 * M_PI * 50.0 * h * t) / h;
+            }
+        }
+        clip.pcm[i] = (int16_t)(1000.0 * v);
+    }
+    return clip;
+}
+
+static double power_of(const int16_t *pcm, size_t samples) {
+    double sum = 0;
+    for (size_t i = 0; i < samples; i++) {
+        sum += (double)pcm[i] * pcm[i];
+    }
+    return samples ? sum / samples : 0;
+}
+
+// Clean plus looped noise at the given SNR; both are scaled down together
+// if the mix would clip
+static int16_t* mix(const clip_t *clean, const clip_t *noise, double snr_db, double *clean_scale) {
+    double gain = sqrt(power_of(clean->pcm, clean->samples) /
+                       (power_of(noise->pcm, noise->samples) * pow(10.0, snr_db / 10.0) + 1e-9));
+    double peak = 1.0;
+    for (size_t i = 0; i < clean->samples; i++) {
+        double v = fabs(clean->pcm[i] + gain * noise->pcm[i % noise->samples]);
+        if (v > peak) {
+            peak = v;
+        }
+    }
+    *clean_scale = peak > 32000.0 ? 32000.0 / peak : 1.0;
+
+    int16_t *out = malloc(clean->samples * sizeof(int16_t));
+    for (size_t i = 0; i < clean->samples; i++) {
+        out[i] = (int16_t)lround(*clean_scale * (clean->pcm[i] + gain * noise->pcm[i % noise->samples]));
+    }
+    return out;
+}
+
+static void fft_double(double *re, double *im, int n, int inverse) {
+    for (int i = 1, j = 0; i < n; i++) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j |= bit;
+        if (i < j) {
+            double t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+    for (int half = 1; half < n; half <<= 1) {
+        for (int start = 0; start < n; start += half << 1) {
+            for (int k = 0; k < half; k++) {
+                double angle = (inverse ? M_PI : -M_PI) * k / half;
+                double wr = cos(angle), wi = sin(angle);
+                int a = start + k, b = a + half;
+                double tr = re[b] * wr - im[b] * wi;
+                double ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+    if (inverse) {
+        for (int i = 0; i < n; i++) {
+            re[i] /= n;
+            im[i] /= n;
+        }
+    }
+}
+
+static void ref_reset(ref_state_t *ref, int max_attenuation_db) {
+    memset(ref, 0, sizeof(*ref));
+    ref->gain_floor = pow(10.0, -max_attenuation_db / 20.0);
+    for (int k = 0; k < NS_BINS; k++) {
+        ref->stored_min[k] = INFINITY;
+        for (int i = 0; i < NS_SUBWINDOWS; i++) {
+            ref->subwindow_min[i][k] = INFINITY;
+        }
+    }
+}
+
+static void ref_frame(ref_state_t *ref) {
+    double re[NS_FRAME_LEN], im[NS_FRAME_LEN];
+    for (int n = 0; n < NS_FRAME_LEN; n++) {
+        re[n] = ref->input[n] * ref_window[n];
+        im[n] = 0;
+    }
+    fft_double(re, im, NS_FRAME_LEN, 0);
+
+    int open_subwindow = ref->subwindow_frames == 0;
+    double noise[NS_BINS];
+    for (int k = 0; k < NS_BINS; k++) {
+        double p = re[k] * re[k] + im[k] * im[k];
+        ref->smoothed[k] = ref->frames == 0 ? p : ref->smoothed[k] + REF_SMOOTH * (p - ref->smoothed[k]);
+        if (open_subwindow || ref->smoothed[k] < ref->current_min[k]) {
+            ref->current_min[k] = ref->smoothed[k];
+        }
+        noise[k] = REF_NOISE_BIAS * fmin(ref->current_min[k], ref->stored_min[k]);
+
+        double post = noise[k] > 0 ? fmin(p / noise[k], REF_SNR_MAX) : REF_SNR_MAX;
+        double prio = REF_PRIO_WEIGHT * ref->clean_snr[k] + (1.0 - REF_PRIO_WEIGHT) * fmax(post - 1.0, 0.0);
+        double gain = fmax(prio / (1.0 + prio), ref->gain_floor);
+        ref->clean_snr[k] = gain * gain * post;
+
+        re[k] *= gain;
+        im[k] *= gain;
+        if (k > 0 && k < NS_FRAME_LEN / 2) {
+            re[NS_FRAME_LEN - k] *= gain;
+            im[NS_FRAME_LEN - k] *= gain;
+        }
+    }
+    ref->frames++;
+    if (++ref->subwindow_frames == NS_SUBWINDOW_FRAMES) {
+        ref->subwindow_frames = 0;
+        memcpy(ref->subwindow_min[ref->subwindow], ref->current_min, sizeof(ref->current_min));
+        ref->subwindow = (ref->subwindow + 1) % NS_SUBWINDOWS;
+        for (int k = 0; k < NS_BINS; k++) {
+            ref->stored_min[k] = INFINITY;
+            for (int i = 0; i < NS_SUBWINDOWS; i++) {
+                ref->stored_min[k] = fmin(ref->stored_min[k], ref->subwindow_min[i][k]);
+            }
+        }
+    }
+
+    fft_double(re, im, NS_FRAME_LEN, 1);
+    for (int n = 0; n < NS_FRAME_LEN; n++) {
+        double y = re[n] * ref_window[n];
+        if (n < NS_HOP_LEN) {
+            ref->output[n] = ref->overlap[n] + y;
+        } else {
+            ref->overlap[n - NS_HOP_LEN] = y;
+        }
+    }
+}
+
+static void ref_process(ref_state_t *ref, const int16_t *in, double *out, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = ref->output[ref->pos];
+        ref->input[NS_HOP_LEN + ref->pos] = in[i];
+        if (++ref->pos == NS_HOP_LEN) {
+            ref_frame(ref);
+            memmove(ref->input, &ref->input[NS_HOP_LEN], NS_HOP_LEN * sizeof(double));
+            ref->pos = 0;
+        }
+    }
+}
+
+// Score one mix. Outputs lag by NS_DELAY and are aligned before scoring.
+static void score(const clip_t *clean, double clean_scale, const int16_t *noisy, const int16_t *out,
+                  const double *ref, snr_result_t *r) {
+    double mean = power_of(clean->pcm, clean->samples) * clean_scale * clean_scale;
+    for (size_t s = 0; s + SEGMENT_LEN + NS_DELAY <= clean->samples; s += SEGMENT_LEN) {
+        double sig = 0, err_in = 0, err_out = 0, in_energy = 0, out_energy = 0;
+        for (size_t i = s; i < s + SEGMENT_LEN; i++) {
+            double c = clean->pcm[i] * clean_scale;
+            double y = out[i + NS_DELAY];
+            sig += c * c;
+            err_in += (noisy[i] - c) * (noisy[i] - c);
+            err_out += (y - c) * (y - c);
+            in_energy += (double)noisy[i] * noisy[i];
+            out_energy += y * y;
+            r->ref_signal += ref[i + NS_DELAY] * ref[i + NS_DELAY];
+            r->ref_error += (ref[i + NS_DELAY] - y) * (ref[i + NS_DELAY] - y);
+        }
+        if (sig < PAUSE_LEVEL * mean * SEGMENT_LEN) {
+            r->pause_in += in_energy;
+            r->pause_out += out_energy;
+            continue;
+        }
+        r->seg_in_db += fmin(fmax(10.0 * log10(sig / (err_in + 1e-9)), SEGSNR_MIN_DB), SEGSNR_MAX_DB);
+        r->seg_out_db += fmin(fmax(10.0 * log10(sig / (err_out + 1e-9)), SEGSNR_MIN_DB), SEGSNR_MAX_DB);
+        r->segments++;
+    }
+}
+
+static int parse_snrs(const char *list, double *snrs) {
+    int n = 0;
+    char *copy = strdup(list);
+    for (char *tok = strtok(copy, ","); tok && n < MAX_SNRS; tok = strtok(NULL, ",")) {
+        snrs[n++] = atof(tok);
+    }
+    free(copy);
+    return n;
+}
+
+static void usage(void) {
+    fprintf(stderr, "Usage: ns_eval [--snr 0,5,10] [--max-db 12] [<clean_dir> <noise_dir>]\n");
+}
+
+int main(int argc, char **argv) {
+    const char *dirs[2] = { NULL, NULL };
+    double snrs[MAX_SNRS] = { 0, 5, 10 };
+    int snr_count = 3;
+    int max_db = 12;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--snr") && i + 1 < argc) {
+            snr_count = parse_snrs(argv[++i], snrs);
+        } else if (!strcmp(argv[i], "--max-db") && i + 1 < argc) {
+            max_db = atoi(argv[++i]);
+        } else if (argv[i][0] != '-' && !dirs[0]) {
+            dirs[0] = argv[i];
+        } else if (argv[i][0] != '-' && !dirs[1]) {
+            dirs[1] = argv[i];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (snr_count == 0 || max_db < 1 || (dirs[0] && !dirs[1])) {
+        usage();
+        return 2;
+    }
+
+    ns_init();
+    for (int n = 0; n < NS_FRAME_LEN; n++) {
+        ref_window[n] = sin(M_PI * n / NS_FRAME_LEN);
+    }
+
+    clip_t *clean, *noise;
+    int clean_count, noise_count;
+    if (dirs[0]) {
+        clean = load_dir(dirs[0], &clean_count);
+        noise = load_dir(dirs[1], &noise_count);
+        if (clean_count == 0 || noise_count == 0) {
+            fprintf(stderr, "Error: need WAV files in both %s and %s\n", dirs[0], dirs[1]);
+            return 2;
+        }
+    } else {
+        clean_count = 3;
+        noise_count = 3;
+        clean = calloc(clean_count, sizeof(clip_t));
+        noise = calloc(noise_count, sizeof(clip_t));
+        for (int i = 0; i < 3; i++) {
+            clean[i] = synth_speech();
+            noise[i] = synth_noise(i);
+        }
+    }
+
+    // Mixes per SNR: every clean file against every noise file
+    ns_state_t *ns = malloc(sizeof(ns_state_t));
+    ref_state_t *ref = malloc(sizeof(ref_state_t));
+    double seconds = 0;
+    clock_t busy = 0;
+    long frames = 0;
+    int failures = 0;
+
+    printf("Corpus: %d clean, %d noise%s; max attenuation %d dB\n\n", clean_count, noise_count,
+           dirs[0] ? "" : " (synthetic)", max_db);
+    printf("input SNR   segSNR in   segSNR out   gain dB   pause atten dB   fixed vs ref dB\n");
+    for (int s = 0; s < snr_count; s++) {
+        snr_result_t r = { 0 };
+        for (int c = 0; c < clean_count; c++) {
+            for (int n = 0; n < noise_count; n++) {
+                double clean_scale;
+                int16_t *noisy = mix(&clean[c], &noise[n], snrs[s], &clean_scale);
+                int16_t *out = malloc(clean[c].samples * sizeof(int16_t));
+                double *ref_out = malloc(clean[c].samples * sizeof(double));
+                memcpy(out, noisy, clean[c].samples * sizeof(int16_t));
+
+                ns_reset(ns, max_db);
+                clock_t start = clock();
+                frames += ns_process(ns, out, clean[c].samples);
+                busy += clock() - start;
+                seconds += (double)clean[c].samples / NS_SAMPLE_RATE;
+
+                ref_reset(ref, max_db);
+                ref_process(ref, noisy, ref_out, clean[c].samples);
+                score(&clean[c], clean_scale, noisy, out, ref_out, &r);
+                free(noisy);
+                free(out);
+                free(ref_out);
+            }
+        }
+
+        double seg_in = r.segments ? r.seg_in_db / r.segments : 0;
+        double seg_out = r.segments ? r.seg_out_db / r.segments : 0;
+        double atten = r.pause_out > 0 ? 10.0 * log10(r.pause_in / r.pause_out) : 0;
+        double agreement = r.ref_error > 0 ? 10.0 * log10(r.ref_signal / r.ref_error) : 99.0;
+        printf("  %5.1f      %7.2f      %7.2f    %+6.2f        %6.2f           %6.1f\n",
+               snrs[s], seg_in, seg_out, seg_out - seg_in, atten, agreement);
+        if (seg_out < seg_in) {
+            printf("FAIL: segmental SNR drops at %.1f dB input SNR\n", snrs[s]);
+            failures++;
+        }
+        if (agreement < MIN_AGREEMENT_DB) {
+            printf("FAIL: fixed point deviates from the reference at %.1f dB input SNR\n", snrs[s]);
+            failures++;
+        }
+    }
+
+    double us_per_frame = frames ? 1e6 * busy / CLOCKS_PER_SEC / frames : 0;
+    printf("\nHost: %.2f us/frame over %ld frames (%.1f s of audio, %.0fx real time)\n", us_per_frame,
+           frames, seconds, us_per_frame > 0 ? 1e6 * NS_HOP_LEN / NS_SAMPLE_RATE / us_per_frame : 0.0);
+
+    for (int i = 0; i < clean_count; i++) {
+        free(clean[i].pcm);
+    }
+    for (int i = 0; i < noise_count; i++) {
+        free(noise[i].pcm);
+    }
+    free(clean);
+    free(noise);
+    free(ns);
+    free(ref);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,199 @@
+#!/usr/bin/env python3
+"""
+HotPin Firmware Keyword Spotter Model Packer
+
+Quantizes a trained float model to the int8 blob read by main/kws.c and
+flashed to the 'kws' partition. The model comes as JSON so any training
+framework can export it; train on the features written by
+'kws_eval --dump-features' so the float model sees the device's MFCCs.
+
+    {
+      "wake_class": 1, "n_frames": 49, "n_mfcc": 10,
+      "input_range": [min, max],            # of the dumped MFCC values
+      "layers": [
+        {"type": "conv2d", "kernel": [10, 4], "stride": [2, 2], "relu": true,
+         "weights": [out][kh][kw][in], "bias": [out], "output_range": [min, max]},
+        {"type": "dwconv2d", "kernel": [3, 3], "stride": [1, 1], "relu": true,
+         "weights": [kh][kw][channels], "bias": [channels], "output_range": [...]},
+        {"type": "pointwise", "relu": true, "weights": [out][in], ...},
+        {"type": "avgpool"},
+        {"type": "fc", "weights": [out][in], "bias": [out], "output_range": [...]}
+      ]
+    }
+
+Activation ranges come from calibration (min/max of each layer's output
+over the training set). Activations are asymmetric int8, weights symmetric
+per output channel, as described in main/kws.h.
+
+Usage:
+    python tools/pack_kws_model.py model.json --out assets/kws/model.bin
+"""
+
+import argparse
+import json
+import math
+import struct
+import sys
+from pathlib import Path
+
+# Must match main/kws.h
+MODEL_MAGIC = 0x574B5048  # "HPKW"
+MODEL_VERSION = 1
+HEADER_FMT = "<IHHHHHHiiifiI2I"
+LAYER_FMT = "<BBBBBBHiIIII"
+LAYER_TYPES = {"conv2d": 0, "dwconv2d": 1, "pointwise": 2, "avgpool": 3, "fc": 4}
+MAX_FRAMES = 49
+MAX_MFCC = 10
+MAX_CLASSES = 16
+PARTITION_SIZE = 128 * 1024
+
+def flatten(values):
+    """Flatten nested lists in row-major order."""
+    if isinstance(values, list):
+        return [x for v in values for x in flatten(v)]
+    return [float(values)]
+
+def activation_params(value_range):
+    """Scale and zero point mapping [min, max] (widened to include 0) to int8."""
+    low, high = min(value_range[0], 0.0), max(value_range[1], 0.0)
+    scale = (high - low) / 255.0 or 1.0
+    zero_point = int(round(-128 - low / scale))
+    return scale, max(-128, min(127, zero_point))
+
+def quantize_multiplier(real):
+    """Q31 multiplier and shift with real = mult * 2^(shift - 31)."""
+    if real <= 0:
+        return 0, 0
+    mantissa, exponent = math.frexp(real)
+    mult = int(round(mantissa * (1 << 31)))
+    if mult == 1 << 31:
+        mult //= 2
+        exponent += 1
+    if exponent < -31:
+        return 0, 0
+    if exponent > 30:
+        sys.exit(f"Error: requantization scale {real} out of range")
+    return mult, exponent
+
+def ceil_div(a, b):
+    return (a + b - 1) // b
+
+def pack(model):
+    n_frames, n_mfcc = model.get("n_frames", MAX_FRAMES), model.get("n_mfcc", MAX_MFCC)
+    if not (0 < n_frames <= MAX_FRAMES and 0 < n_mfcc <= MAX_MFCC):
+        sys.exit(f"Error: input must be at most {MAX_FRAMES} x {MAX_MFCC}")
+
+    in_scale, in_zp = activation_params(model["input_range"])
+    input_mult, input_shift = quantize_multiplier(1.0 / in_scale)
+
+    h, w, c = n_frames, n_mfcc, 1
+    max_activation = h * w * c
+    table, data = [], bytearray()
+    layers = model["layers"]
+    data_start = struct.calcsize(HEADER_FMT) + struct.calcsize(LAYER_FMT) * len(layers)
+
+    def append(blob, align=4):
+        data.extend(b"\0" * (-(data_start + len(data)) % align))
+        offset = data_start + len(data)
+        data.extend(blob)
+        return offset
+
+    scale, zp = in_scale, in_zp
+    for index, layer in enumerate(layers):
+        kind = layer["type"]
+        if kind not in LAYER_TYPES:
+            sys.exit(f"Error: layer {index}: unknown type '{kind}'")
+        kh, kw = layer.get("kernel", [1, 1])
+        sh, sw = layer.get("stride", [1, 1])
+        relu = 1 if layer.get("relu") else 0
+
+        if kind == "avgpool":
+            h, w = 1, 1
+            table.append(struct.pack(LAYER_FMT, LAYER_TYPES[kind], 0, 0, 0, 0, 0, 0, zp, 0, 0, 0, 0))
+            continue
+
+        weights = layer["weights"]
+        bias = [float(b) for b in layer["bias"]]
+        if kind == "conv2d":
+            out_c = len(weights)
+            per_channel = [flatten(wt) for wt in weights]
+            expected = kh * kw * c
+            h, w = ceil_div(h, sh), ceil_div(w, sw)
+        elif kind == "dwconv2d":
+            out_c = c
+            flat = flatten(weights)
+            expected = kh * kw
+            per_channel = [flat[ch::c] for ch in range(c)]
+            h, w = ceil_div(h, sh), ceil_div(w, sw)
+        elif kind == "pointwise":
+            out_c = len(weights)
+            per_channel = [flatten(wt) for wt in weights]
+            expected = c
+        else:  # fc
+            out_c = len(weights)
+            per_channel = [flatten(wt) for wt in weights]
+            expected = h * w * c
+            h, w = 1, 1
+        if any(len(wt) != expected for wt in per_channel) or len(bias) != out_c:
+            sys.exit(f"Error: layer {index} ({kind}): weight shape does not match its input")
+
+        out_scale, out_zp = activation_params(layer["output_range"])
+        q_weights, biases, mults, shifts = [], [], [], []
+        for ch in range(out_c):
+            w_scale = max(abs(v) for v in per_channel[ch]) / 127.0 or 1.0
+            q_weights.append([max(-127, min(127, int(round(v / w_scale)))) for v in per_channel[ch]])
+            biases.append(int(round(bias[ch] / (scale * w_scale))))
+            mult, shift = quantize_multiplier(scale * w_scale / out_scale)
+            mults.append(mult)
+            shifts.append(shift)
+
+        # kws.c reads depthwise weights as [kh][kw][channels]
+        if kind == "dwconv2d":
+            q_flat = [q_weights[ch][k] for k in range(expected) for ch in range(out_c)]
+        else:
+            q_flat = [v for wt in q_weights for v in wt]
+
+        weights_offset = append(struct.pack("<%db" % len(q_flat), *q_flat), 1)
+        bias_offset = append(struct.pack("<%di" % out_c, *biases))
+        mult_offset = append(struct.pack("<%di" % out_c, *mults))
+        shift_offset = append(struct.pack("<%di" % out_c, *shifts))
+        table.append(struct.pack(LAYER_FMT, LAYER_TYPES[kind], relu, kh, kw, sh, sw, out_c, out_zp,
+                                 weights_offset, bias_offset, mult_offset, shift_offset))
+        c = out_c
+        scale, zp = out_scale, out_zp
+        max_activation = max(max_activation, h * w * c)
+
+    n_classes = h * w * c
+    wake_class = model.get("wake_class", 1)
+    if not (2 <= n_classes <= MAX_CLASSES and 0 <= wake_class < n_classes):
+        sys.exit(f"Error: model must end in 2..{MAX_CLASSES} classes including wake_class")
+
+    arena_bytes = 2 * ((max_activation + 3) & ~3)
+    header = struct.pack(HEADER_FMT, MODEL_MAGIC, MODEL_VERSION, len(layers), n_frames, n_mfcc,
+                         n_classes, wake_class, input_mult, input_shift, in_zp, scale, zp,
+                         arena_bytes, 0, 0)
+    return header + b"".join(table) + bytes(data), arena_bytes
+
+def main():
+    parser = argparse.ArgumentParser(description="Pack a keyword spotter model for the 'kws' partition")
+    parser.add_argument("model", help="Float model as JSON (see module docstring)")
+    parser.add_argument("--out", required=True, help="Output image (e.g. assets/kws/model.bin)")
+    parser.add_argument("--size", type=int, default=PARTITION_SIZE,
+                        help="Partition size in bytes (default: %(default)s)")
+    args = parser.parse_args()
+
+    with open(args.model) as f:
+        model = json.load(f)
+    image, arena_bytes = pack(model)
+    if len(image) > args.size:
+        sys.exit(f"Error: model is {len(image)} bytes, partition holds {args.size}")
+
+    out = Path(args.out)
+    out.parent.mkdir(parents=True, exist_ok=True)
+    out.write_bytes(image)
+    print(f"KWS model: {len(model['layers'])} layers, {arena_bytes} byte arena, "
+          f"{len(image)} of {args.size} bytes -> {out}")
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
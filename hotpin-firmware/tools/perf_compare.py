@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+"""
+HotPin Firmware Hot Path Cycle Comparison
+
+Compares the hot path cycle counters of two runs, a default build and a
+performance build (sdkconfig.perf), and prints a Markdown table with the
+change per counter. Each input is one of:
+
+    - a serial log holding the "PERF" lines printed at shutdown
+    - the JSON of GET /state from the webserver (client_telemetry)
+    - the JSON of one "telemetry" message
+
+Run the same record/playback session on both builds so the counters cover
+the same work. The last report in each input is used.
+
+Usage:
+    python tools/perf_compare.py default.log perf.log
+    curl -s http://server:8000/state > perf.json && python tools/perf_compare.py default.json perf.json
+"""
+
+import argparse
+import json
+import re
+import sys
+from pathlib import Path
+
+PERF_LINE_RE = re.compile(r"PERF:\s+(\w+)\s+n=(\d+)\s+avg=(\d+)\s+max=(\d+) cycles")
+PERF_HEADER_RE = re.compile(r"PERF: Hot path cycle counts \((\w+) build\)")
+
+
+def parse_log(text):
+    """Counters from the last block of PERF log lines."""
+    counters = {}
+    build = None
+    for line in text.splitlines():
+        header = PERF_HEADER_RE.search(line)
+        if header:
+            counters = {}
+            build = header.group(1)
+            continue
+        match = PERF_LINE_RE.search(line)
+        if match:
+            counters[match.group(1)] = {"n": int(match.group(2)), "avg": int(match.group(3)),
+                                        "max": int(match.group(4))}
+    return build, counters
+
+
+def parse_json(data):
+    """Counters from a /state response or a telemetry message."""
+    telemetry = data.get("client_telemetry", data)
+    if not telemetry or "perf_cycles" not in telemetry:
+        return None, {}
+    counters = {name: entry for name, entry in telemetry["perf_cycles"].items() if entry.get("n")}
+    return telemetry.get("build"), counters
+
+
+def load(path):
+    text = Path(path).read_text(errors="replace")
+    try:
+        return parse_json(json.loads(text))
+    except ValueError:
+        return parse_log(text)
+
+
+def change(before, after):
+    if not before or after is None:
+        return "-"
+    return f"{(after - before) * 100.0 / before:+.0f}%"
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare hot path cycle counters of two builds")
+    parser.add_argument("before", help="Default build: serial log or JSON")
+    parser.add_argument("after", help="Performance build: serial log or JSON")
+    args = parser.parse_args()
+
+    runs = []
+    for path in (args.before, args.after):
+        if not Path(path).exists():
+            print(f"Error: {path} not found", file=sys.stderr)
+            return 2
+        build, counters = load(path)
+        if not counters:
+            print(f"Error: no cycle counters in {path}", file=sys.stderr)
+            return 2
+        runs.append((build or path, counters))
+
+    (before_name, before), (after_name, after) = runs
+    print(f"| Counter | {before_name} avg | {after_name} avg | Change | {before_name} max | {after_name} max | Change |")
+    print("|---------|------|------|--------|------|------|--------|")
+    for name in sorted(set(before) | set(after)):
+        b = before.get(name, {})
+        a = after.get(name, {})
+        print(f"| {name} | {b.get('avg', '-')} | {a.get('avg', '-')} | {change(b.get('avg'), a.get('avg'))} "
+              f"| {b.get('max', '-')} | {a.get('max', '-')} | {change(b.get('max'), a.get('max'))} |")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
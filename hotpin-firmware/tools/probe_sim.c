@@ -0,0 +1,359 @@
+/*
+ * HotPin Firmware Discovery Probe Simulation (host)
+ *
+ * Runs main/subnet_probe.c over real sockets against a simulated /24 on
+ * the loopback network (127.0.<net>.0/24, all local on Linux) and measures
+ * the time to find the HotPin server, compared with the sequential scan the
+ * firmware used before.
+ *
+ * The simulated subnet:
+ *
+ *   - the device is .100 and the gateway .1. Every other address is one of:
+ *     absent (no host: a listener whose accept queue is full, so the SYN is
+ *     dropped and the connect hangs, like a connect to an address nobody
+ *     answers ARP for), closed (host up, nothing on the port: refused at
+ *     once) or another web server (answers /health with 404). Roughly 80%
+ *     absent, 12% closed and 8% other, from --seed.
+ *   - one address is the HotPin server, answering /health as the webserver
+ *     does. It is --near (.103), --far (.10) or missing.
+ *
+ * Candidates are ordered as build_probe_candidates() in network_discovery.c
+ * does: outward from the device, the gateway after the nearest ten, then
+ * three common local IPs (absent here). The old scan probed the nearest ten,
+ * the gateway and the three common IPs one at a time, with a 2 s timeout
+ * and a 50 ms pause between probes. Loopback answers in microseconds, so
+ * the times are those of the timeouts and the scheduling; on Wi-Fi each
+ * answer adds a few milliseconds.
+ *
+ * Usage:
+ *     gcc -O2 -Imain -o probe_sim tools/probe_sim.c main/subnet_probe.c -lpthread
+ *     ./probe_sim                                     # every scenario, old scan and 4/8/16 sockets
+ *     ./probe_sim [--timeout-ms 250] [--port 18000] [--net 77] [--seed 1] [--no-legacy]
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "subnet_probe.h"
+
+#define DEVICE_HOST         100
+#define GATEWAY_HOST        1
+#define NEAR_HOST           103
+#define FAR_HOST            10
+#define MAX_CANDIDATES      (254 + 8)
+#define LEGACY_TIMEOUT_MS   2000
+#define LEGACY_PAUSE_MS     50
+
+typedef enum {
+    HOST_ABSENT = 0,
+    HOST_CLOSED,
+    HOST_OTHER,
+    HOST_HOTPIN,
+} host_role_t;
+
+static const char *HOTPIN_RESPONSE =
+    "HTTP/1.1 200 OK\r\ncontent-type: application/json\r\nconnection: close\r\n\r\n"
+    "{\"service\":\"hotpin\",\"ok\":true,\"timestamp\":\"2025-01-01T00:00:00\","
+    "\"models\":[\"groq-whisper\",\"groq-llm\"]}";
+static const char *OTHER_RESPONSE =
+    "HTTP/1.1 404 Not Found\r\ncontent-type: text/html\r\nconnection: close\r\n\r\n<h1>Not Found</h1>";
+
+static int net_octet = 77;
+static uint16_t port = 18000;
+static host_role_t roles[256];
+static int listeners[256];          // -1 if nothing bound
+static int fillers[256];            // Connection holding an absent host's accept queue full
+static int hotpin_host = -1;
+static volatile int serving = 1;
+
+static unsigned long rng_state = 1;
+
+static double uniform(double max) {
+    rng_state = rng_state * 6364136223846793005UL + 1442695040888963407UL;
+    return max * (double)((rng_state >> 33) & 0x7fffffff) / 2147483648.0;
+}
+
+static uint32_t host_addr(int host) {
+    char ip[16];
+    snprintf(ip, sizeof(ip), "127.0.%d.%d", net_octet, host);
+    return inet_addr(ip);
+}
+
+static int listen_on(int host, int backlog) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in sa = { .sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = host_addr(host) };
+    if (bind(fd, (struct sockaddr*)&sa, sizeof(sa)) < 0 || listen(fd, backlog) < 0) {
+        perror("bind/listen");
+        exit(1);
+    }
+    return fd;
+}
+
+// Set up the hosts for one scenario. Roles other than the HotPin server stay
+// the same across scenarios (same seed)
+static void build_subnet(int hotpin) {
+    unsigned long seed = rng_state;
+    for (int host = 1; host < 255; host++) {
+        double r = uniform(1.0);
+        roles[host] = r < 0.80 ? HOST_ABSENT : r < 0.92 ? HOST_CLOSED : HOST_OTHER;
+    }
+    rng_state = seed;
+    roles[DEVICE_HOST] = HOST_CLOSED;   // Never probed
+    roles[GATEWAY_HOST] = HOST_OTHER;   // The router's web interface
+    hotpin_host = hotpin;
+    if (hotpin > 0) {
+        roles[hotpin] = HOST_HOTPIN;
+    }
+
+    for (int host = 1; host < 255; host++) {
+        listeners[host] = -1;
+        fillers[host] = -1;
+        if (roles[host] == HOST_CLOSED) {
+            continue;
+        }
+        listeners[host] = listen_on(host, roles[host] == HOST_ABSENT ? 0 : 64);
+        if (roles[host] == HOST_ABSENT) {
+            // One queued connection fills a backlog of 0; later SYNs are dropped
+            fillers[host] = socket(AF_INET, SOCK_STREAM, 0);
+            struct sockaddr_in sa = { .sin_family = AF_INET, .sin_port = htons(port),
+                                      .sin_addr.s_addr = host_addr(host) };
+            connect(fillers[host], (struct sockaddr*)&sa, sizeof(sa));
+        }
+    }
+}
+
+static void teardown_subnet(void) {
+    for (int host = 1; host < 255; host++) {
+        if (fillers[host] >= 0) {
+            close(fillers[host]);
+        }
+        if (listeners[host] >= 0) {
+            close(listeners[host]);
+        }
+        listeners[host] = fillers[host] = -1;
+    }
+}
+
+// Answer /health on the HotPin and other web servers
+static void *serve(void *arg) {
+    (void)arg;
+    struct pollfd fds[256];
+    int hosts[256];
+    while (serving) {
+        int n = 0;
+        for (int host = 1; host < 255; host++) {
+            if (listeners[host] >= 0 && (roles[host] == HOST_HOTPIN || roles[host] == HOST_OTHER)) {
+                fds[n].fd = listeners[host];
+                fds[n].events = POLLIN;
+                hosts[n++] = host;
+            }
+        }
+        if (poll(fds, n, 20) <= 0) {
+            continue;
+        }
+        for (int i = 0; i < n; i++) {
+            if (!(fds[i].revents & POLLIN)) {
+                continue;
+            }
+            int conn = accept(fds[i].fd, NULL, NULL);
+            if (conn < 0) {
+                continue;
+            }
+            char request[512];
+            recv(conn, request, sizeof(request), 0);
+            const char *response = roles[hosts[i]] == HOST_HOTPIN ? HOTPIN_RESPONSE : OTHER_RESPONSE;
+            send(conn, response, strlen(response), MSG_NOSIGNAL);
+            close(conn);
+        }
+    }
+    return NULL;
+}
+
+static int add_candidate(uint32_t *out, int count, uint32_t addr) {
+    for (int i = 0; i < count; i++) {
+        if (out[i] == addr) {
+            return count;
+        }
+    }
+    out[count] = addr;
+    return count + 1;
+}
+
+// As build_probe_candidates() in network_discovery.c, for the simulated /24
+static int build_candidates(uint32_t *out) {
+    int count = 0;
+    for (int step = 1; step < 256; step++) {
+        if (DEVICE_HOST - step >= 1) {
+            count = add_candidate(out, count, host_addr(DEVICE_HOST - step));
+        }
+        if (DEVICE_HOST + step <= 254) {
+            count = add_candidate(out, count, host_addr(DEVICE_HOST + step));
+        }
+        if (step == 5) {
+            count = add_candidate(out, count, host_addr(GATEWAY_HOST));
+        }
+    }
+    return count;
+}
+
+// The scan before the probe engine: nearest ten, gateway, three common IPs,
+// one at a time
+static int build_legacy_candidates(uint32_t *out) {
+    int count = 0;
+    for (int host = DEVICE_HOST - 5; host <= DEVICE_HOST + 5; host++) {
+        if (host != DEVICE_HOST) {
+            out[count++] = host_addr(host);
+        }
+    }
+    out[count++] = host_addr(GATEWAY_HOST);
+    return count;
+}
+
+static int find_host(const uint32_t *addrs, int index) {
+    if (index < 0) {
+        return -1;
+    }
+    for (int host = 1; host < 255; host++) {
+        if (host_addr(host) == addrs[index]) {
+            return host;
+        }
+    }
+    return -1;
+}
+
+static void print_row(const char *scenario, const char *scan, int found_host, const probe_stats_t *s) {
+    char found[16];
+    snprintf(found, sizeof(found), found_host > 0 ? ".%d" : "-", found_host);
+    printf("%-6s %-10s %9u %8s %7u %8u %8u %12u %9u\n", scenario, scan, s->elapsed_ms, found, s->probed,
+           s->refused, s->not_hotpin, s->unreachable, s->max_open);
+}
+
+static void run_legacy(const char *scenario, uint32_t *common, int common_count) {
+    uint32_t addrs[MAX_CANDIDATES];
+    int count = build_legacy_candidates(addrs);
+    for (int i = 0; i < common_count; i++) {
+        addrs[count++] = common[i];
+    }
+    probe_config_t config = { port, 1, LEGACY_TIMEOUT_MS, LEGACY_TIMEOUT_MS };
+    probe_stats_t total = { 0 };
+    int found_host = -1;
+    for (int i = 0; i < count && found_host < 0; i++) {
+        probe_stats_t s;
+        int found = probe_hotpin_servers(&addrs[i], 1, &config, &s);
+        total.probed += s.probed;
+        total.refused += s.refused;
+        total.unreachable += s.unreachable;
+        total.not_hotpin += s.not_hotpin;
+        total.elapsed_ms += s.elapsed_ms;
+        total.max_open = 1;
+        if (found == 0) {
+            found_host = find_host(addrs, i);
+        } else {
+            usleep(LEGACY_PAUSE_MS * 1000);
+            total.elapsed_ms += LEGACY_PAUSE_MS;
+        }
+    }
+    print_row(scenario, "sequential", found_host, &total);
+}
+
+static int usage(const char *prog) {
+    fprintf(stderr, "usage: %s [--timeout-ms 250] [--port 18000] [--net 77] [--seed 1] [--no-legacy]\n", prog);
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    uint32_t timeout_ms = 250;
+    int legacy = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--no-legacy") == 0) {
+            legacy = 0;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return usage(argv[0]);
+        }
+        const char *value = argv[++i];
+        if (strcmp(argv[i - 1], "--timeout-ms") == 0) {
+            timeout_ms = (uint32_t)atoi(value);
+        } else if (strcmp(argv[i - 1], "--port") == 0) {
+            port = (uint16_t)atoi(value);
+        } else if (strcmp(argv[i - 1], "--net") == 0) {
+            net_octet = atoi(value);
+        } else if (strcmp(argv[i - 1], "--seed") == 0) {
+            rng_state = strtoul(value, NULL, 10);
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if (net_octet < 1 || net_octet > 253) {
+        fprintf(stderr, "--net must be 1..253\n");
+        return 2;
+    }
+
+    // The three common IPs: absent hosts on the next /24
+    int saved_net = net_octet;
+    int common_listeners[3], common_fillers[3];
+    uint32_t common[3];
+    net_octet = saved_net + 1;
+    for (int i = 0; i < 3; i++) {
+        common_listeners[i] = listen_on(100 + i, 0);
+        common[i] = host_addr(100 + i);
+        common_fillers[i] = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in sa = { .sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = common[i] };
+        connect(common_fillers[i], (struct sockaddr*)&sa, sizeof(sa));
+    }
+    net_octet = saved_net;
+
+    static const struct { const char *name; int host; } scenarios[] = {
+        { "near", NEAR_HOST },
+        { "far",  FAR_HOST  },
+        { "none", -1        },
+    };
+    static const int parallels[] = { 4, 8, 16 };
+
+    printf("discovery probe of 127.0.%d.0/24, device .%d, connect timeout %u ms\n\n", net_octet, DEVICE_HOST,
+           timeout_ms);
+    printf("%-6s %-10s %9s %8s %7s %8s %8s %12s %9s\n", "server", "scan", "time ms", "found", "probed",
+           "refused", "other", "unreachable", "max open");
+    for (size_t s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++) {
+        build_subnet(scenarios[s].host);
+        serving = 1;
+        pthread_t server;
+        pthread_create(&server, NULL, serve, NULL);
+
+        if (legacy) {
+            run_legacy(scenarios[s].name, common, 3);
+        }
+        for (size_t p = 0; p < sizeof(parallels) / sizeof(parallels[0]); p++) {
+            uint32_t addrs[MAX_CANDIDATES];
+            int count = build_candidates(addrs);
+            for (int i = 0; i < 3; i++) {
+                count = add_candidate(addrs, count, common[i]);
+            }
+            probe_config_t config = { port, (uint8_t)parallels[p], timeout_ms, 1500 };
+            probe_stats_t stats;
+            int found = probe_hotpin_servers(addrs, count, &config, &stats);
+            char name[16];
+            snprintf(name, sizeof(name), "%d sockets", parallels[p]);
+            print_row(scenarios[s].name, name, find_host(addrs, found), &stats);
+        }
+
+        serving = 0;
+        pthread_join(server, NULL);
+        teardown_subnet();
+    }
+    for (int i = 0; i < 3; i++) {
+        close(common_fillers[i]);
+        close(common_listeners[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,602 @@
+/*
+ * HotPin Firmware Scheduling Profile Simulation (host)
+ *
+ * Runs the audio and network tasks of the "default" and "tuned" profiles
+ * (main/task_profile.c) on a model of the two ESP32 cores and reports the
+ * counters the telemetry message carries: capture jitter and playback
+ * underruns. The same load is replayed against both profiles.
+ *
+ * The model:
+ *
+ *   - FreeRTOS scheduling on two cores in 10 us steps: the highest-priority
+ *     ready task that may run on a core gets it, a higher priority preempts
+ *     at once, and equal priorities take turns on each 1 ms tick. Unpinned
+ *     tasks move to whichever core is free. Context switches cost nothing.
+ *   - the Wi-Fi task (priority 23) and lwIP (18) are pinned to the PRO CPU,
+ *     as sdkconfig does in both profiles. Wi-Fi also runs bursts of 0.1-2 ms
+ *     at random, taking --wifi-load of the PRO CPU, for other traffic.
+ *   - --cpu-load adds an unpinned worker at priority 5 in both profiles,
+ *     running 2-20 ms bursts: anything else CPU-bound at the default
+ *     priority (a log flood, a JPEG copy, a feature added later).
+ *   - capture: the I2S DMA completes a 64 ms buffer at a time, and
+ *     i2s_read returns once the task runs with the data there. Each block
+ *     costs the noise suppressor and the copy to PSRAM. The read that
+ *     completes a frame is where the firmware takes its jitter sample
+ *     (|interval - frame period|). The DMA ring holds four buffers; more
+ *     than that unread is an overrun.
+ *   - each frame goes through audio_send, websocket_message, lwIP and Wi-Fi,
+ *     with a CPU cost per KB on each; --net-us-per-kb is the WebSocket
+ *     client's (higher with TLS). The server acks every 4th frame.
+ *   - playback: TTS frames of 500 ms arrive from the server at
+ *     --downlink-kbps with a random 0..--downlink-jitter-ms each, and go
+ *     through Wi-Fi, lwIP, the WebSocket client task and ws_dispatch into
+ *     q_playback. The playback task writes 64 ms blocks into the DMA ring as
+ *     it frees up. The queue staying empty for 100 ms before the stream has
+ *     ended is an underrun, as counted by audio_playback_task; the DMA ring
+ *     running dry is counted separately.
+ *
+ * Each run records for --seconds and then plays back --seconds of TTS.
+ * With no --wifi-load the built-in presets are run.
+ *
+ * Usage:
+ *     gcc -O2 -o sched_sim tools/sched_sim.c
+ *     ./sched_sim                                     # all presets, default vs tuned
+ *     ./sched_sim --wifi-load 0.6 --net-us-per-kb 250 [--cpu-load 0.5] [--seconds 60]
+ *                 [--frame-ms 500] [--downlink-kbps 1000] [--downlink-jitter-ms 100] [--seed 1]
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Firmware constants (main.h, memory_plan.h)
+#define SAMPLE_RATE             16000
+#define BYTES_PER_MS            (SAMPLE_RATE * 2 / 1000)
+#define DMA_BUF_BYTES           2048    // I2S_DMA_BUF_LEN frames, 64 ms
+#define DMA_BUF_COUNT           4
+#define TTS_FRAME_BYTES         16000
+#define QUEUE_LEN_PLAYBACK      16
+#define PLAYBACK_WAIT_US        100000  // xQueueReceive timeout in audio_playback_task
+#define ACK_EVERY               4
+
+#define STEP_US                 10
+#define RTOS_TICK_US            1000
+#define ANY_CORE                (-1)
+#define MAX_JOBS                256
+
+// Per-job CPU costs (us), rough figures for a 240 MHz core
+#define COST_NS_BLOCK_US        1200    // 8 noise suppressor hops
+#define COST_CAPTURE_COPY_US    40
+#define COST_SEND_META_US       300     // cJSON metadata message
+#define COST_WS_FRAME_US        100
+#define COST_TCPIP_PER_KB_US    40
+#define COST_WIFI_PER_KB_US     25
+#define COST_WIFI_FRAME_US      50
+#define COST_DISPATCH_TEXT_US   300
+#define COST_DISPATCH_PER_KB_US 20
+#define COST_PLAYBACK_BLOCK_US  50
+#define COST_SMALL_MSG_BYTES    64
+
+typedef enum {
+    T_WIFI,
+    T_TCPIP,
+    T_WS_CLIENT,
+    T_WS_MESSAGE,
+    T_WS_DISPATCH,
+    T_AUDIO_SEND,
+    T_AUDIO_CAPTURE,
+    T_AUDIO_PLAYBACK,
+    T_WORKER,
+    T_COUNT
+} task_id_t;
+
+typedef struct {
+    const char *name;
+    int priority[2];    // default, tuned
+    int core[2];
+} task_def_t;
+
+// Mirrors profile_tasks in main/task_profile.c (0 = PRO CPU, 1 = APP CPU)
+static const task_def_t task_defs[T_COUNT] = {
+    [T_WIFI]           = { "wifi",              { 23, 23 }, { 0, 0 } },
+    [T_TCPIP]          = { "tcpip",             { 18, 18 }, { 0, 0 } },
+    [T_WS_CLIENT]      = { "websocket_task",    {  5,  6 }, { ANY_CORE, ANY_CORE } },
+    [T_WS_MESSAGE]     = { "websocket_message", {  5,  6 }, { ANY_CORE, 0 } },
+    [T_WS_DISPATCH]    = { "ws_dispatch",       {  5,  6 }, { ANY_CORE, 0 } },
+    [T_AUDIO_SEND]     = { "audio_send",        {  5,  7 }, { ANY_CORE, 0 } },
+    [T_AUDIO_CAPTURE]  = { "audio_capture",     {  5, 12 }, { ANY_CORE, 1 } },
+    [T_AUDIO_PLAYBACK] = { "audio_playback",    {  5, 12 }, { ANY_CORE, 1 } },
+    [T_WORKER]         = { "worker",            {  5,  5 }, { ANY_CORE, ANY_CORE } },
+};
+
+typedef enum {
+    J_NOISE,            // Other Wi-Fi traffic
+    J_WORK,             // --cpu-load
+    J_WIFI_TX,
+    J_WIFI_RX,
+    J_TCPIP_TX,
+    J_TCPIP_RX,
+    J_WS_SEND,
+    J_WS_READ,
+    J_DISPATCH,
+    J_SEND_FRAME,
+    J_CAPTURE_BLOCK,
+    J_PLAYBACK_BLOCK,
+} job_kind_t;
+
+typedef struct {
+    job_kind_t kind;
+    int64_t left_us;
+    uint32_t bytes;
+    bool tts;           // Downlink TTS frame rather than a small message
+} job_t;
+
+typedef struct {
+    job_t jobs[MAX_JOBS];
+    int head;
+    int count;
+    uint64_t seq;       // Ready-list order among equal priorities
+    int priority;
+    int core;
+    int64_t busy_us;
+} task_t;
+
+typedef struct {
+    const char *name;
+    double wifi_load;
+    double cpu_load;
+    double net_us_per_kb;
+    double downlink_kbps;
+    double downlink_jitter_ms;
+} preset_t;
+
+static const preset_t presets[] = {
+    { "quiet",      0.10, 0.0,  30.0, 1000.0,  50.0 },
+    { "busy",       0.50, 0.0,  30.0, 1000.0, 100.0 },
+    { "busy-tls",   0.50, 0.0, 250.0, 1000.0, 100.0 },
+    { "saturated",  0.85, 0.0, 250.0,  600.0, 300.0 },
+    { "busy+cpu",   0.50, 0.5, 250.0, 1000.0, 100.0 },
+    { "sat+cpu",    0.85, 0.9, 250.0,  600.0, 300.0 },
+};
+
+typedef struct {
+    uint32_t reads;             // Reads that completed a frame
+    uint32_t intervals;
+    double jitter_total_us;
+    double jitter_max_us;
+    double latency_total_us;
+    double latency_max_us;
+    uint32_t overruns;
+    uint32_t underruns;
+    uint32_t dma_underruns;
+    double core_load[2];
+} result_t;
+
+static unsigned long rng_state = 1;
+
+static double uniform(double max) {
+    rng_state = rng_state * 6364136223846793005UL + 1442695040888963407UL;
+    return max * (double)((rng_state >> 33) & 0x7fffffff) / 2147483648.0;
+}
+
+static task_t tasks[T_COUNT];
+static int running[2];
+static uint64_t ready_seq;
+static int64_t now_us;
+
+static void push_job(task_id_t id, job_kind_t kind, double cost_us, uint32_t bytes, bool tts) {
+    task_t *t = &tasks[id];
+    if (t->count == MAX_JOBS) {
+        fprintf(stderr, "%s job queue overflow\n", task_defs[id].name);
+        exit(1);
+    }
+    if (t->count == 0) {
+        t->seq = ++ready_seq;
+    }
+    t->jobs[(t->head + t->count) % MAX_JOBS] = (job_t){ kind, (int64_t)cost_us, bytes, tts };
+    t->count++;
+}
+
+static double per_kb(double us_per_kb, uint32_t bytes) {
+    return us_per_kb * bytes / 1024.0;
+}
+
+// Capture and playback state
+static struct {
+    int64_t start_us;
+    uint64_t consumed;          // Bytes read from the DMA ring
+    uint32_t frame_bytes;
+    uint32_t frame_filled;
+    uint32_t frames;
+    int64_t last_read_us;
+    bool reading;
+} cap;
+
+static struct {
+    bool active;
+    int queued;                 // Frames in q_playback
+    uint32_t chunk_left;        // Of the frame being written
+    double dma_us;              // Audio in the DMA ring
+    bool dma_started;
+    bool stream_active;
+    bool end_of_stream;
+    int64_t wait_since;
+    int frames_total;
+    int frames_sent;
+    int frames_delivered;       // Into q_playback
+    int frames_played;
+    double next_arrival_us;
+} play;
+
+static uint32_t capture_available(void) {
+    int64_t elapsed = now_us - cap.start_us;
+    return (uint32_t)((elapsed / 1000) * BYTES_PER_MS / DMA_BUF_BYTES) * DMA_BUF_BYTES;
+}
+
+static void poll_capture(result_t *r) {
+    task_t *t = &tasks[T_AUDIO_CAPTURE];
+    if (t->count > 0 || cap.start_us < 0) {
+        return;
+    }
+    uint64_t available = capture_available();
+    if (available - cap.consumed > DMA_BUF_COUNT * DMA_BUF_BYTES) {
+        uint64_t lost = available - cap.consumed - DMA_BUF_COUNT * DMA_BUF_BYTES;
+        cap.consumed += lost;
+        r->overruns++;
+    }
+    uint32_t want = cap.frame_bytes - cap.frame_filled;
+    if (want > DMA_BUF_BYTES) {
+        want = DMA_BUF_BYTES;
+    }
+    if (available - cap.consumed >= want) {
+        push_job(T_AUDIO_CAPTURE, J_CAPTURE_BLOCK, COST_NS_BLOCK_US + COST_CAPTURE_COPY_US, want, false);
+        cap.reading = true;
+    }
+}
+
+// i2s_read returns when the task runs with the data there
+static void capture_read_returned(result_t *r, const job_t *job) {
+    cap.reading = false;
+    if (cap.frame_filled + job->bytes < cap.frame_bytes) {
+        return;
+    }
+    // Data for the end of the frame was complete at the end of its DMA buffer
+    uint64_t last_byte = cap.consumed + job->bytes;
+    int64_t ready_us = cap.start_us + (int64_t)(((last_byte + DMA_BUF_BYTES - 1) / DMA_BUF_BYTES) * DMA_BUF_BYTES
+                                                / BYTES_PER_MS) * 1000;
+    double latency = (double)(now_us - ready_us);
+    r->reads++;
+    r->latency_total_us += latency;
+    if (latency > r->latency_max_us) {
+        r->latency_max_us = latency;
+    }
+    if (cap.frames > 0) {
+        double period_us = (double)cap.frame_bytes / BYTES_PER_MS * 1000.0;
+        double jitter = (double)(now_us - cap.last_read_us) - period_us;
+        jitter = jitter < 0 ? -jitter : jitter;
+        r->intervals++;
+        r->jitter_total_us += jitter;
+        if (jitter > r->jitter_max_us) {
+            r->jitter_max_us = jitter;
+        }
+    }
+    cap.last_read_us = now_us;
+}
+
+static void poll_playback(result_t *r) {
+    if (!play.active) {
+        return;
+    }
+    if (play.dma_started) {
+        play.dma_us -= STEP_US;
+        if (play.dma_us <= 0) {
+            play.dma_us = 0;
+            if (play.frames_played < play.frames_total || play.chunk_left > 0 || play.queued > 0) {
+                r->dma_underruns++;
+            }
+            play.dma_started = false;
+        }
+    }
+
+    task_t *t = &tasks[T_AUDIO_PLAYBACK];
+    if (t->count > 0) {
+        return;
+    }
+    if (play.chunk_left == 0 && play.queued > 0) {
+        play.queued--;
+        play.chunk_left = TTS_FRAME_BYTES;
+        play.wait_since = -1;
+    }
+    if (play.chunk_left > 0) {
+        // i2s_write blocks until a DMA buffer is free
+        double block_us = (double)DMA_BUF_BYTES / BYTES_PER_MS * 1000.0;
+        if (play.dma_us + block_us <= DMA_BUF_COUNT * block_us) {
+            uint32_t block = play.chunk_left < DMA_BUF_BYTES ? play.chunk_left : DMA_BUF_BYTES;
+            push_job(T_AUDIO_PLAYBACK, J_PLAYBACK_BLOCK, COST_PLAYBACK_BLOCK_US, block, false);
+        }
+        return;
+    }
+
+    if (play.end_of_stream && play.frames_played == play.frames_total) {
+        play.active = play.dma_us > 0;
+        return;
+    }
+    if (play.wait_since < 0) {
+        play.wait_since = now_us;
+    } else if (now_us - play.wait_since >= PLAYBACK_WAIT_US) {
+        if (play.stream_active && !play.end_of_stream) {
+            r->underruns++;
+        }
+        play.stream_active = false;
+        play.wait_since = now_us;
+    }
+}
+
+static void finish_job(const job_t *job, double net_us_per_kb) {
+    switch (job->kind) {
+    case J_CAPTURE_BLOCK:
+        cap.consumed += job->bytes;
+        cap.frame_filled += job->bytes;
+        if (cap.frame_filled == cap.frame_bytes) {
+            cap.frame_filled = 0;
+            cap.frames++;
+            push_job(T_AUDIO_SEND, J_SEND_FRAME, COST_SEND_META_US, cap.frame_bytes, false);
+        }
+        break;
+    case J_SEND_FRAME:
+        push_job(T_WS_MESSAGE, J_WS_SEND, COST_WS_FRAME_US + per_kb(net_us_per_kb, COST_SMALL_MSG_BYTES),
+                 COST_SMALL_MSG_BYTES, false);
+        push_job(T_WS_MESSAGE, J_WS_SEND, COST_WS_FRAME_US + per_kb(net_us_per_kb, job->bytes), job->bytes, false);
+        break;
+    case J_WS_SEND:
+        push_job(T_TCPIP, J_TCPIP_TX, per_kb(COST_TCPIP_PER_KB_US, job->bytes), job->bytes, false);
+        break;
+    case J_TCPIP_TX:
+        push_job(T_WIFI, J_WIFI_TX, COST_WIFI_FRAME_US + per_kb(COST_WIFI_PER_KB_US, job->bytes), job->bytes, false);
+        // The server acks every 4th chunk
+        if (job->bytes > COST_SMALL_MSG_BYTES && cap.frames % ACK_EVERY == 0) {
+            push_job(T_WIFI, J_WIFI_RX, COST_WIFI_FRAME_US, COST_SMALL_MSG_BYTES, false);
+        }
+        break;
+    case J_WIFI_RX:
+        push_job(T_TCPIP, J_TCPIP_RX, per_kb(COST_TCPIP_PER_KB_US, job->bytes), job->bytes, job->tts);
+        break;
+    case J_TCPIP_RX:
+        push_job(T_WS_CLIENT, J_WS_READ, COST_WS_FRAME_US + per_kb(net_us_per_kb, job->bytes), job->bytes, job->tts);
+        break;
+    case J_WS_READ:
+        push_job(T_WS_DISPATCH, J_DISPATCH,
+                 job->tts ? COST_DISPATCH_TEXT_US + per_kb(COST_DISPATCH_PER_KB_US, job->bytes) : COST_DISPATCH_TEXT_US,
+                 job->bytes, job->tts);
+        break;
+    case J_DISPATCH:
+        if (job->tts) {
+            play.queued++;
+            play.frames_delivered++;
+            if (play.frames_delivered == play.frames_total) {
+                play.end_of_stream = true;      // tts_done follows the last frame
+            }
+        }
+        break;
+    case J_PLAYBACK_BLOCK:
+        play.chunk_left -= job->bytes;
+        play.dma_us += (double)job->bytes / BYTES_PER_MS * 1000.0;
+        play.dma_started = true;
+        play.stream_active = true;
+        if (play.chunk_left == 0) {
+            play.frames_played++;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static bool eligible(int id, int core) {
+    const task_t *t = &tasks[id];
+    return t->count > 0 && (t->core == ANY_CORE || t->core == core) && running[1 - core] != id;
+}
+
+static int pick(int core) {
+    int best = -1;
+    for (int i = 0; i < T_COUNT; i++) {
+        if (!eligible(i, core)) {
+            continue;
+        }
+        if (best < 0 || tasks[i].priority > tasks[best].priority ||
+            (tasks[i].priority == tasks[best].priority && tasks[i].seq < tasks[best].seq)) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+static void schedule(void) {
+    bool tick = now_us % RTOS_TICK_US == 0;
+    for (int core = 0; core < 2; core++) {
+        int cur = running[core];
+        if (cur >= 0 && tasks[cur].count == 0) {
+            cur = -1;
+        }
+        running[core] = -1;     // So the pick may keep it
+        int best = pick(core);
+        if (cur >= 0 && best != cur && tasks[best].priority <= tasks[cur].priority) {
+            best = cur;         // Not preempted by equal priority between ticks
+        }
+        if (tick && cur >= 0 && best == cur) {
+            // Time slice: the running task goes to the back of its priority
+            uint64_t seq = tasks[cur].seq;
+            tasks[cur].seq = ++ready_seq;
+            int next = pick(core);
+            if (next >= 0 && tasks[next].priority == tasks[cur].priority) {
+                best = next;
+            } else {
+                tasks[cur].seq = seq;
+            }
+        }
+        running[core] = best;
+    }
+}
+
+static void run(const preset_t *p, int profile, int seconds, uint32_t frame_ms, result_t *r) {
+    memset(r, 0, sizeof(*r));
+    memset(tasks, 0, sizeof(tasks));
+    memset(&cap, 0, sizeof(cap));
+    memset(&play, 0, sizeof(play));
+    for (int i = 0; i < T_COUNT; i++) {
+        tasks[i].priority = task_defs[i].priority[profile];
+        tasks[i].core = task_defs[i].core[profile];
+    }
+    running[0] = running[1] = -1;
+    ready_seq = 0;
+
+    int64_t record_us = (int64_t)seconds * 1000000;
+    int64_t end_us = 2 * record_us + 2000000;
+    double noise_mean_us = 1050.0;
+    double next_noise_us = uniform(2.0 * noise_mean_us / p->wifi_load);
+    double work_mean_us = 11000.0;
+    double next_work_us = p->cpu_load > 0.0 ? uniform(2.0 * work_mean_us / p->cpu_load) : 1e300;
+    double frame_tx_us = TTS_FRAME_BYTES * 8.0 / p->downlink_kbps * 1000.0;
+
+    cap.start_us = 0;
+    cap.frame_bytes = frame_ms * BYTES_PER_MS;
+    play.frames_total = seconds * 1000 / (TTS_FRAME_BYTES / BYTES_PER_MS);
+    play.wait_since = -1;
+
+    for (now_us = 0; now_us < end_us; now_us += STEP_US) {
+        while (next_noise_us <= now_us) {
+            push_job(T_WIFI, J_NOISE, 100.0 + uniform(1900.0), 0, false);
+            next_noise_us += uniform(2.0 * noise_mean_us / p->wifi_load);
+        }
+        while (next_work_us <= now_us) {
+            push_job(T_WORKER, J_WORK, 2000.0 + uniform(18000.0), 0, false);
+            next_work_us += uniform(2.0 * work_mean_us / p->cpu_load);
+        }
+        if (now_us == record_us) {
+            cap.start_us = -1;     // Recording over; playback starts
+            play.active = true;
+            play.next_arrival_us = (double)now_us;
+        }
+        if (play.active && play.frames_sent < play.frames_total && play.next_arrival_us <= now_us &&
+            play.queued < QUEUE_LEN_PLAYBACK) {
+            push_job(T_WIFI, J_WIFI_RX, COST_WIFI_FRAME_US + per_kb(COST_WIFI_PER_KB_US, TTS_FRAME_BYTES),
+                     TTS_FRAME_BYTES, true);
+            play.frames_sent++;
+            play.next_arrival_us += frame_tx_us + uniform(p->downlink_jitter_ms * 1000.0);
+        }
+        poll_capture(r);
+        poll_playback(r);
+        schedule();
+
+        for (int core = 0; core < 2; core++) {
+            int id = running[core];
+            if (id < 0) {
+                continue;
+            }
+            task_t *t = &tasks[id];
+            job_t *job = &t->jobs[t->head];
+            if (id == T_AUDIO_CAPTURE && cap.reading) {
+                capture_read_returned(r, job);
+            }
+            job->left_us -= STEP_US;
+            t->busy_us += STEP_US;
+            r->core_load[core] += STEP_US;
+            if (job->left_us <= 0) {
+                job_t done = *job;
+                t->head = (t->head + 1) % MAX_JOBS;
+                t->count--;
+                finish_job(&done, p->net_us_per_kb);
+                if (t->count > 0) {
+                    t->seq = ++ready_seq;
+                }
+            }
+        }
+    }
+    r->core_load[0] /= (double)end_us;
+    r->core_load[1] /= (double)end_us;
+}
+
+static void print_row(const char *name, const char *profile, const result_t *r) {
+    printf("%-10s %-8s %8.1f %8.1f %9.2f %8.2f %8u %9u %8u %5.0f%% %5.0f%%\n", name, profile,
+           r->intervals ? r->jitter_total_us / r->intervals / 1000.0 : 0.0, r->jitter_max_us / 1000.0,
+           r->reads ? r->latency_total_us / r->reads / 1000.0 : 0.0, r->latency_max_us / 1000.0,
+           r->overruns, r->underruns, r->dma_underruns, 100.0 * r->core_load[0], 100.0 * r->core_load[1]);
+}
+
+static int usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [--wifi-load L --cpu-load C --net-us-per-kb N --downlink-kbps K --downlink-jitter-ms J]\n"
+            "          [--seconds 60] [--frame-ms 500] [--seed 1]\n", prog);
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    preset_t custom = { "custom", 0.0, 0.0, 30.0, 1000.0, 100.0 };
+    int seconds = 60;
+    uint32_t frame_ms = 500;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            return usage(argv[0]);
+        }
+        const char *value = argv[++i];
+        if (strcmp(argv[i - 1], "--wifi-load") == 0) {
+            custom.wifi_load = atof(value);
+        } else if (strcmp(argv[i - 1], "--cpu-load") == 0) {
+            custom.cpu_load = atof(value);
+        } else if (strcmp(argv[i - 1], "--net-us-per-kb") == 0) {
+            custom.net_us_per_kb = atof(value);
+        } else if (strcmp(argv[i - 1], "--downlink-kbps") == 0) {
+            custom.downlink_kbps = atof(value);
+        } else if (strcmp(argv[i - 1], "--downlink-jitter-ms") == 0) {
+            custom.downlink_jitter_ms = atof(value);
+        } else if (strcmp(argv[i - 1], "--seconds") == 0) {
+            seconds = atoi(value);
+        } else if (strcmp(argv[i - 1], "--frame-ms") == 0) {
+            frame_ms = (uint32_t)atoi(value);
+        } else if (strcmp(argv[i - 1], "--seed") == 0) {
+            rng_state = strtoul(value, NULL, 10);
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if (seconds < 1 || seconds > 600) {
+        fprintf(stderr, "--seconds must be 1..600\n");
+        return 2;
+    }
+    if (frame_ms < 20 || frame_ms > 500) {
+        fprintf(stderr, "--frame-ms must be 20..500\n");
+        return 2;
+    }
+    if (custom.wifi_load < 0.0 || custom.wifi_load >= 1.0) {
+        fprintf(stderr, "--wifi-load must be 0..0.99\n");
+        return 2;
+    }
+    if (custom.cpu_load < 0.0 || custom.cpu_load >= 1.0) {
+        fprintf(stderr, "--cpu-load must be 0..0.99\n");
+        return 2;
+    }
+
+    const preset_t *list = presets;
+    int count = sizeof(presets) / sizeof(presets[0]);
+    if (custom.wifi_load > 0.0) {
+        list = &custom;
+        count = 1;
+    }
+
+    printf("%d s recording in %u ms frames, then %d s of TTS playback\n\n", seconds, frame_ms, seconds);
+    printf("%-10s %-8s %8s %8s %9s %8s %8s %9s %8s %6s %6s\n", "load", "profile", "jit avg", "jit max",
+           "read avg", "read max", "overrun", "underrun", "dma dry", "cpu0", "cpu1");
+    for (int i = 0; i < count; i++) {
+        result_t def, tuned;
+        unsigned long seed = rng_state;
+        run(&list[i], 0, seconds, frame_ms, &def);
+        rng_state = seed;  // Same traffic for both
+        run(&list[i], 1, seconds, frame_ms, &tuned);
+        print_row(list[i].name, "default", &def);
+        print_row(list[i].name, "tuned", &tuned);
+    }
+    return 0;
+}
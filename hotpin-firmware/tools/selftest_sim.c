@@ -0,0 +1,340 @@
+/*
+ * HotPin Firmware Audio Self-Test Simulation (host)
+ *
+ * Runs main/selftest.c against a timing model of the device instead of
+ * the I2S driver, and prints the same "selftest_report" JSON the firmware
+ * sends to the server, so the report format and the pass/fail logic can be
+ * exercised without hardware.
+ *
+ * The model:
+ *
+ *   - I2S RX and TX DMA rings of I2S_DMA_BUF_COUNT x 1024 frames running
+ *     off one clock, optionally off nominal by --rate-ppm. The microphone
+ *     hears low-level noise, so loopback has real samples to carry and
+ *     check, and the peak played back is reported. A read blocks
+ *     until a block has arrived; a ring that fills up drops its oldest
+ *     buffers and counts an overrun, like I2S_EVENT_RX_Q_OVF. A write
+ *     blocks until there is room; a ring that runs dry plays silence and
+ *     counts an underrun, like I2S_EVENT_TX_Q_OVF.
+ *   - a chunk pool of --pool chunks and a block queue of the device's depth
+ *   - typical ESP32 costs for the pool, the block copy or tone, and the
+ *     queue, and a WebSocket ping every 4 blocks with a random round trip
+ *   - --stall-ms N --stall-every K holds the task for N ms every K blocks,
+ *     as a Wi-Fi burst or a flash write would
+ *
+ * The core load is the modelled task's own time, reported for core 1
+ * (the APP CPU in the tuned profile); core 0 is left unknown.
+ *
+ * Usage:
+ *     gcc -O2 -Imain -o selftest_sim tools/selftest_sim.c main/selftest.c -lm
+ *     ./selftest_sim [--mode loopback] [--duration-ms 5000] [--rate-ppm 0]
+ *                    [--stall-ms 0 --stall-every 50] [--pool 4]
+ *
+ * Exits 0 if the simulated run passes, 1 if it fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "selftest.h"
+
+// Firmware constants (main.h, diagnostics.c)
+#define SAMPLE_RATE             16000
+#define I2S_DMA_BUF_COUNT       4
+#define I2S_DMA_BUF_LEN         1024
+#define RING_SAMPLES            (I2S_DMA_BUF_COUNT * I2S_DMA_BUF_LEN)
+#define QUEUE_LEN               (SELFTEST_QUEUE_TARGET + 2)
+#define PING_BLOCKS             4
+#define MAX_POOL                16
+
+// Typical costs on the ESP32 at 240 MHz
+#define POOL_US                 4       // alloc_chunk() / free_chunk()
+#define COPY_US                 12      // 2 KB memcpy
+#define CHECKSUM_US             30      // Block checksum, on encode and again on consume
+#define TONE_US                 45      // One block of tone
+#define QUEUE_US                6       // xQueueSend / xQueueReceive
+#define I2S_CALL_US             25      // i2s_read / i2s_write, mutex included
+#define EVENT_POLL_US           10
+#define PING_US                 300     // cJSON build + q_ws_messages send
+#define RTT_MIN_US              15000
+#define RTT_SPREAD_US           40000
+
+typedef struct {
+    int64_t now_us;
+    double rate_hz;                 // Actual DMA sample rate
+    uint64_t busy_us;               // Time the task spent running, not blocked
+
+    uint64_t rx_read;               // Samples handed to the task
+    uint64_t rx_dropped;            // Lost to overruns
+    bool tx_started;
+    int64_t tx_start_us;
+    uint64_t tx_written;            // Samples queued to the TX ring
+    uint64_t tx_silence;            // Samples played as silence after underruns
+    int rx_peak;                    // Loudest microphone and speaker samples
+    int tx_peak;
+
+    uint8_t *pool[MAX_POOL];
+    int pool_free;
+
+    selftest_block_t queue[QUEUE_LEN];
+    int queue_head;
+    int queue_count;
+
+    int stall_ms;
+    int stall_every;
+    uint32_t blocks_seen;
+    uint32_t pending_rx_overruns;
+    uint32_t pending_tx_underruns;
+    selftest_stage_stats_t ws_rtt;
+} sim_t;
+
+static uint32_t rng_state = 0x12345678u;
+
+static uint32_t next_rand(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static void spend(sim_t *sim, int64_t us) {
+    sim->now_us += us;
+    sim->busy_us += (uint64_t)us;
+}
+
+// Samples the DMA clock has produced (RX) or consumed (TX) since start_us
+static uint64_t dma_samples(const sim_t *sim, int64_t start_us, int64_t at_us) {
+    return at_us > start_us ? (uint64_t)((double)(at_us - start_us) * sim->rate_hz / 1e6) : 0;
+}
+
+static int64_t dma_time(const sim_t *sim, int64_t start_us, uint64_t samples) {
+    return start_us + (int64_t)((double)samples * 1e6 / sim->rate_hz + 0.999);
+}
+
+static int64_t sim_now_us(void *ctx) {
+    return ((sim_t*)ctx)->now_us;
+}
+
+static bool sim_i2s_read(void *ctx, int16_t *pcm, size_t samples) {
+    sim_t *sim = ctx;
+    spend(sim, I2S_CALL_US);
+
+    // Oldest buffers are overwritten once the ring is full
+    uint64_t produced = dma_samples(sim, 0, sim->now_us);
+    uint64_t pending = produced - sim->rx_read - sim->rx_dropped;
+    if (pending > RING_SAMPLES) {
+        uint64_t lost = (pending - RING_SAMPLES + I2S_DMA_BUF_LEN - 1) / I2S_DMA_BUF_LEN * I2S_DMA_BUF_LEN;
+        sim->rx_dropped += lost;
+        sim->pending_rx_overruns += (uint32_t)(lost / I2S_DMA_BUF_LEN);
+    }
+
+    uint64_t needed = sim->rx_read + sim->rx_dropped + samples;
+    int64_t ready_us = dma_time(sim, 0, needed);
+    if (ready_us > sim->now_us) {
+        sim->now_us = ready_us;  // Blocked on the DMA
+    }
+    // Room noise around -30 dBFS, a function of the sample's position in
+    // the stream so the same samples come out however the reads are timed
+    uint64_t first = sim->rx_read + sim->rx_dropped;
+    for (size_t i = 0; i < samples; i++) {
+        uint32_t h = (uint32_t)(first + i) * 2654435761u;
+        pcm[i] = (int16_t)((int32_t)(h >> 22) - 512);
+        int mag = pcm[i] < 0 ? -pcm[i] : pcm[i];
+        if (mag > sim->rx_peak) {
+            sim->rx_peak = mag;
+        }
+    }
+    sim->rx_read += samples;
+    return true;
+}
+
+static bool sim_i2s_write(void *ctx, const int16_t *pcm, size_t samples) {
+    sim_t *sim = ctx;
+    spend(sim, I2S_CALL_US);
+
+    if (!sim->tx_started) {
+        sim->tx_started = true;
+        sim->tx_start_us = sim->now_us;
+    }
+
+    // The ring ran dry since the last write: silence went out instead
+    uint64_t played = dma_samples(sim, sim->tx_start_us, sim->now_us);
+    uint64_t queued = sim->tx_written + sim->tx_silence;
+    if (played > queued) {
+        uint64_t gap = (played - queued + I2S_DMA_BUF_LEN - 1) / I2S_DMA_BUF_LEN * I2S_DMA_BUF_LEN;
+        sim->tx_silence += gap;
+        sim->pending_tx_underruns += (uint32_t)(gap / I2S_DMA_BUF_LEN);
+        queued += gap;
+    }
+
+    // Block until the ring has room for the whole block
+    if (queued + samples > played + RING_SAMPLES) {
+        int64_t room_us = dma_time(sim, sim->tx_start_us, queued + samples - RING_SAMPLES);
+        if (room_us > sim->now_us) {
+            sim->now_us = room_us;
+        }
+    }
+    for (size_t i = 0; i < samples; i++) {
+        int mag = pcm[i] < 0 ? -pcm[i] : pcm[i];
+        if (mag > sim->tx_peak) {
+            sim->tx_peak = mag;
+        }
+    }
+    sim->tx_written += samples;
+    return true;
+}
+
+static uint8_t* sim_alloc(void *ctx) {
+    sim_t *sim = ctx;
+    spend(sim, POOL_US);
+    return sim->pool_free > 0 ? sim->pool[--sim->pool_free] : NULL;
+}
+
+static void sim_release(void *ctx, uint8_t *chunk) {
+    sim_t *sim = ctx;
+    spend(sim, POOL_US);
+    sim->pool[sim->pool_free++] = chunk;
+}
+
+static bool sim_enqueue(void *ctx, const selftest_block_t *block) {
+    sim_t *sim = ctx;
+    spend(sim, QUEUE_US);
+    if (sim->queue_count == QUEUE_LEN) {
+        return false;
+    }
+    sim->queue[(sim->queue_head + sim->queue_count++) % QUEUE_LEN] = *block;
+    return true;
+}
+
+static bool sim_dequeue(void *ctx, selftest_block_t *block) {
+    sim_t *sim = ctx;
+    spend(sim, QUEUE_US);
+    if (sim->queue_count == 0) {
+        return false;
+    }
+    *block = sim->queue[sim->queue_head];
+    sim->queue_head = (sim->queue_head + 1) % QUEUE_LEN;
+    sim->queue_count--;
+    return true;
+}
+
+static void sim_on_block(void *ctx, selftest_report_t *report) {
+    sim_t *sim = ctx;
+    spend(sim, EVENT_POLL_US);
+    report->rx_overruns += sim->pending_rx_overruns;
+    if (report->tx_samples > 0) {
+        report->tx_underruns += sim->pending_tx_underruns;
+    }
+    sim->pending_rx_overruns = 0;
+    sim->pending_tx_underruns = 0;
+
+    sim->blocks_seen++;
+    if (sim->blocks_seen % PING_BLOCKS == 0) {
+        spend(sim, PING_US);
+        uint32_t rtt_us = RTT_MIN_US + next_rand() % RTT_SPREAD_US;
+        sim->ws_rtt.count++;
+        sim->ws_rtt.total_us += rtt_us;
+        if (rtt_us > sim->ws_rtt.max_us) {
+            sim->ws_rtt.max_us = rtt_us;
+        }
+    }
+    if (sim->stall_ms > 0 && sim->stall_every > 0 && sim->blocks_seen % (uint32_t)sim->stall_every == 0) {
+        sim->now_us += (int64_t)sim->stall_ms * 1000;  // Preempted, not busy
+    }
+}
+
+static int usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [--mode capture|loopback|playback] [--duration-ms N] [--rate-ppm N]\n"
+                    "          [--stall-ms N --stall-every K] [--pool N]\n", prog);
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    selftest_mode_t mode = SELFTEST_LOOPBACK;
+    uint32_t duration_ms = 5000;
+    double rate_ppm = 0.0;
+    int pool_count = 4;
+    sim_t sim;
+    memset(&sim, 0, sizeof(sim));
+    sim.stall_every = 50;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            return usage(argv[0]);
+        }
+        const char *value = argv[++i];
+        if (strcmp(argv[i - 1], "--mode") == 0) {
+            if (!selftest_mode_from_string(value, &mode)) {
+                return usage(argv[0]);
+            }
+        } else if (strcmp(argv[i - 1], "--duration-ms") == 0) {
+            duration_ms = (uint32_t)atoi(value);
+        } else if (strcmp(argv[i - 1], "--rate-ppm") == 0) {
+            rate_ppm = atof(value);
+        } else if (strcmp(argv[i - 1], "--stall-ms") == 0) {
+            sim.stall_ms = atoi(value);
+        } else if (strcmp(argv[i - 1], "--stall-every") == 0) {
+            sim.stall_every = atoi(value);
+        } else if (strcmp(argv[i - 1], "--pool") == 0) {
+            pool_count = atoi(value);
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if (pool_count < 1 || pool_count > MAX_POOL) {
+        fprintf(stderr, "--pool must be 1..%d\n", MAX_POOL);
+        return 2;
+    }
+
+    static uint8_t chunks[MAX_POOL][SELFTEST_BLOCK_SAMPLES * sizeof(int16_t)];
+    for (int i = 0; i < pool_count; i++) {
+        sim.pool[i] = chunks[i];
+    }
+    sim.pool_free = pool_count;
+    sim.rate_hz = SAMPLE_RATE * (1.0 + rate_ppm / 1e6);
+
+    static int16_t scratch[SELFTEST_BLOCK_SAMPLES];
+    const selftest_platform_t platform = {
+        .now_us = sim_now_us,
+        .i2s_read = sim_i2s_read,
+        .i2s_write = sim_i2s_write,
+        .alloc = sim_alloc,
+        .release = sim_release,
+        .enqueue = sim_enqueue,
+        .dequeue = sim_dequeue,
+        .on_block = sim_on_block,
+        .ctx = &sim,
+        .scratch = scratch,
+        .sample_rate = SAMPLE_RATE,
+    };
+
+    selftest_report_t report;
+    selftest_run(&platform, mode, duration_ms, &report);
+
+    // The block copy (and checksum) or tone runs between two reads of the
+    // virtual clock, so its modelled cost is added to the encode stage
+    // afterwards; the consumer's checksum only counts towards the load
+    selftest_stage_stats_t *encode = &report.stages[SELFTEST_STAGE_ENCODE];
+    uint32_t encode_cost_us = mode == SELFTEST_PLAYBACK ? TONE_US : COPY_US + CHECKSUM_US;
+    uint64_t encode_us = (uint64_t)encode->count * encode_cost_us;
+    uint64_t verify_us = mode == SELFTEST_PLAYBACK ? 0 : (uint64_t)report.blocks * CHECKSUM_US;
+    encode->total_us += encode_us;
+    encode->max_us += encode_cost_us;
+    report.stages[SELFTEST_STAGE_WS_RTT] = sim.ws_rtt;
+    if (report.elapsed_ms > 0) {
+        uint64_t permille = (sim.busy_us + encode_us + verify_us) / report.elapsed_ms;
+        report.cpu_permille[1] = permille > 1000 ? 1000 : (int32_t)permille;
+    }
+
+    char json[1024];
+    if (!selftest_report_json(&report, json, sizeof(json))) {
+        fprintf(stderr, "Report does not fit\n");
+        return 2;
+    }
+    printf("%s\n", json);
+    if (mode == SELFTEST_LOOPBACK) {
+        fprintf(stderr, "Loopback: microphone peak %d, played back at peak %d\n", sim.rx_peak, sim.tx_peak);
+    }
+    return selftest_passed(&report) ? 0 : 1;
+}
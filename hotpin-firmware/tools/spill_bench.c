@@ -0,0 +1,193 @@
+/*
+ * HotPin Firmware Spill Log Benchmark (host)
+ *
+ * Runs main/spill_log.c against a file-backed partition image with NOR
+ * flash semantics (erase to 0xFF, program ANDs bits) and reports append
+ * and replay throughput, recovery after a simulated reboot, eviction,
+ * CRC handling and discarding a backlog. Device flash timing is estimated from the number of sector
+ * erases and programmed bytes using the datasheet figures below.
+ *
+ * Usage:
+ *     gcc -O2 -Imain -o spill_bench tools/spill_bench.c main/spill_log.c
+ *     ./spill_bench [image_path] [partition_kb]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "spill_log.h"
+
+#define CHUNK_BYTES         16000   // Matches main.h
+#define SECTOR_ERASE_US     45000   // Typical 4 KB sector erase (W25Q32)
+#define PAGE_PROGRAM_US     700     // Typical 256 B page program
+
+typedef struct {
+    FILE *file;
+    uint32_t size;
+    uint64_t erased_sectors;
+    uint64_t programmed_bytes;
+    uint64_t read_bytes;
+} file_flash_t;
+
+static bool file_read(void *ctx, uint32_t offset, void *dst, size_t len) {
+    file_flash_t *ff = ctx;
+    if (offset + len > ff->size || fseek(ff->file, offset, SEEK_SET) != 0) {
+        return false;
+    }
+    ff->read_bytes += len;
+    return fread(dst, 1, len, ff->file) == len;
+}
+
+static bool file_write(void *ctx, uint32_t offset, const void *src, size_t len) {
+    file_flash_t *ff = ctx;
+    uint8_t *merged = malloc(len);
+    if (!merged || offset + len > ff->size || fseek(ff->file, offset, SEEK_SET) != 0 ||
+        fread(merged, 1, len, ff->file) != len) {
+        free(merged);
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        merged[i] &= ((const uint8_t*)src)[i];  // NOR: program only clears bits
+    }
+    bool ok = fseek(ff->file, offset, SEEK_SET) == 0 && fwrite(merged, 1, len, ff->file) == len;
+    free(merged);
+    ff->programmed_bytes += len;
+    return ok;
+}
+
+static bool file_erase(void *ctx, uint32_t offset, size_t len) {
+    file_flash_t *ff = ctx;
+    if (offset % SPILL_SECTOR_BYTES || len % SPILL_SECTOR_BYTES || offset + len > ff->size) {
+        return false;
+    }
+    static uint8_t blank[SPILL_SECTOR_BYTES];
+    memset(blank, 0xFF, sizeof(blank));
+    for (size_t done = 0; done < len; done += SPILL_SECTOR_BYTES) {
+        if (fseek(ff->file, offset + done, SEEK_SET) != 0 || fwrite(blank, 1, sizeof(blank), ff->file) != sizeof(blank)) {
+            return false;
+        }
+        ff->erased_sectors++;
+    }
+    return true;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void fill_chunk(uint8_t *buf, uint32_t seq) {
+    for (int i = 0; i < CHUNK_BYTES; i++) {
+        buf[i] = (uint8_t)(seq * 31 + i);
+    }
+}
+
+static double modeled_device_s(const file_flash_t *ff) {
+    return (ff->erased_sectors * SECTOR_ERASE_US + (ff->programmed_bytes + 255) / 256 * PAGE_PROGRAM_US) / 1e6;
+}
+
+static spill_flash_t flash_ops(file_flash_t *ff) {
+    spill_flash_t flash = { file_read, file_write, file_erase, ff, ff->size };
+    return flash;
+}
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : "spill_bench.img";
+    uint32_t size_kb = argc > 2 ? (uint32_t)atoi(argv[2]) : 1024;
+
+    file_flash_t ff = { .size = size_kb * 1024 };
+    ff.file = fopen(path, "w+b");
+    if (!ff.file) {
+        perror(path);
+        return 2;
+    }
+    uint8_t *blank = malloc(ff.size);
+    memset(blank, 0xFF, ff.size);
+    fwrite(blank, 1, ff.size, ff.file);
+    free(blank);
+
+    spill_flash_t flash = flash_ops(&ff);
+    spill_log_t log;
+    if (!spill_log_open(&log, &flash, 0)) {
+        fprintf(stderr, "Error: partition too small\n");
+        return 2;
+    }
+    printf("Partition: %u KB, %u slots of %d bytes\n", size_kb, log.slot_count, SPILL_SLOT_BYTES);
+
+    uint8_t chunk[CHUNK_BYTES], out[CHUNK_BYTES];
+    int failures = 0;
+
+    // 1. Disconnect: spill 75% of capacity
+    uint32_t spilled = log.slot_count * 3 / 4;
+    double t0 = now_s();
+    for (uint32_t seq = 0; seq < spilled; seq++) {
+        fill_chunk(chunk, seq);
+        failures += !spill_log_append(&log, seq, chunk, sizeof(chunk));
+    }
+    double append_s = now_s() - t0;
+    printf("Append:  %u chunks, host %.1f MB/s, modeled device %.1f KB/s (%.1f ms/chunk)\n",
+           spilled, spilled * CHUNK_BYTES / append_s / 1e6,
+           spilled * CHUNK_BYTES / modeled_device_s(&ff) / 1024,
+           modeled_device_s(&ff) * 1000 / spilled);
+
+    // 2. Reboot: recover pending records from flash
+    if (!spill_log_open(&log, &flash, 0) || log.pending != spilled) {
+        printf("FAIL: recovery found %u of %u pending chunks\n", log.pending, spilled);
+        failures++;
+    } else {
+        printf("Recover: %u pending chunks after reopen\n", log.pending);
+    }
+
+    // 3. Reconnect: replay in order
+    t0 = now_s();
+    uint32_t expect = 0, seq;
+    size_t len;
+    while (spill_log_peek(&log, &seq, out, sizeof(out), &len)) {
+        fill_chunk(chunk, expect);
+        if (seq != expect || len != CHUNK_BYTES || memcmp(out, chunk, len) != 0) {
+            printf("FAIL: replay order/content mismatch at %u (got %u)\n", expect, seq);
+            failures++;
+            break;
+        }
+        spill_log_consume(&log);
+        expect++;
+    }
+    double replay_s = now_s() - t0;
+    printf("Replay:  %u chunks in order, host %.1f MB/s\n", expect, expect * CHUNK_BYTES / replay_s / 1e6);
+    failures += expect != spilled;
+
+    // 4. Long outage: 2x capacity, oldest evicted
+    uint32_t base = 1000;
+    for (uint32_t i = 0; i < log.slot_count * 2; i++) {
+        fill_chunk(chunk, base + i);
+        failures += !spill_log_append(&log, base + i, chunk, sizeof(chunk));
+    }
+    spill_log_peek(&log, &seq, out, sizeof(out), &len);
+    printf("Evict:   %u evicted, oldest pending seq %u (expected %u)\n",
+           log.stats.evicted, seq, base + log.slot_count);
+    failures += seq != base + log.slot_count;
+
+    // 5. Corruption: flip a payload byte in the oldest record
+    uint8_t zero = 0;
+    file_write(&ff, log.tail * SPILL_SLOT_BYTES + SPILL_HEADER_BYTES + 100, &zero, 1);
+    spill_log_peek(&log, &seq, out, sizeof(out), &len);
+    printf("CRC:     %u corrupt record skipped, next seq %u\n", log.stats.crc_errors, seq);
+    failures += log.stats.crc_errors != 1 || seq != base + log.slot_count + 1;
+
+    // 6. Reboot with a backlog: discarded records stay gone after reopen
+    uint32_t dropped = spill_log_discard(&log);
+    spill_log_open(&log, &flash, 0);
+    printf("Discard: %u pending chunks dropped, %u found after reopen\n", dropped, log.pending);
+    failures += dropped == 0 || log.pending != 0;
+
+    printf("Wear:    slot erase count %u-%u after %u appends\n",
+           log.stats.erase_min, log.stats.erase_max, spilled + log.slot_count * 2);
+
+    fclose(ff.file);
+    remove(path);
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,190 @@
+/*
+ * HotPin Firmware State Machine Table Test (host)
+ *
+ * Checks main/state_machine.c against the transitions listed below:
+ * every declared edge carries exactly the listed side effects, every other
+ * pair is rejected and counted in the edge's "rejected" statistic, and
+ * SHUTDOWN has no outgoing edges. Update the list together with the table.
+ *
+ * Usage:
+ *     gcc -O2 -Wall -Imain -o state_machine_test tools/state_machine_test.c main/state_machine.c
+ *     ./state_machine_test
+ *
+ * Exits non-zero on the first mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "state_machine.h"
+
+#define LED      SM_EFFECT_LED
+#define EARCON   SM_EFFECT_EARCON
+#define RELEASE  SM_EFFECT_I2S_RELEASE
+#define LEAVE_RECORDING  (SM_EFFECT_I2S_RELEASE | SM_EFFECT_MSG_RECORDING_STOPPED)
+#define ENTER_RECORDING  (SM_EFFECT_I2S_RX | SM_EFFECT_MSG_RECORDING_STARTED)
+#define ENTER_PLAYING    (SM_EFFECT_I2S_TX | SM_EFFECT_MSG_READY_PLAYBACK)
+
+typedef struct {
+    client_state_t from;
+    client_state_t to;
+    uint32_t effects;
+} expected_edge_t;
+
+static const expected_edge_t expected_edges[] = {
+    { CLIENT_STATE_BOOTING,        CLIENT_STATE_CONNECTED,      LED },
+    { CLIENT_STATE_BOOTING,        CLIENT_STATE_IDLE,           LED },
+    { CLIENT_STATE_BOOTING,        CLIENT_STATE_STALLED,        EARCON | LED },
+    { CLIENT_STATE_BOOTING,        CLIENT_STATE_SHUTDOWN,       LED },
+
+    { CLIENT_STATE_CONNECTED,      CLIENT_STATE_IDLE,           SM_EFFECT_MSG_CLIENT_ON | LED },
+    { CLIENT_STATE_CONNECTED,      CLIENT_STATE_STALLED,        EARCON | LED },
+    { CLIENT_STATE_CONNECTED,      CLIENT_STATE_SHUTDOWN,       LED },
+
+    { CLIENT_STATE_IDLE,           CLIENT_STATE_RECORDING,      ENTER_RECORDING | LED },
+    { CLIENT_STATE_IDLE,           CLIENT_STATE_PLAYING,        ENTER_PLAYING | LED },
+    { CLIENT_STATE_IDLE,           CLIENT_STATE_CAMERA_CAPTURE, LED },
+    { CLIENT_STATE_IDLE,           CLIENT_STATE_SELF_TEST,      RELEASE | LED },
+    { CLIENT_STATE_IDLE,           CLIENT_STATE_STALLED,        EARCON | LED },
+    { CLIENT_STATE_IDLE,           CLIENT_STATE_SHUTDOWN,       LED },
+
+    { CLIENT_STATE_RECORDING,      CLIENT_STATE_IDLE,           LEAVE_RECORDING | LED },
+    { CLIENT_STATE_RECORDING,      CLIENT_STATE_PROCESSING,     LEAVE_RECORDING | EARCON | LED },
+    { CLIENT_STATE_RECORDING,      CLIENT_STATE_STALLED,        LEAVE_RECORDING | EARCON | LED },
+    { CLIENT_STATE_RECORDING,      CLIENT_STATE_SHUTDOWN,       LEAVE_RECORDING | LED },
+
+    { CLIENT_STATE_PROCESSING,     CLIENT_STATE_IDLE,           LED },
+    { CLIENT_STATE_PROCESSING,     CLIENT_STATE_PLAYING,        ENTER_PLAYING | LED },
+    { CLIENT_STATE_PROCESSING,     CLIENT_STATE_STALLED,        EARCON | LED },
+    { CLIENT_STATE_PROCESSING,     CLIENT_STATE_SHUTDOWN,       LED },
+
+    { CLIENT_STATE_PLAYING,        CLIENT_STATE_RECORDING,      ENTER_RECORDING | LED },
+    { CLIENT_STATE_PLAYING,        CLIENT_STATE_IDLE,           RELEASE | SM_EFFECT_MSG_PLAYBACK_COMPLETE | LED },
+    { CLIENT_STATE_PLAYING,        CLIENT_STATE_STALLED,        RELEASE | EARCON | LED },
+    { CLIENT_STATE_PLAYING,        CLIENT_STATE_SHUTDOWN,       RELEASE | LED },
+
+    { CLIENT_STATE_CAMERA_CAPTURE, CLIENT_STATE_IDLE,           LED },
+    { CLIENT_STATE_CAMERA_CAPTURE, CLIENT_STATE_STALLED,        EARCON | LED },
+    { CLIENT_STATE_CAMERA_CAPTURE, CLIENT_STATE_SHUTDOWN,       LED },
+
+    { CLIENT_STATE_STALLED,        CLIENT_STATE_CONNECTED,      LED },
+    { CLIENT_STATE_STALLED,        CLIENT_STATE_IDLE,           LED },
+    { CLIENT_STATE_STALLED,        CLIENT_STATE_SHUTDOWN,       LED },
+
+    { CLIENT_STATE_SELF_TEST,      CLIENT_STATE_IDLE,           RELEASE | LED },
+    { CLIENT_STATE_SELF_TEST,      CLIENT_STATE_STALLED,        RELEASE | EARCON | LED },
+    { CLIENT_STATE_SELF_TEST,      CLIENT_STATE_SHUTDOWN,       RELEASE | LED },
+};
+
+#define EXPECTED_EDGE_COUNT (sizeof(expected_edges) / sizeof(expected_edges[0]))
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do {                   \
+    if (!(cond)) {                              \
+        printf("FAIL: " __VA_ARGS__);           \
+        printf("\n");                           \
+        failures++;                             \
+    }                                           \
+} while (0)
+
+static const expected_edge_t* find_expected(client_state_t from, client_state_t to) {
+    for (size_t i = 0; i < EXPECTED_EDGE_COUNT; i++) {
+        if (expected_edges[i].from == from && expected_edges[i].to == to) {
+            return &expected_edges[i];
+        }
+    }
+    return NULL;
+}
+
+static void test_declared_edges(void) {
+    for (size_t i = 0; i < EXPECTED_EDGE_COUNT; i++) {
+        const expected_edge_t *edge = &expected_edges[i];
+        const char *from = state_to_string(edge->from);
+        const char *to = state_to_string(edge->to);
+        uint32_t effects = 0;
+
+        CHECK(sm_is_valid_transition(edge->from, edge->to), "%s -> %s should be declared", from, to);
+        CHECK(sm_transition_effects(edge->from, edge->to) == edge->effects,
+              "%s -> %s effects 0x%03x, expected 0x%03x", from, to,
+              (unsigned)sm_transition_effects(edge->from, edge->to), (unsigned)edge->effects);
+        CHECK(sm_request_transition(edge->from, edge->to, &effects) && effects == edge->effects,
+              "%s -> %s should be accepted with its effects", from, to);
+        CHECK(sm_get_edge_stats(edge->from, edge->to)->rejected == 0, "%s -> %s counted as rejected", from, to);
+    }
+}
+
+static void test_undeclared_edges(void) {
+    sm_reset_stats();
+    for (int from = 0; from < CLIENT_STATE_COUNT; from++) {
+        for (int to = 0; to < CLIENT_STATE_COUNT; to++) {
+            if (from == to || find_expected(from, to)) {
+                continue;
+            }
+            const char *from_name = state_to_string(from);
+            const char *to_name = state_to_string(to);
+            uint32_t effects = 0xdead;
+
+            CHECK(!sm_is_valid_transition(from, to), "%s -> %s should be undeclared", from_name, to_name);
+            CHECK(sm_transition_effects(from, to) == SM_EFFECT_NONE, "%s -> %s has effects", from_name, to_name);
+            CHECK(!sm_request_transition(from, to, &effects), "%s -> %s should be rejected", from_name, to_name);
+            CHECK(!sm_request_transition(from, to, &effects), "%s -> %s should be rejected", from_name, to_name);
+            CHECK(effects == 0xdead, "%s -> %s rejected but wrote effects", from_name, to_name);
+            CHECK(sm_get_edge_stats(from, to)->rejected == 2, "%s -> %s rejected %u times, expected 2",
+                  from_name, to_name, (unsigned)sm_get_edge_stats(from, to)->rejected);
+        }
+    }
+
+    // Requesting the current state is a no-op, not a rejection
+    for (int state = 0; state < CLIENT_STATE_COUNT; state++) {
+        CHECK(!sm_request_transition(state, state, NULL), "%s -> itself should not apply", state_to_string(state));
+        CHECK(sm_get_edge_stats(state, state)->rejected == 0, "%s -> itself counted as rejected",
+              state_to_string(state));
+    }
+
+    // Out-of-range states are neither edges nor counted
+    CHECK(!sm_is_valid_transition(CLIENT_STATE_COUNT, CLIENT_STATE_IDLE), "Out-of-range state accepted");
+    CHECK(!sm_request_transition(CLIENT_STATE_IDLE, CLIENT_STATE_COUNT, NULL), "Out-of-range state accepted");
+    CHECK(sm_get_edge_stats(CLIENT_STATE_IDLE, CLIENT_STATE_COUNT) == NULL, "Out-of-range stats returned");
+
+    sm_reset_stats();
+    CHECK(sm_get_edge_stats(CLIENT_STATE_IDLE, CLIENT_STATE_CONNECTED)->rejected == 0, "Reset left rejections");
+}
+
+static void test_shutdown_terminal(void) {
+    for (int to = 0; to < CLIENT_STATE_COUNT; to++) {
+        CHECK(!sm_is_valid_transition(CLIENT_STATE_SHUTDOWN, to), "SHUTDOWN -> %s should not exist",
+              state_to_string(to));
+    }
+    for (int from = 0; from < CLIENT_STATE_COUNT; from++) {
+        if (from != CLIENT_STATE_SHUTDOWN) {
+            CHECK(sm_is_valid_transition(from, CLIENT_STATE_SHUTDOWN), "%s -> SHUTDOWN should exist",
+                  state_to_string(from));
+        }
+    }
+}
+
+static void test_latency_stats(void) {
+    sm_reset_stats();
+    sm_record_latency(CLIENT_STATE_IDLE, CLIENT_STATE_RECORDING, 1000);
+    sm_record_latency(CLIENT_STATE_IDLE, CLIENT_STATE_RECORDING, 3000);
+    const sm_edge_stats_t *stats = sm_get_edge_stats(CLIENT_STATE_IDLE, CLIENT_STATE_RECORDING);
+    CHECK(stats->count == 2 && stats->total_us == 4000 && stats->max_us == 3000,
+          "Latency stats count=%u total=%llu max=%u", (unsigned)stats->count,
+          (unsigned long long)stats->total_us, (unsigned)stats->max_us);
+    sm_reset_stats();
+}
+
+int main(void) {
+    test_declared_edges();
+    test_undeclared_edges();
+    test_shutdown_terminal();
+    test_latency_stats();
+
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("State machine table: %zu edges, all checks passed\n", EXPECTED_EDGE_COUNT);
+    return EXIT_SUCCESS;
+}
@@ -2,8 +2,11 @@
 import asyncio
 import json
 import os
+import secrets
+import struct
 import time
-from typing import Dict, Optional, Callable
+from dataclasses import dataclass
+from typing import Dict, List, Optional, Callable, Tuple
 from collections import deque
 from .config import Config
 from .utils import create_logger, create_temp_file, create_wave_file, estimate_audio_duration
@@ -11,6 +14,313 @@ from .session_manager import Session, SessionState
 
 logger = create_logger(__name__)
 
+# Audio over UDP: an RTP header (RFC 3550, no CSRCs or extensions) and a
+# PCM16 payload, normally 20 ms. Parity packets share the SSRC; their
+# sequence number and timestamp are those of the first audio packet they
+# protect, and the payload is a count, the XOR of the protected payload
+# lengths and the XOR of the payloads (each zero-padded to the longest).
+RTP_VERSION = 2
+RTP_PT_AUDIO = 96
+RTP_PT_FEC = 97
+RTP_HEADER = struct.Struct("!BBHII")
+RTP_FEC_HEADER = struct.Struct("!BBH")
+RTP_FEC_MAX_GROUP = 16
+RTP_MAX_PAYLOAD = 1400
+UDP_FRAME_MS = 20
+
+
+@dataclass
+class RtpPacket:
+    payload_type: int
+    marker: bool        # First packet of a recording
+    seq: int            # 16 bits, wraps
+    timestamp: int      # Samples
+    ssrc: int
+    payload: bytes
+
+
+def parse_rtp(data: bytes) -> Optional[RtpPacket]:
+    """Parse one datagram, or None if it is not an audio or parity packet."""
+    if len(data) <= RTP_HEADER.size or len(data) > RTP_HEADER.size + RTP_MAX_PAYLOAD:
+        return None
+    first, second, seq, timestamp, ssrc = RTP_HEADER.unpack_from(data)
+    payload_type = second & 0x7f
+    if first != RTP_VERSION << 6 or payload_type not in (RTP_PT_AUDIO, RTP_PT_FEC):
+        return None
+    payload = data[RTP_HEADER.size:]
+    if payload_type == RTP_PT_AUDIO and len(payload) % 2:
+        return None
+    if payload_type == RTP_PT_FEC:
+        if len(payload) <= RTP_FEC_HEADER.size or not 1 <= payload[0] <= RTP_FEC_MAX_GROUP:
+            return None
+    return RtpPacket(payload_type, bool(second & 0x80), seq, timestamp, ssrc, payload)
+
+
+def rtp_packet(seq: int, timestamp: int, ssrc: int, payload: bytes, marker: bool = False,
+               payload_type: int = RTP_PT_AUDIO) -> bytes:
+    """Build a packet as the firmware does (used by tests and tools)."""
+    return RTP_HEADER.pack(RTP_VERSION << 6, (0x80 if marker else 0) | payload_type,
+                           seq & 0xffff, timestamp & 0xffffffff, ssrc) + payload
+
+
+def _xor_payloads(payloads: List[bytes], size: int) -> Tuple[int, int]:
+    """XOR of the payloads (as an integer) and of their lengths."""
+    data = 0
+    lengths = 0
+    for payload in payloads:
+        data ^= int.from_bytes(payload.ljust(size, b"\0"), "big")
+        lengths ^= len(payload)
+    return data, lengths
+
+
+def fec_packet(seq: int, timestamp: int, ssrc: int, payloads: List[bytes]) -> bytes:
+    """Build the parity packet for the audio payloads from seq on."""
+    size = max(len(p) for p in payloads)
+    data, lengths = _xor_payloads(payloads, size)
+    header = RTP_FEC_HEADER.pack(len(payloads), 0, lengths)
+    return rtp_packet(seq, timestamp, ssrc, header + data.to_bytes(size, "big"), payload_type=RTP_PT_FEC)
+
+
+@dataclass
+class ReleasedFrame:
+    seq: int            # Extended sequence number
+    payload: bytes
+    kind: str           # "received", "recovered" or "lost" (released as silence)
+    ready_at: float     # When it arrived or was recovered
+
+
+class JitterBuffer:
+    """Puts one stream's packets back in order and fills the gaps.
+
+    Frames come out in sequence. A missing frame holds back the ones after
+    it for at most depth_ms from when the first of them arrived. Parity
+    recovers it as soon as the rest of its group is in; if that does not
+    happen in time it is released as silence, which keeps the transcript's
+    timing where dropping it would not.
+    """
+
+    HISTORY = 2 * RTP_FEC_MAX_GROUP     # Released payloads kept for recovery
+    MAX_PENDING = 250                   # 5 s of 20 ms frames held before a recording starts
+
+    def __init__(self, depth_ms: int):
+        self.depth = depth_ms / 1000
+        self._pending: Dict[int, Tuple[bytes, float, str]] = {}
+        self._released: Dict[int, bytes] = {}
+        self._groups: Dict[int, Tuple[int, int, bytes]] = {}  # First seq -> (count, length XOR, data XOR)
+        self._next: Optional[int] = None
+        self._highest: Optional[int] = None
+        self._started = False
+        self._frame_len = UDP_FRAME_MS * 32  # 16 kHz PCM16 until a frame says otherwise
+        self.reset_stats()
+
+    def reset_stats(self):
+        self.stats = {"received": 0, "duplicate": 0, "late": 0, "reordered": 0, "overflow": 0,
+                      "fec_packets": 0, "recovered": 0, "lost": 0, "max_hold_ms": 0, "total_hold_ms": 0}
+
+    def _extend(self, seq: int) -> int:
+        if self._highest is None:
+            return seq
+        delta = (seq - self._highest) & 0xffff
+        return self._highest + (delta - 0x10000 if delta >= 0x8000 else delta)
+
+    def push(self, packet: RtpPacket, now: float):
+        ext = self._extend(packet.seq)
+        if self._highest is None:
+            self._highest = ext
+
+        if packet.payload_type == RTP_PT_FEC:
+            count, _, lengths = RTP_FEC_HEADER.unpack_from(packet.payload)
+            self.stats["fec_packets"] += 1
+            self._groups[ext] = (count, lengths, packet.payload[RTP_FEC_HEADER.size:])
+            self._recover(ext, now)
+            return
+
+        if packet.marker and (self._next is None or ext > self._next):
+            # A new recording: anything older belongs to the last one
+            for seq in [s for s in self._pending if s < ext]:
+                del self._pending[seq]
+            self._next = ext
+            self._started = False
+        elif self._next is None:
+            self._next = ext
+
+        if ext < self._next:
+            if not self._started and self._next - ext < RTP_FEC_MAX_GROUP:
+                self._next = ext    # Overtaken by a later packet before anything was released
+            else:
+                self.stats["duplicate" if ext in self._released else "late"] += 1
+                return
+        if ext in self._pending:
+            self.stats["duplicate"] += 1
+            return
+        if len(self._pending) >= self.MAX_PENDING:
+            self.stats["overflow"] += 1
+            return
+        if ext < self._highest:
+            self.stats["reordered"] += 1
+        self._highest = max(self._highest, ext)
+        self._pending[ext] = (packet.payload, now, "received")
+        self.stats["received"] += 1
+        for base, (count, _, _) in list(self._groups.items()):
+            if base <= ext < base + count:
+                self._recover(base, now)
+
+    def _recover(self, base: int, now: float):
+        """Rebuild the one missing packet of a group from its parity."""
+        count, lengths, data = self._groups[base]
+        members = range(base, base + count)
+        missing = [s for s in members if s not in self._pending and s not in self._released]
+        if len(missing) > 1:
+            return
+        del self._groups[base]
+        if not missing or (self._next is not None and missing[0] < self._next):
+            return
+        others = [self._pending[s][0] if s in self._pending else self._released[s] for s in members if s != missing[0]]
+        xor, other_lengths = _xor_payloads(others, len(data))
+        length = lengths ^ other_lengths
+        if length == 0 or length > len(data) or length % 2:
+            return
+        payload = (int.from_bytes(data, "big") ^ xor).to_bytes(len(data), "big")[:length]
+        self._pending[missing[0]] = (payload, now, "recovered")
+        self.stats["recovered"] += 1
+
+    def _release(self, entry: Tuple[bytes, float, str], now: float, out: List[ReleasedFrame]):
+        payload, ready_at, kind = entry
+        if kind == "lost":
+            self.stats["lost"] += 1
+        else:
+            self._frame_len = len(payload)
+            self._released[self._next] = payload
+            self._released.pop(self._next - self.HISTORY, None)
+            hold_ms = int((now - ready_at) * 1000)
+            self.stats["max_hold_ms"] = max(self.stats["max_hold_ms"], hold_ms)
+            self.stats["total_hold_ms"] += hold_ms
+        out.append(ReleasedFrame(self._next, payload, kind, ready_at))
+        self._next += 1
+        self._started = True
+        for base in [b for b, (count, _, _) in self._groups.items() if b + count + self.HISTORY <= self._next]:
+            del self._groups[base]
+
+    def pop_ready(self, now: float) -> List[ReleasedFrame]:
+        """Frames that can be released now, in order."""
+        out: List[ReleasedFrame] = []
+        while self._next is not None and self._pending:
+            entry = self._pending.pop(self._next, None)
+            if entry is None:
+                # Wait for the gap while the packets after it are young
+                if now - min(arrival for _, arrival, _ in self._pending.values()) < self.depth:
+                    break
+                entry = (bytes(self._frame_len), now, "lost")
+            self._release(entry, now, out)
+        return out
+
+    def complete(self, last_seq: int) -> bool:
+        """True once every frame up to last_seq is in."""
+        if self._next is None:
+            return False
+        end = self._extend(last_seq)
+        return all(s in self._pending for s in range(self._next, end + 1))
+
+    def flush(self, now: float, last_seq: Optional[int] = None) -> List[ReleasedFrame]:
+        """Release everything up to last_seq (or what is buffered) and end
+        the recording; frames still missing are released as silence."""
+        out: List[ReleasedFrame] = []
+        end = self._extend(last_seq) if last_seq is not None else max(self._pending, default=None)
+        while self._next is not None and end is not None and self._next <= end:
+            entry = self._pending.pop(self._next, None) or (bytes(self._frame_len), now, "lost")
+            self._release(entry, now, out)
+        self._next = None
+        self._started = False
+        return out
+
+
+@dataclass
+class UdpStream:
+    session: Session
+    host: str               # Address of the session's WebSocket; packets from elsewhere are dropped
+    buffer: JitterBuffer
+    recording: bool = False
+
+
+class UdpAudioReceiver(asyncio.DatagramProtocol):
+    """Receives audio over UDP for the sessions that negotiated udp_audio.
+
+    Each session gets a random SSRC over its authenticated WebSocket, and
+    packets are only taken from the address that WebSocket comes from, so
+    the UDP path needs no credentials of its own. Frames are handed to
+    on_frame in order, while the session is recording.
+    """
+
+    def __init__(self, on_frame: Callable[[Session, int, bytes], None], depth_ms: int):
+        self.on_frame = on_frame
+        self.depth_ms = depth_ms
+        self.streams: Dict[int, UdpStream] = {}
+        self.transport = None
+        self.dropped = 0    # Malformed, for no stream or from the wrong address
+        self.logger = create_logger(self.__class__.__name__)
+
+    def connection_made(self, transport):
+        self.transport = transport
+
+    def register(self, session: Session, host: str) -> int:
+        """Open a stream for the session and return its SSRC."""
+        self.unregister(session.session_id)
+        ssrc = 0
+        while ssrc == 0 or ssrc in self.streams:
+            ssrc = secrets.randbits(32)
+        self.streams[ssrc] = UdpStream(session, host, JitterBuffer(self.depth_ms))
+        return ssrc
+
+    def unregister(self, session_id: str):
+        for ssrc in [k for k, v in self.streams.items() if v.session.session_id == session_id]:
+            del self.streams[ssrc]
+
+    def _stream(self, session: Session) -> Optional[UdpStream]:
+        return next((v for v in self.streams.values() if v.session.session_id == session.session_id), None)
+
+    def datagram_received(self, data: bytes, addr):
+        packet = parse_rtp(data)
+        stream = self.streams.get(packet.ssrc) if packet else None
+        if not stream or addr[0] != stream.host:
+            self.dropped += 1
+            return
+        now = time.monotonic()
+        stream.buffer.push(packet, now)
+        if stream.recording:
+            self._deliver(stream, stream.buffer.pop_ready(now))
+
+    def _deliver(self, stream: UdpStream, frames: List[ReleasedFrame]):
+        for frame in frames:
+            self.on_frame(stream.session, frame.seq, frame.payload)
+
+    def start(self, session: Session) -> bool:
+        """Start handing the session's frames over (recording_started);
+        packets that beat the message over are released now."""
+        stream = self._stream(session)
+        if not stream:
+            return False
+        stream.buffer.reset_stats()
+        stream.recording = True
+        self._deliver(stream, stream.buffer.pop_ready(time.monotonic()))
+        return True
+
+    async def stop(self, session: Session, last_seq: Optional[int]) -> Optional[Dict[str, int]]:
+        """End the recording (recording_stopped): wait up to the jitter
+        depth for frames up to last_seq, release the rest and return the
+        stream's stats. The client sends the message after its last
+        packet, so only a lost packet makes this wait out the depth."""
+        stream = self._stream(session)
+        if not stream or not stream.recording:
+            return None
+        deadline = time.monotonic() + self.depth_ms / 1000
+        while last_seq is not None and not stream.buffer.complete(last_seq) and time.monotonic() < deadline:
+            await asyncio.sleep(0.005)
+        now = time.monotonic()
+        self._deliver(stream, stream.buffer.pop_ready(now) + stream.buffer.flush(now, last_seq))
+        stream.recording = False
+        return dict(stream.buffer.stats)
+
+
 class AudioIngestor:
     """Handles audio chunk ingestion, buffering, and temporary file management."""
     
@@ -18,6 +328,24 @@ class AudioIngestor:
         self.logger = create_logger(self.__class__.__name__)
         self.chunk_callbacks: Dict[str, Callable] = {}  # session_id -> callback function
         self.recording_start_times: Dict[str, float] = {}  # session_id -> start time
+        self.udp: Optional[UdpAudioReceiver] = None
+    
+    async def start_udp_receiver(self, port: int, on_frame: Callable[[Session, int, bytes], None]) -> bool:
+        """Listen for audio over UDP; on_frame gets each session's frames in order."""
+        loop = asyncio.get_running_loop()
+        try:
+            _, self.udp = await loop.create_datagram_endpoint(
+                lambda: UdpAudioReceiver(on_frame, Config.UDP_JITTER_MS), local_addr=(Config.HOST, port))
+        except OSError as e:
+            self.logger.error(f"Cannot listen for UDP audio on port {port}: {e}")
+            return False
+        self.logger.info(f"Listening for UDP audio on port {port}")
+        return True
+    
+    def stop_udp_receiver(self):
+        if self.udp and self.udp.transport:
+            self.udp.transport.close()
+        self.udp = None
     
     async def start_recording_session(self, session: Session):
         """Initialize a new recording session."""
@@ -26,9 +354,15 @@ class AudioIngestor:
         temp_path = os.path.join(Config.TEMP_DIR, temp_filename)
         
         session.audio_buffer.temp_file_path = temp_path
+        session.audio_buffer.open = True
         session.audio_buffer.chunks_received = 0
         session.audio_buffer.total_bytes = 0
         session.audio_buffer.sequence_numbers = []
+        session.audio_buffer.min_chunk_bytes = 0
+        session.audio_buffer.max_chunk_bytes = 0
+        session.audio_buffer.last_chunk_at = 0.0
+        session.audio_buffer.replayed_chunks = 0
+        session.audio_buffer.udp_stats = None
         
         # Initialize file for writing
         os.makedirs(os.path.dirname(temp_path), exist_ok=True)
@@ -42,6 +376,11 @@ class AudioIngestor:
     
     async def ingest_chunk(self, session: Session, seq: int, chunk_data: bytes) -> bool:
         """Ingest an audio chunk and append it to the session's buffer."""
+        return self.append_chunk(session, seq, chunk_data)
+    
+    def append_chunk(self, session: Session, seq: int, chunk_data: bytes) -> bool:
+        """Append an audio chunk to the session's buffer (for callers outside
+        a coroutine, such as the UDP receiver)."""
         if not session.audio_buffer.temp_file_path:
             self.logger.error(f"No active recording for session {session.session_id}")
             return False
@@ -71,9 +410,13 @@ class AudioIngestor:
                 f.write(chunk_data)
             
             # Update session buffer stats
-            session.audio_buffer.chunks_received += 1
-            session.audio_buffer.total_bytes += len(chunk_data)
-            session.audio_buffer.sequence_numbers.append(seq)
+            buffer = session.audio_buffer
+            buffer.chunks_received += 1
+            buffer.total_bytes += len(chunk_data)
+            buffer.sequence_numbers.append(seq)
+            buffer.min_chunk_bytes = min(buffer.min_chunk_bytes or len(chunk_data), len(chunk_data))
+            buffer.max_chunk_bytes = max(buffer.max_chunk_bytes, len(chunk_data))
+            buffer.last_chunk_at = time.time()
             
             # Update expected sequence number
             if seq == session.expected_seq:
@@ -128,18 +471,27 @@ class AudioIngestor:
         # Get duration of recording
         duration = estimate_audio_duration(
             self.get_recording_data(session),
-            sample_rate=16000,
+            sample_rate=session.sample_rate,
             sample_width=2,
             channels=1
         )
         
         self.logger.info(f"Finalized recording for session {session.session_id}: {duration:.2f}s, {session.audio_buffer.total_bytes} bytes")
+        session.audio_buffer.open = False
         
-        # Log recording stats
+        # Log recording stats; the chunk sizes show how the client's adaptive
+        # frames settled, and the gap how long the stop trailed the last audio
+        buffer = session.audio_buffer
         session.log_event("recording_finalized", {
             "duration_seconds": duration,
-            "total_chunks": session.audio_buffer.chunks_received,
-            "total_bytes": session.audio_buffer.total_bytes
+            "total_chunks": buffer.chunks_received,
+            "total_bytes": buffer.total_bytes,
+            "min_chunk_bytes": buffer.min_chunk_bytes,
+            "max_chunk_bytes": buffer.max_chunk_bytes,
+            "avg_chunk_bytes": buffer.total_bytes // buffer.chunks_received if buffer.chunks_received else 0,
+            "last_chunk_to_stop_ms": int((time.time() - buffer.last_chunk_at) * 1000) if buffer.last_chunk_at else None,
+            "replayed_chunks": buffer.replayed_chunks,
+            "udp": buffer.udp_stats
         })
         
         return session.audio_buffer.temp_file_path
@@ -158,7 +510,7 @@ class AudioIngestor:
             return 0.0
         
         audio_data = self.get_recording_data(session)
-        return estimate_audio_duration(audio_data)
+        return estimate_audio_duration(audio_data, sample_rate=session.sample_rate)
     
     async def cleanup_recording_session(self, session: Session):
         """Clean up resources for a recording session."""
@@ -171,6 +523,7 @@ class AudioIngestor:
         
         # Clear buffer state
         session.audio_buffer.temp_file_path = ""
+        session.audio_buffer.open = False
         session.audio_buffer.chunks_received = 0
         session.audio_buffer.total_bytes = 0
         session.audio_buffer.sequence_numbers = []
@@ -28,9 +28,9 @@ class Config:
     TOKEN_TTL_SEC: int = int(os.getenv("TOKEN_TTL_SEC", "3600"))
     
     # Discovery settings
-    MDNS_ADVERTISE: bool = os.getenv("MDNS_ADVERTISE", "false").lower() == "true"
+    MDNS_ADVERTISE: bool = os.getenv("MDNS_ADVERTISE", "true").lower() == "true"
     HOTPIN_NAME: str = os.getenv("HOTPIN_NAME", "HotpinServer")
-    UDP_BROADCAST: bool = os.getenv("UDP_BROADCAST", "false").lower() == "true"
+    UDP_BROADCAST: bool = os.getenv("UDP_BROADCAST", "true").lower() == "true"  # Signed beacons for device discovery
     BROADCAST_PORT: int = int(os.getenv("BROADCAST_PORT", "50000"))
     BROADCAST_INTERVAL_SEC: int = int(os.getenv("BROADCAST_INTERVAL_SEC", "5"))
     PRINT_QR: bool = os.getenv("PRINT_QR", "false").lower() == "true"
@@ -44,7 +44,19 @@ class Config:
     # Audio settings
     CHUNK_SIZE_BYTES: int = int(os.getenv("CHUNK_SIZE_BYTES", "16000"))  # ~0.5s at 16kHz PCM16
     MIN_RECORD_DURATION_SEC: float = float(os.getenv("MIN_RECORD_DURATION_SEC", "0.5"))
-    MAX_CHUNKS_PER_SEC: int = int(os.getenv("MAX_CHUNKS_PER_SEC", "10"))
+    MAX_CHUNKS_PER_SEC: int = int(os.getenv("MAX_CHUNKS_PER_SEC", "50"))  # Shortest client frame: 20 ms
+    # Client features (from its hello) to switch off for every session, comma separated
+    SESSION_DISABLED_FEATURES: list[str] = [f.strip() for f in os.getenv("SESSION_DISABLED_FEATURES", "").split(",") if f.strip()]
+    # Versioned client settings pushed with config_update (POST /config/runtime)
+    RUNTIME_CONFIG_FILE: str = os.getenv("RUNTIME_CONFIG_FILE", "./runtime_config.json")
+    # Live audio over UDP for clients that offer udp_audio; control stays on the WebSocket
+    UDP_AUDIO: bool = os.getenv("UDP_AUDIO", "false").lower() == "true"
+    UDP_AUDIO_PORT: int = int(os.getenv("UDP_AUDIO_PORT", "5004"))
+    UDP_AUDIO_FEC_GROUP: int = int(os.getenv("UDP_AUDIO_FEC_GROUP", "4"))  # Audio packets per parity packet, 0 for none
+    UDP_JITTER_MS: int = int(os.getenv("UDP_JITTER_MS", "100"))  # Longest a gap holds back later audio
+    # Prioritised channels on the WebSocket for clients that offer mux: control jumps binary data
+    WS_MUX: bool = os.getenv("WS_MUX", "true").lower() == "true"
+    WS_MUX_SLICE_BYTES: int = int(os.getenv("WS_MUX_SLICE_BYTES", "1024"))  # Largest slice of a binary message
     
 
     
@@ -58,6 +70,9 @@ class Config:
     MAX_SESSION_DISK_MB: int = int(os.getenv("MAX_SESSION_DISK_MB", "100"))
     AUDIO_SOFT_PERCENT: int = int(os.getenv("AUDIO_SOFT_PERCENT", "80"))
     SESSION_GRACE_SEC: int = int(os.getenv("SESSION_GRACE_SEC", "30"))
+    # How long a disconnected session keeps a recording open for the client
+    # to come back and replay the audio it spilled during the outage
+    SESSION_RESUME_SEC: int = int(os.getenv("SESSION_RESUME_SEC", "300"))
     
     # Session settings
     MAX_RERECORD_ATTEMPTS: int = int(os.getenv("MAX_RERECORD_ATTEMPTS", "2"))
@@ -105,6 +120,15 @@ class Config:
         if not (1 <= cls.WEBSOCKET_PORT <= 65535):
             errors.append(f"WEBSOCKET_PORT {cls.WEBSOCKET_PORT} is not in valid range (1-65535)")
         
+        if not (1 <= cls.UDP_AUDIO_PORT <= 65535):
+            errors.append(f"UDP_AUDIO_PORT {cls.UDP_AUDIO_PORT} is not in valid range (1-65535)")
+        
+        if not (0 <= cls.UDP_AUDIO_FEC_GROUP <= 16):
+            errors.append("UDP_AUDIO_FEC_GROUP must be between 0 and 16")
+
+        if not (256 <= cls.WS_MUX_SLICE_BYTES <= 16384):
+            errors.append("WS_MUX_SLICE_BYTES must be between 256 and 16384")
+        
         # Validate chunk size (should be reasonable)
         if cls.CHUNK_SIZE_BYTES <= 0:
             errors.append("CHUNK_SIZE_BYTES must be > 0")
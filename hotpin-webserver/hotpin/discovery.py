@@ -1,5 +1,7 @@
 """Discovery module for WebSocket URL detection and advertising."""
 import asyncio
+import hashlib
+import hmac
 import json
 import socket
 import threading
@@ -102,13 +104,46 @@ def make_ws_url(ip: str, port: int, path: str, token: Optional[str] = None, use_
     return url
 
 
+BEACON_VERSION = 1
+
+
+def make_beacon(url: str, key: Optional[str], seq: int, ts: Optional[int] = None) -> bytes:
+    """
+    Build a discovery beacon for the firmware's listener (network_discovery.c).
+    
+    The beacon is JSON carrying the WebSocket URL, without the token. With a
+    key (the WebSocket token the devices hold) it is signed with HMAC-SHA256
+    over "hotpin<v>|<url>|<seq>|<ts>", so a device only follows beacons from
+    a server that knows its token. A device ignores a beacon that is not
+    newer (ts, then seq) than the last one it accepted for the URL, so a
+    captured beacon cannot be replayed.
+    
+    Args:
+        url: The WebSocket URL, without a token
+        key: Signing key, or None to send the beacon unsigned
+        seq: Beacon sequence number
+        ts: Unix time, defaults to now
+    
+    Returns:
+        bytes: The UDP payload
+    """
+    ts = int(time.time()) if ts is None else ts
+    beacon = {"type": "hotpin_beacon", "v": BEACON_VERSION, "url": url, "seq": seq, "ts": ts}
+    if key:
+        message = f"hotpin{BEACON_VERSION}|{url}|{seq}|{ts}".encode("utf-8")
+        beacon["sig"] = hmac.new(key.encode("utf-8"), message, hashlib.sha256).hexdigest()
+    return json.dumps(beacon, separators=(",", ":")).encode("utf-8")
+
+
 class DiscoveryService:
     """Main discovery service that handles all detection and advertisement methods."""
     
-    def __init__(self, port: int, path: str, token: Optional[str] = None, use_tls: bool = False):
+    def __init__(self, port: int, path: str, token: Optional[str] = None, use_tls: bool = False,
+                 beacon_key: Optional[str] = None):
         self.port = port
         self.path = path
         self.token = token
+        self.beacon_key = beacon_key
         self.use_tls = use_tls
         self.zeroconf = None
         self.udp_broadcaster = None
@@ -189,12 +224,13 @@ class DiscoveryService:
         if not enable:
             return
         
-        # Create a primary URL for broadcasting
-        primary_url = make_ws_url(get_primary_ip(), self.port, self.path, self.token, self.use_tls)
+        # Broadcast the primary URL without the token; the beacon is signed instead
+        primary_url = make_ws_url(get_primary_ip(), self.port, self.path, None, self.use_tls)
         
         class UDPBroadcaster:
-            def __init__(self, url: str, port: int, interval: int):
+            def __init__(self, url: str, key: Optional[str], port: int, interval: int):
                 self.url = url
+                self.key = key
                 self.port = port
                 self.interval = interval
                 self.running = False
@@ -205,9 +241,10 @@ class DiscoveryService:
                     sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
                     sock.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
                     
+                    seq = 0
                     while self.running:
-                        # Send the URL as UTF-8
-                        sock.sendto(self.url.encode('utf-8'), ('255.255.255.255', self.port))
+                        seq += 1
+                        sock.sendto(make_beacon(self.url, self.key, seq), ('255.255.255.255', self.port))
                         time.sleep(self.interval)
                     
                     sock.close()
@@ -225,7 +262,9 @@ class DiscoveryService:
                 if self.thread:
                     self.thread.join(timeout=1)
         
-        self.udp_broadcaster = UDPBroadcaster(primary_url, broadcast_port, broadcast_interval)
+        if not self.beacon_key:
+            logger.warning("UDP beacons are unsigned; devices with a token will ignore them")
+        self.udp_broadcaster = UDPBroadcaster(primary_url, self.beacon_key, broadcast_port, broadcast_interval)
         self.udp_broadcaster.start()
     
     def print_qr_code(self, url: str, enable: bool = False):
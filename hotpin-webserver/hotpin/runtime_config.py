@@ -0,0 +1,111 @@
+"""Server-pushed runtime configuration for HotPin clients.
+
+The server keeps one versioned set of client settings. Each change bumps the
+version and is pushed to connected clients as a config_update carrying only
+the keys that changed since the version the client reports; a client that
+was offline is brought up to date from its hello. Clients apply the update,
+save it and answer with config_ack.
+"""
+import json
+import os
+from typing import Any, Dict, Optional
+
+from .config import Config
+from .utils import create_logger
+
+logger = create_logger(__name__)
+
+LOG_LEVELS = ["none", "error", "warn", "info", "debug", "verbose"]
+
+# Key -> (min, max) for numbers, or the accepted values; matches the firmware
+# (runtime_config.c), which rejects the whole update on a bad value
+RUNTIME_SETTINGS: Dict[str, Any] = {
+    "chunk_ms": (0, 500),           # 0 lets the client adapt; else 20-500
+    "codec": ["pcm16"],
+    "jpeg_quality": (4, 63),
+    "wake_threshold": (50, 99),     # Wake word detection threshold, percent
+    "ns_max_db": (3, 30),           # Noise suppressor maximum attenuation
+    "ping_interval_sec": (5, 300),
+    "log_level": LOG_LEVELS,
+}
+
+def validate_settings(values: Dict[str, Any]) -> Optional[str]:
+    """Return an error message for the first bad setting, or None."""
+    for key, value in values.items():
+        spec = RUNTIME_SETTINGS.get(key)
+        if spec is None:
+            return f"Unknown setting: {key}"
+        if isinstance(spec, list):
+            if value not in spec:
+                return f"{key} must be one of {', '.join(spec)}"
+            continue
+        if isinstance(value, bool) or not isinstance(value, int) or not spec[0] <= value <= spec[1]:
+            return f"{key} must be an integer in {spec[0]}..{spec[1]}"
+        if key == "chunk_ms" and 0 < value < 20:
+            return "chunk_ms must be 0 or 20..500"
+    return None
+
+class RuntimeConfigStore:
+    """Versioned client settings, saved to a JSON file."""
+
+    def __init__(self, path: str):
+        self.path = path
+        self.version = 0
+        self.values: Dict[str, Any] = {}
+        self.changed_at: Dict[str, int] = {}  # Key -> version that last set it
+        self.load()
+
+    def load(self):
+        """Load the saved settings, if any."""
+        if not os.path.exists(self.path):
+            return
+        try:
+            with open(self.path, "r") as f:
+                data = json.load(f)
+            self.version = int(data.get("version", 0))
+            self.values = dict(data.get("values", {}))
+            self.changed_at = {k: int(v) for k, v in data.get("changed_at", {}).items()}
+            logger.info(f"Runtime configuration version {self.version} loaded from {self.path}")
+        except (OSError, ValueError) as e:
+            logger.error(f"Failed to load runtime configuration from {self.path}: {e}")
+
+    def save(self):
+        """Write the settings atomically."""
+        tmp_path = self.path + ".tmp"
+        with open(tmp_path, "w") as f:
+            json.dump({"version": self.version, "values": self.values, "changed_at": self.changed_at}, f, indent=2)
+        os.replace(tmp_path, self.path)
+
+    def update(self, values: Dict[str, Any]) -> int:
+        """Apply validated changes; returns the new version (unchanged if nothing changed)."""
+        changes = {k: v for k, v in values.items() if self.values.get(k) != v}
+        if not changes:
+            return self.version
+        self.version += 1
+        for key, value in changes.items():
+            self.values[key] = value
+            self.changed_at[key] = self.version
+        self.save()
+        logger.info(f"Runtime configuration version {self.version}: {changes}")
+        return self.version
+
+    def advance_to(self, version: int):
+        """Move past a version a client already holds (e.g. after the file was lost),
+        so the next update is not acknowledged as stale."""
+        if version > self.version:
+            logger.warning(f"Client holds runtime configuration version {version}, "
+                           f"ahead of this server's {self.version}")
+            self.version = version
+            self.save()
+
+    def delta_since(self, version: int) -> Dict[str, Any]:
+        """Settings changed after version, to bring a client holding it up to date."""
+        return {k: v for k, v in self.values.items() if self.changed_at.get(k, 0) > version}
+
+    def update_message(self, client_version: int) -> Optional[Dict[str, Any]]:
+        """config_update for a client at client_version, or None if it is current."""
+        if client_version >= self.version:
+            return None
+        return {"type": "config_update", "version": self.version, "set": self.delta_since(client_version)}
+
+runtime_config = RuntimeConfigStore(Config.RUNTIME_CONFIG_FILE)
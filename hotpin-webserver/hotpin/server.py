@@ -3,6 +3,8 @@ import asyncio
 import json
 import os
 import tempfile
+import time
+from dataclasses import asdict
 from datetime import datetime
 from typing import Optional, Dict, Any
 import uvicorn
@@ -13,7 +15,7 @@ from fastapi.responses import JSONResponse
 
 from .config import Config
 from .ws_manager import manager as ws_manager
-from .session_manager import session_manager, SessionState, Session
+from .session_manager import session_manager, SessionState, Session, SessionProfile, ClientCapabilities, negotiate_profile
 from .audio_ingestor import AudioIngestor
 from .stt_worker import stt_worker
 from .llm_client import llm_client
@@ -23,6 +25,8 @@ from .tts_streamer import tts_streamer
 from .storage_manager import storage_manager
 from .utils import create_logger, validate_audio_chunk
 from .discovery import DiscoveryService
+from .runtime_config import runtime_config, validate_settings
+from .ws_mux import MuxReceiver, MuxSender, AUDIO_HEADER_BYTES, parse_audio_message, AUDIO as MUX_AUDIO, IMAGE as MUX_IMAGE, TTS as MUX_TTS
 
 # Create logger for this module
 logger = create_logger(__name__)
@@ -72,7 +76,8 @@ async def startup_event():
         port=Config.WEBSOCKET_PORT,
         path=Config.WEBSOCKET_PATH,
         token=Config.WEBSOCKET_TOKEN if Config.WEBSOCKET_TOKEN != "mysecrettoken123" else None,
-        use_tls=Config.USE_TLS
+        use_tls=Config.USE_TLS,
+        beacon_key=Config.WS_TOKEN
     )
     
     discovery_service.start_advertising(
@@ -84,6 +89,9 @@ async def startup_event():
         qr_enable=Config.PRINT_QR
     )
     
+    if Config.UDP_AUDIO:
+        await audio_ingestor.start_udp_receiver(Config.UDP_AUDIO_PORT, ingest_udp_frame)
+    
     # Start cleanup tasks
     await session_manager.start_cleanup_task()
     await storage_manager.start_cleanup_task()
@@ -103,6 +111,8 @@ async def shutdown_event():
     if discovery_service:
         discovery_service.stop_advertising()
     
+    audio_ingestor.stop_udp_receiver()
+    
     # Close LLM client
     await llm_client.close()
     
@@ -135,6 +145,8 @@ async def websocket_endpoint(websocket: WebSocket):
         
         # Update session state
         session.update_state(SessionState.CONNECTED)
+        # Binary frames are unframed until this connection's client sends mux_ready
+        session.mux_receiver = None
         
         # Send ready message
         await ws_manager.send_personal_message({
@@ -144,17 +156,25 @@ async def websocket_endpoint(websocket: WebSocket):
         # Main message loop
         while True:
             try:
-                # Receive message from client
-                data = await websocket.receive_text()
-                message = json.loads(data)
+                # Receive message from client; binary frames outside an
+                # audio_chunk_meta exchange are multiplexed slices
+                received = await websocket.receive()
+                if received["type"] == "websocket.disconnect":
+                    raise WebSocketDisconnect(received.get("code", 1000))
+                if received.get("bytes") is not None:
+                    await handle_binary_frame(websocket, session, received["bytes"])
+                    continue
+                message = json.loads(received.get("text") or "")
                 
                 # Process the message based on type
                 await process_client_message(websocket, session, message)
                 
             except WebSocketDisconnect:
-                ws_manager.disconnect(websocket)
-                if session:
+                # A connection replaced by the client's reconnect no longer owns the session
+                if ws_manager.disconnect(websocket) and session:
                     session.update_state(SessionState.DISCONNECTED)
+                    if audio_ingestor.udp:
+                        audio_ingestor.udp.unregister(session.session_id)
                 break
             except json.JSONDecodeError:
                 logger.error("Invalid JSON received from client")
@@ -179,8 +199,7 @@ async def websocket_endpoint(websocket: WebSocket):
                 continue
                 
     except WebSocketDisconnect:
-        ws_manager.disconnect(websocket)
-        if session:
+        if ws_manager.disconnect(websocket) and session:
             session.update_state(SessionState.DISCONNECTED)
 
 async def process_client_message(websocket: WebSocket, session: Session, message: Dict[str, Any]):
@@ -204,6 +223,8 @@ async def process_client_message(websocket: WebSocket, session: Session, message
         await handle_client_on(websocket, session, message)
     elif msg_type == "recording_started":
         await handle_recording_started(websocket, session, message)
+    elif msg_type == "mux_ready":
+        await handle_mux_ready(websocket, session, message)
     elif msg_type == "audio_chunk_meta":
         # Process the audio chunk (binary frame should come next)
         await handle_audio_chunk_meta(websocket, session, message)
@@ -217,6 +238,16 @@ async def process_client_message(websocket: WebSocket, session: Session, message
         await handle_playback_complete(websocket, session, message)
     elif msg_type == "ping":
         await handle_ping(websocket, session, message)
+    elif msg_type == "tts_cancel":
+        await handle_tts_cancel(websocket, session, message)
+    elif msg_type == "replay_miss":
+        await handle_replay_miss(websocket, session, message)
+    elif msg_type == "telemetry":
+        await handle_telemetry(websocket, session, message)
+    elif msg_type == "selftest_report":
+        await handle_selftest_report(websocket, session, message)
+    elif msg_type == "config_ack":
+        await handle_config_ack(websocket, session, message)
     else:
         logger.warning(f"Unknown message type: {msg_type}")
         await ws_manager.send_personal_message({
@@ -225,19 +256,67 @@ async def process_client_message(websocket: WebSocket, session: Session, message
         }, websocket)
 
 async def handle_hello(websocket: WebSocket, session: Session, message: Dict[str, Any]):
-    """Handle hello message from client."""
-    # Update session with client capabilities
+    """Handle hello message from client: record its capabilities and answer
+    with the session parameters picked from them."""
     capabilities_data = message.get("capabilities", {})
     if capabilities_data:
-        from .session_manager import ClientCapabilities
-        session.client_capabilities = ClientCapabilities(
-            psram=capabilities_data.get("psram", False),
-            max_chunk_bytes=capabilities_data.get("max_chunk_bytes", Config.CHUNK_SIZE_BYTES)
+        session.client_capabilities = ClientCapabilities.from_hello(
+            capabilities_data, protocol=int(message.get("protocol", 1))
         )
     
     session.log_event("hello_received", message)
     logger.info(f"Session {session.session_id} capabilities: {capabilities_data}")
 
+    # Clients before the handshake send no protocol and expect no answer
+    if not session.client_capabilities or session.client_capabilities.protocol < 2:
+        return
+    profile = negotiate_profile(session.client_capabilities)
+    if profile is None:
+        logger.warning(f"Session {session.session_id}: no common codec/sample rate, keeping legacy profile")
+        return
+    if "udp_audio" in profile.features:
+        offer_udp_audio(websocket, session, profile)
+    session.negotiated_profile = profile
+    session.log_event("session_config", asdict(profile))
+    await ws_manager.send_personal_message({"type": "session_config", **asdict(profile)}, websocket)
+    # With "mux", both sides keep binary messages whole until the client
+    # has applied session_config and says so with mux_ready
+
+    # Bring the client's runtime configuration up to date (it may have been
+    # offline through one or more changes)
+    if "config_version" in message:
+        client_version = int(message["config_version"])
+        session.client_config = {"version": client_version, "status": "hello"}
+        runtime_config.advance_to(client_version)
+        update = runtime_config.update_message(client_version)
+        if update:
+            session.log_event("config_update", update)
+            await ws_manager.send_personal_message(update, websocket)
+
+def offer_udp_audio(websocket: WebSocket, session: Session, profile: SessionProfile):
+    """Open a UDP audio stream for the session and describe it in the
+    profile; without the receiver or the server's address the feature is
+    dropped and audio stays on the WebSocket."""
+    server = websocket.scope.get("server")
+    if not audio_ingestor.udp or not server or not websocket.client:
+        profile.features.remove("udp_audio")
+        return
+    ssrc = audio_ingestor.udp.register(session, websocket.client.host)
+    profile.udp_audio = {
+        "host": server[0],
+        "port": Config.UDP_AUDIO_PORT,
+        "ssrc": ssrc,
+        "fec_group": Config.UDP_AUDIO_FEC_GROUP,
+        "frame_ms": 20
+    }
+
+def ingest_udp_frame(session: Session, seq: int, payload: bytes):
+    """Take one frame from the UDP jitter buffer, in order."""
+    if not audio_ingestor.append_chunk(session, seq, payload):
+        return
+    if stt_worker.available:
+        stt_worker.accept_audio_chunk(session.session_id, payload)
+
 async def handle_client_on(websocket: WebSocket, session: Session, message: Dict[str, Any]):
     """Handle client_on message."""
     session.update_state(SessionState.IDLE)
@@ -249,9 +328,11 @@ async def handle_recording_started(websocket: WebSocket, session: Session, messa
     
     # Start audio ingestion session
     await audio_ingestor.start_recording_session(session)
+    if audio_ingestor.udp:
+        audio_ingestor.udp.start(session)
     
     # Start STT recognition session
-    stt_worker.start_recognition_session(session.session_id)
+    stt_worker.start_recognition_session(session.session_id, session.sample_rate)
     
     # Set STT callbacks
     def partial_callback(sid, text, is_partial):
@@ -266,10 +347,24 @@ async def handle_recording_started(websocket: WebSocket, session: Session, messa
     session.log_event("recording_started", message)
     logger.info(f"Recording started for session {session.session_id}")
 
+async def handle_mux_ready(websocket: WebSocket, session: Session, message: Dict[str, Any]):
+    """The client slices binary messages from here on; so does the server."""
+    profile = session.negotiated_profile
+    if not profile or "mux" not in profile.features:
+        logger.warning(f"Session {session.session_id}: mux_ready without an agreed mux, ignoring")
+        return
+    if session.mux_receiver:
+        return
+    session.mux_receiver = MuxReceiver(max(Config.MAX_IMAGE_SIZE_BYTES, profile.uplink_frame_bytes + AUDIO_HEADER_BYTES))
+    ws_manager.attach_mux(websocket, MuxSender(websocket, Config.WS_MUX_SLICE_BYTES))
+    session.log_event("mux_ready", {"slice_bytes": Config.WS_MUX_SLICE_BYTES})
+    logger.info(f"Session {session.session_id}: channel multiplexing on")
+
 async def handle_audio_chunk_meta(websocket: WebSocket, session: Session, message: Dict[str, Any]):
     """Handle audio chunk metadata message."""
     seq = message.get("seq")
-    len_bytes = message.get("len_bytes")
+    # Frames vary in length; older firmware names the field "len"
+    len_bytes = message.get("len_bytes", message.get("len"))
     
     if seq is None or len_bytes is None:
         await ws_manager.send_personal_message({
@@ -278,48 +373,18 @@ async def handle_audio_chunk_meta(websocket: WebSocket, session: Session, messag
         }, websocket)
         return
     
+    # Spilled to flash while the uplink was down, sent once it recovered
+    replay = bool(message.get("replay", False))
+    
+    # Multiplexed audio messages carry their own seq; a meta here is stray
+    if session.mux_receiver:
+        logger.warning(f"Session {session.session_id}: audio_chunk_meta {seq} while multiplexing, ignoring")
+        return
+    
     # Receive the binary audio chunk
     try:
         audio_chunk = await websocket.receive_bytes()
-        
-        # Validate the chunk size matches the metadata
-        if len(audio_chunk) != len_bytes:
-            logger.warning(f"Chunk size mismatch for session {session.session_id}: expected {len_bytes}, got {len(audio_chunk)}")
-            await ws_manager.send_personal_message({
-                "type": "error",
-                "message": f"Chunk size mismatch: expected {len_bytes}, got {len(audio_chunk)}"
-            }, websocket)
-            return
-        
-        # Validate the chunk format
-        if not validate_audio_chunk(audio_chunk):
-            logger.warning(f"Invalid audio chunk received for session {session.session_id}")
-            await ws_manager.send_personal_message({
-                "type": "error",
-                "message": "Invalid audio chunk format"
-            }, websocket)
-            return
-        
-        # Ingest the chunk
-        success = await audio_ingestor.ingest_chunk(session, seq, audio_chunk)
-        if not success:
-            logger.error(f"Failed to ingest audio chunk for session {session.session_id}")
-            # The audio_ingestor already logs the specific error
-            return
-        
-        # Process with STT (if STT is available)
-        if stt_worker.available:
-            stt_worker.accept_audio_chunk(session.session_id, audio_chunk)
-        else:
-            logger.warning(f"STT not available, skipping STT processing for session {session.session_id}")
-        
-        # Send acknowledgment every N chunks
-        if session.audio_buffer.chunks_received % 4 == 0:  # Ack every 4 chunks
-            await ws_manager.send_personal_message({
-                "type": "ack",
-                "ref": "chunk",
-                "seq": seq
-            }, websocket)
+        await accept_audio_chunk(websocket, session, seq, len_bytes, audio_chunk, replay)
         
     except WebSocketDisconnect:
         logger.info(f"Client disconnected while receiving audio chunk for session {session.session_id}")
@@ -336,10 +401,88 @@ async def handle_audio_chunk_meta(websocket: WebSocket, session: Session, messag
         except:
             pass  # Client might be disconnected
 
+async def accept_audio_chunk(websocket: WebSocket, session: Session, seq: int, len_bytes: int, audio_chunk: bytes,
+                             replay: bool = False):
+    """Validate, store and transcribe one uplink audio frame."""
+    # The client holds recording_stopped until its spill has drained, and
+    # reconnects under the same session while a recording is open, so a
+    # replayed chunk with no recording open is left over from one that was
+    # abandoned; it must not leak into the next
+    if replay:
+        if not session.audio_buffer.open:
+            logger.info(f"Session {session.session_id}: replayed chunk {seq} has no open recording, dropping")
+            session.log_event("replay_dropped", {"seq": seq})
+            return
+        session.audio_buffer.replayed_chunks += 1
+    
+    # Validate the chunk size matches the metadata
+    if len(audio_chunk) != len_bytes:
+        logger.warning(f"Chunk size mismatch for session {session.session_id}: expected {len_bytes}, got {len(audio_chunk)}")
+        await ws_manager.send_personal_message({
+            "type": "error",
+            "message": f"Chunk size mismatch: expected {len_bytes}, got {len(audio_chunk)}"
+        }, websocket)
+        return
+    
+    # Validate the chunk format
+    if not validate_audio_chunk(audio_chunk):
+        logger.warning(f"Invalid audio chunk received for session {session.session_id}")
+        await ws_manager.send_personal_message({
+            "type": "error",
+            "message": "Invalid audio chunk format"
+        }, websocket)
+        return
+    
+    # Ingest the chunk
+    success = await audio_ingestor.ingest_chunk(session, seq, audio_chunk)
+    if not success:
+        logger.error(f"Failed to ingest audio chunk for session {session.session_id}")
+        # The audio_ingestor already logs the specific error
+        return
+    
+    # Process with STT (if STT is available)
+    if stt_worker.available:
+        stt_worker.accept_audio_chunk(session.session_id, audio_chunk)
+    else:
+        logger.warning(f"STT not available, skipping STT processing for session {session.session_id}")
+    
+    # Send acknowledgment every N chunks
+    if session.audio_buffer.chunks_received % 4 == 0:  # Ack every 4 chunks
+        await ws_manager.send_personal_message({
+            "type": "ack",
+            "ref": "chunk",
+            "seq": seq
+        }, websocket)
+
+async def handle_binary_frame(websocket: WebSocket, session: Session, frame: bytes):
+    """Join a multiplexed slice; act on the message it completes."""
+    if not session.mux_receiver:
+        logger.warning(f"Session {session.session_id}: binary frame without audio_chunk_meta, ignoring")
+        return
+    completed = session.mux_receiver.feed(frame)
+    if completed is None:
+        return
+    channel, payload = completed
+    if channel == MUX_AUDIO:
+        parsed = parse_audio_message(payload)
+        if parsed is None:
+            logger.warning(f"Session {session.session_id}: audio message without its header, ignoring")
+            return
+        seq, replay, pcm = parsed
+        await accept_audio_chunk(websocket, session, seq, len(pcm), pcm, replay)
+    elif channel == MUX_IMAGE:
+        await store_image(session, payload)
+    else:
+        logger.warning(f"Session {session.session_id}: nothing handles channel {channel}, dropping")
+
 async def handle_recording_stopped(websocket: WebSocket, session: Session, message: Dict[str, Any]):
     """Handle recording stopped message."""
     session.update_state(SessionState.PROCESSING)
     
+    # Audio that came over UDP: wait for the last frame the client sent
+    if audio_ingestor.udp:
+        session.audio_buffer.udp_stats = await audio_ingestor.udp.stop(session, message.get("udp_last_seq"))
+    
     # Finalize audio ingestion
     audio_file_path = await audio_ingestor.finalize_recording(session)
     if not audio_file_path:
@@ -418,6 +561,7 @@ async def handle_recording_stopped(websocket: WebSocket, session: Session, messa
     if tts_file_path:
         session.tts_file_path = tts_file_path
         session.tts_ready = True
+        session.tts_turn_id += 1
         
         # Wait for client to be ready for playback or timeout
         # In a real implementation, you'd track this state more carefully
@@ -451,30 +595,16 @@ async def handle_image_captured(websocket: WebSocket, session: Session, message:
 async def handle_ready_for_playback(websocket: WebSocket, session: Session, message: Dict[str, Any]):
     """Handle client ready for playback."""
     if session.tts_file_path and session.tts_ready:
-        # Stream the TTS to the client
-        async def send_callback(msg, binary=False):
-            if binary:
-                await websocket.send_bytes(msg)
-            else:
-                await ws_manager.send_personal_message(msg, websocket)
+        if session.tts_stream_task and not session.tts_stream_task.done():
+            logger.debug(f"TTS already streaming for session {session.session_id}")
+            return
         
-        success = await tts_streamer.stream_tts_to_client(
-            session.tts_file_path,
-            send_callback,
-            session.session_id
+        # Stream in the background so the message loop can still receive
+        # tts_cancel (barge-in) while the file is going out
+        session.tts_cancel_event = asyncio.Event()
+        session.tts_stream_task = asyncio.create_task(
+            stream_tts(websocket, session, session.tts_cancel_event)
         )
-        
-        if success:
-            session.update_state(SessionState.PLAYING)
-        else:
-            logger.error(f"TTS streaming failed for session {session.session_id}")
-            # Offer download as fallback
-            download_url = await tts_streamer.create_download_url(session.tts_file_path)
-            if download_url:
-                await ws_manager.send_personal_message({
-                    "type": "offer_download",
-                    "url": download_url
-                }, websocket)
     else:
         logger.warning(f"No TTS ready for session {session.session_id}")
         await ws_manager.send_personal_message({
@@ -482,6 +612,52 @@ async def handle_ready_for_playback(websocket: WebSocket, session: Session, mess
             "message": "No TTS audio ready"
         }, websocket)
 
+async def stream_tts(websocket: WebSocket, session: Session, cancel_event: asyncio.Event):
+    """Stream the session's TTS file to the client, unless cancelled."""
+    async def send_callback(msg, binary=False):
+        sender = ws_manager.get_mux(websocket)
+        if binary and sender:
+            await sender.send_bytes(MUX_TTS, msg)
+        elif binary:
+            await websocket.send_bytes(msg)
+        else:
+            # tts_done must not overtake the audio it ends
+            after = MUX_TTS if msg.get("type") == "tts_done" else None
+            await ws_manager.send_personal_message(msg, websocket, after)
+    
+    session.update_state(SessionState.PLAYING)
+    profile = session.negotiated_profile
+    success = await tts_streamer.stream_tts_to_client(
+        session.tts_file_path,
+        send_callback,
+        session.session_id,
+        session.tts_turn_id,
+        cancel_event,
+        chunk_size=profile.downlink_frame_bytes if profile else None,
+        sample_rate=profile.sample_rate if profile else None
+    )
+    
+    if cancel_event.is_set():
+        return  # Barge-in; the client is already recording
+    if not success:
+        logger.error(f"TTS streaming failed for session {session.session_id}")
+        # Offer download as fallback
+        download_url = await tts_streamer.create_download_url(session.tts_file_path)
+        if download_url:
+            await ws_manager.send_personal_message({
+                "type": "offer_download",
+                "url": download_url
+            }, websocket)
+
+async def handle_tts_cancel(websocket: WebSocket, session: Session, message: Dict[str, Any]):
+    """Handle barge-in: stop the TTS stream mid-file."""
+    if session.tts_cancel_event:
+        session.tts_cancel_event.set()
+    streaming = session.tts_stream_task is not None and not session.tts_stream_task.done()
+    logger.info(f"Session {session.session_id}: TTS cancelled by client "
+                f"({'stream stopped' if streaming else 'no stream active'})")
+    session.log_event("tts_cancel", {"streaming": streaming})
+
 async def handle_playback_complete(websocket: WebSocket, session: Session, message: Dict[str, Any]):
     """Handle playback complete message."""
     session.update_state(SessionState.IDLE)
@@ -492,11 +668,63 @@ async def handle_playback_complete(websocket: WebSocket, session: Session, messa
     
     session.log_event("playback_complete", message)
 
+async def handle_replay_miss(websocket: WebSocket, session: Session, message: Dict[str, Any]):
+    """Handle a replay the client could not serve from its TTS cache."""
+    logger.info(f"Session {session.session_id}: replay of turn {message.get('turn')} missed the client cache")
+    session.log_event("replay_miss", message)
+
 async def handle_ping(websocket: WebSocket, session: Session, message: Dict[str, Any]):
     """Handle ping message."""
-    await ws_manager.send_personal_message({
-        "type": "pong"
-    }, websocket)
+    reply = {"type": "pong"}
+    if "t" in message:
+        # Echo the client's timestamp so it can time the round trip
+        reply["t"] = message["t"]
+    await ws_manager.send_personal_message(reply, websocket)
+
+async def handle_telemetry(websocket: WebSocket, session: Session, message: Dict[str, Any]):
+    """Handle periodic telemetry report from the client."""
+    session.client_telemetry = {k: v for k, v in message.items() if k not in ("type", "session")}
+    session.client_telemetry["received_at"] = time.time()
+    
+    audio = message.get("audio", {})
+    cpu = message.get("cpu", {})
+    logger.debug(
+        f"Telemetry from {session.session_id} ({message.get('profile', 'unknown')} profile): "
+        f"core load {cpu.get('core_load_pct')}, "
+        f"capture jitter max {audio.get('capture_jitter_max_us')} us, "
+        f"playback underruns {audio.get('playback_underruns')}"
+    )
+
+async def handle_config_ack(websocket: WebSocket, session: Session, message: Dict[str, Any]):
+    """Handle the client's answer to a config_update."""
+    session.client_config = {
+        "version": int(message.get("version", 0)),
+        "status": message.get("status", "unknown"),
+        "error": message.get("error"),
+        "ignored": message.get("ignored", []),
+        "received_at": time.time(),
+    }
+    session.log_event("config_ack", session.client_config)
+    if session.client_config["status"] == "rejected":
+        logger.warning(f"Session {session.session_id} rejected runtime configuration "
+                       f"(bad {session.client_config['error']}), holds version {session.client_config['version']}")
+    else:
+        logger.info(f"Session {session.session_id} runtime configuration version "
+                    f"{session.client_config['version']}: {session.client_config['status']}")
+
+async def handle_selftest_report(websocket: WebSocket, session: Session, message: Dict[str, Any]):
+    """Handle the result of an audio pipeline self-test run by the client."""
+    session.client_selftest = {k: v for k, v in message.items() if k not in ("type", "session")}
+    session.client_selftest["received_at"] = time.time()
+    session.log_event("selftest_report", session.client_selftest)
+    
+    i2s = message.get("i2s", {})
+    logger.info(
+        f"Self-test ({message.get('mode')}) from {session.session_id}: "
+        f"{'passed' if message.get('passed') else 'FAILED'}, "
+        f"rx {i2s.get('rx_rate_hz')} Hz, tx {i2s.get('tx_rate_hz')} Hz, "
+        f"overruns {i2s.get('rx_overruns')}, underruns {i2s.get('tx_underruns')}"
+    )
 
 async def send_partial_transcript(session_id: str, text: str):
     """Send a partial transcript to the client."""
@@ -543,8 +771,21 @@ async def upload_image(
     # Read the image file
     image_data = await file.read()
     
+    result = await store_image(session_obj, image_data)
+    if result["success"]:
+        return JSONResponse(content={
+            "type": "image_received",
+            "filename": result["filename"],
+            "path": result["path"]
+        })
+    else:
+        raise HTTPException(status_code=400, detail=result["error"])
+
+async def store_image(session_obj: Session, image_data: bytes) -> Dict[str, Any]:
+    """Keep an uploaded image (HTTP POST or the mux image channel) as the
+    session's current image and confirm it to the client."""
     # Handle the image upload
-    result = await image_handler.handle_image_upload(session, image_data)
+    result = await image_handler.handle_image_upload(session_obj.session_id, image_data)
     
     if result["success"]:
         # Update session with image info
@@ -557,7 +798,7 @@ async def upload_image(
         }
         
         # Send confirmation to client
-        websocket = ws_manager.active_connections.get(session)
+        websocket = ws_manager.active_connections.get(session_obj.session_id)
         if websocket:
             await ws_manager.send_personal_message({
                 "type": "image_received",
@@ -565,15 +806,84 @@ async def upload_image(
             }, websocket)
         
         session_obj.log_event("image_uploaded", result)
-        
-        return JSONResponse(content={
-            "type": "image_received",
-            "filename": result["filename"],
-            "path": result["path"]
-        })
     else:
         session_obj.log_event("image_upload_failed", {"error": result["error"]})
-        raise HTTPException(status_code=400, detail=result["error"])
+    return result
+
+@app.post("/replay")
+async def replay_response(
+    session: str = Query(..., description="Session ID"),
+    turn: Optional[int] = Query(None, description="Turn ID to replay (default: latest)")
+):
+    """Ask the client to replay a TTS response from its local cache."""
+    session_obj = session_manager.get_session(session)
+    websocket = ws_manager.active_connections.get(session)
+    if not session_obj or not websocket:
+        raise HTTPException(status_code=404, detail="Session not connected")
+    
+    command = {"type": "replay"}
+    if turn is not None:
+        command["turn"] = turn
+    await ws_manager.send_personal_message(command, websocket)
+    session_obj.log_event("replay_requested", command)
+    return {"ok": True, "turn": turn if turn is not None else session_obj.tts_turn_id}
+
+@app.post("/selftest")
+async def request_selftest(
+    session: str = Query(..., description="Session ID"),
+    mode: str = Query("loopback", description="capture, loopback or playback"),
+    duration_ms: int = Query(5000, ge=500, le=30000, description="Run time in milliseconds")
+):
+    """Ask the client to run an audio pipeline self-test; the report lands in /state."""
+    if mode not in ("capture", "loopback", "playback"):
+        raise HTTPException(status_code=400, detail=f"Unknown self-test mode: {mode}")
+    session_obj = session_manager.get_session(session)
+    websocket = ws_manager.active_connections.get(session)
+    if not session_obj or not websocket:
+        raise HTTPException(status_code=404, detail="Session not connected")
+    profile = session_obj.negotiated_profile
+    if profile and "selftest" not in profile.features:
+        raise HTTPException(status_code=409, detail="Self-test is disabled for this session")
+    
+    command = {"type": "selftest", "mode": mode, "duration_ms": duration_ms}
+    await ws_manager.send_personal_message(command, websocket)
+    session_obj.log_event("selftest_requested", command)
+    return {"ok": True, "mode": mode, "duration_ms": duration_ms}
+
+@app.get("/config/runtime")
+async def get_runtime_config():
+    """Current runtime configuration and the version each connected client holds."""
+    clients = {}
+    for session_id in ws_manager.active_connections:
+        session_obj = session_manager.get_session(session_id)
+        clients[session_id] = session_obj.client_config if session_obj else None
+    return {"version": runtime_config.version, "values": runtime_config.values, "clients": clients}
+
+@app.post("/config/runtime")
+async def set_runtime_config(settings: Dict[str, Any]):
+    """Change client settings and push them to every connected client."""
+    error = validate_settings(settings)
+    if error:
+        raise HTTPException(status_code=400, detail=error)
+    
+    previous = runtime_config.version
+    version = runtime_config.update(settings)
+    if version == previous:
+        return {"ok": True, "version": version, "pushed": []}
+    
+    pushed = []
+    for session_id, websocket in list(ws_manager.active_connections.items()):
+        session_obj = session_manager.get_session(session_id)
+        # Only clients that reported a config_version in their hello take updates
+        if not session_obj or not session_obj.client_config:
+            continue
+        update = runtime_config.update_message(session_obj.client_config["version"])
+        if not update:
+            continue
+        await ws_manager.send_personal_message(update, websocket)
+        session_obj.log_event("config_update", update)
+        pushed.append(session_id)
+    return {"ok": True, "version": version, "pushed": pushed}
 
 @app.get("/health")
 async def health_check():
@@ -582,6 +892,7 @@ async def health_check():
     active_sessions = session_manager.get_session_stats()
     
     return {
+        "service": "hotpin",  # Signature the firmware's discovery probe looks for; keep it first
         "ok": True,
         "timestamp": datetime.utcnow().isoformat(),
         "models": ["groq-whisper", "groq-llm"],
@@ -602,8 +913,16 @@ async def get_session_state(session: str = Query(..., description="Session ID"))
         "state": session_obj.state.value,
         "client_capabilities": {
             "psram": session_obj.client_capabilities.psram if session_obj.client_capabilities else None,
-            "max_chunk_bytes": session_obj.client_capabilities.max_chunk_bytes if session_obj.client_capabilities else None
+            "max_chunk_bytes": session_obj.client_capabilities.max_chunk_bytes if session_obj.client_capabilities else None,
+            "protocol": session_obj.client_capabilities.protocol,
+            "psram_bytes": session_obj.client_capabilities.psram_bytes,
+            "codecs": session_obj.client_capabilities.codecs,
+            "sample_rates": session_obj.client_capabilities.sample_rates,
+            "min_frame_bytes": session_obj.client_capabilities.min_frame_bytes,
+            "max_frame_bytes": session_obj.client_capabilities.max_frame_bytes,
+            "features": session_obj.client_capabilities.features
         } if session_obj.client_capabilities else None,
+        "negotiated_profile": asdict(session_obj.negotiated_profile) if session_obj.negotiated_profile else None,
         "audio_buffer": {
             "chunks_received": session_obj.audio_buffer.chunks_received,
             "total_bytes": session_obj.audio_buffer.total_bytes,
@@ -613,7 +932,11 @@ async def get_session_state(session: str = Query(..., description="Session ID"))
         "disk_usage_bytes": session_obj.disk_usage_bytes,
         "conversation_history_count": len(session_obj.conversation_history),
         "current_image_path": session_obj.current_image_path,
-        "tts_ready": session_obj.tts_ready
+        "tts_ready": session_obj.tts_ready,
+        "tts_turn_id": session_obj.tts_turn_id,
+        "client_telemetry": session_obj.client_telemetry,
+        "client_selftest": session_obj.client_selftest,
+        "client_config": session_obj.client_config
     }
 
 def run_server():
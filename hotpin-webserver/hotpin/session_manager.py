@@ -6,9 +6,10 @@ import os
 from datetime import datetime
 from enum import Enum
 from typing import Dict, List, Optional, Any
-from dataclasses import dataclass, asdict
+from dataclasses import dataclass, asdict, field
 from .config import Config
 from .utils import create_logger, generate_session_id, create_temp_file
+from .ws_mux import MuxReceiver
 
 logger = create_logger(__name__)
 
@@ -23,10 +24,82 @@ class SessionState(str, Enum):
     STALLED = "stalled"
     SHUTDOWN = "shutdown"
 
+PROTOCOL_VERSION = 2  # Handshake with hello/session_config; 1 is client_on only
+SUPPORTED_CODECS = ["pcm16"]
+SUPPORTED_SAMPLE_RATES = [16000]
+
 @dataclass
 class ClientCapabilities:
     psram: bool = False
     max_chunk_bytes: int = Config.CHUNK_SIZE_BYTES
+    protocol: int = 1
+    psram_bytes: int = 0
+    codecs: List[str] = field(default_factory=lambda: list(SUPPORTED_CODECS))
+    sample_rates: List[int] = field(default_factory=lambda: list(SUPPORTED_SAMPLE_RATES))
+    min_frame_bytes: int = 0
+    max_frame_bytes: int = Config.CHUNK_SIZE_BYTES
+    features: List[str] = field(default_factory=list)
+
+    @classmethod
+    def from_hello(cls, data: Dict[str, Any], protocol: int = 1) -> "ClientCapabilities":
+        """Build from the "capabilities" object of a hello message."""
+        max_chunk = int(data.get("max_chunk_bytes", Config.CHUNK_SIZE_BYTES))
+        return cls(
+            psram=bool(data.get("psram", False)),
+            max_chunk_bytes=max_chunk,
+            protocol=protocol,
+            psram_bytes=int(data.get("psram_bytes", 0)),
+            codecs=list(data.get("codecs", SUPPORTED_CODECS)),
+            sample_rates=[int(r) for r in data.get("sample_rates", SUPPORTED_SAMPLE_RATES)],
+            min_frame_bytes=int(data.get("min_frame_bytes", 0)),
+            max_frame_bytes=int(data.get("max_frame_bytes", max_chunk)),
+            features=list(data.get("features", [])),
+        )
+
+@dataclass
+class SessionProfile:
+    """Parameters the server picked for a session, sent as session_config."""
+    protocol: int = 1
+    codec: str = "pcm16"
+    sample_rate: int = 16000
+    uplink_frame_bytes: int = Config.CHUNK_SIZE_BYTES
+    uplink_min_frame_bytes: int = Config.CHUNK_SIZE_BYTES
+    downlink_frame_bytes: int = Config.CHUNK_SIZE_BYTES
+    features: List[str] = field(default_factory=list)
+    udp_audio: Dict[str, Any] = field(default_factory=dict)  # Set by the server when udp_audio is agreed
+
+def negotiate_profile(caps: ClientCapabilities) -> Optional[SessionProfile]:
+    """Pick session parameters both sides support.
+
+    Uplink frames are at most CHUNK_SIZE_BYTES. The client may pick each
+    frame's length between uplink_min_frame_bytes and that, but never so
+    short that it would send more than MAX_CHUNKS_PER_SEC. Returns None if
+    there is no common codec or sample rate.
+    """
+    codec = next((c for c in SUPPORTED_CODECS if c in caps.codecs), None)
+    sample_rate = next((r for r in SUPPORTED_SAMPLE_RATES if r in caps.sample_rates), None)
+    if codec is None or sample_rate is None:
+        return None
+
+    def even(n: int) -> int:
+        return n - n % 2
+
+    rate_floor = even(-(-sample_rate * 2 // max(Config.MAX_CHUNKS_PER_SEC, 1)))
+    max_frame = even(caps.max_frame_bytes)
+    uplink = min(max(Config.CHUNK_SIZE_BYTES, caps.min_frame_bytes, rate_floor), max_frame)
+    uplink_min = min(max(caps.min_frame_bytes, rate_floor), uplink)
+    downlink = min(Config.CHUNK_SIZE_BYTES, max_frame)
+
+    return SessionProfile(
+        protocol=min(caps.protocol, PROTOCOL_VERSION),
+        codec=codec,
+        sample_rate=sample_rate,
+        uplink_frame_bytes=even(uplink),
+        uplink_min_frame_bytes=even(uplink_min),
+        downlink_frame_bytes=even(downlink),
+        features=[f for f in caps.features if f not in Config.SESSION_DISABLED_FEATURES
+                  and (f != "udp_audio" or Config.UDP_AUDIO) and (f != "mux" or Config.WS_MUX)],
+    )
 
 @dataclass
 class AudioBuffer:
@@ -35,6 +108,12 @@ class AudioBuffer:
     total_bytes: int = 0
     sequence_numbers: List[int] = None
     temp_file_path: str = ""
+    open: bool = False  # Between recording_started and finalizing; survives a disconnect
+    min_chunk_bytes: int = 0  # Frames vary in length when the client adapts them
+    max_chunk_bytes: int = 0
+    last_chunk_at: float = 0.0
+    replayed_chunks: int = 0  # Chunks the client spilled to flash and sent late
+    udp_stats: Optional[Dict[str, int]] = None  # Jitter buffer counters when the audio came over UDP
     
     def __post_init__(self):
         if self.sequence_numbers is None:
@@ -79,7 +158,33 @@ class Session:
         self.tts_file_path: Optional[str] = None
         self.tts_duration_ms: Optional[int] = None
         self.tts_ready = False
+        self.tts_turn_id = 0  # Increments per response; the client caches TTS audio by turn
+        self.tts_stream_task: Optional[asyncio.Task] = None
+        self.tts_cancel_event: Optional[asyncio.Event] = None
+        
+        # Latest firmware telemetry report (CPU load, audio timing)
+        self.client_telemetry: Optional[Dict[str, Any]] = None
+
+        # Last audio pipeline self-test report from the client
+        self.client_selftest: Optional[Dict[str, Any]] = None
+
+        # Parameters agreed in the hello/session_config handshake; the legacy
+        # profile (16 kHz PCM16 in CHUNK_SIZE_BYTES frames) until then
+        self.negotiated_profile: Optional[SessionProfile] = None
+
+        # With the "mux" feature (ws_mux.py), once the client sends
+        # mux_ready: joins binary slices
+        self.mux_receiver: Optional[MuxReceiver] = None
+
+        # Runtime configuration the client holds: version from its hello,
+        # then from each config_ack
+        self.client_config: Optional[Dict[str, Any]] = None
         
+    @property
+    def sample_rate(self) -> int:
+        """Sample rate of the session's audio in both directions."""
+        return self.negotiated_profile.sample_rate if self.negotiated_profile else 16000
+
     def log_event(self, event_type: str, data: Dict[str, Any] = None):
         """Log an event to the session's event log."""
         event = {
@@ -184,6 +289,7 @@ class Session:
         
         # Reset file paths
         self.audio_buffer.temp_file_path = ""
+        self.audio_buffer.open = False
         self.current_image_path = None
         self.tts_file_path = None
         self.disk_usage_bytes = 0
@@ -223,6 +329,10 @@ class SessionManager:
         """Get all active sessions."""
         return self.sessions.copy()
     
+    def open_recording_paths(self) -> List[str]:
+        """Temp files of recordings still being written (not to be cleaned up)."""
+        return [s.audio_buffer.temp_file_path for s in self.sessions.values() if s.audio_buffer.open]
+    
     def cleanup_expired_sessions(self):
         """Clean up expired sessions based on idle timeout."""
         current_time = time.time()
@@ -230,7 +340,12 @@ class SessionManager:
         
         expired_sessions = []
         for session_id, session in self.sessions.items():
-            if current_time - session.last_activity > idle_grace_period:
+            grace = idle_grace_period
+            # A recording cut off by a disconnect waits for the client to
+            # reconnect under the same session and finish it
+            if session.audio_buffer.open and session.state == SessionState.DISCONNECTED:
+                grace = max(grace, Config.SESSION_RESUME_SEC)
+            if current_time - session.last_activity > grace:
                 expired_sessions.append(session_id)
         
         for session_id in expired_sessions:
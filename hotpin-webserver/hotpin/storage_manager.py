@@ -4,6 +4,7 @@ import os
 from typing import Dict, List, Optional
 from .config import Config
 from .utils import create_logger, cleanup_old_files
+from .session_manager import session_manager
 
 logger = create_logger(__name__)
 
@@ -29,8 +30,10 @@ class StorageManager:
         async def cleanup_loop():
             while True:
                 try:
-                    # Clean up old files based on grace period
-                    cleaned_count = cleanup_old_files(self.temp_dir, Config.SESSION_GRACE_SEC)
+                    # Clean up old files based on grace period; a recording
+                    # left open by a disconnect is kept for the client to finish
+                    cleaned_count = cleanup_old_files(self.temp_dir, Config.SESSION_GRACE_SEC,
+                                                      keep=session_manager.open_recording_paths())
                     if cleaned_count > 0:
                         self.logger.info(f"Cleaned up {cleaned_count} old files")
                     
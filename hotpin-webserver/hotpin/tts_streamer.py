@@ -18,9 +18,21 @@ class TTSStreamer:
         self, 
         tts_file_path: str, 
         send_chunk_callback: Callable,
-        session_id: str
+        session_id: str,
+        turn_id: Optional[int] = None,
+        cancel_event: Optional[asyncio.Event] = None,
+        chunk_size: Optional[int] = None,
+        sample_rate: Optional[int] = None
     ) -> bool:
-        """Stream TTS audio file to client in chunks."""
+        """Stream TTS audio file to client in chunks.
+
+        turn_id, if given, is echoed in tts_ready/tts_done so the client can
+        keep the response in its replay cache. Setting cancel_event (client
+        barge-in) stops the stream before the next chunk; no tts_done is sent.
+        chunk_size and sample_rate come from the session's negotiated profile;
+        without one the defaults apply.
+        """
+        chunk_size = chunk_size or self.chunk_size
         if not os.path.exists(tts_file_path):
             self.logger.error(f"TTS file does not exist: {tts_file_path}")
             return False
@@ -31,13 +43,16 @@ class TTSStreamer:
             self.logger.info(f"Streaming TTS file {tts_file_path} ({file_size} bytes) to session {session_id}")
             
             # Send tts_ready message
-            await send_chunk_callback({
+            ready = {
                 "type": "tts_ready",
                 "duration_ms": int(self._get_audio_duration(tts_file_path) * 1000),
-                "sampleRate": 16000,
+                "sampleRate": sample_rate or 16000,
                 "format": "wav",
                 "fileSize": file_size
-            })
+            }
+            if turn_id is not None:
+                ready["turn"] = turn_id
+            await send_chunk_callback(ready)
             
             # Stream the file in chunks
             seq = 0
@@ -45,7 +60,12 @@ class TTSStreamer:
             
             with open(tts_file_path, 'rb') as f:
                 while True:
-                    chunk_data = f.read(self.chunk_size)
+                    if cancel_event is not None and cancel_event.is_set():
+                        self.logger.info(f"TTS stream for session {session_id} cancelled after "
+                                         f"{bytes_sent} of {file_size} bytes")
+                        return False
+                    
+                    chunk_data = f.read(chunk_size)
                     if not chunk_data:
                         break  # End of file
                     
@@ -71,9 +91,10 @@ class TTSStreamer:
                     await asyncio.sleep(0.01)  # 10ms delay between chunks
             
             # Send completion message
-            await send_chunk_callback({
-                "type": "tts_done"
-            })
+            done = {"type": "tts_done"}
+            if turn_id is not None:
+                done["turn"] = turn_id
+            await send_chunk_callback(done)
             
             self.logger.info(f"Completed TTS streaming for session {session_id}, {bytes_sent} bytes sent")
             return True
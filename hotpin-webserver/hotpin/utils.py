@@ -7,7 +7,7 @@ import tempfile
 import time
 import uuid
 from datetime import datetime, timedelta
-from typing import Optional, Dict, Any
+from typing import Optional, Dict, Any, Iterable
 from hashlib import sha256
 import wave
 import io
@@ -126,14 +126,17 @@ def is_token_expired(timestamp: float, expiry_seconds: int) -> bool:
     """Check if a token has expired."""
     return time.time() - timestamp > expiry_seconds
 
-def cleanup_old_files(temp_dir: str, grace_period: int) -> int:
-    """Clean up files older than grace period. Return number of files cleaned up."""
+def cleanup_old_files(temp_dir: str, grace_period: int, keep: Iterable[str] = ()) -> int:
+    """Clean up files older than grace period, except those in keep. Return number of files cleaned up."""
     count = 0
     now = time.time()
     grace_seconds = grace_period
+    keep_paths = {os.path.abspath(path) for path in keep}
     
     for filename in os.listdir(temp_dir):
         file_path = os.path.join(temp_dir, filename)
+        if os.path.abspath(file_path) in keep_paths:
+            continue
         if os.path.isfile(file_path):
             # Check if file is older than grace period
             if now - os.path.getmtime(file_path) > grace_seconds:
@@ -6,6 +6,7 @@ from typing import Dict, List, Optional, Set
 from fastapi import WebSocket, WebSocketDisconnect
 from .config import Config
 from .utils import create_logger
+from .ws_mux import MuxSender
 
 logger = create_logger(__name__)
 
@@ -17,9 +18,22 @@ class ConnectionManager:
         self.connection_sessions: Dict[WebSocket, str] = {}  # websocket -> session_id
         self.active_session: Optional[str] = None  # Currently active session ID
         self.max_connections: int = Config.MAX_CONNECTIONS
+        self.mux_senders: Dict[WebSocket, MuxSender] = {}  # Connections whose session agreed to mux
         
     async def connect(self, websocket: WebSocket, session_id: str) -> bool:
         """Accept a new WebSocket connection with session validation."""
+        # A client reconnecting under its session id (to finish a recording
+        # cut off by the outage) may come back before its old connection
+        # has timed out here; the new connection replaces it
+        stale = self.active_connections.get(session_id)
+        if stale is not None:
+            logger.info(f"Session {session_id} reconnected, closing its previous connection")
+            self.disconnect(stale)
+            try:
+                await stale.close(code=1001, reason="Replaced by a new connection")
+            except Exception:
+                pass  # Already gone
+
         # Check if we've reached the maximum number of connections
         if len(self.active_connections) >= self.max_connections:
             await websocket.close(code=1008, reason="Too many connections")
@@ -43,8 +57,22 @@ class ConnectionManager:
         logger.info(f"New connection established for session {session_id}")
         return True
         
-    def disconnect(self, websocket: WebSocket):
-        """Handle WebSocket disconnection."""
+    def attach_mux(self, websocket: WebSocket, sender: MuxSender):
+        """Send the connection's messages through a channel multiplexer from now on."""
+        self.mux_senders[websocket] = sender
+
+    def get_mux(self, websocket: WebSocket) -> Optional[MuxSender]:
+        return self.mux_senders.get(websocket)
+
+    def disconnect(self, websocket: WebSocket) -> bool:
+        """Handle WebSocket disconnection.
+
+        Returns False if the connection had already been replaced (or
+        removed), so the caller leaves the session to the new one.
+        """
+        sender = self.mux_senders.pop(websocket, None)
+        if sender:
+            sender.close()
         session_id = self.connection_sessions.get(websocket)
         if session_id:
             del self.active_connections[session_id]
@@ -55,11 +83,22 @@ class ConnectionManager:
                 self.active_session = None
                 
             logger.info(f"Connection disconnected for session {session_id}")
+            return True
+        return False
     
-    async def send_personal_message(self, message: dict, websocket: WebSocket):
-        """Send a message to a specific WebSocket connection."""
+    async def send_personal_message(self, message: dict, websocket: WebSocket, after: Optional[int] = None):
+        """Send a message to a specific WebSocket connection.
+
+        On a multiplexed connection the message is queued ahead of binary
+        data; after names a channel (ws_mux) whose queued data goes first.
+        """
         try:
-            await websocket.send_text(json.dumps(message, separators=(',', ':')))  # More compact JSON
+            text = json.dumps(message, separators=(',', ':'))  # More compact JSON
+            sender = self.mux_senders.get(websocket)
+            if sender:
+                await sender.send_text(text, after)
+            else:
+                await websocket.send_text(text)
         except WebSocketDisconnect:
             self.disconnect(websocket)
         except Exception as e:
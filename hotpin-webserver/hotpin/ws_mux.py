@@ -0,0 +1,289 @@
+"""WebSocket channel multiplexer for HotPin WebServer.
+
+Control JSON, uplink audio, images and downlink TTS share one WebSocket.
+Sent whole and in order, a TTS frame or a JPEG holds every control message
+behind it. When the client offers the "mux" feature (and WS_MUX is on),
+binary messages go instead on logical channels in slices of at most
+WS_MUX_SLICE_BYTES, each one binary frame with a 2-byte header:
+
+    flags (high 2 bits: START 0x40, FINAL 0x80) | channel (low 4 bits),
+    message id (1 byte, per channel, wrapping)
+
+Control messages stay text frames, are never sliced and go ahead of any
+slice. The bulk channels share the rest by deficit round robin, weighted
+by DEFAULT_WEIGHTS. A control message sent "after" a channel (a fence) waits
+until everything queued on that channel before it has gone, so tts_done
+never overtakes the audio it ends.
+
+An audio message carries its own sequence number, ahead of the PCM:
+
+    seq (4 bytes, little-endian), flags (1 byte: AUDIO_FLAG_REPLAY)
+
+The client switches to slices right after sending "mux_ready", and the
+server when it reads it; until then both sides send binary messages whole.
+
+The firmware's side is main/ws_mux.c; both ends use the same framing and
+scheduler.
+"""
+import asyncio
+import time
+from collections import deque
+from typing import Deque, Dict, List, Optional, Tuple, Union
+
+from .utils import create_logger
+
+logger = create_logger(__name__)
+
+CONTROL, AUDIO, TTS, IMAGE, TELEMETRY = range(5)
+CHANNEL_NAMES = {CONTROL: "control", AUDIO: "audio", TTS: "tts", IMAGE: "image", TELEMETRY: "telemetry"}
+
+HEADER_BYTES = 2
+FLAG_START = 0x40
+FLAG_FINAL = 0x80
+CHANNEL_MASK = 0x0F
+MIN_SLICE = 256
+MAX_SLICE = 16384
+
+DEFAULT_WEIGHTS = {AUDIO: 4, TTS: 4, IMAGE: 1, TELEMETRY: 1}
+
+AUDIO_HEADER_BYTES = 5
+AUDIO_FLAG_REPLAY = 0x01  # Spilled to flash while the uplink was down
+
+
+def mux_header(channel: int, msg_id: int, start: bool, final: bool) -> bytes:
+    flags = (FLAG_START if start else 0) | (FLAG_FINAL if final else 0)
+    return bytes([flags | channel, msg_id & 0xFF])
+
+
+def audio_message(seq: int, pcm: bytes, replay: bool = False) -> bytes:
+    """An audio-channel message: header, then the frame."""
+    flags = AUDIO_FLAG_REPLAY if replay else 0
+    return (seq & 0xFFFFFFFF).to_bytes(4, "little") + bytes([flags]) + pcm
+
+
+def parse_audio_message(message: bytes) -> Optional[Tuple[int, bool, bytes]]:
+    """(seq, replay, pcm) of an audio-channel message, None if too short."""
+    if len(message) < AUDIO_HEADER_BYTES:
+        return None
+    seq = int.from_bytes(message[:4], "little")
+    return seq, bool(message[4] & AUDIO_FLAG_REPLAY), bytes(message[AUDIO_HEADER_BYTES:])
+
+
+def split_message(channel: int, msg_id: int, payload: bytes, slice_bytes: int) -> List[bytes]:
+    """All the frames of one bulk message, in order."""
+    frames = []
+    for offset in range(0, len(payload), slice_bytes):
+        piece = payload[offset:offset + slice_bytes]
+        frames.append(mux_header(channel, msg_id, offset == 0, offset + len(piece) == len(payload)) + piece)
+    return frames
+
+
+class _Item:
+    __slots__ = ("data", "offset", "after", "fence", "queued_at")
+
+    def __init__(self, data, after: Optional[int], fence: int):
+        self.data = data
+        self.offset = 0
+        self.after = after
+        self.fence = fence
+        self.queued_at = time.monotonic()
+
+
+class _Queue:
+    def __init__(self, weight: int):
+        self.items: Deque[_Item] = deque()
+        self.weight = max(1, weight)
+        self.deficit = 0
+        self.msg_id = 0
+        self.pushed = 0
+        self.done = 0
+
+
+class MuxScheduler:
+    """Picks the next frame: control first, then the bulk channels by
+    deficit round robin. Pure bookkeeping, no I/O (see ws_mux.c)."""
+
+    def __init__(self, slice_bytes: int, weights: Optional[Dict[int, int]] = None):
+        self.slice_bytes = min(max(slice_bytes, MIN_SLICE), MAX_SLICE)
+        weights = {**DEFAULT_WEIGHTS, **(weights or {})}
+        self.queues = {CONTROL: _Queue(1)}
+        for channel in (AUDIO, TTS, IMAGE, TELEMETRY):
+            self.queues[channel] = _Queue(weights.get(channel, 1))
+        self.bulk = [AUDIO, TTS, IMAGE, TELEMETRY]
+        self.turn = 0
+        self.granted = False  # The channel whose turn it is got its quantum
+
+    def push(self, channel: int, data: Union[str, bytes], after: Optional[int] = None):
+        """Queue a message; for control, after names a channel to go first."""
+        if not data:
+            return
+        after = after if channel == CONTROL and after in self.bulk else None
+        fence = self.queues[after].pushed if after is not None else 0
+        queue = self.queues[channel]
+        queue.items.append(_Item(data, after, fence))
+        queue.pushed += 1
+
+    def pending(self, channel: Optional[int] = None) -> int:
+        if channel is not None:
+            return len(self.queues[channel].items)
+        return sum(len(q.items) for q in self.queues.values())
+
+    def _pop(self, queue: _Queue) -> _Item:
+        item = queue.items.popleft()
+        queue.msg_id = (queue.msg_id + 1) & 0xFF
+        queue.done += 1
+        return item
+
+    def next(self) -> Optional[Tuple[int, Union[str, bytes], Optional[_Item]]]:
+        """The next frame as (channel, frame, item), item set on a message's
+        last frame; None if nothing can go."""
+        control = self.queues[CONTROL]
+        if control.items:
+            head = control.items[0]
+            if head.after is None or self.queues[head.after].done >= head.fence:
+                item = self._pop(control)
+                return CONTROL, item.data, item
+
+        # A channel keeps the turn while it has deficit left, and gets weight
+        # slices' worth once per turn
+        for _ in range(len(self.bulk) + 1):
+            channel = self.bulk[self.turn]
+            queue = self.queues[channel]
+            if queue.items and not self.granted:
+                queue.deficit += queue.weight * self.slice_bytes
+                self.granted = True
+            if queue.items and queue.deficit > 0:
+                return self._slice(channel, queue)
+            if not queue.items:
+                queue.deficit = 0  # No credit saved up while idle
+            self.turn = (self.turn + 1) % len(self.bulk)
+            self.granted = False
+        return None
+
+    def _slice(self, channel: int, queue: _Queue):
+        item = queue.items[0]
+        piece = item.data[item.offset:item.offset + self.slice_bytes]
+        start = item.offset == 0
+        item.offset += len(piece)
+        final = item.offset >= len(item.data)
+        frame = mux_header(channel, queue.msg_id, start, final) + piece
+        queue.deficit -= len(piece)
+        return channel, frame, self._pop(queue) if final else None
+
+    def abort(self, channel: int):
+        """Drop the rest of a channel's message after a failed send."""
+        queue = self.queues[channel]
+        if queue.items:
+            self._pop(queue)
+
+
+class MuxReceiver:
+    """Joins each bulk channel's slices from START to FINAL."""
+
+    def __init__(self, max_bytes: int):
+        self.max_bytes = max_bytes
+        self.partial: Dict[int, Tuple[int, bytearray]] = {}
+        self.dropped = 0
+
+    def feed(self, frame: bytes) -> Optional[Tuple[int, bytes]]:
+        """Take one binary frame; returns (channel, message) once complete."""
+        if len(frame) < HEADER_BYTES:
+            self.dropped += 1
+            return None
+        channel = frame[0] & CHANNEL_MASK
+        flags = frame[0] & (FLAG_START | FLAG_FINAL)
+        msg_id = frame[1]
+        if channel == CONTROL or channel not in CHANNEL_NAMES:
+            self.dropped += 1
+            return None
+
+        if flags & FLAG_START:
+            if channel in self.partial:
+                self.dropped += 1  # Its FINAL slice never came
+            self.partial[channel] = (msg_id, bytearray())
+        current = self.partial.get(channel)
+        if current is None or current[0] != msg_id:
+            self.dropped += 1  # Rest of a message whose start was lost
+            return None
+        buffer = current[1]
+        buffer += frame[HEADER_BYTES:]
+        if len(buffer) > self.max_bytes:
+            del self.partial[channel]
+            self.dropped += 1
+            return None
+        if flags & FLAG_FINAL:
+            del self.partial[channel]
+            return channel, bytes(buffer)
+        return None
+
+
+class MuxSender:
+    """Sends one connection's outbound messages through a MuxScheduler.
+
+    send_text() queues and returns; a background task writes frames to the
+    socket one at a time, so a control message waits for one slice at most.
+    send_bytes() waits while its channel has max_pending messages queued,
+    which paces TTS to the link.
+    """
+
+    def __init__(self, websocket, slice_bytes: int, weights: Optional[Dict[int, int]] = None,
+                 max_pending: int = 4):
+        self.websocket = websocket
+        self.scheduler = MuxScheduler(slice_bytes, weights)
+        self.max_pending = max_pending
+        self.wake = asyncio.Event()
+        self.drained = asyncio.Event()
+        self.closed = False
+        self.frames = {channel: 0 for channel in CHANNEL_NAMES}
+        self.control_wait_max_ms = 0.0
+        self.task = asyncio.create_task(self._run())
+
+    async def send_text(self, text: str, after: Optional[int] = None):
+        if self.closed:
+            raise ConnectionError("WebSocket multiplexer closed")
+        self.scheduler.push(CONTROL, text, after)
+        self.wake.set()
+
+    async def send_bytes(self, channel: int, data: bytes):
+        while not self.closed and self.scheduler.pending(channel) >= self.max_pending:
+            self.drained.clear()
+            await self.drained.wait()
+        if self.closed:
+            raise ConnectionError("WebSocket multiplexer closed")
+        self.scheduler.push(channel, data)
+        self.wake.set()
+
+    async def _run(self):
+        try:
+            while True:
+                picked = self.scheduler.next()
+                if picked is None:
+                    self.wake.clear()
+                    await self.wake.wait()
+                    continue
+                channel, frame, item = picked
+                if channel == CONTROL:
+                    await self.websocket.send_text(frame)
+                    wait_ms = (time.monotonic() - item.queued_at) * 1000
+                    self.control_wait_max_ms = max(self.control_wait_max_ms, wait_ms)
+                else:
+                    await self.websocket.send_bytes(frame)
+                self.frames[channel] += 1
+                if item is not None:
+                    self.drained.set()
+        except asyncio.CancelledError:
+            pass
+        except Exception as e:
+            logger.warning(f"WebSocket multiplexer stopped: {e}")
+        finally:
+            self.closed = True
+            self.drained.set()
+
+    def close(self):
+        """Stop sending; whatever is still queued is dropped."""
+        if not self.closed:
+            self.closed = True
+            self.task.cancel()
+            self.drained.set()
+        sent = {CHANNEL_NAMES[c]: n for c, n in self.frames.items() if n}
+        logger.info(f"Multiplexer frames sent: {sent}, longest control wait {self.control_wait_max_ms:.1f} ms")
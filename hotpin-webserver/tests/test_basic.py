@@ -1,6 +1,7 @@
 """Basic tests for HotPin WebServer."""
 import asyncio
 import os
+import time
 from hotpin.config import Config
 from hotpin.utils import create_logger
 from hotpin.session_manager import session_manager
@@ -80,6 +81,221 @@ def test_audio_validation():
     print("✓ Audio validation working correctly")
 
 
+def test_profile_negotiation():
+    """Test that the negotiated profile stays within the client's capabilities."""
+    print("Testing session profile negotiation...")
+    
+    from hotpin.session_manager import ClientCapabilities, negotiate_profile
+    
+    caps = ClientCapabilities.from_hello({
+        "psram": True,
+        "codecs": ["pcm16"],
+        "sample_rates": [16000],
+        "min_frame_bytes": 2048,
+        "max_frame_bytes": 4096,
+        "features": ["barge_in", "tts_cache"]
+    }, protocol=2)
+    profile = negotiate_profile(caps)
+    assert profile is not None, "pcm16 at 16 kHz should be agreed"
+    assert 2048 <= profile.uplink_frame_bytes <= 4096, "Uplink frame should fit the client's limits"
+    assert profile.downlink_frame_bytes <= 4096, "Downlink frame should not exceed the client's maximum"
+    assert profile.uplink_frame_bytes % 2 == 0, "Frames should hold whole PCM16 samples"
+    assert 2048 <= profile.uplink_min_frame_bytes <= profile.uplink_frame_bytes, "Adaptive frame range should be ordered"
+    
+    # No codec in common
+    caps.codecs = ["opus"]
+    assert negotiate_profile(caps) is None, "Negotiation should fail without a common codec"
+    
+    print("✓ Profile negotiation working correctly")
+
+
+def test_runtime_config_deltas():
+    """Test that config_update carries only the settings a client is missing."""
+    print("Testing runtime configuration deltas...")
+    
+    import tempfile
+    from hotpin.runtime_config import RuntimeConfigStore, validate_settings
+    
+    with tempfile.TemporaryDirectory() as tmp:
+        path = os.path.join(tmp, "runtime_config.json")
+        store = RuntimeConfigStore(path)
+        assert store.update({"jpeg_quality": 10, "log_level": "warn"}) == 1
+        assert store.update({"jpeg_quality": 10}) == 1, "An unchanged value should not bump the version"
+        assert store.update({"ping_interval_sec": 15}) == 2
+        
+        assert store.update_message(2) is None, "A current client needs no update"
+        assert store.update_message(1)["set"] == {"ping_interval_sec": 15}
+        assert store.update_message(0)["set"] == {"jpeg_quality": 10, "log_level": "warn", "ping_interval_sec": 15}
+        assert RuntimeConfigStore(path).delta_since(1) == {"ping_interval_sec": 15}, "Versions should survive a restart"
+    
+    assert validate_settings({"chunk_ms": 0, "codec": "pcm16"}) is None
+    assert validate_settings({"chunk_ms": 10}) is not None, "Frames under 20 ms should be refused"
+    assert validate_settings({"log_level": "loud"}) is not None
+    assert validate_settings({"sample_rate": 8000}) is not None, "Unknown settings should be refused"
+    
+    print("✓ Runtime configuration deltas working correctly")
+
+
+def test_discovery_beacon():
+    """Test that discovery beacons are signed and do not carry the token."""
+    print("Testing discovery beacons...")
+    
+    import hashlib
+    import hmac
+    import json
+    from hotpin.discovery import make_beacon
+    
+    url = "ws://192.168.1.20:8000/ws"
+    beacon = json.loads(make_beacon(url, "secret", 7, ts=1700000000))
+    assert beacon["url"] == url and "secret" not in json.dumps(beacon), "The token must not be broadcast"
+    expected = hmac.new(b"secret", f"hotpin1|{url}|7|1700000000".encode(), hashlib.sha256).hexdigest()
+    assert beacon["sig"] == expected, "Signature should match what the firmware computes"
+    assert "sig" not in json.loads(make_beacon(url, None, 1)), "Without a key the beacon is unsigned"
+    
+    print("✓ Discovery beacons working correctly")
+
+
+def test_udp_jitter_buffer():
+    """Test that UDP audio comes out in order with a lost packet rebuilt."""
+    print("Testing UDP jitter buffer...")
+    
+    from hotpin.audio_ingestor import JitterBuffer, parse_rtp, rtp_packet, fec_packet
+    
+    frames = [bytes([i]) * 640 for i in range(1, 8)]
+    packets = [rtp_packet(65534 + i, 320 * i, 7, f, marker=(i == 0)) for i, f in enumerate(frames)]
+    parity = fec_packet(65534, 0, 7, frames[:4])
+    buffer = JitterBuffer(depth_ms=100)
+    # Packet 1 is lost and 3 overtakes 2; the sequence number wraps at 2
+    for data in packets[:1] + packets[3:4] + packets[2:3] + [parity] + packets[4:]:
+        buffer.push(parse_rtp(data), 0.0)
+    released = buffer.pop_ready(0.01)
+    assert [f.payload for f in released] == frames, "Frames should be in order with the lost one recovered"
+    assert released[1].kind == "recovered" and buffer.stats["recovered"] == 1
+    assert buffer.stats["reordered"] == 1
+    
+    # Frames 7-9 lost without parity: 10 waits for them, then they are silence
+    buffer.push(parse_rtp(rtp_packet(65534 + 10, 3200, 7, frames[0])), 0.02)
+    assert buffer.pop_ready(0.05) == [], "A gap should hold later frames back for the jitter depth"
+    released = buffer.pop_ready(0.2)
+    assert [f.kind for f in released] == ["lost"] * 3 + ["received"], "The gap should be concealed"
+    assert released[0].payload == bytes(640)
+    assert parse_rtp(b"\x00" * 20) is None, "Non-RTP datagrams should be rejected"
+    
+    print("✓ UDP jitter buffer working correctly")
+
+
+def test_ws_mux():
+    """Test that control jumps sliced binary data but not past its fence."""
+    print("Testing WebSocket channel multiplexer...")
+    
+    from hotpin.ws_mux import (MuxReceiver, MuxScheduler, AUDIO, CONTROL, IMAGE, audio_message,
+                               parse_audio_message)
+    
+    scheduler = MuxScheduler(slice_bytes=256, weights={AUDIO: 2, IMAGE: 1})
+    audio = bytes(range(256)) * 3
+    image = b"\xff" * 600
+    scheduler.push(AUDIO, audio)
+    scheduler.push(IMAGE, image)
+    scheduler.push(CONTROL, '{"type":"ack"}')
+    scheduler.push(CONTROL, '{"type":"recording_stopped"}', after=AUDIO)
+    order = []
+    receiver = MuxReceiver(max_bytes=4096)
+    completed = []
+    while (picked := scheduler.next()) is not None:
+        channel, frame, _ = picked
+        order.append((channel, frame if channel == CONTROL else len(frame) - 2))
+        if channel != CONTROL:
+            completed.append(receiver.feed(frame))
+    assert order[0] == (CONTROL, '{"type":"ack"}'), "Control should go before any slice"
+    assert order[1:4] == [(AUDIO, 256), (AUDIO, 256), (IMAGE, 256)], "Audio should get two slices per image slice"
+    stop = order.index((CONTROL, '{"type":"recording_stopped"}'))
+    assert [c for c, _ in order[:stop]].count(AUDIO) == 3, "The fence should hold control until the audio is sent"
+    assert [c for c, _ in order[stop + 1:]] == [IMAGE, IMAGE], "The image should finish after the fenced message"
+    assert (AUDIO, audio) in completed and (IMAGE, image) in completed, "Slices should join into the messages"
+    
+    # A message cut short is dropped when the channel's next one starts
+    assert receiver.feed(bytes([0x40 | AUDIO, 9]) + b"a") is None
+    assert receiver.feed(bytes([0xC0 | AUDIO, 10]) + b"b") == (AUDIO, b"b")
+    assert receiver.dropped == 1
+    
+    # Audio messages carry their own seq and replay flag
+    assert parse_audio_message(audio_message(70000, b"pcm", replay=True)) == (70000, True, b"pcm")
+    assert parse_audio_message(audio_message(3, b"")) == (3, False, b"")
+    assert parse_audio_message(b"\x01\x02") is None, "A message shorter than its header should be rejected"
+    
+    print("✓ WebSocket channel multiplexer working correctly")
+
+
+async def test_recording_resumes_after_reconnect():
+    """Test that audio spilled during an outage lands in the recording it belongs to."""
+    print("Testing recording resume after a reconnect...")
+    
+    from hotpin.config import Config
+    from hotpin.session_manager import SessionState
+    from hotpin.server import ws_manager, audio_ingestor, accept_audio_chunk, handle_recording_started
+    from hotpin.utils import cleanup_old_files
+    
+    class FakeWebSocket:
+        def __init__(self):
+            self.sent = []
+            self.closed = None
+        
+        async def accept(self):
+            pass
+        
+        async def close(self, code=1000, reason=""):
+            self.closed = code
+        
+        async def send_text(self, text):
+            self.sent.append(text)
+    
+    session_id = "test_resume_session"
+    chunk = bytes(640)
+    first = FakeWebSocket()
+    assert await ws_manager.connect(first, session_id)
+    session = session_manager.create_session(session_id)
+    await handle_recording_started(first, session, {"type": "recording_started"})
+    await accept_audio_chunk(first, session, 0, len(chunk), chunk)
+    
+    # The link drops mid-recording and stays down past the idle grace period
+    assert ws_manager.disconnect(first)
+    session.update_state(SessionState.DISCONNECTED)
+    session.last_activity -= Config.SESSION_GRACE_SEC + 1
+    session_manager.cleanup_expired_sessions()
+    assert session_manager.get_session(session_id) is session, "A session with an open recording should be kept"
+    stale = time.time() - Config.SESSION_GRACE_SEC - 1
+    os.utime(session.audio_buffer.temp_file_path, (stale, stale))
+    cleanup_old_files(Config.TEMP_DIR, Config.SESSION_GRACE_SEC, keep=session_manager.open_recording_paths())
+    assert os.path.exists(session.audio_buffer.temp_file_path), "An open recording's file should be kept"
+    
+    # The client comes back under the same session and replays its spill
+    second = FakeWebSocket()
+    assert await ws_manager.connect(second, session_id)
+    session.update_state(SessionState.CONNECTED)
+    await accept_audio_chunk(second, session, 1, len(chunk), chunk, replay=True)
+    
+    # Reconnecting again before the server noticed the drop replaces the stale connection
+    third = FakeWebSocket()
+    assert await ws_manager.connect(third, session_id), "A reconnect should replace its stale connection"
+    assert second.closed is not None, "The stale connection should be closed"
+    assert not ws_manager.disconnect(second), "The stale connection should no longer own the session"
+    await accept_audio_chunk(third, session, 2, len(chunk), chunk, replay=True)
+    
+    assert session.audio_buffer.chunks_received == 3
+    assert session.audio_buffer.replayed_chunks == 2
+    path = await audio_ingestor.finalize_recording(session)
+    assert path and os.path.getsize(path) == 3 * len(chunk), "Every chunk should be in the recording"
+    
+    # A replay arriving after recording_stopped belongs to no recording
+    await accept_audio_chunk(third, session, 3, len(chunk), chunk, replay=True)
+    assert session.audio_buffer.chunks_received == 3
+    
+    ws_manager.disconnect(third)
+    session_manager.remove_session(session_id)
+    
+    print("✓ Recording resume after a reconnect working correctly")
+
+
 async def run_all_tests():
     """Run all basic tests."""
     print("Starting HotPin WebServer basic tests...\n")
@@ -88,6 +304,12 @@ async def run_all_tests():
     test_components_initialization()
     test_session_management()
     test_audio_validation()
+    test_profile_negotiation()
+    test_runtime_config_deltas()
+    test_discovery_beacon()
+    test_udp_jitter_buffer()
+    test_ws_mux()
+    await test_recording_resumes_after_reconnect()
     
     print("\n✓ All basic tests passed!")
 
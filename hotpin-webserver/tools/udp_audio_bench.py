@@ -0,0 +1,206 @@
+#!/usr/bin/env python3
+"""
+HotPin UDP Audio Loss Benchmark
+
+Streams 20 ms RTP packets, in the firmware's format (main/rtp_fec.c), over
+loopback UDP into the server's UdpAudioReceiver and measures how much of
+the audio comes out, and how late, with and without XOR parity. Every
+scenario runs at once, each as its own stream, in real time.
+
+By default the loss and delay are emulated in the sender: each packet is
+dropped by a Gilbert-Elliott model (random loss when the mean burst is 1)
+and delayed by a base plus a uniform jitter, which also reorders packets.
+With --netem the sender leaves packets alone, so the impairment comes from
+netem on the loopback interface instead, e.g.:
+
+    sudo tc qdisc add dev lo root netem loss 5% delay 10ms 10ms
+    python tools/udp_audio_bench.py --netem
+    sudo tc qdisc del dev lo root
+
+Latency is from the packet's send to its release from the jitter buffer,
+network delay included.
+
+Usage:
+    python tools/udp_audio_bench.py [--seconds 20] [--jitter-ms 20] [--depth-ms 100] [--netem]
+"""
+
+import argparse
+import asyncio
+import os
+import random
+import socket
+import sys
+import time
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), os.pardir))
+
+from hotpin.audio_ingestor import UdpAudioReceiver, fec_packet, rtp_packet  # noqa: E402
+
+FRAME_MS = 20
+FRAME_BYTES = 640
+BASE_DELAY_MS = 5
+
+# (name, average loss, mean burst length in packets)
+LOSS_MODELS = [
+    ("none", 0.0, 1),
+    ("1% random", 0.01, 1),
+    ("5% random", 0.05, 1),
+    ("10% random", 0.10, 1),
+    ("5% bursts of 3", 0.05, 3),
+]
+FEC_GROUPS = [0, 4, 2]
+
+
+class FakeSession:
+    def __init__(self, session_id):
+        self.session_id = session_id
+
+
+class GilbertElliott:
+    """Two-state loss: every packet in the bad state is lost."""
+
+    def __init__(self, loss, burst, rng):
+        self.rng = rng
+        self.leave_bad = 1.0 / burst
+        self.enter_bad = loss * self.leave_bad / (1.0 - loss) if loss > 0 else 0.0
+        self.bad = False
+
+    def drop(self):
+        self.bad = self.rng.random() < (1.0 - self.leave_bad if self.bad else self.enter_bad)
+        return self.bad
+
+
+class Stream:
+    def __init__(self, name, loss, burst, group, args, receiver, port, rng):
+        self.name = name
+        self.group = group
+        self.args = args
+        self.loss = GilbertElliott(loss, burst, rng)
+        self.rng = rng
+        self.session = FakeSession(f"{name}/{group}")
+        self.ssrc = receiver.register(self.session, "127.0.0.1")
+        receiver.start(self.session)
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.connect(("127.0.0.1", port))
+        self.sent_at = {}
+        self.released = {}
+        self.first_seq = rng.randrange(65536)
+        self.seq = self.first_seq
+        self.bytes = 0
+        self.audio_lost = 0
+        self.audio_bytes = 0
+        self.group_payloads = []
+        self.group_seq = 0
+
+    def _emit(self, loop, data, audio=False):
+        self.bytes += len(data)
+        if self.args.netem:
+            self.sock.send(data)
+            return
+        if self.loss.drop():
+            self.audio_lost += audio
+            return
+        delay = (BASE_DELAY_MS + self.rng.uniform(0, self.args.jitter_ms)) / 1000
+        loop.call_later(delay, self.sock.send, data)
+
+    def send_frame(self, loop, index):
+        payload = frame_payload(index)
+        seq = self.seq & 0xffff
+        self.sent_at[index] = time.monotonic()
+        self.audio_bytes += FRAME_BYTES
+        self._emit(loop, rtp_packet(seq, index * FRAME_BYTES // 2, self.ssrc, payload, marker=index == 0), audio=True)
+        if self.group:
+            if not self.group_payloads:
+                self.group_seq = seq
+            self.group_payloads.append(payload)
+            if len(self.group_payloads) == self.group:
+                self._emit(loop, fec_packet(self.group_seq, 0, self.ssrc, self.group_payloads))
+                self.group_payloads = []
+        self.seq += 1
+
+    def finish(self, loop):
+        if self.group_payloads:
+            self._emit(loop, fec_packet(self.group_seq, 0, self.ssrc, self.group_payloads))
+            self.group_payloads = []
+
+    def on_frame(self, seq, payload):
+        # Extended seq numbers start where the stream did
+        self.released[seq - self.first_seq] = (time.monotonic(), payload)
+
+
+def frame_payload(index):
+    """Distinct for every frame and never silence."""
+    return (index + 1).to_bytes(4, "big") * (FRAME_BYTES // 4)
+
+
+def percentile(values, fraction):
+    if not values:
+        return 0.0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(fraction * len(values)))]
+
+
+async def run(args):
+    loop = asyncio.get_running_loop()
+    streams = {}
+
+    def on_frame(session, seq, payload):
+        streams[session.session_id].on_frame(seq, payload)
+
+    transport, receiver = await loop.create_datagram_endpoint(
+        lambda: UdpAudioReceiver(on_frame, args.depth_ms), local_addr=("127.0.0.1", 0))
+    port = transport.get_extra_info("sockname")[1]
+    rng = random.Random(args.seed)
+    for name, loss, burst in LOSS_MODELS if not args.netem else [("netem", 0.0, 1)]:
+        for group in FEC_GROUPS:
+            stream = Stream(name, loss, burst, group, args, receiver, port, rng)
+            streams[stream.session.session_id] = stream
+
+    frames = args.seconds * 1000 // FRAME_MS
+    start = time.monotonic()
+    for index in range(frames):
+        for stream in streams.values():
+            stream.send_frame(loop, index)
+        await asyncio.sleep(max(0.0, start + (index + 1) * FRAME_MS / 1000 - time.monotonic()))
+    for stream in streams.values():
+        stream.finish(loop)
+
+    results = []
+    for stream in streams.values():
+        stats = await receiver.stop(stream.session, (stream.first_seq + frames - 1) & 0xffff)
+        delivered = [i for i, (_, payload) in stream.released.items() if payload == frame_payload(i)]
+        latencies = [(stream.released[i][0] - stream.sent_at[i]) * 1000 for i in delivered if i in stream.sent_at]
+        results.append((stream, stats, len(delivered), latencies))
+    transport.close()
+
+    print(f"{frames} frames of {FRAME_MS} ms per stream, jitter buffer {args.depth_ms} ms"
+          + ("" if args.netem else f", delay {BASE_DELAY_MS}+0..{args.jitter_ms} ms"))
+    print()
+    print("| Loss | Parity | Lost | Recovered | Residual loss | p50 | p99 | Max | Overhead |")
+    print("|------|--------|------|-----------|---------------|-----|-----|-----|----------|")
+    for stream, stats, delivered, latencies in results:
+        # Under netem, what never arrived: parity can rebuild a packet that
+        # is only late, which then counts as a duplicate
+        lost = frames - stats["received"] - stats["duplicate"] - stats["late"] if args.netem else stream.audio_lost
+        missing = frames - delivered
+        recovered = f"{100 * (lost - missing) / lost:.0f}%" if lost > 0 else "-"
+        print(f"| {stream.name} | {'1 per %d' % stream.group if stream.group else 'none'} "
+              f"| {100 * lost / frames:.1f}% | {recovered} "
+              f"| {100 * missing / frames:.2f}% "
+              f"| {percentile(latencies, 0.5):.0f} ms | {percentile(latencies, 0.99):.0f} ms "
+              f"| {max(latencies, default=0):.0f} ms "
+              f"| {100 * (stream.bytes - stream.audio_bytes) / stream.audio_bytes:.0f}% |")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0].strip())
+    parser.add_argument("--seconds", type=int, default=20, help="Audio per stream")
+    parser.add_argument("--jitter-ms", type=int, default=20, help="Emulated delay spread on top of 5 ms")
+    parser.add_argument("--depth-ms", type=int, default=100, help="Jitter buffer depth (UDP_JITTER_MS)")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--netem", action="store_true", help="Leave loss and delay to netem on lo")
+    asyncio.run(run(parser.parse_args()))
+
+
+if __name__ == "__main__":
+    main()
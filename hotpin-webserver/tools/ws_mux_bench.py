@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+"""
+HotPin WebSocket Multiplexer Benchmark
+
+Measures how long small control messages (acks, 40-odd bytes of JSON) take
+to cross a WebSocket that live audio and camera images keep saturated: sent
+whole and in order, as before the mux feature, and through the multiplexer
+(hotpin/ws_mux.py, the same scheduler as the firmware's main/ws_mux.c) at
+several slice sizes. Every scenario runs at once, each on its own link, in
+real time.
+
+The link is emulated: each frame, plus a 6-byte WebSocket header, takes
+its size over the link rate to go out, one frame at a time, as a socket
+with a full send buffer would. Audio frames go out every frame period and
+images every --image-every seconds, together near the link's capacity;
+control messages go at random, about every 100 ms.
+
+Latency is from when a message is handed to the sender to when its last
+byte has crossed the link.
+
+Usage:
+    python tools/ws_mux_bench.py [--seconds 30] [--rate-kbps 600] [--audio-bytes 16000] [--image-bytes 60000]
+"""
+
+import argparse
+import asyncio
+import json
+import logging
+import os
+import random
+import sys
+import time
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), os.pardir))
+
+from hotpin.ws_mux import AUDIO, IMAGE, MuxReceiver, MuxSender  # noqa: E402
+
+WS_HEADER_BYTES = 6
+AUDIO_BYTES_PER_SEC = 32000     # 16 kHz PCM16
+SLICES = [4096, 1024, 512]
+
+
+class EmulatedLink:
+    """Stands in for a WebSocket: sends finish when the link has carried them."""
+
+    def __init__(self, rate_kbps, on_frame):
+        self.bytes_per_sec = rate_kbps * 1000 / 8
+        self.on_frame = on_frame
+        self.lock = asyncio.Lock()
+        self.free_at = 0.0
+
+    async def _send(self, size, frame):
+        async with self.lock:
+            now = time.monotonic()
+            self.free_at = max(self.free_at, now) + (size + WS_HEADER_BYTES) / self.bytes_per_sec
+            await asyncio.sleep(self.free_at - now)
+            self.on_frame(frame, self.free_at)
+
+    async def send_text(self, text):
+        await self._send(len(text.encode()), text)
+
+    async def send_bytes(self, data):
+        await self._send(len(data), data)
+
+
+class InOrderSender:
+    """Whole messages, first in first out: the path without mux."""
+
+    def __init__(self, link):
+        self.link = link
+        self.queue = asyncio.Queue()
+        self.task = asyncio.create_task(self._run())
+
+    async def _run(self):
+        while True:
+            channel, data = await self.queue.get()
+            if channel is None:
+                await self.link.send_text(data)
+            else:
+                await self.link.send_bytes(data)
+
+    async def send_text(self, text, after=None):
+        await self.queue.put((None, text))
+
+    async def send_bytes(self, channel, data):
+        await self.queue.put((channel, data))
+
+    def close(self):
+        self.task.cancel()
+
+
+class Scenario:
+    def __init__(self, name, slice_bytes, args):
+        self.name = name
+        self.slice_bytes = slice_bytes
+        self.latency = {"control": [], "audio": [], "image": []}
+        self.sent_at = {}
+        self.receiver = MuxReceiver(max(args.image_bytes, args.audio_bytes) + 1) if slice_bytes else None
+        self.link = EmulatedLink(args.rate_kbps, self.on_frame)
+        self.sender = MuxSender(self.link, slice_bytes, max_pending=1 << 30) if slice_bytes else InOrderSender(self.link)
+
+    def on_frame(self, frame, done_at):
+        if isinstance(frame, str):
+            message = json.loads(frame)
+            self.latency["control"].append((done_at - message["t"]) * 1000)
+            return
+        if self.receiver:
+            completed = self.receiver.feed(frame)
+            if completed is None:
+                return
+            frame = completed[1]
+        kind, index = frame[0], int.from_bytes(frame[1:5], "big")
+        self.latency["audio" if kind == AUDIO else "image"].append((done_at - self.sent_at[(kind, index)]) * 1000)
+
+    async def send_bulk(self, kind, index, size):
+        self.sent_at[(kind, index)] = time.monotonic()
+        await self.sender.send_bytes(kind, bytes([kind]) + index.to_bytes(4, "big") + bytes(size - 5))
+
+    async def send_control(self, index):
+        await self.sender.send_text(json.dumps({"type": "ack", "ref": "chunk", "seq": index, "t": time.monotonic()}))
+
+
+async def produce(scenarios, args, rng):
+    loop_start = time.monotonic()
+    frame_period = args.audio_bytes / AUDIO_BYTES_PER_SEC
+    next_audio, next_image, next_control = 0.0, 0.5, rng.uniform(0, 0.2)
+    audio_index = image_index = control_index = 0
+    while True:
+        now = time.monotonic() - loop_start
+        if now >= args.seconds:
+            return
+        if now >= next_audio:
+            for scenario in scenarios:
+                await scenario.send_bulk(AUDIO, audio_index, args.audio_bytes)
+            audio_index += 1
+            next_audio += frame_period
+        if now >= next_image:
+            for scenario in scenarios:
+                await scenario.send_bulk(IMAGE, image_index, args.image_bytes)
+            image_index += 1
+            next_image += args.image_every
+        if now >= next_control:
+            for scenario in scenarios:
+                await scenario.send_control(control_index)
+            control_index += 1
+            next_control += rng.uniform(0, 0.2)
+        await asyncio.sleep(max(0.0, min(next_audio, next_image, next_control) - (time.monotonic() - loop_start)))
+
+
+def percentile(values, fraction):
+    if not values:
+        return 0.0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(fraction * len(values)))]
+
+
+async def run(args):
+    scenarios = [Scenario("in order", 0, args)] + [Scenario("mux", s, args) for s in SLICES]
+    await produce(scenarios, args, random.Random(args.seed))
+    await asyncio.sleep(args.drain)
+    for scenario in scenarios:
+        scenario.sender.close()
+
+    load = (AUDIO_BYTES_PER_SEC + args.image_bytes / args.image_every) * 8 / 1000
+    print(f"{args.seconds} s on a {args.rate_kbps} kbit/s link; {args.audio_bytes} B audio frames and a "
+          f"{args.image_bytes} B image every {args.image_every} s ({100 * load / args.rate_kbps:.0f}% of the link)")
+    print()
+    print("| Sending | Slice | Control p50 | Control p99 | Control max | Audio p50 | Audio p99 | Image p50 |")
+    print("|---------|-------|-------------|-------------|-------------|-----------|-----------|-----------|")
+    for s in scenarios:
+        control, audio, image = s.latency["control"], s.latency["audio"], s.latency["image"]
+        print(f"| {s.name} | {s.slice_bytes or 'whole'} "
+              f"| {percentile(control, 0.5):.0f} ms | {percentile(control, 0.99):.0f} ms | {max(control, default=0):.0f} ms "
+              f"| {percentile(audio, 0.5):.0f} ms | {percentile(audio, 0.99):.0f} ms "
+              f"| {percentile(image, 0.5):.0f} ms |")
+
+
+def main():
+    logging.getLogger("hotpin.ws_mux").setLevel(logging.WARNING)  # Per-sender summaries
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0].strip())
+    parser.add_argument("--seconds", type=int, default=30, help="Load per scenario")
+    parser.add_argument("--rate-kbps", type=int, default=600, help="Emulated link rate")
+    parser.add_argument("--audio-bytes", type=int, default=16000, help="Audio frame (CHUNK_SIZE_BYTES)")
+    parser.add_argument("--image-bytes", type=int, default=60000, help="JPEG size")
+    parser.add_argument("--image-every", type=float, default=2.0, help="Seconds between images")
+    parser.add_argument("--drain", type=float, default=5.0, help="Seconds to let queued data finish")
+    parser.add_argument("--seed", type=int, default=1)
+    asyncio.run(run(parser.parse_args()))
+
+
+if __name__ == "__main__":
+    main()